@@ -51,4 +51,22 @@ float LinearizeDepth(float depth, float NearPlaneZ, float FarPlaneZ)
     float linearDepth = ProjectionB / (depth - ProjectionA);
 
     return linearDepth;
+}
+
+// Decoding of the compressed vertex streams (see ER_VertexCompression.h)
+// 'quantizedPosition' is R16G16B16A16_UNORM, scale/bias are from ER_VertexCompression::GetPositionDecodeScaleBias()
+float4 DecodeQuantizedPosition(float4 quantizedPosition, float4 scale, float4 bias)
+{
+    return float4(quantizedPosition.xyz * scale.xyz + bias.xyz, 1.0f);
+}
+
+// 'encoded' is R16G16_UNORM (octahedral mapping)
+float3 DecodeOctahedral(float2 encoded)
+{
+    float2 e = encoded * 2.0f - 1.0f;
+    float3 v = float3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-v.z);
+    v.x += v.x >= 0.0f ? -t : t;
+    v.y += v.y >= 0.0f ? -t : t;
+    return normalize(v);
 }
\ No newline at end of file
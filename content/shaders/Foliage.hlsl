@@ -15,6 +15,8 @@ cbuffer FoliageCBuffer : register(b0)
     float4 CameraPos;
     float4 VoxelCameraPos;
     float4 WindDirection;
+    float4 PositionDecodeScale; // only for VSMain_quantized
+    float4 PositionDecodeBias; // only for VSMain_quantized
     float RotateToCamera;
     float Time;
     float WindFrequency;
@@ -41,6 +43,16 @@ struct VS_INPUT
     row_major float4x4 World : WORLD;
 };
 
+// VertexQuantizedPositionTextureNormal (see ER_VertexCompression.h)
+struct VS_INPUT_QUANTIZED
+{
+    float4 Position : POSITION; // R16G16B16A16_UNORM
+    float2 TextureCoordinates : TEXCOORD0; // R16G16_FLOAT
+    float2 Normal : NORMAL; // R16G16_UNORM
+    
+    row_major float4x4 World : WORLD;
+};
+
 struct VS_OUTPUT
 {
     float4 Position : SV_Position;
@@ -184,6 +196,17 @@ VS_OUTPUT VSMain(VS_INPUT IN)
     return OUT;
 }
 
+VS_OUTPUT VSMain_quantized(VS_INPUT_QUANTIZED IN)
+{
+    VS_INPUT decodedIN;
+    decodedIN.Position = DecodeQuantizedPosition(IN.Position, PositionDecodeScale, PositionDecodeBias);
+    decodedIN.TextureCoordinates = IN.TextureCoordinates;
+    decodedIN.Normal = DecodeOctahedral(IN.Normal);
+    decodedIN.World = IN.World;
+    
+    return VSMain(decodedIN);
+}
+
 float CalculateShadow(float3 ShadowCoord, int index)
 {
     const float Dilation = 2.0;
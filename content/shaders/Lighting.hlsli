@@ -245,9 +245,18 @@ float3 GetTrilinearInterpolationFromNeighbourProbes(float3 pos, float distanceBe
     float3 result = float3(0.0, 0.0, 0.0);
     
     float cellDistance = distanceBetweenDiffuseProbes;
-    float distanceX0 = abs(cellProbesPositions[0].x - pos.x) / cellDistance;
-    float distanceY0 = abs(cellProbesPositions[0].y - pos.y) / cellDistance;
-    float distanceZ0 = abs(cellProbesPositions[0].z - pos.z) / cellDistance;
+    
+    // first corner of the cell (probe #0 can be skipped in sparse grids, so we restore it from any existing probe: index = (y << 2) | (x << 1) | z)
+    float3 cellCorner = cellProbesPositions[0];
+    for (int i = NUM_OF_PROBES_PER_CELL - 1; i >= 0; i--)
+    {
+        if (cellProbesExistanceFlags[i])
+            cellCorner = cellProbesPositions[i] - float3((i >> 1) & 1, i >> 2, i & 1) * cellDistance;
+    }
+    
+    float distanceX0 = abs(cellCorner.x - pos.x) / cellDistance;
+    float distanceY0 = abs(cellCorner.y - pos.y) / cellDistance;
+    float distanceZ0 = abs(cellCorner.z - pos.z) / cellDistance;
     
     // bottom-left, bottom-right, upper-left, upper-right, bottom-total, upper-total
     bool sideHasColor[6] = { true, true, true, true, true, true };
@@ -435,6 +444,7 @@ float3 GetDiffuseIrradiance(float3 worldPos, float3 normal, float3 camPos, bool
     int diffuseProbesCellIndex = GetLightProbesCellIndex(worldPos, probesInfo.diffuseProbeCellsCount, probesInfo.sceneLightProbeBounds.xyz, probesInfo.distanceBetweenDiffuseProbes);
     if (diffuseProbesCellIndex != -1)
     {
+        bool hasProbes = false;
         for (int i = 0; i < NUM_OF_PROBES_PER_CELL; i++)
         {
             cellProbesExistanceFlags[i] = false;
@@ -443,6 +453,7 @@ float3 GetDiffuseIrradiance(float3 worldPos, float3 normal, float3 camPos, bool
             if (currentIndex != -1)
             {
                 cellProbesExistanceFlags[i] = true;
+                hasProbes = true;
             
                 float3 SH[SPHERICAL_HARMONICS_COEF_COUNT];
                 for (int s = 0; s < SPHERICAL_HARMONICS_COEF_COUNT; s++)
@@ -453,6 +464,9 @@ float3 GetDiffuseIrradiance(float3 worldPos, float3 normal, float3 camPos, bool
             }
         }
         
+        if (!hasProbes) // all probes of the cell are skipped (sparse grid)
+            return probesInfo.globalIrradianceDiffuseProbeTexture.SampleLevel(linearSampler, normal, 0).rgb;
+        
         finalSum = GetTrilinearInterpolationFromNeighbourProbes(worldPos, probesInfo.distanceBetweenDiffuseProbes);
     }
     else
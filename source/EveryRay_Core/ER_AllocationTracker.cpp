@@ -0,0 +1,171 @@
+#include "stdafx.h"
+
+#include "ER_AllocationTracker.h"
+#include "ER_Utility.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace EveryRay_Core
+{
+	// plain arrays of atomics (no constructors to run), so that allocations before main() are counted safely
+	static std::atomic<std::uint64_t> sAllocationsCounts[ER_ALLOCATION_TAG_COUNT];
+	static std::atomic<std::uint64_t> sAllocatedBytes[ER_ALLOCATION_TAG_COUNT];
+	static thread_local ER_AllocationTag sThreadTag = ER_ALLOCATION_TAG_GENERAL;
+
+	ER_AllocationStats ER_AllocationTracker::sFrameStats[ER_ALLOCATION_TAG_COUNT];
+	static std::uint64_t sFrameBudgets[ER_ALLOCATION_TAG_COUNT] = {};
+	static bool sHasFrameBudget[ER_ALLOCATION_TAG_COUNT] = {}; // tags without a budget are never reported
+	static bool sIsOverFrameBudget[ER_ALLOCATION_TAG_COUNT] = {}; // of the last finished frame (to log once)
+
+	static const char* sTagNames[ER_ALLOCATION_TAG_COUNT] =
+	{
+		"General",
+		"Simulation",
+		"Rendering objects",
+		"GPU culling",
+		"GBuffer",
+		"Shadows",
+		"Light probes",
+		"Illumination",
+		"Volumetrics",
+		"Post processing",
+		"UI"
+	};
+
+	void ER_AllocationTracker::OnAllocation(size_t aSize)
+	{
+		sAllocationsCounts[sThreadTag].fetch_add(1, std::memory_order_relaxed);
+		sAllocatedBytes[sThreadTag].fetch_add(aSize, std::memory_order_relaxed);
+	}
+
+	void ER_AllocationTracker::EndFrame()
+	{
+		for (int tag = 0; tag < ER_ALLOCATION_TAG_COUNT; tag++)
+		{
+			sFrameStats[tag].allocationsCount = sAllocationsCounts[tag].exchange(0, std::memory_order_relaxed);
+			sFrameStats[tag].bytes = sAllocatedBytes[tag].exchange(0, std::memory_order_relaxed);
+		}
+
+#if ER_TRACK_ALLOCATIONS
+		for (int tag = 0; tag < ER_ALLOCATION_TAG_COUNT; tag++)
+		{
+			const bool isOverBudget = IsOverFrameBudget(static_cast<ER_AllocationTag>(tag));
+			if (isOverBudget && !sIsOverFrameBudget[tag])
+			{
+				std::string message = "[ER Logger][ER_AllocationTracker] Heap allocations budget is exceeded by '" + std::string(sTagNames[tag]) + "': " +
+					std::to_string(sFrameStats[tag].allocationsCount) + " allocations per frame (budget: " + std::to_string(sFrameBudgets[tag]) + ")" + '\n';
+				ER_OUTPUT_LOG(ER_Utility::ToWideString(message).c_str());
+			}
+			sIsOverFrameBudget[tag] = isOverBudget;
+		}
+#endif
+	}
+
+	void ER_AllocationTracker::SetFrameBudget(ER_AllocationTag aTag, std::uint64_t aAllocationsCount)
+	{
+		sFrameBudgets[aTag] = aAllocationsCount;
+		sHasFrameBudget[aTag] = true;
+	}
+
+	bool ER_AllocationTracker::IsOverFrameBudget(ER_AllocationTag aTag)
+	{
+		return sHasFrameBudget[aTag] && sFrameStats[aTag].allocationsCount > sFrameBudgets[aTag];
+	}
+
+	ER_AllocationStats ER_AllocationTracker::GetFrameTotalStats()
+	{
+		ER_AllocationStats total;
+		for (int tag = 0; tag < ER_ALLOCATION_TAG_COUNT; tag++)
+		{
+			total.allocationsCount += sFrameStats[tag].allocationsCount;
+			total.bytes += sFrameStats[tag].bytes;
+		}
+		return total;
+	}
+
+	const char* ER_AllocationTracker::GetTagName(ER_AllocationTag aTag)
+	{
+		return sTagNames[aTag];
+	}
+
+	ER_AllocationTag ER_AllocationTracker::GetThreadTag()
+	{
+		return sThreadTag;
+	}
+
+	void ER_AllocationTracker::SetThreadTag(ER_AllocationTag aTag)
+	{
+		sThreadTag = aTag;
+	}
+}
+
+#if ER_TRACK_ALLOCATIONS
+// Replacements of the global allocation functions (the other forms of new/delete forward to these)
+void* operator new(size_t aSize)
+{
+	EveryRay_Core::ER_AllocationTracker::OnAllocation(aSize);
+	for (;;)
+	{
+		if (void* pointer = std::malloc(aSize ? aSize : 1))
+			return pointer;
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void* operator new[](size_t aSize)
+{
+	return operator new(aSize);
+}
+
+void* operator new(size_t aSize, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(aSize);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](size_t aSize, const std::nothrow_t&) noexcept
+{
+	return operator new(aSize, std::nothrow);
+}
+
+void operator delete(void* aPointer) noexcept
+{
+	std::free(aPointer);
+}
+
+void operator delete[](void* aPointer) noexcept
+{
+	std::free(aPointer);
+}
+
+void operator delete(void* aPointer, size_t) noexcept
+{
+	std::free(aPointer);
+}
+
+void operator delete[](void* aPointer, size_t) noexcept
+{
+	std::free(aPointer);
+}
+
+void operator delete(void* aPointer, const std::nothrow_t&) noexcept
+{
+	std::free(aPointer);
+}
+
+void operator delete[](void* aPointer, const std::nothrow_t&) noexcept
+{
+	std::free(aPointer);
+}
+#endif
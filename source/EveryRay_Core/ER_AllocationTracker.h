@@ -0,0 +1,69 @@
+// Heap allocation tracking in EveryRay Rendering Engine
+// Global operator new is replaced (if ER_TRACK_ALLOCATIONS is enabled) and every allocation is counted for the subsystem tag of the calling thread.
+// - subsystems set their tag with ER_AllocationScope (worker threads start untagged, i.e. with ER_ALLOCATION_TAG_GENERAL)
+// - EndFrame() is called once per frame by the main thread: the counters of the frame become visible in GetFrameStats() and are zeroed,
+//   and the number of allocations per frame of a subsystem is checked against its budget (SetFrameBudget(), i.e., to catch regressions)
+// - only allocations are counted (frees do not know their size without sized deallocation)
+// - tracking is opt-in: ER_TRACK_ALLOCATIONS is defined in the project settings (Debug), other configurations keep the default operator new
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#ifndef ER_TRACK_ALLOCATIONS
+#define ER_TRACK_ALLOCATIONS 0
+#endif
+
+namespace EveryRay_Core
+{
+	enum ER_AllocationTag
+	{
+		ER_ALLOCATION_TAG_GENERAL = 0,
+		ER_ALLOCATION_TAG_SIMULATION,
+		ER_ALLOCATION_TAG_RENDERING_OBJECTS,
+		ER_ALLOCATION_TAG_GPU_CULLING,
+		ER_ALLOCATION_TAG_GBUFFER,
+		ER_ALLOCATION_TAG_SHADOWS,
+		ER_ALLOCATION_TAG_LIGHT_PROBES,
+		ER_ALLOCATION_TAG_ILLUMINATION,
+		ER_ALLOCATION_TAG_VOLUMETRICS,
+		ER_ALLOCATION_TAG_POST_PROCESSING,
+		ER_ALLOCATION_TAG_UI,
+
+		ER_ALLOCATION_TAG_COUNT
+	};
+
+	struct ER_AllocationStats
+	{
+		std::uint64_t allocationsCount = 0;
+		std::uint64_t bytes = 0;
+	};
+
+	class ER_AllocationTracker
+	{
+	public:
+		static void OnAllocation(size_t aSize);
+		static void EndFrame();
+
+		static const ER_AllocationStats& GetFrameStats(ER_AllocationTag aTag) { return sFrameStats[aTag]; }
+		// Max allocations count per frame of the tag: EndFrame() logs when it is exceeded (once, until the tag is back within the budget)
+		static void SetFrameBudget(ER_AllocationTag aTag, std::uint64_t aAllocationsCount);
+		static bool IsOverFrameBudget(ER_AllocationTag aTag);
+		static ER_AllocationStats GetFrameTotalStats();
+		static const char* GetTagName(ER_AllocationTag aTag);
+
+		static ER_AllocationTag GetThreadTag();
+		static void SetThreadTag(ER_AllocationTag aTag);
+	private:
+		static ER_AllocationStats sFrameStats[ER_ALLOCATION_TAG_COUNT]; // of the last finished frame
+	};
+
+	// Tags the heap allocations of the calling thread for the lifetime of the scope (the previous tag is restored)
+	class ER_AllocationScope
+	{
+	public:
+		ER_AllocationScope(ER_AllocationTag aTag) : mPreviousTag(ER_AllocationTracker::GetThreadTag()) { ER_AllocationTracker::SetThreadTag(aTag); }
+		~ER_AllocationScope() { ER_AllocationTracker::SetThreadTag(mPreviousTag); }
+	private:
+		ER_AllocationTag mPreviousTag;
+	};
+}
@@ -0,0 +1,404 @@
+#include "stdafx.h"
+#include "ER_CPUOcclusionCuller.h"
+#include "ER_WorkerPool.h"
+
+#include <algorithm>
+#include <cfloat>
+
+namespace EveryRay_Core
+{
+	static const int ER_OCCLUSION_CLIP_PLANES_COUNT = 5;
+	static const int ER_OCCLUSION_MAX_CLIPPED_VERTICES = 3 + ER_OCCLUSION_CLIP_PLANES_COUNT;
+
+	// Clip space: near (z >= 0), left, right, bottom, top (|x|, |y| <= w); the far plane is not needed for the depth test
+	static const XMFLOAT4 ClipPlanes[ER_OCCLUSION_CLIP_PLANES_COUNT] =
+	{
+		XMFLOAT4(0.0f, 0.0f, 1.0f, 0.0f),
+		XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f),
+		XMFLOAT4(-1.0f, 0.0f, 0.0f, 1.0f),
+		XMFLOAT4(0.0f, 1.0f, 0.0f, 1.0f),
+		XMFLOAT4(0.0f, -1.0f, 0.0f, 1.0f)
+	};
+
+	static float ClipDistance(const XMFLOAT4& aPlane, const XMFLOAT4& aVertex)
+	{
+		return aPlane.x * aVertex.x + aPlane.y * aVertex.y + aPlane.z * aVertex.z + aPlane.w * aVertex.w;
+	}
+
+	// Pixel (i.e., its center at i + 0.5) range of [aMin, aMax] along one axis; values are not smaller than -0.5 (clipped)
+	static int FirstPixel(float aMin)
+	{
+		const float value = aMin - 0.5f;
+		const int truncated = static_cast<int>(value);
+		return truncated + (value > static_cast<float>(truncated) ? 1 : 0);
+	}
+	static int LastPixel(float aMax)
+	{
+		const float value = aMax - 0.5f;
+		return value < 0.0f ? -1 : static_cast<int>(value);
+	}
+
+	ER_CPUOcclusionCuller::ER_CPUOcclusionCuller(int aWidth, int aHeight)
+		: mWidth(aWidth), mHeight(aHeight)
+	{
+		assert(mWidth > 0 && mHeight > 0 && mWidth % 4 == 0);
+
+		int width = mWidth;
+		int height = mHeight;
+		while (true)
+		{
+			mMipSizes.push_back(std::make_pair(width, height));
+			mMips.push_back(std::vector<float>(width * height, 1.0f));
+			if (width == 1 && height == 1)
+				break;
+			width = std::max(1, (width + 1) / 2);
+			height = std::max(1, (height + 1) / 2);
+		}
+		XMStoreFloat4x4(&mViewProjection, XMMatrixIdentity());
+	}
+
+	void ER_CPUOcclusionCuller::BeginFrame(const XMMATRIX& aViewProjection)
+	{
+		XMStoreFloat4x4(&mViewProjection, aViewProjection);
+		std::fill(mMips[0].begin(), mMips[0].end(), 1.0f);
+		mClipVertices.clear();
+		mScreenVertices.clear();
+		mOutsideMasks.clear();
+		mClipIndices.clear();
+		mStats = ER_CPUOcclusionCullerStats();
+		mIsReady = false;
+	}
+
+	void ER_CPUOcclusionCuller::AddOccluder(const std::vector<XMFLOAT3>& aVertices, const std::vector<UINT>& aIndices, const XMMATRIX& aWorld)
+	{
+		if (aVertices.empty() || aIndices.size() < 3)
+			return;
+
+		const XMMATRIX worldViewProjection = XMMatrixMultiply(aWorld, XMLoadFloat4x4(&mViewProjection));
+		const UINT baseVertex = static_cast<UINT>(mClipVertices.size());
+		mClipVertices.resize(baseVertex + aVertices.size());
+		mScreenVertices.resize(baseVertex + aVertices.size());
+		mOutsideMasks.resize(baseVertex + aVertices.size());
+		for (size_t i = baseVertex; i < mClipVertices.size(); i++)
+		{
+			XMStoreFloat4(&mClipVertices[i], XMVector3Transform(XMLoadFloat3(&aVertices[i - baseVertex]), worldViewProjection));
+
+			UINT outsideMask = 0;
+			for (int plane = 0; plane < ER_OCCLUSION_CLIP_PLANES_COUNT; plane++)
+			{
+				if (ClipDistance(ClipPlanes[plane], mClipVertices[i]) < 0.0f)
+					outsideMask |= (1 << plane);
+			}
+			mOutsideMasks[i] = outsideMask;
+			if (!outsideMask)
+				mScreenVertices[i] = ToScreen(mClipVertices[i]);
+		}
+
+		const size_t baseIndex = mClipIndices.size();
+		mClipIndices.resize(baseIndex + aIndices.size() - aIndices.size() % 3);
+		for (size_t i = baseIndex; i < mClipIndices.size(); i++)
+		{
+			assert(aIndices[i - baseIndex] < aVertices.size());
+			mClipIndices[i] = baseVertex + aIndices[i - baseIndex];
+		}
+		mStats.occludersCount++;
+	}
+
+	void ER_CPUOcclusionCuller::Rasterize(ER_WorkerPool* aWorkerPool)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		const int sourceTrianglesCount = static_cast<int>(mClipIndices.size() / 3);
+		const int maxThreadsCount = aWorkerPool ? aWorkerPool->GetWorkersCount() + 1 : 1;
+		const int threadsCount = std::max(1, std::min(std::min(maxThreadsCount, sourceTrianglesCount / ER_OCCLUSION_MIN_TRIANGLES_PER_THREAD), mHeight));
+		mTriangles.resize(threadsCount);
+		for (auto& triangles : mTriangles)
+			triangles.clear();
+
+		if (threadsCount == 1)
+		{
+			SetupTriangles(0, sourceTrianglesCount, mTriangles[0]);
+			RasterizeBand(0, mHeight);
+		}
+		else
+		{
+			// every job sets up its own range of triangles...
+			const int trianglesPerThread = (sourceTrianglesCount + threadsCount - 1) / threadsCount;
+			aWorkerPool->ParallelFor(threadsCount, [this, sourceTrianglesCount, trianglesPerThread](int i)
+			{
+				const size_t begin = static_cast<size_t>(std::min(sourceTrianglesCount, i * trianglesPerThread));
+				const size_t end = static_cast<size_t>(std::min(sourceTrianglesCount, (i + 1) * trianglesPerThread));
+				SetupTriangles(begin, end, mTriangles[i]);
+			});
+
+			// ...and then rasterizes all triangles into its own rows of the depth buffer
+			const int rowsPerThread = (mHeight + threadsCount - 1) / threadsCount;
+			const int bandsCount = (mHeight + rowsPerThread - 1) / rowsPerThread;
+			aWorkerPool->ParallelFor(bandsCount, [this, rowsPerThread](int aBand)
+			{
+				const int rowBegin = aBand * rowsPerThread;
+				RasterizeBand(rowBegin, std::min(mHeight, rowBegin + rowsPerThread));
+			});
+		}
+
+		BuildHiZ();
+		mIsReady = true;
+
+		for (const auto& triangles : mTriangles)
+			mStats.trianglesCount += static_cast<UINT>(triangles.size());
+		mStats.rasterizationThreadsCount = static_cast<UINT>(threadsCount);
+		mStats.rasterizationTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	}
+
+	void ER_CPUOcclusionCuller::SetupTriangles(size_t aBegin, size_t aEnd, std::vector<Triangle>& aTriangles) const
+	{
+		XMFLOAT4 clipVertices[3];
+		for (size_t triangle = aBegin; triangle < aEnd; triangle++)
+		{
+			const UINT* indices = &mClipIndices[triangle * 3];
+			const UINT outsideMask0 = mOutsideMasks[indices[0]];
+			const UINT outsideMask1 = mOutsideMasks[indices[1]];
+			const UINT outsideMask2 = mOutsideMasks[indices[2]];
+			if (outsideMask0 & outsideMask1 & outsideMask2) // all vertices are outside of one plane
+				continue;
+
+			const UINT clipMask = outsideMask0 | outsideMask1 | outsideMask2;
+			if (!clipMask)
+				SetupScreenTriangle(mScreenVertices[indices[0]], mScreenVertices[indices[1]], mScreenVertices[indices[2]], aTriangles);
+			else
+			{
+				clipVertices[0] = mClipVertices[indices[0]];
+				clipVertices[1] = mClipVertices[indices[1]];
+				clipVertices[2] = mClipVertices[indices[2]];
+				SetupClippedTriangle(clipVertices, clipMask, aTriangles);
+			}
+		}
+	}
+
+	XMFLOAT3 ER_CPUOcclusionCuller::ToScreen(const XMFLOAT4& aClipVertex) const
+	{
+		const float invW = 1.0f / aClipVertex.w;
+		return XMFLOAT3(
+			(aClipVertex.x * invW * 0.5f + 0.5f) * static_cast<float>(mWidth),
+			(0.5f - aClipVertex.y * invW * 0.5f) * static_cast<float>(mHeight),
+			aClipVertex.z * invW);
+	}
+
+	// Clips the triangle by the planes of 'aClipMask' (Sutherland-Hodgman) and sets up the resulting triangle fan
+	void ER_CPUOcclusionCuller::SetupClippedTriangle(const XMFLOAT4* aClipVertices, UINT aClipMask, std::vector<Triangle>& aTriangles) const
+	{
+		XMFLOAT4 polygons[2][ER_OCCLUSION_MAX_CLIPPED_VERTICES];
+		int verticesCount = 3;
+		int current = 0;
+		for (int vertex = 0; vertex < 3; vertex++)
+			polygons[current][vertex] = aClipVertices[vertex];
+
+		for (int plane = 0; plane < ER_OCCLUSION_CLIP_PLANES_COUNT && verticesCount >= 3; plane++)
+		{
+			if (!(aClipMask & (1 << plane)))
+				continue;
+
+			const XMFLOAT4* input = polygons[current];
+			XMFLOAT4* output = polygons[1 - current];
+			int outputCount = 0;
+			for (int vertex = 0; vertex < verticesCount; vertex++)
+			{
+				const XMFLOAT4& a = input[vertex];
+				const XMFLOAT4& b = input[(vertex + 1) % verticesCount];
+				const float distanceA = ClipDistance(ClipPlanes[plane], a);
+				const float distanceB = ClipDistance(ClipPlanes[plane], b);
+				if (distanceA >= 0.0f)
+					output[outputCount++] = a;
+				if ((distanceA >= 0.0f) != (distanceB >= 0.0f))
+				{
+					const float t = distanceA / (distanceA - distanceB);
+					output[outputCount++] = XMFLOAT4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t);
+				}
+			}
+			verticesCount = outputCount;
+			current = 1 - current;
+		}
+		if (verticesCount < 3)
+			return;
+
+		XMFLOAT3 screenVertices[ER_OCCLUSION_MAX_CLIPPED_VERTICES];
+		for (int vertex = 0; vertex < verticesCount; vertex++)
+		{
+			if (polygons[current][vertex].w <= 0.0f)
+				return;
+			screenVertices[vertex] = ToScreen(polygons[current][vertex]);
+		}
+		for (int vertex = 1; vertex + 1 < verticesCount; vertex++)
+			SetupScreenTriangle(screenVertices[0], screenVertices[vertex], screenVertices[vertex + 1], aTriangles);
+	}
+
+	// Keeps the triangles that cover pixel centers (the vertices are inside of the screen)
+	void ER_CPUOcclusionCuller::SetupScreenTriangle(const XMFLOAT3& aV0, const XMFLOAT3& aV1, const XMFLOAT3& aV2, std::vector<Triangle>& aTriangles) const
+	{
+		Triangle triangle;
+		triangle.xStart = std::max(0, FirstPixel(std::min(aV0.x, std::min(aV1.x, aV2.x))));
+		triangle.xEnd = std::min(mWidth - 1, LastPixel(std::max(aV0.x, std::max(aV1.x, aV2.x))));
+		if (triangle.xStart > triangle.xEnd)
+			return;
+		triangle.yStart = std::max(0, FirstPixel(std::min(aV0.y, std::min(aV1.y, aV2.y))));
+		triangle.yEnd = std::min(mHeight - 1, LastPixel(std::max(aV0.y, std::max(aV1.y, aV2.y))));
+		if (triangle.yStart > triangle.yEnd)
+			return;
+
+		// counter-clockwise in pixels, so that the edge functions are positive inside
+		const bool isCounterClockwise = (aV1.x - aV0.x) * (aV2.y - aV0.y) - (aV1.y - aV0.y) * (aV2.x - aV0.x) > 0.0f;
+		const XMFLOAT3& v0 = aV0;
+		const XMFLOAT3& v1 = isCounterClockwise ? aV1 : aV2;
+		const XMFLOAT3& v2 = isCounterClockwise ? aV2 : aV1;
+
+		// E01 / area, E12 / area and E20 / area are the barycentrics of v2, v0 and v1
+		const XMFLOAT3* edgeVertices[4] = { &v0, &v1, &v2, &v0 };
+		for (int edge = 0; edge < 3; edge++)
+		{
+			const XMFLOAT3& a = *edgeVertices[edge];
+			const XMFLOAT3& b = *edgeVertices[edge + 1];
+			triangle.edgeA[edge] = a.y - b.y;
+			triangle.edgeB[edge] = b.x - a.x;
+			triangle.edgeC[edge] = a.x * b.y - a.y * b.x;
+		}
+		const float area = triangle.edgeC[0] + triangle.edgeC[1] + triangle.edgeC[2];
+		if (area <= 0.0f)
+			return;
+
+		const float invArea = 1.0f / area;
+		triangle.depthA = (triangle.edgeA[1] * v0.z + triangle.edgeA[2] * v1.z + triangle.edgeA[0] * v2.z) * invArea;
+		triangle.depthB = (triangle.edgeB[1] * v0.z + triangle.edgeB[2] * v1.z + triangle.edgeB[0] * v2.z) * invArea;
+		triangle.depthC = (triangle.edgeC[1] * v0.z + triangle.edgeC[2] * v1.z + triangle.edgeC[0] * v2.z) * invArea;
+		aTriangles.push_back(triangle);
+	}
+
+	// Half-space rasterization of all triangles into the rows [aRowBegin, aRowEnd), 4 pixels of a row at a time
+	void ER_CPUOcclusionCuller::RasterizeBand(int aRowBegin, int aRowEnd)
+	{
+		std::vector<float>& depth = mMips[0];
+		const XMVECTOR pixelCenterOffsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+		const XMVECTOR zero = XMVectorZero();
+
+		for (const auto& triangles : mTriangles)
+		{
+			for (const Triangle& triangle : triangles)
+			{
+				const int yStart = std::max(aRowBegin, triangle.yStart);
+				const int yEnd = std::min(aRowEnd - 1, triangle.yEnd);
+				if (yStart > yEnd)
+					continue;
+
+				const XMVECTOR edgeA0 = XMVectorReplicate(triangle.edgeA[0]);
+				const XMVECTOR edgeA1 = XMVectorReplicate(triangle.edgeA[1]);
+				const XMVECTOR edgeA2 = XMVectorReplicate(triangle.edgeA[2]);
+				const XMVECTOR depthA = XMVectorReplicate(triangle.depthA);
+				const XMVECTOR columnsBegin = XMVectorReplicate(static_cast<float>(triangle.xStart) + 0.5f);
+				const XMVECTOR columnsEnd = XMVectorReplicate(static_cast<float>(triangle.xEnd) + 0.5f);
+
+				for (int y = yStart; y <= yEnd; y++)
+				{
+					const float pixelY = static_cast<float>(y) + 0.5f;
+					const XMVECTOR edgeRow0 = XMVectorReplicate(triangle.edgeB[0] * pixelY + triangle.edgeC[0]);
+					const XMVECTOR edgeRow1 = XMVectorReplicate(triangle.edgeB[1] * pixelY + triangle.edgeC[1]);
+					const XMVECTOR edgeRow2 = XMVectorReplicate(triangle.edgeB[2] * pixelY + triangle.edgeC[2]);
+					const XMVECTOR depthRow = XMVectorReplicate(triangle.depthB * pixelY + triangle.depthC);
+
+					float* row = &depth[y * mWidth];
+					for (int x = triangle.xStart & ~3; x <= triangle.xEnd; x += 4)
+					{
+						const XMVECTOR pixelX = XMVectorAdd(XMVectorReplicate(static_cast<float>(x)), pixelCenterOffsets);
+
+						XMVECTOR inside = XMVectorAndInt(XMVectorGreaterOrEqual(pixelX, columnsBegin), XMVectorLessOrEqual(pixelX, columnsEnd));
+						inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeA0, pixelX, edgeRow0), zero));
+						inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeA1, pixelX, edgeRow1), zero));
+						inside = XMVectorAndInt(inside, XMVectorGreaterOrEqual(XMVectorMultiplyAdd(edgeA2, pixelX, edgeRow2), zero));
+						if (XMVector4EqualInt(inside, XMVectorFalseInt()))
+							continue;
+
+						const XMVECTOR pixelDepth = XMVectorMultiplyAdd(depthA, pixelX, depthRow);
+						const XMVECTOR currentDepth = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&row[x]));
+						XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&row[x]), XMVectorSelect(currentDepth, XMVectorMin(currentDepth, pixelDepth), inside));
+					}
+				}
+			}
+		}
+	}
+
+	// Every texel of a mip is the farthest depth of its (up to) 2x2 texels of the previous mip
+	void ER_CPUOcclusionCuller::BuildHiZ()
+	{
+		for (int mip = 1; mip < GetMipCount(); mip++)
+		{
+			const std::vector<float>& source = mMips[mip - 1];
+			const int sourceWidth = mMipSizes[mip - 1].first;
+			const int sourceHeight = mMipSizes[mip - 1].second;
+			std::vector<float>& destination = mMips[mip];
+			const int width = mMipSizes[mip].first;
+			const int height = mMipSizes[mip].second;
+
+			for (int y = 0; y < height; y++)
+			{
+				const int y0 = 2 * y;
+				const int y1 = std::min(2 * y + 1, sourceHeight - 1);
+				for (int x = 0; x < width; x++)
+				{
+					const int x0 = 2 * x;
+					const int x1 = std::min(2 * x + 1, sourceWidth - 1);
+					destination[y * width + x] = std::max(
+						std::max(source[y0 * sourceWidth + x0], source[y0 * sourceWidth + x1]),
+						std::max(source[y1 * sourceWidth + x0], source[y1 * sourceWidth + x1]));
+				}
+			}
+		}
+	}
+
+	// The nearest depth of the box is compared with the farthest depths of the (at most 2x2) texels of the mip that covers its screen rectangle
+	bool ER_CPUOcclusionCuller::IsOccluded(const ER_AABB& aAABB) const
+	{
+		if (!mIsReady)
+			return false;
+
+		const XMMATRIX viewProjection = XMLoadFloat4x4(&mViewProjection);
+		float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX;
+		float maxX = -FLT_MAX, maxY = -FLT_MAX;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			const XMVECTOR position = XMVectorSet(
+				(corner & 1) ? aAABB.second.x : aAABB.first.x,
+				(corner & 2) ? aAABB.second.y : aAABB.first.y,
+				(corner & 4) ? aAABB.second.z : aAABB.first.z, 1.0f);
+			XMFLOAT4 clipPosition;
+			XMStoreFloat4(&clipPosition, XMVector4Transform(position, viewProjection));
+			if (clipPosition.z < 0.0f || clipPosition.w <= 0.0f) // crosses the near plane
+				return false;
+
+			const float invW = 1.0f / clipPosition.w;
+			const float x = (clipPosition.x * invW * 0.5f + 0.5f) * static_cast<float>(mWidth);
+			const float y = (0.5f - clipPosition.y * invW * 0.5f) * static_cast<float>(mHeight);
+			minX = std::min(minX, x); maxX = std::max(maxX, x);
+			minY = std::min(minY, y); maxY = std::max(maxY, y);
+			minZ = std::min(minZ, clipPosition.z * invW);
+		}
+		if (maxX < 0.0f || maxY < 0.0f || minX > static_cast<float>(mWidth) || minY > static_cast<float>(mHeight))
+			return false;
+
+		const int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+		const int x1 = std::min(mWidth - 1, static_cast<int>(std::floor(maxX)));
+		const int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+		const int y1 = std::min(mHeight - 1, static_cast<int>(std::floor(maxY)));
+
+		int mip = 0;
+		while (mip < GetMipCount() - 1 && ((x1 >> mip) - (x0 >> mip) > 1 || (y1 >> mip) - (y0 >> mip) > 1))
+			mip++;
+
+		for (int y = y0 >> mip; y <= (y1 >> mip); y++)
+		{
+			for (int x = x0 >> mip; x <= (x1 >> mip); x++)
+			{
+				if (minZ <= GetDepth(x, y, mip))
+					return false;
+			}
+		}
+		return true;
+	}
+}
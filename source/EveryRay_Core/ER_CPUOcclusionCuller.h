@@ -0,0 +1,78 @@
+// CPU occlusion culling in EveryRay Rendering Engine
+// A small set of occluders (dedicated low-poly proxies or the lowest LODs of the marked objects) is rasterized into a low-resolution depth buffer
+// and AABBs are tested against its hierarchical-Z (every texel of a mip stores the farthest depth of the texels below it).
+// - occluder triangles are clipped by the frustum and set up in parallel, then rasterized in horizontal bands (one job of the worker pool per band), 4 pixels at a time (SIMD)
+// - AABBs that cross the near plane or are outside of the screen are never occluded (frustum culling is a separate step)
+// - IsOccluded() only reads the buffers, so it can be called from many threads once Rasterize() is done
+// - no RHI is used, so the whole thing can be tested on the CPU (see GetDepth())
+#pragma once
+#include "Common.h"
+
+#define ER_OCCLUSION_DEPTH_WIDTH 256 // has to be a multiple of 4
+#define ER_OCCLUSION_DEPTH_HEIGHT 128
+#define ER_OCCLUSION_MIN_TRIANGLES_PER_THREAD 4096 // Rasterize() is split between threads only for bigger workloads
+
+namespace EveryRay_Core
+{
+	class ER_WorkerPool;
+
+	struct ER_CPUOcclusionCullerStats
+	{
+		UINT occludersCount = 0;
+		UINT trianglesCount = 0; // after clipping and rejection of the triangles that do not cover any pixel
+		UINT rasterizationThreadsCount = 0;
+		double rasterizationTimeMs = 0.0;
+	};
+
+	class ER_CPUOcclusionCuller
+	{
+	public:
+		ER_CPUOcclusionCuller(int aWidth = ER_OCCLUSION_DEPTH_WIDTH, int aHeight = ER_OCCLUSION_DEPTH_HEIGHT);
+		~ER_CPUOcclusionCuller() {}
+
+		void BeginFrame(const XMMATRIX& aViewProjection);
+		// Triangle list in local space (transformed by 'aWorld')
+		void AddOccluder(const std::vector<XMFLOAT3>& aVertices, const std::vector<UINT>& aIndices, const XMMATRIX& aWorld);
+		// Sets up and rasterizes the triangles of the occluders, then builds the hierarchical-Z (single-threaded without 'aWorkerPool')
+		void Rasterize(ER_WorkerPool* aWorkerPool = nullptr);
+
+		bool IsOccluded(const ER_AABB& aAABB) const;
+
+		bool IsReady() const { return mIsReady; }
+		float GetDepth(int aX, int aY, int aMip = 0) const { return mMips[aMip][aY * mMipSizes[aMip].first + aX]; }
+		int GetWidth(int aMip = 0) const { return mMipSizes[aMip].first; }
+		int GetHeight(int aMip = 0) const { return mMipSizes[aMip].second; }
+		int GetMipCount() const { return static_cast<int>(mMips.size()); }
+
+		const ER_CPUOcclusionCullerStats& GetStats() const { return mStats; }
+	private:
+		// Screen-space triangle ready for rasterization (pixel bounds, edge functions and depth plane)
+		struct Triangle
+		{
+			float edgeA[3], edgeB[3], edgeC[3]; // E(x, y) = A * x + B * y + C, positive inside
+			float depthA, depthB, depthC; // Z(x, y) = A * x + B * y + C
+			int xStart, xEnd, yStart, yEnd; // pixels with centers inside of the bounds
+		};
+
+		void SetupTriangles(size_t aBegin, size_t aEnd, std::vector<Triangle>& aTriangles) const;
+		void SetupClippedTriangle(const XMFLOAT4* aClipVertices, UINT aClipMask, std::vector<Triangle>& aTriangles) const;
+		void SetupScreenTriangle(const XMFLOAT3& aV0, const XMFLOAT3& aV1, const XMFLOAT3& aV2, std::vector<Triangle>& aTriangles) const;
+		XMFLOAT3 ToScreen(const XMFLOAT4& aClipVertex) const;
+		void RasterizeBand(int aRowBegin, int aRowEnd);
+		void BuildHiZ();
+
+		std::vector<std::vector<float>> mMips; // #0 is the depth buffer
+		std::vector<std::pair<int, int>> mMipSizes;
+		std::vector<XMFLOAT4> mClipVertices; // of all occluders
+		std::vector<XMFLOAT3> mScreenVertices; // only valid for the vertices inside of the frustum
+		std::vector<UINT> mOutsideMasks; // frustum planes that the vertices are outside of
+		std::vector<UINT> mClipIndices;
+		std::vector<std::vector<Triangle>> mTriangles; // per setup thread
+
+		ER_CPUOcclusionCullerStats mStats;
+		XMFLOAT4X4 mViewProjection;
+		int mWidth = 0;
+		int mHeight = 0;
+		bool mIsReady = false;
+	};
+}
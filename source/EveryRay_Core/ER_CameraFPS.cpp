@@ -58,9 +58,9 @@ namespace EveryRay_Core
 
 	void ER_CameraFPS::Initialize()
 	{
-		mKeyboard = (ER_Keyboard*)mCore->GetServices().FindService(ER_Keyboard::TypeIdClass());
-		mMouse = (ER_Mouse*)mCore->GetServices().FindService(ER_Mouse::TypeIdClass());
-		mGamepad = (ER_Gamepad*)mCore->GetServices().FindService(ER_Gamepad::TypeIdClass());
+		mKeyboard = mCore->GetServices().FindService<ER_Keyboard>();
+		mMouse = mCore->GetServices().FindService<ER_Mouse>();
+		mGamepad = mCore->GetServices().FindService<ER_Gamepad>();
 
 		ER_Camera::Initialize();
 	}
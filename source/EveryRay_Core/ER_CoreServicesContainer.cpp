@@ -5,7 +5,7 @@
 namespace EveryRay_Core
 {
 	ER_CoreServicesContainer::ER_CoreServicesContainer()
-		: mServices()
+		: mCoreServices(), mServices()
 	{
 	}
 
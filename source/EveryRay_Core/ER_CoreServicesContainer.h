@@ -1,14 +1,74 @@
 #pragma once
 
 #include "Common.h"
+#include <array>
 
 namespace EveryRay_Core
 {
+	class ER_Keyboard;
+	class ER_Mouse;
+	class ER_Gamepad;
+	class ER_Camera;
+	class ER_Editor;
+	class ER_QuadRenderer;
+	class ER_TextureStreamer;
+
+	template<typename... Types>
+	struct ER_ServiceTypeList
+	{
+		static constexpr UINT Count = sizeof...(Types);
+	};
+
+	// Core services get dense indices at compile time (their position in the list), so typed lookups are just array reads.
+	// Add new core services here; other types can still use the untyped (RTTI id) API.
+	using ER_CoreServiceTypes = ER_ServiceTypeList<ER_Keyboard, ER_Mouse, ER_Gamepad, ER_Camera, ER_Editor, ER_QuadRenderer, ER_TextureStreamer>;
+
+	template<typename T>
+	struct ER_ServiceTypeNotRegistered : std::false_type {};
+
+	template<typename T, typename List>
+	struct ER_ServiceTypeIndex;
+	template<typename T>
+	struct ER_ServiceTypeIndex<T, ER_ServiceTypeList<>>
+	{
+		static_assert(ER_ServiceTypeNotRegistered<T>::value, "Service type is not in ER_CoreServiceTypes");
+		static constexpr UINT Value = 0;
+	};
+	template<typename T, typename... Rest>
+	struct ER_ServiceTypeIndex<T, ER_ServiceTypeList<T, Rest...>>
+	{
+		static constexpr UINT Value = 0;
+	};
+	template<typename T, typename Other, typename... Rest>
+	struct ER_ServiceTypeIndex<T, ER_ServiceTypeList<Other, Rest...>>
+	{
+		static constexpr UINT Value = 1 + ER_ServiceTypeIndex<T, ER_ServiceTypeList<Rest...>>::Value;
+	};
+
 	class ER_CoreServicesContainer
 	{
 	public:
 		ER_CoreServicesContainer();
 
+		// Typed API (core services only). The service is also registered by its RTTI id, so the untyped API finds it too.
+		template<typename T>
+		void AddService(T* service)
+		{
+			mCoreServices[ER_ServiceTypeIndex<T, ER_CoreServiceTypes>::Value] = service;
+			AddService(T::TypeIdClass(), service);
+		}
+		template<typename T>
+		void RemoveService()
+		{
+			mCoreServices[ER_ServiceTypeIndex<T, ER_CoreServiceTypes>::Value] = nullptr;
+			RemoveService(T::TypeIdClass());
+		}
+		template<typename T>
+		T* FindService() const
+		{
+			return static_cast<T*>(mCoreServices[ER_ServiceTypeIndex<T, ER_CoreServiceTypes>::Value]);
+		}
+
 		void AddService(UINT typeID, void* service);
 		void RemoveService(UINT typeID);
 		void* FindService(UINT typeID) const;
@@ -17,6 +77,7 @@ namespace EveryRay_Core
 		ER_CoreServicesContainer(const ER_CoreServicesContainer& rhs);
 		ER_CoreServicesContainer& operator=(const ER_CoreServicesContainer& rhs);
 
+		std::array<void*, ER_CoreServiceTypes::Count> mCoreServices;
 		std::map<UINT, void*> mServices;
 	};
 }
\ No newline at end of file
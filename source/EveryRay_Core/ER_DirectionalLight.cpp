@@ -32,7 +32,7 @@ namespace EveryRay_Core
 	{
 		DeleteObject(mProxyModel);
 
-		RotationUpdateEvent->RemoveAllListeners();
+		RotationUpdateEvent->UnsubscribeAll();
 		DeleteObject(RotationUpdateEvent);
 	}
 
@@ -124,8 +124,7 @@ namespace EveryRay_Core
 		if (mProxyModel)
 			mProxyModel->ApplyTransform(transformMatrix);
 
-		for (auto listener : RotationUpdateEvent->GetListeners())
-			listener();
+		RotationUpdateEvent->Notify();
 	}
 
 	void ER_DirectionalLight::DrawProxyModel(ER_RHI_GPUTexture* aRenderTarget, ER_RHI_GPUTexture* aDepth, const ER_CoreTime & time, ER_RHI_GPURootSignature* rs)
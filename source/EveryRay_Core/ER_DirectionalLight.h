@@ -3,7 +3,7 @@
 #include "Common.h"
 #include "ER_Light.h"
 #include "ER_DebugProxyObject.h"
-#include "ER_GenericEvent.h"
+#include "ER_Event.h"
 
 #include "RHI/ER_RHI.h"
 
@@ -13,7 +13,7 @@ namespace EveryRay_Core
 	{
 		RTTI_DECLARATIONS(ER_DirectionalLight, ER_Light)
 		
-		using Delegate_RotationUpdate = std::function<void()>; 
+		using Delegate_RotationUpdate = void(); 
 
 	public:
 		ER_DirectionalLight(ER_Core& game);
@@ -55,7 +55,7 @@ namespace EveryRay_Core
 
 		float GetDirectionalLightIntensity() const { return mDirectionalLightIntensity; }
 
-		ER_GenericEvent<Delegate_RotationUpdate>* RotationUpdateEvent = new ER_GenericEvent<Delegate_RotationUpdate>();
+		ER_Event<Delegate_RotationUpdate>* RotationUpdateEvent = new ER_Event<Delegate_RotationUpdate>();
 
 	protected:
 		XMFLOAT3 mDirection;
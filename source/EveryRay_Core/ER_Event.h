@@ -0,0 +1,358 @@
+// Typed event system in EveryRay Rendering Engine
+// - listeners are stored in small-buffer delegates (no heap allocations for callables up to ER_DELEGATE_INLINE_SIZE bytes)
+// - Subscribe() returns a handle, listeners can also be named (and notified by their names)
+// - Notify() iterates the listeners in place (no copies); unsubscribing during Notify() is safe, even for the listener that is being called
+//   (its slot is released after the dispatch), listeners subscribed during Notify() are called from the next dispatch
+// - Post() can be called from any thread: arguments are queued and notified in DispatchDeferred() on the thread that owns the event
+
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "ER_CoreException.h"
+
+#define ER_DELEGATE_INLINE_SIZE 64 // bigger callables are stored on the heap
+
+namespace EveryRay_Core
+{
+	template<typename Signature, size_t InlineSize = ER_DELEGATE_INLINE_SIZE>
+	class ER_Delegate;
+
+	template<typename R, typename... Args, size_t InlineSize>
+	class ER_Delegate<R(Args...), InlineSize>
+	{
+	public:
+		ER_Delegate() {}
+		template<typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, ER_Delegate>::value>::type>
+		ER_Delegate(F&& aCallable)
+		{
+			using Callable = typename std::decay<F>::type;
+			Assign<Callable>(std::forward<F>(aCallable), std::integral_constant<bool, IsStoredInline<Callable>()>());
+		}
+		ER_Delegate(ER_Delegate&& aOther) noexcept { MoveFrom(aOther); }
+		ER_Delegate& operator=(ER_Delegate&& aOther) noexcept
+		{
+			if (this != &aOther)
+			{
+				Reset();
+				MoveFrom(aOther);
+			}
+			return *this;
+		}
+		ER_Delegate(const ER_Delegate&) = delete;
+		ER_Delegate& operator=(const ER_Delegate&) = delete;
+		~ER_Delegate() { Reset(); }
+
+		R operator()(Args... aArgs)
+		{
+			assert(mInvoke);
+			return mInvoke(mStorage, std::forward<Args>(aArgs)...);
+		}
+		explicit operator bool() const { return mInvoke != nullptr; }
+		bool IsInline() const { return mIsInline; }
+
+		void Reset()
+		{
+			if (mManage)
+				mManage(Operation::Destroy, nullptr, mStorage);
+			mInvoke = nullptr;
+			mManage = nullptr;
+			mIsInline = true;
+		}
+
+	private:
+		enum class Operation { Move, Destroy };
+
+		template<typename Callable>
+		static constexpr bool IsStoredInline()
+		{
+			return sizeof(Callable) <= InlineSize && alignof(Callable) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<Callable>::value;
+		}
+
+		template<typename Callable, typename F>
+		void Assign(F&& aCallable, std::true_type /*inline*/)
+		{
+			new (mStorage) Callable(std::forward<F>(aCallable));
+			mInvoke = [](void* aStorage, Args&&... aArgs) -> R { return (*static_cast<Callable*>(aStorage))(std::forward<Args>(aArgs)...); };
+			mManage = [](Operation aOperation, void* aDst, void* aSrc)
+			{
+				Callable* src = static_cast<Callable*>(aSrc);
+				if (aOperation == Operation::Move)
+					new (aDst) Callable(std::move(*src));
+				src->~Callable();
+			};
+			mIsInline = true;
+		}
+		template<typename Callable, typename F>
+		void Assign(F&& aCallable, std::false_type /*heap*/)
+		{
+			*reinterpret_cast<Callable**>(mStorage) = new Callable(std::forward<F>(aCallable));
+			mInvoke = [](void* aStorage, Args&&... aArgs) -> R { return (**static_cast<Callable**>(aStorage))(std::forward<Args>(aArgs)...); };
+			mManage = [](Operation aOperation, void* aDst, void* aSrc)
+			{
+				Callable** src = static_cast<Callable**>(aSrc);
+				if (aOperation == Operation::Move)
+					*static_cast<Callable**>(aDst) = *src;
+				else
+					delete *src;
+				*src = nullptr;
+			};
+			mIsInline = false;
+		}
+
+		void MoveFrom(ER_Delegate& aOther)
+		{
+			if (aOther.mManage)
+				aOther.mManage(Operation::Move, mStorage, aOther.mStorage);
+			mInvoke = aOther.mInvoke;
+			mManage = aOther.mManage;
+			mIsInline = aOther.mIsInline;
+			aOther.mInvoke = nullptr;
+			aOther.mManage = nullptr;
+			aOther.mIsInline = true;
+		}
+
+		alignas(std::max_align_t) unsigned char mStorage[InlineSize < sizeof(void*) ? sizeof(void*) : InlineSize];
+		R (*mInvoke)(void*, Args&&...) = nullptr;
+		void (*mManage)(Operation, void*, void*) = nullptr;
+		bool mIsInline = true;
+	};
+
+	struct ER_EventHandle
+	{
+		std::uint32_t index = UINT32_MAX;
+		std::uint32_t generation = 0;
+
+		bool IsValid() const { return index != UINT32_MAX; }
+	};
+
+	template<typename Signature>
+	class ER_Event;
+
+	template<typename... Args>
+	class ER_Event<void(Args...)>
+	{
+	public:
+		using Delegate = ER_Delegate<void(Args...)>;
+
+		ER_Event() {}
+		ER_Event(const ER_Event&) = delete;
+		ER_Event& operator=(const ER_Event&) = delete;
+		~ER_Event() { assert(mDispatchDepth == 0); }
+
+		template<typename F>
+		ER_EventHandle Subscribe(F&& aListener)
+		{
+			const std::uint32_t index = AllocateSlot();
+			Slot& slot = mSlots[index];
+			slot.listener = Delegate(std::forward<F>(aListener));
+			slot.serial = ++mSerial;
+			slot.isActive = true;
+
+			ER_EventHandle handle;
+			handle.index = index;
+			handle.generation = slot.generation;
+			return handle;
+		}
+		// Does nothing if a listener with that name already exists (its handle is returned)
+		template<typename F>
+		ER_EventHandle Subscribe(const std::string& aName, F&& aListener)
+		{
+			auto it = mNamedHandles.find(aName);
+			if (it != mNamedHandles.end())
+				return it->second;
+
+			ER_EventHandle handle = Subscribe(std::forward<F>(aListener));
+			mNamedHandles.emplace(aName, handle);
+			return handle;
+		}
+
+		bool Unsubscribe(ER_EventHandle aHandle)
+		{
+			if (!IsSubscribed(aHandle))
+				return false;
+
+			for (auto it = mNamedHandles.begin(); it != mNamedHandles.end(); ++it)
+			{
+				if (it->second.index == aHandle.index)
+				{
+					mNamedHandles.erase(it);
+					break;
+				}
+			}
+			RemoveSlot(aHandle.index);
+			return true;
+		}
+		bool Unsubscribe(const std::string& aName)
+		{
+			auto it = mNamedHandles.find(aName);
+			if (it == mNamedHandles.end())
+				return false;
+
+			const std::uint32_t index = it->second.index;
+			mNamedHandles.erase(it);
+			RemoveSlot(index);
+			return true;
+		}
+		void UnsubscribeAll()
+		{
+			mNamedHandles.clear();
+			for (std::uint32_t index = 0; index < static_cast<std::uint32_t>(mSlots.size()); index++)
+			{
+				if (mSlots[index].isActive)
+					RemoveSlot(index);
+			}
+		}
+
+		bool IsSubscribed(ER_EventHandle aHandle) const
+		{
+			return aHandle.IsValid() && aHandle.index < mSlots.size() && mSlots[aHandle.index].isActive && mSlots[aHandle.index].generation == aHandle.generation;
+		}
+		ER_EventHandle Find(const std::string& aName) const
+		{
+			auto it = mNamedHandles.find(aName);
+			return (it != mNamedHandles.end()) ? it->second : ER_EventHandle();
+		}
+		size_t GetListenersCount() const { return mListenersCount; }
+
+		// Calls all listeners (in an unspecified order)
+		void Notify(Args... aArgs)
+		{
+			DispatchScope scope(*this);
+			const std::uint64_t lastSerial = mSerial;
+			const size_t slotsCount = mSlots.size();
+			for (size_t index = 0; index < slotsCount; index++)
+			{
+				Slot& slot = mSlots[index];
+				if (slot.isActive && slot.serial <= lastSerial)
+					slot.listener(aArgs...);
+			}
+		}
+		// Calls one listener; returns false if it does not exist
+		bool Notify(ER_EventHandle aHandle, Args... aArgs)
+		{
+			if (!IsSubscribed(aHandle))
+				return false;
+
+			DispatchScope scope(*this);
+			mSlots[aHandle.index].listener(aArgs...);
+			return true;
+		}
+		bool Notify(const std::string& aName, Args... aArgs)
+		{
+			return Notify(Find(aName), aArgs...);
+		}
+		// Same as Notify(aName, ...) but throws if the listener does not exist
+		void NotifyChecked(const std::string& aName, Args... aArgs)
+		{
+			if (!Notify(Find(aName), aArgs...))
+			{
+				std::string msg = "Listener was not found: " + aName;
+				throw ER_CoreException(msg.c_str());
+			}
+		}
+
+		// Thread-safe: arguments are copied into the queue of DispatchDeferred()
+		void Post(Args... aArgs)
+		{
+			std::lock_guard<std::mutex> lock(mDeferredMutex);
+			mDeferred.emplace_back(std::move(aArgs)...);
+		}
+		// Notifies all listeners once per posted call (in the order of Post() calls); the queue storage is reused between calls
+		void DispatchDeferred()
+		{
+			assert(mDispatchingDeferred.empty());
+			{
+				std::lock_guard<std::mutex> lock(mDeferredMutex);
+				std::swap(mDeferred, mDispatchingDeferred);
+			}
+			for (auto& arguments : mDispatchingDeferred)
+				NotifyWithTuple(arguments, std::index_sequence_for<Args...>());
+			mDispatchingDeferred.clear();
+		}
+
+	private:
+		using DeferredArguments = std::tuple<typename std::decay<Args>::type...>;
+
+		struct Slot
+		{
+			Delegate listener;
+			std::uint64_t serial = 0; // slots subscribed after a Notify() started are skipped by it
+			std::uint32_t generation = 0;
+			bool isActive = false;
+		};
+
+		// Releases the slots that were unsubscribed during a dispatch (the outermost one, as listeners can notify again)
+		struct DispatchScope
+		{
+			DispatchScope(ER_Event& aEvent) : mEvent(aEvent) { mEvent.mDispatchDepth++; }
+			~DispatchScope()
+			{
+				if (--mEvent.mDispatchDepth == 0)
+				{
+					for (std::uint32_t index : mEvent.mPendingReleases)
+						mEvent.ReleaseSlot(index);
+					mEvent.mPendingReleases.clear();
+				}
+			}
+			ER_Event& mEvent;
+		};
+
+		template<size_t... Indices>
+		void NotifyWithTuple(DeferredArguments& aArguments, std::index_sequence<Indices...>)
+		{
+			Notify(std::get<Indices>(aArguments)...);
+		}
+
+		std::uint32_t AllocateSlot()
+		{
+			mListenersCount++;
+			if (!mFreeSlots.empty())
+			{
+				const std::uint32_t index = mFreeSlots.back();
+				mFreeSlots.pop_back();
+				return index;
+			}
+			mSlots.emplace_back(); // deque: slots never move, so a listener can subscribe during Notify()
+			return static_cast<std::uint32_t>(mSlots.size() - 1);
+		}
+		void RemoveSlot(std::uint32_t aIndex)
+		{
+			assert(mSlots[aIndex].isActive);
+			mSlots[aIndex].isActive = false;
+			mListenersCount--;
+			if (mDispatchDepth > 0)
+				mPendingReleases.push_back(aIndex);
+			else
+				ReleaseSlot(aIndex);
+		}
+		void ReleaseSlot(std::uint32_t aIndex)
+		{
+			Slot& slot = mSlots[aIndex];
+			slot.listener.Reset();
+			slot.generation++;
+			mFreeSlots.push_back(aIndex);
+		}
+
+		std::deque<Slot> mSlots;
+		std::vector<std::uint32_t> mFreeSlots;
+		std::vector<std::uint32_t> mPendingReleases;
+		std::unordered_map<std::string, ER_EventHandle> mNamedHandles;
+		std::uint64_t mSerial = 0;
+		size_t mListenersCount = 0;
+		int mDispatchDepth = 0;
+
+		std::mutex mDeferredMutex;
+		std::vector<DeferredArguments> mDeferred;
+		std::vector<DeferredArguments> mDispatchingDeferred;
+	};
+}
@@ -6,6 +6,7 @@
 #include "ER_Model.h"
 #include "ER_Mesh.h"
 #include "ER_VertexDeclarations.h"
+#include "ER_VertexCompression.h"
 #include "ER_Scene.h"
 #include "ER_DirectionalLight.h"
 #include "ER_ShadowMapper.h"
@@ -19,6 +20,11 @@
 #define FOLIAGE_PASS_ROOT_DESCRIPTOR_TABLE_SRV_INDEX 0
 #define FOLIAGE_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX 1
 
+// max errors of the quantized billboard vertices (model space) before falling back to full precision
+#define FOLIAGE_QUANTIZED_POSITION_MAX_ERROR 0.001f
+#define FOLIAGE_QUANTIZED_NORMAL_MAX_ERROR_DEGREES 1.0f
+#define FOLIAGE_QUANTIZED_UV_MAX_ERROR 0.001f
+
 namespace EveryRay_Core
 {
 	static int currentSplatChannnel = (int)TerrainSplatChannels::NONE;
@@ -81,13 +87,12 @@ namespace EveryRay_Core
 			//ER_OUTPUT_LOG(ER_Utility::ToWideString(name).c_str());
 		}
 
-		for (auto listener : FoliageSystemInitializedEvent->GetListeners())
-			listener();
+		FoliageSystemInitializedEvent->Notify();
 	}
 
 	void ER_FoliageManager::Update(const ER_CoreTime& gameTime, float gustDistance, float strength, float frequency)
 	{
-		ER_Camera* camera = (ER_Camera*)(mCore->GetServices().FindService(ER_Camera::TypeIdClass()));
+		ER_Camera* camera = mCore->GetServices().FindService<ER_Camera>();
 
 		if (mEnabled)
 		{
@@ -169,7 +174,7 @@ namespace EveryRay_Core
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 	ER_Foliage::ER_Foliage(ER_Core& pCore, ER_Camera& pCamera, ER_DirectionalLight& pLight, int pPatchesCount, const std::string& textureName, float scale, float distributionRadius,
-		const XMFLOAT3& distributionCenter, FoliageBillboardType bType, bool isPlacedOnTerrain, int placeChannel, float placedHeightDelta)
+		const XMFLOAT3& distributionCenter, FoliageBillboardType bType, bool isPlacedOnTerrain, int placeChannel, float placedHeightDelta, bool isQuantizedVertices)
 		:
 		mCore(pCore),
 		mCamera(pCamera),
@@ -183,26 +188,50 @@ namespace EveryRay_Core
 		mTextureName(textureName),
 		mIsPlacedOnTerrain(isPlacedOnTerrain),
 		mTerrainSplatChannel(placeChannel),
-		mPlacementHeightDelta(placedHeightDelta)
+		mPlacementHeightDelta(placedHeightDelta),
+		mIsQuantizedVertices(isQuantizedVertices)
 	{
 		auto rhi = mCore.GetRHI();
 
+		LoadBillboardModel(mType); // before the shaders: quantization can fall back to full precision
+
 		//shaders
 		{
-			ER_RHI_INPUT_ELEMENT_DESC inputElementDescriptions[] =
+			if (mIsQuantizedVertices)
+			{
+				ER_RHI_INPUT_ELEMENT_DESC inputElementDescriptions[] =
+				{
+					{ "POSITION", 0, ER_FORMAT_R16G16B16A16_UNORM, 0, 0, true, 0 },
+					{ "TEXCOORD", 0, ER_FORMAT_R16G16_FLOAT, 0, 0xffffffff, true, 0 },
+					{ "NORMAL", 0, ER_FORMAT_R16G16_UNORM, 0, 0xffffffff, true, 0 },
+					{ "WORLD", 0, ER_FORMAT_R32G32B32A32_FLOAT, 1, 0,  false, 1 },
+					{ "WORLD", 1, ER_FORMAT_R32G32B32A32_FLOAT, 1, 16, false, 1 },
+					{ "WORLD", 2, ER_FORMAT_R32G32B32A32_FLOAT, 1, 32, false, 1 },
+					{ "WORLD", 3, ER_FORMAT_R32G32B32A32_FLOAT, 1, 48, false, 1 }
+				};
+				mInputLayout = rhi->CreateInputLayout(inputElementDescriptions, ARRAYSIZE(inputElementDescriptions));
+
+				// PSOs are shared by name between the zones
+				mFoliageGBufferPassPSOName += " (quantized vertices)";
+				mFoliageVoxelizationPassPSOName += " (quantized vertices)";
+			}
+			else
 			{
-				{ "POSITION", 0, ER_FORMAT_R32G32B32A32_FLOAT, 0, 0, true, 0 },
-				{ "TEXCOORD", 0, ER_FORMAT_R32G32_FLOAT, 0, 0xffffffff, true, 0 },
-				{ "NORMAL", 0, ER_FORMAT_R32G32B32_FLOAT, 0, 0xffffffff, true, 0 },
-				{ "WORLD", 0, ER_FORMAT_R32G32B32A32_FLOAT, 1, 0,  false, 1 },
-				{ "WORLD", 1, ER_FORMAT_R32G32B32A32_FLOAT, 1, 16, false, 1 },
-				{ "WORLD", 2, ER_FORMAT_R32G32B32A32_FLOAT, 1, 32, false, 1 },
-				{ "WORLD", 3, ER_FORMAT_R32G32B32A32_FLOAT, 1, 48, false, 1 }
-			};
-			mInputLayout = rhi->CreateInputLayout(inputElementDescriptions, ARRAYSIZE(inputElementDescriptions));
+				ER_RHI_INPUT_ELEMENT_DESC inputElementDescriptions[] =
+				{
+					{ "POSITION", 0, ER_FORMAT_R32G32B32A32_FLOAT, 0, 0, true, 0 },
+					{ "TEXCOORD", 0, ER_FORMAT_R32G32_FLOAT, 0, 0xffffffff, true, 0 },
+					{ "NORMAL", 0, ER_FORMAT_R32G32B32_FLOAT, 0, 0xffffffff, true, 0 },
+					{ "WORLD", 0, ER_FORMAT_R32G32B32A32_FLOAT, 1, 0,  false, 1 },
+					{ "WORLD", 1, ER_FORMAT_R32G32B32A32_FLOAT, 1, 16, false, 1 },
+					{ "WORLD", 2, ER_FORMAT_R32G32B32A32_FLOAT, 1, 32, false, 1 },
+					{ "WORLD", 3, ER_FORMAT_R32G32B32A32_FLOAT, 1, 48, false, 1 }
+				};
+				mInputLayout = rhi->CreateInputLayout(inputElementDescriptions, ARRAYSIZE(inputElementDescriptions));
+			}
 
 			mVS = rhi->CreateGPUShader();
-			mVS->CompileShader(rhi, "content\\shaders\\Foliage.hlsl", "VSMain", ER_VERTEX, mInputLayout);
+			mVS->CompileShader(rhi, "content\\shaders\\Foliage.hlsl", mIsQuantizedVertices ? "VSMain_quantized" : "VSMain", ER_VERTEX, mInputLayout);
 
 			mGS = rhi->CreateGPUShader();
 			mGS->CompileShader(rhi, "content\\shaders\\Foliage.hlsl", "GSMain", ER_GEOMETRY);
@@ -217,8 +246,6 @@ namespace EveryRay_Core
 			mPS_Voxelization->CompileShader(rhi, "content\\shaders\\Foliage.hlsl", "PSMain_voxelization", ER_PIXEL);
 		}
 
-		LoadBillboardModel(mType);
-
 		mAlbedoTexture = rhi->CreateGPUTexture(L"");
 		mAlbedoTexture->CreateGPUTextureResource(rhi, textureName, true);
 		rhi->GenerateMipsWithTextureReplacement(&mAlbedoTexture,
@@ -256,36 +283,44 @@ namespace EveryRay_Core
 	{
 		auto rhi = mCore.GetRHI();
 
+		std::string modelPath;
+		if (bType == FoliageBillboardType::SINGLE)
+			modelPath = "content\\models\\vegetation\\foliage_quad_single.obj";
+		else if (bType == FoliageBillboardType::TWO_QUADS_CROSSING)
+			modelPath = "content\\models\\vegetation\\foliage_quad_double.obj";
+		else if (bType == FoliageBillboardType::THREE_QUADS_CROSSING)
+			modelPath = "content\\models\\vegetation\\foliage_quad_triple.obj";
+		else if (bType == FoliageBillboardType::MULTIPLE_QUADS_CROSSING)
+			modelPath = "content\\models\\vegetation\\foliage_quad_multiple.obj";
+		else
+			return;
+
+		mIsRotating = bType == FoliageBillboardType::SINGLE;
+
 		mVertexBuffer = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: Foliage - Vertex Buffer");
 		mIndexBuffer = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: Foliage - Index Buffer");
-		if (bType == FoliageBillboardType::SINGLE) {
-			mIsRotating = true;
-			std::unique_ptr<ER_Model> quadSingleModel(new ER_Model(mCore, ER_Utility::GetFilePath("content\\models\\vegetation\\foliage_quad_single.obj"), true));
-			quadSingleModel->GetMesh(0).CreateVertexBuffer_PositionUvNormal(mVertexBuffer);
-			quadSingleModel->GetMesh(0).CreateIndexBuffer(mIndexBuffer);
-			mVerticesCount = static_cast<int>(quadSingleModel->GetMesh(0).Indices().size());
-		}
-		else if (bType == FoliageBillboardType::TWO_QUADS_CROSSING) {
-			mIsRotating = false;
-			std::unique_ptr<ER_Model> quadDoubleModel(new ER_Model(mCore, ER_Utility::GetFilePath("content\\models\\vegetation\\foliage_quad_double.obj"), true));
-			quadDoubleModel->GetMesh(0).CreateVertexBuffer_PositionUvNormal(mVertexBuffer);
-			quadDoubleModel->GetMesh(0).CreateIndexBuffer(mIndexBuffer);
-			mVerticesCount = static_cast<int>(quadDoubleModel->GetMesh(0).Indices().size());
-		}
-		else if (bType == FoliageBillboardType::THREE_QUADS_CROSSING) {
-			mIsRotating = false;
-			std::unique_ptr<ER_Model> quadTripleModel(new ER_Model(mCore, ER_Utility::GetFilePath("content\\models\\vegetation\\foliage_quad_triple.obj"), true));
-			quadTripleModel->GetMesh(0).CreateVertexBuffer_PositionUvNormal(mVertexBuffer);
-			quadTripleModel->GetMesh(0).CreateIndexBuffer(mIndexBuffer);
-			mVerticesCount = static_cast<int>(quadTripleModel->GetMesh(0).Indices().size());
-		}
-		else if (bType == FoliageBillboardType::MULTIPLE_QUADS_CROSSING) {
-			mIsRotating = false;
-			std::unique_ptr<ER_Model> quadMultipleModel(new ER_Model(mCore, ER_Utility::GetFilePath("content\\models\\vegetation\\foliage_quad_multiple.obj"), true));
-			quadMultipleModel->GetMesh(0).CreateVertexBuffer_PositionUvNormal(mVertexBuffer);
-			quadMultipleModel->GetMesh(0).CreateIndexBuffer(mIndexBuffer);
-			mVerticesCount = static_cast<int>(quadMultipleModel->GetMesh(0).Indices().size());
+
+		std::unique_ptr<ER_Model> quadModel(new ER_Model(mCore, ER_Utility::GetFilePath(modelPath), true));
+		const ER_Mesh& mesh = quadModel->GetMesh(0);
+		if (mIsQuantizedVertices)
+		{
+			ER_VertexCompressionError error;
+			mesh.CreateVertexBuffer_QuantizedPositionUvNormal(mVertexBuffer, mPositionDecodeScale, mPositionDecodeBias, &error);
+
+			mIsQuantizedVertices = error.positionMax <= FOLIAGE_QUANTIZED_POSITION_MAX_ERROR && error.normalMaxDegrees <= FOLIAGE_QUANTIZED_NORMAL_MAX_ERROR_DEGREES &&
+				error.uvMax <= FOLIAGE_QUANTIZED_UV_MAX_ERROR;
+			if (!mIsQuantizedVertices)
+			{
+				ER_OUTPUT_LOG(ER_Utility::ToWideString("[ER Logger][ER_Foliage] Quantized vertices of " + modelPath + " are above the error tolerance (position: " + std::to_string(error.positionMax) +
+					", normal: " + std::to_string(error.normalMaxDegrees) + " degrees, uv: " + std::to_string(error.uvMax) + "), using full precision vertices instead" + '\n').c_str());
+				DeleteObject(mVertexBuffer);
+				mVertexBuffer = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: Foliage - Vertex Buffer");
+			}
 		}
+		if (!mIsQuantizedVertices)
+			mesh.CreateVertexBuffer_PositionUvNormal(mVertexBuffer);
+		mesh.CreateIndexBuffer(mIndexBuffer);
+		mVerticesCount = static_cast<int>(mesh.Indices().size());
 	}
 	void ER_Foliage::Initialize()
 	{
@@ -320,7 +355,7 @@ namespace EveryRay_Core
 				terrain->PlaceOnTerrain(mOutputPositionsOnTerrainBuffer, mInputPositionsOnTerrainBuffer, mCurrentPositions, mPatchesCount, (TerrainSplatChannels)mTerrainSplatChannel, nullptr, 0, mPlacementHeightDelta);
 #ifndef ER_PLATFORM_WIN64_DX11
 				std::string eventName = "On-terrain placement callback - initialization of foliage: " + mName;
-				terrain->ReadbackPlacedPositionsOnInitEvent->AddListener(eventName, [&](ER_Terrain* aTerrain)
+				terrain->ReadbackPlacedPositionsOnInitEvent->Subscribe(eventName, [&](ER_Terrain* aTerrain)
 					{ 
 						assert(aTerrain);
 						aTerrain->ReadbackPlacedPositions(mOutputPositionsOnTerrainBuffer, mInputPositionsOnTerrainBuffer, mCurrentPositions, mPatchesCount);
@@ -405,6 +440,8 @@ namespace EveryRay_Core
 		mFoliageConstantBuffer.Data.CameraDirection = XMFLOAT4(mCamera.Direction().x, mCamera.Direction().y, mCamera.Direction().z, 1.0f);
 		mFoliageConstantBuffer.Data.CameraPos = XMFLOAT4(mCamera.Position().x, mCamera.Position().y, mCamera.Position().z, 1.0f);
 		mFoliageConstantBuffer.Data.WindDirection = XMFLOAT4{ 0.0f, 0.0f, 1.0f , 1.0f };
+		mFoliageConstantBuffer.Data.PositionDecodeScale = mPositionDecodeScale;
+		mFoliageConstantBuffer.Data.PositionDecodeBias = mPositionDecodeBias;
 		mFoliageConstantBuffer.Data.VoxelCameraPos = XMFLOAT4{ mVoxelCameraPos->x, mVoxelCameraPos->y, mVoxelCameraPos->z, 1.0 };
 		mFoliageConstantBuffer.Data.RotateToCamera = (mIsRotating) ? 1.0f : 0.0f;;
 		mFoliageConstantBuffer.Data.Time = static_cast<float>(gameTime.TotalCoreTime());
@@ -576,7 +613,7 @@ namespace EveryRay_Core
 						terrain->PlaceOnTerrain(mOutputPositionsOnTerrainBuffer, mInputPositionsOnTerrainBuffer, mCurrentPositions, mPatchesCount, currentChannel, nullptr, 0, mPlacementHeightDelta);
 #ifndef ER_PLATFORM_WIN64_DX11
 						std::string eventName = "On-terrain placement callback - update of foliage: " + mName;
-						terrain->ReadbackPlacedPositionsOnUpdateEvent->AddListener(eventName, [&](ER_Terrain* aTerrain)
+						terrain->ReadbackPlacedPositionsOnUpdateEvent->Subscribe(eventName, [&](ER_Terrain* aTerrain)
 							{
 								assert(aTerrain);
 								aTerrain->ReadbackPlacedPositions(mOutputPositionsOnTerrainBuffer, mInputPositionsOnTerrainBuffer, mCurrentPositions, mPatchesCount); 
@@ -1,7 +1,7 @@
 #pragma once
 #include "Common.h"
 #include "ER_CoreComponent.h"
-#include "ER_GenericEvent.h"
+#include "ER_Event.h"
 #include "RHI/ER_RHI.h"
 
 #define MAX_FOLIAGE_ZONES 4096
@@ -38,6 +38,8 @@ namespace EveryRay_Core
 			XMFLOAT4 CameraPos;
 			XMFLOAT4 VoxelCameraPos;
 			XMFLOAT4 WindDirection;
+			XMFLOAT4 PositionDecodeScale; // only for quantized vertices
+			XMFLOAT4 PositionDecodeBias; // only for quantized vertices
 			float RotateToCamera;
 			float Time;
 			float WindFrequency;
@@ -92,7 +94,7 @@ namespace EveryRay_Core
 	public:
 		ER_Foliage(ER_Core& pCore, ER_Camera& pCamera, ER_DirectionalLight& pLight, int pPatchesCount, const std::string& textureName, float scale = 1.0f, float distributionRadius = 100, 
 			const XMFLOAT3& distributionCenter = XMFLOAT3(0.0f, 0.0f, 0.0f), FoliageBillboardType bType = FoliageBillboardType::SINGLE,
-			bool isPlacedOnTerrain = false, int terrainPlaceChannel = 4, float placedHeightDelta = 0.0f);
+			bool isPlacedOnTerrain = false, int terrainPlaceChannel = 4, float placedHeightDelta = 0.0f, bool isQuantizedVertices = false);
 		~ER_Foliage();
 
 		void Initialize();
@@ -185,6 +187,10 @@ namespace EveryRay_Core
 
 		FoliageBillboardType mType;
 
+		bool mIsQuantizedVertices = false; // VertexQuantizedPositionTextureNormal instead of VertexPositionTextureNormal (falls back if the compression error is too high)
+		XMFLOAT4 mPositionDecodeScale = XMFLOAT4(1.0f, 1.0f, 1.0f, 0.0f);
+		XMFLOAT4 mPositionDecodeBias = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+
 		int mTerrainSplatChannel = 4;
 		bool mIsPlacedOnTerrain = false;
 		float mPlacementHeightDelta = 0.0;
@@ -257,8 +263,8 @@ namespace EveryRay_Core
 
 		float GetQualityFactor() { return mCurrentFoliageQualityFactor; }
 
-		using Delegate_FoliageSystemInitialized = std::function<void()>;
-		ER_GenericEvent<Delegate_FoliageSystemInitialized>* FoliageSystemInitializedEvent = new ER_GenericEvent<Delegate_FoliageSystemInitialized>();
+		using Delegate_FoliageSystemInitialized = void();
+		ER_Event<Delegate_FoliageSystemInitialized>* FoliageSystemInitializedEvent = new ER_Event<Delegate_FoliageSystemInitialized>();
 	private:
 		void UpdateImGui();
 		std::vector<ER_Foliage*> mFoliageCollection;
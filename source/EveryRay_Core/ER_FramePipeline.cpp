@@ -0,0 +1,78 @@
+#include "stdafx.h"
+#include "ER_FramePipeline.h"
+
+#include <algorithm>
+
+namespace EveryRay_Core
+{
+	ER_FramePipeline::~ER_FramePipeline()
+	{
+		if (mIsKicked)
+			mWorkerPool->Wait(mSimulationJob);
+	}
+
+	void ER_FramePipeline::Publish(const std::function<void()>& aSimulate)
+	{
+		if (!mIsKicked)
+		{
+			auto startTime = std::chrono::high_resolution_clock::now();
+			aSimulate();
+
+			mStats.simulationTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+			mStats.waitTimeMs = 0.0;
+			mStats.overlapTimeMs = 0.0;
+			mStats.wasPipelined = false;
+			return;
+		}
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		Wait();
+
+		mStats.waitTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		mStats.simulationTimeMs = mWorkerSimulationTimeMs;
+		mStats.overlapTimeMs = std::max(0.0, mStats.simulationTimeMs - mStats.waitTimeMs);
+		mStats.wasPipelined = true;
+		mStats.workerArenaStats = mWorkerArena.GetStats();
+	}
+
+	void ER_FramePipeline::Kick(const std::function<void()>& aSimulate)
+	{
+		assert(!mIsKicked);
+		if (!mIsPipelined || !mWorkerPool)
+			return;
+
+		mWorkerException = nullptr;
+		mIsKicked = true;
+		mWorkerPool->Submit(mSimulationJob, [this, aSimulate]
+		{
+			mWorkerArena.Reset();
+			ER_ThreadArenaScope arenaScope(&mWorkerArena);
+
+			auto startTime = std::chrono::high_resolution_clock::now();
+			try
+			{
+				aSimulate();
+			}
+			catch (...)
+			{
+				mWorkerException = std::current_exception();
+			}
+			mWorkerSimulationTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		});
+	}
+
+	void ER_FramePipeline::Wait()
+	{
+		if (!mIsKicked)
+			return;
+
+		mWorkerPool->Wait(mSimulationJob);
+		mIsKicked = false;
+		if (mWorkerException)
+		{
+			std::exception_ptr exception = mWorkerException;
+			mWorkerException = nullptr;
+			std::rethrow_exception(exception);
+		}
+	}
+}
@@ -0,0 +1,60 @@
+// Frame pipeline in EveryRay Rendering Engine: overlaps the CPU simulation of the next frame with the command recording of the current one
+//
+//   main thread:   | Update(N): Publish() ... Kick() | Draw(N) (recording)           | Update(N+1): Publish() ... Kick() | Draw(N+1) ...
+//   worker (pool):                                  | simulation for N+1 -> back state |                                   | simulation for N+2 ...
+//
+// Ownership rules of the double-buffered render-facing state (i.e., ER_RenderingObject::Simulate()/PublishSimulatedState()):
+// - between Kick() and Publish() the worker owns the back (simulated) state. It only reads the data that the main thread does not change while recording.
+// - Publish() waits for the worker and hands the back state over to the main thread (front state), the main thread never reads the back state outside of it.
+// - the main thread changes the simulation inputs (transforms, editor, camera) only between Publish() and Kick().
+// Culling and LOD results are therefore one frame behind the camera when pipelining is enabled (popping and missing objects at the screen edges on fast camera turns),
+// so it is opt-in (SetPipelined()). Without pipelining, the simulation runs in Publish() on the main thread with the current camera.
+#pragma once
+#include "Common.h"
+#include "ER_LinearArena.h"
+#include "ER_WorkerPool.h"
+
+#include <functional>
+#include <exception>
+
+namespace EveryRay_Core
+{
+	struct ER_FramePipelineStats
+	{
+		double simulationTimeMs = 0.0; // on the worker thread (or on the main thread if not pipelined)
+		double waitTimeMs = 0.0; // main thread was blocked in Publish()
+		double overlapTimeMs = 0.0; // part of the simulation hidden behind the recording of the previous frame
+		bool wasPipelined = false;
+		ER_LinearArenaStats workerArenaStats; // temporary allocations of the worker thread
+	};
+
+	class ER_FramePipeline
+	{
+	public:
+		ER_FramePipeline() {}
+		~ER_FramePipeline();
+
+		// Start of the update (main thread): the simulated state of the frame becomes visible. 'aSimulate' runs here if nothing was kicked (first frame, pipelining disabled).
+		void Publish(const std::function<void()>& aSimulate);
+		// End of the update (main thread): the simulation of the next frame starts as a job of the worker pool (does nothing if pipelining is disabled)
+		void Kick(const std::function<void()>& aSimulate);
+		// Blocks until the kicked simulation is done (i.e., before the simulated objects are destroyed)
+		void Wait();
+
+		void SetWorkerPool(ER_WorkerPool* aWorkerPool) { mWorkerPool = aWorkerPool; } // without a pool, the simulation always runs in Publish()
+		void SetPipelined(bool aValue) { mIsPipelined = aValue; }
+		bool IsPipelined() const { return mIsPipelined; }
+		bool IsSimulating() const { return mIsKicked; }
+
+		const ER_FramePipelineStats& GetStats() const { return mStats; }
+	private:
+		ER_WorkerPool* mWorkerPool = nullptr;
+		ER_WorkerJobCounter mSimulationJob;
+		std::exception_ptr mWorkerException;
+		ER_FramePipelineStats mStats;
+		ER_LinearArena mWorkerArena; // temporary allocations of the worker thread, reset at the start of every simulation
+		double mWorkerSimulationTimeMs = 0.0; // written by the worker, read after Wait()
+		bool mIsKicked = false;
+		bool mIsPipelined = false;
+	};
+}
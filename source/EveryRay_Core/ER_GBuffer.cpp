@@ -8,6 +8,8 @@
 #include "ER_Utility.h"
 #include "ER_Scene.h"
 
+#include <algorithm>
+
 namespace EveryRay_Core {
 
 	static const std::string psoNameNonInstanced = "ER_RHI_GPUPipelineStateObject: GBufferMaterial";
@@ -98,25 +100,22 @@ namespace EveryRay_Core {
 		if (!mIsEnabled)
 			return;
 
-		rhi->SetRootSignature(mRootSignature);
-		rhi->SetTopologyType(ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-		ER_MaterialSystems materialSystems;
+		// PSOs are created here, draws are recorded by several threads (contiguous ranges of objects, so the order on the GPU does not change)
+		std::vector<ER_RenderingObject*> objectsToDraw;
 		for (auto renderingObjectInfo = scene->objects.begin(); renderingObjectInfo != scene->objects.end(); renderingObjectInfo++)
 		{
 			ER_RenderingObject* renderingObject = renderingObjectInfo->second;
-			if (renderingObject->IsCulled())
+			if (renderingObject->IsCulled() || renderingObject->IsOccluded())
 				continue;
 
 			const std::string& psoName = renderingObject->IsInstanced() ? psoNameInstanced : psoNameNonInstanced;
 			auto materialInfo = renderingObject->GetMaterials().find(ER_MaterialHelper::gbufferMaterialName);
 			if (materialInfo != renderingObject->GetMaterials().end())
 			{
-				ER_GBufferMaterial* material = static_cast<ER_GBufferMaterial*>(materialInfo->second);
 				if (!rhi->IsPSOReady(psoName))
 				{
 					rhi->InitializePSO(psoName);
-					material->PrepareShaders();
+					static_cast<ER_GBufferMaterial*>(materialInfo->second)->PrepareShaders();
 					rhi->SetRasterizerState(ER_NO_CULLING);
 					rhi->SetBlendState(ER_NO_BLEND);
 					rhi->SetDepthStencilState(ER_RHI_DEPTH_STENCIL_STATE::ER_DEPTH_ONLY_WRITE_COMPARISON_LESS_EQUAL);
@@ -124,16 +123,51 @@ namespace EveryRay_Core {
 					rhi->SetRootSignatureToPSO(psoName, mRootSignature);
 					rhi->SetTopologyTypeToPSO(psoName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 					rhi->FinalizePSO(psoName);
+					rhi->UnsetPSO();
 				}
-				rhi->SetPSO(psoName);
+				objectsToDraw.push_back(renderingObject);
+			}
+		}
+		if (objectsToDraw.empty())
+			return;
+
+		// textures can be shared by the objects of several contexts (materials, placeholders) and resource states are tracked globally,
+		// so they are transitioned here on the current list: the barriers of the contexts would run in the order of recording, not of submission
+		std::vector<ER_RHI_GPUResource*> textures;
+		for (ER_RenderingObject* renderingObject : objectsToDraw)
+		{
+			for (int meshIndex = 0; meshIndex < renderingObject->GetMeshCount(); meshIndex++)
+				ER_GBufferMaterial::GetMeshTextures(renderingObject, meshIndex, textures);
+		}
+		std::sort(textures.begin(), textures.end());
+		textures.erase(std::unique(textures.begin(), textures.end()), textures.end());
+		rhi->TransitionResources(textures, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, rhi->GetCurrentGraphicsCommandListIndex());
+
+		const int objectsCount = static_cast<int>(objectsToDraw.size());
+		const int contextsCount = std::min(rhi->GetParallelCommandContextsCount(), objectsCount);
+		rhi->ExecuteParallelCommandContexts("GBuffer", contextsCount, [&](int aContextIndex)
+		{
+			rhi->SetRenderTargets({ mAlbedoBuffer, mNormalBuffer, mPositionsBuffer, mExtraBuffer, mExtra2Buffer }, mDepthBuffer);
+			rhi->SetRootSignature(mRootSignature);
+			rhi->SetTopologyType(ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+			ER_MaterialSystems materialSystems;
+			const int startObject = objectsCount * aContextIndex / contextsCount;
+			const int endObject = objectsCount * (aContextIndex + 1) / contextsCount;
+			for (int i = startObject; i < endObject; i++)
+			{
+				ER_RenderingObject* renderingObject = objectsToDraw[i];
+				ER_GBufferMaterial* material = static_cast<ER_GBufferMaterial*>(renderingObject->GetMaterials().find(ER_MaterialHelper::gbufferMaterialName)->second);
+
+				rhi->SetPSO(renderingObject->IsInstanced() ? psoNameInstanced : psoNameNonInstanced);
 				for (int meshIndex = 0; meshIndex < renderingObject->GetMeshCount(); meshIndex++)
 				{
 					material->PrepareForRendering(materialSystems, renderingObject, meshIndex, mRootSignature);
-					renderingObject->Draw(ER_MaterialHelper::gbufferMaterialName, true, meshIndex);
+					renderingObject->Draw(ER_MaterialHelper::gbufferMaterialName, true, meshIndex, true);
 				}
 			}
-		}
-		rhi->UnsetPSO();
+			rhi->UnsetPSO();
+		});
 	}
 
 	void ER_GBuffer::UpdateImGui()
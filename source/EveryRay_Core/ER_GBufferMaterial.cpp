@@ -60,13 +60,14 @@ namespace EveryRay_Core
 	void ER_GBufferMaterial::PrepareForRendering(ER_MaterialSystems neededSystems, ER_RenderingObject* aObj, int meshIndex, ER_RHI_GPURootSignature* rs)
 	{
 		auto rhi = ER_Material::GetCore()->GetRHI();
-		ER_Camera* camera = (ER_Camera*)(ER_Material::GetCore()->GetServices().FindService(ER_Camera::TypeIdClass()));
+		ER_Camera* camera = ER_Material::GetCore()->GetServices().FindService<ER_Camera>();
 
 		assert(aObj);
 		assert(camera);
 
 		mConstantBuffer.Data.ViewProjection = XMMatrixTranspose(camera->ViewMatrix() * camera->ProjectionMatrix());
 		mConstantBuffer.ApplyChanges(rhi);
+		aObj->PrepareObjectConstantBuffer(); // bound before DrawLOD()
 		
 		if (!rhi->IsRootConstantSupported())
 		{
@@ -79,12 +80,7 @@ namespace EveryRay_Core
 		rhi->SetConstantBuffers(ER_PIXEL, { mConstantBuffer.Buffer() , aObj->GetObjectsConstantBuffer().Buffer() }, 0, rs, GBUFFER_MAT_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
 
 		std::vector<ER_RHI_GPUResource*> resources;
-		resources.push_back(aObj->GetTextureData(meshIndex).AlbedoMap);	
-		resources.push_back(aObj->GetTextureData(meshIndex).NormalMap);
-		resources.push_back(aObj->GetTextureData(meshIndex).RoughnessMap);
-		resources.push_back(aObj->GetTextureData(meshIndex).MetallicMap);
-		resources.push_back(aObj->GetTextureData(meshIndex).HeightMap);	
-		resources.push_back(aObj->GetTextureData(meshIndex).ExtraMaskMap);
+		GetMeshTextures(aObj, meshIndex, resources);
 		rhi->SetShaderResources(ER_PIXEL, resources, 0, rs, GBUFFER_MAT_ROOT_DESCRIPTOR_TABLE_PIXEL_SRV_INDEX);
 		rhi->SetSamplers(ER_PIXEL, { ER_RHI_SAMPLER_STATE::ER_TRILINEAR_WRAP }, 0, rs);
 
@@ -92,6 +88,16 @@ namespace EveryRay_Core
 			rhi->SetShaderResources(ER_VERTEX, { aObj->GetIndirectNewInstanceBuffer() }, static_cast<int>(resources.size()), rs, GBUFFER_MAT_ROOT_DESCRIPTOR_TABLE_VERTEX_SRV_INDEX);
 	}
 
+	void ER_GBufferMaterial::GetMeshTextures(ER_RenderingObject* aObj, int meshIndex, std::vector<ER_RHI_GPUResource*>& aTextures)
+	{
+		aTextures.push_back(aObj->GetTextureData(meshIndex).AlbedoMap);
+		aTextures.push_back(aObj->GetTextureData(meshIndex).NormalMap);
+		aTextures.push_back(aObj->GetTextureData(meshIndex).RoughnessMap);
+		aTextures.push_back(aObj->GetTextureData(meshIndex).MetallicMap);
+		aTextures.push_back(aObj->GetTextureData(meshIndex).HeightMap);
+		aTextures.push_back(aObj->GetTextureData(meshIndex).ExtraMaskMap);
+	}
+
 	void ER_GBufferMaterial::PrepareResourcesForStandardMaterial(ER_MaterialSystems neededSystems, ER_RenderingObject* aObj, int meshIndex, ER_RHI_GPURootSignature* rs)
 	{
 		//not used because this material is not standard
@@ -29,6 +29,9 @@ namespace EveryRay_Core
 		virtual void CreateVertexBuffer(const ER_Mesh& mesh, ER_RHI_GPUBuffer* vertexBuffer) override;
 		virtual int VertexSize() override;
 
+		// Pixel shader textures of the mesh (same order as in the shader), nulls are kept
+		static void GetMeshTextures(ER_RenderingObject* aObj, int meshIndex, std::vector<ER_RHI_GPUResource*>& aTextures);
+
 		ER_RHI_GPUConstantBuffer<GBufferMaterial_CBufferData::GBufferCB> mConstantBuffer;
 	};
 }
\ No newline at end of file
@@ -12,6 +12,8 @@
 #include "ER_RenderingObject.h"
 #include "ER_Utility.h"
 
+#include <algorithm>
+
 #define GPU_CULL_PASS_ROOT_DESCRIPTOR_TABLE_SRV_INDEX 0
 #define GPU_CULL_PASS_ROOT_DESCRIPTOR_TABLE_UAV_INDEX 1
 #define GPU_CULL_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX 2
@@ -36,6 +38,11 @@ namespace EveryRay_Core
 
 #if ER_PLATFORM_WIN64_DX11
 		mMeshConstantBuffer.Release();
+		for (auto& buffers : mReadbackBuffers)
+		{
+			DeleteObject(buffers.second.first);
+			DeleteObject(buffers.second.second);
+		}
 #endif
 		mCameraConstantBuffer.Release();
 	}
@@ -122,11 +129,61 @@ namespace EveryRay_Core
 	}
 
 
+	// Submitted as an async compute job: the graphics queue has to call AcquireCullingResults() before it draws the indirect objects
 	void ER_GPUCuller::PerformCull(ER_Scene* aScene)
 	{
 		assert(aScene);
 
-		ClearCounters(aScene);
+		std::vector<ER_RHI_GPUResource*> reads;
+		std::vector<ER_RHI_GPUResource*> writes;
+		GetCullingResources(aScene, reads, writes);
+
+		mCore.GetRHI()->GetAsyncComputeScheduler().Submit("EveryRay: GPU Culling (job)", reads, writes, [this, aScene]()
+		{
+			ClearCounters(aScene);
+			Cull(aScene);
+		});
+	}
+
+	void ER_GPUCuller::AcquireCullingResults(ER_Scene* aScene)
+	{
+		assert(aScene);
+
+		std::vector<ER_RHI_GPUResource*> reads;
+		std::vector<ER_RHI_GPUResource*> writes;
+		GetCullingResources(aScene, reads, writes);
+
+		mCore.GetRHI()->GetAsyncComputeScheduler().Acquire(writes);
+
+		if (ER_Utility::IsValidatingGPUCullingOnCPU)
+		{
+			PerformCullOnCPU(aScene);
+#if ER_PLATFORM_WIN64_DX11
+			ValidateCullingResults(aScene);
+#endif
+		}
+	}
+
+	void ER_GPUCuller::GetCullingResources(ER_Scene* aScene, std::vector<ER_RHI_GPUResource*>& aReads, std::vector<ER_RHI_GPUResource*>& aWrites)
+	{
+		for (ER_SceneObject& obPair : aScene->objects)
+		{
+			ER_RenderingObject* aObj = obPair.second;
+
+			if (!aObj->IsGPUIndirectlyRendered())
+				continue;
+
+			if (!aObj->GetIndirectArgsBuffer() || !aObj->GetIndirectNewInstanceBuffer() || !aObj->GetIndirectOriginalInstanceBuffer())
+				continue;
+
+			aReads.push_back(aObj->GetIndirectOriginalInstanceBuffer());
+			aWrites.push_back(aObj->GetIndirectNewInstanceBuffer());
+			aWrites.push_back(aObj->GetIndirectArgsBuffer());
+		}
+	}
+
+	void ER_GPUCuller::Cull(ER_Scene* aScene)
+	{
 
 		mIndirectCullsCounterPerFrame = 0;
 		auto rhi = mCore.GetRHI();
@@ -187,31 +244,210 @@ namespace EveryRay_Core
 
 #if ER_PLATFORM_WIN64_DX11
 	void ER_GPUCuller::UpdateMeshesConstantBuffer(const ER_RenderingObject* aObj)
+	{
+		aObj->FillIndirectMeshConstants(mMeshConstantBuffer.Data);
+		mMeshConstantBuffer.ApplyChanges(mCore.GetRHI());
+	}
+
+	// Reads back the results of the GPU (direct readback in the dx11 immediate context, so it stalls - only for debugging)
+	// and compares them with the CPU reference
+	void ER_GPUCuller::ValidateCullingResults(ER_Scene* aScene)
 	{
 		auto rhi = mCore.GetRHI();
-		const int totalObjLodCount = aObj->GetLODCount();
 
-		int offset, indexCount, lastAvailableLod = 0;
-		for (int lodI = 0; lodI < MAX_LOD; lodI++)
+		for (ER_SceneObject& obPair : aScene->objects)
 		{
-			for (int meshI = 0; meshI < MAX_MESH_COUNT; meshI++)
+			ER_RenderingObject* aObj = obPair.second;
+
+			const ER_GPUCullingResults* expected = GetCPUCullingResults(aObj);
+			if (!expected)
+				continue;
+
+			auto it = mReadbackBuffers.find(aObj);
+			if (it == mReadbackBuffers.end())
 			{
-				offset = MAX_MESH_COUNT * lodI + meshI;
-				if (lodI < totalObjLodCount)
-					indexCount = (meshI < aObj->GetMeshCount(/*TODO ideally from lodI but we dont support meshes per LOD yet*/)) ? aObj->GetIndexCount(lodI, meshI) : INT_MAX;
-				else
-					indexCount = INT_MAX;
-					// Uncomment this if you want to fallback into previous LOD (you have to adjust ER_RenderingObject::Draw())
-					// indexCount = (meshI < aObj->GetMeshCount(/*TODO ideally from lastAvailableLod but we dont support meshes per LOD yet*/)) ? aObj->GetIndexCount(lastAvailableLod, meshI) : INT_MAX;
-				
-				mMeshConstantBuffer.Data.IndexCount_StartIndexLoc_BaseVtxLoc_StartInstLoc[offset] = XMINT4(indexCount, 0, 0, 0);
+				ER_RHI_GPUBuffer* argsReadback = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: GPU Culler - Args Readback Buffer: " + aObj->GetName());
+				argsReadback->CreateGPUBufferResource(rhi, nullptr, static_cast<UINT>(expected->args.size()), sizeof(UINT), false,
+					ER_BIND_NONE, 0x10000L | 0x20000L /*legacy from DX11*/, ER_RESOURCE_MISC_NONE, ER_RHI_FORMAT::ER_FORMAT_R32_UINT); //should be STAGING
+				ER_RHI_GPUBuffer* instancesReadback = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: GPU Culler - New Instance Data Readback Buffer: " + aObj->GetName());
+				instancesReadback->CreateGPUBufferResource(rhi, nullptr, static_cast<UINT>(expected->instances.size()), sizeof(IndirectInstanceData), false,
+					ER_BIND_NONE, 0x10000L | 0x20000L /*legacy from DX11*/, ER_RESOURCE_MISC_BUFFER_STRUCTURED); //should be STAGING
+				it = mReadbackBuffers.emplace(aObj, std::make_pair(argsReadback, instancesReadback)).first;
 			}
-			if (lodI < totalObjLodCount)
-				lastAvailableLod = lodI;
+
+			rhi->BeginCopyCommandList();
+			rhi->CopyBuffer(it->second.first, aObj->GetIndirectArgsBuffer(), 0, true);
+			rhi->CopyBuffer(it->second.second, aObj->GetIndirectNewInstanceBuffer(), 0, true);
+			rhi->EndCopyCommandList();
+			rhi->ExecuteCopyCommandList();
+
+			ER_GPUCullingResults actual;
+			void* outputData = nullptr;
+			rhi->BeginBufferRead(it->second.first, &outputData);
+			{
+				assert(outputData);
+				const UINT* args = reinterpret_cast<const UINT*>(outputData);
+				actual.args.assign(args, args + expected->args.size());
+			}
+			rhi->EndBufferRead(it->second.first);
+			outputData = nullptr;
+			rhi->BeginBufferRead(it->second.second, &outputData);
+			{
+				assert(outputData);
+				const IndirectInstanceData* instances = reinterpret_cast<const IndirectInstanceData*>(outputData);
+				actual.instances.assign(instances, instances + expected->instances.size());
+			}
+			rhi->EndBufferRead(it->second.second);
+
+			std::string mismatch;
+			if (!CompareCullingResults(*expected, actual, aObj->GetInstanceCount(), mismatch))
+				ER_OUTPUT_LOG(ER_Utility::ToWideString("[ER Logger][ER_GPUCuller] GPU culling does not match the CPU reference for " + aObj->GetName() + ": " + mismatch + '\n').c_str());
 		}
-		mMeshConstantBuffer.Data.OriginalInstancesCount = aObj->GetInstanceCount();
-		mMeshConstantBuffer.Data.pad = XMINT3(0,0,0);
-		mMeshConstantBuffer.ApplyChanges(rhi);
 	}
 #endif
+
+	void ER_GPUCuller::PerformCullOnCPU(ER_Scene* aScene)
+	{
+		assert(aScene);
+
+		IndirectMeshCB meshConstants;
+		for (ER_SceneObject& obPair : aScene->objects)
+		{
+			ER_RenderingObject* aObj = obPair.second;
+
+			if (!aObj->IsGPUIndirectlyRendered() || aObj->GetIndirectOriginalInstanceData().empty())
+				continue;
+
+			if (aObj->GetIndirectOriginalInstanceData().size() != aObj->GetInstanceCount())
+				continue;
+
+			aObj->FillIndirectMeshConstants(meshConstants);
+			CullOnCPU(meshConstants, mCameraConstantBuffer.Data, aObj->GetIndirectOriginalInstanceData(), mCPUCullingResults[aObj]);
+		}
+	}
+
+	const ER_GPUCullingResults* ER_GPUCuller::GetCPUCullingResults(const ER_RenderingObject* aObj) const
+	{
+		auto it = mCPUCullingResults.find(aObj);
+		return (it != mCPUCullingResults.end()) ? &it->second : nullptr;
+	}
+
+	// Every step follows the shaders in the same order of operations (with IEEE floats), so that the results are bitwise identical;
+	// only the GPU compiler can break that by fusing the multiply-adds of the frustum test
+	void ER_GPUCuller::CullOnCPU(const IndirectMeshCB& aMeshConstants, const IndirectCullingCBufferData::CameraConstants& aCameraConstants,
+		const std::vector<IndirectInstanceData>& aInstances, ER_GPUCullingResults& aResults)
+	{
+		const UINT originalInstancesCount = aMeshConstants.OriginalInstancesCount;
+		assert(aInstances.size() >= originalInstancesCount);
+
+		// IndirectCullingClear.hlsl (new instance buffer is cleared with ClearUAV())
+		aResults.args.resize(MAX_LOD * MAX_MESH_COUNT * 5);
+		for (int offset = 0; offset < MAX_LOD * MAX_MESH_COUNT; offset++)
+		{
+			const XMINT4& meshConstants = aMeshConstants.IndexCount_StartIndexLoc_BaseVtxLoc_StartInstLoc[offset];
+			aResults.args[offset * 5 + 0] = static_cast<UINT>(meshConstants.x);
+			aResults.args[offset * 5 + 1] = 0;
+			aResults.args[offset * 5 + 2] = static_cast<UINT>(meshConstants.y);
+			aResults.args[offset * 5 + 3] = static_cast<UINT>(meshConstants.z);
+			aResults.args[offset * 5 + 4] = static_cast<UINT>(meshConstants.w);
+		}
+		aResults.instances.assign(originalInstancesCount * MAX_LOD, IndirectInstanceData()); // zeroed
+
+		// IndirectCulling.hlsl
+		const XMFLOAT4* planes = aCameraConstants.FrustumPlanes;
+		const XMFLOAT4& lodDistances = aCameraConstants.LodCameraDistances;
+		const XMFLOAT4& cameraPos = aCameraConstants.CameraPos;
+		for (UINT index = 0; index < originalInstancesCount; index++)
+		{
+			const IndirectInstanceData& data = aInstances[index];
+
+			bool isCulled = false;
+			for (int planeID = 0; planeID < 6; ++planeID)
+			{
+				const float axisVertX = (planes[planeID].x > 0.0f) ? data.AABBMin.x : data.AABBMax.x;
+				const float axisVertY = (planes[planeID].y > 0.0f) ? data.AABBMin.y : data.AABBMax.y;
+				const float axisVertZ = (planes[planeID].z > 0.0f) ? data.AABBMin.z : data.AABBMax.z;
+
+				const float dot = planes[planeID].x * axisVertX + planes[planeID].y * axisVertY + planes[planeID].z * axisVertZ;
+				if (dot + planes[planeID].w > 0.0f)
+				{
+					isCulled = true;
+					break;
+				}
+			}
+			if (isCulled)
+				continue;
+
+			// float3(worldMat[0][3], worldMat[1][3], worldMat[2][3]) in HLSL (column-major) is the translation row of XMFLOAT4X4
+			const float posX = data.World._41;
+			const float posY = data.World._42;
+			const float posZ = data.World._43;
+			const float distanceToCameraSqr =
+				(cameraPos.x - posX) * (cameraPos.x - posX) +
+				(cameraPos.y - posY) * (cameraPos.y - posY) +
+				(cameraPos.z - posZ) * (cameraPos.z - posZ);
+
+			int lod = -1;
+			if (distanceToCameraSqr <= lodDistances.x)
+				lod = 0;
+			else if (lodDistances.x < distanceToCameraSqr && distanceToCameraSqr <= lodDistances.y)
+				lod = 1;
+			else if (lodDistances.y < distanceToCameraSqr && distanceToCameraSqr <= lodDistances.z)
+				lod = 2;
+			if (lod == -1)
+				continue;
+
+			for (int mesh = 0; mesh < MAX_MESH_COUNT; mesh++)
+			{
+				const UINT offset = MAX_MESH_COUNT * lod + mesh;
+				const UINT outIndex = aResults.args[offset * 5 + 1]++;
+				if (mesh == 0)
+					aResults.instances[originalInstancesCount * lod + outIndex] = data;
+			}
+		}
+	}
+
+	bool ER_GPUCuller::CompareCullingResults(const ER_GPUCullingResults& aExpected, const ER_GPUCullingResults& aActual, UINT aOriginalInstancesCount, std::string& aMismatch)
+	{
+		if (aExpected.args.size() != aActual.args.size() || aExpected.instances.size() != aActual.instances.size())
+		{
+			aMismatch = "different buffer sizes";
+			return false;
+		}
+
+		for (size_t i = 0; i < aExpected.args.size(); i++)
+		{
+			if (aExpected.args[i] != aActual.args[i])
+			{
+				aMismatch = "arg #" + std::to_string(i % 5) + " of lod " + std::to_string(i / 5 / MAX_MESH_COUNT) + ", mesh " + std::to_string((i / 5) % MAX_MESH_COUNT) +
+					": " + std::to_string(aExpected.args[i]) + " (expected) vs " + std::to_string(aActual.args[i]);
+				return false;
+			}
+		}
+
+		// instances are appended with atomics on the GPU, so only the sets of every LOD can be compared (the visible ones are at the beginning)
+		auto bitwiseLess = [](const IndirectInstanceData& a, const IndirectInstanceData& b) { return memcmp(&a, &b, sizeof(IndirectInstanceData)) < 0; };
+		auto bitwiseEqual = [](const IndirectInstanceData& a, const IndirectInstanceData& b) { return memcmp(&a, &b, sizeof(IndirectInstanceData)) == 0; };
+		for (int lod = 0; lod < MAX_LOD; lod++)
+		{
+			const size_t begin = static_cast<size_t>(aOriginalInstancesCount) * lod;
+			const size_t visibleCount = aExpected.args[MAX_MESH_COUNT * lod * 5 + 1];
+			if (begin + visibleCount > aExpected.instances.size())
+			{
+				aMismatch = "more visible instances than the buffer can hold in lod " + std::to_string(lod);
+				return false;
+			}
+
+			std::vector<IndirectInstanceData> expected(aExpected.instances.begin() + begin, aExpected.instances.begin() + begin + visibleCount);
+			std::vector<IndirectInstanceData> actual(aActual.instances.begin() + begin, aActual.instances.begin() + begin + visibleCount);
+			std::sort(expected.begin(), expected.end(), bitwiseLess);
+			std::sort(actual.begin(), actual.end(), bitwiseLess);
+			if (!std::equal(expected.begin(), expected.end(), actual.begin(), bitwiseEqual))
+			{
+				aMismatch = "different visible instances in lod " + std::to_string(lod);
+				return false;
+			}
+		}
+		return true;
+	}
 }
\ No newline at end of file
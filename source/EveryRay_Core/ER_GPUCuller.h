@@ -1,25 +1,16 @@
 #pragma once
 #include "Common.h"
 #include "ER_CoreComponent.h"
+#include "ER_RenderingObject.h"
 #include "RHI/ER_RHI.h"
 
 namespace EveryRay_Core
 {
 	class ER_Camera;
 	class ER_Scene;
-	class ER_RenderingObject;
 
 	namespace IndirectCullingCBufferData
 	{
-#if ER_PLATFORM_WIN64_DX11
-		struct ER_ALIGN_GPU_BUFFER MeshConstants
-		{
-			XMINT4 IndexCount_StartIndexLoc_BaseVtxLoc_StartInstLoc[MAX_LOD * MAX_MESH_COUNT];
-			UINT OriginalInstancesCount;
-			XMINT3 pad;
-		};
-#endif
-
 		struct ER_ALIGN_GPU_BUFFER CameraConstants
 		{
 			XMFLOAT4 FrustumPlanes[6];
@@ -28,6 +19,13 @@ namespace EveryRay_Core
 		};
 	}
 
+	// Outputs of the culling passes for one object (as they are in the GPU buffers)
+	struct ER_GPUCullingResults
+	{
+		std::vector<UINT> args; // draw indexed instanced args: MAX_LOD * MAX_MESH_COUNT * 5
+		std::vector<IndirectInstanceData> instances; // compacted instances: OriginalInstancesCount per LOD
+	};
+
 	class ER_GPUCuller : public ER_CoreComponent
 	{
 	public:
@@ -36,9 +34,24 @@ namespace EveryRay_Core
 
 		void Initialize();
 		void PerformCull(ER_Scene* aScene);
+		void AcquireCullingResults(ER_Scene* aScene);
 		void ClearCounters(ER_Scene* aScene);
 
+		// CPU reference of IndirectCullingClear.hlsl + IndirectCulling.hlsl (keep in sync!)
+		// Visible instances are compacted in their original order, while the GPU appends them in any order (see CompareCullingResults())
+		static void CullOnCPU(const IndirectMeshCB& aMeshConstants, const IndirectCullingCBufferData::CameraConstants& aCameraConstants,
+			const std::vector<IndirectInstanceData>& aInstances, ER_GPUCullingResults& aResults);
+		// Args have to be identical, compacted instances of every LOD have to be the same set (bitwise)
+		static bool CompareCullingResults(const ER_GPUCullingResults& aExpected, const ER_GPUCullingResults& aActual, UINT aOriginalInstancesCount, std::string& aMismatch);
+
+		// Culls all indirectly rendered objects of the scene on the CPU with the camera of the last PerformCull()
+		void PerformCullOnCPU(ER_Scene* aScene);
+		const ER_GPUCullingResults* GetCPUCullingResults(const ER_RenderingObject* aObj) const;
+
 	private:
+		void Cull(ER_Scene* aScene);
+		void GetCullingResources(ER_Scene* aScene, std::vector<ER_RHI_GPUResource*>& aReads, std::vector<ER_RHI_GPUResource*>& aWrites);
+
 		ER_Core& mCore;
 		ER_Camera& mCamera;
 
@@ -46,7 +59,9 @@ namespace EveryRay_Core
 		ER_RHI_GPUShader* mIndirectCullingClearCS = nullptr;
 #if ER_PLATFORM_WIN64_DX11
 		void UpdateMeshesConstantBuffer(const ER_RenderingObject* aObj);
-		ER_RHI_GPUConstantBuffer<IndirectCullingCBufferData::MeshConstants> mMeshConstantBuffer;
+		void ValidateCullingResults(ER_Scene* aScene);
+		ER_RHI_GPUConstantBuffer<IndirectMeshCB> mMeshConstantBuffer;
+		std::map<const ER_RenderingObject*, std::pair<ER_RHI_GPUBuffer*, ER_RHI_GPUBuffer*>> mReadbackBuffers; // staging copies of the args and new instance buffers
 #endif
 		ER_RHI_GPUConstantBuffer<IndirectCullingCBufferData::CameraConstants> mCameraConstantBuffer;
 		ER_RHI_GPURootSignature* mIndirectCullingRS = nullptr;
@@ -54,6 +69,8 @@ namespace EveryRay_Core
 		const std::string mPSOName = "ER_RHI_GPUPipelineStateObject: Indirect Cull Pass";
 		const std::string mPSOClearName = "ER_RHI_GPUPipelineStateObject: Indirect Cull Pass Clear";
 		
+		std::map<const ER_RenderingObject*, ER_GPUCullingResults> mCPUCullingResults;
+
 		int mIndirectCullsCounterPerFrame = 0;
 	};
 }
\ No newline at end of file
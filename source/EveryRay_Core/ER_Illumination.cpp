@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include <stdio.h>
+#include <algorithm>
 
 #include "ER_Illumination.h"
 #include "ER_CoreTime.h"
@@ -108,6 +109,7 @@ namespace EveryRay_Core {
 			DeleteObject(mVCTVoxelCascades3DRTs[i]);
 			DeleteObject(mDebugVoxelZonesGizmos[i]);
 		}
+		ReleaseVoxelizationObjects();
 		DeleteObject(mVCTVoxelizationDebugRT);
 		DeleteObject(mVCTMainRT);
 		DeleteObject(mVCTUpsampleAndBlurRT);
@@ -442,17 +444,40 @@ namespace EveryRay_Core {
 				std::string materialName = ER_MaterialHelper::voxelizationMaterialName + "_" + std::to_string(cascade);
 				const std::string& psoName = voxelizationPSONames[cascade];
 
-				for (auto& obj : mVoxelizationObjects[cascade])
+				for (int objectIndex : mVoxelizationCascadesObjects[cascade])
 				{
-					if (!obj.second->IsInVoxelization())
+					VoxelizationObject& voxelizationObject = mVoxelizationObjects[objectIndex];
+					ER_RenderingObject* renderingObject = voxelizationObject.object;
+					if (!renderingObject->IsInVoxelization())
 						continue;
 
-					ER_RenderingObject* renderingObject = obj.second;
+					// instanced objects are drawn with the instances inside the cascade (not with the ones culled against the main camera)
+					ER_RHI_GPUBuffer* instanceBuffer = nullptr;
+					const UINT instanceCount = static_cast<UINT>(voxelizationObject.cascadeInstances[cascade].size());
+					if (renderingObject->IsInstanced() && !renderingObject->IsGPUIndirectlyRendered())
+					{
+						if (voxelizationObject.cascadeInstanceBuffersCapacity[cascade] < renderingObject->GetInstanceCount())
+						{
+							DeleteObject(voxelizationObject.cascadeInstanceBuffers[cascade]);
+							voxelizationObject.cascadeInstanceBuffers[cascade] = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: VCT GI - voxelization instances of " + renderingObject->GetName() + " (cascade " + std::to_string(cascade) + ")");
+							voxelizationObject.cascadeInstanceBuffers[cascade]->CreateGPUBufferResource(rhi, &renderingObject->GetInstancesData()[0], renderingObject->GetInstanceCount(), sizeof(InstancedData), true, ER_BIND_VERTEX_BUFFER);
+							voxelizationObject.cascadeInstanceBuffersCapacity[cascade] = renderingObject->GetInstanceCount();
+							voxelizationObject.isCascadeInstanceBufferDirty[cascade] = true;
+						}
+						instanceBuffer = voxelizationObject.cascadeInstanceBuffers[cascade];
+
+						if (voxelizationObject.isCascadeInstanceBufferDirty[cascade])
+						{
+							rhi->UpdateBuffer(instanceBuffer, &voxelizationObject.cascadeInstances[cascade][0], sizeof(InstancedData) * instanceCount);
+							voxelizationObject.isCascadeInstanceBufferDirty[cascade] = false;
+						}
+					}
+
 					auto materialInfo = renderingObject->GetMaterials().find(materialName);
 					if (materialInfo != renderingObject->GetMaterials().end())
 					{
 						ER_Material* material = materialInfo->second;
-						for (int meshIndex = 0; meshIndex < obj.second->GetMeshCount(); meshIndex++)
+						for (int meshIndex = 0; meshIndex < renderingObject->GetMeshCount(); meshIndex++)
 						{
 							if (!rhi->IsPSOReady(psoName))
 							{
@@ -467,7 +492,10 @@ namespace EveryRay_Core {
 							rhi->SetPSO(psoName);
 							static_cast<ER_VoxelizationMaterial*>(material)->PrepareForRendering(materialSystems, renderingObject, meshIndex,
 								mWorldVoxelScales[cascade], voxelCascadesSizes[cascade], mVoxelCameraPositions[cascade], mVoxelizationRS);
-							renderingObject->Draw(materialName, true, meshIndex);
+							if (instanceBuffer)
+								renderingObject->DrawLOD(materialName, true, meshIndex, 0, true, instanceBuffer, instanceCount);
+							else
+								renderingObject->Draw(materialName, true, meshIndex);
 							rhi->UnsetPSO();
 						}
 					}
@@ -690,7 +718,7 @@ namespace EveryRay_Core {
 		{
 			for (auto& objectInfo : scene->objects)
 			{
-				if (!objectInfo.second->IsCulled() && objectInfo.second->IsRendered() && objectInfo.second->IsSeparableSubsurfaceScattering())
+				if (!objectInfo.second->IsCulled() && !objectInfo.second->IsOccluded() && objectInfo.second->IsRendered() && objectInfo.second->IsSeparableSubsurfaceScattering())
 				{
 					mIsSSSCulled = false;
 					break;
@@ -743,6 +771,9 @@ namespace EveryRay_Core {
 				ImGui::Checkbox("DEBUG - Ambient Occlusion", &mShowVCTAmbientOcclusionOnly);
 				ImGui::Checkbox("DEBUG - Voxel Texture", &mShowVCTVoxelizationOnly);
 				ImGui::Checkbox("DEBUG - Voxel Cascades Gizmos (Editor)", &mDrawVCTVoxelZonesGizmos);
+				for (int cascade = 0; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+					ImGui::Text("Voxelized in cascade %d: %d objects, %d instances", cascade, static_cast<int>(mVoxelizationCascadesObjects[cascade].size()), mVoxelizationCascadesInstancesCount[cascade]);
+				ImGui::Text("Voxel cascades culling: %.3f ms", mVoxelizationCullingTimeMs);
 			}
 			if (ImGui::CollapsingHeader("Static - Light Probes"))
 			{
@@ -751,8 +782,16 @@ namespace EveryRay_Core {
 				ImGui::Checkbox("DEBUG - Hide culled probes", &mProbesManager->mDebugDiscardCulledProbes);
 				ImGui::Checkbox("DEBUG - Diffuse probes", &mDrawDiffuseProbes);
 				ImGui::Checkbox("DEBUG - Specular probes", &mDrawSpecularProbes);
+				const ER_SpecularProbesResidencyStats& residency = mProbesManager->GetSpecularProbesResidencyStats();
+				ImGui::Text("Specular probes resident: %d (pending: %d)", residency.residentCount, residency.pendingCount);
+				ImGui::Text("Specular probes copied/evicted: %d/%d (total: %llu/%llu)", residency.copiedCount, residency.evictedCount, residency.copiedCountTotal, residency.evictedCountTotal);
 			}
 		}
+		if (ImGui::CollapsingHeader("Forward Lighting"))
+		{
+			ImGui::Text("Objects: %d, batches: %d, PSO changes: %d", mForwardLightingStats.objectsCount, mForwardLightingStats.batchesCount, mForwardLightingStats.psoChangesCount);
+			ImGui::Text("Bindings - CBs: %d, SRVs: %d, skipped: %d", mForwardLightingStats.constantBuffersBindingsCount, mForwardLightingStats.shaderResourcesBindingsCount, mForwardLightingStats.skippedBindingsCount);
+		}
 		ImGui::End();
 	}
 
@@ -873,14 +912,37 @@ namespace EveryRay_Core {
 		}
 	}
 
+	// Opaque forward objects are drawn in batches per PSO and sorted by their textures inside a batch, so that redundant bindings are skipped
+	// in PreparePipelineForForwardLighting() and PrepareResourcesForForwardLighting(). Transparent objects are drawn after them in their original order
+	// (sorting them by state would change the blending order from frame to frame). Pass constants and shared resources are updated once per frame.
 	void ER_Illumination::DrawForwardLighting(ER_GBuffer* gbuffer, ER_RHI_GPUTexture* aRenderTarget)
 	{
 		auto rhi = mCore->GetRHI();
+		mForwardLightingStats = ForwardLightingStats();
+
 		rhi->SetRenderTargets({ aRenderTarget }, gbuffer->GetDepth());
 		rhi->SetRootSignature(mForwardLightingRS);
 		rhi->SetTopologyType(ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+		mForwardLightingBatchedObjects.clear();
 		for (auto& obj : mForwardPassObjects)
-			obj.second->Draw(ER_MaterialHelper::forwardLightingNonMaterialName);
+			mForwardLightingBatchedObjects.push_back(obj.second);
+		std::stable_sort(mForwardLightingBatchedObjects.begin(), mForwardLightingBatchedObjects.end(), [](ER_RenderingObject* a, ER_RenderingObject* b)
+		{
+			if (a->IsTransparent() || b->IsTransparent())
+				return !a->IsTransparent() && b->IsTransparent(); // stable sort keeps the original order of transparent objects
+			if (a->IsInstanced() != b->IsInstanced())
+				return !a->IsInstanced();
+			ER_RHI_GPUTexture* albedoA = a->GetMeshCount() > 0 ? a->GetTextureData(0).AlbedoMap : nullptr;
+			ER_RHI_GPUTexture* albedoB = b->GetMeshCount() > 0 ? b->GetTextureData(0).AlbedoMap : nullptr;
+			return std::less<ER_RHI_GPUTexture*>()(albedoA, albedoB);
+		});
+
+		UpdateForwardLightingPassData();
+		for (ER_RenderingObject* obj : mForwardLightingBatchedObjects)
+			obj->Draw(ER_MaterialHelper::forwardLightingNonMaterialName, false, -1, true);
+		mForwardLightingStats.objectsCount = static_cast<int>(mForwardLightingBatchedObjects.size());
+		mForwardLightingStats.batchesCount = mForwardLightingStats.psoChangesCount; // one batch per PSO, standard materials are counted below (when a batch is flushed)
 
 		rhi->UnsetPSO();
 
@@ -888,29 +950,98 @@ namespace EveryRay_Core {
 		assert(scene);
 		// Passes for all other materials (which are called "standard") that are rendered in "Forward" way into local illumination RT.
 		// This can be used for all kinds of materials that are layered onto each other (transparent ones can also be rendered here).
-		// TODO: We'd better render objects in batches per material in order to reduce SetRootSignature()/SetPSO() calls etc. Code below is not optimal
-		for (auto& it = scene->objects.begin(); it != scene->objects.end(); it++)
+		// Objects are batched per material: the ones with the same material are drawn one after another and PSO is unset once per batch.
+		mForwardStandardMaterialsBatchedObjects.clear();
+		for (auto& objectInfo : scene->objects)
 		{
-			for (auto& mat : it->second->GetMaterials())
+			for (auto& mat : objectInfo.second->GetMaterials())
 			{
 				if (mat.second->IsStandard())
-				{
-					it->second->Draw(mat.first);
-					rhi->UnsetPSO();
-				}
+					mForwardStandardMaterialsBatchedObjects.emplace_back(&mat.first, objectInfo.second);
+			}
+		}
+		std::stable_sort(mForwardStandardMaterialsBatchedObjects.begin(), mForwardStandardMaterialsBatchedObjects.end(),
+			[](const std::pair<const std::string*, ER_RenderingObject*>& a, const std::pair<const std::string*, ER_RenderingObject*>& b) { return *a.first < *b.first; });
+
+		const size_t standardMaterialsDrawsCount = mForwardStandardMaterialsBatchedObjects.size();
+		for (size_t i = 0; i < standardMaterialsDrawsCount; i++)
+		{
+			const std::string& materialName = *mForwardStandardMaterialsBatchedObjects[i].first;
+			mForwardStandardMaterialsBatchedObjects[i].second->Draw(materialName, false, -1, true);
+			if (i + 1 == standardMaterialsDrawsCount || *mForwardStandardMaterialsBatchedObjects[i + 1].first != materialName)
+			{
+				rhi->UnsetPSO();
+				mForwardLightingStats.batchesCount++;
 			}
 		}
 	}
 
-	void ER_Illumination::PreparePipelineForForwardLighting(ER_RenderingObject* aObj)
+	// Constant buffers of the pass and resources shared by all forward objects (shadows, probes)
+	void ER_Illumination::UpdateForwardLightingPassData()
 	{
 		auto rhi = mCore->GetRHI();
 
-		std::string psoName;
+		for (size_t i = 0; i < NUM_SHADOW_CASCADES; i++)
+			mForwardLightingConstantBuffer.Data.ShadowMatrices[i] = XMMatrixTranspose(mShadowMapper.GetViewMatrix(i) * mShadowMapper.GetProjectionMatrix(i) * XMLoadFloat4x4(&ER_MatrixHelper::GetProjectionShadowMatrix()));
+		mForwardLightingConstantBuffer.Data.ViewProjection = XMMatrixTranspose(mCamera.ViewMatrix() * mCamera.ProjectionMatrix());
+		mForwardLightingConstantBuffer.Data.ShadowTexelSize = XMFLOAT4{ 1.0f / mShadowMapper.GetResolution(), 1.0f, 1.0f , 1.0f };
+		mForwardLightingConstantBuffer.Data.ShadowCascadeDistances = XMFLOAT4{ mCamera.GetCameraFarShadowCascadeDistance(0), mCamera.GetCameraFarShadowCascadeDistance(1), mCamera.GetCameraFarShadowCascadeDistance(2), 1.0f };
+		mForwardLightingConstantBuffer.Data.SunDirection = XMFLOAT4{ -mDirectionalLight.Direction().x, -mDirectionalLight.Direction().y, -mDirectionalLight.Direction().z, 1.0f };
+		mForwardLightingConstantBuffer.Data.SunColor = XMFLOAT4{ mDirectionalLight.GetDirectionalLightColor().x, mDirectionalLight.GetDirectionalLightColor().y, mDirectionalLight.GetDirectionalLightColor().z, mDirectionalLight.GetDirectionalLightIntensity() };
+		mForwardLightingConstantBuffer.Data.CameraPosition = XMFLOAT4{ mCamera.Position().x,mCamera.Position().y,mCamera.Position().z, 1.0f };
+		mForwardLightingConstantBuffer.ApplyChanges(rhi);
+
+		if (mProbesManager->IsEnabled())
+		{
+			mLightProbesConstantBuffer.Data.DiffuseProbesCellsCount = mProbesManager->GetProbesCellsCount(DIFFUSE_PROBE);
+			mLightProbesConstantBuffer.Data.SpecularProbesCellsCount = mProbesManager->GetProbesCellsCount(SPECULAR_PROBE);
+			mLightProbesConstantBuffer.Data.SceneLightProbesBounds = XMFLOAT4{ mProbesManager->GetSceneProbesVolumeMin().x, mProbesManager->GetSceneProbesVolumeMin().y, mProbesManager->GetSceneProbesVolumeMin().z, 1.0f };
+			mLightProbesConstantBuffer.Data.DistanceBetweenDiffuseProbes = mProbesManager->GetDistanceBetweenDiffuseProbes();
+			mLightProbesConstantBuffer.Data.DistanceBetweenSpecularProbes = mProbesManager->GetDistanceBetweenSpecularProbes();
+			mLightProbesConstantBuffer.ApplyChanges(rhi);
+		}
+
+		// 0-4 are mesh textures (set per mesh)
+		mForwardLightingResources.assign(18, nullptr);
+		if (mProbesManager->AreGlobalProbesReady())
+		{
+			for (int i = 0; i < NUM_SHADOW_CASCADES; i++)
+				mForwardLightingResources[5 + i] = mShadowMapper.GetShadowTexture(i);
+			mForwardLightingResources[8] = mProbesManager->GetGlobalDiffuseProbe()->GetCubemapTexture();
+			mForwardLightingResources[9] = mProbesManager->IsEnabled() ? mProbesManager->GetDiffuseProbesCellsIndicesBuffer() : nullptr;
+			mForwardLightingResources[10] = mProbesManager->IsEnabled() ? mProbesManager->GetDiffuseProbesSphericalHarmonicsCoefficientsBuffer() : nullptr;
+			mForwardLightingResources[11] = mProbesManager->IsEnabled() ? mProbesManager->GetDiffuseProbesPositionsBuffer() : nullptr;
+			mForwardLightingResources[12] = mProbesManager->GetGlobalSpecularProbe()->GetCubemapTexture();
+			mForwardLightingResources[13] = mProbesManager->IsEnabled() ? mProbesManager->GetCulledSpecularProbesTextureArray() : nullptr;
+			mForwardLightingResources[14] = mProbesManager->IsEnabled() ? mProbesManager->GetSpecularProbesCellsIndicesBuffer() : nullptr;
+			mForwardLightingResources[15] = mProbesManager->IsEnabled() ? mProbesManager->GetSpecularProbesTexArrayIndicesBuffer() : nullptr;
+			mForwardLightingResources[16] = mProbesManager->IsEnabled() ? mProbesManager->GetSpecularProbesPositionsBuffer() : nullptr;
+			mForwardLightingResources[17] = mProbesManager->GetIntegrationMap();
+		}
+
+		mIsForwardLightingResourcesBound = false;
+		mForwardLightingCurrentObject = nullptr;
+		mForwardLightingCurrentPSOName.clear();
+	}
+
+	const std::string& ER_Illumination::GetForwardLightingPSOName(ER_RenderingObject* aObj)
+	{
 		if (!aObj->IsTransparent())
-			psoName = aObj->IsInstanced() ? mForwardLightingInstancingPSOName : mForwardLightingPSOName;
+			return aObj->IsInstanced() ? mForwardLightingInstancingPSOName : mForwardLightingPSOName;
 		else
-			psoName = aObj->IsInstanced() ? mForwardLightingTransparentInstancingPSOName : mForwardLightingTransparentPSOName;
+			return aObj->IsInstanced() ? mForwardLightingTransparentInstancingPSOName : mForwardLightingTransparentPSOName;
+	}
+
+	void ER_Illumination::PreparePipelineForForwardLighting(ER_RenderingObject* aObj)
+	{
+		auto rhi = mCore->GetRHI();
+
+		const std::string& psoName = GetForwardLightingPSOName(aObj);
+		if (psoName == mForwardLightingCurrentPSOName)
+		{
+			mForwardLightingStats.skippedBindingsCount++;
+			return;
+		}
 
 		if (!rhi->IsPSOReady(psoName))
 		{
@@ -928,6 +1059,9 @@ namespace EveryRay_Core {
 		}
 		rhi->SetPSO(psoName);
 		rhi->SetSamplers(ER_PIXEL, { ER_RHI_SAMPLER_STATE::ER_TRILINEAR_WRAP, ER_RHI_SAMPLER_STATE::ER_SHADOW_SS, ER_RHI_SAMPLER_STATE::ER_TRILINEAR_CLAMP });
+
+		mForwardLightingCurrentPSOName = psoName;
+		mForwardLightingStats.psoChangesCount++;
 	}
 
 	void ER_Illumination::PrepareResourcesForForwardLighting(ER_RenderingObject* aObj, int meshIndex, int lod)
@@ -938,78 +1072,66 @@ namespace EveryRay_Core {
 
 		if (aObj && aObj->IsForwardShading())
 		{
-			for (size_t i = 0; i < NUM_SHADOW_CASCADES; i++)
-				mForwardLightingConstantBuffer.Data.ShadowMatrices[i] = XMMatrixTranspose(mShadowMapper.GetViewMatrix(i) * mShadowMapper.GetProjectionMatrix(i) * XMLoadFloat4x4(&ER_MatrixHelper::GetProjectionShadowMatrix()));
-			mForwardLightingConstantBuffer.Data.ViewProjection = XMMatrixTranspose(mCamera.ViewMatrix() * mCamera.ProjectionMatrix());
-			mForwardLightingConstantBuffer.Data.ShadowTexelSize = XMFLOAT4{ 1.0f / mShadowMapper.GetResolution(), 1.0f, 1.0f , 1.0f };
-			mForwardLightingConstantBuffer.Data.ShadowCascadeDistances = XMFLOAT4{ mCamera.GetCameraFarShadowCascadeDistance(0), mCamera.GetCameraFarShadowCascadeDistance(1), mCamera.GetCameraFarShadowCascadeDistance(2), 1.0f };
-			mForwardLightingConstantBuffer.Data.SunDirection = XMFLOAT4{ -mDirectionalLight.Direction().x, -mDirectionalLight.Direction().y, -mDirectionalLight.Direction().z, 1.0f };
-			mForwardLightingConstantBuffer.Data.SunColor = XMFLOAT4{ mDirectionalLight.GetDirectionalLightColor().x, mDirectionalLight.GetDirectionalLightColor().y, mDirectionalLight.GetDirectionalLightColor().z, mDirectionalLight.GetDirectionalLightIntensity() };
-			mForwardLightingConstantBuffer.Data.CameraPosition = XMFLOAT4{ mCamera.Position().x,mCamera.Position().y,mCamera.Position().z, 1.0f };
-			mForwardLightingConstantBuffer.ApplyChanges(rhi);
-
-			if (mProbesManager->IsEnabled())
+			// pass constant buffers are updated in UpdateForwardLightingPassData(), here we only bind them (once per object)
+			if (aObj != mForwardLightingCurrentObject)
 			{
-				mLightProbesConstantBuffer.Data.DiffuseProbesCellsCount = mProbesManager->GetProbesCellsCount(DIFFUSE_PROBE);
-				mLightProbesConstantBuffer.Data.SpecularProbesCellsCount = mProbesManager->GetProbesCellsCount(SPECULAR_PROBE);
-				mLightProbesConstantBuffer.Data.SceneLightProbesBounds = XMFLOAT4{ mProbesManager->GetSceneProbesVolumeMin().x, mProbesManager->GetSceneProbesVolumeMin().y, mProbesManager->GetSceneProbesVolumeMin().z, 1.0f };
-				mLightProbesConstantBuffer.Data.DistanceBetweenDiffuseProbes = mProbesManager->GetDistanceBetweenDiffuseProbes();
-				mLightProbesConstantBuffer.Data.DistanceBetweenSpecularProbes = mProbesManager->GetDistanceBetweenSpecularProbes();
-				mLightProbesConstantBuffer.ApplyChanges(rhi);
-
-				if (rhi->IsRootConstantSupported())
+				if (mProbesManager->IsEnabled())
 				{
-					rhi->SetConstantBuffers(ER_VERTEX, { mForwardLightingConstantBuffer.Buffer(), aObj->GetObjectsConstantBuffer().Buffer(), mLightProbesConstantBuffer.Buffer() }, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
-					rhi->SetRootConstant(static_cast<UINT>(lod), FORWARD_LIGHTING_PASS_ROOT_CONSTANT_INDEX);
+					if (rhi->IsRootConstantSupported())
+						rhi->SetConstantBuffers(ER_VERTEX, { mForwardLightingConstantBuffer.Buffer(), aObj->GetObjectsConstantBuffer().Buffer(), mLightProbesConstantBuffer.Buffer() }, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
+					else
+					{
+						rhi->SetConstantBuffers(ER_VERTEX, { 
+							mForwardLightingConstantBuffer.Buffer(), aObj->GetObjectsConstantBuffer().Buffer(), mLightProbesConstantBuffer.Buffer(), aObj->GetObjectsFakeRootConstantBuffer().Buffer()
+							}, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
+					}
+					rhi->SetConstantBuffers(ER_PIXEL, { mForwardLightingConstantBuffer.Buffer(), aObj->GetObjectsConstantBuffer().Buffer(), mLightProbesConstantBuffer.Buffer() }, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
 				}
 				else
 				{
-					rhi->SetConstantBuffers(ER_VERTEX, { 
-						mForwardLightingConstantBuffer.Buffer(), aObj->GetObjectsConstantBuffer().Buffer(), mLightProbesConstantBuffer.Buffer(), aObj->GetObjectsFakeRootConstantBuffer().Buffer()
-						}, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
+					rhi->SetConstantBuffers(ER_VERTEX, { mForwardLightingConstantBuffer.Buffer(), aObj->GetObjectsConstantBuffer().Buffer() }, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
+					if (!rhi->IsRootConstantSupported())
+						rhi->SetConstantBuffers(ER_VERTEX, { aObj->GetObjectsFakeRootConstantBuffer().Buffer() }, 3 /* we used 0-2 slots already*/, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
+					rhi->SetConstantBuffers(ER_PIXEL,  { mForwardLightingConstantBuffer.Buffer(), aObj->GetObjectsConstantBuffer().Buffer() }, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
 				}
-				rhi->SetConstantBuffers(ER_PIXEL, { mForwardLightingConstantBuffer.Buffer(), aObj->GetObjectsConstantBuffer().Buffer(), mLightProbesConstantBuffer.Buffer() }, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
+				mForwardLightingCurrentObject = aObj;
+				mForwardLightingStats.constantBuffersBindingsCount++;
 			}
 			else
+				mForwardLightingStats.skippedBindingsCount++;
+
+			if (rhi->IsRootConstantSupported())
+				rhi->SetRootConstant(static_cast<UINT>(lod), FORWARD_LIGHTING_PASS_ROOT_CONSTANT_INDEX);
+
+			// shared resources are already in the list, we rebind it only if the mesh textures differ from the bound ones
+			if (mProbesManager->AreGlobalProbesReady())
 			{
-				if (rhi->IsRootConstantSupported())
+				const TextureData& textures = aObj->GetTextureData(meshIndex);
+				ER_RHI_GPUResource* meshResources[5] = { textures.AlbedoMap, textures.NormalMap, textures.MetallicMap, textures.RoughnessMap,
+					aObj->IsTransparent() ? textures.ExtraMaskMap : textures.HeightMap };
+
+				bool isChanged = !mIsForwardLightingResourcesBound;
+				for (int i = 0; i < 5; i++)
 				{
-					rhi->SetConstantBuffers(ER_VERTEX, { mForwardLightingConstantBuffer.Buffer(), aObj->GetObjectsConstantBuffer().Buffer() }, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
-					rhi->SetRootConstant(static_cast<UINT>(lod), FORWARD_LIGHTING_PASS_ROOT_CONSTANT_INDEX);
+					if (mForwardLightingResources[i] != meshResources[i])
+					{
+						mForwardLightingResources[i] = meshResources[i];
+						isChanged = true;
+					}
 				}
-				else
+
+				if (isChanged)
 				{
-					rhi->SetConstantBuffers(ER_VERTEX, { mForwardLightingConstantBuffer.Buffer(), aObj->GetObjectsConstantBuffer().Buffer() }, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
-					rhi->SetConstantBuffers(ER_VERTEX, { aObj->GetObjectsFakeRootConstantBuffer().Buffer() }, 3 /* we used 0-2 slots already*/, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
+					rhi->SetShaderResources(ER_PIXEL, mForwardLightingResources, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_PIXEL_SRV_INDEX);
+					mIsForwardLightingResourcesBound = true;
+					mForwardLightingStats.shaderResourcesBindingsCount++;
 				}
-				rhi->SetConstantBuffers(ER_PIXEL,  { mForwardLightingConstantBuffer.Buffer(), aObj->GetObjectsConstantBuffer().Buffer() }, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
-			}
-
-			std::vector<ER_RHI_GPUResource*> resources(18);
-			if (mProbesManager->AreGlobalProbesReady())
-			{
-				resources[0] = aObj->GetTextureData(meshIndex).AlbedoMap;
-				resources[1] = aObj->GetTextureData(meshIndex).NormalMap;
-				resources[2] = aObj->GetTextureData(meshIndex).MetallicMap;
-				resources[3] = aObj->GetTextureData(meshIndex).RoughnessMap;
-				resources[4] = aObj->IsTransparent() ? aObj->GetTextureData(meshIndex).ExtraMaskMap : aObj->GetTextureData(meshIndex).HeightMap;
-				for (int i = 0; i < NUM_SHADOW_CASCADES; i++)
-					resources[5 + i] = mShadowMapper.GetShadowTexture(i);
-				resources[8] = mProbesManager->GetGlobalDiffuseProbe()->GetCubemapTexture();
-				resources[9] = mProbesManager->IsEnabled() ? mProbesManager->GetDiffuseProbesCellsIndicesBuffer() : nullptr;
-				resources[10] = mProbesManager->IsEnabled() ? mProbesManager->GetDiffuseProbesSphericalHarmonicsCoefficientsBuffer() : nullptr;
-				resources[11] = mProbesManager->IsEnabled() ? mProbesManager->GetDiffuseProbesPositionsBuffer() : nullptr;
-				resources[12] = mProbesManager->GetGlobalSpecularProbe()->GetCubemapTexture();
-				resources[13] = mProbesManager->IsEnabled() ? mProbesManager->GetCulledSpecularProbesTextureArray() : nullptr;
-				resources[14] = mProbesManager->IsEnabled() ? mProbesManager->GetSpecularProbesCellsIndicesBuffer() : nullptr;
-				resources[15] = mProbesManager->IsEnabled() ? mProbesManager->GetSpecularProbesTexArrayIndicesBuffer() : nullptr;
-				resources[16] = mProbesManager->IsEnabled() ? mProbesManager->GetSpecularProbesPositionsBuffer() : nullptr;
-				resources[17] = mProbesManager->GetIntegrationMap();
-				rhi->SetShaderResources(ER_PIXEL, resources, 0, mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_PIXEL_SRV_INDEX);
+				else
+					mForwardLightingStats.skippedBindingsCount++;
 			}
 
 			if (aObj->IsGPUIndirectlyRendered())
-				rhi->SetShaderResources(ER_VERTEX, { aObj->GetIndirectNewInstanceBuffer() }, static_cast<int>(resources.size()), mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_VERTEX_SRV_INDEX);
+				rhi->SetShaderResources(ER_VERTEX, { aObj->GetIndirectNewInstanceBuffer() }, static_cast<int>(mForwardLightingResources.size()), mForwardLightingRS, FORWARD_LIGHTING_PASS_ROOT_DESCRIPTOR_TABLE_VERTEX_SRV_INDEX);
 
 			// we unset PSO after all objects are rendered
 		}
@@ -1020,44 +1142,202 @@ namespace EveryRay_Core {
 		return mGbuffer->GetDepth();
 	}
 
+	static bool IsIntersectingAABB(const ER_AABB& a, const ER_AABB& b)
+	{
+		return
+			(a.first.x <= b.second.x && a.second.x >= b.first.x) &&
+			(a.first.y <= b.second.y && a.second.y >= b.first.y) &&
+			(a.first.z <= b.second.z && a.second.z >= b.first.z);
+	}
+
+	// Tests world AABBs of all voxelized objects (of every instance for instanced ones) against the cascades and fills compact per-cascade lists.
+	// Bigger workloads are split between threads in contiguous ranges of objects with roughly the same amount of instances.
 	void ER_Illumination::CPUCullObjectsAgainstVoxelCascades(const ER_Scene* scene)
 	{
 		if (mCurrentGIQuality == GIQuality::GI_LOW)
 			return;
 
-		//TODO add instancing support
-		//TODO fix repetition checks when the object AABB is bigger than the lower cascade (i.e. sponza)
-		//TODO add optimization for culling objects by checking its volume size in second+ cascades
 		//TODO add indirect drawing support (GPU cull)
-		//TODO add multithreading per cascade
-		for (int cascade = 0; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		// rebuild the list if voxelized objects of the scene have changed
 		{
+			int voxelizedObjectsCount = 0;
+			bool isChanged = false;
 			for (auto& objectInfo : scene->objects)
 			{
 				if (!objectInfo.second->IsInVoxelization())
 					continue;
 
-				auto aabbObj = objectInfo.second->GetLocalAABB();
-				XMFLOAT3 position;
-				ER_MatrixHelper::GetTranslation(objectInfo.second->GetTransformationMatrix(), position);
-				aabbObj.first.x += position.x;
-				aabbObj.first.y += position.y;
-				aabbObj.first.z += position.z;
-				aabbObj.second.x += position.x;
-				aabbObj.second.y += position.y;
-				aabbObj.second.z += position.z;
-
-				bool isColliding =
-					(aabbObj.first.x <= mWorldVoxelCascadesAABBs[cascade].second.x && aabbObj.second.x >= mWorldVoxelCascadesAABBs[cascade].first.x) &&
-					(aabbObj.first.y <= mWorldVoxelCascadesAABBs[cascade].second.y && aabbObj.second.y >= mWorldVoxelCascadesAABBs[cascade].first.y) &&
-					(aabbObj.first.z <= mWorldVoxelCascadesAABBs[cascade].second.z && aabbObj.second.z >= mWorldVoxelCascadesAABBs[cascade].first.z);
-
-				auto it = mVoxelizationObjects[cascade].find(objectInfo.first);
-				if (isColliding && (it == mVoxelizationObjects[cascade].end()))
-					mVoxelizationObjects[cascade].insert(objectInfo);
-				else if (!isColliding && (it != mVoxelizationObjects[cascade].end()))
-					mVoxelizationObjects[cascade].erase(it);
+				if (voxelizedObjectsCount >= static_cast<int>(mVoxelizationObjects.size()) || mVoxelizationObjects[voxelizedObjectsCount].object != objectInfo.second)
+				{
+					isChanged = true;
+					break;
+				}
+				voxelizedObjectsCount++;
+			}
+
+			if (isChanged || voxelizedObjectsCount != static_cast<int>(mVoxelizationObjects.size()))
+			{
+				ReleaseVoxelizationObjects();
+				for (auto& objectInfo : scene->objects)
+				{
+					if (!objectInfo.second->IsInVoxelization())
+						continue;
+
+					mVoxelizationObjects.emplace_back();
+					mVoxelizationObjects.back().object = objectInfo.second;
+				}
+			}
+		}
+
+		// union of all cascades (early-out for instances far from the camera)
+		ER_AABB cascadesBounds = mWorldVoxelCascadesAABBs[0];
+		for (int cascade = 1; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+		{
+			cascadesBounds.first.x = std::min(cascadesBounds.first.x, mWorldVoxelCascadesAABBs[cascade].first.x);
+			cascadesBounds.first.y = std::min(cascadesBounds.first.y, mWorldVoxelCascadesAABBs[cascade].first.y);
+			cascadesBounds.first.z = std::min(cascadesBounds.first.z, mWorldVoxelCascadesAABBs[cascade].first.z);
+			cascadesBounds.second.x = std::max(cascadesBounds.second.x, mWorldVoxelCascadesAABBs[cascade].second.x);
+			cascadesBounds.second.y = std::max(cascadesBounds.second.y, mWorldVoxelCascadesAABBs[cascade].second.y);
+			cascadesBounds.second.z = std::max(cascadesBounds.second.z, mWorldVoxelCascadesAABBs[cascade].second.z);
+		}
+
+		const int objectsCount = static_cast<int>(mVoxelizationObjects.size());
+		UINT64 instancesCount = 0;
+		for (const auto& voxelizationObject : mVoxelizationObjects)
+			instancesCount += std::max(voxelizationObject.object->GetInstanceCount(), 1u);
+
+		ER_WorkerPool* workerPool = mCore->GetWorkerPool();
+		const int numThreads = std::max(1, std::min(workerPool->GetWorkersCount() + 1, static_cast<int>(instancesCount / VOXEL_GI_CULLING_MIN_INSTANCES_PER_THREAD)));
+		if (numThreads == 1)
+			CPUCullVoxelizationObjects(0, objectsCount, cascadesBounds);
+		else
+		{
+			std::vector<std::pair<int, int>> ranges; // [begin; end) of objects with roughly the same instances count
+			ranges.reserve(numThreads);
+
+			const UINT64 instancesPerThread = instancesCount / numThreads;
+			UINT64 rangeInstancesCount = 0;
+			int rangeBegin = 0;
+			for (int i = 0; i < objectsCount; i++)
+			{
+				rangeInstancesCount += std::max(mVoxelizationObjects[i].object->GetInstanceCount(), 1u);
+				if (rangeInstancesCount >= instancesPerThread || i == objectsCount - 1)
+				{
+					ranges.emplace_back(rangeBegin, i + 1);
+					rangeBegin = i + 1;
+					rangeInstancesCount = 0;
+				}
+			}
+			workerPool->ParallelFor(static_cast<int>(ranges.size()), [this, &ranges, &cascadesBounds](int aRange)
+			{
+				CPUCullVoxelizationObjects(ranges[aRange].first, ranges[aRange].second, cascadesBounds);
+			});
+		}
+
+		for (int cascade = 0; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+		{
+			mVoxelizationCascadesObjects[cascade].clear();
+			mVoxelizationCascadesInstancesCount[cascade] = 0;
+			for (int i = 0; i < objectsCount; i++)
+			{
+				const VoxelizationObject& voxelizationObject = mVoxelizationObjects[i];
+				if (!voxelizationObject.isInCascade[cascade])
+					continue;
+
+				mVoxelizationCascadesObjects[cascade].push_back(i);
+				if (voxelizationObject.object->IsInstanced() && !voxelizationObject.object->IsGPUIndirectlyRendered())
+					mVoxelizationCascadesInstancesCount[cascade] += static_cast<int>(voxelizationObject.cascadeInstances[cascade].size());
+				else
+					mVoxelizationCascadesInstancesCount[cascade] += std::max(static_cast<int>(voxelizationObject.object->GetInstanceCount()), 1);
 			}
 		}
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		mVoxelizationCullingTimeMs = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	}
+
+	// Only writes to mVoxelizationObjects[aBegin, aEnd), so ranges can be processed in parallel
+	void ER_Illumination::CPUCullVoxelizationObjects(int aBegin, int aEnd, const ER_AABB& aCascadesBounds)
+	{
+		std::vector<InstancedData> instances[NUM_VOXEL_GI_CASCADES];
+
+		for (int i = aBegin; i < aEnd; i++)
+		{
+			VoxelizationObject& voxelizationObject = mVoxelizationObjects[i];
+			ER_RenderingObject* object = voxelizationObject.object;
+
+			if (!object->IsInstanced())
+			{
+				const ER_AABB& aabb = object->GetGlobalAABB();
+				for (int cascade = 0; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+					voxelizationObject.isInCascade[cascade] = IsIntersectingAABB(aabb, mWorldVoxelCascadesAABBs[cascade]);
+				continue;
+			}
+
+			const int instanceCount = static_cast<int>(object->GetInstanceCount());
+			if (object->IsGPUIndirectlyRendered())
+			{
+				// instances are culled on the GPU, we only need to know if any of them is inside the cascade
+				for (int cascade = 0; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+					voxelizationObject.isInCascade[cascade] = false;
+
+				for (int instanceIndex = 0; instanceIndex < instanceCount; instanceIndex++)
+				{
+					const ER_AABB& aabb = object->GetInstanceAABB(instanceIndex);
+					if (!IsIntersectingAABB(aabb, aCascadesBounds))
+						continue;
+
+					for (int cascade = 0; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+						voxelizationObject.isInCascade[cascade] = voxelizationObject.isInCascade[cascade] || IsIntersectingAABB(aabb, mWorldVoxelCascadesAABBs[cascade]);
+				}
+				continue;
+			}
+
+			const std::vector<InstancedData>& instancesData = object->GetInstancesData();
+			for (int cascade = 0; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+				instances[cascade].clear();
+
+			for (int instanceIndex = 0; instanceIndex < instanceCount; instanceIndex++)
+			{
+				const ER_AABB& aabb = object->GetInstanceAABB(instanceIndex);
+				if (!IsIntersectingAABB(aabb, aCascadesBounds))
+					continue;
+
+				for (int cascade = 0; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+				{
+					if (IsIntersectingAABB(aabb, mWorldVoxelCascadesAABBs[cascade]))
+						instances[cascade].push_back(instancesData[instanceIndex]);
+				}
+			}
+
+			// the instance buffer of the cascade is only uploaded if its instances have changed
+			for (int cascade = 0; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+			{
+				std::vector<InstancedData>& cascadeInstances = voxelizationObject.cascadeInstances[cascade];
+				voxelizationObject.isInCascade[cascade] = !instances[cascade].empty();
+
+				if (instances[cascade].size() != cascadeInstances.size() ||
+					(!cascadeInstances.empty() && memcmp(&instances[cascade][0], &cascadeInstances[0], sizeof(InstancedData) * cascadeInstances.size()) != 0))
+				{
+					cascadeInstances.swap(instances[cascade]);
+					voxelizationObject.isCascadeInstanceBufferDirty[cascade] = true;
+				}
+			}
+		}
+	}
+
+	void ER_Illumination::ReleaseVoxelizationObjects()
+	{
+		for (auto& voxelizationObject : mVoxelizationObjects)
+		{
+			for (int cascade = 0; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+				DeleteObject(voxelizationObject.cascadeInstanceBuffers[cascade]);
+		}
+		mVoxelizationObjects.clear();
+
+		for (int cascade = 0; cascade < NUM_VOXEL_GI_CASCADES; cascade++)
+			mVoxelizationCascadesObjects[cascade].clear();
 	}
 }
\ No newline at end of file
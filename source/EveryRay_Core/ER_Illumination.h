@@ -7,6 +7,7 @@
 
 #define NUM_VOXEL_GI_CASCADES 2
 #define NUM_VOXEL_GI_TEX_MIPS 6
+#define VOXEL_GI_CULLING_MIN_INSTANCES_PER_THREAD 2048 // CPUCullObjectsAgainstVoxelCascades() is split between threads only for bigger workloads
 
 namespace EveryRay_Core
 {
@@ -142,11 +143,15 @@ namespace EveryRay_Core
 	private:
 		void DrawDeferredLighting(ER_GBuffer* gbuffer, ER_RHI_GPUTexture* aRenderTarget);
 		void DrawForwardLighting(ER_GBuffer* gbuffer, ER_RHI_GPUTexture* aRenderTarget);
+		void UpdateForwardLightingPassData();
+		const std::string& GetForwardLightingPSOName(ER_RenderingObject* aObj);
 
 		void UpdateImGui();
 		void UpdateVoxelCameraPosition();
 
 		void CPUCullObjectsAgainstVoxelCascades(const ER_Scene* scene);
+		void CPUCullVoxelizationObjects(int aBegin, int aEnd, const ER_AABB& aCascadesBounds);
+		void ReleaseVoxelizationObjects();
 
 		ER_Camera& mCamera;
 		const ER_DirectionalLight& mDirectionalLight;
@@ -158,7 +163,21 @@ namespace EveryRay_Core
 		ER_GBuffer* mGbuffer = nullptr;
 
 		using RenderingObjectInfo = std::map<std::string, ER_RenderingObject*>;
-		RenderingObjectInfo mVoxelizationObjects[NUM_VOXEL_GI_CASCADES];
+
+		// Voxelized scene object and its world-space instances that intersect every cascade (filled by CPUCullObjectsAgainstVoxelCascades())
+		struct VoxelizationObject
+		{
+			ER_RenderingObject* object = nullptr;
+			bool isInCascade[NUM_VOXEL_GI_CASCADES] = {};
+			std::vector<InstancedData> cascadeInstances[NUM_VOXEL_GI_CASCADES]; // instanced (non-indirect) objects only
+			ER_RHI_GPUBuffer* cascadeInstanceBuffers[NUM_VOXEL_GI_CASCADES] = {};
+			UINT cascadeInstanceBuffersCapacity[NUM_VOXEL_GI_CASCADES] = {};
+			bool isCascadeInstanceBufferDirty[NUM_VOXEL_GI_CASCADES] = {};
+		};
+		std::vector<VoxelizationObject> mVoxelizationObjects; // same order as in the scene
+		std::vector<int> mVoxelizationCascadesObjects[NUM_VOXEL_GI_CASCADES]; // compact lists of indices in mVoxelizationObjects, each object is submitted once per cascade
+		int mVoxelizationCascadesInstancesCount[NUM_VOXEL_GI_CASCADES] = {};
+		double mVoxelizationCullingTimeMs = 0.0;
 
 		ER_RHI_GPUConstantBuffer<IlluminationCBufferData::VoxelizationDebugCB> mVoxelizationDebugConstantBuffer;
 		ER_RHI_GPUConstantBuffer<IlluminationCBufferData::VoxelConeTracingMainCB> mVoxelConeTracingMainConstantBuffer;
@@ -260,6 +279,24 @@ namespace EveryRay_Core
 		bool mShowDebug = false;
 
 		RenderingObjectInfo mForwardPassObjects;
+
+		// Per-frame counters of the forward pass (see DrawForwardLighting())
+		struct ForwardLightingStats
+		{
+			int objectsCount = 0;
+			int batchesCount = 0; // forward lighting PSOs + standard materials
+			int psoChangesCount = 0;
+			int constantBuffersBindingsCount = 0;
+			int shaderResourcesBindingsCount = 0;
+			int skippedBindingsCount = 0; // redundant PSO/constant buffers/shader resources bindings that were not sent to the RHI
+		};
+		ForwardLightingStats mForwardLightingStats;
+		std::vector<ER_RenderingObject*> mForwardLightingBatchedObjects; // forward pass objects sorted by PSO and textures
+		std::vector<std::pair<const std::string*, ER_RenderingObject*>> mForwardStandardMaterialsBatchedObjects; // sorted by material name
+		std::vector<ER_RHI_GPUResource*> mForwardLightingResources; // shared resources (shadows, probes) are filled once per frame
+		std::string mForwardLightingCurrentPSOName;
+		ER_RenderingObject* mForwardLightingCurrentObject = nullptr; // whose constant buffers are bound
+		bool mIsForwardLightingResourcesBound = false;
 		GIQuality mCurrentGIQuality;
 	};
 }
\ No newline at end of file
@@ -18,6 +18,8 @@
 #include "ER_QuadRenderer.h"
 #include "ER_RenderToLightProbeMaterial.h"
 #include "ER_MaterialsCallbacks.h"
+#include "ER_Frustum.h"
+#include "ER_LinearArena.h"
 
 #define DIFFUSE_PROBE 0
 #define SPECULAR_PROBE 1
@@ -100,7 +102,7 @@ namespace EveryRay_Core
 
 	void ER_LightProbe::CPUCullAgainstProbeBoundingVolume(const XMFLOAT3& aMin, const XMFLOAT3& aMax)
 	{
-		mIsCulled =
+		mIsCulled = mIsSkipped ||
 			(mPosition.x > aMax.x || mPosition.x < aMin.x) ||
 			(mPosition.y > aMax.y || mPosition.y < aMin.y) ||
 			(mPosition.z > aMax.z || mPosition.z < aMin.z);
@@ -108,9 +110,6 @@ namespace EveryRay_Core
 
 	void ER_LightProbe::StoreSphericalHarmonicsFromCubemap(ER_Core& game, ER_RHI_GPUTexture* aTextureConvoluted)
 	{
-		if (game.GetRHI()->GetAPI() != ER_GRAPHICS_API::DX11)
-			throw ER_CoreException("Storing SH from cubemap is only available on DX11 at the moment.");
-
 		assert(aTextureConvoluted);
 
 		ER_RHI* rhi = game.GetRHI();
@@ -134,7 +133,7 @@ namespace EveryRay_Core
 	}
 
 	void ER_LightProbe::Compute(ER_Core& game, ER_RHI_GPUTexture* aTextureNonConvoluted, ER_RHI_GPUTexture* aTextureConvoluted,
-		ER_RHI_GPUTexture** aDepthBuffers, const std::wstring& levelPath, const LightProbeRenderingObjectsInfo& objectsToRender, ER_QuadRenderer* quadRenderer, ER_Skybox* skybox)
+		ER_RHI_GPUTexture** aDepthBuffers, const std::wstring& levelPath, const std::vector<ER_LightProbeRenderingObject>& objectsToRender, ER_QuadRenderer* quadRenderer, ER_Skybox* skybox)
 	{
 		if (game.GetRHI()->GetAPI() != ER_GRAPHICS_API::DX11)
 			throw ER_CoreException("Computing light probes is only available on DX11 at the moment.");
@@ -174,22 +173,118 @@ namespace EveryRay_Core
 		}
 	}
 
+	// Looks up the materials once, so that we do not build material names per object per face for every probe
+	void ER_LightProbe::GatherObjectsToRender(const LightProbeRenderingObjectsInfo& aObjects, int aProbeType, bool isGlobal, std::vector<ER_LightProbeRenderingObject>& aResult)
+	{
+		aResult.clear();
+
+		std::string materialNames[CUBEMAP_FACES_COUNT];
+		const std::string materialListenerName = ((aProbeType == DIFFUSE_PROBE) ? "diffuse_" : "specular_") + ER_MaterialHelper::renderToLightProbeMaterialName;
+		for (int cubeMapFaceIndex = 0; cubeMapFaceIndex < CUBEMAP_FACES_COUNT; cubeMapFaceIndex++)
+			materialNames[cubeMapFaceIndex] = materialListenerName + "_" + std::to_string(cubeMapFaceIndex);
+
+		for (auto& object : aObjects)
+		{
+			if (isGlobal && !object.second->IsUsedForGlobalLightProbeRendering())
+				continue;
+
+			if (!object.second->IsInLightProbe())
+				continue;
+
+			ER_LightProbeRenderingObject probeObject;
+			probeObject.object = object.second;
+
+			bool hasMaterials = false;
+			for (int cubeMapFaceIndex = 0; cubeMapFaceIndex < CUBEMAP_FACES_COUNT; cubeMapFaceIndex++)
+			{
+				auto materialInfo = object.second->GetMaterials().find(materialNames[cubeMapFaceIndex]);
+				if (materialInfo != object.second->GetMaterials().end())
+				{
+					probeObject.materialNames[cubeMapFaceIndex] = &materialInfo->first;
+					probeObject.materials[cubeMapFaceIndex] = materialInfo->second;
+					hasMaterials = true;
+				}
+			}
+
+			if (hasMaterials)
+				aResult.push_back(probeObject);
+		}
+	}
+
+	// Builds the visible set of the probe once: every object with the mask of the cubemap faces (frustums) it is visible in
+	void ER_LightProbe::CullObjectsPerFace(const std::vector<ER_LightProbeRenderingObject>& objectsToRender)
+	{
+		// same test as in ER_RenderingObject::PerformCPUCull()
+		auto isCulled = [](const ER_Frustum& frustum, const ER_AABB& aabb)
+		{
+			for (int planeID = 0; planeID < 6; ++planeID)
+			{
+				const XMFLOAT4& plane = frustum.Planes()[planeID];
+				XMFLOAT3 axisVert;
+				axisVert.x = (plane.x > 0.0f) ? aabb.first.x : aabb.second.x;
+				axisVert.y = (plane.y > 0.0f) ? aabb.first.y : aabb.second.y;
+				axisVert.z = (plane.z > 0.0f) ? aabb.first.z : aabb.second.z;
+
+				if (plane.x * axisVert.x + plane.y * axisVert.y + plane.z * axisVert.z + plane.w > 0.0f)
+					return true;
+			}
+			return false;
+		};
+
+		// cubemap cameras never get Update(), so their frustums are built here from the current view-projection
+		ER_ArenaVector<ER_Frustum> frustums;
+		frustums.reserve(CUBEMAP_FACES_COUNT);
+		for (int cubeMapFaceIndex = 0; cubeMapFaceIndex < CUBEMAP_FACES_COUNT; cubeMapFaceIndex++)
+			frustums.push_back(ER_Frustum(mCubemapCameras[cubeMapFaceIndex]->ViewProjectionMatrix()));
+
+		mVisibleObjects.clear();
+		mLastCulledObjectsCount = 0;
+		for (int objectIndex = 0; objectIndex < static_cast<int>(objectsToRender.size()); objectIndex++)
+		{
+			ER_RenderingObject* object = objectsToRender[objectIndex].object;
+
+			UINT facesMask = 0;
+			for (int cubeMapFaceIndex = 0; cubeMapFaceIndex < CUBEMAP_FACES_COUNT; cubeMapFaceIndex++)
+			{
+				if (!objectsToRender[objectIndex].materials[cubeMapFaceIndex])
+					continue;
+
+				bool isVisible = false;
+				if (object->IsInstanced()) // all instances are drawn, so one visible instance is enough
+				{
+					for (int instanceIndex = 0; instanceIndex < static_cast<int>(object->GetInstanceCount()) && !isVisible; instanceIndex++)
+						isVisible = !isCulled(frustums[cubeMapFaceIndex], object->GetInstanceAABB(instanceIndex));
+				}
+				else
+					isVisible = !isCulled(frustums[cubeMapFaceIndex], object->GetGlobalAABB());
+
+				if (isVisible)
+					facesMask |= (1 << cubeMapFaceIndex);
+				else
+					mLastCulledObjectsCount++;
+			}
+
+			if (facesMask)
+				mVisibleObjects.push_back(std::make_pair(objectIndex, facesMask));
+		}
+	}
+
 	void ER_LightProbe::DrawGeometryToProbe(ER_Core& game, ER_RHI_GPUTexture* aTextureNonConvoluted, ER_RHI_GPUTexture** aDepthBuffers,
-		const LightProbeRenderingObjectsInfo& objectsToRender, ER_Skybox* skybox)
+		const std::vector<ER_LightProbeRenderingObject>& objectsToRender, ER_Skybox* skybox)
 	{
 		if (game.GetRHI()->GetAPI() != ER_GRAPHICS_API::DX11)
 			throw ER_CoreException("Rendering to light probes is only available on DX11 at the moment.");
 
 		ER_RHI* rhi = game.GetRHI();
 		float clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-		bool isGlobal = (mIndex == -1);
 
-		std::string materialListenerName = ((mProbeType == DIFFUSE_PROBE) ? "diffuse_" : "specular_") + ER_MaterialHelper::renderToLightProbeMaterialName;
-		
 		ER_MaterialSystems matSystems;
 		matSystems.mDirectionalLight = mDirectionalLight;
 		matSystems.mShadowMapper = mShadowMapper;
 
+		CullObjectsPerFace(objectsToRender);
+		mLastDrawnObjectsCount = 0;
+
 		rhi->SetTopologyType(ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
 		//draw world to probe
@@ -217,25 +312,20 @@ namespace EveryRay_Core
 				// Probe P is next to object A, but object A is far from main camera => A does not have lod 0, probe P can not render A.
 				const int lod = 0;
 
-				//TODO change to culled objects per face (not a priority since we compute probes once)
-				for (auto& object : objectsToRender)
+				for (auto& visibleObject : mVisibleObjects)
 				{
-					if (isGlobal && !object.second->IsUsedForGlobalLightProbeRendering())
+					if (!(visibleObject.second & (1 << cubeMapFaceIndex)))
 						continue;
 
-					if (!object.second->IsInLightProbe())
-						continue;
-				
-					auto materialInfo = object.second->GetMaterials().find(materialListenerName + "_" + std::to_string(cubeMapFaceIndex));
-					if (materialInfo != object.second->GetMaterials().end())
+					const ER_LightProbeRenderingObject& probeObject = objectsToRender[visibleObject.first];
+					ER_Material* material = probeObject.materials[cubeMapFaceIndex];
+					for (int meshIndex = 0; meshIndex < probeObject.object->GetMeshCount(); meshIndex++)
 					{
-						for (int meshIndex = 0; meshIndex < object.second->GetMeshCount(); meshIndex++)
-						{
-							materialInfo->second->PrepareShaders();
-							static_cast<ER_RenderToLightProbeMaterial*>(materialInfo->second)->PrepareForRendering(matSystems, object.second, meshIndex, mCubemapCameras[cubeMapFaceIndex], nullptr);
-							object.second->DrawLOD(materialInfo->first, false, meshIndex, lod, true);
-						}
+						material->PrepareShaders();
+						static_cast<ER_RenderToLightProbeMaterial*>(material)->PrepareForRendering(matSystems, probeObject.object, meshIndex, mCubemapCameras[cubeMapFaceIndex], nullptr);
+						probeObject.object->DrawLOD(*probeObject.materialNames[cubeMapFaceIndex], false, meshIndex, lod, true);
 					}
+					mLastDrawnObjectsCount++;
 				}
 			}
 		}
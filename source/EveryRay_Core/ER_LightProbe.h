@@ -1,4 +1,6 @@
 #pragma once
+#define CUBEMAP_FACES_COUNT 6
+
 #include "RHI/ER_RHI.h"
 
 namespace EveryRay_Core
@@ -17,8 +19,18 @@ namespace EveryRay_Core
 	class ER_CoreTime;
 	class ER_QuadRenderer;
 	class ER_RenderingObject;
+	class ER_Material;
 	class ER_Core;
 
+	// Rendering object that can be drawn to light probes of one type, with its materials already looked up for every cubemap face.
+	// Gathered once per bake and shared by all probes of that type.
+	struct ER_LightProbeRenderingObject
+	{
+		ER_RenderingObject* object = nullptr;
+		const std::string* materialNames[CUBEMAP_FACES_COUNT] = { nullptr }; // keys in the object's materials map
+		ER_Material* materials[CUBEMAP_FACES_COUNT] = { nullptr };
+	};
+
 	class ER_LightProbe
 	{
 		using LightProbeRenderingObjectsInfo = std::vector<std::pair<std::string, ER_RenderingObject*>>;
@@ -29,7 +41,8 @@ namespace EveryRay_Core
 		void Initialize(ER_Core& game, ER_DirectionalLight* light, ER_ShadowMapper* shadowMapper, int size, int aProbeType, int index);
 
 		void Compute(ER_Core& game, ER_RHI_GPUTexture* aTextureNonConvoluted, ER_RHI_GPUTexture* aTextureConvoluted, ER_RHI_GPUTexture** aDepthBuffers,
-			const std::wstring& levelPath, const LightProbeRenderingObjectsInfo& objectsToRender, ER_QuadRenderer* quadRenderer, ER_Skybox* skybox = nullptr);
+			const std::wstring& levelPath, const std::vector<ER_LightProbeRenderingObject>& objectsToRender, ER_QuadRenderer* quadRenderer, ER_Skybox* skybox = nullptr);
+		static void GatherObjectsToRender(const LightProbeRenderingObjectsInfo& aObjects, int aProbeType, bool isGlobal, std::vector<ER_LightProbeRenderingObject>& aResult);
 		void UpdateProbe(const ER_CoreTime& gameTime);
 
 		bool LoadProbeFromDisk(ER_Core& game, const std::wstring& levelPath);
@@ -49,10 +62,19 @@ namespace EveryRay_Core
 
 		void CPUCullAgainstProbeBoundingVolume(const XMFLOAT3& aMin, const XMFLOAT3& aMax);
 		bool IsCulled() { return mIsCulled; }
+
+		// skipped probes (sparse grid) are never loaded, computed or used in cells and always stay culled
+		void SetSkipped(bool value) { mIsSkipped = value; mIsCulled = value; }
+		bool IsSkipped() { return mIsSkipped; }
+
+		// stats of the last computation (summed over all faces)
+		UINT GetLastDrawnObjectsCount() { return mLastDrawnObjectsCount; }
+		UINT GetLastCulledObjectsCount() { return mLastCulledObjectsCount; }
 	private:
 		void StoreSphericalHarmonicsFromCubemap(ER_Core& game, ER_RHI_GPUTexture* aTextureConvoluted);
 		void SaveProbeOnDisk(ER_Core& game, const std::wstring& levelPath, ER_RHI_GPUTexture* aTextureConvoluted);
-		void DrawGeometryToProbe(ER_Core& game, ER_RHI_GPUTexture* aTextureNonConvoluted, ER_RHI_GPUTexture** aDepthBuffers, const LightProbeRenderingObjectsInfo& objectsToRender, ER_Skybox* skybox);
+		void DrawGeometryToProbe(ER_Core& game, ER_RHI_GPUTexture* aTextureNonConvoluted, ER_RHI_GPUTexture** aDepthBuffers, const std::vector<ER_LightProbeRenderingObject>& objectsToRender, ER_Skybox* skybox);
+		void CullObjectsPerFace(const std::vector<ER_LightProbeRenderingObject>& objectsToRender);
 		void ConvoluteProbe(ER_Core& game, ER_QuadRenderer* quadRenderer, ER_RHI_GPUTexture* aTextureNonConvoluted, ER_RHI_GPUTexture* aTextureConvoluted);
 		std::wstring GetConstructedProbeName(const std::wstring& levelPath, bool inSphericalHarmonics = false);
 
@@ -61,8 +83,10 @@ namespace EveryRay_Core
 		ER_DirectionalLight* mDirectionalLight = nullptr;
 		ER_ShadowMapper* mShadowMapper = nullptr;
 
-		LightProbeRenderingObjectsInfo mObjectsToRenderPerFace[6];
-		ER_Camera* mCubemapCameras[6] = { nullptr };
+		std::vector<std::pair<int, UINT>> mVisibleObjects; // index in the gathered objects, mask of the cubemap faces the object is visible in
+		UINT mLastDrawnObjectsCount = 0;
+		UINT mLastCulledObjectsCount = 0;
+		ER_Camera* mCubemapCameras[CUBEMAP_FACES_COUNT] = { nullptr };
 
 		ER_RHI_GPUTexture* mCubemapTexture = nullptr; // for regular diffuse probe it should be null (because we use SH)
 		ER_RHI_GPUConstantBuffer<LightProbeCBufferData::ProbeConvolutionCB> mConvolutionCB;
@@ -77,5 +101,6 @@ namespace EveryRay_Core
 		bool mIsProbeLoadedFromDisk = false;
 		bool mIsComputed = false;
 		bool mIsCulled = false;
+		bool mIsSkipped = false;
 	};
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "ER_LightProbesManager.h"
 #include "ER_Core.h"
 #include "ER_CoreTime.h"
@@ -9,6 +11,7 @@
 #include "ER_VectorHelper.h"
 #include "ER_RenderingObject.h"
 #include "ER_Model.h"
+#include "ER_Mesh.h"
 #include "ER_Scene.h"
 #include "ER_RenderableAABB.h"
 #include "ER_QuadRenderer.h"
@@ -51,7 +54,7 @@ namespace EveryRay_Core
 			mTempSpecularCubemapDepthBuffers[i]->CreateGPUTextureResource(rhi, SPECULAR_PROBE_SIZE, SPECULAR_PROBE_SIZE, 1u, ER_FORMAT_D24_UNORM_S8_UINT, ER_BIND_SHADER_RESOURCE | ER_BIND_DEPTH_STENCIL);
 		}
 
-		mQuadRenderer = (ER_QuadRenderer*)game.GetServices().FindService(ER_QuadRenderer::TypeIdClass());
+		mQuadRenderer = game.GetServices().FindService<ER_QuadRenderer>();
 		assert(mQuadRenderer);
 		mConvolutionPS = rhi->CreateGPUShader();
 		mConvolutionPS->CompileShader(rhi, "content\\shaders\\IBL\\ProbeConvolution.hlsl", "PSMain", ER_PIXEL);
@@ -150,6 +153,8 @@ namespace EveryRay_Core
 
 		SetupGlobalDiffuseProbe(core, camera, scene, light, shadowMapper);
 
+		auto setupStartTime = std::chrono::high_resolution_clock::now();
+
 		mDiffuseProbesCountX = (maxBounds.x - minBounds.x) / mDistanceBetweenDiffuseProbes + 1;
 		mDiffuseProbesCountY = (maxBounds.y - minBounds.y) / mDistanceBetweenDiffuseProbes + 1;
 		mDiffuseProbesCountZ = (maxBounds.z - minBounds.z) / mDistanceBetweenDiffuseProbes + 1;
@@ -167,9 +172,7 @@ namespace EveryRay_Core
 		assert(mDiffuseProbesCellsCountTotal);
 
 		float probeCellPositionOffset = static_cast<float>(mDistanceBetweenDiffuseProbes) / 2.0f;
-		mDiffuseProbesCellBounds = {
-			XMFLOAT3(-probeCellPositionOffset, -probeCellPositionOffset, -probeCellPositionOffset),
-			XMFLOAT3(probeCellPositionOffset, probeCellPositionOffset, probeCellPositionOffset) };
+		mDiffuseProbesCellsIndices.assign(mDiffuseProbesCellsCountTotal * PROBE_COUNT_PER_CELL, -1);
 		{
 			for (int cellsY = 0; cellsY < mDiffuseProbesCellsCountY; cellsY++)
 			{
@@ -193,6 +196,8 @@ namespace EveryRay_Core
 		// simple 3D grid distribution of probes
 		for (size_t i = 0; i < mDiffuseProbesCountTotal; i++)
 			mDiffuseProbes.emplace_back(core, light, shadowMapper, DIFFUSE_PROBE_SIZE, DIFFUSE_PROBE, i);
+		if (scene->IsLightProbesGridSparse())
+			SkipProbesForSparseGrid(scene, DIFFUSE_PROBE);
 
 		for (int probesY = 0; probesY < mDiffuseProbesCountY; probesY++)
 		{
@@ -207,7 +212,8 @@ namespace EveryRay_Core
 					int index = probesY * (mDiffuseProbesCountX * mDiffuseProbesCountZ) + probesX * mDiffuseProbesCountZ + probesZ;
 					mDiffuseProbes[index].SetPosition(pos);
 					mDiffuseProbes[index].SetShaderInfoForConvolution(mConvolutionPS);
-					AddProbeToCells(mDiffuseProbes[index], DIFFUSE_PROBE, minBounds, maxBounds);
+					if (!mDiffuseProbes[index].IsSkipped())
+						AddProbeToCells(index, probesX, probesY, probesZ, DIFFUSE_PROBE);
 				}
 			}
 		}
@@ -220,21 +226,15 @@ namespace EveryRay_Core
 		mDiffuseProbesPositionsGPUBuffer->CreateGPUBufferResource(rhi, diffuseProbesPositionsCPUBuffer, mDiffuseProbesCountTotal, sizeof(XMFLOAT3), false, ER_BIND_SHADER_RESOURCE, 0, ER_RESOURCE_MISC_BUFFER_STRUCTURED);
 		DeleteObjects(diffuseProbesPositionsCPUBuffer);
 
-		// probe cell's indices GPU buffer, tex. array indices GPU/CPU buffers
-		int* diffuseProbeCellsIndicesCPUBuffer = new int[mDiffuseProbesCellsCountTotal * PROBE_COUNT_PER_CELL];
-		for (int probeIndex = 0; probeIndex < mDiffuseProbesCellsCountTotal; probeIndex++)
-		{
-			for (int indices = 0; indices < PROBE_COUNT_PER_CELL; indices++)
-			{
-				if (indices >= mDiffuseProbesCells[probeIndex].lightProbeIndices.size())
-					diffuseProbeCellsIndicesCPUBuffer[probeIndex * PROBE_COUNT_PER_CELL + indices] = -1;
-				else
-					diffuseProbeCellsIndicesCPUBuffer[probeIndex * PROBE_COUNT_PER_CELL + indices] = mDiffuseProbesCells[probeIndex].lightProbeIndices[indices];
-			}
-		}
+		// probe cell's indices GPU buffer (flat array from the cells setup)
 		mDiffuseProbesCellsIndicesGPUBuffer = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: diffuse probes cells indices buffer");
-		mDiffuseProbesCellsIndicesGPUBuffer->CreateGPUBufferResource(rhi, diffuseProbeCellsIndicesCPUBuffer, mDiffuseProbesCellsCountTotal * PROBE_COUNT_PER_CELL, sizeof(int), false, ER_BIND_SHADER_RESOURCE, 0, ER_RESOURCE_MISC_BUFFER_STRUCTURED);
-		DeleteObjects(diffuseProbeCellsIndicesCPUBuffer);
+		mDiffuseProbesCellsIndicesGPUBuffer->CreateGPUBufferResource(rhi, mDiffuseProbesCellsIndices.data(), mDiffuseProbesCellsCountTotal * PROBE_COUNT_PER_CELL, sizeof(int), false, ER_BIND_SHADER_RESOURCE, 0, ER_RESOURCE_MISC_BUFFER_STRUCTURED);
+
+		auto setupEndTime = std::chrono::high_resolution_clock::now();
+		std::wstring msg = L"[ER Logger][ER_LightProbesManager] Diffuse probes grid setup: " + std::to_wstring(mDiffuseProbesCountTotal - mDiffuseProbesSkippedCount) + L"/" +
+			std::to_wstring(mDiffuseProbesCountTotal) + L" probes (" + std::to_wstring(mDiffuseProbesSkippedCount) + L" skipped), " + std::to_wstring(mDiffuseProbesCellsCountTotal) + L" cells in " +
+			std::to_wstring(std::chrono::duration<double, std::milli>(setupEndTime - setupStartTime).count()) + L" ms\n";
+		ER_OUTPUT_LOG(msg.c_str());
 		
 		std::string name = "Debug diffuse lightprobes ";
 		scene->objects.emplace_back(name, new ER_RenderingObject(name, scene->objects.size(), core, camera,
@@ -272,6 +272,8 @@ namespace EveryRay_Core
 		
 		SetupGlobalSpecularProbe(game, camera, scene, light, shadowMapper);
 
+		auto setupStartTime = std::chrono::high_resolution_clock::now();
+
 		mSpecularProbesCountX = (maxBounds.x - minBounds.x) / mDistanceBetweenSpecularProbes + 1;
 		mSpecularProbesCountY = (maxBounds.y - minBounds.y) / mDistanceBetweenSpecularProbes + 1;
 		mSpecularProbesCountZ = (maxBounds.z - minBounds.z) / mDistanceBetweenSpecularProbes + 1;
@@ -288,9 +290,7 @@ namespace EveryRay_Core
 		assert(mSpecularProbesCellsCountTotal);
 
 		float probeCellPositionOffset = static_cast<float>(mDistanceBetweenSpecularProbes) / 2.0f;
-		mSpecularProbesCellBounds = {
-			XMFLOAT3(-probeCellPositionOffset, -probeCellPositionOffset, -probeCellPositionOffset),
-			XMFLOAT3(probeCellPositionOffset, probeCellPositionOffset, probeCellPositionOffset) };
+		mSpecularProbesCellsIndices.assign(mSpecularProbesCellsCountTotal * PROBE_COUNT_PER_CELL, -1);
 		
 		for (int cellsY = 0; cellsY < mSpecularProbesCellsCountY; cellsY++)
 		{
@@ -313,6 +313,8 @@ namespace EveryRay_Core
 		// simple 3D grid distribution of probes
 		for (size_t i = 0; i < mSpecularProbesCountTotal; i++)
 			mSpecularProbes.emplace_back(game, light, shadowMapper, SPECULAR_PROBE_SIZE, SPECULAR_PROBE, i);
+		if (scene->IsLightProbesGridSparse())
+			SkipProbesForSparseGrid(scene, SPECULAR_PROBE);
 
 		for (int probesY = 0; probesY < mSpecularProbesCountY; probesY++)
 		{
@@ -328,7 +330,8 @@ namespace EveryRay_Core
 					//mSpecularProbes[index]->SetIndex(index);
 					mSpecularProbes[index].SetPosition(pos);
 					mSpecularProbes[index].SetShaderInfoForConvolution(mConvolutionPS);
-					AddProbeToCells(mSpecularProbes[index], SPECULAR_PROBE, minBounds, maxBounds);
+					if (!mSpecularProbes[index].IsSkipped())
+						AddProbeToCells(index, probesX, probesY, probesZ, SPECULAR_PROBE);
 				}
 			}
 		}
@@ -341,23 +344,19 @@ namespace EveryRay_Core
 		mSpecularProbesPositionsGPUBuffer->CreateGPUBufferResource(rhi, specularProbesPositionsCPUBuffer, mSpecularProbesCountTotal, sizeof(XMFLOAT3), false, ER_BIND_SHADER_RESOURCE, 0, ER_RESOURCE_MISC_BUFFER_STRUCTURED);
 		DeleteObjects(specularProbesPositionsCPUBuffer);
 
-		// probe cell's indices GPU buffer, tex. array indices GPU/CPU buffers
-		int* specularProbeCellsIndicesCPUBuffer = new int[mSpecularProbesCellsCountTotal * PROBE_COUNT_PER_CELL];
-		for (int probeIndex = 0; probeIndex < mSpecularProbesCellsCountTotal; probeIndex++)
-		{
-			for (int indices = 0; indices < PROBE_COUNT_PER_CELL; indices++)
-			{
-				if (indices >= mSpecularProbesCells[probeIndex].lightProbeIndices.size())
-					specularProbeCellsIndicesCPUBuffer[probeIndex * PROBE_COUNT_PER_CELL + indices] = -1;
-				else
-					specularProbeCellsIndicesCPUBuffer[probeIndex * PROBE_COUNT_PER_CELL + indices] = mSpecularProbesCells[probeIndex].lightProbeIndices[indices];
-			}
-		}
+		// probe cell's indices GPU buffer (flat array from the cells setup)
 		mSpecularProbesCellsIndicesGPUBuffer = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: specular probes cells indices buffer");
-		mSpecularProbesCellsIndicesGPUBuffer->CreateGPUBufferResource(rhi, specularProbeCellsIndicesCPUBuffer,	mSpecularProbesCellsCountTotal * PROBE_COUNT_PER_CELL, sizeof(int), false, ER_BIND_SHADER_RESOURCE, 0, ER_RESOURCE_MISC_BUFFER_STRUCTURED);
-		DeleteObjects(specularProbeCellsIndicesCPUBuffer);
+		mSpecularProbesCellsIndicesGPUBuffer->CreateGPUBufferResource(rhi, mSpecularProbesCellsIndices.data(), mSpecularProbesCellsCountTotal * PROBE_COUNT_PER_CELL, sizeof(int), false, ER_BIND_SHADER_RESOURCE, 0, ER_RESOURCE_MISC_BUFFER_STRUCTURED);
+
+		auto setupEndTime = std::chrono::high_resolution_clock::now();
+		std::wstring msg = L"[ER Logger][ER_LightProbesManager] Specular probes grid setup: " + std::to_wstring(mSpecularProbesCountTotal - mSpecularProbesSkippedCount) + L"/" +
+			std::to_wstring(mSpecularProbesCountTotal) + L" probes (" + std::to_wstring(mSpecularProbesSkippedCount) + L" skipped), " + std::to_wstring(mSpecularProbesCellsCountTotal) + L" cells in " +
+			std::to_wstring(std::chrono::duration<double, std::milli>(setupEndTime - setupStartTime).count()) + L" ms\n";
+		ER_OUTPUT_LOG(msg.c_str());
 
 		mSpecularProbesTexArrayIndicesCPUBuffer = new int[mSpecularProbesCountTotal];
+		for (int i = 0; i < mSpecularProbesCountTotal; i++)
+			mSpecularProbesTexArrayIndicesCPUBuffer[i] = -1;
 		mSpecularProbesTexArrayIndicesGPUBuffer = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: specular probes texture array indices buffer");
 		mSpecularProbesTexArrayIndicesGPUBuffer->CreateGPUBufferResource(rhi, mSpecularProbesTexArrayIndicesCPUBuffer, mSpecularProbesCountTotal, sizeof(int), true, ER_BIND_SHADER_RESOURCE, 0, ER_RESOURCE_MISC_BUFFER_STRUCTURED);
 
@@ -383,35 +382,256 @@ namespace EveryRay_Core
 
 		mSpecularCubemapArrayRT = rhi->CreateGPUTexture(L"ER_RHI_GPUTexture: Specular Cubemap Array RT");
 		mSpecularCubemapArrayRT->CreateGPUTextureResource(rhi, SPECULAR_PROBE_SIZE, SPECULAR_PROBE_SIZE, 1, ER_FORMAT_R8G8B8A8_UNORM, ER_BIND_SHADER_RESOURCE, SPECULAR_PROBE_MIP_COUNT, -1, CUBEMAP_FACES_COUNT, true, mMaxSpecularProbesInVolumeCount);
+
+		mSpecularProbesResidentSlots.assign(mMaxSpecularProbesInVolumeCount, -1);
+		mSpecularProbesFreeSlots.clear();
+		for (int slot = mMaxSpecularProbesInVolumeCount - 1; slot >= 0; slot--)
+			mSpecularProbesFreeSlots.push_back(slot);
 	}
 
-	void ER_LightProbesManager::AddProbeToCells(ER_LightProbe& aProbe, ER_ProbeType aType, const XMFLOAT3& minBounds, const XMFLOAT3& maxBounds)
+	// Analytical assignment: a probe at grid coordinates (x, y, z) is a corner of the cells (x - 1..x, y - 1..y, z - 1..z)
+	void ER_LightProbesManager::AddProbeToCells(int aProbeIndex, int aProbeX, int aProbeY, int aProbeZ, ER_ProbeType aType)
 	{
-		int index = aProbe.GetIndex();
-		if (aType == DIFFUSE_PROBE)
+		std::vector<ER_LightProbeCell>& cells = (aType == DIFFUSE_PROBE) ? mDiffuseProbesCells : mSpecularProbesCells;
+		std::vector<int>& cellsIndices = (aType == DIFFUSE_PROBE) ? mDiffuseProbesCellsIndices : mSpecularProbesCellsIndices;
+		const int cellsCountX = (aType == DIFFUSE_PROBE) ? mDiffuseProbesCellsCountX : mSpecularProbesCellsCountX;
+		const int cellsCountY = (aType == DIFFUSE_PROBE) ? mDiffuseProbesCellsCountY : mSpecularProbesCellsCountY;
+		const int cellsCountZ = (aType == DIFFUSE_PROBE) ? mDiffuseProbesCellsCountZ : mSpecularProbesCellsCountZ;
+
+		for (int cornerY = 0; cornerY <= 1; cornerY++)
 		{
-			// brute force O(cells * probes)
-			for (auto& cell : mDiffuseProbesCells)
+			const int cellY = aProbeY - cornerY;
+			if (cellY < 0 || cellY >= cellsCountY)
+				continue;
+
+			for (int cornerX = 0; cornerX <= 1; cornerX++)
 			{
-				if (IsProbeInCell(aProbe, cell, mDiffuseProbesCellBounds))
-					cell.lightProbeIndices.push_back(index);
+				const int cellX = aProbeX - cornerX;
+				if (cellX < 0 || cellX >= cellsCountX)
+					continue;
 
-				if (cell.lightProbeIndices.size() > PROBE_COUNT_PER_CELL)
-					throw ER_CoreException("Too many diffuse probes per cell!");
+				for (int cornerZ = 0; cornerZ <= 1; cornerZ++)
+				{
+					const int cellZ = aProbeZ - cornerZ;
+					if (cellZ < 0 || cellZ >= cellsCountZ)
+						continue;
+
+					// same order of the corners as the probes were pushed to the cell before (by the index of the probe), which the shaders rely on
+					const int cellIndex = cellY * (cellsCountX * cellsCountZ) + cellX * cellsCountZ + cellZ;
+					const int slot = (cornerY << 2) | (cornerX << 1) | cornerZ;
+					cellsIndices[cellIndex * PROBE_COUNT_PER_CELL + slot] = aProbeIndex;
+					cells[cellIndex].probesCount++;
+				}
 			}
 		}
-		else
+	}
+
+	// Marks the probes of the grid that can not contribute to the lighting as skipped:
+	// 1) probes outside of the level (bounds of all rendering objects used in probes + the distance between probes)
+	// 2) probes inside solid geometry: 6 axis-aligned rays are cast from every probe and the probe is skipped if enough of them hit back faces first.
+	//    Rays of the probes on the same grid row are traced together: triangles are intersected with the rows they overlap and the hits are then swept along the row,
+	//    so the cost is O(triangles + probes) instead of O(triangles * probes).
+	void ER_LightProbesManager::SkipProbesForSparseGrid(ER_Scene* scene, ER_ProbeType aType)
+	{
+		std::vector<ER_LightProbe>& probes = (aType == DIFFUSE_PROBE) ? mDiffuseProbes : mSpecularProbes;
+		int& skippedCount = (aType == DIFFUSE_PROBE) ? mDiffuseProbesSkippedCount : mSpecularProbesSkippedCount;
+		const float distance = (aType == DIFFUSE_PROBE) ? mDistanceBetweenDiffuseProbes : mDistanceBetweenSpecularProbes;
+		const int counts[3] = {
+			(aType == DIFFUSE_PROBE) ? mDiffuseProbesCountX : mSpecularProbesCountX,
+			(aType == DIFFUSE_PROBE) ? mDiffuseProbesCountY : mSpecularProbesCountY,
+			(aType == DIFFUSE_PROBE) ? mDiffuseProbesCountZ : mSpecularProbesCountZ };
+		const float gridMin[3] = { mSceneProbesMinBounds.x, mSceneProbesMinBounds.y, mSceneProbesMinBounds.z };
+		const float gridMax[3] = {
+			gridMin[0] + (counts[0] - 1) * distance,
+			gridMin[1] + (counts[1] - 1) * distance,
+			gridMin[2] + (counts[2] - 1) * distance };
+
+		// grid index of the probe (same layout as in the setup: y, x, z)
+		auto getProbeIndex = [&](const int coords[3]) { return coords[1] * (counts[0] * counts[2]) + coords[0] * counts[2] + coords[2]; };
+
+		// hit of a row of probes along the axis: coordinate on the axis and the direction of the normal
+		struct RowHit
 		{
-			// brute force O(cells * probes)
-			for (auto& cell : mSpecularProbesCells)
+			float coordinate;
+			bool isFacingPositive;
+			bool operator<(const RowHit& other) const { return coordinate < other.coordinate; }
+		};
+		// rows along every axis ('a'), indexed by the probe coordinates on the other two axes ('u', 'v')
+		std::vector<std::vector<RowHit>> rowHits[3];
+		for (int a = 0; a < 3; a++)
+			rowHits[a].resize(counts[(a + 1) % 3] * counts[(a + 2) % 3]);
+
+		XMFLOAT3 levelMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 levelMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+		auto addTriangle = [&](const XMFLOAT3 vertices[3], const XMFLOAT3& normal)
+		{
+			const float p[3][3] = {
+				{ vertices[0].x, vertices[0].y, vertices[0].z },
+				{ vertices[1].x, vertices[1].y, vertices[1].z },
+				{ vertices[2].x, vertices[2].y, vertices[2].z } };
+			const float n[3] = { normal.x, normal.y, normal.z };
+
+			for (int a = 0; a < 3; a++)
 			{
-				if (IsProbeInCell(aProbe, cell, mSpecularProbesCellBounds))
-					cell.lightProbeIndices.push_back(index);
+				const int u = (a + 1) % 3;
+				const int v = (a + 2) % 3;
+
+				// triangle in the plane of the rows (u, v)
+				const float area = (p[1][u] - p[0][u]) * (p[2][v] - p[0][v]) - (p[2][u] - p[0][u]) * (p[1][v] - p[0][v]);
+				if (fabs(area) < 1e-8f)
+					continue; // parallel to the rows
+
+				const float minU = std::min(p[0][u], std::min(p[1][u], p[2][u]));
+				const float maxU = std::max(p[0][u], std::max(p[1][u], p[2][u]));
+				const float minV = std::min(p[0][v], std::min(p[1][v], p[2][v]));
+				const float maxV = std::max(p[0][v], std::max(p[1][v], p[2][v]));
+				const int firstU = std::max(0, static_cast<int>(ceil((minU - gridMin[u]) / distance)));
+				const int lastU = std::min(counts[u] - 1, static_cast<int>(floor((maxU - gridMin[u]) / distance)));
+				const int firstV = std::max(0, static_cast<int>(ceil((minV - gridMin[v]) / distance)));
+				const int lastV = std::min(counts[v] - 1, static_cast<int>(floor((maxV - gridMin[v]) / distance)));
+
+				for (int rowU = firstU; rowU <= lastU; rowU++)
+				{
+					const float pu = gridMin[u] + rowU * distance;
+					for (int rowV = firstV; rowV <= lastV; rowV++)
+					{
+						const float pv = gridMin[v] + rowV * distance;
+
+						// barycentrics of the row in the triangle
+						const float w1 = ((pu - p[0][u]) * (p[2][v] - p[0][v]) - (p[2][u] - p[0][u]) * (pv - p[0][v])) / area;
+						const float w2 = ((p[1][u] - p[0][u]) * (pv - p[0][v]) - (pu - p[0][u]) * (p[1][v] - p[0][v])) / area;
+						if (w1 < 0.0f || w2 < 0.0f || w1 + w2 > 1.0f)
+							continue;
+
+						const float coordinate = p[0][a] + w1 * (p[1][a] - p[0][a]) + w2 * (p[2][a] - p[0][a]);
+						rowHits[a][rowU * counts[v] + rowV].push_back({ coordinate, n[a] > 0.0f });
+					}
+				}
+			}
+		};
+
+		for (auto& sceneObject : scene->objects)
+		{
+			ER_RenderingObject* object = sceneObject.second;
+			if (!object || !object->IsInLightProbe() || !object->GetModel())
+				continue;
 
-				if (cell.lightProbeIndices.size() > PROBE_COUNT_PER_CELL)
-					throw ER_CoreException("Too many specular probes per cell!");
+			std::vector<XMMATRIX> transforms;
+			if (object->IsInstanced())
+			{
+				for (auto& instance : object->GetInstancesData())
+					transforms.push_back(XMLoadFloat4x4(&instance.World));
+			}
+			else
+				transforms.push_back(object->GetTransformationMatrix());
+
+			const ER_AABB& localAABB = object->GetLocalAABB();
+			for (auto& transform : transforms)
+			{
+				// world AABB of the object (or the instance)
+				XMFLOAT3 worldMin = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+				XMFLOAT3 worldMax = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				for (int corner = 0; corner < 8; corner++)
+				{
+					XMFLOAT3 point;
+					XMStoreFloat3(&point, XMVector3Transform(XMVectorSet(
+						(corner & 1) ? localAABB.second.x : localAABB.first.x,
+						(corner & 2) ? localAABB.second.y : localAABB.first.y,
+						(corner & 4) ? localAABB.second.z : localAABB.first.z, 1.0f), transform));
+					worldMin = XMFLOAT3(std::min(worldMin.x, point.x), std::min(worldMin.y, point.y), std::min(worldMin.z, point.z));
+					worldMax = XMFLOAT3(std::max(worldMax.x, point.x), std::max(worldMax.y, point.y), std::max(worldMax.z, point.z));
+				}
+				levelMin = XMFLOAT3(std::min(levelMin.x, worldMin.x), std::min(levelMin.y, worldMin.y), std::min(levelMin.z, worldMin.z));
+				levelMax = XMFLOAT3(std::max(levelMax.x, worldMax.x), std::max(levelMax.y, worldMax.y), std::max(levelMax.z, worldMax.z));
+
+				if (worldMax.x < gridMin[0] || worldMin.x > gridMax[0] ||
+					worldMax.y < gridMin[1] || worldMin.y > gridMax[1] ||
+					worldMax.z < gridMin[2] || worldMin.z > gridMax[2])
+					continue;
+
+				for (auto& mesh : object->GetModel()->Meshes())
+				{
+					const std::vector<XMFLOAT3>& meshVertices = mesh.Vertices();
+					const std::vector<XMFLOAT3>& meshNormals = mesh.Normals();
+					const std::vector<UINT>& meshIndices = mesh.Indices();
+					if (meshNormals.size() != meshVertices.size())
+						continue; // can't tell back faces without normals
+
+					for (size_t i = 0; i + 2 < meshIndices.size(); i += 3)
+					{
+						XMFLOAT3 vertices[3];
+						XMVECTOR normal = XMVectorZero();
+						for (int j = 0; j < 3; j++)
+						{
+							const UINT index = meshIndices[i + j];
+							XMStoreFloat3(&vertices[j], XMVector3Transform(XMLoadFloat3(&meshVertices[index]), transform));
+							normal = XMVectorAdd(normal, XMVector3TransformNormal(XMLoadFloat3(&meshNormals[index]), transform));
+						}
+						XMFLOAT3 triangleNormal;
+						XMStoreFloat3(&triangleNormal, normal);
+						addTriangle(vertices, triangleNormal);
+					}
+				}
+			}
+		}
+
+		if (levelMin.x > levelMax.x)
+			return; // nothing in the level to test against
+
+		// closest hit of the rays in both directions of every row
+		std::vector<UINT8> backFaceHits(probes.size(), 0);
+		for (int a = 0; a < 3; a++)
+		{
+			const int u = (a + 1) % 3;
+			const int v = (a + 2) % 3;
+			for (int rowU = 0; rowU < counts[u]; rowU++)
+			{
+				for (int rowV = 0; rowV < counts[v]; rowV++)
+				{
+					std::vector<RowHit>& hits = rowHits[a][rowU * counts[v] + rowV];
+					if (hits.empty())
+						continue;
+					std::sort(hits.begin(), hits.end());
+
+					int coords[3];
+					coords[u] = rowU;
+					coords[v] = rowV;
+					size_t nextHit = 0;
+					for (coords[a] = 0; coords[a] < counts[a]; coords[a]++)
+					{
+						const float probeCoordinate = gridMin[a] + coords[a] * distance;
+						while (nextHit < hits.size() && hits[nextHit].coordinate <= probeCoordinate)
+							nextHit++;
+
+						UINT8& probeBackFaceHits = backFaceHits[getProbeIndex(coords)];
+						if (nextHit < hits.size() && hits[nextHit].isFacingPositive) // ray in the positive direction
+							probeBackFaceHits++;
+						if (nextHit > 0 && !hits[nextHit - 1].isFacingPositive) // ray in the negative direction
+							probeBackFaceHits++;
+					}
+				}
 			}
 		}
+
+		skippedCount = 0;
+		for (int probeIndex = 0; probeIndex < static_cast<int>(probes.size()); probeIndex++)
+		{
+			const int y = probeIndex / (counts[0] * counts[2]);
+			const int x = (probeIndex / counts[2]) % counts[0];
+			const int z = probeIndex % counts[2];
+			const XMFLOAT3 pos = XMFLOAT3(gridMin[0] + x * distance, gridMin[1] + y * distance, gridMin[2] + z * distance);
+
+			const bool isOutsideOfLevel =
+				pos.x < levelMin.x - distance || pos.x > levelMax.x + distance ||
+				pos.y < levelMin.y - distance || pos.y > levelMax.y + distance ||
+				pos.z < levelMin.z - distance || pos.z > levelMax.z + distance;
+			const bool isInsideGeometry = backFaceHits[probeIndex] >= LIGHT_PROBES_SPARSE_MIN_BACK_FACE_HITS;
+
+			probes[probeIndex].SetSkipped(isOutsideOfLevel || isInsideGeometry);
+			if (probes[probeIndex].IsSkipped())
+				skippedCount++;
+		}
 	}
 
 	// Fast uniform-grid searching approach (WARNING: can not do multiple indices per pos. (i.e., when pos. is on the edge of several cells))
@@ -484,26 +704,6 @@ namespace EveryRay_Core
 			return XMFLOAT4(mSpecularProbesCellsCountX, mSpecularProbesCellsCountY, mSpecularProbesCellsCountZ, mSpecularProbesCellsCountTotal);
 	}
 
-	bool ER_LightProbesManager::IsProbeInCell(ER_LightProbe& aProbe, ER_LightProbeCell& aCell, ER_AABB& aCellBounds)
-	{
-		XMFLOAT3 pos = aProbe.GetPosition();
-		float epsilon = 0.00001f;
-
-		XMFLOAT3 maxBounds = XMFLOAT3(
-			aCellBounds.second.x + aCell.position.x,
-			aCellBounds.second.y + aCell.position.y,
-			aCellBounds.second.z + aCell.position.z);
-
-		XMFLOAT3 minBounds = XMFLOAT3(
-			aCellBounds.first.x + aCell.position.x,
-			aCellBounds.first.y + aCell.position.y,
-			aCellBounds.first.z + aCell.position.z);
-
-		return	(pos.x <= (maxBounds.x + epsilon) && pos.x >= (minBounds.x - epsilon)) &&
-				(pos.y <= (maxBounds.y + epsilon) && pos.y >= (minBounds.y - epsilon)) &&
-				(pos.z <= (maxBounds.z + epsilon) && pos.z >= (minBounds.z - epsilon));
-	}
-
 	void ER_LightProbesManager::ComputeOrLoadGlobalProbes(ER_Core& game, ProbesRenderingObjectsInfo& aObjects, ER_Skybox* skybox)
 	{
 		assert(skybox);
@@ -517,7 +717,11 @@ namespace EveryRay_Core
 			if (!mGlobalDiffuseProbe->LoadProbeFromDisk(game, diffuseProbesPath))
 			{
 				if (game.GetRHI()->GetAPI() == ER_GRAPHICS_API::DX11)
-					mGlobalDiffuseProbe->Compute(game, mTempDiffuseCubemapFacesRT, mTempDiffuseCubemapFacesConvolutedRT, mTempDiffuseCubemapDepthBuffers, diffuseProbesPath, aObjects, mQuadRenderer, skybox);
+				{
+					std::vector<ER_LightProbeRenderingObject> objectsToRender;
+					ER_LightProbe::GatherObjectsToRender(aObjects, DIFFUSE_PROBE, true, objectsToRender);
+					mGlobalDiffuseProbe->Compute(game, mTempDiffuseCubemapFacesRT, mTempDiffuseCubemapFacesConvolutedRT, mTempDiffuseCubemapDepthBuffers, diffuseProbesPath, objectsToRender, mQuadRenderer, skybox);
+				}
 				else
 					throw ER_CoreException("ER_LightProbesManager: Computing & saving the probes is only possible on DX11 at the moment");
 			}
@@ -534,7 +738,11 @@ namespace EveryRay_Core
 			if (!mGlobalSpecularProbe->LoadProbeFromDisk(game, specularProbesPath))
 			{
 				if (game.GetRHI()->GetAPI() == ER_GRAPHICS_API::DX11)
-					mGlobalSpecularProbe->Compute(game, mTempSpecularCubemapFacesRT, mTempSpecularCubemapFacesConvolutedRT, mTempSpecularCubemapDepthBuffers, specularProbesPath, aObjects, mQuadRenderer, skybox);
+				{
+					std::vector<ER_LightProbeRenderingObject> objectsToRender;
+					ER_LightProbe::GatherObjectsToRender(aObjects, SPECULAR_PROBE, true, objectsToRender);
+					mGlobalSpecularProbe->Compute(game, mTempSpecularCubemapFacesRT, mTempSpecularCubemapFacesConvolutedRT, mTempSpecularCubemapDepthBuffers, specularProbesPath, objectsToRender, mQuadRenderer, skybox);
+				}
 				else
 					throw ER_CoreException("ER_LightProbesManager: Computing & saving the probes is only possible on DX11 at the moment");
 			}
@@ -549,49 +757,15 @@ namespace EveryRay_Core
 	{
 		ER_RHI* rhi = game.GetRHI();
 
-		int numThreads = std::thread::hardware_concurrency();
-		if (game.GetRHI()->GetAPI() != ER_GRAPHICS_API::DX11)
-			numThreads = 1; //TODO fix this on DX12 (need to support multiple command lists)
-
-		assert(numThreads > 0);
-
 		if (mDistanceBetweenDiffuseProbes <= 0.0)
 			mDiffuseProbesReady = true;
 
 		if (!mDiffuseProbesReady && mDistanceBetweenDiffuseProbes > 0)
 		{
 			std::wstring diffuseProbesPath = mLevelPath + L"diffuse_probes\\";
-			
-			std::vector<std::thread> threads;
-			threads.reserve(numThreads);
+			LoadProbesFromDisk(game, mDiffuseProbes, DIFFUSE_PROBE, diffuseProbesPath);
 
-			int probesPerThread = mDiffuseProbes.size() / numThreads;
-
-			for (int i = 0; i < numThreads; i++)
-			{
-				threads.push_back(std::thread([&, diffuseProbesPath, i]
-				{ 
-					int endRange = (i < numThreads - 1) ? (i + 1) * probesPerThread : mDiffuseProbes.size();
-					for (int j = i * probesPerThread; j < endRange; j++)
-						mDiffuseProbes[j].LoadProbeFromDisk(game, diffuseProbesPath);
-				}));
-			}
-			for (auto& t : threads) t.join();
-
-			for (auto& probe : mDiffuseProbes)
-			{
-				if (!probe.IsLoadedFromDisk())
-				{
-					if (game.GetRHI()->GetAPI() == ER_GRAPHICS_API::DX11)
-						probe.Compute(game, mTempDiffuseCubemapFacesRT, mTempDiffuseCubemapFacesConvolutedRT, mTempDiffuseCubemapDepthBuffers, diffuseProbesPath, aObjects, mQuadRenderer, skybox);
-					else
-						throw ER_CoreException("ER_LightProbesManager: Computing & saving the probes is only possible on DX11 at the moment");
-				}
-				else
-				{
-					//TODO load empty
-				}
-			}
+			ComputeProbes(game, mDiffuseProbes, DIFFUSE_PROBE, diffuseProbesPath, aObjects, skybox);
 			
 			mDiffuseProbesReady = true;
 
@@ -616,44 +790,104 @@ namespace EveryRay_Core
 		if (!mSpecularProbesReady && mDistanceBetweenSpecularProbes > 0)
 		{
 			std::wstring specularProbesPath = mLevelPath + L"specular_probes\\";
+			LoadProbesFromDisk(game, mSpecularProbes, SPECULAR_PROBE, specularProbesPath);
 
-			std::vector<std::thread> threads;
-			int numThreads = std::thread::hardware_concurrency();
-			if (game.GetRHI()->GetAPI() != ER_GRAPHICS_API::DX11)
-				numThreads = 1; //TODO fix this on DX12 (need to support multiple command lists)
-
-			threads.reserve(numThreads);
+			ComputeProbes(game, mSpecularProbes, SPECULAR_PROBE, specularProbesPath, aObjects, skybox);
+			mSpecularProbesReady = true;
+		}
+	}
 
-			int probesPerThread = mSpecularProbes.size() / numThreads;
+	// Loads the probes on several threads. Texture uploads are recorded on the current command list,
+	// so on DX12 every thread records into its own list (see ER_RHI::ExecuteParallelCommandContexts()); DX11 creates the textures on the device directly.
+	void ER_LightProbesManager::LoadProbesFromDisk(ER_Core& game, std::vector<ER_LightProbe>& aProbes, ER_ProbeType aType, const std::wstring& aPath)
+	{
+		ER_RHI* rhi = game.GetRHI();
 
-			for (int i = 0; i < numThreads; i++)
+		const int probesCount = static_cast<int>(aProbes.size());
+		auto loadProbes = [&](int aThreadIndex, int aThreadsCount)
+		{
+			const int endRange = probesCount * (aThreadIndex + 1) / aThreadsCount;
+			for (int j = probesCount * aThreadIndex / aThreadsCount; j < endRange; j++)
 			{
-				threads.push_back(std::thread([&, specularProbesPath, i]
-				{
-					int endRange = (i < numThreads - 1) ? (i + 1) * probesPerThread : mSpecularProbes.size();
-					for (int j = i * probesPerThread; j < endRange; j++)
-						mSpecularProbes[j].LoadProbeFromDisk(game, specularProbesPath);
-				}));
+				if (!aProbes[j].IsSkipped())
+					aProbes[j].LoadProbeFromDisk(game, aPath);
 			}
+		};
+
+		if (rhi->GetAPI() == ER_GRAPHICS_API::DX11)
+		{
+			const int numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+			std::vector<std::thread> threads;
+			threads.reserve(numThreads);
+			for (int i = 0; i < numThreads; i++)
+				threads.push_back(std::thread(loadProbes, i, numThreads));
 			for (auto& t : threads) t.join();
+		}
+		else
+		{
+			const int contextsCount = std::max(1, std::min(rhi->GetParallelCommandContextsCount(), probesCount));
+			rhi->ExecuteParallelCommandContexts(aType == DIFFUSE_PROBE ? "Diffuse probes loading" : "Specular probes loading", contextsCount,
+				[&](int aContextIndex) { loadProbes(aContextIndex, contextsCount); });
+		}
+	}
 
-			for (auto& probe : mSpecularProbes)
-			{
-				if (!probe.IsLoadedFromDisk())
-				{
-					if (game.GetRHI()->GetAPI() == ER_GRAPHICS_API::DX11)
-						probe.Compute(game, mTempSpecularCubemapFacesRT, mTempSpecularCubemapFacesConvolutedRT, mTempSpecularCubemapDepthBuffers, specularProbesPath, aObjects, mQuadRenderer, skybox);
-					else
-						throw ER_CoreException("ER_LightProbesManager: Computing & saving the probes is only possible on DX11 at the moment");
+	// Bakes all probes that were not loaded from disk, one after another (progress and throughput are logged every LIGHT_PROBES_BAKE_PROGRESS_LOG_INTERVAL probes)
+	void ER_LightProbesManager::ComputeProbes(ER_Core& game, std::vector<ER_LightProbe>& aProbes, ER_ProbeType aType, const std::wstring& aPath,
+		ProbesRenderingObjectsInfo& aObjects, ER_Skybox* skybox)
+	{
+		std::vector<int> probesToCompute;
+		for (int i = 0; i < static_cast<int>(aProbes.size()); i++)
+		{
+			if (!aProbes[i].IsLoadedFromDisk() && !aProbes[i].IsSkipped())
+				probesToCompute.push_back(i);
+		}
+		if (probesToCompute.empty())
+			return;
 
-				}
-				else
-				{
-					//TODO load empty
-				}
+		if (game.GetRHI()->GetAPI() != ER_GRAPHICS_API::DX11)
+			throw ER_CoreException("ER_LightProbesManager: Computing & saving the probes is only possible on DX11 at the moment");
+
+		ER_RHI_GPUTexture* facesRT = (aType == DIFFUSE_PROBE) ? mTempDiffuseCubemapFacesRT : mTempSpecularCubemapFacesRT;
+		ER_RHI_GPUTexture* facesConvolutedRT = (aType == DIFFUSE_PROBE) ? mTempDiffuseCubemapFacesConvolutedRT : mTempSpecularCubemapFacesConvolutedRT;
+		ER_RHI_GPUTexture** depthBuffers = (aType == DIFFUSE_PROBE) ? mTempDiffuseCubemapDepthBuffers : mTempSpecularCubemapDepthBuffers;
+		const std::wstring typeName = (aType == DIFFUSE_PROBE) ? L"diffuse" : L"specular";
+
+		// the same for all probes of this type
+		std::vector<ER_LightProbeRenderingObject> objectsToRender;
+		ER_LightProbe::GatherObjectsToRender(aObjects, aType, false, objectsToRender);
+
+		const int probesCount = static_cast<int>(probesToCompute.size());
+		UINT64 drawnObjectsCount = 0;
+		UINT64 culledObjectsCount = 0;
+		auto bakeStartTime = std::chrono::high_resolution_clock::now();
+
+		for (int intervalStart = 0; intervalStart < probesCount; intervalStart += LIGHT_PROBES_BAKE_PROGRESS_LOG_INTERVAL)
+		{
+			const int intervalEnd = std::min(intervalStart + LIGHT_PROBES_BAKE_PROGRESS_LOG_INTERVAL, probesCount);
+			auto intervalStartTime = std::chrono::high_resolution_clock::now();
+
+			for (int i = intervalStart; i < intervalEnd; i++)
+			{
+				ER_LightProbe& probe = aProbes[probesToCompute[i]];
+				probe.Compute(game, facesRT, facesConvolutedRT, depthBuffers, aPath, objectsToRender, mQuadRenderer, skybox);
+				drawnObjectsCount += probe.GetLastDrawnObjectsCount();
+				culledObjectsCount += probe.GetLastCulledObjectsCount();
 			}
-			mSpecularProbesReady = true;
+
+			auto intervalEndTime = std::chrono::high_resolution_clock::now();
+			const double intervalSeconds = std::max(std::chrono::duration<double>(intervalEndTime - intervalStartTime).count(), 0.001);
+			std::wstring msg = L"[ER Logger][ER_LightProbesManager] Baked " + std::to_wstring(intervalEnd) + L"/" + std::to_wstring(probesCount) + L" " + typeName +
+				L" probes (" + std::to_wstring(static_cast<float>(intervalEnd - intervalStart) / intervalSeconds) + L" probes/s)\n";
+			ER_OUTPUT_LOG(msg.c_str());
 		}
+
+		auto bakeEndTime = std::chrono::high_resolution_clock::now();
+		const double bakeSeconds = std::max(std::chrono::duration<double>(bakeEndTime - bakeStartTime).count(), 0.001);
+		const UINT64 totalFaces = static_cast<UINT64>(probesCount) * CUBEMAP_FACES_COUNT;
+		std::wstring msg = L"[ER Logger][ER_LightProbesManager] Finished baking " + std::to_wstring(probesCount) + L" " + typeName + L" probes in " +
+			std::to_wstring(bakeSeconds) + L" s (" + std::to_wstring(probesCount / bakeSeconds) + L" probes/s). Objects per face: " +
+			std::to_wstring(static_cast<float>(drawnObjectsCount) / totalFaces) + L" drawn, " + std::to_wstring(static_cast<float>(culledObjectsCount) / totalFaces) + L" culled\n";
+		ER_OUTPUT_LOG(msg.c_str());
 	}
 
 	void ER_LightProbesManager::DrawDebugProbes(ER_RHI* rhi, ER_RHI_GPUTexture* aRenderTarget, ER_RHI_GPUTexture* aDepth, ER_ProbeType aType, ER_RHI_GPURootSignature* rs)
@@ -696,6 +930,9 @@ namespace EveryRay_Core
 
 	}
 
+	// Specular probes are kept resident in the culled cubemap array: only the probes that entered the camera volume are copied
+	// (closest first, SPECULAR_PROBES_COPIES_PER_FRAME at most) and the ones that left it give their slots back.
+	// GPU buffers are only updated when something has changed.
 	void ER_LightProbesManager::UpdateProbesByType(ER_Core& game, ER_ProbeType aType)
 	{
 		std::vector<ER_LightProbe>& probes = (aType == DIFFUSE_PROBE) ? mDiffuseProbes : mSpecularProbes;
@@ -711,10 +948,10 @@ namespace EveryRay_Core
 			if (!mSpecularProbesReady || mDistanceBetweenSpecularProbes <= 0)
 				return;
 
-			mNonCulledSpecularProbesCount = 0;
 			mNonCulledSpecularProbesIndices.clear();
 		}
 
+		ER_RHI* rhi = game.GetRHI();
 		if (aType == SPECULAR_PROBE)
 		{
 			XMFLOAT3 minBounds = XMFLOAT3(
@@ -726,68 +963,119 @@ namespace EveryRay_Core
 				mSpecularProbesVolumeSize + mMainCamera.Position().y,
 				mSpecularProbesVolumeSize + mMainCamera.Position().z);
 
-			for (auto& lightProbe : probes)
-				lightProbe.CPUCullAgainstProbeBoundingVolume(minBounds, maxBounds);
-		}
+			for (int i = 0; i < static_cast<int>(probes.size()); i++)
+			{
+				probes[i].CPUCullAgainstProbeBoundingVolume(minBounds, maxBounds);
+				if (!probes[i].IsCulled())
+					mNonCulledSpecularProbesIndices.push_back(i);
+			}
 
-		if (probeRenderingObject)
-		{
-			auto& oldInstancedData = probeRenderingObject->GetInstancesData();
-			assert(oldInstancedData.size() == probes.size());
+			ER_SpecularProbesResidencyStats& stats = mSpecularProbesResidencyStats;
+			stats.copiedCount = 0;
+			stats.evictedCount = 0;
 
-			for (int i = 0; i < oldInstancedData.size(); i++)
+			// evict the probes that left the volume
+			for (int slot = 0; slot < static_cast<int>(mSpecularProbesResidentSlots.size()); slot++)
 			{
-				bool isCulled = probes[i].IsCulled();
-				//writing culling flag to [4][4] of world instanced matrix
-				oldInstancedData[i].World._44 = isCulled ? 1.0f : 0.0f;
-				//writing cubemap index to [0][0] of world instanced matrix (since we don't need scale)
-				oldInstancedData[i].World._11 = -1.0f;
-				if (!isCulled)
+				const int probeIndex = mSpecularProbesResidentSlots[slot];
+				if (probeIndex != -1 && probes[probeIndex].IsCulled())
 				{
-					if (aType == DIFFUSE_PROBE)
-						oldInstancedData[i].World._11 = static_cast<float>(i);
-					else
-					{
-						oldInstancedData[i].World._11 = static_cast<float>(mNonCulledSpecularProbesCount);
-						mNonCulledSpecularProbesCount++;
-						mNonCulledSpecularProbesIndices.push_back(i);
-					}
+					mSpecularProbesResidentSlots[slot] = -1;
+					mSpecularProbesTexArrayIndicesCPUBuffer[probeIndex] = -1;
+					mSpecularProbesFreeSlots.push_back(slot);
+					stats.evictedCount++;
 				}
 			}
 
-			probeRenderingObject->UpdateInstanceBuffer(oldInstancedData);
-		}
+			// probes that entered the volume (closest to the camera first)
+			std::vector<int> probesToCopy;
+			for (int probeIndex : mNonCulledSpecularProbesIndices)
+			{
+				if (mSpecularProbesTexArrayIndicesCPUBuffer[probeIndex] == -1)
+					probesToCopy.push_back(probeIndex);
+			}
 
-		ER_RHI* rhi = game.GetRHI();
-		if (aType == SPECULAR_PROBE)
-		{
-			for (int i = 0; i < mSpecularProbesCountTotal; i++)
-				mSpecularProbesTexArrayIndicesCPUBuffer[i] = -1;
+			const bool isArrayEmpty = mSpecularProbesFreeSlots.size() == mSpecularProbesResidentSlots.size();
+			const int copiesCount = std::min(static_cast<int>(mSpecularProbesFreeSlots.size()),
+				isArrayEmpty ? static_cast<int>(probesToCopy.size()) : std::min(static_cast<int>(probesToCopy.size()), SPECULAR_PROBES_COPIES_PER_FRAME));
+			if (copiesCount < static_cast<int>(probesToCopy.size()))
+			{
+				const XMVECTOR cameraPos = XMLoadFloat3(&mMainCamera.Position());
+				std::partial_sort(probesToCopy.begin(), probesToCopy.begin() + copiesCount, probesToCopy.end(), [&](int a, int b) {
+					return XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&probes[a].GetPosition()), cameraPos))) <
+						XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&probes[b].GetPosition()), cameraPos)));
+				});
+			}
 
-			for (int i = 0; i < mMaxSpecularProbesInVolumeCount; i++)
+			if (copiesCount > 0)
 			{
-				if (i < mNonCulledSpecularProbesIndices.size() && i < probes.size())
+				std::vector<ER_RHI_GPUResource*> copyResources = { static_cast<ER_RHI_GPUResource*>(mSpecularCubemapArrayRT) };
+				std::vector<ER_RHI_RESOURCE_STATE> copyStates = { ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_DEST };
+				for (int i = 0; i < copiesCount; i++)
 				{
-					int probeIndex = mNonCulledSpecularProbesIndices[i];
+					copyResources.push_back(static_cast<ER_RHI_GPUResource*>(probes[probesToCopy[i]].GetCubemapTexture()));
+					copyStates.push_back(ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_SOURCE);
+				}
 
-					rhi->TransitionResources({ static_cast<ER_RHI_GPUResource*>(mSpecularCubemapArrayRT), static_cast<ER_RHI_GPUResource*>(mSpecularProbes[probeIndex].GetCubemapTexture()) },
-						{ ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_DEST, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_SOURCE }, rhi->GetCurrentGraphicsCommandListIndex());
+				rhi->TransitionResources(copyResources, copyStates, rhi->GetCurrentGraphicsCommandListIndex());
+				for (int i = 0; i < copiesCount; i++)
+				{
+					const int probeIndex = probesToCopy[i];
+					const int slot = mSpecularProbesFreeSlots.back();
+					mSpecularProbesFreeSlots.pop_back();
 
 					for (int cubeI = 0; cubeI < CUBEMAP_FACES_COUNT; cubeI++)
 					{
 						for (int mip = 0; mip < SPECULAR_PROBE_MIP_COUNT; mip++)
 						{
-							rhi->CopyGPUTextureSubresourceRegion(mSpecularCubemapArrayRT, mip + (cubeI + CUBEMAP_FACES_COUNT * i) * SPECULAR_PROBE_MIP_COUNT, 0, 0, 0,
-								mSpecularProbes[probeIndex].GetCubemapTexture(), mip + cubeI * SPECULAR_PROBE_MIP_COUNT, true);
+							rhi->CopyGPUTextureSubresourceRegion(mSpecularCubemapArrayRT, mip + (cubeI + CUBEMAP_FACES_COUNT * slot) * SPECULAR_PROBE_MIP_COUNT, 0, 0, 0,
+								probes[probeIndex].GetCubemapTexture(), mip + cubeI * SPECULAR_PROBE_MIP_COUNT, true);
 						}
 					}
-					mSpecularProbesTexArrayIndicesCPUBuffer[probeIndex] = CUBEMAP_FACES_COUNT * i;
+					mSpecularProbesResidentSlots[slot] = probeIndex;
+					mSpecularProbesTexArrayIndicesCPUBuffer[probeIndex] = CUBEMAP_FACES_COUNT * slot;
+				}
+				rhi->TransitionResources(copyResources, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, rhi->GetCurrentGraphicsCommandListIndex());
+			}
+
+			stats.copiedCount = copiesCount;
+			stats.copiedCountTotal += stats.copiedCount;
+			stats.evictedCountTotal += stats.evictedCount;
+			stats.residentCount = static_cast<int>(mSpecularProbesResidentSlots.size() - mSpecularProbesFreeSlots.size());
+			stats.pendingCount = static_cast<int>(probesToCopy.size()) - copiesCount;
+
+			if (stats.copiedCount > 0 || stats.evictedCount > 0)
+				rhi->UpdateBuffer(mSpecularProbesTexArrayIndicesGPUBuffer, mSpecularProbesTexArrayIndicesCPUBuffer, sizeof(mSpecularProbesTexArrayIndicesCPUBuffer[0]) * mSpecularProbesCountTotal);
+		}
+
+		if (probeRenderingObject)
+		{
+			auto& oldInstancedData = probeRenderingObject->GetInstancesData();
+			assert(oldInstancedData.size() == probes.size());
 
-					rhi->TransitionResources({ static_cast<ER_RHI_GPUResource*>(mSpecularCubemapArrayRT), static_cast<ER_RHI_GPUResource*>(mSpecularProbes[probeIndex].GetCubemapTexture()) },
-						{ ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE }, rhi->GetCurrentGraphicsCommandListIndex());
+			bool isChanged = false;
+			for (int i = 0; i < oldInstancedData.size(); i++)
+			{
+				bool isCulled = probes[i].IsCulled();
+				//writing cubemap index to [0][0] of world instanced matrix (since we don't need scale), -1 if not in the texture array
+				float cubemapIndex = -1.0f;
+				if (!isCulled)
+				{
+					if (aType == DIFFUSE_PROBE)
+						cubemapIndex = static_cast<float>(i);
+					else if (mSpecularProbesTexArrayIndicesCPUBuffer[i] != -1)
+						cubemapIndex = static_cast<float>(mSpecularProbesTexArrayIndicesCPUBuffer[i] / CUBEMAP_FACES_COUNT);
 				}
+				//writing culling flag to [4][4] of world instanced matrix
+				const float culledFlag = isCulled ? 1.0f : 0.0f;
+
+				isChanged |= (oldInstancedData[i].World._44 != culledFlag) || (oldInstancedData[i].World._11 != cubemapIndex);
+				oldInstancedData[i].World._44 = culledFlag;
+				oldInstancedData[i].World._11 = cubemapIndex;
 			}
-			rhi->UpdateBuffer(mSpecularProbesTexArrayIndicesGPUBuffer, mSpecularProbesTexArrayIndicesCPUBuffer, sizeof(mSpecularProbesTexArrayIndicesCPUBuffer[0]) * mSpecularProbesCountTotal);
+
+			if (isChanged)
+				probeRenderingObject->UpdateInstanceBuffer(oldInstancedData);
 		}
 	}
 
@@ -1,13 +1,14 @@
 #pragma once
-#define CUBEMAP_FACES_COUNT 6
-
 #define DIFFUSE_PROBE_SIZE 32 //cubemap dimension
 
 #define SPECULAR_PROBE_MIP_COUNT 6
 #define SPECULAR_PROBE_SIZE 128 //cubemap dimension
 
 #define MAX_CUBEMAPS_IN_VOLUME_PER_AXIS 6 // == cbrt(2048 / CUBEMAP_FACES_COUNT), 2048 - tex. array limit (DX11)
+#define SPECULAR_PROBES_COPIES_PER_FRAME 16 // probes copied to the culled cubemap array per frame (the others wait and use the fallback), unlimited if the array is empty
 #define PROBE_COUNT_PER_CELL 8 // 3D cube cell of probes in each vertex
+#define LIGHT_PROBES_BAKE_PROGRESS_LOG_INTERVAL 64 // probes baked between progress reports
+#define LIGHT_PROBES_SPARSE_MIN_BACK_FACE_HITS 3 // of the 6 axis-aligned rays of a probe: hitting back faces first means the probe is inside solid geometry (sparse grid)
 
 #define SPHERICAL_HARMONICS_ORDER 2
 #define SPHERICAL_HARMONICS_COEF_COUNT (SPHERICAL_HARMONICS_ORDER + 1) * (SPHERICAL_HARMONICS_ORDER + 1)
@@ -35,13 +36,26 @@ namespace EveryRay_Core
 		PROBE_TYPES_COUNT = 2
 	};
 
+	// Probe indices of a cell are stored in a flat array of the manager (see GetProbesCellsIndices())
 	struct ER_LightProbeCell
 	{
 		XMFLOAT3 position;
-		std::vector<int> lightProbeIndices;
+		int probesCount = 0; // non-skipped probes in the cell's range
 		int index;
 	};
 
+	// Residency of the culled specular probes cubemap array: probes are copied to a slot only when they enter the camera volume
+	// and their slot is freed when they leave it (see UpdateProbesByType())
+	struct ER_SpecularProbesResidencyStats
+	{
+		int residentCount = 0;
+		int pendingCount = 0; // in the volume but not copied yet (over the frame's budget or no free slots)
+		int copiedCount = 0; // last frame
+		int evictedCount = 0; // last frame
+		UINT64 copiedCountTotal = 0;
+		UINT64 evictedCountTotal = 0;
+	};
+
 	class ER_LightProbesManager
 	{
 	public:
@@ -56,6 +70,10 @@ namespace EveryRay_Core
 		void DrawDebugProbes(ER_RHI* rhi, ER_RHI_GPUTexture* aRenderTarget, ER_RHI_GPUTexture* aDepth, ER_ProbeType aType, ER_RHI_GPURootSignature* rs);
 		void UpdateProbes(ER_Core& game);
 		int GetCellIndex(const XMFLOAT3& pos, ER_ProbeType aType);
+		// Cell 'i' owns the range [i * PROBE_COUNT_PER_CELL, (i + 1) * PROBE_COUNT_PER_CELL): one slot per corner of the cell ((y << 2) | (x << 1) | z),
+		// -1 if there is no probe in the corner (skipped in a sparse grid). Uploaded as is to the GPU.
+		const std::vector<int>& GetProbesCellsIndices(ER_ProbeType aType) const { return (aType == DIFFUSE_PROBE) ? mDiffuseProbesCellsIndices : mSpecularProbesCellsIndices; }
+		const ER_LightProbeCell& GetProbesCell(int index, ER_ProbeType aType) const { return (aType == DIFFUSE_PROBE) ? mDiffuseProbesCells[index] : mSpecularProbesCells[index]; }
 
 		ER_LightProbe* GetGlobalDiffuseProbe() const { return mGlobalDiffuseProbe; }
 		const ER_LightProbe& GetDiffuseLightProbe(int index) const { return mDiffuseProbes[index]; }
@@ -71,6 +89,7 @@ namespace EveryRay_Core
 		ER_RHI_GPUBuffer* GetSpecularProbesTexArrayIndicesBuffer() const { return mSpecularProbesTexArrayIndicesGPUBuffer; }
 		ER_RHI_GPUBuffer* GetSpecularProbesPositionsBuffer() const { return mSpecularProbesPositionsGPUBuffer; }
 		float GetDistanceBetweenSpecularProbes() { return mDistanceBetweenSpecularProbes; }
+		const ER_SpecularProbesResidencyStats& GetSpecularProbesResidencyStats() const { return mSpecularProbesResidencyStats; }
 
 		ER_RHI_GPUTexture* GetIntegrationMap() { return mIntegrationMapTextureSRV; }
 		
@@ -87,9 +106,11 @@ namespace EveryRay_Core
 		void SetupGlobalSpecularProbe(ER_Core& game, ER_Camera& camera, ER_Scene* scene, ER_DirectionalLight* light, ER_ShadowMapper* shadowMapper);
 		void SetupDiffuseProbes(ER_Core& game, ER_Camera& camera, ER_Scene* scene, ER_DirectionalLight* light, ER_ShadowMapper* shadowMapper);
 		void SetupSpecularProbes(ER_Core& game, ER_Camera& camera, ER_Scene* scene, ER_DirectionalLight* light, ER_ShadowMapper* shadowMapper);
-		void AddProbeToCells(ER_LightProbe& aProbe, ER_ProbeType aType, const XMFLOAT3& minBounds, const XMFLOAT3& maxBounds);
-		bool IsProbeInCell(ER_LightProbe& aProbe, ER_LightProbeCell& aCell, ER_AABB& aCellBounds);
+		void AddProbeToCells(int aProbeIndex, int aProbeX, int aProbeY, int aProbeZ, ER_ProbeType aType);
+		void SkipProbesForSparseGrid(ER_Scene* scene, ER_ProbeType aType);
 		void UpdateProbesByType(ER_Core& game, ER_ProbeType aType);
+		void LoadProbesFromDisk(ER_Core& game, std::vector<ER_LightProbe>& aProbes, ER_ProbeType aType, const std::wstring& aPath);
+		void ComputeProbes(ER_Core& game, std::vector<ER_LightProbe>& aProbes, ER_ProbeType aType, const std::wstring& aPath, ProbesRenderingObjectsInfo& aObjects, ER_Skybox* skybox);
 		
 		ER_QuadRenderer* mQuadRenderer = nullptr;
 		ER_Camera& mMainCamera;
@@ -112,8 +133,9 @@ namespace EveryRay_Core
 		ER_RHI_GPUTexture* mTempDiffuseCubemapFacesConvolutedRT = nullptr;
 		ER_RHI_GPUTexture* mTempDiffuseCubemapDepthBuffers[CUBEMAP_FACES_COUNT] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
 		std::vector<ER_LightProbeCell> mDiffuseProbesCells;
-		ER_AABB mDiffuseProbesCellBounds;
+		std::vector<int> mDiffuseProbesCellsIndices;
 		int mDiffuseProbesCountTotal = 0;
+		int mDiffuseProbesSkippedCount = 0;
 		int mDiffuseProbesCountX = 0;
 		int mDiffuseProbesCountY = 0;
 		int mDiffuseProbesCountZ = 0;
@@ -139,9 +161,13 @@ namespace EveryRay_Core
 		ER_RHI_GPUTexture* mTempSpecularCubemapDepthBuffers[CUBEMAP_FACES_COUNT] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
 		ER_RHI_GPUTexture* mSpecularCubemapArrayRT = nullptr;
 		std::vector<ER_LightProbeCell> mSpecularProbesCells;
-		ER_AABB mSpecularProbesCellBounds;
+		std::vector<int> mSpecularProbesCellsIndices;
 		std::vector<int> mNonCulledSpecularProbesIndices;
+		std::vector<int> mSpecularProbesResidentSlots; // probe index in every slot of the culled cubemap array, -1 if free
+		std::vector<int> mSpecularProbesFreeSlots;
+		ER_SpecularProbesResidencyStats mSpecularProbesResidencyStats;
 		int mSpecularProbesCountTotal = 0;
+		int mSpecularProbesSkippedCount = 0;
 		int mSpecularProbesCountX = 0;
 		int mSpecularProbesCountY = 0;
 		int mSpecularProbesCountZ = 0;
@@ -149,7 +175,6 @@ namespace EveryRay_Core
 		int mSpecularProbesCellsCountY = 0;
 		int mSpecularProbesCellsCountZ = 0;
 		int mSpecularProbesCellsCountTotal = 0;
-		int mNonCulledSpecularProbesCount = 0;
 		bool mSpecularProbesReady = false;
 		ER_LightProbe* mGlobalSpecularProbe = nullptr;
 		bool mGlobalSpecularProbeReady = false;
@@ -0,0 +1,92 @@
+#include "stdafx.h"
+
+#include "ER_LinearArena.h"
+
+#include <algorithm>
+
+namespace EveryRay_Core
+{
+	static thread_local ER_LinearArena* sThreadArena = nullptr;
+
+	ER_LinearArena::ER_LinearArena(size_t aBlockSize)
+		: mBlockSize(aBlockSize)
+	{
+		assert(aBlockSize > 0);
+	}
+
+	ER_LinearArena::~ER_LinearArena()
+	{
+		assert(sThreadArena != this);
+		for (auto& block : mBlocks)
+			delete[] block.data;
+	}
+
+	void* ER_LinearArena::Allocate(size_t aSize, size_t aAlignment)
+	{
+		assert(aAlignment > 0 && (aAlignment & (aAlignment - 1)) == 0);
+
+		auto alignedOffset = [aAlignment](const Block& aBlock, size_t aOffset)
+		{
+			const uintptr_t address = reinterpret_cast<uintptr_t>(aBlock.data) + aOffset;
+			return aOffset + ((aAlignment - (address & (aAlignment - 1))) & (aAlignment - 1));
+		};
+
+		size_t start = mOffset;
+		size_t offset = mBlocks.empty() ? 0 : alignedOffset(mBlocks[mCurrentBlock], mOffset);
+		if (mBlocks.empty() || offset + aSize > mBlocks[mCurrentBlock].size)
+		{
+			AddBlock(aSize + aAlignment); // the rest of the current block is wasted until Reset()
+			start = 0;
+			offset = alignedOffset(mBlocks[mCurrentBlock], 0);
+		}
+
+		void* result = mBlocks[mCurrentBlock].data + offset;
+		mStats.usedBytes += (offset - start) + aSize;
+		mStats.peakBytes = std::max(mStats.peakBytes, mStats.usedBytes);
+		mStats.allocationsCount++;
+		mOffset = offset + aSize;
+		return result;
+	}
+
+	void ER_LinearArena::Reset()
+	{
+		// merge the blocks, so that the next frame fits into one
+		if (mBlocks.size() > 1)
+		{
+			const size_t capacity = mStats.capacityBytes;
+			for (auto& block : mBlocks)
+				delete[] block.data;
+			mBlocks.clear();
+			mStats.capacityBytes = 0;
+			AddBlock(capacity);
+		}
+
+		mCurrentBlock = 0;
+		mOffset = 0;
+		mStats.usedBytes = 0;
+		mStats.allocationsCount = 0;
+	}
+
+	void ER_LinearArena::AddBlock(size_t aMinSize)
+	{
+		Block block;
+		block.size = std::max(mBlockSize, aMinSize);
+		block.data = new unsigned char[block.size];
+		mBlocks.push_back(block);
+
+		mCurrentBlock = mBlocks.size() - 1;
+		mOffset = 0;
+		mStats.capacityBytes += block.size;
+		mStats.blocksCount = mBlocks.size();
+	}
+
+	ER_LinearArena* ER_LinearArena::GetThreadArena()
+	{
+		return sThreadArena;
+	}
+
+	void ER_LinearArena::SetThreadArena(ER_LinearArena* aArena)
+	{
+		sThreadArena = aArena;
+	}
+}
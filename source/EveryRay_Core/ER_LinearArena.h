@@ -0,0 +1,107 @@
+// Linear (bump) arena in EveryRay Rendering Engine: for temporary per-frame allocations
+// - Allocate() moves a pointer inside of the current block (a new block is added if it does not fit), memory is never freed individually
+// - Reset() releases everything at once: at the end of the frame for the frame arena of the main thread (ER_RuntimeCore) or at the start of
+//   the job for the arena of the simulation thread (ER_FramePipeline). If the frame did not fit into one block, the blocks are merged, so after
+//   a few frames the arena settles on one block and does not touch the heap anymore.
+// - arenas are not thread-safe: every thread binds its own (SetThreadArena()), containers must not grow on other threads
+// - ER_ArenaAllocator is an STL allocator on top of the arena of the calling thread (falls back to the heap if the thread has no arena), e.g.:
+//     ER_ArenaVector<ER_RenderingObject*> objects; // freed by the next Reset(), must not outlive the frame
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#define ER_LINEAR_ARENA_BLOCK_SIZE (64 * 1024)
+
+namespace EveryRay_Core
+{
+	struct ER_LinearArenaStats
+	{
+		size_t usedBytes = 0; // since the last Reset()
+		size_t peakBytes = 0; // of all frames
+		size_t capacityBytes = 0;
+		size_t allocationsCount = 0; // since the last Reset()
+		size_t blocksCount = 0;
+	};
+
+	class ER_LinearArena
+	{
+	public:
+		ER_LinearArena(size_t aBlockSize = ER_LINEAR_ARENA_BLOCK_SIZE);
+		~ER_LinearArena();
+
+		void* Allocate(size_t aSize, size_t aAlignment = alignof(std::max_align_t));
+		template<typename T>
+		T* AllocateArray(size_t aCount) { return static_cast<T*>(Allocate(sizeof(T) * aCount, alignof(T))); }
+		void Reset();
+
+		const ER_LinearArenaStats& GetStats() const { return mStats; }
+
+		static ER_LinearArena* GetThreadArena();
+		static void SetThreadArena(ER_LinearArena* aArena);
+	private:
+		ER_LinearArena(const ER_LinearArena&);
+		ER_LinearArena& operator=(const ER_LinearArena&);
+
+		struct Block
+		{
+			unsigned char* data = nullptr;
+			size_t size = 0;
+		};
+		void AddBlock(size_t aMinSize);
+
+		std::vector<Block> mBlocks;
+		ER_LinearArenaStats mStats;
+		size_t mBlockSize = 0;
+		size_t mCurrentBlock = 0;
+		size_t mOffset = 0; // in the current block
+	};
+
+	// Binds an arena to the calling thread for the lifetime of the scope (the previous one is restored)
+	class ER_ThreadArenaScope
+	{
+	public:
+		ER_ThreadArenaScope(ER_LinearArena* aArena) : mPreviousArena(ER_LinearArena::GetThreadArena()) { ER_LinearArena::SetThreadArena(aArena); }
+		~ER_ThreadArenaScope() { ER_LinearArena::SetThreadArena(mPreviousArena); }
+	private:
+		ER_LinearArena* mPreviousArena;
+	};
+
+	template<typename T>
+	class ER_ArenaAllocator
+	{
+	public:
+		using value_type = T;
+
+		ER_ArenaAllocator() : mArena(ER_LinearArena::GetThreadArena()) {}
+		explicit ER_ArenaAllocator(ER_LinearArena* aArena) : mArena(aArena) {}
+		template<typename U>
+		ER_ArenaAllocator(const ER_ArenaAllocator<U>& aOther) : mArena(aOther.GetArena()) {}
+
+		T* allocate(size_t aCount)
+		{
+			if (mArena)
+				return mArena->AllocateArray<T>(aCount);
+			return static_cast<T*>(::operator new(sizeof(T) * aCount));
+		}
+		void deallocate(T* aPointer, size_t)
+		{
+			if (!mArena)
+				::operator delete(aPointer);
+		}
+
+		ER_LinearArena* GetArena() const { return mArena; }
+	private:
+		ER_LinearArena* mArena;
+	};
+
+	template<typename T, typename U>
+	bool operator==(const ER_ArenaAllocator<T>& aLeft, const ER_ArenaAllocator<U>& aRight) { return aLeft.GetArena() == aRight.GetArena(); }
+	template<typename T, typename U>
+	bool operator!=(const ER_ArenaAllocator<T>& aLeft, const ER_ArenaAllocator<U>& aRight) { return aLeft.GetArena() != aRight.GetArena(); }
+
+	template<typename T>
+	using ER_ArenaVector = std::vector<T, ER_ArenaAllocator<T>>;
+}
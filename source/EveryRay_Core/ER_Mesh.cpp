@@ -6,6 +6,7 @@
 #include "ER_Core.h"
 #include "ER_CoreException.h"
 #include "ER_VertexDeclarations.h"
+#include "ER_VertexCompression.h"
 
 #include "assimp\scene.h"
 
@@ -86,6 +87,48 @@ namespace EveryRay_Core
 		}
 	}
 
+	// LOD mesh: triangles of 'source' (indices into its vertices); only the referenced vertices are copied
+	ER_Mesh::ER_Mesh(ER_Model& model, ER_ModelMaterial& material, const ER_Mesh& source, const std::vector<UINT>& indices)
+		: mModel(model), mMaterial(material), mName(source.mName), mVertices(), mNormals(), mTangents(), mBiNormals(), mTextureCoordinates(), mVertexColors(), mFaceCount(0), mIndices()
+	{
+		assert(indices.size() % 3 == 0);
+
+		const UINT invalidIndex = 0xffffffff;
+		std::vector<UINT> vertexRemap(source.mVertices.size(), invalidIndex);
+		std::vector<UINT> usedVertices;
+		mIndices.reserve(indices.size());
+		for (UINT index : indices)
+		{
+			if (vertexRemap[index] == invalidIndex)
+			{
+				vertexRemap[index] = static_cast<UINT>(usedVertices.size());
+				usedVertices.push_back(index);
+			}
+			mIndices.push_back(vertexRemap[index]);
+		}
+		mFaceCount = static_cast<UINT>(mIndices.size() / 3);
+
+		auto copyUsedVertices = [&usedVertices](const auto& sourceData, auto& data)
+		{
+			if (sourceData.empty())
+				return;
+			data.reserve(usedVertices.size());
+			for (UINT vertex : usedVertices)
+				data.push_back(sourceData[vertex]);
+		};
+
+		copyUsedVertices(source.mVertices, mVertices);
+		copyUsedVertices(source.mNormals, mNormals);
+		copyUsedVertices(source.mTangents, mTangents);
+		copyUsedVertices(source.mBiNormals, mBiNormals);
+		mTextureCoordinates.resize(source.mTextureCoordinates.size());
+		for (size_t i = 0; i < source.mTextureCoordinates.size(); i++)
+			copyUsedVertices(source.mTextureCoordinates[i], mTextureCoordinates[i]);
+		mVertexColors.resize(source.mVertexColors.size());
+		for (size_t i = 0; i < source.mVertexColors.size(); i++)
+			copyUsedVertices(source.mVertexColors[i], mVertexColors[i]);
+	}
+
 	/*ER_Mesh::ER_Mesh(Model & model, ER_ModelMaterial * material)
 	{
 	}*/
@@ -216,6 +259,25 @@ namespace EveryRay_Core
 		vertexBuffer->CreateGPUBufferResource(mModel.GetCore().GetRHI(), &vertices[0], static_cast<UINT>(vertices.size()), sizeof(VertexPositionTextureNormal), false, ER_BIND_VERTEX_BUFFER);
 	}
 
+	void ER_Mesh::CreateVertexBuffer_QuantizedPositionUvNormal(ER_RHI_GPUBuffer* vertexBuffer, XMFLOAT4& decodeScale, XMFLOAT4& decodeBias, ER_VertexCompressionError* error, int uvChannel) const
+	{
+		const std::vector<XMFLOAT3>& sourceVertices = Vertices();
+		const std::vector<XMFLOAT3>& textureCoordinates = mTextureCoordinates[uvChannel];
+		assert(textureCoordinates.size() == sourceVertices.size());
+
+		const std::vector<XMFLOAT3>& normals = Normals();
+		assert(normals.size() == sourceVertices.size());
+
+		const ER_AABB aabb = ER_VertexCompression::CalculateAABB(sourceVertices);
+		ER_VertexCompression::GetPositionDecodeScaleBias(aabb, decodeScale, decodeBias);
+
+		std::vector<VertexQuantizedPositionTextureNormal> vertices;
+		ER_VertexCompression::CompressVertices(sourceVertices, textureCoordinates, normals, aabb, vertices, error);
+
+		assert(vertexBuffer);
+		vertexBuffer->CreateGPUBufferResource(mModel.GetCore().GetRHI(), &vertices[0], static_cast<UINT>(vertices.size()), sizeof(VertexQuantizedPositionTextureNormal), false, ER_BIND_VERTEX_BUFFER);
+	}
+
 	void ER_Mesh::CreateVertexBuffer_PositionUvNormalTangent(ER_RHI_GPUBuffer* vertexBuffer, int uvChannel) const
 	{
 		const std::vector<XMFLOAT3>& sourceVertices = Vertices();
@@ -9,11 +9,13 @@ namespace EveryRay_Core
 {
 	class ER_Model;
 	class ER_ModelMaterial;
+	struct ER_VertexCompressionError;
 
 	class ER_Mesh
 	{
 	public:
 		ER_Mesh(ER_Model& model, ER_ModelMaterial& material, aiMesh& mesh);
+		ER_Mesh(ER_Model& model, ER_ModelMaterial& material, const ER_Mesh& source, const std::vector<UINT>& indices); // LOD of 'source' (see ER_Model::GenerateLOD())
 		~ER_Mesh();
 
 		ER_Model& GetModel();
@@ -35,8 +37,13 @@ namespace EveryRay_Core
 		void CreateVertexBuffer_PositionUv(ER_RHI_GPUBuffer* vertexBuffer, int uvChannel = 0) const;
 		void CreateVertexBuffer_PositionUvNormal(ER_RHI_GPUBuffer* vertexBuffer, int uvChannel = 0) const;
 		void CreateVertexBuffer_PositionUvNormalTangent(ER_RHI_GPUBuffer* vertexBuffer, int uvChannel = 0) const;
+		// VertexQuantizedPositionTextureNormal: positions have to be decoded in the shader with 'decodeScale' and 'decodeBias' (see ER_VertexCompression)
+		void CreateVertexBuffer_QuantizedPositionUvNormal(ER_RHI_GPUBuffer* vertexBuffer, XMFLOAT4& decodeScale, XMFLOAT4& decodeBias, ER_VertexCompressionError* error = nullptr, int uvChannel = 0) const;
 
 	private:
+		friend class ER_Model;
+		void SetIndices(std::vector<UINT>& indices) { mIndices.swap(indices); } // same triangles in a different order (see ER_Model::OptimizeMeshes())
+
 		ER_Model& mModel;
 		ER_ModelMaterial& mMaterial;
 		std::string mName;
@@ -0,0 +1,393 @@
+#include "stdafx.h"
+#include "ER_MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace EveryRay_Core
+{
+	namespace
+	{
+		const UINT INVALID_INDEX = 0xffffffff;
+
+		// Forsyth's scoring constants
+		const float CACHE_DECAY_POWER = 1.5f;
+		const float LAST_TRIANGLE_SCORE = 0.75f;
+		const float VALENCE_BOOST_SCALE = 2.0f;
+		const float VALENCE_BOOST_POWER = 0.5f;
+
+		inline XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+		inline XMFLOAT3 Add(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+		inline XMFLOAT3 Scale(const XMFLOAT3& a, float s) { return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+		inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		inline float Length(const XMFLOAT3& a) { return sqrtf(Dot(a, a)); }
+		inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+
+		// not normalized (length = 2 * area), outward if 'windingSign' is from GetWindingSign()
+		inline XMFLOAT3 GetTriangleNormal(const std::vector<XMFLOAT3>& positions, const UINT* triangle, float windingSign)
+		{
+			const XMFLOAT3& p0 = positions[triangle[0]];
+			return Scale(Cross(Sub(positions[triangle[1]], p0), Sub(positions[triangle[2]], p0)), windingSign);
+		}
+
+		float GetVertexScore(int cachePosition, UINT remainingValence)
+		{
+			if (remainingValence == 0)
+				return -1.0f;
+
+			float score = 0.0f;
+			if (cachePosition >= 0)
+			{
+				if (cachePosition < 3) // vertices of the last triangle: fixed score, so that it is not too easy to use them again
+					score = LAST_TRIANGLE_SCORE;
+				else
+				{
+					const float scaler = 1.0f / static_cast<float>(ER_VERTEX_CACHE_OPTIMIZATION_SIZE - 3);
+					score = powf(1.0f - static_cast<float>(cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+				}
+			}
+
+			// vertices with few triangles left are preferred, so that we do not leave lonely triangles behind
+			score += VALENCE_BOOST_SCALE * powf(static_cast<float>(remainingValence), -VALENCE_BOOST_POWER);
+			return score;
+		}
+
+		// FIFO cache simulation, returns the number of cache misses of every triangle in 'misses' (optional)
+		UINT SimulateFIFOCache(const UINT* indices, size_t indexCount, UINT vertexCount, UINT cacheSize, std::vector<UINT>& timestamps, std::vector<UINT8>* misses)
+		{
+			// a vertex is in the cache if it was added less than 'cacheSize' misses ago
+			timestamps.assign(vertexCount, 0);
+			UINT time = cacheSize + 1;
+			UINT missesCount = 0;
+			for (size_t i = 0; i < indexCount; i += 3)
+			{
+				UINT8 triangleMisses = 0;
+				for (int j = 0; j < 3; j++)
+				{
+					UINT vertex = indices[i + j];
+					if (time - timestamps[vertex] > cacheSize)
+					{
+						timestamps[vertex] = time++;
+						triangleMisses++;
+					}
+				}
+				missesCount += triangleMisses;
+				if (misses)
+					misses->push_back(triangleMisses);
+			}
+			return missesCount;
+		}
+	}
+
+	ER_VertexCacheStats ER_MeshOptimizer::AnalyzeVertexCache(const std::vector<UINT>& aIndices, UINT aVertexCount, UINT aCacheSize)
+	{
+		ER_VertexCacheStats stats;
+		if (aIndices.size() < 3)
+			return stats;
+
+		std::vector<UINT> timestamps;
+		const UINT missesCount = SimulateFIFOCache(aIndices.data(), aIndices.size(), aVertexCount, aCacheSize, timestamps, nullptr);
+
+		UINT referencedVerticesCount = 0;
+		std::vector<UINT8> isReferenced(aVertexCount, 0);
+		for (UINT index : aIndices)
+		{
+			if (!isReferenced[index])
+			{
+				isReferenced[index] = 1;
+				referencedVerticesCount++;
+			}
+		}
+
+		stats.acmr = static_cast<float>(missesCount) / static_cast<float>(aIndices.size() / 3);
+		stats.atvr = static_cast<float>(missesCount) / static_cast<float>(referencedVerticesCount);
+		return stats;
+	}
+
+	void ER_MeshOptimizer::OptimizeVertexCache(std::vector<UINT>& aIndices, UINT aVertexCount)
+	{
+		assert(aIndices.size() % 3 == 0);
+		const UINT triangleCount = static_cast<UINT>(aIndices.size() / 3);
+		if (triangleCount == 0)
+			return;
+
+		// triangles of every vertex: [triangleOffsets[v], triangleOffsets[v] + remainingValence[v]) are not emitted yet
+		std::vector<UINT> remainingValence(aVertexCount, 0);
+		for (UINT index : aIndices)
+			remainingValence[index]++;
+
+		std::vector<UINT> triangleOffsets(aVertexCount, 0);
+		UINT offset = 0;
+		for (UINT v = 0; v < aVertexCount; v++)
+		{
+			triangleOffsets[v] = offset;
+			offset += remainingValence[v];
+		}
+
+		std::vector<UINT> vertexTriangles(aIndices.size());
+		{
+			std::vector<UINT> fillCounts(aVertexCount, 0);
+			for (UINT t = 0; t < triangleCount; t++)
+				for (int j = 0; j < 3; j++)
+				{
+					UINT v = aIndices[t * 3 + j];
+					vertexTriangles[triangleOffsets[v] + fillCounts[v]++] = t;
+				}
+		}
+
+		std::vector<float> vertexScores(aVertexCount);
+		for (UINT v = 0; v < aVertexCount; v++)
+			vertexScores[v] = GetVertexScore(-1, remainingValence[v]);
+
+		std::vector<float> triangleScores(triangleCount);
+		for (UINT t = 0; t < triangleCount; t++)
+			triangleScores[t] = vertexScores[aIndices[t * 3 + 0]] + vertexScores[aIndices[t * 3 + 1]] + vertexScores[aIndices[t * 3 + 2]];
+
+		std::vector<UINT8> isEmitted(triangleCount, 0);
+
+		UINT cache[ER_VERTEX_CACHE_OPTIMIZATION_SIZE + 3];
+		UINT cacheCount = 0;
+		UINT newCache[ER_VERTEX_CACHE_OPTIMIZATION_SIZE + 3];
+
+		std::vector<UINT> result;
+		result.reserve(aIndices.size());
+
+		UINT bestTriangle = INVALID_INDEX;
+		UINT inputCursor = 0;
+		for (UINT emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+		{
+			if (bestTriangle == INVALID_INDEX)
+			{
+				// nothing useful in the cache: take the best of the remaining triangles (scores of the triangles outside of the cache only depend on valence)
+				float bestScore = -1.0f;
+				while (inputCursor < triangleCount && isEmitted[inputCursor])
+					inputCursor++;
+				for (UINT t = inputCursor; t < triangleCount; t++)
+				{
+					if (!isEmitted[t] && triangleScores[t] > bestScore)
+					{
+						bestScore = triangleScores[t];
+						bestTriangle = t;
+						if (bestScore >= 3.0f * VALENCE_BOOST_SCALE) // can't be better than 3 vertices with one triangle left
+							break;
+					}
+				}
+			}
+
+			const UINT* triangle = &aIndices[bestTriangle * 3];
+			result.push_back(triangle[0]);
+			result.push_back(triangle[1]);
+			result.push_back(triangle[2]);
+			isEmitted[bestTriangle] = 1;
+
+			// remove the triangle from the adjacency of its vertices
+			for (int j = 0; j < 3; j++)
+			{
+				const UINT v = triangle[j];
+				UINT* triangles = &vertexTriangles[triangleOffsets[v]];
+				for (UINT k = 0; k < remainingValence[v]; k++)
+				{
+					if (triangles[k] == bestTriangle)
+					{
+						std::swap(triangles[k], triangles[remainingValence[v] - 1]);
+						break;
+					}
+				}
+				remainingValence[v]--;
+			}
+
+			// LRU: vertices of the new triangle go first, the rest keeps its order
+			UINT newCacheCount = 0;
+			for (int j = 0; j < 3; j++)
+			{
+				if (j == 0 || (triangle[j] != triangle[0] && (j == 1 || triangle[j] != triangle[1]))) // degenerate triangles
+					newCache[newCacheCount++] = triangle[j];
+			}
+			for (UINT i = 0; i < cacheCount; i++)
+			{
+				const UINT v = cache[i];
+				if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+					newCache[newCacheCount++] = v;
+			}
+
+			// vertices that fell out of the cache lose their position score
+			if (newCacheCount > ER_VERTEX_CACHE_OPTIMIZATION_SIZE)
+			{
+				for (UINT i = ER_VERTEX_CACHE_OPTIMIZATION_SIZE; i < newCacheCount; i++)
+				{
+					const UINT v = newCache[i];
+					const float newScore = GetVertexScore(-1, remainingValence[v]);
+					const float delta = newScore - vertexScores[v];
+					vertexScores[v] = newScore;
+					for (UINT k = 0; k < remainingValence[v]; k++)
+						triangleScores[vertexTriangles[triangleOffsets[v] + k]] += delta;
+				}
+				newCacheCount = ER_VERTEX_CACHE_OPTIMIZATION_SIZE;
+			}
+
+			// update the vertices in the cache and find the best triangle among their triangles
+			bestTriangle = INVALID_INDEX;
+			float bestScore = -1.0f;
+			for (UINT i = 0; i < newCacheCount; i++)
+			{
+				const UINT v = newCache[i];
+				cache[i] = v;
+
+				const float newScore = GetVertexScore(static_cast<int>(i), remainingValence[v]);
+				const float delta = newScore - vertexScores[v];
+				vertexScores[v] = newScore;
+				for (UINT k = 0; k < remainingValence[v]; k++)
+					triangleScores[vertexTriangles[triangleOffsets[v] + k]] += delta;
+			}
+			cacheCount = newCacheCount;
+
+			for (UINT i = 0; i < cacheCount; i++)
+			{
+				const UINT v = cache[i];
+				for (UINT k = 0; k < remainingValence[v]; k++)
+				{
+					const UINT t = vertexTriangles[triangleOffsets[v] + k];
+					if (triangleScores[t] > bestScore)
+					{
+						bestScore = triangleScores[t];
+						bestTriangle = t;
+					}
+				}
+			}
+		}
+
+		aIndices.swap(result);
+	}
+
+	void ER_MeshOptimizer::OptimizeOverdraw(std::vector<UINT>& aIndices, const std::vector<XMFLOAT3>& aPositions, const std::vector<XMFLOAT3>& aNormals, float aThreshold)
+	{
+		assert(aIndices.size() % 3 == 0);
+		const UINT triangleCount = static_cast<UINT>(aIndices.size() / 3);
+		const UINT vertexCount = static_cast<UINT>(aPositions.size());
+		if (triangleCount < 2)
+			return;
+
+		// hard boundaries: triangles that miss the cache with all their vertices (the cache is effectively flushed there)
+		std::vector<UINT> timestamps;
+		std::vector<UINT8> misses;
+		misses.reserve(triangleCount);
+		SimulateFIFOCache(aIndices.data(), aIndices.size(), vertexCount, ER_VERTEX_CACHE_ANALYSIS_SIZE, timestamps, &misses);
+
+		std::vector<UINT> hardClusters; // first triangle of every cluster
+		for (UINT t = 0; t < triangleCount; t++)
+			if (t == 0 || misses[t] == 3)
+				hardClusters.push_back(t);
+
+		// soft boundaries: split a hard cluster further if the part so far (simulated with an empty cache) is not much worse than the whole cluster
+		std::vector<UINT> clusters;
+		for (size_t c = 0; c < hardClusters.size(); c++)
+		{
+			const UINT start = hardClusters[c];
+			const UINT end = (c + 1 < hardClusters.size()) ? hardClusters[c + 1] : triangleCount;
+
+			UINT clusterMisses = 0;
+			for (UINT t = start; t < end; t++)
+				clusterMisses += misses[t];
+			const float clusterACMR = static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+			UINT softStart = start;
+			UINT softMisses = 0;
+			UINT time = ER_VERTEX_CACHE_ANALYSIS_SIZE + 1;
+			std::fill(timestamps.begin(), timestamps.end(), 0);
+			clusters.push_back(start);
+			for (UINT t = start; t < end; t++)
+			{
+				for (int j = 0; j < 3; j++)
+				{
+					UINT v = aIndices[t * 3 + j];
+					if (time - timestamps[v] > ER_VERTEX_CACHE_ANALYSIS_SIZE)
+					{
+						timestamps[v] = time++;
+						softMisses++;
+					}
+				}
+
+				const float softACMR = static_cast<float>(softMisses) / static_cast<float>(t + 1 - softStart);
+				if (t + 1 < end && softACMR <= clusterACMR * aThreshold)
+				{
+					clusters.push_back(t + 1);
+					softStart = t + 1;
+					softMisses = 0;
+					time += ER_VERTEX_CACHE_ANALYSIS_SIZE + 1; // flush
+				}
+			}
+		}
+
+		// sort key of a cluster: how much it faces away from the center of the mesh
+		const float windingSign = GetWindingSign(aIndices, aPositions, aNormals);
+
+		XMFLOAT3 meshCenter(0.0f, 0.0f, 0.0f);
+		float meshArea = 0.0f;
+		for (UINT t = 0; t < triangleCount; t++)
+		{
+			const UINT* triangle = &aIndices[t * 3];
+			const float area = Length(GetTriangleNormal(aPositions, triangle, windingSign));
+			XMFLOAT3 centroid = Scale(Add(Add(aPositions[triangle[0]], aPositions[triangle[1]]), aPositions[triangle[2]]), 1.0f / 3.0f);
+			meshCenter = Add(meshCenter, Scale(centroid, area));
+			meshArea += area;
+		}
+		if (meshArea > 0.0f)
+			meshCenter = Scale(meshCenter, 1.0f / meshArea);
+
+		std::vector<std::pair<float, UINT>> sortedClusters(clusters.size()); // key, cluster
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			const UINT start = clusters[c];
+			const UINT end = (c + 1 < clusters.size()) ? clusters[c + 1] : triangleCount;
+
+			XMFLOAT3 clusterCenter(0.0f, 0.0f, 0.0f);
+			XMFLOAT3 clusterNormal(0.0f, 0.0f, 0.0f);
+			float clusterArea = 0.0f;
+			for (UINT t = start; t < end; t++)
+			{
+				const UINT* triangle = &aIndices[t * 3];
+				const XMFLOAT3 normal = GetTriangleNormal(aPositions, triangle, windingSign);
+				const float area = Length(normal);
+				XMFLOAT3 centroid = Scale(Add(Add(aPositions[triangle[0]], aPositions[triangle[1]]), aPositions[triangle[2]]), 1.0f / 3.0f);
+				clusterCenter = Add(clusterCenter, Scale(centroid, area));
+				clusterNormal = Add(clusterNormal, normal);
+				clusterArea += area;
+			}
+
+			float key = 0.0f;
+			const float normalLength = Length(clusterNormal);
+			if (clusterArea > 0.0f && normalLength > 0.0f)
+				key = Dot(Sub(Scale(clusterCenter, 1.0f / clusterArea), meshCenter), Scale(clusterNormal, 1.0f / normalLength));
+			sortedClusters[c] = std::make_pair(key, static_cast<UINT>(c));
+		}
+
+		std::stable_sort(sortedClusters.begin(), sortedClusters.end(),
+			[](const std::pair<float, UINT>& a, const std::pair<float, UINT>& b) { return a.first > b.first; });
+
+		std::vector<UINT> result;
+		result.reserve(aIndices.size());
+		for (const auto& cluster : sortedClusters)
+		{
+			const UINT start = clusters[cluster.second];
+			const UINT end = (cluster.second + 1 < clusters.size()) ? clusters[cluster.second + 1] : triangleCount;
+			result.insert(result.end(), aIndices.begin() + start * 3, aIndices.begin() + end * 3);
+		}
+		aIndices.swap(result);
+	}
+
+	float ER_MeshOptimizer::GetWindingSign(const std::vector<UINT>& aIndices, const std::vector<XMFLOAT3>& aPositions, const std::vector<XMFLOAT3>& aNormals)
+	{
+		// imported meshes have their winding flipped for the clockwise front faces of the right-handed camera
+		if (aNormals.size() != aPositions.size())
+			return -1.0f;
+
+		float agreement = 0.0f;
+		for (size_t i = 0; i + 2 < aIndices.size(); i += 3)
+		{
+			const UINT* triangle = &aIndices[i];
+			const XMFLOAT3 faceNormal = GetTriangleNormal(aPositions, triangle, 1.0f);
+			agreement += Dot(faceNormal, Add(Add(aNormals[triangle[0]], aNormals[triangle[1]]), aNormals[triangle[2]]));
+		}
+		return agreement >= 0.0f ? 1.0f : -1.0f;
+	}
+}
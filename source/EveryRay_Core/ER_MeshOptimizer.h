@@ -0,0 +1,40 @@
+// Index buffer optimizations in EveryRay Rendering Engine (results are cached by ER_Model)
+// - vertex cache: "Linear-Speed Vertex Cache Optimisation" (T. Forsyth) with an LRU cache model
+// - overdraw: triangles are split into clusters on vertex cache boundaries ("Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", P. Sander et al.),
+//   clusters that face away from the center of the mesh are drawn first, so that they occlude the rest
+// Only works with triangle lists (3 indices per face); all data is in the space of the mesh vertices.
+
+#pragma once
+#include "Common.h"
+
+#define ER_VERTEX_CACHE_OPTIMIZATION_SIZE 32 // LRU cache model used by the optimizer
+#define ER_VERTEX_CACHE_ANALYSIS_SIZE 16 // FIFO cache model used for the stats (the usual post-transform cache of the hardware)
+#define ER_OVERDRAW_OPTIMIZATION_THRESHOLD 1.05f // how much worse (ACMR) the vertex cache can get in favour of smaller clusters
+
+namespace EveryRay_Core
+{
+	struct ER_VertexCacheStats
+	{
+		float acmr = 0.0f; // average cache miss ratio: transformed vertices / triangles (0.5 - ideal, 3.0 - worst)
+		float atvr = 0.0f; // average transformed vertex ratio: transformed vertices / referenced vertices (1.0 - ideal)
+	};
+
+	class ER_MeshOptimizer
+	{
+	public:
+		static ER_VertexCacheStats AnalyzeVertexCache(const std::vector<UINT>& aIndices, UINT aVertexCount, UINT aCacheSize = ER_VERTEX_CACHE_ANALYSIS_SIZE);
+
+		// Reorders triangles for post-transform cache hits (vertices are not touched)
+		static void OptimizeVertexCache(std::vector<UINT>& aIndices, UINT aVertexCount);
+		// Reorders clusters of an index buffer that is already optimized for the vertex cache; ACMR stays within 'aThreshold' of the input
+		static void OptimizeOverdraw(std::vector<UINT>& aIndices, const std::vector<XMFLOAT3>& aPositions, const std::vector<XMFLOAT3>& aNormals, float aThreshold = ER_OVERDRAW_OPTIMIZATION_THRESHOLD);
+
+	private:
+		// +1 or -1: sign of cross(p1 - p0, p2 - p0) that points outwards (winding of the imported meshes depends on the import flags)
+		static float GetWindingSign(const std::vector<UINT>& aIndices, const std::vector<XMFLOAT3>& aPositions, const std::vector<XMFLOAT3>& aNormals);
+
+		ER_MeshOptimizer();
+		ER_MeshOptimizer(const ER_MeshOptimizer& rhs);
+		ER_MeshOptimizer& operator=(const ER_MeshOptimizer& rhs);
+	};
+}
@@ -0,0 +1,470 @@
+#include "stdafx.h"
+#include "ER_MeshSimplifier.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace EveryRay_Core
+{
+	namespace
+	{
+		const UINT INVALID_INDEX = 0xffffffff;
+
+		enum VertexKind
+		{
+			VERTEX_KIND_MANIFOLD = 0,
+			VERTEX_KIND_BORDER,
+			VERTEX_KIND_SEAM,
+			VERTEX_KIND_LOCKED,
+			VERTEX_KIND_COUNT
+		};
+
+		// [from][to]: can a vertex of kind 'from' collapse into a vertex of kind 'to'
+		const bool CAN_COLLAPSE[VERTEX_KIND_COUNT][VERTEX_KIND_COUNT] =
+		{
+			{ true,  true,  true,  true  },
+			{ false, true,  false, false },
+			{ false, false, true,  false },
+			{ false, false, false, false }
+		};
+
+		inline XMFLOAT3 Sub(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+		inline XMFLOAT3 Scale(const XMFLOAT3& a, float s) { return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+		inline float Dot(const XMFLOAT3& a, const XMFLOAT3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+		inline float Length(const XMFLOAT3& a) { return sqrtf(Dot(a, a)); }
+		inline XMFLOAT3 Cross(const XMFLOAT3& a, const XMFLOAT3& b) { return XMFLOAT3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+
+		// Symmetric 4x4 matrix of the sum of squared distances to the planes, weighted
+		struct Quadric
+		{
+			float a00 = 0.0f, a11 = 0.0f, a22 = 0.0f;
+			float a10 = 0.0f, a20 = 0.0f, a21 = 0.0f;
+			float b0 = 0.0f, b1 = 0.0f, b2 = 0.0f;
+			float c = 0.0f;
+			float w = 0.0f;
+		};
+
+		void AddPlane(Quadric& q, const XMFLOAT3& normal, float distance, float weight)
+		{
+			q.a00 += normal.x * normal.x * weight;
+			q.a11 += normal.y * normal.y * weight;
+			q.a22 += normal.z * normal.z * weight;
+			q.a10 += normal.y * normal.x * weight;
+			q.a20 += normal.z * normal.x * weight;
+			q.a21 += normal.z * normal.y * weight;
+			q.b0 += normal.x * distance * weight;
+			q.b1 += normal.y * distance * weight;
+			q.b2 += normal.z * distance * weight;
+			q.c += distance * distance * weight;
+			q.w += weight;
+		}
+
+		void AddQuadric(Quadric& q, const Quadric& other)
+		{
+			q.a00 += other.a00; q.a11 += other.a11; q.a22 += other.a22;
+			q.a10 += other.a10; q.a20 += other.a20; q.a21 += other.a21;
+			q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+			q.c += other.c;
+			q.w += other.w;
+		}
+
+		// weighted average of the squared distances from 'v' to the planes
+		float GetQuadricError(const Quadric& q, const XMFLOAT3& v)
+		{
+			float r = q.c;
+			r += q.a00 * v.x * v.x + q.a11 * v.y * v.y + q.a22 * v.z * v.z;
+			r += 2.0f * (q.a10 * v.x * v.y + q.a20 * v.x * v.z + q.a21 * v.y * v.z);
+			r += 2.0f * (q.b0 * v.x + q.b1 * v.y + q.b2 * v.z);
+			return q.w > 0.0f ? fabsf(r) / q.w : 0.0f;
+		}
+
+		// Outgoing half-edges of every vertex (CSR)
+		struct EdgeAdjacency
+		{
+			std::vector<UINT> offsets; // vertexCount + 1
+			std::vector<UINT> targets;
+
+			void Build(const std::vector<UINT>& indices, UINT vertexCount)
+			{
+				offsets.assign(vertexCount + 1, 0);
+				for (size_t i = 0; i < indices.size(); i++)
+					offsets[indices[i] + 1]++;
+				for (UINT v = 0; v < vertexCount; v++)
+					offsets[v + 1] += offsets[v];
+
+				std::vector<UINT> fill(offsets.begin(), offsets.end() - 1);
+				targets.resize(indices.size());
+				for (size_t i = 0; i < indices.size(); i += 3)
+				{
+					for (int e = 0; e < 3; e++)
+						targets[fill[indices[i + e]]++] = indices[i + (e + 1) % 3];
+				}
+			}
+
+			bool HasEdge(UINT from, UINT to) const
+			{
+				for (UINT i = offsets[from]; i < offsets[from + 1]; i++)
+					if (targets[i] == to)
+						return true;
+				return false;
+			}
+		};
+
+		struct Collapse
+		{
+			UINT from;
+			UINT to;
+			float error;
+		};
+
+		// true if moving 'from' (any wedge of its position) into 'to' flips one of the remaining triangles around it
+		bool HasTriangleFlips(const std::vector<UINT>& indices, const std::vector<UINT>& triangleOffsets, const std::vector<UINT>& triangles,
+			const std::vector<XMFLOAT3>& positions, const std::vector<UINT>& remap, const std::vector<UINT>& collapseRemap, UINT from, UINT to)
+		{
+			const UINT fromPosition = remap[from];
+			const UINT toPosition = remap[to];
+			const XMFLOAT3& newPosition = positions[to];
+
+			for (UINT t = triangleOffsets[fromPosition]; t < triangleOffsets[fromPosition + 1]; t++)
+			{
+				const UINT* triangle = &indices[triangles[t] * 3];
+
+				int corner = 0;
+				while (remap[triangle[corner]] != fromPosition)
+					corner++;
+
+				// vertices of the triangle could have been collapsed earlier in this pass
+				const UINT v1 = collapseRemap[triangle[(corner + 1) % 3]];
+				const UINT v2 = collapseRemap[triangle[(corner + 2) % 3]];
+				if (remap[v1] == toPosition || remap[v2] == toPosition) // collapses with the edge
+					continue;
+
+				const XMFLOAT3& oldPosition = positions[triangle[corner]];
+				const XMFLOAT3 oldNormal = Cross(Sub(positions[v1], oldPosition), Sub(positions[v2], oldPosition));
+				const XMFLOAT3 newNormal = Cross(Sub(positions[v1], newPosition), Sub(positions[v2], newPosition));
+				if (Dot(oldNormal, newNormal) <= 0.0f)
+					return true;
+			}
+			return false;
+		}
+	}
+
+	void ER_MeshSimplifier::GenerateVertexRemap(UINT aVertexCount, const std::vector<ER_VertexStream>& aStreams, std::vector<UINT>& aRemap)
+	{
+		auto compare = [&aStreams](UINT a, UINT b) -> int
+		{
+			for (const ER_VertexStream& stream : aStreams)
+			{
+				const char* data = static_cast<const char*>(stream.data);
+				const int result = memcmp(data + static_cast<size_t>(a) * stream.stride, data + static_cast<size_t>(b) * stream.stride, stream.stride);
+				if (result != 0)
+					return result;
+			}
+			return 0;
+		};
+
+		std::vector<UINT> order(aVertexCount);
+		for (UINT i = 0; i < aVertexCount; i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&compare](UINT a, UINT b)
+		{
+			const int result = compare(a, b);
+			return result != 0 ? result < 0 : a < b;
+		});
+
+		aRemap.resize(aVertexCount);
+		for (UINT i = 0; i < aVertexCount; i++)
+		{
+			// identical vertices are sorted by their index, so the first one of every run is the lowest index
+			const bool isFirst = i == 0 || compare(order[i - 1], order[i]) != 0;
+			aRemap[order[i]] = isFirst ? order[i] : aRemap[order[i - 1]];
+		}
+	}
+
+	float ER_MeshSimplifier::Simplify(const std::vector<UINT>& aIndices, const std::vector<XMFLOAT3>& aPositions, size_t aTargetIndexCount, float aTargetError, std::vector<UINT>& aResult)
+	{
+		assert(aIndices.size() % 3 == 0);
+		const UINT vertexCount = static_cast<UINT>(aPositions.size());
+		aTargetIndexCount = aTargetIndexCount / 3 * 3;
+
+		// degenerate triangles would break the classification
+		aResult.clear();
+		aResult.reserve(aIndices.size());
+		for (size_t i = 0; i < aIndices.size(); i += 3)
+		{
+			const UINT i0 = aIndices[i + 0], i1 = aIndices[i + 1], i2 = aIndices[i + 2];
+			assert(i0 < vertexCount && i1 < vertexCount && i2 < vertexCount);
+			if (i0 != i1 && i0 != i2 && i1 != i2)
+			{
+				aResult.push_back(i0);
+				aResult.push_back(i1);
+				aResult.push_back(i2);
+			}
+		}
+		if (aResult.size() <= aTargetIndexCount)
+			return 0.0f;
+
+		// positions in [0, 1], so that the error does not depend on the size of the mesh
+		XMFLOAT3 minPosition(FLT_MAX, FLT_MAX, FLT_MAX);
+		XMFLOAT3 maxPosition(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (const XMFLOAT3& position : aPositions)
+		{
+			minPosition = XMFLOAT3(std::min(minPosition.x, position.x), std::min(minPosition.y, position.y), std::min(minPosition.z, position.z));
+			maxPosition = XMFLOAT3(std::max(maxPosition.x, position.x), std::max(maxPosition.y, position.y), std::max(maxPosition.z, position.z));
+		}
+		const float extent = std::max(maxPosition.x - minPosition.x, std::max(maxPosition.y - minPosition.y, maxPosition.z - minPosition.z));
+		const float invExtent = extent > 0.0f ? 1.0f / extent : 0.0f;
+
+		std::vector<XMFLOAT3> positions(vertexCount);
+		for (UINT i = 0; i < vertexCount; i++)
+			positions[i] = Scale(Sub(aPositions[i], minPosition), invExtent);
+
+		// vertices with the same position (wedges): 'remap' points to the first one, 'wedge' is a circular list of all of them.
+		// Vertices that are not referenced (e.g. welded duplicates) are not wedges of anything.
+		std::vector<UINT> positionRemap;
+		GenerateVertexRemap(vertexCount, { { aPositions.data(), sizeof(XMFLOAT3) } }, positionRemap);
+		std::vector<UINT8> isUsed(vertexCount, 0);
+		for (UINT index : aResult)
+			isUsed[index] = 1;
+		std::vector<UINT> remap(vertexCount);
+		std::vector<UINT> firstUsed(vertexCount, INVALID_INDEX);
+		for (UINT i = 0; i < vertexCount; i++)
+		{
+			if (!isUsed[i])
+			{
+				remap[i] = i;
+				continue;
+			}
+			UINT& first = firstUsed[positionRemap[i]];
+			if (first == INVALID_INDEX)
+				first = i;
+			remap[i] = first;
+		}
+		std::vector<UINT> wedge(vertexCount);
+		for (UINT i = 0; i < vertexCount; i++)
+			wedge[i] = i;
+		for (UINT i = 0; i < vertexCount; i++)
+		{
+			if (remap[i] != i)
+			{
+				wedge[i] = wedge[remap[i]];
+				wedge[remap[i]] = i;
+			}
+		}
+
+		// open edges between vertex indices (not positions): on borders and on attribute seams.
+		// openIncoming/openOutgoing: the other vertex of the only open edge, INVALID_INDEX if there is none, the vertex itself if there are several
+		EdgeAdjacency adjacency;
+		adjacency.Build(aResult, vertexCount);
+
+		std::vector<UINT> openIncoming(vertexCount, INVALID_INDEX);
+		std::vector<UINT> openOutgoing(vertexCount, INVALID_INDEX);
+		for (UINT v = 0; v < vertexCount; v++)
+		{
+			for (UINT e = adjacency.offsets[v]; e < adjacency.offsets[v + 1]; e++)
+			{
+				const UINT target = adjacency.targets[e];
+				if (!adjacency.HasEdge(target, v))
+				{
+					openIncoming[target] = (openIncoming[target] == INVALID_INDEX) ? v : target;
+					openOutgoing[v] = (openOutgoing[v] == INVALID_INDEX) ? target : v;
+				}
+			}
+		}
+
+		auto isSingleOpenEdge = [](UINT vertex, UINT other) { return other != INVALID_INDEX && other != vertex; };
+
+		std::vector<UINT8> kinds(vertexCount, VERTEX_KIND_LOCKED);
+		for (UINT v = 0; v < vertexCount; v++)
+		{
+			if (remap[v] != v)
+			{
+				kinds[v] = kinds[remap[v]]; // the first wedge is always classified first
+				continue;
+			}
+
+			if (wedge[v] == v)
+			{
+				if (openIncoming[v] == INVALID_INDEX && openOutgoing[v] == INVALID_INDEX)
+					kinds[v] = VERTEX_KIND_MANIFOLD;
+				else if (isSingleOpenEdge(v, openIncoming[v]) && isSingleOpenEdge(v, openOutgoing[v]))
+					kinds[v] = VERTEX_KIND_BORDER;
+			}
+			else if (wedge[wedge[v]] == v)
+			{
+				// seam between two wedges: open edges of one side have to mirror the open edges of the other side
+				const UINT w = wedge[v];
+				if (isSingleOpenEdge(v, openIncoming[v]) && isSingleOpenEdge(v, openOutgoing[v]) && isSingleOpenEdge(w, openIncoming[w]) && isSingleOpenEdge(w, openOutgoing[w]) &&
+					remap[openIncoming[v]] == remap[openOutgoing[w]] && remap[openOutgoing[v]] == remap[openIncoming[w]])
+					kinds[v] = VERTEX_KIND_SEAM;
+			}
+		}
+
+		// quadrics per position: planes of the triangles (area weighted) and planes that keep the border/seam edges in place
+		std::vector<Quadric> quadrics(vertexCount);
+		for (size_t i = 0; i < aResult.size(); i += 3)
+		{
+			const UINT* triangle = &aResult[i];
+			const XMFLOAT3& p0 = positions[triangle[0]];
+			XMFLOAT3 normal = Cross(Sub(positions[triangle[1]], p0), Sub(positions[triangle[2]], p0));
+			const float area = Length(normal);
+			if (area > 0.0f)
+				normal = Scale(normal, 1.0f / area);
+			for (int c = 0; c < 3; c++)
+				AddPlane(quadrics[remap[triangle[c]]], normal, -Dot(normal, p0), area);
+
+			for (int e = 0; e < 3; e++)
+			{
+				const UINT from = triangle[e];
+				const UINT to = triangle[(e + 1) % 3];
+				if ((kinds[from] != VERTEX_KIND_BORDER && kinds[from] != VERTEX_KIND_SEAM) || adjacency.HasEdge(to, from))
+					continue;
+
+				// plane through the edge, perpendicular to the triangle
+				const XMFLOAT3& edgeStart = positions[from];
+				XMFLOAT3 edge = Sub(positions[to], edgeStart);
+				const float edgeLength = Length(edge);
+				if (edgeLength <= 0.0f)
+					continue;
+				edge = Scale(edge, 1.0f / edgeLength);
+				const XMFLOAT3 toOpposite = Sub(positions[triangle[(e + 2) % 3]], edgeStart);
+				XMFLOAT3 edgeNormal = Sub(toOpposite, Scale(edge, Dot(toOpposite, edge)));
+				const float edgeNormalLength = Length(edgeNormal);
+				if (edgeNormalLength <= 0.0f)
+					continue;
+				edgeNormal = Scale(edgeNormal, 1.0f / edgeNormalLength);
+
+				const float weight = edgeLength * edgeLength * ER_SIMPLIFIER_BORDER_WEIGHT;
+				AddPlane(quadrics[remap[from]], edgeNormal, -Dot(edgeNormal, edgeStart), weight);
+				AddPlane(quadrics[remap[to]], edgeNormal, -Dot(edgeNormal, edgeStart), weight);
+			}
+		}
+
+		const float targetErrorSqr = aTargetError * aTargetError;
+		float resultErrorSqr = 0.0f;
+
+		std::vector<UINT> collapseRemap(vertexCount);
+		std::vector<UINT8> collapseLocked(vertexCount);
+		std::vector<UINT> triangleOffsets(vertexCount + 1);
+		std::vector<UINT> triangles;
+		std::vector<Collapse> collapses;
+
+		while (aResult.size() > aTargetIndexCount)
+		{
+			// triangles around every position of the current index buffer
+			triangleOffsets.assign(vertexCount + 1, 0);
+			for (size_t i = 0; i < aResult.size(); i++)
+				triangleOffsets[remap[aResult[i]] + 1]++;
+			for (UINT v = 0; v < vertexCount; v++)
+				triangleOffsets[v + 1] += triangleOffsets[v];
+			triangles.resize(aResult.size());
+			{
+				std::vector<UINT> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+				for (size_t i = 0; i < aResult.size(); i++)
+					triangles[fill[remap[aResult[i]]]++] = static_cast<UINT>(i / 3);
+			}
+
+			// cheapest valid direction of every edge
+			collapses.clear();
+			for (size_t i = 0; i < aResult.size(); i += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					const UINT v0 = aResult[i + e];
+					const UINT v1 = aResult[i + (e + 1) % 3];
+					if (remap[v0] == remap[v1])
+						continue;
+
+					Collapse best = { INVALID_INDEX, INVALID_INDEX, FLT_MAX };
+					const UINT directions[2][2] = { { v0, v1 }, { v1, v0 } };
+					for (int d = 0; d < 2; d++)
+					{
+						const UINT from = directions[d][0];
+						const UINT to = directions[d][1];
+						if (!CAN_COLLAPSE[kinds[from]][kinds[to]])
+							continue;
+						// borders and seams can only slide along themselves
+						if ((kinds[from] == VERTEX_KIND_BORDER || kinds[from] == VERTEX_KIND_SEAM) && openOutgoing[from] != to && openIncoming[from] != to)
+							continue;
+
+						const float error = GetQuadricError(quadrics[remap[from]], positions[to]);
+						if (error < best.error)
+							best = { from, to, error };
+					}
+					if (best.from != INVALID_INDEX)
+						collapses.push_back(best);
+				}
+			}
+			if (collapses.empty())
+				break;
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+			{
+				if (a.error != b.error)
+					return a.error < b.error;
+				return a.from != b.from ? a.from < b.from : a.to < b.to;
+			});
+
+			// many collapses get locked by their neighbours, so the error limit of the pass is a bit above the error of the "ideal" last collapse
+			const size_t triangleCollapseGoal = (aResult.size() - aTargetIndexCount) / 3;
+			const size_t edgeCollapseGoal = triangleCollapseGoal / 2;
+			const float passErrorLimit = edgeCollapseGoal < collapses.size() ? 1.5f * collapses[edgeCollapseGoal].error : FLT_MAX;
+
+			for (UINT v = 0; v < vertexCount; v++)
+				collapseRemap[v] = v;
+			std::fill(collapseLocked.begin(), collapseLocked.end(), static_cast<UINT8>(0));
+
+			size_t triangleCollapses = 0;
+			for (const Collapse& collapse : collapses)
+			{
+				if (collapse.error > targetErrorSqr || collapse.error > passErrorLimit || triangleCollapses >= triangleCollapseGoal)
+					break;
+
+				const UINT fromPosition = remap[collapse.from];
+				const UINT toPosition = remap[collapse.to];
+				if (collapseLocked[fromPosition] || collapseLocked[toPosition])
+					continue;
+				if (HasTriangleFlips(aResult, triangleOffsets, triangles, positions, remap, collapseRemap, collapse.from, collapse.to))
+					continue;
+
+				AddQuadric(quadrics[toPosition], quadrics[fromPosition]);
+
+				const UINT kind = kinds[collapse.from];
+				collapseRemap[collapse.from] = collapse.to;
+				if (kind == VERTEX_KIND_SEAM)
+				{
+					// the other side of the seam collapses along the mirrored edge
+					const UINT otherFrom = wedge[collapse.from];
+					const UINT otherTo = (openOutgoing[collapse.from] == collapse.to) ? openIncoming[otherFrom] : openOutgoing[otherFrom];
+					collapseRemap[otherFrom] = otherTo;
+				}
+
+				collapseLocked[fromPosition] = 1;
+				collapseLocked[toPosition] = 1;
+				triangleCollapses += (kind == VERTEX_KIND_BORDER) ? 1 : 2;
+				resultErrorSqr = std::max(resultErrorSqr, collapse.error);
+			}
+			if (triangleCollapses == 0)
+				break;
+
+			size_t writeIndex = 0;
+			for (size_t i = 0; i < aResult.size(); i += 3)
+			{
+				const UINT i0 = collapseRemap[aResult[i + 0]];
+				const UINT i1 = collapseRemap[aResult[i + 1]];
+				const UINT i2 = collapseRemap[aResult[i + 2]];
+				if (i0 != i1 && i0 != i2 && i1 != i2)
+				{
+					aResult[writeIndex++] = i0;
+					aResult[writeIndex++] = i1;
+					aResult[writeIndex++] = i2;
+				}
+			}
+			aResult.resize(writeIndex);
+		}
+
+		return sqrtf(resultErrorSqr);
+	}
+}
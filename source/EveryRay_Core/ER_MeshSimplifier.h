@@ -0,0 +1,36 @@
+// Quadric error mesh simplification in EveryRay Rendering Engine (used for the automatic LOD generation, see ER_Model::GenerateLOD())
+// - "Surface Simplification Using Quadric Error Metrics" (M. Garland, P. Heckbert): edges are collapsed into one of their vertices in the order of the quadric error
+// - vertices are classified once: manifold (can collapse into any neighbour), border (only along the open edge), seam (only along the seam, both sides collapse together)
+//   and locked (never collapse), so attribute seams (UV/normal splits) and open borders keep their shape
+// - vertices are never moved or created: the result is an index buffer into the same vertices
+// Only works with triangle lists. Input has to be welded (see GenerateVertexRemap()), otherwise every vertex is a seam of many wedges and gets locked.
+
+#pragma once
+#include "Common.h"
+
+#define ER_SIMPLIFIER_BORDER_WEIGHT 10.0f // weight of the quadrics that keep border and seam edges in place
+
+namespace EveryRay_Core
+{
+	struct ER_VertexStream
+	{
+		const void* data;
+		UINT stride; // size of one element in bytes
+	};
+
+	class ER_MeshSimplifier
+	{
+	public:
+		// aRemap[i] - first vertex that is bitwise identical to vertex 'i' in all the streams
+		static void GenerateVertexRemap(UINT aVertexCount, const std::vector<ER_VertexStream>& aStreams, std::vector<UINT>& aRemap);
+
+		// Collapses edges until 'aTargetIndexCount' is reached or the next collapse would go above 'aTargetError' (relative to the extent of the mesh: 0.01 - 1%).
+		// Returns the error of the result (relative as well).
+		static float Simplify(const std::vector<UINT>& aIndices, const std::vector<XMFLOAT3>& aPositions, size_t aTargetIndexCount, float aTargetError, std::vector<UINT>& aResult);
+
+	private:
+		ER_MeshSimplifier();
+		ER_MeshSimplifier(const ER_MeshSimplifier& rhs);
+		ER_MeshSimplifier& operator=(const ER_MeshSimplifier& rhs);
+	};
+}
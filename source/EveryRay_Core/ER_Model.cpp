@@ -5,6 +5,11 @@
 #include "ER_ModelMaterial.h"
 #include "ER_Core.h"
 #include "ER_CoreException.h"
+#include "ER_MeshSimplifier.h"
+#include "ER_MeshOptimizer.h"
+#include "ER_Utility.h"
+
+#include <algorithm>
 
 #include "assimp\Importer.hpp"
 #include "assimp\scene.h"
@@ -12,6 +17,104 @@
 
 namespace EveryRay_Core
 {
+	namespace
+	{
+		// index caches (".erlod", ".eropt"): triangles per mesh with a hash of the source data
+		const UINT INDEX_CACHE_MAGIC = 0x444f4c45; // "ELOD"
+		const UINT INDEX_CACHE_VERSION = 2; // 2: LOD indices are optimized for the vertex cache and overdraw
+		std::mutex sIndexCacheMutex; // rendering objects with the same model can be loaded on different threads
+
+		// FNV-1a
+		void HashData(UINT64& hash, const void* data, size_t size)
+		{
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			for (size_t i = 0; i < size; i++)
+			{
+				hash ^= bytes[i];
+				hash *= 1099511628211ULL;
+			}
+		}
+
+		template <typename T>
+		void HashVector(UINT64& hash, const std::vector<T>& data)
+		{
+			const UINT64 count = data.size();
+			HashData(hash, &count, sizeof(count));
+			if (!data.empty())
+				HashData(hash, data.data(), data.size() * sizeof(T));
+		}
+
+		bool LoadIndexCache(const std::string& path, UINT64 sourceHash, const std::vector<ER_Mesh>& meshes, std::vector<std::vector<UINT>>& meshesIndices, std::vector<float>& meshesErrors)
+		{
+			std::lock_guard<std::mutex> lock(sIndexCacheMutex);
+			std::ifstream file(path.c_str(), std::ios::binary);
+			if (!file.is_open())
+				return false;
+
+			UINT magic = 0, version = 0, meshCount = 0;
+			UINT64 hash = 0;
+			file.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+			file.read(reinterpret_cast<char*>(&version), sizeof(version));
+			file.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+			file.read(reinterpret_cast<char*>(&meshCount), sizeof(meshCount));
+			if (!file || magic != INDEX_CACHE_MAGIC || version != INDEX_CACHE_VERSION || hash != sourceHash || meshCount != meshes.size())
+				return false;
+
+			auto invalidate = [&meshesIndices, &meshesErrors]()
+			{
+				meshesIndices.clear();
+				meshesErrors.clear();
+				return false;
+			};
+
+			meshesIndices.resize(meshCount);
+			meshesErrors.resize(meshCount);
+			for (UINT i = 0; i < meshCount; i++)
+			{
+				UINT indexCount = 0;
+				file.read(reinterpret_cast<char*>(&indexCount), sizeof(indexCount));
+				file.read(reinterpret_cast<char*>(&meshesErrors[i]), sizeof(float));
+				if (!file || indexCount % 3 != 0 || indexCount > meshes[i].Indices().size())
+					return invalidate();
+
+				meshesIndices[i].resize(indexCount);
+				file.read(reinterpret_cast<char*>(meshesIndices[i].data()), indexCount * sizeof(UINT));
+				if (!file)
+					return invalidate();
+
+				const size_t vertexCount = meshes[i].Vertices().size();
+				if (std::any_of(meshesIndices[i].begin(), meshesIndices[i].end(), [vertexCount](UINT index) { return index >= vertexCount; }))
+					return invalidate();
+			}
+			return true;
+		}
+
+		void SaveIndexCache(const std::string& path, UINT64 sourceHash, const std::vector<std::vector<UINT>>& meshesIndices, const std::vector<float>& meshesErrors)
+		{
+			std::lock_guard<std::mutex> lock(sIndexCacheMutex);
+			std::ofstream file(path.c_str(), std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				std::string message = "[ER Logger][ER_Model] Could not write index cache: " + path + "\n";
+				ER_OUTPUT_LOG(ER_Utility::ToWideString(message).c_str());
+				return;
+			}
+
+			const UINT meshCount = static_cast<UINT>(meshesIndices.size());
+			file.write(reinterpret_cast<const char*>(&INDEX_CACHE_MAGIC), sizeof(INDEX_CACHE_MAGIC));
+			file.write(reinterpret_cast<const char*>(&INDEX_CACHE_VERSION), sizeof(INDEX_CACHE_VERSION));
+			file.write(reinterpret_cast<const char*>(&sourceHash), sizeof(sourceHash));
+			file.write(reinterpret_cast<const char*>(&meshCount), sizeof(meshCount));
+			for (UINT i = 0; i < meshCount; i++)
+			{
+				const UINT indexCount = static_cast<UINT>(meshesIndices[i].size());
+				file.write(reinterpret_cast<const char*>(&indexCount), sizeof(indexCount));
+				file.write(reinterpret_cast<const char*>(&meshesErrors[i]), sizeof(float));
+				file.write(reinterpret_cast<const char*>(meshesIndices[i].data()), indexCount * sizeof(UINT));
+			}
+		}
+	}
+
 	ER_Model::ER_Model(ER_Core& game, const std::string& filename, bool flipUVs)
 		: mCore(game), mMeshes(), mMaterials()
 	{
@@ -44,6 +147,26 @@ namespace EveryRay_Core
 		}
 
 		mFilename = filename;
+		OptimizeMeshes();
+	}
+
+	ER_Model::ER_Model(const ER_Model& sourceModel, const std::vector<std::vector<UINT>>& meshesIndices)
+		: mCore(sourceModel.mCore), mMeshes(), mMaterials(), mFilename(sourceModel.mFilename)
+	{
+		assert(meshesIndices.size() == sourceModel.mMeshes.size());
+
+		// meshes keep references to the materials, so all of them are added first
+		mMaterials.reserve(sourceModel.mMaterials.size());
+		for (const ER_ModelMaterial& material : sourceModel.mMaterials)
+			mMaterials.push_back(ER_ModelMaterial(*this, material));
+
+		mMeshes.reserve(sourceModel.mMeshes.size());
+		for (size_t i = 0; i < sourceModel.mMeshes.size(); i++)
+		{
+			const ER_Mesh& sourceMesh = sourceModel.mMeshes[i];
+			const size_t materialIndex = &sourceMesh.GetMaterial() - sourceModel.mMaterials.data();
+			mMeshes.push_back(ER_Mesh(*this, mMaterials[materialIndex], sourceMesh, meshesIndices[i]));
+		}
 	}
 
 	ER_Model::~ER_Model()
@@ -106,4 +229,140 @@ namespace EveryRay_Core
 		mAABB = { minVertex, maxVertex };
 		return mAABB;
 	}
+
+	void ER_Model::OptimizeMeshes()
+	{
+		UINT64 sourceHash = 14695981039346656037ULL;
+		HashData(sourceHash, &INDEX_CACHE_VERSION, sizeof(INDEX_CACHE_VERSION));
+		for (const ER_Mesh& mesh : mMeshes)
+		{
+			HashVector(sourceHash, mesh.Vertices());
+			HashVector(sourceHash, mesh.Normals());
+			HashVector(sourceHash, mesh.Indices());
+		}
+
+		const std::string cachePath = mFilename + ".eropt";
+		std::vector<std::vector<UINT>> meshesIndices;
+		std::vector<float> meshesErrors; // not used (always 0)
+		if (!LoadIndexCache(cachePath, sourceHash, mMeshes, meshesIndices, meshesErrors))
+		{
+			float acmrOriginal = 0.0f;
+			float acmrOptimized = 0.0f;
+			UINT triangleCount = 0;
+			for (const ER_Mesh& mesh : mMeshes)
+			{
+				meshesIndices.push_back(mesh.Indices());
+				meshesErrors.push_back(0.0f);
+
+				// triangle lists only (meshes with points/lines are separated by the importer)
+				std::vector<UINT>& indices = meshesIndices.back();
+				if (indices.empty() || indices.size() != static_cast<size_t>(mesh.FaceCount()) * 3)
+					continue;
+
+				const UINT vertexCount = static_cast<UINT>(mesh.Vertices().size());
+				acmrOriginal += ER_MeshOptimizer::AnalyzeVertexCache(indices, vertexCount).acmr * mesh.FaceCount();
+				ER_MeshOptimizer::OptimizeVertexCache(indices, vertexCount);
+				ER_MeshOptimizer::OptimizeOverdraw(indices, mesh.Vertices(), mesh.Normals());
+				acmrOptimized += ER_MeshOptimizer::AnalyzeVertexCache(indices, vertexCount).acmr * mesh.FaceCount();
+				triangleCount += mesh.FaceCount();
+			}
+			SaveIndexCache(cachePath, sourceHash, meshesIndices, meshesErrors);
+
+			if (triangleCount > 0)
+			{
+				std::string message = "[ER Logger][ER_Model] Optimized index buffers of '" + mFilename + "': ACMR " + std::to_string(acmrOriginal / triangleCount) + " -> " + std::to_string(acmrOptimized / triangleCount) + "\n";
+				ER_OUTPUT_LOG(ER_Utility::ToWideString(message).c_str());
+			}
+		}
+
+		for (size_t i = 0; i < mMeshes.size(); i++)
+			mMeshes[i].SetIndices(meshesIndices[i]);
+	}
+
+	std::unique_ptr<ER_Model> ER_Model::GenerateLOD(int lodIndex, float triangleRatio, float maxError) const
+	{
+		assert(lodIndex > 0 && lodIndex < MAX_LOD);
+		triangleRatio = std::min(1.0f, std::max(0.0f, triangleRatio));
+
+		// the cache is only valid for the same source data and settings
+		UINT64 sourceHash = 14695981039346656037ULL;
+		HashData(sourceHash, &INDEX_CACHE_VERSION, sizeof(INDEX_CACHE_VERSION));
+		HashData(sourceHash, &triangleRatio, sizeof(triangleRatio));
+		HashData(sourceHash, &maxError, sizeof(maxError));
+		for (const ER_Mesh& mesh : mMeshes)
+		{
+			HashVector(sourceHash, mesh.Vertices());
+			HashVector(sourceHash, mesh.Normals());
+			HashVector(sourceHash, mesh.Tangents());
+			HashVector(sourceHash, mesh.BiNormals());
+			for (const std::vector<XMFLOAT3>& textureCoordinates : mesh.TextureCoordinates())
+				HashVector(sourceHash, textureCoordinates);
+			for (const std::vector<XMFLOAT4>& vertexColors : mesh.VertexColors())
+				HashVector(sourceHash, vertexColors);
+			HashVector(sourceHash, mesh.Indices());
+		}
+
+		const std::string cachePath = mFilename + ".lod" + std::to_string(lodIndex) + ".erlod";
+		std::vector<std::vector<UINT>> meshesIndices;
+		std::vector<float> meshesErrors;
+		const bool isCached = LoadIndexCache(cachePath, sourceHash, mMeshes, meshesIndices, meshesErrors);
+		if (!isCached)
+		{
+			for (const ER_Mesh& mesh : mMeshes)
+			{
+				meshesIndices.push_back({});
+				std::vector<UINT>& lodIndices = meshesIndices.back();
+				float error = 0.0f;
+
+				if (mesh.Indices().size() != static_cast<size_t>(mesh.FaceCount()) * 3) // not a triangle list
+					lodIndices = mesh.Indices();
+				else
+				{
+					// vertices are not joined by the importer: identical ones are welded, so that only real attribute seams split the surface
+					std::vector<ER_VertexStream> streams = { { mesh.Vertices().data(), sizeof(XMFLOAT3) } };
+					if (!mesh.Normals().empty())
+						streams.push_back({ mesh.Normals().data(), sizeof(XMFLOAT3) });
+					if (!mesh.Tangents().empty())
+						streams.push_back({ mesh.Tangents().data(), sizeof(XMFLOAT3) });
+					if (!mesh.BiNormals().empty())
+						streams.push_back({ mesh.BiNormals().data(), sizeof(XMFLOAT3) });
+					for (const std::vector<XMFLOAT3>& textureCoordinates : mesh.TextureCoordinates())
+						streams.push_back({ textureCoordinates.data(), sizeof(XMFLOAT3) });
+					for (const std::vector<XMFLOAT4>& vertexColors : mesh.VertexColors())
+						streams.push_back({ vertexColors.data(), sizeof(XMFLOAT4) });
+
+					std::vector<UINT> remap;
+					ER_MeshSimplifier::GenerateVertexRemap(static_cast<UINT>(mesh.Vertices().size()), streams, remap);
+					std::vector<UINT> weldedIndices(mesh.Indices());
+					for (UINT& index : weldedIndices)
+						index = remap[index];
+
+					const size_t targetIndexCount = static_cast<size_t>(static_cast<float>(mesh.FaceCount()) * triangleRatio) * 3;
+					error = ER_MeshSimplifier::Simplify(weldedIndices, mesh.Vertices(), targetIndexCount, maxError, lodIndices);
+					if (lodIndices.empty()) // everything collapsed
+					{
+						lodIndices = mesh.Indices();
+						error = 0.0f;
+					}
+					else
+					{
+						// same order as the source meshes (see OptimizeMeshes()); LOD vertices are copied in the order of the first use
+						ER_MeshOptimizer::OptimizeVertexCache(lodIndices, static_cast<UINT>(mesh.Vertices().size()));
+						ER_MeshOptimizer::OptimizeOverdraw(lodIndices, mesh.Vertices(), mesh.Normals());
+					}
+				}
+				meshesErrors.push_back(error);
+			}
+			SaveIndexCache(cachePath, sourceHash, meshesIndices, meshesErrors);
+		}
+
+		for (size_t i = 0; i < mMeshes.size(); i++)
+		{
+			std::string message = "[ER Logger][ER_Model] " + std::string(isCached ? "Loaded cached" : "Generated") + " LOD #" + std::to_string(lodIndex) + " of '" + mFilename + "', mesh '" + mMeshes[i].Name() + "': " +
+				std::to_string(mMeshes[i].FaceCount()) + " -> " + std::to_string(meshesIndices[i].size() / 3) + " triangles, error: " + std::to_string(meshesErrors[i]) + "\n";
+			ER_OUTPUT_LOG(ER_Utility::ToWideString(message).c_str());
+		}
+
+		return std::unique_ptr<ER_Model>(new ER_Model(*this, meshesIndices));
+	}
 }
\ No newline at end of file
@@ -2,6 +2,9 @@
 
 #include "Common.h"
 
+#define ER_LOD_TRIANGLE_RATIO 0.5f // default ratio of the triangles between two generated LODs
+#define ER_LOD_MAX_ERROR 0.05f // max simplification error of the generated LODs, relative to the extent of a mesh
+
 namespace EveryRay_Core
 {
 	class ER_Core;
@@ -12,6 +15,7 @@ namespace EveryRay_Core
 	{
 	public:
 		ER_Model(ER_Core& game, const std::string& filename, bool flipUVs = false);
+		ER_Model(const ER_Model& sourceModel, const std::vector<std::vector<UINT>>& meshesIndices); // LOD: triangles per mesh of 'sourceModel'
 		~ER_Model();
 
 		ER_Core& GetCore();
@@ -25,7 +29,13 @@ namespace EveryRay_Core
 		const char* GetFileNameChar() { return mFilename.c_str(); }
 		const ER_AABB& GenerateAABB();
 
+		// Simplified copy of the model with 'triangleRatio' of its triangles (per mesh); cached in "<model file>.lod<index>.erlod"
+		std::unique_ptr<ER_Model> GenerateLOD(int lodIndex, float triangleRatio, float maxError = ER_LOD_MAX_ERROR) const;
+
 	private:
+		// Reorders the triangles of the meshes for the vertex cache and overdraw (see ER_MeshOptimizer); cached in "<model file>.eropt"
+		void OptimizeMeshes();
+
 		ER_Model(const ER_Model& rhs);
 		ER_Model& operator=(const ER_Model& rhs);
 
@@ -47,6 +47,11 @@ namespace EveryRay_Core
 		}
 	}
 
+	ER_ModelMaterial::ER_ModelMaterial(ER_Model& model, const ER_ModelMaterial& source)
+		: mModel(model), mName(source.mName), mTextures(source.mTextures)
+	{
+	}
+
 	ER_ModelMaterial::~ER_ModelMaterial()
 	{
 	}
@@ -27,6 +27,7 @@ namespace EveryRay_Core
 	public:
 		ER_ModelMaterial(ER_Model& model, aiMaterial* material);
 		ER_ModelMaterial(ER_Model& model);
+		ER_ModelMaterial(ER_Model& model, const ER_ModelMaterial& source); // same textures for another model (LODs)
 		~ER_ModelMaterial();
 
 		ER_Model& GetModel();
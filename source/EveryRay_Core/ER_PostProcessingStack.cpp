@@ -40,14 +40,7 @@ namespace EveryRay_Core {
 
 	ER_PostProcessingStack::~ER_PostProcessingStack()
 	{
-		DeleteObject(mTonemappingRT);
-		DeleteObject(mSSRRT);
-		DeleteObject(mSSSRT);
-		DeleteObject(mColorGradingRT);
-		DeleteObject(mVignetteRT);
-		DeleteObject(mFXAART);
-		DeleteObject(mLinearFogRT);
-		DeleteObject(mVolumetricFogRT);
+		DeleteObject(mRenderGraph);
 
 		DeleteObject(mTonemappingPS);
 		DeleteObject(mSSRPS);
@@ -78,6 +71,8 @@ namespace EveryRay_Core {
 	{
 		auto rhi = mCore.GetRHI();
 
+		mRenderGraph = new ER_RenderGraph("Post Processing Stack");
+
 		mFinalResolvePS = rhi->CreateGPUShader();
 		mFinalResolvePS->CompileShader(rhi, "content\\shaders\\EmptyColorResolve.hlsl", "PSMain", ER_PIXEL);
 		mFinalResolveRS = rhi->CreateRootSignature(1, 1);
@@ -97,10 +92,6 @@ namespace EveryRay_Core {
 			
 			mLinearFogConstantBuffer.Initialize(rhi, "ER_RHI_GPUBuffer: Linear Fog CB");
 
-			mLinearFogRT = rhi->CreateGPUTexture(L"ER_RHI_GPUTexture: Linear Fog RT");
-			mLinearFogRT->CreateGPUTextureResource(rhi, static_cast<UINT>(mCore.ScreenWidth()), static_cast<UINT>(mCore.ScreenHeight()), 1u,
-				ER_FORMAT_R11G11B10_FLOAT, ER_BIND_SHADER_RESOURCE | ER_BIND_RENDER_TARGET, 1);
-
 			mLinearFogRS = rhi->CreateRootSignature(2, 1);
 			if (mLinearFogRS)
 			{
@@ -111,10 +102,6 @@ namespace EveryRay_Core {
 			}
 		}
 
-		mVolumetricFogRT = rhi->CreateGPUTexture(L"ER_RHI_GPUTexture: Volumetric Fog RT");
-		mVolumetricFogRT->CreateGPUTextureResource(rhi, static_cast<UINT>(mCore.ScreenWidth()), static_cast<UINT>(mCore.ScreenHeight()), 1u,
-			ER_FORMAT_R11G11B10_FLOAT, ER_BIND_SHADER_RESOURCE | ER_BIND_RENDER_TARGET, 1);
-
 		//SSR
 		{
 			mUseSSR = pSSR;
@@ -124,9 +111,6 @@ namespace EveryRay_Core {
 
 			mSSRConstantBuffer.Initialize(rhi, "ER_RHI_GPUBuffer: SSR CB");
 			
-			mSSRRT = rhi->CreateGPUTexture(L"ER_RHI_GPUTexture: SSR RT");
-			mSSRRT->CreateGPUTextureResource(rhi, static_cast<UINT>(mCore.ScreenWidth()), static_cast<UINT>(mCore.ScreenHeight()), 1u,
-				ER_FORMAT_R11G11B10_FLOAT, ER_BIND_SHADER_RESOURCE | ER_BIND_RENDER_TARGET, 1);
 
 			mSSRRS = rhi->CreateRootSignature(2, 1);
 			if (mSSRRS)
@@ -147,10 +131,6 @@ namespace EveryRay_Core {
 
 			mSSSConstantBuffer.Initialize(rhi, "ER_RHI_GPUBuffer: SSS CB");
 
-			mSSSRT = rhi->CreateGPUTexture(L"ER_RHI_GPUTexture: SSS RT");
-			mSSSRT->CreateGPUTextureResource(rhi, static_cast<UINT>(mCore.ScreenWidth()), static_cast<UINT>(mCore.ScreenHeight()), 1u,
-				ER_FORMAT_R11G11B10_FLOAT, ER_BIND_SHADER_RESOURCE | ER_BIND_RENDER_TARGET, 1);
-
 			mSSSRS = rhi->CreateRootSignature(2, 1);
 			if (mSSSRS)
 			{
@@ -168,10 +148,6 @@ namespace EveryRay_Core {
 			mTonemappingPS = rhi->CreateGPUShader();
 			mTonemappingPS->CompileShader(rhi, "content\\shaders\\Tonemap.hlsl", "PSMain", ER_PIXEL);
 
-			mTonemappingRT = rhi->CreateGPUTexture(L"ER_RHI_GPUTexture: Tonemapping RT");
-			mTonemappingRT->CreateGPUTextureResource(rhi, static_cast<UINT>(mCore.ScreenWidth()), static_cast<UINT>(mCore.ScreenHeight()), 1u,
-				ER_FORMAT_R11G11B10_FLOAT, ER_BIND_SHADER_RESOURCE | ER_BIND_RENDER_TARGET, 1);
-
 			mTonemapRS = rhi->CreateRootSignature(1, 1);
 			if (mTonemapRS)
 			{
@@ -195,10 +171,6 @@ namespace EveryRay_Core {
 			mColorGradingPS = rhi->CreateGPUShader();
 			mColorGradingPS->CompileShader(rhi, "content\\shaders\\ColorGrading.hlsl", "PSMain", ER_PIXEL);
 
-			mColorGradingRT = rhi->CreateGPUTexture(L"ER_RHI_GPUTexture: Color Grading RT");
-			mColorGradingRT->CreateGPUTextureResource(rhi, static_cast<UINT>(mCore.ScreenWidth()), static_cast<UINT>(mCore.ScreenHeight()), 1u,
-				ER_FORMAT_R11G11B10_FLOAT, ER_BIND_SHADER_RESOURCE | ER_BIND_RENDER_TARGET, 1);
-
 			mColorGradingRS = rhi->CreateRootSignature(1, 0);
 			if (mColorGradingRS)
 			{
@@ -216,9 +188,6 @@ namespace EveryRay_Core {
 
 			mVignetteConstantBuffer.Initialize(rhi, "ER_RHI_GPUBuffer: Vignette CB");
 			
-			mVignetteRT = rhi->CreateGPUTexture(L"ER_RHI_GPUTexture: Vignette RT");
-			mVignetteRT->CreateGPUTextureResource(rhi, static_cast<UINT>(mCore.ScreenWidth()), static_cast<UINT>(mCore.ScreenHeight()), 1u,
-				ER_FORMAT_R11G11B10_FLOAT, ER_BIND_SHADER_RESOURCE | ER_BIND_RENDER_TARGET, 1);
 
 			mVignetteRS = rhi->CreateRootSignature(2, 1);
 			if (mVignetteRS)
@@ -239,10 +208,6 @@ namespace EveryRay_Core {
 
 			mFXAAConstantBuffer.Initialize(rhi, "ER_RHI_GPUBuffer: FXAA CB");
 
-			mFXAART = rhi->CreateGPUTexture(L"ER_RHI_GPUTexture: FXAA RT");
-			mFXAART->CreateGPUTextureResource(rhi, static_cast<UINT>(mCore.ScreenWidth()), static_cast<UINT>(mCore.ScreenHeight()), 1u,
-				ER_FORMAT_R11G11B10_FLOAT, ER_BIND_SHADER_RESOURCE | ER_BIND_RENDER_TARGET, 1);
-
 			mFXAARS = rhi->CreateRootSignature(2, 1);
 			if (mFXAARS)
 			{
@@ -332,6 +297,18 @@ namespace EveryRay_Core {
 			ImGui::Checkbox("FXAA - On", &mUseFXAA);
 		}
 
+		if (ImGui::CollapsingHeader("Render Graph") && mRenderGraph)
+		{
+			const ER_RenderGraphStats& stats = mRenderGraph->GetStats();
+			const float toMB = 1.0f / (1024.0f * 1024.0f);
+			ImGui::Text("Passes: %u (culled: %u)", stats.passesCount, stats.culledPassesCount);
+			ImGui::Text("Transitions: %u", stats.transitionsCount);
+			ImGui::Text("Transient textures: %u (physical: %u)", stats.transientTexturesCount, stats.physicalTexturesCount);
+			ImGui::Text("Transient memory without aliasing: %.2f MB", static_cast<float>(stats.transientMemoryWithoutAliasing) * toMB);
+			ImGui::Text("Transient memory (pooled): %.2f MB", static_cast<float>(stats.transientMemoryPooled) * toMB);
+			ImGui::Text("Transient memory peak: %.2f MB", static_cast<float>(stats.transientMemoryPeak) * toMB);
+		}
+
 		ImGui::End();
 	}
 	
@@ -350,17 +327,15 @@ namespace EveryRay_Core {
 		auto rhi = mCore.GetRHI();
 		rhi->UnbindRenderTargets();
 
-		rhi->SetMainRenderTargets();
-
-		rhi->SetTopologyType(ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		rhi->SetRootSignature(mFinalResolveRS);
-
 		//final resolve to main RT (pre-UI)
+		const ER_RenderGraphHandle resolveInput = aResolveRT ? mRenderGraph->ImportTexture("Resolve Input", aResolveRT) : mRenderTargetBeforeResolve;
+		mRenderGraph->AddPass("EveryRay: Post Processing (Final Resolve)", [this, resolveInput](ER_RHI* rhi, const ER_RenderGraph& graph)
 		{
-			ER_QuadRenderer* quad = (ER_QuadRenderer*)mCore.GetServices().FindService(ER_QuadRenderer::TypeIdClass());
+			ER_QuadRenderer* quad = mCore.GetServices().FindService<ER_QuadRenderer>();
 			assert(quad);
-			assert(mRenderTargetBeforeResolve);
 
+			rhi->SetMainRenderTargets();
+			rhi->SetRootSignature(mFinalResolveRS);
 			if (!rhi->IsPSOReady(mFinalResolvePassPSOName))
 			{
 				rhi->InitializePSO(mFinalResolvePassPSOName);
@@ -376,11 +351,21 @@ namespace EveryRay_Core {
 			}
 			rhi->SetPSO(mFinalResolvePassPSOName);
 			rhi->SetSamplers(ER_PIXEL, { ER_RHI_SAMPLER_STATE::ER_TRILINEAR_WRAP });
-			rhi->SetShaderResources(ER_PIXEL, { aResolveRT ? aResolveRT : mRenderTargetBeforeResolve }, 0, mFinalResolveRS, FINALRESOLVE_PASS_ROOT_DESCRIPTOR_TABLE_SRV_INDEX);
+			rhi->SetShaderResources(ER_PIXEL, { graph.GetTexture(resolveInput) }, 0, mFinalResolveRS, FINALRESOLVE_PASS_ROOT_DESCRIPTOR_TABLE_SRV_INDEX);
 			quad->Draw(rhi);
 			rhi->UnsetPSO();
+		}).Read(resolveInput).SetSideEffects(); // main RT is not a part of the graph
+
+		if (!mRenderGraph->Compile())
+		{
+			for (const std::string& error : mRenderGraph->GetErrors())
+				ER_OUTPUT_LOG(ER_Utility::ToWideString(error + "\n").c_str());
+			throw ER_CoreException("ER_PostProcessingStack: Render graph of the post processing stack is invalid!");
 		}
 
+		rhi->SetTopologyType(ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		mRenderGraph->Execute(rhi);
+
 		rhi->UnbindResourcesFromShader(ER_PIXEL);
 	}
 
@@ -485,62 +470,78 @@ namespace EveryRay_Core {
 		rhi->SetConstantBuffers(ER_PIXEL, { mFXAAConstantBuffer.Buffer() }, 0, mFXAARS, FXAA_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX);
 	}
 
+	// Only records the passes into the render graph, they are executed in End()
 	void ER_PostProcessingStack::DrawEffects(const ER_CoreTime& gameTime, ER_QuadRenderer* quad, ER_GBuffer* gbuffer, ER_VolumetricClouds* aVolumetricClouds, ER_VolumetricFog* aVolumetricFog)
 	{
 		assert(quad);
 		assert(gbuffer);
-		auto rhi = mCore.GetRHI();
-
-		mRenderTargetBeforeResolve = mRenderTargetBeforePostProcessingPasses;
-		rhi->SetTopologyType(ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+		assert(mRenderTargetBeforePostProcessingPasses && mDepthTarget);
+
+		mRenderGraph->Reset();
+		mRenderTargetBeforeResolve = mRenderGraph->ImportTexture("Post Processing Input", mRenderTargetBeforePostProcessingPasses);
+		const ER_RenderGraphHandle depth = mRenderGraph->ImportTexture("Depth", mDepthTarget);
+		const ER_RenderGraphHandle normals = mRenderGraph->ImportTexture("GBuffer Normals", gbuffer->GetNormals());
+		const ER_RenderGraphHandle positions = mRenderGraph->ImportTexture("GBuffer Positions", gbuffer->GetPositions());
+		const ER_RenderGraphHandle extra = mRenderGraph->ImportTexture("GBuffer Extra", gbuffer->GetExtraBuffer());
+		const ER_RenderGraphHandle extra2 = mRenderGraph->ImportTexture("GBuffer Extra2", gbuffer->GetExtra2Buffer());
+
+		ER_RenderGraphTextureDesc effectRTDesc;
+		effectRTDesc.width = static_cast<UINT>(mCore.ScreenWidth());
+		effectRTDesc.height = static_cast<UINT>(mCore.ScreenHeight());
+		effectRTDesc.format = ER_FORMAT_R11G11B10_FLOAT;
+		effectRTDesc.bindFlags = ER_BIND_SHADER_RESOURCE | ER_BIND_RENDER_TARGET;
 
 		// Linear fog
 		if (mUseLinearFog)
 		{
-			rhi->BeginEventTag("EveryRay: Post Processing (Linear Fog)");
-
-			rhi->SetRenderTargets({ mLinearFogRT });
-			rhi->SetRootSignature(mLinearFogRS);
-			if (!rhi->IsPSOReady(mLinearFogPassPSOName))
+			const ER_RenderGraphHandle input = mRenderTargetBeforeResolve;
+			const ER_RenderGraphHandle output = mRenderGraph->CreateTexture("Linear Fog RT", effectRTDesc);
+			mRenderGraph->AddPass("EveryRay: Post Processing (Linear Fog)", [this, quad, input, output](ER_RHI* rhi, const ER_RenderGraph& graph)
 			{
-				rhi->InitializePSO(mLinearFogPassPSOName);
-				rhi->SetShader(mLinearFogPS);
-				rhi->SetRenderTargetFormats({ mLinearFogRT });
-				rhi->SetBlendState(ER_NO_BLEND);
-				rhi->SetRasterizerState(ER_NO_CULLING);
-				rhi->SetRootSignatureToPSO(mLinearFogPassPSOName, mLinearFogRS);
-				rhi->SetTopologyTypeToPSO(mLinearFogPassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-				quad->PrepareDraw(rhi);
-				rhi->FinalizePSO(mLinearFogPassPSOName);
-			}
-			rhi->SetPSO(mLinearFogPassPSOName);
-			PrepareDrawingLinearFog(mRenderTargetBeforeResolve);
-			quad->Draw(rhi);
-			rhi->UnsetPSO();
-			
-			rhi->UnbindRenderTargets();
+				ER_RHI_GPUTexture* outputRT = graph.GetTexture(output);
 
-			//[WARNING] Set from last post processing effect
-			mRenderTargetBeforeResolve = mLinearFogRT;
+				rhi->SetRenderTargets({ outputRT });
+				rhi->SetRootSignature(mLinearFogRS);
+				if (!rhi->IsPSOReady(mLinearFogPassPSOName))
+				{
+					rhi->InitializePSO(mLinearFogPassPSOName);
+					rhi->SetShader(mLinearFogPS);
+					rhi->SetRenderTargetFormats({ outputRT });
+					rhi->SetBlendState(ER_NO_BLEND);
+					rhi->SetRasterizerState(ER_NO_CULLING);
+					rhi->SetRootSignatureToPSO(mLinearFogPassPSOName, mLinearFogRS);
+					rhi->SetTopologyTypeToPSO(mLinearFogPassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+					quad->PrepareDraw(rhi);
+					rhi->FinalizePSO(mLinearFogPassPSOName);
+				}
+				rhi->SetPSO(mLinearFogPassPSOName);
+				PrepareDrawingLinearFog(graph.GetTexture(input));
+				quad->Draw(rhi);
+				rhi->UnsetPSO();
+
+				rhi->UnbindRenderTargets();
+			}).Read(input).Read(depth).Write(output);
 
-			rhi->EndEventTag();
+			//[WARNING] Set from last post processing effect
+			mRenderTargetBeforeResolve = output;
 		}
 
 		// SSS
-		if (mUseSSS)
+		if (mUseSSS && mCore.GetLevel()->mIllumination->IsSSSBlurring())
 		{
-			rhi->BeginEventTag("EveryRay: Post Processing (SSS)");
-
-			ER_Illumination* illumination = mCore.GetLevel()->mIllumination;
-			if (illumination->IsSSSBlurring())
+			const ER_RenderGraphHandle input = mRenderTargetBeforeResolve;
+			const ER_RenderGraphHandle output = mRenderGraph->CreateTexture("SSS RT", effectRTDesc);
+			mRenderGraph->AddPass("EveryRay: Post Processing (SSS)", [this, quad, gbuffer, gameTime, input, output](ER_RHI* rhi, const ER_RenderGraph& graph)
 			{
-				rhi->SetRenderTargets({ mSSSRT });
+				ER_RHI_GPUTexture* outputRT = graph.GetTexture(output);
+
+				rhi->SetRenderTargets({ outputRT });
 				rhi->SetRootSignature(mSSSRS);
 				if (!rhi->IsPSOReady(mSSSPassPSOName))
 				{
 					rhi->InitializePSO(mSSSPassPSOName);
 					rhi->SetShader(mSSSPS);
-					rhi->SetRenderTargetFormats({ mSSSRT });
+					rhi->SetRenderTargetFormats({ outputRT });
 					rhi->SetBlendState(ER_NO_BLEND);
 					rhi->SetRasterizerState(ER_NO_CULLING);
 					rhi->SetRootSignatureToPSO(mSSSPassPSOName, mSSSRS);
@@ -552,206 +553,224 @@ namespace EveryRay_Core {
 
 				//vertical
 				{
-					PrepareDrawingSSS(gameTime, mRenderTargetBeforeResolve, gbuffer, true);
+					PrepareDrawingSSS(gameTime, graph.GetTexture(input), gbuffer, true);
 					quad->Draw(rhi, false);
 				}
 				//horizontal
 				{
-					PrepareDrawingSSS(gameTime, mRenderTargetBeforeResolve, gbuffer, false);
+					PrepareDrawingSSS(gameTime, graph.GetTexture(input), gbuffer, false);
 					quad->Draw(rhi);
 				}
 				rhi->UnsetPSO();
 
 				rhi->UnbindRenderTargets();
-				//[WARNING] Set from last post processing effect
-				mRenderTargetBeforeResolve = mSSSRT;
-			}
+			}).Read(input).Read(depth).Read(extra2).Write(output);
 
-			rhi->EndEventTag();
+			//[WARNING] Set from last post processing effect
+			mRenderTargetBeforeResolve = output;
 		}
 
 		// SSR
 		if (mUseSSR)
 		{
-			rhi->BeginEventTag("EveryRay: Post Processing (SSR)");
-
-			rhi->SetRenderTargets({ mSSRRT });
-			rhi->SetRootSignature(mSSRRS);
-			if (!rhi->IsPSOReady(mSSRPassPSOName))
+			const ER_RenderGraphHandle input = mRenderTargetBeforeResolve;
+			const ER_RenderGraphHandle output = mRenderGraph->CreateTexture("SSR RT", effectRTDesc);
+			mRenderGraph->AddPass("EveryRay: Post Processing (SSR)", [this, quad, gbuffer, gameTime, input, output](ER_RHI* rhi, const ER_RenderGraph& graph)
 			{
-				rhi->InitializePSO(mSSRPassPSOName);
-				rhi->SetShader(mSSRPS);
-				rhi->SetRenderTargetFormats({ mSSRRT });
-				rhi->SetBlendState(ER_NO_BLEND);
-				rhi->SetRasterizerState(ER_NO_CULLING);
-				rhi->SetRootSignatureToPSO(mSSRPassPSOName, mSSRRS);
-				rhi->SetTopologyTypeToPSO(mSSRPassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-				quad->PrepareDraw(rhi);
-				rhi->FinalizePSO(mSSRPassPSOName);
-			}
-			rhi->SetPSO(mSSRPassPSOName);
-			PrepareDrawingSSR(gameTime, mRenderTargetBeforeResolve, gbuffer);
-			quad->Draw(rhi);
-			rhi->UnsetPSO();
+				ER_RHI_GPUTexture* outputRT = graph.GetTexture(output);
+
+				rhi->SetRenderTargets({ outputRT });
+				rhi->SetRootSignature(mSSRRS);
+				if (!rhi->IsPSOReady(mSSRPassPSOName))
+				{
+					rhi->InitializePSO(mSSRPassPSOName);
+					rhi->SetShader(mSSRPS);
+					rhi->SetRenderTargetFormats({ outputRT });
+					rhi->SetBlendState(ER_NO_BLEND);
+					rhi->SetRasterizerState(ER_NO_CULLING);
+					rhi->SetRootSignatureToPSO(mSSRPassPSOName, mSSRRS);
+					rhi->SetTopologyTypeToPSO(mSSRPassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+					quad->PrepareDraw(rhi);
+					rhi->FinalizePSO(mSSRPassPSOName);
+				}
+				rhi->SetPSO(mSSRPassPSOName);
+				PrepareDrawingSSR(gameTime, graph.GetTexture(input), gbuffer);
+				quad->Draw(rhi);
+				rhi->UnsetPSO();
 
-			rhi->UnbindRenderTargets();
+				rhi->UnbindRenderTargets();
+			}).Read(input).Read(normals).Read(extra).Read(extra2).Read(depth).Write(output);
 
 			//[WARNING] Set from last post processing effect
-			mRenderTargetBeforeResolve = mSSRRT;
-
-			rhi->EndEventTag();
+			mRenderTargetBeforeResolve = output;
 		}
 
-
 		// Composite with volumetric fog (if enabled)
-		rhi->BeginEventTag("EveryRay: Post Processing (Volumetric Fog - Composite)");
+		if (aVolumetricFog && aVolumetricFog->IsEnabled())
 		{
-			if (aVolumetricFog && aVolumetricFog->IsEnabled())
+			const ER_RenderGraphHandle input = mRenderTargetBeforeResolve;
+			const ER_RenderGraphHandle output = mRenderGraph->CreateTexture("Volumetric Fog RT", effectRTDesc);
+			mRenderGraph->AddPass("EveryRay: Post Processing (Volumetric Fog - Composite)", [aVolumetricFog, input, output, positions](ER_RHI* rhi, const ER_RenderGraph& graph)
 			{
-				rhi->SetRenderTargets({ mVolumetricFogRT });
-				aVolumetricFog->Composite(mVolumetricFogRT, mRenderTargetBeforeResolve, gbuffer->GetPositions());
+				ER_RHI_GPUTexture* outputRT = graph.GetTexture(output);
+
+				rhi->SetRenderTargets({ outputRT });
+				aVolumetricFog->Composite(outputRT, graph.GetTexture(input), graph.GetTexture(positions));
 				rhi->UnbindRenderTargets();
+			}).Read(input).Read(positions).Write(output);
 
-				//[WARNING] Set from last post processing effect
-				mRenderTargetBeforeResolve = mVolumetricFogRT;
-			}
+			//[WARNING] Set from last post processing effect
+			mRenderTargetBeforeResolve = output;
 		}
-		rhi->EndEventTag();
 
-		rhi->BeginEventTag("EveryRay: Post Processing (Volumetric Clouds - Composite)");
+		// Composite with volumetric clouds (if enabled): in-place
+		if (aVolumetricClouds && aVolumetricClouds->IsEnabled())
 		{
-			// Composite with volumetric clouds (if enabled)
-			if (aVolumetricClouds && aVolumetricClouds->IsEnabled())
-				aVolumetricClouds->Composite(mRenderTargetBeforeResolve);
+			const ER_RenderGraphHandle target = mRenderTargetBeforeResolve;
+			mRenderGraph->AddPass("EveryRay: Post Processing (Volumetric Clouds - Composite)", [aVolumetricClouds, target](ER_RHI* rhi, const ER_RenderGraph& graph)
+			{
+				aVolumetricClouds->Composite(graph.GetTexture(target));
+			}).Write(target);
 		}
-		rhi->EndEventTag();
 
 		// Tonemap
 		if (mUseTonemap)
 		{
-			rhi->BeginEventTag("EveryRay: Post Processing (Tonemap)");
-
-			rhi->SetRenderTargets({ mTonemappingRT });
-			rhi->SetRootSignature(mTonemapRS);
-			if (!rhi->IsPSOReady(mTonemapPassPSOName))
+			const ER_RenderGraphHandle input = mRenderTargetBeforeResolve;
+			const ER_RenderGraphHandle output = mRenderGraph->CreateTexture("Tonemapping RT", effectRTDesc);
+			mRenderGraph->AddPass("EveryRay: Post Processing (Tonemap)", [this, quad, gbuffer, input, output](ER_RHI* rhi, const ER_RenderGraph& graph)
 			{
-				rhi->InitializePSO(mTonemapPassPSOName);
-				rhi->SetShader(mTonemappingPS);
-				rhi->SetBlendState(ER_NO_BLEND);
-				rhi->SetRasterizerState(ER_NO_CULLING);
-				rhi->SetRenderTargetFormats({ mTonemappingRT });
-				rhi->SetRootSignatureToPSO(mTonemapPassPSOName, mTonemapRS);
-				rhi->SetTopologyTypeToPSO(mTonemapPassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-				quad->PrepareDraw(rhi);
-				rhi->FinalizePSO(mTonemapPassPSOName);
-			}
-			rhi->SetPSO(mTonemapPassPSOName);
-			PrepareDrawingTonemapping(mRenderTargetBeforeResolve, gbuffer);
-			quad->Draw(rhi);
-			rhi->UnsetPSO();
+				ER_RHI_GPUTexture* outputRT = graph.GetTexture(output);
+
+				rhi->SetRenderTargets({ outputRT });
+				rhi->SetRootSignature(mTonemapRS);
+				if (!rhi->IsPSOReady(mTonemapPassPSOName))
+				{
+					rhi->InitializePSO(mTonemapPassPSOName);
+					rhi->SetShader(mTonemappingPS);
+					rhi->SetBlendState(ER_NO_BLEND);
+					rhi->SetRasterizerState(ER_NO_CULLING);
+					rhi->SetRenderTargetFormats({ outputRT });
+					rhi->SetRootSignatureToPSO(mTonemapPassPSOName, mTonemapRS);
+					rhi->SetTopologyTypeToPSO(mTonemapPassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+					quad->PrepareDraw(rhi);
+					rhi->FinalizePSO(mTonemapPassPSOName);
+				}
+				rhi->SetPSO(mTonemapPassPSOName);
+				PrepareDrawingTonemapping(graph.GetTexture(input), gbuffer);
+				quad->Draw(rhi);
+				rhi->UnsetPSO();
 
-			rhi->UnbindRenderTargets();
+				rhi->UnbindRenderTargets();
+			}).Read(input).Read(depth).Write(output);
 
 			//[WARNING] Set from last post processing effect
-			mRenderTargetBeforeResolve = mTonemappingRT;
-
-			rhi->EndEventTag();
+			mRenderTargetBeforeResolve = output;
 		}
 
 		// Color grading
 		if (mUseColorGrading)
 		{
-			rhi->BeginEventTag("EveryRay: Post Processing (Color Grading)");
-
-			rhi->SetRenderTargets({ mColorGradingRT });
-			rhi->SetRootSignature(mColorGradingRS);
-			if (!rhi->IsPSOReady(mColorGradingPassPSOName))
+			const ER_RenderGraphHandle input = mRenderTargetBeforeResolve;
+			const ER_RenderGraphHandle output = mRenderGraph->CreateTexture("Color Grading RT", effectRTDesc);
+			mRenderGraph->AddPass("EveryRay: Post Processing (Color Grading)", [this, quad, input, output](ER_RHI* rhi, const ER_RenderGraph& graph)
 			{
-				rhi->InitializePSO(mColorGradingPassPSOName);
-				rhi->SetShader(mColorGradingPS);
-				rhi->SetRenderTargetFormats({ mColorGradingRT });
-				rhi->SetBlendState(ER_NO_BLEND);
-				rhi->SetRasterizerState(ER_NO_CULLING);
-				rhi->SetRootSignatureToPSO(mColorGradingPassPSOName, mColorGradingRS);
-				rhi->SetTopologyTypeToPSO(mColorGradingPassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-				quad->PrepareDraw(rhi);
-				rhi->FinalizePSO(mColorGradingPassPSOName);
-			}
-			rhi->SetPSO(mColorGradingPassPSOName);
-			PrepareDrawingColorGrading(mRenderTargetBeforeResolve);
-			quad->Draw(rhi);
-			rhi->UnsetPSO();
+				ER_RHI_GPUTexture* outputRT = graph.GetTexture(output);
+
+				rhi->SetRenderTargets({ outputRT });
+				rhi->SetRootSignature(mColorGradingRS);
+				if (!rhi->IsPSOReady(mColorGradingPassPSOName))
+				{
+					rhi->InitializePSO(mColorGradingPassPSOName);
+					rhi->SetShader(mColorGradingPS);
+					rhi->SetRenderTargetFormats({ outputRT });
+					rhi->SetBlendState(ER_NO_BLEND);
+					rhi->SetRasterizerState(ER_NO_CULLING);
+					rhi->SetRootSignatureToPSO(mColorGradingPassPSOName, mColorGradingRS);
+					rhi->SetTopologyTypeToPSO(mColorGradingPassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+					quad->PrepareDraw(rhi);
+					rhi->FinalizePSO(mColorGradingPassPSOName);
+				}
+				rhi->SetPSO(mColorGradingPassPSOName);
+				PrepareDrawingColorGrading(graph.GetTexture(input));
+				quad->Draw(rhi);
+				rhi->UnsetPSO();
 
-			rhi->UnbindRenderTargets();
+				rhi->UnbindRenderTargets();
+			}).Read(input).Write(output);
 
 			//[WARNING] Set from last post processing effect
-			mRenderTargetBeforeResolve = mColorGradingRT;
-
-			rhi->EndEventTag();
+			mRenderTargetBeforeResolve = output;
 		}
 
 		// Vignette
 		if (mUseVignette)
 		{
-			rhi->BeginEventTag("EveryRay: Post Processing (Vignette)");
-
-			rhi->SetRenderTargets({ mVignetteRT });
-			rhi->SetRootSignature(mVignetteRS);
-			if (!rhi->IsPSOReady(mVignettePassPSOName))
+			const ER_RenderGraphHandle input = mRenderTargetBeforeResolve;
+			const ER_RenderGraphHandle output = mRenderGraph->CreateTexture("Vignette RT", effectRTDesc);
+			mRenderGraph->AddPass("EveryRay: Post Processing (Vignette)", [this, quad, input, output](ER_RHI* rhi, const ER_RenderGraph& graph)
 			{
-				rhi->InitializePSO(mVignettePassPSOName);
-				rhi->SetShader(mVignettePS);
-				rhi->SetBlendState(ER_NO_BLEND);
-				rhi->SetRasterizerState(ER_NO_CULLING);
-				rhi->SetRenderTargetFormats({ mVignetteRT });
-				rhi->SetRootSignatureToPSO(mVignettePassPSOName, mVignetteRS);
-				rhi->SetTopologyTypeToPSO(mVignettePassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-				quad->PrepareDraw(rhi);
-				rhi->FinalizePSO(mVignettePassPSOName);
-			}
-			rhi->SetPSO(mVignettePassPSOName);
-			PrepareDrawingVignette(mRenderTargetBeforeResolve);
-			quad->Draw(rhi);
-			rhi->UnsetPSO();
+				ER_RHI_GPUTexture* outputRT = graph.GetTexture(output);
+
+				rhi->SetRenderTargets({ outputRT });
+				rhi->SetRootSignature(mVignetteRS);
+				if (!rhi->IsPSOReady(mVignettePassPSOName))
+				{
+					rhi->InitializePSO(mVignettePassPSOName);
+					rhi->SetShader(mVignettePS);
+					rhi->SetBlendState(ER_NO_BLEND);
+					rhi->SetRasterizerState(ER_NO_CULLING);
+					rhi->SetRenderTargetFormats({ outputRT });
+					rhi->SetRootSignatureToPSO(mVignettePassPSOName, mVignetteRS);
+					rhi->SetTopologyTypeToPSO(mVignettePassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+					quad->PrepareDraw(rhi);
+					rhi->FinalizePSO(mVignettePassPSOName);
+				}
+				rhi->SetPSO(mVignettePassPSOName);
+				PrepareDrawingVignette(graph.GetTexture(input));
+				quad->Draw(rhi);
+				rhi->UnsetPSO();
 
-			rhi->UnbindRenderTargets();
+				rhi->UnbindRenderTargets();
+			}).Read(input).Write(output);
 
 			//[WARNING] Set from last post processing effect
-			mRenderTargetBeforeResolve = mVignetteRT;
-
-			rhi->EndEventTag();
+			mRenderTargetBeforeResolve = output;
 		}
 
 		// FXAA
 		if (mUseFXAA)
 		{
-			rhi->BeginEventTag("EveryRay: Post Processing (FXAA)");
-
-			rhi->SetRenderTargets({ mFXAART });
-			rhi->SetRootSignature(mFXAARS);
-			if (!rhi->IsPSOReady(mFXAAPassPSOName))
+			const ER_RenderGraphHandle input = mRenderTargetBeforeResolve;
+			const ER_RenderGraphHandle output = mRenderGraph->CreateTexture("FXAA RT", effectRTDesc);
+			mRenderGraph->AddPass("EveryRay: Post Processing (FXAA)", [this, quad, input, output](ER_RHI* rhi, const ER_RenderGraph& graph)
 			{
-				rhi->InitializePSO(mFXAAPassPSOName);
-				rhi->SetShader(mFXAAPS);
-				rhi->SetBlendState(ER_NO_BLEND);
-				rhi->SetRasterizerState(ER_NO_CULLING);
-				rhi->SetRenderTargetFormats({ mFXAART });
-				rhi->SetRootSignatureToPSO(mFXAAPassPSOName, mFXAARS);
-				rhi->SetTopologyTypeToPSO(mFXAAPassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-				quad->PrepareDraw(rhi);
-				rhi->FinalizePSO(mFXAAPassPSOName);
-			}
-			rhi->SetPSO(mFXAAPassPSOName);
-			PrepareDrawingFXAA(mRenderTargetBeforeResolve);
-			quad->Draw(rhi);
-			rhi->UnsetPSO();
+				ER_RHI_GPUTexture* outputRT = graph.GetTexture(output);
+
+				rhi->SetRenderTargets({ outputRT });
+				rhi->SetRootSignature(mFXAARS);
+				if (!rhi->IsPSOReady(mFXAAPassPSOName))
+				{
+					rhi->InitializePSO(mFXAAPassPSOName);
+					rhi->SetShader(mFXAAPS);
+					rhi->SetBlendState(ER_NO_BLEND);
+					rhi->SetRasterizerState(ER_NO_CULLING);
+					rhi->SetRenderTargetFormats({ outputRT });
+					rhi->SetRootSignatureToPSO(mFXAAPassPSOName, mFXAARS);
+					rhi->SetTopologyTypeToPSO(mFXAAPassPSOName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+					quad->PrepareDraw(rhi);
+					rhi->FinalizePSO(mFXAAPassPSOName);
+				}
+				rhi->SetPSO(mFXAAPassPSOName);
+				PrepareDrawingFXAA(graph.GetTexture(input));
+				quad->Draw(rhi);
+				rhi->UnsetPSO();
 
-			rhi->UnbindRenderTargets();
+				rhi->UnbindRenderTargets();
+			}).Read(input).Write(output);
 
 			//[WARNING] Set from last post processing effect 
-			mRenderTargetBeforeResolve = mFXAART;
-
-			rhi->EndEventTag();
+			mRenderTargetBeforeResolve = output;
 		}
 	}
 }
\ No newline at end of file
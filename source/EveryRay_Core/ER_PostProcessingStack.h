@@ -2,6 +2,7 @@
 #include "Common.h"
 #include "ER_Core.h"
 #include "ER_CoreTime.h"
+#include "ER_RenderGraph.h"
 
 namespace EveryRay_Core
 {
@@ -82,14 +83,12 @@ namespace EveryRay_Core
 		ER_Camera& camera;
 
 		// Tonemap
-		ER_RHI_GPUTexture* mTonemappingRT = nullptr;
 		ER_RHI_GPUShader* mTonemappingPS = nullptr;
 		bool mUseTonemap = true;
 		std::string mTonemapPassPSOName = "ER_RHI_GPUPipelineStateObject: Post Processing - Tonemap";
 		ER_RHI_GPURootSignature* mTonemapRS = nullptr;
 
 		// SSR
-		ER_RHI_GPUTexture* mSSRRT = nullptr;
 		ER_RHI_GPUConstantBuffer<PostEffectsCBuffers::SSRCB> mSSRConstantBuffer;
 		ER_RHI_GPUShader* mSSRPS = nullptr;
 		bool mUseSSR = false;
@@ -100,7 +99,6 @@ namespace EveryRay_Core
 		ER_RHI_GPURootSignature* mSSRRS = nullptr;
 
 		// SSS
-		ER_RHI_GPUTexture* mSSSRT = nullptr;
 		bool mUseSSS = true;
 		ER_RHI_GPUShader* mSSSPS = nullptr;
 		ER_RHI_GPUConstantBuffer<PostEffectsCBuffers::SSSCB> mSSSConstantBuffer;
@@ -108,7 +106,6 @@ namespace EveryRay_Core
 		ER_RHI_GPURootSignature* mSSSRS = nullptr;
 
 		// Linear Fog
-		ER_RHI_GPUTexture* mLinearFogRT = nullptr;
 		ER_RHI_GPUConstantBuffer<PostEffectsCBuffers::LinearFogCB> mLinearFogConstantBuffer;
 		ER_RHI_GPUShader* mLinearFogPS = nullptr;
 		bool mUseLinearFog = false;
@@ -119,10 +116,7 @@ namespace EveryRay_Core
 		std::string mLinearFogPassPSOName = "ER_RHI_GPUPipelineStateObject: Post Processing - Linear Fog";
 		ER_RHI_GPURootSignature* mLinearFogRS = nullptr;
 
-		ER_RHI_GPUTexture* mVolumetricFogRT = nullptr;
-
 		// LUT Color Grading
-		ER_RHI_GPUTexture* mColorGradingRT = nullptr;
 		ER_RHI_GPUTexture* mLUTs[3] = { nullptr, nullptr, nullptr };
 		ER_RHI_GPUShader* mColorGradingPS = nullptr;
 		int mColorGradingCurrentLUTIndex = 2;
@@ -131,7 +125,6 @@ namespace EveryRay_Core
 		ER_RHI_GPURootSignature* mColorGradingRS = nullptr;
 
 		// FXAA
-		ER_RHI_GPUTexture* mFXAART = nullptr;
 		ER_RHI_GPUConstantBuffer<PostEffectsCBuffers::FXAACB> mFXAAConstantBuffer;
 		ER_RHI_GPUShader* mFXAAPS = nullptr;
 		bool mUseFXAA = true;
@@ -139,7 +132,6 @@ namespace EveryRay_Core
 		ER_RHI_GPURootSignature* mFXAARS = nullptr;
 
 		// Vignette
-		ER_RHI_GPUTexture* mVignetteRT = nullptr;
 		ER_RHI_GPUConstantBuffer<PostEffectsCBuffers::VignetteCB> mVignetteConstantBuffer;
 		ER_RHI_GPUShader* mVignettePS = nullptr;
 		float mVignetteRadius = 0.75f;
@@ -152,8 +144,11 @@ namespace EveryRay_Core
 		std::string mFinalResolvePassPSOName = "ER_RHI_GPUPipelineStateObject: Post Processing - Final Resolve";
 		ER_RHI_GPURootSignature* mFinalResolveRS = nullptr;
 
+		// all the passes are recorded into the graph in DrawEffects() and executed in End(); RTs of the effects are transient textures of the graph
+		ER_RenderGraph* mRenderGraph = nullptr;
+		ER_RenderGraphHandle mRenderTargetBeforeResolve = ER_RENDER_GRAPH_INVALID_HANDLE;
+
 		// just pointers to RTs (not allocated in this system)
-		ER_RHI_GPUTexture* mRenderTargetBeforeResolve = nullptr;
 		ER_RHI_GPUTexture* mRenderTargetBeforePostProcessingPasses = nullptr;
 		ER_RHI_GPUTexture* mDepthTarget = nullptr;
 
@@ -0,0 +1,561 @@
+#include "stdafx.h"
+#include "ER_RenderGraph.h"
+#include "ER_Utility.h"
+
+#include <algorithm>
+
+namespace EveryRay_Core
+{
+	namespace
+	{
+		UINT GetBytesPerPixel(ER_RHI_FORMAT aFormat)
+		{
+			switch (aFormat)
+			{
+			case ER_FORMAT_R32G32B32A32_TYPELESS:
+			case ER_FORMAT_R32G32B32A32_FLOAT:
+			case ER_FORMAT_R32G32B32A32_UINT:
+				return 16;
+			case ER_FORMAT_R32G32B32_TYPELESS:
+			case ER_FORMAT_R32G32B32_FLOAT:
+			case ER_FORMAT_R32G32B32_UINT:
+				return 12;
+			case ER_FORMAT_R16G16B16A16_TYPELESS:
+			case ER_FORMAT_R16G16B16A16_FLOAT:
+			case ER_FORMAT_R16G16B16A16_UNORM:
+			case ER_FORMAT_R16G16B16A16_UINT:
+			case ER_FORMAT_R32G32_TYPELESS:
+			case ER_FORMAT_R32G32_FLOAT:
+			case ER_FORMAT_R32G32_UINT:
+				return 8;
+			case ER_FORMAT_R8G8_TYPELESS:
+			case ER_FORMAT_R8G8_UNORM:
+			case ER_FORMAT_R8G8_UINT:
+			case ER_FORMAT_D16_UNORM:
+			case ER_FORMAT_R16_TYPELESS:
+			case ER_FORMAT_R16_FLOAT:
+			case ER_FORMAT_R16_UNORM:
+			case ER_FORMAT_R16_UINT:
+				return 2;
+			case ER_FORMAT_R8_TYPELESS:
+			case ER_FORMAT_R8_UNORM:
+			case ER_FORMAT_R8_UINT:
+				return 1;
+			case ER_FORMAT_UNKNOWN:
+				return 0;
+			default:
+				return 4;
+			}
+		}
+
+		bool IsWriteState(ER_RHI_RESOURCE_STATE aState)
+		{
+			return aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_RENDER_TARGET ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_UNORDERED_ACCESS ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_DEPTH_WRITE ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_DEST;
+		}
+
+		bool IsReadState(ER_RHI_RESOURCE_STATE aState)
+		{
+			return aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COMPUTE_SHADER_RESOURCE ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_UNORDERED_ACCESS ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_DEPTH_READ ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_SOURCE ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_GENERIC_READ;
+		}
+
+		// bind flag that a texture needs to be used in the state
+		ER_RHI_BIND_FLAG GetRequiredBindFlag(ER_RHI_RESOURCE_STATE aState)
+		{
+			switch (aState)
+			{
+			case ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_RENDER_TARGET:
+				return ER_BIND_RENDER_TARGET;
+			case ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_UNORDERED_ACCESS:
+				return ER_BIND_UNORDERED_ACCESS;
+			case ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_DEPTH_WRITE:
+			case ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_DEPTH_READ:
+				return ER_BIND_DEPTH_STENCIL;
+			case ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE:
+			case ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE:
+			case ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COMPUTE_SHADER_RESOURCE:
+				return ER_BIND_SHADER_RESOURCE;
+			default:
+				return ER_BIND_NONE;
+			}
+		}
+	}
+
+	ER_RenderGraphPassBuilder& ER_RenderGraphPassBuilder::Read(ER_RenderGraphHandle aHandle, ER_RHI_RESOURCE_STATE aState)
+	{
+		mGraph.AddAccess(mPassIndex, aHandle, aState, false);
+		return *this;
+	}
+
+	ER_RenderGraphPassBuilder& ER_RenderGraphPassBuilder::Write(ER_RenderGraphHandle aHandle, ER_RHI_RESOURCE_STATE aState)
+	{
+		mGraph.AddAccess(mPassIndex, aHandle, aState, true);
+		return *this;
+	}
+
+	ER_RenderGraphPassBuilder& ER_RenderGraphPassBuilder::SetSideEffects()
+	{
+		mGraph.mPasses[mPassIndex].hasSideEffects = true;
+		return *this;
+	}
+
+	ER_RenderGraph::ER_RenderGraph(const std::string& aName)
+		: mName(aName)
+	{
+	}
+
+	ER_RenderGraph::~ER_RenderGraph()
+	{
+		for (auto& physicalTexture : mPhysicalTextures)
+			DeleteObject(physicalTexture.texture);
+		mPhysicalTextures.clear();
+	}
+
+	void ER_RenderGraph::Reset()
+	{
+		mPasses.clear();
+		mResources.clear();
+		mErrors.clear();
+		mStats = ER_RenderGraphStats();
+		mIsCompiled = false;
+	}
+
+	ER_RenderGraphHandle ER_RenderGraph::CreateTexture(const std::string& aName, const ER_RenderGraphTextureDesc& aDesc)
+	{
+		if (aDesc.width == 0 || aDesc.height == 0 || aDesc.mips == 0 || aDesc.format == ER_FORMAT_UNKNOWN)
+			AddError("Texture '" + aName + "' has an invalid description");
+
+		Resource resource;
+		resource.name = aName;
+		resource.desc = aDesc;
+		mResources.push_back(resource);
+		mIsCompiled = false;
+		return static_cast<ER_RenderGraphHandle>(mResources.size() - 1);
+	}
+
+	ER_RenderGraphHandle ER_RenderGraph::ImportTexture(const std::string& aName, ER_RHI_GPUTexture* aTexture)
+	{
+		if (!aTexture)
+			AddError("Imported texture '" + aName + "' is null");
+
+		Resource resource;
+		resource.name = aName;
+		resource.importedTexture = aTexture;
+		resource.isImported = true;
+		mResources.push_back(resource);
+		mIsCompiled = false;
+		return static_cast<ER_RenderGraphHandle>(mResources.size() - 1);
+	}
+
+	ER_RenderGraphPassBuilder ER_RenderGraph::AddPass(const std::string& aName, const ER_RenderGraphPassCallback& aCallback)
+	{
+		Pass pass;
+		pass.name = aName;
+		pass.callback = aCallback;
+		mPasses.push_back(pass);
+		mIsCompiled = false;
+		return ER_RenderGraphPassBuilder(*this, static_cast<int>(mPasses.size() - 1));
+	}
+
+	void ER_RenderGraph::AddAccess(int aPassIndex, ER_RenderGraphHandle aHandle, ER_RHI_RESOURCE_STATE aState, bool isWrite)
+	{
+		Pass& pass = mPasses[aPassIndex];
+		if (!IsValidHandle(aHandle))
+		{
+			AddError("Pass '" + pass.name + "' uses an unknown resource handle: " + std::to_string(aHandle));
+			return;
+		}
+
+		std::vector<Access>& accesses = isWrite ? pass.writes : pass.reads;
+		for (const Access& access : accesses)
+		{
+			if (access.handle != aHandle)
+				continue;
+			if (access.state != aState)
+				AddError("Pass '" + pass.name + "' uses resource '" + mResources[aHandle].name + "' in two different states");
+			return;
+		}
+
+		Access access;
+		access.handle = aHandle;
+		access.state = aState;
+		accesses.push_back(access);
+	}
+
+	void ER_RenderGraph::AddError(const std::string& aError)
+	{
+		mErrors.push_back("[ER Logger][ER_RenderGraph] " + mName + ": " + aError);
+	}
+
+	bool ER_RenderGraph::Compile()
+	{
+		mIsCompiled = false;
+
+		CullPasses();
+		if (!Validate()) // also fails on the errors of the declaration (i.e., unknown handles)
+			return false;
+
+		CalculateLifetimes();
+		ReleaseUnusedTextures();
+		AliasTransientTextures();
+		PrepareTransitions();
+		CalculateStats();
+
+		mIsCompiled = true;
+		return true;
+	}
+
+	// Reference counting from Frostbite's FrameGraph: passes that write nothing that is read later, imported or a side effect are removed (and so are their inputs, recursively)
+	void ER_RenderGraph::CullPasses()
+	{
+		for (Resource& resource : mResources)
+			resource.refCount = 0;
+
+		for (Pass& pass : mPasses)
+		{
+			pass.isCulled = false;
+			pass.refCount = static_cast<int>(pass.writes.size());
+			for (const Access& read : pass.reads)
+				mResources[read.handle].refCount++;
+		}
+
+		std::vector<ER_RenderGraphHandle> unreferencedResources;
+		auto cullPass = [&](Pass& pass)
+		{
+			pass.isCulled = true;
+			for (const Access& read : pass.reads)
+			{
+				Resource& resource = mResources[read.handle];
+				if (--resource.refCount == 0 && !resource.isImported)
+					unreferencedResources.push_back(read.handle);
+			}
+		};
+
+		for (int i = 0; i < static_cast<int>(mResources.size()); i++)
+		{
+			if (mResources[i].refCount == 0 && !mResources[i].isImported)
+				unreferencedResources.push_back(i);
+		}
+
+		for (Pass& pass : mPasses)
+		{
+			if (pass.refCount == 0 && !pass.hasSideEffects)
+				cullPass(pass);
+		}
+
+		while (!unreferencedResources.empty())
+		{
+			const ER_RenderGraphHandle handle = unreferencedResources.back();
+			unreferencedResources.pop_back();
+
+			for (Pass& pass : mPasses)
+			{
+				if (pass.isCulled)
+					continue;
+
+				for (const Access& write : pass.writes)
+				{
+					if (write.handle == handle && --pass.refCount == 0 && !pass.hasSideEffects)
+						cullPass(pass);
+				}
+			}
+		}
+	}
+
+	bool ER_RenderGraph::Validate()
+	{
+		std::vector<bool> isWritten(mResources.size(), false);
+		for (const Pass& pass : mPasses)
+		{
+			if (pass.isCulled)
+				continue;
+
+			auto validateAccess = [&](const Access& access, bool isWrite)
+			{
+				const Resource& resource = mResources[access.handle];
+				if (isWrite && !IsWriteState(access.state))
+					AddError("Pass '" + pass.name + "' writes to '" + resource.name + "' in a read-only state");
+				if (!isWrite && !IsReadState(access.state))
+					AddError("Pass '" + pass.name + "' reads '" + resource.name + "' in a write-only state");
+
+				// we do not know the bind flags of the imported textures
+				const ER_RHI_BIND_FLAG requiredFlag = GetRequiredBindFlag(access.state);
+				if (!resource.isImported && (resource.desc.bindFlags & requiredFlag) != requiredFlag)
+					AddError("Pass '" + pass.name + "' uses '" + resource.name + "' in a state that its bind flags do not allow");
+			};
+
+			for (const Access& read : pass.reads)
+			{
+				validateAccess(read, false);
+				if (!mResources[read.handle].isImported && !isWritten[read.handle])
+					AddError("Pass '" + pass.name + "' reads '" + mResources[read.handle].name + "' before anything has written to it");
+
+				for (const Access& write : pass.writes)
+				{
+					if (write.handle == read.handle && write.state != read.state)
+						AddError("Pass '" + pass.name + "' reads and writes '" + mResources[read.handle].name + "' in different states");
+				}
+			}
+
+			for (const Access& write : pass.writes)
+			{
+				validateAccess(write, true);
+				isWritten[write.handle] = true;
+			}
+		}
+
+		return mErrors.empty();
+	}
+
+	void ER_RenderGraph::CalculateLifetimes()
+	{
+		for (Resource& resource : mResources)
+		{
+			resource.firstPass = -1;
+			resource.lastPass = -1;
+			resource.physicalIndex = -1;
+		}
+
+		for (int passIndex = 0; passIndex < static_cast<int>(mPasses.size()); passIndex++)
+		{
+			const Pass& pass = mPasses[passIndex];
+			if (pass.isCulled)
+				continue;
+
+			auto extendLifetime = [&](const Access& access)
+			{
+				Resource& resource = mResources[access.handle];
+				if (resource.firstPass < 0)
+					resource.firstPass = passIndex;
+				resource.lastPass = passIndex;
+			};
+			for (const Access& read : pass.reads)
+				extendLifetime(read);
+			for (const Access& write : pass.writes)
+				extendLifetime(write);
+		}
+	}
+
+	// Greedy: every transient texture (in the order of the first use) takes the first pooled texture with the same description that is free by then.
+	// The same graph always gets the same physical textures, so the pool does not change between frames.
+	void ER_RenderGraph::AliasTransientTextures()
+	{
+		for (PhysicalTexture& physicalTexture : mPhysicalTextures)
+		{
+			physicalTexture.lastPass = -1;
+			physicalTexture.isUsed = false;
+		}
+
+		std::vector<ER_RenderGraphHandle> transientResources;
+		for (int i = 0; i < static_cast<int>(mResources.size()); i++)
+		{
+			if (!mResources[i].isImported && mResources[i].firstPass >= 0)
+				transientResources.push_back(i);
+		}
+		std::stable_sort(transientResources.begin(), transientResources.end(), [&](ER_RenderGraphHandle a, ER_RenderGraphHandle b)
+		{
+			return mResources[a].firstPass < mResources[b].firstPass;
+		});
+
+		for (ER_RenderGraphHandle handle : transientResources)
+		{
+			Resource& resource = mResources[handle];
+			for (int i = 0; i < static_cast<int>(mPhysicalTextures.size()); i++)
+			{
+				PhysicalTexture& physicalTexture = mPhysicalTextures[i];
+				if (physicalTexture.desc == resource.desc && (!physicalTexture.isUsed || physicalTexture.lastPass < resource.firstPass))
+				{
+					resource.physicalIndex = i;
+					break;
+				}
+			}
+
+			if (resource.physicalIndex < 0)
+			{
+				PhysicalTexture physicalTexture;
+				physicalTexture.desc = resource.desc;
+				mPhysicalTextures.push_back(physicalTexture);
+				resource.physicalIndex = static_cast<int>(mPhysicalTextures.size() - 1);
+			}
+
+			PhysicalTexture& physicalTexture = mPhysicalTextures[resource.physicalIndex];
+			physicalTexture.lastPass = resource.lastPass;
+			physicalTexture.lastUsedFrame = mFrameIndex;
+			physicalTexture.isUsed = true;
+		}
+	}
+
+	// Only the state changes inside the graph and the first use of every resource (its state before the graph is unknown here) need a transition.
+	// The RHI skips the first-use transitions if the texture is already in that state.
+	void ER_RenderGraph::PrepareTransitions()
+	{
+		const ER_RHI_RESOURCE_STATE unknownState = ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COMMON;
+		std::vector<ER_RHI_RESOURCE_STATE> states(mResources.size(), unknownState);
+		std::vector<bool> isUsed(mResources.size(), false);
+
+		for (Pass& pass : mPasses)
+		{
+			pass.transitions.clear();
+			if (pass.isCulled)
+				continue;
+
+			auto addTransition = [&](const Access& access)
+			{
+				if (isUsed[access.handle] && states[access.handle] == access.state)
+					return;
+				for (const Access& transition : pass.transitions)
+				{
+					if (transition.handle == access.handle) // read and written in the same state
+						return;
+				}
+				isUsed[access.handle] = true;
+				states[access.handle] = access.state;
+				pass.transitions.push_back(access);
+			};
+			for (const Access& read : pass.reads)
+				addTransition(read);
+			for (const Access& write : pass.writes)
+				addTransition(write);
+		}
+	}
+
+	void ER_RenderGraph::CalculateStats()
+	{
+		mStats = ER_RenderGraphStats();
+		mStats.passesCount = static_cast<UINT>(mPasses.size());
+
+		std::vector<UINT64> memoryPerPass(mPasses.size(), 0);
+		for (const Pass& pass : mPasses)
+		{
+			if (pass.isCulled)
+				mStats.culledPassesCount++;
+			mStats.transitionsCount += static_cast<UINT>(pass.transitions.size());
+		}
+
+		for (const Resource& resource : mResources)
+		{
+			if (resource.isImported || resource.firstPass < 0)
+				continue;
+
+			const UINT64 size = GetTextureSize(resource.desc);
+			mStats.transientTexturesCount++;
+			mStats.transientMemoryWithoutAliasing += size;
+			for (int i = resource.firstPass; i <= resource.lastPass; i++)
+				memoryPerPass[i] += size;
+		}
+
+		for (UINT64 memory : memoryPerPass)
+			mStats.transientMemoryPeak = std::max(mStats.transientMemoryPeak, memory);
+
+		for (const PhysicalTexture& physicalTexture : mPhysicalTextures)
+		{
+			if (!physicalTexture.isUsed)
+				continue;
+			mStats.physicalTexturesCount++;
+			mStats.transientMemoryPooled += GetTextureSize(physicalTexture.desc);
+		}
+	}
+
+	// Textures can still be used by the frames in flight, so we wait for many frames before releasing them (i.e., after a resize)
+	void ER_RenderGraph::ReleaseUnusedTextures()
+	{
+		for (int i = static_cast<int>(mPhysicalTextures.size()) - 1; i >= 0; i--)
+		{
+			if (mFrameIndex - mPhysicalTextures[i].lastUsedFrame > ER_RENDER_GRAPH_UNUSED_TEXTURE_FRAMES)
+			{
+				DeleteObject(mPhysicalTextures[i].texture);
+				mPhysicalTextures.erase(mPhysicalTextures.begin() + i);
+			}
+		}
+	}
+
+	void ER_RenderGraph::Execute(ER_RHI* aRHI)
+	{
+		assert(aRHI);
+		if (!mIsCompiled)
+		{
+			ER_OUTPUT_LOG(ER_Utility::ToWideString("[ER Logger][ER_RenderGraph] " + mName + ": trying to execute a graph that is not compiled, skipping...\n").c_str());
+			return;
+		}
+
+		for (int i = 0; i < static_cast<int>(mPhysicalTextures.size()); i++)
+		{
+			PhysicalTexture& physicalTexture = mPhysicalTextures[i];
+			if (!physicalTexture.isUsed || physicalTexture.texture)
+				continue;
+
+			physicalTexture.texture = aRHI->CreateGPUTexture(ER_Utility::ToWideString("ER_RHI_GPUTexture: " + mName + " - Render Graph Texture " + std::to_string(i)));
+			physicalTexture.texture->CreateGPUTextureResource(aRHI, physicalTexture.desc.width, physicalTexture.desc.height, 1u,
+				physicalTexture.desc.format, physicalTexture.desc.bindFlags, static_cast<int>(physicalTexture.desc.mips));
+		}
+
+		mIsExecuting = true;
+		std::vector<ER_RHI_GPUResource*> transitionResources;
+		std::vector<ER_RHI_RESOURCE_STATE> transitionStates;
+		for (const Pass& pass : mPasses)
+		{
+			if (pass.isCulled)
+				continue;
+
+			aRHI->BeginEventTag(pass.name);
+
+			transitionResources.clear();
+			transitionStates.clear();
+			for (const Access& transition : pass.transitions)
+			{
+				transitionResources.push_back(GetTexture(transition.handle));
+				transitionStates.push_back(transition.state);
+			}
+			if (!transitionResources.empty())
+				aRHI->TransitionResources(transitionResources, transitionStates);
+
+			if (pass.callback)
+				pass.callback(aRHI, *this);
+
+			aRHI->EndEventTag();
+		}
+		mIsExecuting = false;
+
+		mFrameIndex++;
+	}
+
+	ER_RHI_GPUTexture* ER_RenderGraph::GetTexture(ER_RenderGraphHandle aHandle) const
+	{
+		assert(mIsExecuting);
+		if (!IsValidHandle(aHandle))
+			return nullptr;
+
+		const Resource& resource = mResources[aHandle];
+		if (resource.isImported)
+			return resource.importedTexture;
+		return resource.physicalIndex >= 0 ? mPhysicalTextures[resource.physicalIndex].texture : nullptr;
+	}
+
+	bool ER_RenderGraph::IsPassCulled(int aPassIndex) const
+	{
+		assert(aPassIndex >= 0 && aPassIndex < static_cast<int>(mPasses.size()));
+		return mPasses[aPassIndex].isCulled;
+	}
+
+	UINT64 ER_RenderGraph::GetTextureSize(const ER_RenderGraphTextureDesc& aDesc)
+	{
+		UINT64 size = 0;
+		UINT width = aDesc.width;
+		UINT height = aDesc.height;
+		for (UINT mip = 0; mip < aDesc.mips; mip++)
+		{
+			size += static_cast<UINT64>(width) * static_cast<UINT64>(height) * GetBytesPerPixel(aDesc.format);
+			width = std::max(1u, width / 2);
+			height = std::max(1u, height / 2);
+		}
+		return size;
+	}
+}
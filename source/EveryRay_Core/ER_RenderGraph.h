@@ -0,0 +1,155 @@
+// Render graph in EveryRay Rendering Engine ("FrameGraph: Extensible Rendering Architecture in Frostbite", Y. O'Donnell)
+// Rebuilt every frame: Reset() -> CreateTexture()/ImportTexture() + AddPass() -> Compile() -> Execute()
+// - passes declare what they read and write (and in which ER_RHI_RESOURCE_STATE), the graph batches the transitions of every pass into one TransitionResources() call
+// - passes that do not contribute to an imported texture or a side effect (i.e., writing to the main RT) are culled
+// - transient textures only live between their first and last pass and share physical textures with the same description when the lifetimes do not overlap.
+//   Our RHI has no placed resources, so this is done with a pool of textures (kept between frames); the peak memory of the ideal (placed) aliasing is reported as well.
+// - Compile() never touches the RHI (no transitions or texture creation until Execute())
+#pragma once
+#include "Common.h"
+#include "RHI/ER_RHI.h"
+
+#include <functional>
+
+#define ER_RENDER_GRAPH_INVALID_HANDLE -1
+#define ER_RENDER_GRAPH_UNUSED_TEXTURE_FRAMES 60 // pooled textures that were not used for that many frames are released
+
+namespace EveryRay_Core
+{
+	class ER_RenderGraph;
+
+	typedef int ER_RenderGraphHandle;
+	typedef std::function<void(ER_RHI* aRHI, const ER_RenderGraph& aGraph)> ER_RenderGraphPassCallback;
+
+	struct ER_RenderGraphTextureDesc
+	{
+		UINT width = 0;
+		UINT height = 0;
+		ER_RHI_FORMAT format = ER_FORMAT_UNKNOWN;
+		ER_RHI_BIND_FLAG bindFlags = ER_BIND_NONE;
+		UINT mips = 1;
+
+		bool operator==(const ER_RenderGraphTextureDesc& rhs) const
+		{
+			return width == rhs.width && height == rhs.height && format == rhs.format && bindFlags == rhs.bindFlags && mips == rhs.mips;
+		}
+	};
+
+	struct ER_RenderGraphStats
+	{
+		UINT passesCount = 0;
+		UINT culledPassesCount = 0;
+		UINT transitionsCount = 0;
+		UINT transientTexturesCount = 0;
+		UINT physicalTexturesCount = 0; // used by this frame
+		UINT64 transientMemoryWithoutAliasing = 0; // in bytes: every transient texture has its own allocation
+		UINT64 transientMemoryPooled = 0; // what is actually allocated (pooled textures used by this frame)
+		UINT64 transientMemoryPeak = 0; // the highest sum of the textures alive during one pass (ideal placed aliasing)
+	};
+
+	// Returned by ER_RenderGraph::AddPass() to declare the resources of the pass
+	class ER_RenderGraphPassBuilder
+	{
+	public:
+		ER_RenderGraphPassBuilder(ER_RenderGraph& aGraph, int aPassIndex) : mGraph(aGraph), mPassIndex(aPassIndex) {}
+
+		ER_RenderGraphPassBuilder& Read(ER_RenderGraphHandle aHandle, ER_RHI_RESOURCE_STATE aState = ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		ER_RenderGraphPassBuilder& Write(ER_RenderGraphHandle aHandle, ER_RHI_RESOURCE_STATE aState = ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_RENDER_TARGET);
+		ER_RenderGraphPassBuilder& SetSideEffects(); // never culled
+	private:
+		ER_RenderGraph& mGraph;
+		int mPassIndex;
+	};
+
+	class ER_RenderGraph
+	{
+		friend class ER_RenderGraphPassBuilder;
+	public:
+		ER_RenderGraph(const std::string& aName);
+		~ER_RenderGraph();
+
+		void Reset();
+
+		ER_RenderGraphHandle CreateTexture(const std::string& aName, const ER_RenderGraphTextureDesc& aDesc);
+		// External texture (not owned by the graph): its content is expected to be used after the graph, so its writers are never culled
+		ER_RenderGraphHandle ImportTexture(const std::string& aName, ER_RHI_GPUTexture* aTexture);
+
+		ER_RenderGraphPassBuilder AddPass(const std::string& aName, const ER_RenderGraphPassCallback& aCallback);
+
+		// Culls, validates, calculates the lifetimes, aliases the transient textures and prepares the transitions. Does not need the RHI.
+		// Returns false if the graph is invalid (see GetErrors()).
+		bool Compile();
+		void Execute(ER_RHI* aRHI);
+
+		// Only valid in the callbacks of Execute()
+		ER_RHI_GPUTexture* GetTexture(ER_RenderGraphHandle aHandle) const;
+
+		const std::vector<std::string>& GetErrors() const { return mErrors; }
+		const ER_RenderGraphStats& GetStats() const { return mStats; }
+		bool IsPassCulled(int aPassIndex) const;
+		bool IsCompiled() const { return mIsCompiled; }
+
+		static UINT64 GetTextureSize(const ER_RenderGraphTextureDesc& aDesc);
+	private:
+		struct Access
+		{
+			ER_RenderGraphHandle handle;
+			ER_RHI_RESOURCE_STATE state;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			ER_RenderGraphPassCallback callback;
+			std::vector<Access> reads;
+			std::vector<Access> writes;
+			std::vector<Access> transitions; // filled in Compile()
+			bool hasSideEffects = false;
+			bool isCulled = false;
+			int refCount = 0;
+		};
+
+		struct Resource
+		{
+			std::string name;
+			ER_RenderGraphTextureDesc desc;
+			ER_RHI_GPUTexture* importedTexture = nullptr;
+			bool isImported = false;
+			int refCount = 0;
+			int firstPass = -1; // lifetime (alive passes only)
+			int lastPass = -1;
+			int physicalIndex = -1; // in mPhysicalTextures (transient only)
+		};
+
+		struct PhysicalTexture
+		{
+			ER_RenderGraphTextureDesc desc;
+			ER_RHI_GPUTexture* texture = nullptr; // created in Execute()
+			int lastPass = -1; // last pass of the resource that currently occupies it (only during Compile())
+			UINT64 lastUsedFrame = 0;
+			bool isUsed = false; // by the current frame
+		};
+
+		bool IsValidHandle(ER_RenderGraphHandle aHandle) const { return aHandle >= 0 && aHandle < static_cast<int>(mResources.size()); }
+		void AddAccess(int aPassIndex, ER_RenderGraphHandle aHandle, ER_RHI_RESOURCE_STATE aState, bool isWrite);
+		void AddError(const std::string& aError);
+
+		void CullPasses();
+		bool Validate();
+		void CalculateLifetimes();
+		void AliasTransientTextures();
+		void PrepareTransitions();
+		void CalculateStats();
+		void ReleaseUnusedTextures();
+
+		std::string mName;
+		std::vector<Pass> mPasses;
+		std::vector<Resource> mResources;
+		std::vector<PhysicalTexture> mPhysicalTextures; // persistent between frames
+		std::vector<std::string> mErrors;
+		ER_RenderGraphStats mStats;
+		UINT64 mFrameIndex = 0;
+		bool mIsCompiled = false;
+		bool mIsExecuting = false;
+	};
+}
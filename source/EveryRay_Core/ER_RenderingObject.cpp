@@ -17,6 +17,8 @@
 #include "ER_Terrain.h"
 #include "ER_Settings.h"
 #include "ER_Scene.h"
+#include "ER_TextureStreamer.h"
+#include "ER_CPUOcclusionCuller.h"
 
 namespace EveryRay_Core
 {
@@ -108,6 +110,7 @@ namespace EveryRay_Core
 		for (auto& meshesInstanceBuffersLOD : mMeshesInstanceBuffers)
 			DeletePointerCollection(meshesInstanceBuffersLOD);
 		mMeshesInstanceBuffers.clear();
+		DeletePointerCollection(mMeshesMainViewInstanceBuffers);
 
 		mMeshesTextureBuffers.clear();
 
@@ -290,10 +293,21 @@ namespace EveryRay_Core
 
 	// This is main method for loading textures before going to RHI
 	// It supports quality levels, format check and different types of textures
+	// Textures are streamed in: we get a placeholder right away and the real texture (with mips) is assigned once it has been uploaded
 	void ER_RenderingObject::LoadTexture(ER_RHI_GPUTexture** aTexture, bool* loadStat, const std::wstring& path, int meshIndex, bool isPlaceholder)
 	{
 		assert(loadStat);
-		ER_RHI* rhi = mCore->GetRHI();
+		ER_TextureStreamer* textureStreamer = mCore->GetServices().FindService<ER_TextureStreamer>();
+		assert(textureStreamer);
+
+		// placeholders (empty maps) are tiny and shared by many meshes: they have no quality levels and are loaded once synchronously,
+		// so they are never streamed and the streamer does not track their residency
+		if (isPlaceholder)
+		{
+			*aTexture = textureStreamer->AddOrGetTexture(path, nullptr, false, false, loadStat);
+			assert(*aTexture);
+			return;
+		}
 
 		const int extensionSymbolCount = 4; // .png, .dds, etc.
 		const int texQualityCount = RenderingObjectTextureQuality::OBJECT_TEXTURE_COUNT;
@@ -322,12 +336,15 @@ namespace EveryRay_Core
 		bool tgaLoader = (path.substr(path.length() - extensionSymbolCount) == std::wstring(postfixTGA)) || (path.substr(path.length() - extensionSymbolCount) == std::wstring(postfixTGA_Capital));
 		std::string errorMessage = mModel->GetFileName() + " of mesh index: " + std::to_string(meshIndex);
 
+		// called on the main thread once the texture has been uploaded (the scene is destroyed only after the streamer drops pending requests)
+		auto onTextureReady = [aTexture](ER_RHI_GPUTexture* aReadyTexture) { *aTexture = aReadyTexture; };
+
 		{
 			bool didExist = false;
 			//we start traversing through different texture quality levels unless we hit the first one
 			for (int i = static_cast<int>(mCurrentTextureQuality); i >= 0; i--)
 			{
-				*aTexture = mCore->AddOrGetGPUTextureFromCache(possiblePaths[i], &didExist, false, true, loadStat, true);
+				*aTexture = textureStreamer->RequestTexture(possiblePaths[i], onTextureReady, &didExist, loadStat, true);
 				if (didExist)
 					break;
 
@@ -337,27 +354,12 @@ namespace EveryRay_Core
 						break;
 
 					if (!*loadStat && i <= 0) // after we traversed all possible levels, lets load the original path (maybe the texture does not have postfix)
-						*aTexture = mCore->AddOrGetGPUTextureFromCache(path, &didExist);
+						*aTexture = textureStreamer->RequestTexture(path, onTextureReady, &didExist);
 				}
 
 			}
 			assert(*aTexture);
-
-			if (!isPlaceholder/* && !didExist*/)
-			{
-				rhi->GenerateMipsWithTextureReplacement(aTexture,
-					[this, aTexture](ER_RHI_GPUTexture** aNewTextureWithMips)
-					{
-						assert(*aNewTextureWithMips);
-						assert(!(*aNewTextureWithMips)->debugName.empty());
-
-						if (!mCore->IsGPUTextureInCache((*aNewTextureWithMips)->debugName))
-							mCore->AddGPUTextureToCache((*aNewTextureWithMips)->debugName, *aNewTextureWithMips);
-
-						*aTexture = mCore->AddOrGetGPUTextureFromCache((*aNewTextureWithMips)->debugName);
-					}
-				);
-			}
+			// mips are generated on the streamer's workers, so we do not need GenerateMipsWithTextureReplacement() for these textures anymore
 		};
 	}
 
@@ -404,20 +406,28 @@ namespace EveryRay_Core
 		}
 	}
 	
-	void ER_RenderingObject::Draw(const std::string& materialName, bool toDepth, int meshIndex) {
+	void ER_RenderingObject::Draw(const std::string& materialName, bool toDepth, int meshIndex, bool isMainView) {
 		
 		// for instanced objects we run DrawLOD() for all available LODs (some instances might end up in one LOD, others in other LODs)
 		if (mIsInstanced)
 		{
+			// object constants do not depend on the LOD: the buffer that is already bound is kept for all of them
+			const bool isObjectConstantBufferPrepared = mIsObjectConstantBufferPrepared;
 			for (int lod = 0; lod < GetLODCount(); lod++)
-				DrawLOD(materialName, toDepth, meshIndex, lod);
+			{
+				mIsObjectConstantBufferPrepared = isObjectConstantBufferPrepared;
+				DrawLOD(materialName, toDepth, meshIndex, lod, false, nullptr, 0, isMainView);
+			}
 		}
 		else
-			DrawLOD(materialName, toDepth, meshIndex, mCurrentLODIndex);
+			DrawLOD(materialName, toDepth, meshIndex, mCurrentLODIndex, false, nullptr, 0, isMainView);
 	}
 
-	void ER_RenderingObject::DrawLOD(const std::string& materialName, bool toDepth, int meshIndex, int lod, bool skipCulling)
+	void ER_RenderingObject::DrawLOD(const std::string& materialName, bool toDepth, int meshIndex, int lod, bool skipCulling, ER_RHI_GPUBuffer* aInstanceBuffer, UINT aInstanceCount, bool isMainView)
 	{
+		const bool isObjectConstantBufferPrepared = mIsObjectConstantBufferPrepared;
+		mIsObjectConstantBufferPrepared = false;
+
 		if (ER_Utility::StopDrawingRenderingObjects)
 			return;
 
@@ -428,21 +438,21 @@ namespace EveryRay_Core
 		if (mMaterials.find(materialName) == mMaterials.end() && !isForwardPass)
 			return;
 		
-		if (mIsRendered && (skipCulling || !mIsCulled) && mCurrentLODIndex != -1)
+		// occlusion culling is done from the main camera, so other views (shadows, voxelization) only use frustum culling results
+		const bool isCulled = mIsCulled || (isMainView && mIsOccluded);
+		if (mIsRendered && (skipCulling || !isCulled) && mCurrentLODIndex != -1)
 		{
+			const bool isMainViewInstanceBuffer = isMainView && mIsUsingMainViewInstanceBuffers && lod == 0 && !aInstanceBuffer;
+
 			if (!isForwardPass && (!mMaterials.size() || mMeshRenderBuffers[lod].size() == 0))
 				return;
 			
 			{
-				mObjectConstantBuffer.Data.World = XMMatrixTranspose(mTransformationMatrix);
-				mObjectConstantBuffer.Data.IndexOfRefraction = mIOR;
-				mObjectConstantBuffer.Data.CustomRoughness = mCustomRoughness;
-				mObjectConstantBuffer.Data.CustomMetalness = mCustomMetalness;
-				mObjectConstantBuffer.Data.CustomAlphaDiscard = mCustomAlphaDiscard;
-				mObjectConstantBuffer.Data.OriginalInstanceCount = mInstanceCount;
-				mObjectConstantBuffer.Data.RenderingObjectFlags = mObjectShaderBitmaskFlags;
-				mObjectConstantBuffer.ApplyChanges(rhi);
+				// updating an already bound buffer would not be seen by this draw (see PrepareObjectConstantBuffer())
+				if (!isObjectConstantBufferPrepared)
+					UpdateObjectConstantBuffer();
 
+				// only bound where root constants aren't supported (DX11), which updates the buffer in place
 				mObjectFakeRootConstantBuffer.Data.CurrentLOD = lod;
 				mObjectFakeRootConstantBuffer.ApplyChanges(rhi);
 			}
@@ -461,8 +471,10 @@ namespace EveryRay_Core
 						//WARNING: Make sure the system actually sets that buffer!
 						rhi->SetVertexBuffers({ mMeshRenderBuffers[lod][meshI]->VertexBuffer });
 					}
+					else if (isMainViewInstanceBuffer)
+						rhi->SetVertexBuffers({ mMeshRenderBuffers[lod][meshI]->VertexBuffer, mMeshesMainViewInstanceBuffers[meshI]->InstanceBuffer });
 					else
-						rhi->SetVertexBuffers({ mMeshRenderBuffers[lod][meshI]->VertexBuffer, mMeshesInstanceBuffers[lod][meshI]->InstanceBuffer });
+						rhi->SetVertexBuffers({ mMeshRenderBuffers[lod][meshI]->VertexBuffer, aInstanceBuffer ? aInstanceBuffer : mMeshesInstanceBuffers[lod][meshI]->InstanceBuffer });
 				}
 				else
 					rhi->SetVertexBuffers({ mMeshRenderBuffers[lod][meshI]->VertexBuffer });
@@ -471,9 +483,7 @@ namespace EveryRay_Core
 				// run prepare callbacks for standard materials (specials, i.e., shadow mapping, are processed in their own systems)
 				if (!isForwardPass && mMaterials[materialName]->IsStandard())
 				{
-					auto prepareMaterialBeforeRendering = MeshMaterialVariablesUpdateEvent->GetListener(materialName);
-					if (prepareMaterialBeforeRendering)
-						prepareMaterialBeforeRendering(meshI, lod);
+					MeshMaterialVariablesUpdateEvent->NotifyChecked(materialName, meshI, lod);
 				}
 				else if (isForwardPass && mCore->GetLevel()->mIllumination)
 					mCore->GetLevel()->mIllumination->PrepareResourcesForForwardLighting(this, meshI, lod);
@@ -490,8 +500,9 @@ namespace EveryRay_Core
 					}
 					else
 					{
-						if (mInstanceCountToRender[lod] > 0)
-							rhi->DrawIndexedInstanced(mMeshRenderBuffers[lod][meshI]->IndicesCount, mInstanceCountToRender[lod], 0, 0, 0);
+						const UINT instanceCount = aInstanceBuffer ? aInstanceCount : (isMainViewInstanceBuffer ? mInstanceCountToRenderMainView : mInstanceCountToRender[lod]);
+						if (instanceCount > 0)
+							rhi->DrawIndexedInstanced(mMeshRenderBuffers[lod][meshI]->IndicesCount, instanceCount, 0, 0, 0);
 						else
 							continue;
 					}
@@ -502,6 +513,24 @@ namespace EveryRay_Core
 		}
 	}
 
+	void ER_RenderingObject::PrepareObjectConstantBuffer()
+	{
+		UpdateObjectConstantBuffer();
+		mIsObjectConstantBufferPrepared = true;
+	}
+
+	void ER_RenderingObject::UpdateObjectConstantBuffer()
+	{
+		mObjectConstantBuffer.Data.World = XMMatrixTranspose(mTransformationMatrix);
+		mObjectConstantBuffer.Data.IndexOfRefraction = mIOR;
+		mObjectConstantBuffer.Data.CustomRoughness = mCustomRoughness;
+		mObjectConstantBuffer.Data.CustomMetalness = mCustomMetalness;
+		mObjectConstantBuffer.Data.CustomAlphaDiscard = mCustomAlphaDiscard;
+		mObjectConstantBuffer.Data.OriginalInstanceCount = mInstanceCount;
+		mObjectConstantBuffer.Data.RenderingObjectFlags = mObjectShaderBitmaskFlags;
+		mObjectConstantBuffer.ApplyChanges(mCore->GetRHI());
+	}
+
 	void ER_RenderingObject::DrawAABB(ER_RHI_GPUTexture* aRenderTarget, ER_RHI_GPUTexture* aDepth, ER_RHI_GPURootSignature* rs)
 	{
 		if (mIsSelected && mIsAvailableInEditorMode && mIsAABBDebugEnabled && ER_Utility::IsEditorMode)
@@ -596,6 +625,27 @@ namespace EveryRay_Core
 		}
 	}
 
+	// Instances that passed both frustum and occlusion culling (LOD 0 only: CPU-culled objects with LODs are rebalanced in UpdateLODs())
+	void ER_RenderingObject::UpdateMainViewInstanceBuffer(std::vector<InstancedData>& instanceData)
+	{
+		auto rhi = mCore->GetRHI();
+
+		if (mMeshesMainViewInstanceBuffers.empty())
+		{
+			for (size_t i = 0; i < mMeshesCount[0]; i++)
+			{
+				mMeshesMainViewInstanceBuffers.push_back(new InstanceBufferData());
+				mMeshesMainViewInstanceBuffers[i]->InstanceBuffer = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: ER_RenderingObject - Main View Instance Buffer: " + mName + ", mesh: " + std::to_string(i));
+				CreateInstanceBuffer(&mInstanceData[0][0], MAX_INSTANCE_COUNT, mMeshesMainViewInstanceBuffers[i]->InstanceBuffer);
+				mMeshesMainViewInstanceBuffers[i]->Stride = sizeof(InstancedData);
+			}
+		}
+
+		mInstanceCountToRenderMainView = static_cast<UINT>(instanceData.size());
+		for (size_t i = 0; i < mMeshesCount[0]; i++)
+			rhi->UpdateBuffer(mMeshesMainViewInstanceBuffers[i]->InstanceBuffer, mInstanceCountToRenderMainView == 0 ? nullptr : &instanceData[0], InstanceSize() * mInstanceCountToRenderMainView);
+	}
+
 	UINT ER_RenderingObject::InstanceSize() const
 	{
 		return sizeof(InstancedData);
@@ -603,35 +653,39 @@ namespace EveryRay_Core
 
 	// This method culls the object (or its instances) on CPU 
 	// Note: for instanced objects consider using indirect rendering instead (culling will happen on GPU and not in this method)
-	void ER_RenderingObject::PerformCPUFrustumCull(ER_Camera* camera)
+	// Runs on the worker thread of ER_FramePipeline: results are written to 'aState'
+	void ER_RenderingObject::PerformCPUCull(const ER_RenderingObjectSimulationCamera& aCamera, const ER_CPUOcclusionCuller* aOcclusionCuller, ER_RenderingObjectSimulatedState& aState) const
 	{
 		assert(!mIsIndirectlyRendered);
 
-		auto frustum = camera->GetFrustum();
-		auto cullFunction = [&frustum](ER_AABB& aabb) {
+		const XMFLOAT4* planes = aCamera.frustumPlanes;
+		auto frustumCullFunction = [planes, &aCamera](const ER_AABB& aabb) {
+			if (!aCamera.isFrustumCulling)
+				return false;
+
 			bool culled = false;
 			// start a loop through all frustum planes
 			for (int planeID = 0; planeID < 6; ++planeID)
 			{
-				XMVECTOR planeNormal = XMVectorSet(frustum.Planes()[planeID].x, frustum.Planes()[planeID].y, frustum.Planes()[planeID].z, 0.0f);
-				float planeConstant = frustum.Planes()[planeID].w;
+				XMVECTOR planeNormal = XMVectorSet(planes[planeID].x, planes[planeID].y, planes[planeID].z, 0.0f);
+				float planeConstant = planes[planeID].w;
 
 				XMFLOAT3 axisVert;
 
 				// x-axis
-				if (frustum.Planes()[planeID].x > 0.0f)
+				if (planes[planeID].x > 0.0f)
 					axisVert.x = aabb.first.x;
 				else
 					axisVert.x = aabb.second.x;
 
 				// y-axis
-				if (frustum.Planes()[planeID].y > 0.0f)
+				if (planes[planeID].y > 0.0f)
 					axisVert.y = aabb.first.y;
 				else
 					axisVert.y = aabb.second.y;
 
 				// z-axis
-				if (frustum.Planes()[planeID].z > 0.0f)
+				if (planes[planeID].z > 0.0f)
 					axisVert.z = aabb.first.z;
 				else
 					axisVert.z = aabb.second.z;
@@ -646,33 +700,48 @@ namespace EveryRay_Core
 			}
 			return culled;
 		};
+		// occlusion is only tested for the boxes inside of the frustum
+		// its results are kept apart from frustum culling ones: occluders hide objects from the main camera only, not from the lights (shadows) or voxel cascades
+		auto occlusionCullFunction = [aOcclusionCuller, &aState](const ER_AABB& aabb) {
+			if (aOcclusionCuller && aOcclusionCuller->IsOccluded(aabb))
+			{
+				aState.occludedCount++;
+				return true;
+			}
+			return false;
+		};
 
-		assert(mInstanceCullingFlags.size() == mInstanceCount);
+		assert(aState.instanceCullingFlags.size() == mInstanceCount);
 
 		if (mIsInstanced)
 		{
-			XMMATRIX instanceWorldMatrix = XMMatrixIdentity();
 			const int currentLOD = 0; // no need to iterate through LODs (AABBs are shared between LODs, so culling results will be identical)
 
-			mTempPostCullingInstanceData.clear();
+			aState.postCullingInstanceData.clear();
+			aState.postOcclusionInstanceData.clear();
+			for (int instanceIndex = 0; instanceIndex < static_cast<int>(mInstanceCount); instanceIndex++)
 			{
-				std::vector<InstancedData> newInstanceData;
-				for (int instanceIndex = 0; instanceIndex < static_cast<int>(mInstanceCount); instanceIndex++)
+				aState.instanceCullingFlags[instanceIndex] = frustumCullFunction(aState.instanceAABBs[instanceIndex]);
+				if (!aState.instanceCullingFlags[instanceIndex])
 				{
-					instanceWorldMatrix = XMLoadFloat4x4(&(mInstanceData[currentLOD][instanceIndex].World));
-					mInstanceCullingFlags[instanceIndex] = cullFunction(mInstanceAABBs[instanceIndex]);
-					if (!mInstanceCullingFlags[instanceIndex])
-						newInstanceData.push_back(instanceWorldMatrix);
+					aState.postCullingInstanceData.push_back(mInstanceData[currentLOD][instanceIndex]);
+					if (!occlusionCullFunction(aState.instanceAABBs[instanceIndex]))
+						aState.postOcclusionInstanceData.push_back(mInstanceData[currentLOD][instanceIndex]);
 				}
-				mTempPostCullingInstanceData = newInstanceData; //we store a copy for future usages
+			}
 
-				// if we have lods, we will update instance buffers later in UpdateLODs()
-				if (GetLODCount() <= 1)
-					UpdateInstanceBuffer(mTempPostCullingInstanceData, 0);
+			// if we have lods, we will update instance buffers later in UpdateLODs()
+			if (GetLODCount() <= 1)
+			{
+				aState.isUploadingPostCullingInstanceData = true;
+				aState.isUploadingPostOcclusionInstanceData = (aOcclusionCuller != nullptr);
 			}
 		}
 		else
-			mIsCulled = cullFunction(mGlobalAABB);
+		{
+			aState.isCulled = frustumCullFunction(aState.globalAABB);
+			aState.isOccluded = !aState.isCulled && occlusionCullFunction(aState.globalAABB);
+		}
 	}
 
 	void ER_RenderingObject::StoreInstanceDataAfterTerrainPlacement()
@@ -732,7 +801,7 @@ namespace EveryRay_Core
 			
 #ifndef ER_PLATFORM_WIN64_DX11
 				std::string eventName = "On-terrain placement callback - initialization of ER_RenderingObject: " + mName;
-				terrain->ReadbackPlacedPositionsOnInitEvent->AddListener(eventName, [&](ER_Terrain* aTerrain)
+				terrain->ReadbackPlacedPositionsOnInitEvent->Subscribe(eventName, [&](ER_Terrain* aTerrain)
 					{
 						assert(aTerrain);
 						XMFLOAT4 currentPos;
@@ -777,7 +846,7 @@ namespace EveryRay_Core
 				
 #ifndef ER_PLATFORM_WIN64_DX11
 				std::string eventName = "On-terrain placement callback - initialization of ER_RenderingObject: " + mName;
-				terrain->ReadbackPlacedPositionsOnInitEvent->AddListener(eventName, [&](ER_Terrain* aTerrain)
+				terrain->ReadbackPlacedPositionsOnInitEvent->Subscribe(eventName, [&](ER_Terrain* aTerrain)
 					{
 						assert(aTerrain);
 						aTerrain->ReadbackPlacedPositions(mOutputPositionsOnTerrainBuffer, mInputPositionsOnTerrainBuffer, mTempInstancesPositions, mInstanceCount);
@@ -795,12 +864,12 @@ namespace EveryRay_Core
 		}
 		mIsTerrainPlacementFinished = true;
 	}
+	// Main thread part of the update (editor, GPU resources, texture streaming). AABBs, culling and LODs are calculated in Simulate().
 	void ER_RenderingObject::Update(const ER_CoreTime& time)
 	{
 		UpdateBitmaskFlags();
 
-		ER_Camera* camera = (ER_Camera*)(mCore->GetServices().FindService(ER_Camera::TypeIdClass()));
-		assert(camera);
+		ER_Camera* camera = &mCamera; // same as the camera service, no lookup per object
 
 		bool isCurrentlyEditable = ER_Utility::IsEditorMode && mIsAvailableInEditorMode && mIsSelected;
 
@@ -814,71 +883,175 @@ namespace EveryRay_Core
 		//if (mIsTerrainPlacement && !mIsTerrainPlacementFinished)
 		//	PlaceProcedurallyOnTerrain();
 
+		if (mIsIndirectlyRendered)
+			CreateIndirectInstanceData(); // only happens once but we need to do it after the first update (i.e. after we placed the instances and calculated their AABBs)
+
+		// indirectly rendered objects are culled on the GPU, so we can't skip them here
+		if (camera && (!mIsCulled || mIsIndirectlyRendered))
+			ReportTexturesUsage(camera);
+
+		if (isCurrentlyEditable)
+		{
+			UpdateGizmos();
+			ShowInstancesListWindow();
+			if (mIsAABBDebugEnabled)
+				mDebugGizmoAABB->Update(mGlobalAABB);
+		}
+	}
+
+	// Runs on the worker thread of ER_FramePipeline: only reads the data that the main thread does not change while a frame is recorded
+	// (transforms, instance data, LODs) and only writes mSimulatedState
+	void ER_RenderingObject::Simulate(const ER_RenderingObjectSimulationCamera& aCamera, const ER_CPUOcclusionCuller* aOcclusionCuller)
+	{
+		ER_RenderingObjectSimulatedState& state = mSimulatedState;
+		state.isUploadingOriginalInstanceData = false;
+		state.isUploadingPostCullingInstanceData = false;
+		state.isUploadingPostLoddingInstanceData = false;
+		state.isUploadingPostOcclusionInstanceData = false;
+		state.isCulled = false;
+		state.isOccluded = false;
+		state.currentLODIndex = 0;
+		state.occludedCount = 0;
+
 		//update AABBs (global and instanced)
 		{
-			mGlobalAABB = mLocalAABB;
-			UpdateAABB(mGlobalAABB, mTransformationMatrix);
+			state.globalAABB = mLocalAABB;
+			UpdateAABB(state.globalAABB, mTransformationMatrix);
 
+			state.instanceAABBs.resize(mInstanceCount);
+			state.instanceCullingFlags.assign(mInstanceCount, false);
 			if (mIsInstanced)
 			{
 				XMMATRIX instanceWorldMatrix = XMMatrixIdentity();
 				for (int instanceIndex = 0; instanceIndex < static_cast<int>(mInstanceCount); instanceIndex++)
 				{
 					instanceWorldMatrix = XMLoadFloat4x4(&(mInstanceData[0][instanceIndex].World));
-					mInstanceAABBs[instanceIndex] = mLocalAABB;
-					UpdateAABB(mInstanceAABBs[instanceIndex], instanceWorldMatrix);
+					state.instanceAABBs[instanceIndex] = mLocalAABB;
+					UpdateAABB(state.instanceAABBs[instanceIndex], instanceWorldMatrix);
 				}
 			}
 		}
 
-		if (mIsIndirectlyRendered)
-			CreateIndirectInstanceData(); // only happens once but we need to do it after the first update (i.e. after we placed the instances and calculated their AABBs)
-		else // fallback for old CPU frustum culling (i.e., makes sense for non-instanced objects)
+		if (!mIsIndirectlyRendered) // fallback for old CPU frustum culling (i.e., makes sense for non-instanced objects)
 		{
-			if (ER_Utility::IsMainCameraCPUFrustumCulling && camera)
-				PerformCPUFrustumCull(camera);
-			else
+			if (aCamera.isFrustumCulling || aOcclusionCuller)
+				PerformCPUCull(aCamera, aOcclusionCuller, state);
+			else if (mIsInstanced)
 			{
 				// you can still use CPU culling of instances with buffer updates (for objects which do not use indirect rendering)
 				// however, this is left here mainly for legacy reason and potential debugging of indirect culling/rendering bugs
-				if (mIsInstanced)
-				{
-					//just updating transforms (that could be changed in a previous frame); this is not optimal (GPU buffer map() every frame...)
-					for (int lod = 0; lod < GetLODCount(); lod++)
-						UpdateInstanceBuffer(mInstanceData[lod], lod);
-				}
+				// just updating transforms (that could be changed in a previous frame); this is not optimal (GPU buffer map() every frame...)
+				state.isUploadingOriginalInstanceData = true;
 			}
 		}
 
 		if (GetLODCount() > 1)
-			UpdateLODs();
+			UpdateLODs(aCamera, state);
+	}
 
-		if (isCurrentlyEditable)
+	// Main thread (see ER_FramePipeline::Publish()): the simulated state becomes the current one (containers are swapped, not copied)
+	void ER_RenderingObject::PublishSimulatedState()
+	{
+		ER_RenderingObjectSimulatedState& state = mSimulatedState;
+		if (state.instanceAABBs.size() != mInstanceCount) // not simulated yet
+			return;
+
+		mGlobalAABB = state.globalAABB;
+		std::swap(mInstanceAABBs, state.instanceAABBs);
+		std::swap(mInstanceCullingFlags, state.instanceCullingFlags);
+		mIsCulled = state.isCulled;
+		mIsOccluded = state.isOccluded;
+		mCurrentLODIndex = state.currentLODIndex;
+		mOccludedCount = state.occludedCount;
+
+		if (state.isUploadingOriginalInstanceData)
 		{
-			UpdateGizmos();
-			ShowInstancesListWindow();
-			if (mIsAABBDebugEnabled)
-				mDebugGizmoAABB->Update(mGlobalAABB);
+			for (int lod = 0; lod < GetLODCount(); lod++)
+				UpdateInstanceBuffer(mInstanceData[lod], lod);
+		}
+		if (state.isUploadingPostCullingInstanceData)
+			UpdateInstanceBuffer(state.postCullingInstanceData, 0);
+		mIsUsingMainViewInstanceBuffers = state.isUploadingPostOcclusionInstanceData;
+		if (state.isUploadingPostOcclusionInstanceData)
+			UpdateMainViewInstanceBuffer(state.postOcclusionInstanceData);
+		if (state.isUploadingPostLoddingInstanceData)
+		{
+			for (int lod = 0; lod < GetLODCount(); lod++)
+				UpdateInstanceBuffer(state.postLoddingInstanceData[lod], lod);
 		}
 	}
 
-	void ER_RenderingObject::UpdateAABB(ER_AABB& aabb, const XMMATRIX& transformMatrix)
+	// Sends the screen coverage of the object to the texture streamer, which then decides how many mips of our textures should be resident
+	void ER_RenderingObject::ReportTexturesUsage(ER_Camera* camera)
 	{
+		ER_TextureStreamer* textureStreamer = mCore->GetServices().FindService<ER_TextureStreamer>();
+		if (!textureStreamer)
+			return;
+
+		float pixelsOnScreen = 0.0f;
+		if (mIsInstanced)
+		{
+			for (UINT instanceIndex = 0; instanceIndex < mInstanceCount; instanceIndex++)
+				pixelsOnScreen = std::max(pixelsOnScreen, GetScreenCoverage(mInstanceAABBs[instanceIndex], camera));
+		}
+		else
+			pixelsOnScreen = GetScreenCoverage(mGlobalAABB, camera);
+
+		// lower texture quality just drops the most detailed mips
+		const int mipBias = static_cast<int>(RenderingObjectTextureQuality::OBJECT_TEXTURE_HIGH) - static_cast<int>(mCurrentTextureQuality);
+
+		for (auto& textureData : mMeshesTextureBuffers)
+		{
+			ER_RHI_GPUTexture* textures[] = { textureData.AlbedoMap, textureData.NormalMap, textureData.SpecularMap, textureData.MetallicMap,
+				textureData.RoughnessMap, textureData.HeightMap, textureData.ExtraMaskMap, textureData.ExtraMap2, textureData.ExtraMap3 };
+			for (ER_RHI_GPUTexture* texture : textures)
+			{
+				if (texture)
+					textureStreamer->ReportTextureUsage(texture, pixelsOnScreen, mipBias);
+			}
+		}
+
+		ER_RHI_GPUTexture* extraTextures[] = { mSnowAlbedoTexture, mSnowNormalTexture, mSnowRoughnessTexture, mFurHeightTexture };
+		for (ER_RHI_GPUTexture* texture : extraTextures)
+		{
+			if (texture)
+				textureStreamer->ReportTextureUsage(texture, pixelsOnScreen, mipBias);
+		}
+	}
+
+	// Approximate projected size (in pixels, vertically) of the bounding sphere of the AABB
+	float ER_RenderingObject::GetScreenCoverage(const ER_AABB& aabb, ER_Camera* camera)
+	{
+		const XMVECTOR minPoint = XMLoadFloat3(&aabb.first);
+		const XMVECTOR maxPoint = XMLoadFloat3(&aabb.second);
+		const float radius = 0.5f * XMVectorGetX(XMVector3Length(maxPoint - minPoint));
+		const float distanceToCenter = XMVectorGetX(XMVector3Length(0.5f * (minPoint + maxPoint) - XMLoadFloat3(&camera->Position())));
+
+		if (distanceToCenter <= radius) // camera is inside
+			return FLT_MAX;
+
+		const float distance = std::max(distanceToCenter - radius, camera->NearPlaneDistance());
+		return radius * static_cast<float>(mCore->ScreenHeight()) / (distance * tanf(0.5f * camera->FieldOfView()));
+	}
+
+	void ER_RenderingObject::UpdateAABB(ER_AABB& aabb, const XMMATRIX& transformMatrix) const
+	{
+		XMFLOAT3 aabbVertices[8]; // not a member: also called from the worker thread of ER_FramePipeline
 		// computing AABB from the non-axis aligned BB
-		mCurrentGlobalAABBVertices[0] = (XMFLOAT3(aabb.first.x, aabb.second.y, aabb.first.z));
-		mCurrentGlobalAABBVertices[1] = (XMFLOAT3(aabb.second.x, aabb.second.y, aabb.first.z));
-		mCurrentGlobalAABBVertices[2] = (XMFLOAT3(aabb.second.x, aabb.first.y, aabb.first.z));
-		mCurrentGlobalAABBVertices[3] = (XMFLOAT3(aabb.first.x, aabb.first.y, aabb.first.z));
-		mCurrentGlobalAABBVertices[4] = (XMFLOAT3(aabb.first.x, aabb.second.y, aabb.second.z));
-		mCurrentGlobalAABBVertices[5] = (XMFLOAT3(aabb.second.x, aabb.second.y, aabb.second.z));
-		mCurrentGlobalAABBVertices[6] = (XMFLOAT3(aabb.second.x, aabb.first.y, aabb.second.z));
-		mCurrentGlobalAABBVertices[7] = (XMFLOAT3(aabb.first.x, aabb.first.y, aabb.second.z));
+		aabbVertices[0] = (XMFLOAT3(aabb.first.x, aabb.second.y, aabb.first.z));
+		aabbVertices[1] = (XMFLOAT3(aabb.second.x, aabb.second.y, aabb.first.z));
+		aabbVertices[2] = (XMFLOAT3(aabb.second.x, aabb.first.y, aabb.first.z));
+		aabbVertices[3] = (XMFLOAT3(aabb.first.x, aabb.first.y, aabb.first.z));
+		aabbVertices[4] = (XMFLOAT3(aabb.first.x, aabb.second.y, aabb.second.z));
+		aabbVertices[5] = (XMFLOAT3(aabb.second.x, aabb.second.y, aabb.second.z));
+		aabbVertices[6] = (XMFLOAT3(aabb.second.x, aabb.first.y, aabb.second.z));
+		aabbVertices[7] = (XMFLOAT3(aabb.first.x, aabb.first.y, aabb.second.z));
 
 		// non-axis-aligned BB (applying transform)
 		for (size_t i = 0; i < 8; i++)
 		{
-			XMVECTOR point = XMVector3Transform(XMLoadFloat3(&(mCurrentGlobalAABBVertices[i])), transformMatrix);
-			XMStoreFloat3(&(mCurrentGlobalAABBVertices[i]), point);
+			XMVECTOR point = XMVector3Transform(XMLoadFloat3(&(aabbVertices[i])), transformMatrix);
+			XMStoreFloat3(&(aabbVertices[i]), point);
 		}
 
 		XMFLOAT3 minVertex = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
@@ -887,14 +1060,14 @@ namespace EveryRay_Core
 		for (UINT i = 0; i < 8; i++)
 		{
 			//Get the smallest vertex 
-			minVertex.x = std::min(minVertex.x, mCurrentGlobalAABBVertices[i].x);    // Find smallest x value in model
-			minVertex.y = std::min(minVertex.y, mCurrentGlobalAABBVertices[i].y);    // Find smallest y value in model
-			minVertex.z = std::min(minVertex.z, mCurrentGlobalAABBVertices[i].z);    // Find smallest z value in model
+			minVertex.x = std::min(minVertex.x, aabbVertices[i].x);    // Find smallest x value in model
+			minVertex.y = std::min(minVertex.y, aabbVertices[i].y);    // Find smallest y value in model
+			minVertex.z = std::min(minVertex.z, aabbVertices[i].z);    // Find smallest z value in model
 
 			//Get the largest vertex 
-			maxVertex.x = std::max(maxVertex.x, mCurrentGlobalAABBVertices[i].x);    // Find largest x value in model
-			maxVertex.y = std::max(maxVertex.y, mCurrentGlobalAABBVertices[i].y);    // Find largest y value in model
-			maxVertex.z = std::max(maxVertex.z, mCurrentGlobalAABBVertices[i].z);    // Find largest z value in model
+			maxVertex.x = std::max(maxVertex.x, aabbVertices[i].x);    // Find largest x value in model
+			maxVertex.y = std::max(maxVertex.y, aabbVertices[i].y);    // Find largest y value in model
+			maxVertex.z = std::max(maxVertex.z, aabbVertices[i].z);    // Find largest z value in model
 		}
 
 		aabb = ER_AABB(minVertex, maxVertex);
@@ -1031,6 +1204,8 @@ namespace EveryRay_Core
 					name += " LOD #" + std::to_string(mCurrentLODIndex);
 					if (mIsCulled)
 						name += " (Culled)";
+					else if (mIsOccluded)
+						name += " (Occluded)";
 				}
 			}
 
@@ -1077,7 +1252,7 @@ namespace EveryRay_Core
 				XMFLOAT3 newCameraPos;
 				ER_MatrixHelper::GetTranslation(XMLoadFloat4x4(&(XMFLOAT4X4(mCurrentObjectTransformMatrix))), newCameraPos);
 
-				ER_Camera* camera = (ER_Camera*)(mCore->GetServices().FindService(ER_Camera::TypeIdClass()));
+				ER_Camera* camera = mCore->GetServices().FindService<ER_Camera>();
 				if (camera)
 					camera->SetPosition(newCameraPos);
 			}
@@ -1188,6 +1363,15 @@ namespace EveryRay_Core
 		if (!mIndirectMeshConstants.IsInitialized() && mIsIndirectlyRendered)
 			mIndirectMeshConstants.Initialize(rhi, "ER_RHI_GPUBuffer: GPU Indirect Mesh CB: " + mName);
 
+		FillIndirectMeshConstants(mIndirectMeshConstants.Data);
+		mIndirectMeshConstants.ApplyChanges(rhi);
+
+		return mIndirectMeshConstants.Buffer();
+	}
+
+	// Mesh constants of IndirectCullingClear.hlsl and IndirectCulling.hlsl (shared by all APIs and the CPU reference in ER_GPUCuller)
+	void ER_RenderingObject::FillIndirectMeshConstants(IndirectMeshCB& aConstants) const
+	{
 		const int totalObjLodCount = GetLODCount();
 
 		int offset, indexCount, lastAvailableLod = 0;
@@ -1203,63 +1387,61 @@ namespace EveryRay_Core
 				// Uncomment this if you want to fallback into previous LOD (you have to adjust ER_RenderingObject::Draw())
 				// indexCount = (meshI < aObj->GetMeshCount(/*TODO ideally from lastAvailableLod but we dont support meshes per LOD yet*/)) ? aObj->GetIndexCount(lastAvailableLod, meshI) : INT_MAX;
 
-				mIndirectMeshConstants.Data.IndexCount_StartIndexLoc_BaseVtxLoc_StartInstLoc[offset] = XMINT4(indexCount, 0, 0, 0);
+				aConstants.IndexCount_StartIndexLoc_BaseVtxLoc_StartInstLoc[offset] = XMINT4(indexCount, 0, 0, 0);
 			}
 			if (lodI < totalObjLodCount)
 				lastAvailableLod = lodI;
 		}
-		mIndirectMeshConstants.Data.OriginalInstancesCount = GetInstanceCount();
-		mIndirectMeshConstants.Data.pad = XMINT3(0, 0, 0);
-		mIndirectMeshConstants.ApplyChanges(rhi);
-
-		return mIndirectMeshConstants.Buffer();
+		aConstants.OriginalInstancesCount = GetInstanceCount();
+		aConstants.pad = XMINT3(0, 0, 0);
 	}
 
-	void ER_RenderingObject::UpdateLODs()
+	// Runs on the worker thread of ER_FramePipeline: results are written to 'aState'
+	void ER_RenderingObject::UpdateLODs(const ER_RenderingObjectSimulationCamera& aCamera, ER_RenderingObjectSimulatedState& aState) const
 	{
-		const float sqrDistLod0 = ER_Utility::DistancesLOD[0] * ER_Utility::DistancesLOD[0];
-		const float sqrDistLod1 = ER_Utility::DistancesLOD[1] * ER_Utility::DistancesLOD[1];
-		const float sqrDistLod2 = ER_Utility::DistancesLOD[2] * ER_Utility::DistancesLOD[2];
+		const float sqrDistLod0 = aCamera.lodDistances[0] * aCamera.lodDistances[0];
+		const float sqrDistLod1 = aCamera.lodDistances[1] * aCamera.lodDistances[1];
+		const float sqrDistLod2 = aCamera.lodDistances[2] * aCamera.lodDistances[2];
 
 		if (mIsInstanced) {
 			if (!mIsIndirectlyRendered) // LODs are also updated in ER_GPUCuller, so no need to do that here
 				return;
-			if (!ER_Utility::IsMainCameraCPUFrustumCulling && mInstanceData.size() == 0)
+			if (!aCamera.isFrustumCulling && mInstanceData.size() == 0)
 				return;
-			if (ER_Utility::IsMainCameraCPUFrustumCulling && mTempPostCullingInstanceData.size() == 0)
+			if (aCamera.isFrustumCulling && aState.postCullingInstanceData.size() == 0)
 				return;
 
-			mTempPostLoddingInstanceData.clear();
-			for (int lod = 0; lod < GetLODCount(); lod++)
-				mTempPostLoddingInstanceData.push_back({});
+			// the per-LOD lists keep their capacity between frames (no heap allocations once the instance counts settle)
+			aState.postLoddingInstanceData.resize(GetLODCount());
+			for (auto& lodInstanceData : aState.postLoddingInstanceData)
+				lodInstanceData.clear();
 
 			//traverse through original or culled instance data (sort of "read-only") to rebalance LOD's instance buffers
-			int length = (ER_Utility::IsMainCameraCPUFrustumCulling) ? static_cast<int>(mTempPostCullingInstanceData.size()) : static_cast<int>(mInstanceData[0].size());
+			int length = (aCamera.isFrustumCulling) ? static_cast<int>(aState.postCullingInstanceData.size()) : static_cast<int>(mInstanceData[0].size());
 			for (int i = 0; i < length; i++)
 			{
 				XMFLOAT3 pos;
-				XMMATRIX mat = (ER_Utility::IsMainCameraCPUFrustumCulling) ? XMLoadFloat4x4(&mTempPostCullingInstanceData[i].World) : XMLoadFloat4x4(&mInstanceData[0][i].World);
+				XMMATRIX mat = (aCamera.isFrustumCulling) ? XMLoadFloat4x4(&aState.postCullingInstanceData[i].World) : XMLoadFloat4x4(&mInstanceData[0][i].World);
 				ER_MatrixHelper::GetTranslation(mat, pos);
 
 				float distanceToCameraSqr =
-					(mCamera.Position().x - pos.x) * (mCamera.Position().x - pos.x) +
-					(mCamera.Position().y - pos.y) * (mCamera.Position().y - pos.y) +
-					(mCamera.Position().z - pos.z) * (mCamera.Position().z - pos.z);
+					(aCamera.position.x - pos.x) * (aCamera.position.x - pos.x) +
+					(aCamera.position.y - pos.y) * (aCamera.position.y - pos.y) +
+					(aCamera.position.z - pos.z) * (aCamera.position.z - pos.z);
 
 				//XMMATRIX newMat;
 				if (distanceToCameraSqr <= sqrDistLod0) {
-					mTempPostLoddingInstanceData[0].push_back((ER_Utility::IsMainCameraCPUFrustumCulling) ? mTempPostCullingInstanceData[i].World : mInstanceData[0][i].World);
+					aState.postLoddingInstanceData[0].push_back((aCamera.isFrustumCulling) ? aState.postCullingInstanceData[i].World : mInstanceData[0][i].World);
 				}
 				else if (sqrDistLod0 < distanceToCameraSqr && distanceToCameraSqr <= sqrDistLod1) {
-					mTempPostLoddingInstanceData[1].push_back((ER_Utility::IsMainCameraCPUFrustumCulling) ? mTempPostCullingInstanceData[i].World : mInstanceData[0][i].World);
+					aState.postLoddingInstanceData[1].push_back((aCamera.isFrustumCulling) ? aState.postCullingInstanceData[i].World : mInstanceData[0][i].World);
 				}
 				else if (sqrDistLod1 < distanceToCameraSqr && distanceToCameraSqr <= sqrDistLod2) {
-					mTempPostLoddingInstanceData[2].push_back((ER_Utility::IsMainCameraCPUFrustumCulling) ? mTempPostCullingInstanceData[i].World : mInstanceData[0][i].World);
+					aState.postLoddingInstanceData[2].push_back((aCamera.isFrustumCulling) ? aState.postCullingInstanceData[i].World : mInstanceData[0][i].World);
 				}
 			}
 
-			for (int i = 0; i < GetLODCount(); i++)
-				UpdateInstanceBuffer(mTempPostLoddingInstanceData[i], i);
+			aState.isUploadingPostLoddingInstanceData = true;
 		}
 		else
 		{
@@ -1267,23 +1449,23 @@ namespace EveryRay_Core
 			ER_MatrixHelper::GetTranslation(mTransformationMatrix, pos);
 
 			float distanceToCameraSqr =
-				(mCamera.Position().x - pos.x) * (mCamera.Position().x - pos.x) +
-				(mCamera.Position().y - pos.y) * (mCamera.Position().y - pos.y) +
-				(mCamera.Position().z - pos.z) * (mCamera.Position().z - pos.z);
+				(aCamera.position.x - pos.x) * (aCamera.position.x - pos.x) +
+				(aCamera.position.y - pos.y) * (aCamera.position.y - pos.y) +
+				(aCamera.position.z - pos.z) * (aCamera.position.z - pos.z);
 
 			if (distanceToCameraSqr <= sqrDistLod0) {
-				mCurrentLODIndex = 0;
+				aState.currentLODIndex = 0;
 			}
 			else if (sqrDistLod0 < distanceToCameraSqr && distanceToCameraSqr <= sqrDistLod1) {
-				mCurrentLODIndex = 1;
+				aState.currentLODIndex = 1;
 			}
 			else if (sqrDistLod1 < distanceToCameraSqr && distanceToCameraSqr <= sqrDistLod2) {
-				mCurrentLODIndex = 2;
+				aState.currentLODIndex = 2;
 			}
 			else
-				mCurrentLODIndex = -1; //culled
+				aState.currentLODIndex = -1; //culled
 
-			mCurrentLODIndex = std::min(mCurrentLODIndex, GetLODCount());
+			aState.currentLODIndex = std::min(aState.currentLODIndex, GetLODCount());
 		}
 	}
 	void ER_RenderingObject::LoadLOD(std::unique_ptr<ER_Model> pModel)
@@ -1309,6 +1491,40 @@ namespace EveryRay_Core
 		LoadRenderBuffers(lodIndex);
 	}
 
+	void ER_RenderingObject::LoadOccluder(const ER_Model* aProxyModel)
+	{
+		const int lastLOD = GetLODCount() - 1;
+		const ER_Model* model = aProxyModel ? aProxyModel : (lastLOD == 0 ? mModel.get() : mModelLODs[lastLOD - 1].get());
+		assert(model);
+
+		mOccluderVertices.clear();
+		mOccluderIndices.clear();
+		for (size_t meshIndex = 0; meshIndex < model->Meshes().size(); meshIndex++)
+		{
+			const ER_Mesh& mesh = model->GetMesh(static_cast<int>(meshIndex));
+			const UINT baseVertex = static_cast<UINT>(mOccluderVertices.size());
+			mOccluderVertices.insert(mOccluderVertices.end(), mesh.Vertices().begin(), mesh.Vertices().end());
+			for (UINT index : mesh.Indices())
+				mOccluderIndices.push_back(baseVertex + index);
+		}
+		mIsOccluder = !mOccluderIndices.empty();
+	}
+
+	// Runs on the worker thread of ER_FramePipeline (before the objects are simulated)
+	void ER_RenderingObject::RasterizeOccluder(ER_CPUOcclusionCuller& aCuller) const
+	{
+		if (!mIsOccluder)
+			return;
+
+		if (mIsInstanced)
+		{
+			for (UINT instanceIndex = 0; instanceIndex < mInstanceCount; instanceIndex++)
+				aCuller.AddOccluder(mOccluderVertices, mOccluderIndices, XMLoadFloat4x4(&(mInstanceData[0][instanceIndex].World)));
+		}
+		else
+			aCuller.AddOccluder(mOccluderVertices, mOccluderIndices, mTransformationMatrix);
+	}
+
 	void ER_RenderingObject::ResetInstanceData(int count, bool clear, int lod)
 	{
 		assert(lod < GetLODCount());
@@ -1362,21 +1578,14 @@ namespace EveryRay_Core
 		mIndirectNewInstanceDataBuffer = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: ER_RenderingObject - Indirect New Instance Data Buffer : " + mName);
 		mIndirectOriginalInstanceDataBuffer = rhi->CreateGPUBuffer("ER_RHI_GPUBuffer: ER_RenderingObject - Indirect Original Instance Data Buffer : " + mName);
 
-		struct IndirectInstanceData 
-		{
-			XMFLOAT4X4 world;
-			XMFLOAT4 aabbMin;
-			XMFLOAT4 aabbMax;
-		};
-
-		std::vector<IndirectInstanceData> data;
+		std::vector<IndirectInstanceData>& data = mIndirectOriginalInstanceData;
 		data.resize(mInstanceCount);
 
 		for (int i = 0; i < mInstanceCount; ++i)
 		{
-			data[i].world = mInstanceData[0][i].World;
-			data[i].aabbMin = XMFLOAT4(mInstanceAABBs[i].first.x, mInstanceAABBs[i].first.y, mInstanceAABBs[i].first.z, 1.0f);
-			data[i].aabbMax = XMFLOAT4(mInstanceAABBs[i].second.x, mInstanceAABBs[i].second.y, mInstanceAABBs[i].second.z, 1.0f);
+			data[i].World = mInstanceData[0][i].World;
+			data[i].AABBMin = XMFLOAT4(mInstanceAABBs[i].first.x, mInstanceAABBs[i].first.y, mInstanceAABBs[i].first.z, 1.0f);
+			data[i].AABBMax = XMFLOAT4(mInstanceAABBs[i].second.x, mInstanceAABBs[i].second.y, mInstanceAABBs[i].second.z, 1.0f);
 		}
 
 		mIndirectOriginalInstanceDataBuffer->CreateGPUBufferResource(rhi, &data[0], mInstanceCount, sizeof(IndirectInstanceData), false,
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "Common.h"
-#include "ER_GenericEvent.h"
+#include "ER_Event.h"
 #include "ER_ModelMaterial.h"
 
 #include "RHI\ER_RHI.h"
@@ -31,6 +31,7 @@ namespace EveryRay_Core
 	class ER_RenderableAABB;
 	class ER_Camera;
 	class ER_Model;
+	class ER_CPUOcclusionCuller;
 
 	enum RenderingObjectTextureQuality
 	{
@@ -92,6 +93,14 @@ namespace EveryRay_Core
 		XMINT3 pad;
 	};
 
+	// Keep in sync with "Instance" in content/shaders/IndirectCulling.hlsli!
+	struct IndirectInstanceData
+	{
+		XMFLOAT4X4 World;
+		XMFLOAT4 AABBMin;
+		XMFLOAT4 AABBMax;
+	};
+
 	struct ER_ALIGN_GPU_BUFFER ObjectFakeRootCB
 	{
 		UINT CurrentLOD;
@@ -146,9 +155,41 @@ namespace EveryRay_Core
 		
 	};
 
+	// Camera data of the simulation, copied on the main thread before the simulation is kicked (see ER_FramePipeline)
+	struct ER_RenderingObjectSimulationCamera
+	{
+		XMFLOAT4 frustumPlanes[6];
+		XMFLOAT3 position = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		XMFLOAT4X4 viewProjection;
+		float lodDistances[MAX_LOD] = {}; // copy of ER_Utility::DistancesLOD (edited by ImGui on the main thread)
+		bool isFrustumCulling = false;
+		bool isOcclusionCulling = false;
+	};
+
+	// Render-facing state written by ER_RenderingObject::Simulate() (worker thread) and handed to the main thread by ER_RenderingObject::PublishSimulatedState()
+	struct ER_RenderingObjectSimulatedState
+	{
+		ER_AABB globalAABB;
+		std::vector<ER_AABB> instanceAABBs;
+		std::vector<bool> instanceCullingFlags;
+		std::vector<InstancedData> postCullingInstanceData; // instance data after CPU culling
+		std::vector<InstancedData> postOcclusionInstanceData; // instance data after CPU culling and occlusion culling (main view only)
+		std::vector<std::vector<InstancedData>> postLoddingInstanceData; // instance data after lodding (per LOD group)
+		int currentLODIndex = 0;
+		UINT occludedCount = 0; // object or instances culled by the occlusion culler
+		bool isCulled = false; // frustum only
+		bool isOccluded = false;
+
+		// instance buffers to update when the state is published
+		bool isUploadingOriginalInstanceData = false;
+		bool isUploadingPostCullingInstanceData = false;
+		bool isUploadingPostLoddingInstanceData = false;
+		bool isUploadingPostOcclusionInstanceData = false;
+	};
+
 	class ER_RenderingObject
 	{
-		using Delegate_MeshMaterialVariablesUpdate = std::function<void(int, int)>; // mesh index & lod index for input
+		using Delegate_MeshMaterialVariablesUpdate = void(int, int); // mesh index & lod index for input
 
 	public:
 		ER_RenderingObject(const std::string& pName, int index, ER_Core& pCore, ER_Camera& pCamera, std::unique_ptr<ER_Model> pModel, bool availableInEditor = false, bool isInstanced = false);
@@ -161,15 +202,21 @@ namespace EveryRay_Core
 		void LoadCustomMaterialTextures();
 		void LoadAssignedMeshTextures(int meshIndex);
 
-		void Draw(const std::string& materialName, bool toDepth = false, int meshIndex = -1);
-		void DrawLOD(const std::string& materialName, bool toDepth, int meshIndex, int lod, bool skipCulling = false);
+		// 'isMainView' - the pass is rendered from the main camera (GBuffer, forward), so occlusion culling results are also applied
+		void Draw(const std::string& materialName, bool toDepth = false, int meshIndex = -1, bool isMainView = false);
+		// 'aInstanceBuffer' replaces the camera-culled instances of an instanced (non-indirect) object, i.e., instances culled by another system
+		void DrawLOD(const std::string& materialName, bool toDepth, int meshIndex, int lod, bool skipCulling = false, ER_RHI_GPUBuffer* aInstanceBuffer = nullptr, UINT aInstanceCount = 0, bool isMainView = false);
 		void DrawAABB(ER_RHI_GPUTexture* aRenderTarget, ER_RHI_GPUTexture* aDepth, ER_RHI_GPURootSignature* rs);
 		void Update(const ER_CoreTime& time);
+		// 'aOcclusionCuller' - occluders are already rasterized (nullptr if the occlusion culling is disabled)
+		void Simulate(const ER_RenderingObjectSimulationCamera& aCamera, const ER_CPUOcclusionCuller* aOcclusionCuller = nullptr);
+		void PublishSimulatedState();
 
 		std::map<std::string, ER_Material*>& GetMaterials() { return mMaterials; }
 		
 		TextureData& GetTextureData(int meshIndex) { return mMeshesTextureBuffers[meshIndex]; }
 		
+		const ER_Model* GetModel() const { return mModel.get(); } // LOD 0
 		const int GetMeshCount(int lod = 0) const { return mMeshesCount[lod]; }
 		const std::vector<XMFLOAT3>& GetVertices(int lod = 0) { return mMeshAllVertices[lod]; }
 		const UINT GetInstanceCount(int lod = 0) const { return (mIsInstanced ? static_cast<UINT>(mInstanceData[lod].size()) : 0); }
@@ -194,8 +241,7 @@ namespace EveryRay_Core
 		void AddInstanceData(const XMMATRIX& worldMatrix, int lod = -1);
 		void CreateIndirectInstanceData();
 		UINT InstanceSize() const;
-		
-		void PerformCPUFrustumCull(ER_Camera* camera);
+
 
 		void SetGPUIndirectlyRendered(bool value) { mIsIndirectlyRendered = value; }
 		bool IsGPUIndirectlyRendered() { return mIsIndirectlyRendered; }
@@ -203,13 +249,24 @@ namespace EveryRay_Core
 		ER_RHI_GPUBuffer* GetIndirectOriginalInstanceBuffer() { return mIndirectOriginalInstanceDataBuffer; }
 		ER_RHI_GPUBuffer* GetIndirectArgsBuffer() { return mIndirectArgsBuffer; }
 		ER_RHI_GPUBuffer* GetIndirectMeshConstantBuffer();
+		void FillIndirectMeshConstants(IndirectMeshCB& aConstants) const;
+		const std::vector<IndirectInstanceData>& GetIndirectOriginalInstanceData() const { return mIndirectOriginalInstanceData; }
 
 		void Rename(const std::string& name) { mName = name; }
 		const std::string& GetName() { return mName; }
 
 		const int GetLODCount() const {	return 1 + static_cast<int>(mModelLODs.size());	}
-		void UpdateLODs();
 		void LoadLOD(std::unique_ptr<ER_Model> pModel);
+
+		// Triangles of 'aProxyModel' (or of the last LOD if nullptr) are rasterized by the CPU occlusion culler
+		void LoadOccluder(const ER_Model* aProxyModel);
+		void RasterizeOccluder(ER_CPUOcclusionCuller& aCuller) const;
+		bool IsOccluder() const { return mIsOccluder; }
+		UINT GetOccludedCount() const { return mOccludedCount; }
+
+		// Dynamic casters are redrawn into the shadow maps every frame, static ones are cached (see ER_ShadowMapper)
+		void SetDynamicShadowCaster(bool value) { mIsDynamicShadowCaster = value; }
+		bool IsDynamicShadowCaster() const { return mIsDynamicShadowCaster; }
 		
 		float GetMinScale() { return mMinScale; }
 		void SetMinScale(float v) { mMinScale = v; }
@@ -226,9 +283,10 @@ namespace EveryRay_Core
 		bool IsRendered() { return mIsRendered; }
 		void SetRendered(bool val) { mIsRendered = val; }
 
-		// main camera view flag
+		// main camera view flags: frustum culling (also used by other views, i.e., shadows) and occlusion culling (main view passes only)
 		bool IsCulled() { return mIsCulled; }
 		void SetCulled(bool val) { mIsCulled = val; }
+		bool IsOccluded() { return mIsOccluded; }
 
 		float GetCustomAlphaDiscard() { return mCustomAlphaDiscard; }
 		void SetCustomAlphaDiscard(float val) { mCustomAlphaDiscard = val; }
@@ -302,9 +360,12 @@ namespace EveryRay_Core
 		void SetIndexInScene(int index) { mIndexInScene = index; }
 
 		ER_RHI_GPUConstantBuffer<ObjectCB>& GetObjectsConstantBuffer() { return mObjectConstantBuffer; }
+		// Constant buffers must be updated before they are bound (on DX12 an update moves them to a new range of the per-frame ring),
+		// so materials that bind the object's buffer before DrawLOD() (i.e., in their PrepareForRendering()) call this first
+		void PrepareObjectConstantBuffer();
 		ER_RHI_GPUConstantBuffer<ObjectFakeRootCB>& GetObjectsFakeRootConstantBuffer() { return mObjectFakeRootConstantBuffer; }
 
-		ER_GenericEvent<Delegate_MeshMaterialVariablesUpdate>* MeshMaterialVariablesUpdateEvent = new ER_GenericEvent<Delegate_MeshMaterialVariablesUpdate>();
+		ER_Event<Delegate_MeshMaterialVariablesUpdate>* MeshMaterialVariablesUpdateEvent = new ER_Event<Delegate_MeshMaterialVariablesUpdate>();
 	
 		std::vector<std::string> mCustomAlbedoTextures;
 		std::vector<std::string> mCustomNormalTextures;
@@ -348,9 +409,15 @@ namespace EveryRay_Core
 		void SetFurGravityStrength(float v) { mFurGravityStrength = v; }
 		XMFLOAT4 GetFurGravityStrength(); 
 	private:
-		void UpdateAABB(ER_AABB& aabb, const XMMATRIX& transformMatrix);
+		void UpdateAABB(ER_AABB& aabb, const XMMATRIX& transformMatrix) const;
+		void UpdateObjectConstantBuffer();
+		void PerformCPUCull(const ER_RenderingObjectSimulationCamera& aCamera, const ER_CPUOcclusionCuller* aOcclusionCuller, ER_RenderingObjectSimulatedState& aState) const;
+		void UpdateLODs(const ER_RenderingObjectSimulationCamera& aCamera, ER_RenderingObjectSimulatedState& aState) const;
+		void ReportTexturesUsage(ER_Camera* camera);
+		float GetScreenCoverage(const ER_AABB& aabb, ER_Camera* camera);
 		void LoadTexture(ER_RHI_GPUTexture** aTexture, bool* loadStat, const std::wstring& path, int meshIndex, bool isPlaceholder = false);
 		void CreateInstanceBuffer(InstancedData* instanceData, UINT instanceCount, ER_RHI_GPUBuffer* instanceBuffer);
+		void UpdateMainViewInstanceBuffer(std::vector<InstancedData>& instanceData);
 		
 		void UpdateGizmos();
 		void UpdateBitmaskFlags();
@@ -364,6 +431,7 @@ namespace EveryRay_Core
 
 		ER_RHI_GPUConstantBuffer<ObjectCB>						mObjectConstantBuffer;
 		ER_RHI_GPUConstantBuffer<ObjectFakeRootCB>				mObjectFakeRootConstantBuffer; // for platforms where root constants aren't supported
+		bool													mIsObjectConstantBufferPrepared = false; // by PrepareObjectConstantBuffer() for the next DrawLOD()
 
 		///****************************************************************************************************************************
 		// *** mesh/model data (buffers, textures, etc.) ***
@@ -371,11 +439,14 @@ namespace EveryRay_Core
 		std::vector<std::vector<std::vector<XMFLOAT3>>>			mMeshVertices; // vertices per mesh, per LOD group
 		std::vector<std::vector<RenderBufferData*>>				mMeshRenderBuffers; // vertex/index buffers per mesh, per LOD group
 		std::vector<std::vector<InstanceBufferData*>>			mMeshesInstanceBuffers; // instance buffers per mesh, per LOD group
+		std::vector<InstanceBufferData*>						mMeshesMainViewInstanceBuffers; // instance buffers per mesh (LOD 0) without occluded instances, created on first use
 		std::vector<std::vector<XMFLOAT3>>						mMeshAllVertices; // vertices of all meshes combined, per LOD group
 		std::vector<float>										mMeshesReflectionFactors; // mesh reflection factors, per LOD group
 		std::vector<int>										mMeshesCount; // mesh count, per LOD group
 		std::unique_ptr<ER_Model>								mModel;
 		std::vector<std::unique_ptr<ER_Model>>					mModelLODs;
+		std::vector<XMFLOAT3>									mOccluderVertices; // mesh space triangle list of the occluder (all meshes combined)
+		std::vector<UINT>										mOccluderIndices;
 		// 
 		///****************************************************************************************************************************
 
@@ -385,9 +456,8 @@ namespace EveryRay_Core
 		std::vector<std::string>								mInstancesNames; // collection of names of instances (mName + index)
 		std::vector<ER_AABB>									mInstanceAABBs; // collection of AABBs for every instance (shared for LODs)
 		std::vector<bool>										mInstanceCullingFlags; // collection of culling flags for every instance (vector is lame here btw...)
-		std::vector<InstancedData>								mTempPostCullingInstanceData; // temp instance data after CPU culling
-		std::vector<std::vector<InstancedData>>					mTempPostLoddingInstanceData; // temp instance data after lodding (per LOD group)
 		std::vector<UINT>										mInstanceCountToRender; //instance render count  (per LOD group)
+		UINT													mInstanceCountToRenderMainView = 0; //instance render count in mMeshesMainViewInstanceBuffers
 		std::vector<std::vector<InstancedData>>					mInstanceData; //original instance data  (per LOD group)
 		XMFLOAT4*												mTempInstancesPositions = nullptr;
 
@@ -399,6 +469,7 @@ namespace EveryRay_Core
 		ER_RHI_GPUBuffer*										mIndirectNewInstanceDataBuffer = nullptr; //new instance transforms of all LODs culled and processed in CS
 		ER_RHI_GPUBuffer*										mIndirectArgsBuffer = nullptr; // draw indexed instance indirect args for all meshes (instance count is calculated in CS)
 		ER_RHI_GPUConstantBuffer<IndirectMeshCB>				mIndirectMeshConstants; // not used on DX11-like APIs;
+		std::vector<IndirectInstanceData>						mIndirectOriginalInstanceData; // CPU copy of mIndirectOriginalInstanceDataBuffer (for the CPU reference of the GPU culling)
 		
 		///****************************************************************************************************************************
 
@@ -445,13 +516,14 @@ namespace EveryRay_Core
 
 		ER_AABB													mLocalAABB; //mesh space AABB
 		ER_AABB													mGlobalAABB; //world space AABB
-		XMFLOAT3												mCurrentGlobalAABBVertices[8];
+		ER_RenderingObjectSimulatedState						mSimulatedState; // owned by the worker thread of ER_FramePipeline between Kick() and Publish()
 		ER_RenderableAABB*										mDebugGizmoAABB = nullptr;
 	
 		std::string												mName;
 		const char*												mInstancedNamesUI[MAX_INSTANCE_COUNT];
 		int														mIndexInScene = -1;
 		int														mCurrentLODIndex = 0; //only used for non-instanced object
+		UINT													mOccludedCount = 0;
 		int														mEditorSelectedInstancedObjectIndex = 0;
 		bool													mIsAABBDebugEnabled = true;
 		bool													mIsWireframeMode = false;
@@ -462,6 +534,10 @@ namespace EveryRay_Core
 		bool													mIsForwardShading = false;
 		bool													mIsPOM = false;
 		bool													mIsCulled = false; //only for non-instanced objects
+		bool													mIsOccluded = false; //only for non-instanced objects
+		bool													mIsUsingMainViewInstanceBuffers = false; //occlusion culling results of instances are in mMeshesMainViewInstanceBuffers
+		bool													mIsOccluder = false;
+		bool													mIsDynamicShadowCaster = false;
 		bool													mIsMarkedAsFoliage = false;
 		bool													mIsInLightProbe = false;
 		bool													mIsSeparableSubsurfaceScattering = false;
@@ -13,6 +13,8 @@
 #include "ER_Sandbox.h"
 #include "ER_Editor.h"
 #include "ER_QuadRenderer.h"
+#include "ER_TextureStreamer.h"
+#include "ER_AllocationTracker.h"
 
 #include "..\JsonCpp\include\json\json.h"
 
@@ -25,8 +27,6 @@ namespace EveryRay_Core
 	static float nearPlaneDist = 0.5f;
 	static float farPlaneDist = 600.0f;
 
-	static std::mutex renderingObjectsTextureCacheMutex;
-
 	ER_RuntimeCore::ER_RuntimeCore(ER_RHI* aRHI, HINSTANCE instance, const std::wstring& windowClass, const std::wstring& windowTitle, int showCommand, bool isFullscreen)
 		: ER_Core(aRHI, instance, windowClass, windowTitle, showCommand, isFullscreen),
 		mDirectInput(nullptr),
@@ -35,7 +35,8 @@ namespace EveryRay_Core
 		mGamepad(nullptr),
 		mShowProfiler(false),
 		mEditor(nullptr),
-		mQuadRenderer(nullptr)
+		mQuadRenderer(nullptr),
+		mTextureStreamer(nullptr)
 	{
 		LoadGraphicsConfig();
 
@@ -55,6 +56,19 @@ namespace EveryRay_Core
 
 	void ER_RuntimeCore::Initialize()
 	{
+		ER_LinearArena::SetThreadArena(&mFrameArena);
+
+#if ER_TRACK_ALLOCATIONS
+		// budgets of the subsystems whose per-frame data lives in the arenas: job submissions to the worker pool (job functions, queue nodes) are the expected heap allocations
+		{
+			const std::uint64_t jobsCount = GetWorkerPool()->GetWorkersCount() + 1; // one job per worker and one for the calling thread (ER_WorkerPool::ParallelFor())
+			const std::uint64_t jobAllocations = 2;
+			ER_AllocationTracker::SetFrameBudget(ER_ALLOCATION_TAG_SIMULATION, (jobsCount + 1) * jobAllocations); // + ER_FramePipeline::Kick()
+			ER_AllocationTracker::SetFrameBudget(ER_ALLOCATION_TAG_GBUFFER, jobsCount * jobAllocations + 8);
+			ER_AllocationTracker::SetFrameBudget(ER_ALLOCATION_TAG_SHADOWS, (jobsCount * jobAllocations + 8) * NUM_SHADOW_CASCADES);
+		}
+#endif
+
 		//SetCurrentDirectory(ER_Utility::ExecutableDirectory().c_str());
 
 		{
@@ -65,15 +79,15 @@ namespace EveryRay_Core
 
 			mKeyboard = new ER_Keyboard(*this, mDirectInput);
 			mCoreEngineComponents.push_back(mKeyboard);
-			mServices.AddService(ER_Keyboard::TypeIdClass(), mKeyboard);
+			mServices.AddService<ER_Keyboard>(mKeyboard);
 
 			mMouse = new ER_Mouse(*this, mDirectInput);
 			mCoreEngineComponents.push_back(mMouse);
-			mServices.AddService(ER_Mouse::TypeIdClass(), mMouse);
+			mServices.AddService<ER_Mouse>(mMouse);
 
 			mGamepad = new ER_Gamepad(*this);
 			mCoreEngineComponents.push_back(mGamepad);
-			mServices.AddService(ER_Gamepad::TypeIdClass(), mGamepad);
+			mServices.AddService<ER_Gamepad>(mGamepad);
 		}
 
 		mCamera = new ER_CameraFPS(*this, 1.5708f, this->AspectRatio(), nearPlaneDist, farPlaneDist );
@@ -83,15 +97,19 @@ namespace EveryRay_Core
 		mCamera->SetNearPlaneDistance(nearPlaneDist);
 		mCamera->SetFarPlaneDistance(farPlaneDist);
 		mCoreEngineComponents.push_back(mCamera);
-		mServices.AddService(ER_Camera::TypeIdClass(), mCamera);
+		mServices.AddService<ER_Camera>(mCamera);
 
 		mEditor = new ER_Editor(*this);
 		mCoreEngineComponents.push_back(mEditor);
-		mServices.AddService(ER_Editor::TypeIdClass(), mEditor);
+		mServices.AddService<ER_Editor>(mEditor);
 
 		mQuadRenderer = new ER_QuadRenderer(*this);
 		mCoreEngineComponents.push_back(mQuadRenderer);
-		mServices.AddService(ER_QuadRenderer::TypeIdClass(), mQuadRenderer);
+		mServices.AddService<ER_QuadRenderer>(mQuadRenderer);
+
+		mTextureStreamer = new ER_TextureStreamer(*this);
+		mCoreEngineComponents.push_back(mTextureStreamer);
+		mServices.AddService<ER_TextureStreamer>(mTextureStreamer);
 
 		#pragma region INITIALIZE_IMGUI
 
@@ -220,9 +238,7 @@ namespace EveryRay_Core
 			DeleteObject(mCurrentSandbox);
 		}
 
-		for (auto& it : mRenderingObjectsTextureCache)
-			DeleteObject(it.second);
-		mRenderingObjectsTextureCache.erase(mRenderingObjectsTextureCache.begin(), mRenderingObjectsTextureCache.end());
+		mTextureStreamer->Clear();
 
 		if (mRHI && !isFirstLoad)
 		{
@@ -232,6 +248,7 @@ namespace EveryRay_Core
 
 			mIsRHIReset = true;
 		}
+		mTextureStreamer->CreatePlaceholderTexture();
 
 		mCurrentSandbox = new ER_Sandbox();
 		if (mScenesPaths.find(aSceneName) != mScenesPaths.end())
@@ -306,6 +323,14 @@ namespace EveryRay_Core
 			ImGui::SliderFloat("Camera Far Plane", &farPlaneDist, 150.0f, 200000.0f);
 			mCamera->SetFarPlaneDistance(farPlaneDist);
 			ImGui::Checkbox("CPU frustum culling", &ER_Utility::IsMainCameraCPUFrustumCulling);
+			ImGui::Checkbox("CPU occlusion culling", &ER_Utility::IsMainCameraCPUOcclusionCulling);
+			if (mCurrentSandbox && ER_Utility::IsMainCameraCPUOcclusionCulling)
+			{
+				const ER_CPUOcclusionCullerStats& stats = mCurrentSandbox->GetOcclusionCullerStats();
+				ImGui::Text("Occluders: %u (%u triangles), rasterized in %f ms (%u threads)", stats.occludersCount, stats.trianglesCount, stats.rasterizationTimeMs, stats.rasterizationThreadsCount);
+				ImGui::Text("Occluded objects/instances: %u", mCurrentSandbox->GetOccludedCount());
+			}
+			ImGui::Checkbox("Validate GPU culling on CPU (slow, mismatches are logged)", &ER_Utility::IsValidatingGPUCullingOnCPU);
 			ImGui::End();
 		}
 			
@@ -335,9 +360,114 @@ namespace EveryRay_Core
 				{
 					ImGui::TextColored(ImVec4(0.8f, 0.0f, 0.0f, 1), "Render: %f ms", mElapsedTimeRenderCPU.count() * 1000);
 					ImGui::TextColored(ImVec4(0.8f, 0.0f, 0.0f, 1), "Update: %f ms", mElapsedTimeUpdateCPU.count() * 1000);
+					if (mCurrentSandbox)
+					{
+						ER_FramePipeline& framePipeline = mCurrentSandbox->GetFramePipeline();
+						bool isPipelined = framePipeline.IsPipelined();
+						if (ImGui::Checkbox("Simulate next frame during recording (culling is one frame late)", &isPipelined))
+							framePipeline.SetPipelined(isPipelined);
+
+						const ER_FramePipelineStats& stats = framePipeline.GetStats();
+						ImGui::Text("Simulation: %f ms (%s)", stats.simulationTimeMs, stats.wasPipelined ? "worker thread" : "main thread");
+						ImGui::Text("Waiting for simulation: %f ms", stats.waitTimeMs);
+						ImGui::Text("Overlapped with recording: %f ms", stats.overlapTimeMs);
+					}
 				}
 				if (ImGui::CollapsingHeader("GPU Time"))
 				{
+				}
+				if (ImGui::CollapsingHeader("Texture Streaming"))
+					mTextureStreamer->ShowStatsImGui();
+				if (ImGui::CollapsingHeader("Constant Buffers"))
+				{
+					if (const ER_RHI_ConstantRingStats* ringStats = mRHI->GetConstantRingStats())
+					{
+						ImGui::Text("Ring: %.2f / %.2f MB (peak: %.2f MB)", static_cast<double>(ringStats->bytesAllocated) / (1024.0 * 1024.0),
+							static_cast<double>(ringStats->capacityPerFrame) / (1024.0 * 1024.0), static_cast<double>(ringStats->bytesAllocatedPeak) / (1024.0 * 1024.0));
+						ImGui::Text("Allocations last frame: %u, overflows: %u", ringStats->allocationsCount, ringStats->overflowsCount);
+					}
+					else
+						ImGui::Text("Constant buffers are updated in place (no constant ring on this API)");
+				}
+				if (ImGui::CollapsingHeader("Descriptors"))
+				{
+					ER_RHI_DescriptorHeapStats heapStats;
+					if (mRHI->GetDescriptorStats(ER_RHI_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, heapStats))
+					{
+						auto showStats = [](const char* name, const ER_RHI_DescriptorAllocatorStats& stats) {
+							ImGui::Text("%s: %u / %u (peak: %u), largest free block: %u, fragmentation: %.1f%%", name,
+								stats.allocatedCount, stats.capacity, stats.allocatedCountPeak, stats.largestFreeBlock, stats.fragmentation * 100.0f);
+							if (stats.exhaustionsCount > 0 || stats.invalidFreesCount > 0)
+								ImGui::TextColored(ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "    failed allocations: %u, invalid frees: %u", stats.exhaustionsCount, stats.invalidFreesCount);
+						};
+						ImGui::Text("CBV/SRV/UAV");
+						showStats("CPU", heapStats.cpu);
+						showStats("GPU persistent (bindless)", heapStats.persistent);
+						showStats("GPU transient (ring)", heapStats.transient);
+						ImGui::Text("Tables allocated this frame so far: %u", heapStats.transient.allocationsCount);
+					}
+					else
+						ImGui::Text("Descriptors are managed by the API");
+				}
+				if (ImGui::CollapsingHeader("Command Lists"))
+				{
+					bool isParallelRecording = mRHI->IsParallelRecordingEnabled();
+					if (ImGui::Checkbox("Parallel recording", &isParallelRecording))
+						mRHI->SetParallelRecordingEnabled(isParallelRecording);
+					ImGui::Text("Recording contexts: %d", mRHI->GetParallelCommandContextsCount());
+
+					for (auto& section : mRHI->GetParallelCommandContextsStats())
+					{
+						const ER_RHI_ParallelCommandContextsStats& stats = section.second;
+						double recordingTimeMs = 0.0;
+						for (int i = 0; i < stats.contextsCount; i++)
+							recordingTimeMs += stats.recordingTimeMs[i];
+						ImGui::Text("%s: %.3f ms (recording: %.3f ms on %d contexts)", section.first.c_str(), stats.totalTimeMs, recordingTimeMs, stats.contextsCount);
+						for (int i = 0; i < stats.contextsCount; i++)
+							ImGui::Text("    context %d: %.3f ms", i, stats.recordingTimeMs[i]);
+					}
+				}
+				if (ImGui::CollapsingHeader("Async Compute"))
+				{
+					if (mRHI->IsAsyncComputeSupported())
+					{
+						bool isAsyncCompute = mRHI->IsAsyncComputeEnabled();
+						if (ImGui::Checkbox("Async compute", &isAsyncCompute))
+							mRHI->SetAsyncComputeEnabled(isAsyncCompute);
+					}
+					else
+						ImGui::Text("Async compute is not supported by the API");
+
+					const ER_RHI_AsyncComputeScheduler& scheduler = mRHI->GetAsyncComputeScheduler();
+					const ER_RHI_AsyncComputeStats& stats = scheduler.GetStats();
+					ImGui::Text("Jobs: %u (on the compute queue: %u)", stats.jobsCount, stats.asyncJobsCount);
+					ImGui::Text("Waits: graphics %u, compute %u", stats.graphicsWaitsCount, stats.computeWaitsCount);
+					ImGui::Text("Ownership transfers: released %u, acquired %u", stats.releasesCount, stats.acquiresCount);
+					for (const std::string& jobName : scheduler.GetJobNames())
+						ImGui::Text("    %s", jobName.c_str());
+				}
+				if (ImGui::CollapsingHeader("Memory"))
+				{
+					auto showArenaStats = [](const char* name, const ER_LinearArenaStats& stats) {
+						ImGui::Text("%s arena: %.1f / %.1f KB (peak: %.1f KB), allocations: %u, blocks: %u", name, static_cast<double>(stats.usedBytes) / 1024.0,
+							static_cast<double>(stats.capacityBytes) / 1024.0, static_cast<double>(stats.peakBytes) / 1024.0, static_cast<UINT>(stats.allocationsCount), static_cast<UINT>(stats.blocksCount));
+					};
+					showArenaStats("Main thread", mFrameArena.GetStats());
+					if (mCurrentSandbox)
+						showArenaStats("Simulation (worker thread)", mCurrentSandbox->GetFramePipeline().GetStats().workerArenaStats);
+
+#if ER_TRACK_ALLOCATIONS
+					const ER_AllocationStats total = ER_AllocationTracker::GetFrameTotalStats();
+					ImGui::Text("Heap allocations last frame: %llu (%.1f KB)", total.allocationsCount, static_cast<double>(total.bytes) / 1024.0);
+					for (int tag = 0; tag < ER_ALLOCATION_TAG_COUNT; tag++)
+					{
+						const ER_AllocationStats& stats = ER_AllocationTracker::GetFrameStats(static_cast<ER_AllocationTag>(tag));
+						const ImVec4 color = ER_AllocationTracker::IsOverFrameBudget(static_cast<ER_AllocationTag>(tag)) ? ImVec4(0.8f, 0.2f, 0.24f, 1.0f) : ImVec4(1.0f, 1.0f, 1.0f, 1.0f);
+						ImGui::TextColored(color, "    %s: %llu (%.1f KB)", ER_AllocationTracker::GetTagName(static_cast<ER_AllocationTag>(tag)), stats.allocationsCount, static_cast<double>(stats.bytes) / 1024.0);
+					}
+#else
+					ImGui::Text("Heap allocations are not tracked (ER_TRACK_ALLOCATIONS is disabled)");
+#endif
 				}
 				ImGui::End();
 			}
@@ -371,6 +501,7 @@ namespace EveryRay_Core
 			mCurrentSandbox->Destroy(*this);
 			DeleteObject(mCurrentSandbox);
 		}
+		DeleteObject(mTextureStreamer);
 
 		//destroy imgui
 		{
@@ -381,6 +512,7 @@ namespace EveryRay_Core
 		}
 
 		ER_Core::Shutdown();
+		ER_LinearArena::SetThreadArena(nullptr);
 	}
 	
 	void ER_RuntimeCore::Draw(const ER_CoreTime& gameTime)
@@ -403,7 +535,9 @@ namespace EveryRay_Core
 		mRHI->SetRasterizerState(ER_RHI_RASTERIZER_STATE::ER_NO_CULLING);
 		mRHI->SetBlendState(ER_RHI_BLEND_STATE::ER_NO_BLEND);
 
+		mRHI->GetAsyncComputeScheduler().BeginFrame(mRHI, mRHI->IsAsyncComputeEnabled());
 		mCurrentSandbox->Draw(*this, gameTime);
+		mRHI->GetAsyncComputeScheduler().EndFrame();
 
 		mRHI->TransitionMainRenderTargetToPresent();
 		mRHI->EndGraphicsCommandList();
@@ -412,75 +546,35 @@ namespace EveryRay_Core
 
 		auto endRenderTimer = std::chrono::high_resolution_clock::now();
 		mElapsedTimeRenderCPU = endRenderTimer - startRenderTimer;
+
+		// nothing allocated from the frame arena lives longer than the frame
+		mFrameArena.Reset();
+		ER_AllocationTracker::EndFrame();
 	}
 
 	ER_RHI_GPUTexture* ER_RuntimeCore::AddOrGetGPUTextureFromCache(const std::wstring& aFullPath, bool* didExist, bool is3D /*= false*/, bool skipFallback /*= false*/, bool* statusFlag /*= nullptr*/, bool isSilent /*= false*/)
 	{
-		const std::lock_guard<std::mutex> lock(renderingObjectsTextureCacheMutex);
-
-		auto it = mRenderingObjectsTextureCache.find(aFullPath);
-		if (it != mRenderingObjectsTextureCache.end())
-		{
-			if (didExist)
-				*didExist = true;
-			return it->second;
-		}
-		else
-		{
-			if (didExist)
-				*didExist = false;
-
-			auto result = mRenderingObjectsTextureCache.emplace(aFullPath, mRHI->CreateGPUTexture(aFullPath));
-			result.first->second->CreateGPUTextureResource(mRHI, aFullPath, true, is3D, skipFallback, statusFlag, isSilent);
-			if (statusFlag && *statusFlag == false)
-			{
-				DeleteObject(result.first->second);
-				mRenderingObjectsTextureCache.erase(aFullPath);
-				return nullptr;
-			}
-			else
-			{
-				std::wstring msg = L"[ER Logger][ER_Core] Added new texture to rendering objects' texture cache: " + aFullPath + L'\n';
-				ER_OUTPUT_LOG(msg.c_str());
-
-				return result.first->second;
-			}
-		}
-
-		return nullptr;
+		return mTextureStreamer->AddOrGetTexture(aFullPath, didExist, is3D, skipFallback, statusFlag, isSilent);
 	}
 
 	void ER_RuntimeCore::AddGPUTextureToCache(const std::wstring& aFullPath, ER_RHI_GPUTexture* aTexture)
 	{
-		mRenderingObjectsTextureCache.emplace(aFullPath, aTexture);
+		mTextureStreamer->AddTexture(aFullPath, aTexture);
 	}
 
 	bool ER_RuntimeCore::RemoveGPUTextureFromCache(const std::wstring& aFullPath, bool removeKey)
 	{
-		auto it = mRenderingObjectsTextureCache.find(aFullPath);
-		if (it != mRenderingObjectsTextureCache.end())
-		{
-			DeleteObject(it->second);
-			if (removeKey)
-				mRenderingObjectsTextureCache.erase(it->first);
-
-			return true;
-		}
-		else
-			return false;
+		return mTextureStreamer->RemoveTexture(aFullPath, removeKey);
 	}
 
 	void ER_RuntimeCore::ReplaceGPUTextureFromCache(const std::wstring& aFullPath, ER_RHI_GPUTexture* aTex)
 	{
-		auto it = mRenderingObjectsTextureCache.find(aFullPath);
-		if (it != mRenderingObjectsTextureCache.end())
-			it->second = aTex;
+		mTextureStreamer->ReplaceTexture(aFullPath, aTex);
 	}
 
 	bool ER_RuntimeCore::IsGPUTextureInCache(const std::wstring& aFullPath)
 	{
-		auto it = mRenderingObjectsTextureCache.find(aFullPath);
-		return (it != mRenderingObjectsTextureCache.end());
+		return mTextureStreamer->IsTextureInCache(aFullPath);
 	}
 
 }
@@ -3,6 +3,7 @@
 
 #include "ER_Core.h"
 #include "Common.h"
+#include "ER_LinearArena.h"
 
 namespace EveryRay_Core
 {
@@ -12,6 +13,7 @@ namespace EveryRay_Core
 	class ER_CameraFPS;
 	class ER_Editor;
 	class ER_QuadRenderer;
+	class ER_TextureStreamer;
 	
 	enum GraphicsQualityPreset
 	{
@@ -54,14 +56,14 @@ namespace EveryRay_Core
 		ER_CameraFPS* mCamera = nullptr;
 		ER_Editor* mEditor = nullptr;
 		ER_QuadRenderer* mQuadRenderer = nullptr;
+		ER_TextureStreamer* mTextureStreamer = nullptr; // also owns the cache of physical textures (on disk) from ER_RenderingObjects in the level
 
 		ER_RHI_Viewport mMainViewport;
+		ER_LinearArena mFrameArena; // temporary allocations of the main thread, reset at the end of Draw()
 
 		std::chrono::duration<double> mElapsedTimeUpdateCPU;
 		std::chrono::duration<double> mElapsedTimeRenderCPU;
 
-		std::map<std::wstring, ER_RHI_GPUTexture*> mRenderingObjectsTextureCache; // all physical textures (on disk) from ER_RenderingObjects in the level
-
 		std::map<std::string, std::string> mScenesPaths;
 		std::vector<std::string> mScenesNamesByIndices;
 		char* mDisplayedLevelNames[MAX_SCENES_COUNT] = { 0 };
@@ -22,6 +22,7 @@
 #include "ER_Illumination.h"
 #include "ER_LightProbesManager.h"
 #include "ER_GPUCuller.h"
+#include "ER_AllocationTracker.h"
 
 #include "RHI/ER_RHI.h"
 
@@ -38,6 +39,8 @@ namespace EveryRay_Core {
 	{
 		game.CPUProfiler()->BeginCPUTime("Destroying scene: " + mName);
 
+		mFramePipeline.Wait(); // worker thread might still simulate the objects
+
 		ER_RHI* rhi = game.GetRHI();
 		rhi->WaitForGpuOnGraphicsFence();
 
@@ -54,12 +57,17 @@ namespace EveryRay_Core {
 		DeleteObject(mLightProbesManager);
 		DeleteObject(mTerrain);
 		DeleteObject(mGPUCuller);
+		DeleteObject(mOcclusionCuller);
 		game.CPUProfiler()->EndCPUTime("Destroying scene: " + mName);
 	}
 
     void ER_Sandbox::Initialize(ER_Core& game, ER_Camera& camera, const std::string& sceneName, const std::string& sceneFolderPath)
     {
 		mName = sceneName;
+		mCamera = &camera;
+		mWorkerPool = game.GetWorkerPool();
+		assert(mWorkerPool);
+		mFramePipeline.SetWorkerPool(mWorkerPool);
 
 		ER_RHI* rhi = game.GetRHI();
 		assert(rhi);
@@ -78,13 +86,13 @@ namespace EveryRay_Core {
 #pragma endregion
 
 		#pragma region INIT_EDITOR
-		mEditor = (ER_Editor*)game.GetServices().FindService(ER_Editor::TypeIdClass());
+		mEditor = game.GetServices().FindService<ER_Editor>();
 		assert(mEditor);
 		mEditor->LoadScene(mScene);
 #pragma endregion
 
 		#pragma region INIT_QUAD_RENDERER
-		mQuadRenderer = (ER_QuadRenderer*)game.GetServices().FindService(ER_QuadRenderer::TypeIdClass());
+		mQuadRenderer = game.GetServices().FindService<ER_QuadRenderer>();
 		assert(mQuadRenderer);
 		mQuadRenderer->Setup();
 #pragma endregion
@@ -97,7 +105,7 @@ namespace EveryRay_Core {
 #pragma endregion
 
 		#pragma region INIT_CONTROLS
-        mKeyboard = (ER_Keyboard*)game.GetServices().FindService(ER_Keyboard::TypeIdClass());
+        mKeyboard = game.GetServices().FindService<ER_Keyboard>();
         assert(mKeyboard);
 #pragma endregion
 
@@ -130,7 +138,7 @@ namespace EveryRay_Core {
 		#pragma region INIT_SHADOWMAPPER
 		game.CPUProfiler()->BeginCPUTime("Shadow mapper init");
         mShadowMapper = new ER_ShadowMapper(game, camera, *mDirectionalLight, (ShadowQuality)ER_Settings::ShadowsQuality);
-        mDirectionalLight->RotationUpdateEvent->AddListener("shadow mapper", [&]() { mShadowMapper->ApplyTransform(); });
+        mDirectionalLight->RotationUpdateEvent->Subscribe("shadow mapper", [&]() { mShadowMapper->ApplyTransform(); });
 		game.CPUProfiler()->EndCPUTime("Shadow mapper init");
 #pragma endregion
 
@@ -192,7 +200,7 @@ namespace EveryRay_Core {
 		{
 			game.CPUProfiler()->BeginCPUTime("Foliage init");
 			mFoliageSystem = new ER_FoliageManager(game, mScene, *mDirectionalLight, (FoliageQuality)ER_Settings::FoliageQuality);
-			mFoliageSystem->FoliageSystemInitializedEvent->AddListener("foliage initialized for GI", [&]() { mIllumination->SetFoliageSystemForGI(mFoliageSystem); });
+			mFoliageSystem->FoliageSystemInitializedEvent->Subscribe("foliage initialized for GI", [&]() { mIllumination->SetFoliageSystemForGI(mFoliageSystem); });
 			mFoliageSystem->Initialize();
 			game.CPUProfiler()->EndCPUTime("Foliage init");
 		}
@@ -203,6 +211,8 @@ namespace EveryRay_Core {
 		mGPUCuller = new ER_GPUCuller(game, camera);
 		mGPUCuller->Initialize();
 		game.CPUProfiler()->EndCPUTime("GPU Culler init");
+
+		mOcclusionCuller = new ER_CPUOcclusionCuller();
 #pragma endregion
 
 
@@ -222,7 +232,7 @@ namespace EveryRay_Core {
 				// assign prepare callbacks to standard materials (non-standard ones are processed from their own systems)
 				if (layeredMaterial.second->IsStandard())
 				{
-					object.second->MeshMaterialVariablesUpdateEvent->AddListener(layeredMaterial.first,
+					object.second->MeshMaterialVariablesUpdateEvent->Subscribe(layeredMaterial.first,
 						[&, matSystems = materialSystems](int meshIndex, int lodIndex) { 
 							layeredMaterial.second->PrepareResourcesForStandardMaterial(matSystems, object.second, meshIndex, mScene->GetStandardMaterialRootSignature(layeredMaterial.first));
 						}
@@ -242,14 +252,41 @@ namespace EveryRay_Core {
 
 		if (mTerrain)
 		{
-			for (auto listener : mTerrain->ReadbackPlacedPositionsOnInitEvent->GetListeners())
-				listener(mTerrain);
-			mTerrain->ReadbackPlacedPositionsOnInitEvent->RemoveAllListeners();
+			mTerrain->ReadbackPlacedPositionsOnInitEvent->Notify(mTerrain);
+			mTerrain->ReadbackPlacedPositionsOnInitEvent->UnsubscribeAll();
 		}
     }
 
 	void ER_Sandbox::Update(ER_Core& game, const ER_CoreTime& gameTime)
 	{
+		ER_Camera* camera = mCamera;
+		assert(camera);
+		auto getSimulationCamera = [camera]()
+		{
+			ER_RenderingObjectSimulationCamera simulationCamera;
+			const ER_Frustum frustum = camera->GetFrustum();
+			for (int i = 0; i < 6; i++)
+				simulationCamera.frustumPlanes[i] = frustum.Planes()[i];
+			simulationCamera.position = camera->Position();
+			XMStoreFloat4x4(&simulationCamera.viewProjection, camera->ViewProjectionMatrix());
+			for (int i = 0; i < MAX_LOD; i++)
+				simulationCamera.lodDistances[i] = ER_Utility::DistancesLOD[i];
+			simulationCamera.isFrustumCulling = ER_Utility::IsMainCameraCPUFrustumCulling;
+			simulationCamera.isOcclusionCulling = ER_Utility::IsMainCameraCPUOcclusionCulling;
+			return simulationCamera;
+		};
+
+		// objects were simulated while the previous frame was recorded (see ER_FramePipeline), otherwise they are simulated now
+		const ER_RenderingObjectSimulationCamera currentCamera = getSimulationCamera();
+		mFramePipeline.Publish([this, currentCamera]() { Simulate(currentCamera); });
+		mOccludedCount = 0;
+		for (auto& object : mScene->objects)
+		{
+			object.second->PublishSimulatedState();
+			mOccludedCount += object.second->GetOccludedCount();
+		}
+		mOcclusionCullerStats = mOcclusionCuller->GetStats();
+
 		//TODO refactor to updates for elements of ER_CoreComponent type
 
 		//TODO refactor skybox updates
@@ -267,20 +304,98 @@ namespace EveryRay_Core {
 		mVolumetricFog->Update(gameTime);
 		if (mTerrain && mScene->HasTerrain())
 			mTerrain->Update(gameTime);
-		mIllumination->Update(gameTime, mScene);
+		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_ILLUMINATION);
+			mIllumination->Update(gameTime, mScene);
+		}
 		if (mScene->HasLightProbesSupport() && mLightProbesManager->IsEnabled())
+		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_LIGHT_PROBES);
 			mLightProbesManager->UpdateProbes(game);
-		mShadowMapper->Update(gameTime);
+		}
+		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_SHADOWS);
+			mShadowMapper->Update(gameTime);
+		}
 		if (mFoliageSystem && mScene->HasFoliage())
 			mFoliageSystem->Update(gameTime, mWindGustDistance, mWindStrength, mWindFrequency);
 		mDirectionalLight->UpdateProxyModel(gameTime, 
-			((ER_Camera*)game.GetServices().FindService(ER_Camera::TypeIdClass()))->ViewMatrix4X4(),
-			((ER_Camera*)game.GetServices().FindService(ER_Camera::TypeIdClass()))->ProjectionMatrix4X4()); //TODO refactor to DebugRenderer
+			mCamera->ViewMatrix4X4(), mCamera->ProjectionMatrix4X4()); //TODO refactor to DebugRenderer
 
-		for (auto& object : mScene->objects)
-			object.second->Update(gameTime);
+		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_RENDERING_OBJECTS);
+			for (auto& object : mScene->objects)
+				object.second->Update(gameTime);
+		}
 
-        UpdateImGui();
+		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_UI);
+			UpdateImGui();
+		}
+
+		// the simulation of the next frame runs on the worker thread while this frame is recorded (objects must not be changed until the next Publish())
+		const ER_RenderingObjectSimulationCamera nextCamera = getSimulationCamera();
+		mFramePipeline.Kick([this, nextCamera]() { Simulate(nextCamera); });
+	}
+
+	void ER_Sandbox::Simulate(const ER_RenderingObjectSimulationCamera& aCamera)
+	{
+		ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_SIMULATION);
+		const int maxThreads = mWorkerPool->GetWorkersCount() + 1; // + calling thread
+
+		// occluders are rasterized first, then every object is tested against the hierarchical-Z
+		const ER_CPUOcclusionCuller* occlusionCuller = nullptr;
+		if (aCamera.isOcclusionCulling)
+		{
+			mOcclusionCuller->BeginFrame(XMLoadFloat4x4(&aCamera.viewProjection));
+			for (auto& object : mScene->objects)
+			{
+				if (object.second->IsRendered())
+					object.second->RasterizeOccluder(*mOcclusionCuller);
+			}
+			mOcclusionCuller->Rasterize(mWorkerPool);
+			occlusionCuller = mOcclusionCuller;
+		}
+		else
+			mOcclusionCuller->BeginFrame(XMMatrixIdentity()); // resets the stats
+
+		// objects only write to their own simulated state, so contiguous ranges of objects are simulated in parallel
+		const int objectsCount = static_cast<int>(mScene->objects.size());
+		UINT64 instancesCount = 0;
+		for (const auto& object : mScene->objects)
+			instancesCount += std::max(object.second->GetInstanceCount(), 1u);
+
+		const int numThreads = std::max(1, std::min(maxThreads, static_cast<int>(instancesCount / ER_SIMULATION_MIN_INSTANCES_PER_THREAD)));
+		if (numThreads == 1)
+		{
+			for (auto& object : mScene->objects)
+				object.second->Simulate(aCamera, occlusionCuller);
+		}
+		else
+		{
+			std::vector<std::pair<int, int>> ranges; // [begin; end) of objects with roughly the same instances count
+			ranges.reserve(numThreads);
+
+			const UINT64 instancesPerThread = instancesCount / numThreads;
+			UINT64 rangeInstancesCount = 0;
+			int rangeBegin = 0;
+			for (int i = 0; i < objectsCount; i++)
+			{
+				rangeInstancesCount += std::max(mScene->objects[i].second->GetInstanceCount(), 1u);
+				if (rangeInstancesCount >= instancesPerThread || i == objectsCount - 1)
+				{
+					ranges.emplace_back(rangeBegin, i + 1);
+					rangeBegin = i + 1;
+					rangeInstancesCount = 0;
+				}
+			}
+			mWorkerPool->ParallelFor(static_cast<int>(ranges.size()), [this, &ranges, &aCamera, occlusionCuller](int aRange)
+			{
+				ER_AllocationScope threadAllocationScope(ER_ALLOCATION_TAG_SIMULATION);
+				for (int objectIndex = ranges[aRange].first; objectIndex < ranges[aRange].second; objectIndex++)
+					mScene->objects[objectIndex].second->Simulate(aCamera, occlusionCuller);
+			});
+		}
 	}
 
     void ER_Sandbox::UpdateImGui()
@@ -308,6 +423,9 @@ namespace EveryRay_Core {
 		if (ImGui::Button("Terrain") && mTerrain)
 			mTerrain->Config();
 
+		if (ImGui::Button("Shadow Mapper") && mShadowMapper)
+			mShadowMapper->Config();
+
 		//TODO remove from here
 		if (ImGui::CollapsingHeader("Wind"))
 		{
@@ -316,7 +434,6 @@ namespace EveryRay_Core {
 			ImGui::SliderFloat("Wind frequency", &mWindFrequency, 0.0f, 100.0f);
 		}
 
-		//TODO shadow mapper config
 		//TODO skybox config
 
         ImGui::End();
@@ -329,19 +446,20 @@ namespace EveryRay_Core {
 		
 		#pragma region GPU_CULLING
 		rhi->BeginEventTag("EveryRay: GPU Culling");
-		mGPUCuller->PerformCull(mScene);
+		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_GPU_CULLING);
+			mGPUCuller->PerformCull(mScene);
+		}
 		rhi->EndEventTag();
 #pragma endregion
 
 		#pragma region DRAW_GBUFFER
 		rhi->BeginEventTag("EveryRay: GBuffer");
 		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_GBUFFER);
 			mGBuffer->Start();
 
-			rhi->BeginEventTag("EveryRay: GBuffer (objects)");
-			mGBuffer->Draw(mScene);
-			rhi->EndEventTag();
-
+			// terrain and foliage do not depend on the GPU culling, so they overlap it on the graphics queue (when async compute is enabled)
 			rhi->BeginEventTag("EveryRay: GBuffer (terrain)");
 			if (mTerrain)
 			{
@@ -358,6 +476,11 @@ namespace EveryRay_Core {
 			}
 			rhi->EndEventTag();
 
+			rhi->BeginEventTag("EveryRay: GBuffer (objects)");
+			mGPUCuller->AcquireCullingResults(mScene);
+			mGBuffer->Draw(mScene);
+			rhi->EndEventTag();
+
 			mGBuffer->End();
 		}
 		rhi->EndEventTag();
@@ -366,14 +489,26 @@ namespace EveryRay_Core {
 		#pragma region DRAW_SHADOWS
 		rhi->BeginEventTag("EveryRay: Shadow Maps");
 		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_SHADOWS);
 			mShadowMapper->Draw(mScene, mTerrain);
 		}
 		rhi->EndEventTag();
 #pragma endregion
-		
+
+		// async compute jobs are submitted as soon as their inputs are ready, so that they overlap the rest of the frame
+		#pragma region DRAW_VOLUMETRIC_FOG
+		rhi->BeginEventTag("EveryRay: Volumetric Fog");
+		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_VOLUMETRICS);
+			mVolumetricFog->Draw();
+		}
+		rhi->EndEventTag();
+#pragma endregion
+
 		#pragma region DRAW_GLOBAL_ILLUMINATION
 		rhi->BeginEventTag("EveryRay: Compute/load light probes");
 		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_LIGHT_PROBES);
 			// compute static GI (load probes if they exist on disk, otherwise - compute them)
 			{
 				if (mScene->HasLightProbesSupport() && !mLightProbesManager->AreProbesReady())
@@ -392,6 +527,7 @@ namespace EveryRay_Core {
 		// compute dynamic GI
 		rhi->BeginEventTag("EveryRay: Dynamic Global Illumination");
 		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_ILLUMINATION);
 			mIllumination->DrawDynamicGlobalIllumination(mGBuffer, gameTime);
 		}
 		rhi->EndEventTag();
@@ -400,6 +536,7 @@ namespace EveryRay_Core {
 		#pragma region DRAW_LOCAL_ILLUMINATION
 		rhi->BeginEventTag("EveryRay: Local Illumination");
 		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_ILLUMINATION);
 			mIllumination->DrawLocalIllumination(mGBuffer, mSkybox);
 			ER_RHI_GPUTexture* localRT = mIllumination->GetLocalIlluminationRT();
 
@@ -444,33 +581,30 @@ namespace EveryRay_Core {
 		}
 #pragma endregion
 		
-		// combine the results of local and global illumination
-		rhi->BeginEventTag("EveryRay: Composite Illumination");
-		{
-			mIllumination->CompositeTotalIllumination();
-		}
-		rhi->EndEventTag();
-
-		#pragma region DRAW_VOLUMETRIC_FOG
-		rhi->BeginEventTag("EveryRay: Volumetric Fog");
+		#pragma region DRAW_VOLUMETRIC_CLOUDS
+		rhi->BeginEventTag("EveryRay: Volumetric Clouds");
 		{
-			mVolumetricFog->Draw();
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_VOLUMETRICS);
+			mVolumetricClouds->Draw(gameTime);
 		}
 		rhi->EndEventTag();
 #pragma endregion
 
-		#pragma region DRAW_VOLUMETRIC_CLOUDS
-		rhi->BeginEventTag("EveryRay: Volumetric Clouds");
+		// combine the results of local and global illumination
+		rhi->BeginEventTag("EveryRay: Composite Illumination");
 		{
-			mVolumetricClouds->Draw(gameTime);
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_ILLUMINATION);
+			mIllumination->CompositeTotalIllumination();
 		}
 		rhi->EndEventTag();
-#pragma endregion	
 
 		#pragma region DRAW_POSTPROCESSING
 		rhi->BeginEventTag("EveryRay: Post Processing");
 		{
-			auto quad = (ER_QuadRenderer*)game.GetServices().FindService(ER_QuadRenderer::TypeIdClass());
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_POST_PROCESSING);
+			auto quad = game.GetServices().FindService<ER_QuadRenderer>();
+			mVolumetricFog->AcquireResults();
+			mVolumetricClouds->AcquireResults();
 			mPostProcessingStack->Begin(mIllumination->GetFinalIlluminationRT(), mGBuffer->GetDepth());
 			mPostProcessingStack->DrawEffects(gameTime, quad, mGBuffer, mVolumetricClouds, mVolumetricFog);
 			mPostProcessingStack->End();
@@ -484,6 +618,7 @@ namespace EveryRay_Core {
 		#pragma region DRAW_IMGUI
 		rhi->BeginEventTag("EveryRay: ImGui");
 		{
+			ER_AllocationScope allocationScope(ER_ALLOCATION_TAG_UI);
 			rhi->SetGPUDescriptorHeapImGui(rhi->GetCurrentGraphicsCommandListIndex());
 
 			ImGui::Render();
@@ -1,5 +1,9 @@
 #pragma once
 #include "Common.h"
+#include "ER_FramePipeline.h"
+#include "ER_CPUOcclusionCuller.h"
+
+#define ER_SIMULATION_MIN_INSTANCES_PER_THREAD 1024 // Simulate() is split between threads only for bigger workloads
 
 namespace EveryRay_Core
 {
@@ -22,6 +26,8 @@ namespace EveryRay_Core
     class ER_PostProcessingStack;
     class ER_QuadRenderer;
     class ER_GPUCuller;
+    class ER_WorkerPool;
+    struct ER_RenderingObjectSimulationCamera;
 
 	class ER_Sandbox
 	{
@@ -34,6 +40,11 @@ namespace EveryRay_Core
 		virtual void Update(ER_Core& game, const ER_CoreTime& time);
 		virtual void Draw(ER_Core& game, const ER_CoreTime& time);
 
+		ER_FramePipeline& GetFramePipeline() { return mFramePipeline; }
+		// results of the simulation that was published in this frame
+		const ER_CPUOcclusionCullerStats& GetOcclusionCullerStats() const { return mOcclusionCullerStats; }
+		UINT GetOccludedCount() const { return mOccludedCount; }
+
         ER_Scene* mScene = nullptr;
 		ER_Editor* mEditor = nullptr;
         ER_Keyboard* mKeyboard = nullptr;
@@ -50,8 +61,16 @@ namespace EveryRay_Core
         ER_PostProcessingStack* mPostProcessingStack = nullptr;
         ER_QuadRenderer* mQuadRenderer = nullptr;
         ER_GPUCuller* mGPUCuller = nullptr;
+        ER_Camera* mCamera = nullptr; // resolved once in Initialize()
+        ER_CPUOcclusionCuller* mOcclusionCuller = nullptr; // used by the worker thread of mFramePipeline
+        ER_WorkerPool* mWorkerPool = nullptr; // resolved once in Initialize()
     private:
         void UpdateImGui();
+        void Simulate(const ER_RenderingObjectSimulationCamera& aCamera); // worker thread of mFramePipeline
+
+        ER_FramePipeline mFramePipeline;
+        ER_CPUOcclusionCullerStats mOcclusionCullerStats;
+        UINT mOccludedCount = 0;
         std::string mName;
 
         XMMATRIX mDefaultSunRotationMatrix;
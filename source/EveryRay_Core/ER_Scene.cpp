@@ -36,166 +36,161 @@ namespace EveryRay_Core
 
 		CreateStandardMaterialsRootSignatures();
 
-		Json::Reader reader;
-		std::ifstream scene(path.c_str(), std::ifstream::binary);
+		mSceneDocument.Load(path); // the only time we read and parse the scene file, all subsystems use this document afterwards
 
-		if (!reader.parse(scene, mSceneJsonRoot)) {
-			throw ER_CoreException(reader.getFormattedErrorMessages().c_str());
-		}
-		else {
-
-			if (mSceneJsonRoot.isMember("camera_position")) {
-				float vec3[3];
-				for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["camera_position"].size(); i++)
-					vec3[i] = mSceneJsonRoot["camera_position"][i].asFloat();
+		if (mSceneJsonRoot.isMember("camera_position")) {
+			float vec3[3];
+			for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["camera_position"].size(); i++)
+				vec3[i] = mSceneJsonRoot["camera_position"][i].asFloat();
 
-				mCameraPosition = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
-			}
+			mCameraPosition = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
+		}
 
-			if (mSceneJsonRoot.isMember("camera_direction")) {
-				float vec3[3];
-				for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["camera_direction"].size(); i++)
-					vec3[i] = mSceneJsonRoot["camera_direction"][i].asFloat();
+		if (mSceneJsonRoot.isMember("camera_direction")) {
+			float vec3[3];
+			for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["camera_direction"].size(); i++)
+				vec3[i] = mSceneJsonRoot["camera_direction"][i].asFloat();
 
-				mCameraDirection = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
-			}
+			mCameraDirection = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
+		}
 
-			if (mSceneJsonRoot.isMember("sun_direction")) {
-				float vec3[3] = { 0.0, 0.0, 0.0 };
-				for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["sun_direction"].size(); i++)
-					vec3[i] = mSceneJsonRoot["sun_direction"][i].asFloat();
+		if (mSceneJsonRoot.isMember("sun_direction")) {
+			float vec3[3] = { 0.0, 0.0, 0.0 };
+			for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["sun_direction"].size(); i++)
+				vec3[i] = mSceneJsonRoot["sun_direction"][i].asFloat();
 
-				mSunDirection = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
-			}
+			mSunDirection = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
+		}
 
-			if (mSceneJsonRoot.isMember("sun_color")) {
-				float vec3[3];
-				for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["sun_color"].size(); i++)
-					vec3[i] = mSceneJsonRoot["sun_color"][i].asFloat();
+		if (mSceneJsonRoot.isMember("sun_color")) {
+			float vec3[3];
+			for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["sun_color"].size(); i++)
+				vec3[i] = mSceneJsonRoot["sun_color"][i].asFloat();
 
-				mSunColor = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
-			}
+			mSunColor = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
+		}
 
-			// terrain config
-			{
-				if (mSceneJsonRoot.isMember("terrain_num_tiles")) {
-					mHasTerrain = true;
-					mTerrainTilesCount = mSceneJsonRoot["terrain_num_tiles"].asInt();
-					if (mSceneJsonRoot.isMember("terrain_tile_scale"))
-						mTerrainTileScale = mSceneJsonRoot["terrain_tile_scale"].asFloat();
-					if (mSceneJsonRoot.isMember("terrain_tile_resolution"))
-						mTerrainTileResolution = mSceneJsonRoot["terrain_tile_resolution"].asInt();
-					std::string fieldName = "terrain_texture_splat_layer";
-					std::wstring result = L"";
-
-					for (int i = 0; i < 4; i++)
-					{
-						fieldName += std::to_string(i);
-						if (mSceneJsonRoot.isMember(fieldName.c_str()))
-							result = ER_Utility::ToWideString(mSceneJsonRoot[fieldName.c_str()].asString());
-						else
-							result = L"";
-					
-						fieldName = "terrain_texture_splat_layer";
-						mTerrainSplatLayersTextureNames[i] = result;
-					}
+		// terrain config
+		{
+			if (mSceneJsonRoot.isMember("terrain_num_tiles")) {
+				mHasTerrain = true;
+				mTerrainTilesCount = mSceneJsonRoot["terrain_num_tiles"].asInt();
+				if (mSceneJsonRoot.isMember("terrain_tile_scale"))
+					mTerrainTileScale = mSceneJsonRoot["terrain_tile_scale"].asFloat();
+				if (mSceneJsonRoot.isMember("terrain_tile_resolution"))
+					mTerrainTileResolution = mSceneJsonRoot["terrain_tile_resolution"].asInt();
+				std::string fieldName = "terrain_texture_splat_layer";
+				std::wstring result = L"";
+
+				for (int i = 0; i < 4; i++)
+				{
+					fieldName += std::to_string(i);
+					if (mSceneJsonRoot.isMember(fieldName.c_str()))
+						result = ER_Utility::ToWideString(mSceneJsonRoot[fieldName.c_str()].asString());
+					else
+						result = L"";
+				
+					fieldName = "terrain_texture_splat_layer";
+					mTerrainSplatLayersTextureNames[i] = result;
 				}
-				else
-				mHasTerrain = false;
 			}
+			else
+			mHasTerrain = false;
+		}
 
-			// light probes config
-			{
-				if (mSceneJsonRoot.isMember("light_probes_volume_bounds_min")) {
-					float vec3[3];
-					for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["light_probes_volume_bounds_min"].size(); i++)
-						vec3[i] = mSceneJsonRoot["light_probes_volume_bounds_min"][i].asFloat();
+		// light probes config
+		{
+			if (mSceneJsonRoot.isMember("light_probes_volume_bounds_min")) {
+				float vec3[3];
+				for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["light_probes_volume_bounds_min"].size(); i++)
+					vec3[i] = mSceneJsonRoot["light_probes_volume_bounds_min"][i].asFloat();
 
-					mLightProbesVolumeMinBounds = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
-				}
-				else
-					mHasLightProbes = false;
+				mLightProbesVolumeMinBounds = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
+			}
+			else
+				mHasLightProbes = false;
 
-				if (mSceneJsonRoot.isMember("light_probes_volume_bounds_max")) {
-					float vec3[3];
-					for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["light_probes_volume_bounds_max"].size(); i++)
-						vec3[i] = mSceneJsonRoot["light_probes_volume_bounds_max"][i].asFloat();
+			if (mSceneJsonRoot.isMember("light_probes_volume_bounds_max")) {
+				float vec3[3];
+				for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["light_probes_volume_bounds_max"].size(); i++)
+					vec3[i] = mSceneJsonRoot["light_probes_volume_bounds_max"][i].asFloat();
 
-					mLightProbesVolumeMaxBounds = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
-				}
-				else
-					mHasLightProbes = false;
+				mLightProbesVolumeMaxBounds = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
+			}
+			else
+				mHasLightProbes = false;
 
-				if (mSceneJsonRoot.isMember("light_probes_diffuse_distance"))
-					mLightProbesDiffuseDistance = mSceneJsonRoot["light_probes_diffuse_distance"].asFloat();
-				if (mSceneJsonRoot.isMember("light_probes_specular_distance"))
-					mLightProbesSpecularDistance = mSceneJsonRoot["light_probes_specular_distance"].asFloat();
+			if (mSceneJsonRoot.isMember("light_probes_diffuse_distance"))
+				mLightProbesDiffuseDistance = mSceneJsonRoot["light_probes_diffuse_distance"].asFloat();
+			if (mSceneJsonRoot.isMember("light_probes_specular_distance"))
+				mLightProbesSpecularDistance = mSceneJsonRoot["light_probes_specular_distance"].asFloat();
+			if (mSceneJsonRoot.isMember("light_probes_sparse_grid"))
+				mIsLightProbesGridSparse = mSceneJsonRoot["light_probes_sparse_grid"].asBool();
 
-				if (mSceneJsonRoot.isMember("light_probe_global_cam_position")) {
-					float vec3[3];
-					for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["light_probe_global_cam_position"].size(); i++)
-						vec3[i] = mSceneJsonRoot["light_probe_global_cam_position"][i].asFloat();
+			if (mSceneJsonRoot.isMember("light_probe_global_cam_position")) {
+				float vec3[3];
+				for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["light_probe_global_cam_position"].size(); i++)
+					vec3[i] = mSceneJsonRoot["light_probe_global_cam_position"][i].asFloat();
 
-					mGlobalLightProbeCameraPos = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
-				}
+				mGlobalLightProbeCameraPos = XMFLOAT3(vec3[0], vec3[1], vec3[2]);
 			}
+		}
 
-			if (mSceneJsonRoot.isMember("foliage_zones"))
-				mHasFoliage = true;
+		if (mSceneJsonRoot.isMember("foliage_zones"))
+			mHasFoliage = true;
 
-			if (mSceneJsonRoot.isMember("use_volumetric_fog")) {
-				mHasVolumetricFog = mSceneJsonRoot["use_volumetric_fog"].asBool();
-			}
-			else
-				mHasVolumetricFog = false;
-
-			// add rendering objects to scene
-			unsigned int numRenderingObjects = mSceneJsonRoot["rendering_objects"].size();
-			for (Json::Value::ArrayIndex i = 0; i != numRenderingObjects; i++) {
-				objects.emplace_back(
-					mSceneJsonRoot["rendering_objects"][i]["name"].asString(), 
-					new ER_RenderingObject(mSceneJsonRoot["rendering_objects"][i]["name"].asString(), i, *mCore, mCamera, 
-						std::unique_ptr<ER_Model>(new ER_Model(*mCore, ER_Utility::GetFilePath(mSceneJsonRoot["rendering_objects"][i]["model_path"].asString()), true)),
-						true, mSceneJsonRoot["rendering_objects"][i]["instanced"].asBool())
-				);
-			}
-			std::partition(objects.begin(), objects.end(), [](const ER_SceneObject& obj) {	return obj.second->IsInstanced(); });
-			assert(numRenderingObjects == objects.size());
+		if (mSceneJsonRoot.isMember("use_volumetric_fog")) {
+			mHasVolumetricFog = mSceneJsonRoot["use_volumetric_fog"].asBool();
+		}
+		else
+			mHasVolumetricFog = false;
+
+		// add rendering objects to scene
+		unsigned int numRenderingObjects = mSceneJsonRoot["rendering_objects"].size();
+		for (Json::Value::ArrayIndex i = 0; i != numRenderingObjects; i++) {
+			objects.emplace_back(
+				mSceneJsonRoot["rendering_objects"][i]["name"].asString(), 
+				new ER_RenderingObject(mSceneJsonRoot["rendering_objects"][i]["name"].asString(), i, *mCore, mCamera, 
+					std::unique_ptr<ER_Model>(new ER_Model(*mCore, ER_Utility::GetFilePath(mSceneJsonRoot["rendering_objects"][i]["model_path"].asString()), true)),
+					true, mSceneJsonRoot["rendering_objects"][i]["instanced"].asBool())
+			);
+		}
+		std::partition(objects.begin(), objects.end(), [](const ER_SceneObject& obj) {	return obj.second->IsInstanced(); });
+		assert(numRenderingObjects == objects.size());
 
 #if MULTITHREADED_SCENE_LOAD && !ER_PLATFORM_WIN64_DX12
-			int numThreads = std::thread::hardware_concurrency();
+		int numThreads = std::thread::hardware_concurrency();
 #else
-			int numThreads = 1;
+		int numThreads = 1;
 #endif
-			int objectsPerThread = numRenderingObjects / numThreads;
-			if (objectsPerThread == 0)
-			{
-				numThreads = 1;
-				objectsPerThread = numRenderingObjects;
-			}
+		int objectsPerThread = numRenderingObjects / numThreads;
+		if (objectsPerThread == 0)
+		{
+			numThreads = 1;
+			objectsPerThread = numRenderingObjects;
+		}
 
-			std::vector<std::thread> threads;
-			threads.reserve(numThreads);
+		std::vector<std::thread> threads;
+		threads.reserve(numThreads);
 
-			for (int i = 0; i < numThreads; i++)
+		for (int i = 0; i < numThreads; i++)
+		{
+			threads.push_back(std::thread([&, numThreads, numRenderingObjects, objectsPerThread, i]
 			{
-				threads.push_back(std::thread([&, numThreads, numRenderingObjects, objectsPerThread, i]
-				{
-					int endRange = (i < numThreads - 1) ? (i + 1) * objectsPerThread : numRenderingObjects;
+				int endRange = (i < numThreads - 1) ? (i + 1) * objectsPerThread : numRenderingObjects;
 
-					for (int j = i * objectsPerThread; j < endRange; j++)
-					{
-						auto objectI = objects.begin();
-						std::advance(objectI, j);
-						LoadRenderingObjectData(objectI->second);
-					}
-				}));
-			}
-			for (auto& t : threads) t.join();
-
-			for (auto& obj : objects)
-				LoadRenderingObjectInstancedData(obj.second);
+				for (int j = i * objectsPerThread; j < endRange; j++)
+				{
+					auto objectI = objects.begin();
+					std::advance(objectI, j);
+					LoadRenderingObjectData(objectI->second);
+				}
+			}));
 		}
+		for (auto& t : threads) t.join();
+
+		for (auto& obj : objects)
+			LoadRenderingObjectInstancedData(obj.second);
 
 		{
 			std::wstring msg = L"[ER Logger][ER_Scene] Finished loading scene: " + ER_Utility::ToWideString(path) + L" Enjoy! \n";
@@ -207,7 +202,7 @@ namespace EveryRay_Core
 	{
 		for (auto& object : objects)
 		{
-			object.second->MeshMaterialVariablesUpdateEvent->RemoveAllListeners();
+			object.second->MeshMaterialVariablesUpdateEvent->UnsubscribeAll();
 			DeleteObject(object.second);
 		}
 		objects.clear();
@@ -316,6 +311,9 @@ namespace EveryRay_Core
 			if (mSceneJsonRoot["rendering_objects"][i].isMember("skip_indirect_specular"))
 				aObject->SetSkipIndirectSpecular(mSceneJsonRoot["rendering_objects"][i]["skip_indirect_specular"].asBool());
 
+			if (mSceneJsonRoot["rendering_objects"][i].isMember("dynamic_shadow_caster"))
+				aObject->SetDynamicShadowCaster(mSceneJsonRoot["rendering_objects"][i]["dynamic_shadow_caster"].asBool());
+
 			if (mSceneJsonRoot["rendering_objects"][i].isMember("index_of_refraction"))
 				aObject->SetIOR(mSceneJsonRoot["rendering_objects"][i]["index_of_refraction"].asFloat());
 
@@ -575,6 +573,32 @@ namespace EveryRay_Core
 					aObject->LoadLOD(std::unique_ptr<ER_Model>(new ER_Model(*mCore, ER_Utility::GetFilePath(path), true)));
 				}
 			}
+			else if (mSceneJsonRoot["rendering_objects"][i].isMember("generate_lods") && mSceneJsonRoot["rendering_objects"][i]["generate_lods"].asBool())
+			{
+				// simplified from LOD #0; optional "lod_triangle_ratios" (relative to LOD #0) for LOD #1, #2...
+				const Json::Value& ratios = mSceneJsonRoot["rendering_objects"][i]["lod_triangle_ratios"];
+				float triangleRatio = 1.0f;
+				for (int lod = 1; lod < MAX_LOD; lod++)
+				{
+					triangleRatio *= ER_LOD_TRIANGLE_RATIO;
+					if (ratios.isArray() && static_cast<Json::Value::ArrayIndex>(lod - 1) < ratios.size())
+						triangleRatio = ratios[lod - 1].asFloat();
+					aObject->LoadLOD(aObject->GetModel()->GenerateLOD(lod, triangleRatio));
+				}
+			}
+		}
+
+		// load occluder (for CPU occlusion culling): dedicated low-poly proxy or the last LOD of the object
+		if (mSceneJsonRoot["rendering_objects"][i].isMember("use_as_occluder") && mSceneJsonRoot["rendering_objects"][i]["use_as_occluder"].asBool())
+		{
+			if (mSceneJsonRoot["rendering_objects"][i].isMember("occluder_proxy_path"))
+			{
+				std::string path = mSceneJsonRoot["rendering_objects"][i]["occluder_proxy_path"].asString();
+				std::unique_ptr<ER_Model> proxyModel(new ER_Model(*mCore, ER_Utility::GetFilePath(path), true));
+				aObject->LoadOccluder(proxyModel.get());
+			}
+			else
+				aObject->LoadOccluder(nullptr);
 		}
 
 		std::wstring msg = L"[ER Logger][ER_Scene] Loaded rendering object into scene: " + ER_Utility::ToWideString(aObject->GetName()) + L'\n';
@@ -589,10 +613,10 @@ namespace EveryRay_Core
 		if (!isInstanced)
 			return;
 
-		bool hasLODs = mSceneJsonRoot["rendering_objects"][i].isMember("model_lods");
+		bool hasLODs = aObject->GetLODCount() > 1; // loaded from "model_lods" or generated
 		if (hasLODs)
 		{
-			for (int lod = 0; lod < mSceneJsonRoot["rendering_objects"][i]["model_lods"].size(); lod++)
+			for (int lod = 0; lod < aObject->GetLODCount(); lod++)
 			{
 				aObject->LoadInstanceBuffers(lod);
 				if (aObject->GetTerrainPlacement() && aObject->GetTerrainProceduralInstanceCount() > 0)
@@ -671,16 +695,11 @@ namespace EveryRay_Core
 				vec3[2] = foliageZones[iz]->GetDistributionCenter().z;
 				for (Json::Value::ArrayIndex i = 0; i < 3; i++)
 					content.append(vec3[i]);
-				mSceneJsonRoot["foliage_zones"][iz]["position"] = content;
+				mSceneDocument.ReplaceSection(mSceneJsonRoot["foliage_zones"][iz]["position"], content);
 			}
 		}
 
-		Json::StreamWriterBuilder builder;
-		std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
-
-		std::ofstream file_id;
-		file_id.open(mScenePath.c_str());
-		writer->write(mSceneJsonRoot, &file_id);
+		mSceneDocument.Save(); // only the changed sections are re-serialized
 	}
 
 	void ER_Scene::SaveRenderingObjectsTransforms()
@@ -702,7 +721,7 @@ namespace EveryRay_Core
 					ER_MatrixHelper::GetFloatArray(mat, matF);
 					for (int i = 0; i < 16; i++)
 						content.append(matF[i]);
-					mSceneJsonRoot["rendering_objects"][i]["transform"] = content;
+					mSceneDocument.ReplaceSection(mSceneJsonRoot["rendering_objects"][i]["transform"], content);
 				}
 			}
 			else
@@ -714,7 +733,7 @@ namespace EveryRay_Core
 
 				for (int i = 0; i < 16; i++)
 					content.append(matF[i]);
-				mSceneJsonRoot["rendering_objects"][i]["transform"] = content;
+				mSceneDocument.ReplaceSection(mSceneJsonRoot["rendering_objects"][i]["transform"], content);
 			}
 
 			if (mSceneJsonRoot["rendering_objects"][i].isMember("instanced")) 
@@ -739,19 +758,14 @@ namespace EveryRay_Core
 							for (int i = 0; i < 16; i++)
 								contentInstanceTransform.append(matF[i]);
 
-							mSceneJsonRoot["rendering_objects"][i]["instances_transforms"][instance]["transform"] = contentInstanceTransform;
+							mSceneDocument.ReplaceSection(mSceneJsonRoot["rendering_objects"][i]["instances_transforms"][instance]["transform"], contentInstanceTransform);
 						}
 					}
 				}
 			}
 		}
 
-		Json::StreamWriterBuilder builder;
-		std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
-
-		std::ofstream file_id;
-		file_id.open(mScenePath.c_str());
-		writer->write(mSceneJsonRoot, &file_id);
+		mSceneDocument.Save(); // only the changed sections are re-serialized
 	}
 
 	// We cant do reflection in C++, that is why we check every materials name and create a material out of it (and root-signature if needed)
@@ -788,46 +802,43 @@ namespace EveryRay_Core
 
 	void ER_Scene::LoadFoliageZones(std::vector<ER_Foliage*>& foliageZones, ER_DirectionalLight& light)
 	{
-		Json::Reader reader;
-		std::ifstream scene(mScenePath.c_str(), std::ifstream::binary);
 		ER_Core* core = GetCore();
 		assert(core);
 
-		if (!reader.parse(scene, mSceneJsonRoot)) {
-			throw ER_CoreException(reader.getFormattedErrorMessages().c_str());
-		}
-		else {
-			if (mSceneJsonRoot.isMember("foliage_zones")) {
-				for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["foliage_zones"].size(); i++)
-				{
-					float vec3[3];
-					for (Json::Value::ArrayIndex ia = 0; ia != mSceneJsonRoot["foliage_zones"][i]["position"].size(); ia++)
-						vec3[ia] = mSceneJsonRoot["foliage_zones"][i]["position"][ia].asFloat();
-
-					bool placedOnTerrain = false;
-					if (mSceneJsonRoot["foliage_zones"][i].isMember("placed_on_terrain"))
-						placedOnTerrain = mSceneJsonRoot["foliage_zones"][i]["placed_on_terrain"].asBool();
-					
-					TerrainSplatChannels terrainChannel = TerrainSplatChannels::NONE;
-					if (mSceneJsonRoot["foliage_zones"][i].isMember("placed_splat_channel"))
-						terrainChannel = (TerrainSplatChannels)(mSceneJsonRoot["foliage_zones"][i]["placed_splat_channel"].asInt());
-
-					float placedHeightDelta = 0.0f;
-					if (mSceneJsonRoot["foliage_zones"][i].isMember("placed_height_delta"))
-						placedHeightDelta = mSceneJsonRoot["foliage_zones"][i]["placed_height_delta"].asFloat();
-
-					foliageZones.push_back(new ER_Foliage(*core, mCamera, light,
-						mSceneJsonRoot["foliage_zones"][i]["patch_count"].asInt(),
-						ER_Utility::GetFilePath(mSceneJsonRoot["foliage_zones"][i]["texture_path"].asString()),
-						mSceneJsonRoot["foliage_zones"][i]["average_scale"].asFloat(),
-						mSceneJsonRoot["foliage_zones"][i]["distribution_radius"].asFloat(),
-						XMFLOAT3(vec3[0], vec3[1], vec3[2]),
-						(FoliageBillboardType)mSceneJsonRoot["foliage_zones"][i]["type"].asInt(), placedOnTerrain, terrainChannel, placedHeightDelta));
-				}
+		if (mSceneJsonRoot.isMember("foliage_zones")) {
+			for (Json::Value::ArrayIndex i = 0; i != mSceneJsonRoot["foliage_zones"].size(); i++)
+			{
+				float vec3[3];
+				for (Json::Value::ArrayIndex ia = 0; ia != mSceneJsonRoot["foliage_zones"][i]["position"].size(); ia++)
+					vec3[ia] = mSceneJsonRoot["foliage_zones"][i]["position"][ia].asFloat();
+
+				bool placedOnTerrain = false;
+				if (mSceneJsonRoot["foliage_zones"][i].isMember("placed_on_terrain"))
+					placedOnTerrain = mSceneJsonRoot["foliage_zones"][i]["placed_on_terrain"].asBool();
+				
+				TerrainSplatChannels terrainChannel = TerrainSplatChannels::NONE;
+				if (mSceneJsonRoot["foliage_zones"][i].isMember("placed_splat_channel"))
+					terrainChannel = (TerrainSplatChannels)(mSceneJsonRoot["foliage_zones"][i]["placed_splat_channel"].asInt());
+
+				float placedHeightDelta = 0.0f;
+				if (mSceneJsonRoot["foliage_zones"][i].isMember("placed_height_delta"))
+					placedHeightDelta = mSceneJsonRoot["foliage_zones"][i]["placed_height_delta"].asFloat();
+
+				bool quantizedVertices = false;
+				if (mSceneJsonRoot["foliage_zones"][i].isMember("quantized_vertices"))
+					quantizedVertices = mSceneJsonRoot["foliage_zones"][i]["quantized_vertices"].asBool();
+
+				foliageZones.push_back(new ER_Foliage(*core, mCamera, light,
+					mSceneJsonRoot["foliage_zones"][i]["patch_count"].asInt(),
+					ER_Utility::GetFilePath(mSceneJsonRoot["foliage_zones"][i]["texture_path"].asString()),
+					mSceneJsonRoot["foliage_zones"][i]["average_scale"].asFloat(),
+					mSceneJsonRoot["foliage_zones"][i]["distribution_radius"].asFloat(),
+					XMFLOAT3(vec3[0], vec3[1], vec3[2]),
+					(FoliageBillboardType)mSceneJsonRoot["foliage_zones"][i]["type"].asInt(), placedOnTerrain, terrainChannel, placedHeightDelta, quantizedVertices));
 			}
-			else
-				mHasFoliage = false;
 		}
+		else
+			mHasFoliage = false;
 	}
 
 	ER_RHI_GPURootSignature* ER_Scene::GetStandardMaterialRootSignature(const std::string& materialName)
@@ -4,6 +4,7 @@
 #include "ER_Camera.h"
 #include "ER_ModelMaterial.h"
 #include "ER_Material.h"
+#include "ER_SceneDocument.h"
 
 #include "..\JsonCpp\include\json\json.h"
 
@@ -39,6 +40,7 @@ namespace EveryRay_Core
 		const XMFLOAT3& GetLightProbesVolumeMaxBounds() const { return mLightProbesVolumeMaxBounds; }
 		float GetLightProbesDiffuseDistance() { return mLightProbesDiffuseDistance; }
 		float GetLightProbesSpecularDistance() { return mLightProbesSpecularDistance; }
+		bool IsLightProbesGridSparse() { return mIsLightProbesGridSparse; }
 		const XMFLOAT3& GetGlobalLightProbeCameraPos() { return mGlobalLightProbeCameraPos; }
 
 		bool HasFoliage() { return mHasFoliage; }
@@ -52,6 +54,8 @@ namespace EveryRay_Core
 		const std::wstring& GetTerrainSplatLayerTextureName(int index) { return mTerrainSplatLayersTextureNames[index]; }
 
 		bool HasVolumetricFog() { return mHasVolumetricFog; }
+
+		ER_SceneDocument& GetSceneDocument() { return mSceneDocument; }
 	private:
 		void CreateStandardMaterialsRootSignatures();
 		void LoadRenderingObjectData(ER_RenderingObject* aObject);
@@ -66,7 +70,8 @@ namespace EveryRay_Core
 		XMFLOAT3 mSunDirection; //in degrees
 		XMFLOAT3 mSunColor;
 
-		Json::Value mSceneJsonRoot;
+		ER_SceneDocument mSceneDocument; // parsed once, shared by all subsystems
+		Json::Value& mSceneJsonRoot = mSceneDocument.GetRoot();
 		std::string mScenePath;
 		
 		bool mHasVolumetricFog = false;
@@ -83,6 +88,7 @@ namespace EveryRay_Core
 		XMFLOAT3 mLightProbesVolumeMaxBounds = { 0,0,0 };
 		float mLightProbesDiffuseDistance = -1.0f;
 		float mLightProbesSpecularDistance = -1.0f;
+		bool mIsLightProbesGridSparse = false; // skip probes inside solid geometry or outside of the level (rendering objects used in probes)
 		XMFLOAT3 mGlobalLightProbeCameraPos = { 0,0,0 };
 	};
 }
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "stdafx.h"
+#include <algorithm>
+
+#include "ER_SceneDocument.h"
+#include "ER_CoreException.h"
+#include "ER_Utility.h"
+
+namespace EveryRay_Core
+{
+	ER_SceneDocument::ER_SceneDocument()
+	{
+	}
+
+	ER_SceneDocument::~ER_SceneDocument()
+	{
+		mDirtySections.clear();
+		mSplicedSections.clear();
+	}
+
+	void ER_SceneDocument::Load(const std::string& path)
+	{
+		mPath = path;
+
+		std::ifstream file(path.c_str(), std::ifstream::binary);
+		if (!file.is_open())
+		{
+			std::string message = "Could not open scene file: " + path;
+			throw ER_CoreException(message.c_str());
+		}
+
+		file.seekg(0, std::ios::end);
+		mText.resize(static_cast<size_t>(file.tellg()));
+		file.seekg(0, std::ios::beg);
+		if (!mText.empty())
+			file.read(&mText[0], mText.size());
+		file.close();
+
+		Parse();
+	}
+
+	void ER_SceneDocument::Parse()
+	{
+		mDirtySections.clear();
+		mSplicedSections.clear();
+		mNeedsFullRewrite = false;
+
+		Json::Reader reader;
+		const char* begin = mText.data();
+		if (!reader.parse(begin, begin + mText.size(), mRoot))
+			throw ER_CoreException(reader.getFormattedErrorMessages().c_str());
+	}
+
+	void ER_SceneDocument::ReplaceSection(Json::Value& section, const Json::Value& newValue)
+	{
+		if (section == newValue)
+			return;
+
+		// assignment resets the offsets, but we still need them to find the section in the text
+		const ptrdiff_t start = section.getOffsetStart();
+		const ptrdiff_t limit = section.getOffsetLimit();
+		section = newValue;
+		section.setOffsetStart(start);
+		section.setOffsetLimit(limit);
+
+		if (limit <= start)
+		{
+			mNeedsFullRewrite = true;
+			return;
+		}
+
+		if (std::find(mDirtySections.begin(), mDirtySections.end(), &section) == mDirtySections.end())
+			mDirtySections.push_back(&section);
+	}
+
+	void ER_SceneDocument::Save()
+	{
+		if (mPath.empty())
+			throw ER_CoreException("Can't save to scene json file! Empty scene name...");
+
+		if (mNeedsFullRewrite)
+		{
+			Json::StreamWriterBuilder builder;
+			mText = Json::writeString(builder, mRoot);
+			WriteAtomically(mText);
+			Parse(); // refresh the offsets from the new text (no disk read)
+
+			std::wstring msg = L"[ER Logger][ER_SceneDocument] Rewrote the whole scene file (new sections were added): " + ER_Utility::ToWideString(mPath) + L'\n';
+			ER_OUTPUT_LOG(msg.c_str());
+			return;
+		}
+
+		if (mDirtySections.empty())
+			return;
+
+		std::sort(mDirtySections.begin(), mDirtySections.end(), [](const Json::Value* a, const Json::Value* b) {
+			return a->getOffsetStart() < b->getOffsetStart();
+		});
+
+		const int sectionsCount = static_cast<int>(mDirtySections.size());
+		for (Json::Value* section : mDirtySections)
+		{
+			const ptrdiff_t start = section->getOffsetStart();
+			const ptrdiff_t limit = section->getOffsetLimit();
+
+			const size_t currentStart = GetCurrentOffset(start);
+			auto it = mSplicedSections.find(start);
+			const size_t currentLength = (it != mSplicedSections.end()) ? it->second.second : static_cast<size_t>(limit - start);
+
+			const std::string sectionText = SerializeSection(*section, currentStart);
+			mText.replace(currentStart, currentLength, sectionText);
+			mSplicedSections[start] = std::make_pair(limit, sectionText.size());
+		}
+		mDirtySections.clear();
+
+		WriteAtomically(mText);
+
+		std::wstring msg = L"[ER Logger][ER_SceneDocument] Saved " + std::to_wstring(sectionsCount) + L" changed section(s) to: " + ER_Utility::ToWideString(mPath) + L'\n';
+		ER_OUTPUT_LOG(msg.c_str());
+	}
+
+	size_t ER_SceneDocument::GetCurrentOffset(ptrdiff_t originalOffset) const
+	{
+		ptrdiff_t delta = 0;
+		for (auto& spliced : mSplicedSections)
+		{
+			if (spliced.first >= originalOffset)
+				break;
+			delta += static_cast<ptrdiff_t>(spliced.second.second) - (spliced.second.first - spliced.first);
+		}
+		return static_cast<size_t>(originalOffset + delta);
+	}
+
+	// The writer starts at column 0, so we indent every following line the same way as the line the section starts on.
+	// That way the result is identical to what a full rewrite would produce.
+	std::string ER_SceneDocument::SerializeSection(const Json::Value& value, size_t currentOffset) const
+	{
+		Json::StreamWriterBuilder builder;
+		const std::string text = Json::writeString(builder, value);
+
+		size_t lineStart = mText.rfind('\n', currentOffset);
+		lineStart = (lineStart == std::string::npos) ? 0 : lineStart + 1;
+		std::string indentation;
+		for (size_t i = lineStart; i < currentOffset && (mText[i] == '\t' || mText[i] == ' '); i++)
+			indentation += mText[i];
+
+		std::string result;
+		result.reserve(text.size() + indentation.size() * 32);
+		for (char c : text)
+		{
+			result += c;
+			if (c == '\n')
+				result += indentation;
+		}
+		return result;
+	}
+
+	void ER_SceneDocument::WriteAtomically(const std::string& text)
+	{
+		const std::string tempPath = mPath + ".tmp";
+		{
+			std::ofstream file(tempPath.c_str(), std::ofstream::binary | std::ofstream::trunc);
+			if (!file.is_open())
+				throw ER_CoreException("Can't save to scene json file! Could not create a temporary file...");
+
+			file.write(text.data(), text.size());
+			file.flush();
+			if (!file.good())
+			{
+				file.close();
+				DeleteFileA(tempPath.c_str());
+				throw ER_CoreException("Can't save to scene json file! Could not write to a temporary file...");
+			}
+		}
+
+		if (!MoveFileExA(tempPath.c_str(), mPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		{
+			HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+			DeleteFileA(tempPath.c_str());
+			throw ER_CoreException("Can't save to scene json file! Could not replace the scene file with the temporary one...", hr);
+		}
+	}
+}
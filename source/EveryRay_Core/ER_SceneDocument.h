@@ -0,0 +1,48 @@
+// Scene (level) json document in EveryRay Rendering Engine
+// Parsed once on level load and shared by all subsystems that read the scene file (objects, foliage, terrain, probes, etc.).
+// Saves are incremental: only replaced sections (i.e., transforms, foliage positions) are re-serialized and spliced into the original text,
+// which is then written atomically (temp file + rename).
+
+#pragma once
+#include "Common.h"
+
+#include "..\JsonCpp\include\json\json.h"
+
+namespace EveryRay_Core
+{
+	class ER_SceneDocument
+	{
+	public:
+		ER_SceneDocument();
+		~ER_SceneDocument();
+
+		void Load(const std::string& path);
+		void Save();
+
+		// Replaces the value of an existing section in the document and marks it dirty (skipped if the value did not change).
+		// Sections that do not exist in the original file yet (i.e., "transform" added by the editor) force a full rewrite on the next save.
+		void ReplaceSection(Json::Value& section, const Json::Value& newValue);
+
+		Json::Value& GetRoot() { return mRoot; }
+		const std::string& GetPath() const { return mPath; }
+		bool HasUnsavedChanges() const { return mNeedsFullRewrite || !mDirtySections.empty(); }
+	private:
+		ER_SceneDocument(const ER_SceneDocument& rhs);
+		ER_SceneDocument& operator=(const ER_SceneDocument& rhs);
+
+		void Parse();
+		void WriteAtomically(const std::string& text);
+		size_t GetCurrentOffset(ptrdiff_t originalOffset) const;
+		std::string SerializeSection(const Json::Value& value, size_t currentOffset) const;
+
+		Json::Value mRoot;
+		std::string mPath;
+		std::string mText; // current contents of the file on disk
+
+		// Json::Value offsets always point into the originally parsed text, so we keep track of what we have spliced since then:
+		// original start -> (original limit, current length in mText)
+		std::map<ptrdiff_t, std::pair<ptrdiff_t, size_t>> mSplicedSections;
+		std::vector<Json::Value*> mDirtySections;
+		bool mNeedsFullRewrite = false;
+	};
+}
@@ -14,6 +14,7 @@
 #include "ER_ShadowMapMaterial.h"
 #include "ER_MaterialsCallbacks.h"
 #include "ER_Terrain.h"
+#include "ER_Utility.h"
 
 #include <sstream>
 #include <iomanip>
@@ -54,6 +55,11 @@ namespace EveryRay_Core
 			mShadowMaps.push_back(rhi->CreateGPUTexture(L"ER_RHI_GPUTexture: Shadow Map #" + std::to_wstring(i)));
 			mShadowMaps[i]->CreateGPUTextureResource(rhi, mResolution, mResolution, 1u, ER_FORMAT_D16_UNORM, ER_BIND_DEPTH_STENCIL | ER_BIND_SHADER_RESOURCE);
 
+			mStaticShadowMaps.push_back(rhi->CreateGPUTexture(L"ER_RHI_GPUTexture: Static Shadow Map #" + std::to_wstring(i)));
+			mStaticShadowMaps[i]->CreateGPUTextureResource(rhi, mResolution, mResolution, 1u, ER_FORMAT_D16_UNORM, ER_BIND_DEPTH_STENCIL | ER_BIND_SHADER_RESOURCE);
+			mStaticCascadeCaches.push_back({});
+			mCascadeMaterialNames[i] = ER_MaterialHelper::shadowMapMaterialName + " " + std::to_string(i);
+
 			mCameraCascadesFrustums.push_back(XMMatrixIdentity());
 			(isCascaded) ? mCameraCascadesFrustums[i].SetMatrix(mCamera.GetCustomViewProjectionMatrixForCascade(i)) : mCameraCascadesFrustums[i].SetMatrix(mCamera.ProjectionMatrix());
 
@@ -78,6 +84,7 @@ namespace EveryRay_Core
 	ER_ShadowMapper::~ER_ShadowMapper()
 	{
 		DeletePointerCollection(mShadowMaps);
+		DeletePointerCollection(mStaticShadowMaps);
 		DeletePointerCollection(mLightProjectors);
 
 		DeleteObject(mRootSignature);
@@ -85,21 +92,127 @@ namespace EveryRay_Core
 
 	void ER_ShadowMapper::Update(const ER_CoreTime& gameTime)
 	{
+		mFrameIndex++;
+
 		for (int i = 0; i < NUM_SHADOW_CASCADES; i++)
 		{
 			(mIsCascaded) ? mCameraCascadesFrustums[i].SetMatrix(mCamera.GetCustomViewProjectionMatrixForCascade(i)) : mCameraCascadesFrustums[i].SetMatrix(mCamera.ProjectionMatrix());
 
+			const XMMATRIX projectionMatrix = GetProjectionBoundingSphere(i); // also updates the centered position
+			const float width = 2.0f / XMVectorGetX(projectionMatrix.r[0]); // see XMMatrixOrthographicRH()
+
+			// with caching, the cascade keeps its matrices (and the static depth rendered with them) until it moves too much
+			StaticCascadeCache& cache = mStaticCascadeCaches[i];
+			if (mIsCachingStaticCasters && !(IsCascadeMoved(i, mLightProjectorCenteredPositions[i], width) && IsCascadeScheduled(i)))
+				continue;
+
 			mLightProjectors[i]->SetPosition(mLightProjectorCenteredPositions[i].x, mLightProjectorCenteredPositions[i].y, mLightProjectorCenteredPositions[i].z);
-			mLightProjectors[i]->SetProjectionMatrix(GetProjectionBoundingSphere(i));
+			mLightProjectors[i]->SetProjectionMatrix(projectionMatrix);
 			mLightProjectors[i]->SetViewMatrix(mLightProjectorCenteredPositions[i], mDirectionalLight.Direction(), mDirectionalLight.Up());
 			mLightProjectors[i]->Update();
+
+			cache.lightDirection = mDirectionalLight.Direction();
+			cache.center = mLightProjectorCenteredPositions[i];
+			cache.width = width;
+			cache.isValid = false;
 		}
+
+		UpdateImGui();
+	}
+
+	void ER_ShadowMapper::UpdateImGui()
+	{
+		if (!mShowDebug)
+			return;
+
+		ImGui::Begin("Shadow Mapper");
+		if (ImGui::Checkbox("Cache static casters", &mIsCachingStaticCasters) && mIsCachingStaticCasters)
+			InvalidateStaticCache();
+		ImGui::SliderFloat("Max light rotation (degrees)", &mCacheMaxLightAngle, 0.0f, 5.0f);
+		ImGui::SliderFloat("Max cascade offset (fraction of width)", &mCacheMaxCascadeOffset, 0.0f, 0.5f);
+		ImGui::SliderInt("Far cascades update interval (frames)", &mFarCascadesUpdateInterval, 1, 8);
+		if (ImGui::Button("Invalidate static cache"))
+			InvalidateStaticCache();
+		ImGui::Text("Casters: %u static, %u dynamic", mStats.staticCastersCount, mStats.dynamicCastersCount);
+		ImGui::Text("Cascades: %u static renders, %u from cache, %u skipped", mStats.staticCascadeRenders, mStats.skippedStaticCascadeRenders, mStats.skippedCascadeRenders);
+		ImGui::End();
+	}
+
+	void ER_ShadowMapper::InvalidateStaticCache()
+	{
+		for (StaticCascadeCache& cache : mStaticCascadeCaches)
+			cache.isValid = false;
+	}
+
+	bool ER_ShadowMapper::IsCascadeMoved(int index, const XMFLOAT3& aCenter, float aWidth) const
+	{
+		const StaticCascadeCache& cache = mStaticCascadeCaches[index];
+		if (cache.width <= 0.0f || fabs(cache.width - aWidth) > 0.001f * aWidth) // never placed or the camera projection has changed
+			return true;
+
+		const XMFLOAT3& lightDirection = mDirectionalLight.Direction();
+		const float cosAngle = cache.lightDirection.x * lightDirection.x + cache.lightDirection.y * lightDirection.y + cache.lightDirection.z * lightDirection.z;
+		if (cosAngle < cosf(XMConvertToRadians(mCacheMaxLightAngle)))
+			return true;
+
+		const XMFLOAT3 offset = XMFLOAT3(aCenter.x - cache.center.x, aCenter.y - cache.center.y, aCenter.z - cache.center.z);
+		const float maxOffset = mCacheMaxCascadeOffset * aWidth;
+		return offset.x * offset.x + offset.y * offset.y + offset.z * offset.z > maxOffset * maxOffset;
+	}
+
+	// The first cascade is always moved when needed, far ones take turns (one frame each), so that their static renders are spread over frames
+	bool ER_ShadowMapper::IsCascadeScheduled(int index) const
+	{
+		if (index == 0 || mFarCascadesUpdateInterval <= 1 || mStaticCascadeCaches[index].width <= 0.0f)
+			return true;
+
+		return (mFrameIndex + index) % static_cast<UINT64>(mFarCascadesUpdateInterval) == 0;
+	}
+
+	// Instanced objects are culled by the main camera (on CPU or GPU), so their shadows change every frame anyway;
+	// the selected object of the editor can be moved with the gizmo
+	bool ER_ShadowMapper::IsStaticCaster(ER_RenderingObject* aObj) const
+	{
+		if (aObj->IsInstanced() || aObj->IsDynamicShadowCaster())
+			return false;
+
+		return !(ER_Utility::IsEditorMode && aObj->IsAvailableInEditor() && aObj->IsSelected());
+	}
+
+	// Changes whenever a static caster is added, removed, moved or hidden
+	UINT64 ER_ShadowMapper::GetStaticCastersSignature(const ER_Scene* scene) const
+	{
+		UINT64 signature = 14695981039346656037ull; // FNV-1a
+		auto hash = [&signature](const void* aData, size_t aSize)
+		{
+			const unsigned char* bytes = static_cast<const unsigned char*>(aData);
+			for (size_t i = 0; i < aSize; i++)
+				signature = (signature ^ bytes[i]) * 1099511628211ull;
+		};
+
+		for (auto renderingObjectInfo = scene->objects.begin(); renderingObjectInfo != scene->objects.end(); renderingObjectInfo++)
+		{
+			ER_RenderingObject* renderingObject = renderingObjectInfo->second;
+			if (!IsStaticCaster(renderingObject))
+				continue;
+
+			const XMFLOAT4X4 transform = renderingObject->GetTransformationMatrix4X4();
+			const bool isRendered = renderingObject->IsRendered();
+			hash(&renderingObject, sizeof(renderingObject));
+			hash(&transform, sizeof(transform));
+			hash(&isRendered, sizeof(isRendered));
+		}
+		return signature;
 	}
 
 	void ER_ShadowMapper::BeginRenderingToShadowMap(int cascadeIndex)
 	{
 		assert(cascadeIndex < NUM_SHADOW_CASCADES);
+		BeginRenderingToDepth(mShadowMaps[cascadeIndex], true);
+	}
 
+	void ER_ShadowMapper::BeginRenderingToDepth(ER_RHI_GPUTexture* aDepth, bool aClear)
+	{
 		auto rhi = GetCore()->GetRHI();
 
 		mOriginalRS = rhi->GetCurrentRasterizerState();
@@ -109,15 +222,16 @@ namespace EveryRay_Core
 		ER_RHI_Viewport newViewport;
 		newViewport.TopLeftX = 0.0f;
 		newViewport.TopLeftY = 0.0f;
-		newViewport.Width = static_cast<float>(mShadowMaps[cascadeIndex]->GetWidth());
-		newViewport.Height = static_cast<float>(mShadowMaps[cascadeIndex]->GetHeight());
+		newViewport.Width = static_cast<float>(aDepth->GetWidth());
+		newViewport.Height = static_cast<float>(aDepth->GetHeight());
 		newViewport.MinDepth = 0.0f;
 		newViewport.MaxDepth = 1.0f;
 
-		ER_RHI_Rect newRect = { 0, 0, static_cast<LONG>(mShadowMaps[cascadeIndex]->GetWidth()), static_cast<LONG>(mShadowMaps[cascadeIndex]->GetHeight()) };
+		ER_RHI_Rect newRect = { 0, 0, static_cast<LONG>(aDepth->GetWidth()), static_cast<LONG>(aDepth->GetHeight()) };
 
-		rhi->SetDepthTarget(mShadowMaps[cascadeIndex]);
-		rhi->ClearDepthStencilTarget(mShadowMaps[cascadeIndex], 1.0f);
+		rhi->SetDepthTarget(aDepth);
+		if (aClear)
+			rhi->ClearDepthStencilTarget(aDepth, 1.0f);
 		rhi->SetViewport(newViewport);
 		rhi->SetRect(newRect);
 	}
@@ -267,64 +381,176 @@ namespace EveryRay_Core
 		return projectionMatrix;
 	}
 
+	// With caching, every cascade is a copy of its static depth (re-rendered only when invalid) with dynamic casters drawn on top;
+	// cascades without dynamic casters are not touched at all while their static depth is valid
 	void ER_ShadowMapper::Draw(const ER_Scene* scene, ER_Terrain* terrain)
 	{
 		auto rhi = GetCore()->GetRHI();
 
-		ER_MaterialSystems materialSystems;
-		materialSystems.mShadowMapper = this;
+		mStats = {};
+		if (mIsCachingStaticCasters)
+		{
+			const UINT64 signature = GetStaticCastersSignature(scene);
+			if (signature != mStaticCastersSignature)
+			{
+				InvalidateStaticCache();
+				mStaticCastersSignature = signature;
+			}
+		}
 
 		for (int i = 0; i < NUM_SHADOW_CASCADES; i++)
 		{
-			std::string materialName = ER_MaterialHelper::shadowMapMaterialName + " " + std::to_string(i);
-			BeginRenderingToShadowMap(i);
-
-			rhi->BeginEventTag("EveryRay: Shadow Maps (terrain), cascade " + std::to_string(i));
-			if (terrain)
-				terrain->Draw(TerrainRenderPass::TERRAIN_SHADOW, { mShadowMaps[i] }, nullptr, this, nullptr, i);
-			rhi->EndEventTag();
-
-			rhi->BeginEventTag("EveryRay: Shadow Maps (objects), cascade " + std::to_string(i));
-
-			rhi->SetRootSignature(mRootSignature);
-			rhi->SetTopologyType(ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-			int objectIndex = 0;
-			for (auto renderingObjectInfo = scene->objects.begin(); renderingObjectInfo != scene->objects.end(); renderingObjectInfo++, objectIndex++)
+			const std::string& materialName = mCascadeMaterialNames[i];
+
+			// PSOs are created here, draws are recorded later (the lists are in the frame arena)
+			ER_ArenaVector<ER_RenderingObject*> staticObjects;
+			ER_ArenaVector<ER_RenderingObject*> dynamicObjects;
+			staticObjects.reserve(scene->objects.size());
+			dynamicObjects.reserve(scene->objects.size());
+			for (auto renderingObjectInfo = scene->objects.begin(); renderingObjectInfo != scene->objects.end(); renderingObjectInfo++)
 			{
 				ER_RenderingObject* renderingObject = renderingObjectInfo->second;
 				const std::string& psoName = renderingObject->IsInstanced() ? psoNameInstanced : psoNameNonInstanced;
 				auto materialInfo = renderingObject->GetMaterials().find(materialName);
 				if (materialInfo != renderingObject->GetMaterials().end())
 				{
-					ER_Material* material = materialInfo->second;
 					if (!rhi->IsPSOReady(psoName))
 					{
 						rhi->InitializePSO(psoName);
 						rhi->SetRasterizerState(ER_SHADOW_RS);
 						rhi->SetBlendState(ER_NO_BLEND);
 						rhi->SetDepthStencilState(ER_RHI_DEPTH_STENCIL_STATE::ER_DEPTH_ONLY_WRITE_COMPARISON_LESS_EQUAL);
-						material->PrepareShaders();
+						materialInfo->second->PrepareShaders();
 						rhi->SetRenderTargetFormats({}, mShadowMaps[i]);
 						rhi->SetRootSignatureToPSO(psoName, mRootSignature);
 						rhi->SetTopologyTypeToPSO(psoName, ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 						rhi->FinalizePSO(psoName);
+						rhi->UnsetPSO();
 					}
-					rhi->SetPSO(psoName);
+
+					if (mIsCachingStaticCasters && IsStaticCaster(renderingObject))
+						staticObjects.push_back(renderingObject);
+					else
+						dynamicObjects.push_back(renderingObject);
+				}
+			}
+			if (i == 0)
+			{
+				mStats.staticCastersCount = static_cast<UINT>(staticObjects.size());
+				mStats.dynamicCastersCount = static_cast<UINT>(dynamicObjects.size());
+			}
+
+			StaticCascadeCache& cache = mStaticCascadeCaches[i];
+			if (!mIsCachingStaticCasters)
+			{
+				BeginRenderingToDepth(mShadowMaps[i], true);
+				DrawCasters(i, mShadowMaps[i], terrain, dynamicObjects, false);
+				StopRenderingToShadowMap(i);
+
+				cache.isValid = false;
+				cache.isCompositeValid = false;
+				continue;
+			}
+
+			if (!cache.isValid)
+			{
+				rhi->BeginEventTag("EveryRay: Shadow Maps (static casters), cascade " + std::to_string(i));
+				BeginRenderingToDepth(mStaticShadowMaps[i], true);
+				DrawCasters(i, mStaticShadowMaps[i], terrain, staticObjects, true); // static depth must not depend on the main camera culling
+				StopRenderingToShadowMap(i);
+				rhi->EndEventTag();
+
+				cache.isValid = true;
+				cache.isCompositeValid = false;
+				mStats.staticCascadeRenders++;
+			}
+			else
+				mStats.skippedStaticCascadeRenders++;
+
+			if (cache.isCompositeValid && dynamicObjects.empty())
+			{
+				mStats.skippedCascadeRenders++;
+				continue;
+			}
+
+			rhi->CopyGPUTextureSubresourceRegion(mShadowMaps[i], 0, 0, 0, 0, mStaticShadowMaps[i], 0);
+			if (!dynamicObjects.empty())
+			{
+				rhi->BeginEventTag("EveryRay: Shadow Maps (dynamic casters), cascade " + std::to_string(i));
+				BeginRenderingToDepth(mShadowMaps[i], false);
+				DrawCasters(i, mShadowMaps[i], nullptr, dynamicObjects, false);
+				StopRenderingToShadowMap(i);
+				rhi->EndEventTag();
+			}
+			cache.isCompositeValid = dynamicObjects.empty();
+		}
+	}
+
+	// Expects BeginRenderingToDepth(aDepth)
+	void ER_ShadowMapper::DrawCasters(int cascadeIndex, ER_RHI_GPUTexture* aDepth, ER_Terrain* terrain, const ER_ArenaVector<ER_RenderingObject*>& aObjects, bool aSkipCulling)
+	{
+		auto rhi = GetCore()->GetRHI();
+		const int i = cascadeIndex;
+		const std::string& materialName = mCascadeMaterialNames[i];
+
+		ER_MaterialSystems materialSystems;
+		materialSystems.mShadowMapper = this;
+
+		rhi->BeginEventTag("EveryRay: Shadow Maps (terrain), cascade " + std::to_string(i));
+		if (terrain)
+			terrain->Draw(TerrainRenderPass::TERRAIN_SHADOW, { aDepth }, nullptr, this, nullptr, i);
+		rhi->EndEventTag();
+
+		rhi->BeginEventTag("EveryRay: Shadow Maps (objects), cascade " + std::to_string(i));
+
+		// draws are recorded by several threads (contiguous ranges of objects, so the order on the GPU does not change)
+		const int objectsCount = static_cast<int>(aObjects.size());
+		if (objectsCount > 0)
+		{
+			// albedo textures (alpha test) can be shared by several contexts: transitioned on the current list (see ER_GBuffer::Draw())
+			std::vector<ER_RHI_GPUResource*> textures;
+			for (ER_RenderingObject* renderingObject : aObjects)
+			{
+				for (int meshIndex = 0; meshIndex < renderingObject->GetMeshCount(); meshIndex++)
+				{
+					if (renderingObject->GetTextureData(meshIndex).AlbedoMap)
+						textures.push_back(renderingObject->GetTextureData(meshIndex).AlbedoMap);
+				}
+			}
+			std::sort(textures.begin(), textures.end());
+			textures.erase(std::unique(textures.begin(), textures.end()), textures.end());
+			if (!textures.empty())
+				rhi->TransitionResources(textures, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, rhi->GetCurrentGraphicsCommandListIndex());
+
+			const int contextsCount = std::min(rhi->GetParallelCommandContextsCount(), objectsCount);
+			rhi->ExecuteParallelCommandContexts("Shadow Maps, cascade " + std::to_string(i), contextsCount, [&](int aContextIndex)
+			{
+				rhi->SetDepthTarget(aDepth);
+				rhi->SetRootSignature(mRootSignature);
+				rhi->SetTopologyType(ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+				const int startObject = objectsCount * aContextIndex / contextsCount;
+				const int endObject = objectsCount * (aContextIndex + 1) / contextsCount;
+				for (int objectIndex = startObject; objectIndex < endObject; objectIndex++)
+				{
+					ER_RenderingObject* renderingObject = aObjects[objectIndex];
+					ER_ShadowMapMaterial* material = static_cast<ER_ShadowMapMaterial*>(renderingObject->GetMaterials().find(materialName)->second);
+
+					rhi->SetPSO(renderingObject->IsInstanced() ? psoNameInstanced : psoNameNonInstanced);
 					for (int meshIndex = 0; meshIndex < renderingObject->GetMeshCount(); meshIndex++)
 					{
-						static_cast<ER_ShadowMapMaterial*>(material)->PrepareForRendering(materialSystems, renderingObject, meshIndex, i, mRootSignature);
+						material->PrepareForRendering(materialSystems, renderingObject, meshIndex, i, mRootSignature);
 						if (!renderingObject->IsInstanced())
-							renderingObject->DrawLOD(materialName, true, meshIndex, renderingObject->GetLODCount() - 1); //drawing highest LOD
+							renderingObject->DrawLOD(materialName, true, meshIndex, renderingObject->GetLODCount() - 1, aSkipCulling); //drawing highest LOD
 						else
 							renderingObject->Draw(materialName, true, meshIndex);
 					}
 				}
-			}
-			rhi->EndEventTag();
-
-			rhi->UnsetPSO();
-			StopRenderingToShadowMap(i);
+				rhi->UnsetPSO();
+			});
 		}
+		rhi->EndEventTag();
+
+		rhi->UnsetPSO();
 	}
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include "Common.h"
 #include "ER_CoreComponent.h"
 #include "RHI/ER_RHI.h"
+#include "ER_LinearArena.h"
 
 namespace EveryRay_Core
 {
@@ -11,6 +12,7 @@ namespace EveryRay_Core
 	class ER_DirectionalLight;
 	class ER_Scene;
 	class ER_Terrain;
+	class ER_RenderingObject;
 
 	enum ShadowQuality
 	{
@@ -19,6 +21,16 @@ namespace EveryRay_Core
 		SHADOW_HIGH
 	};
 
+	// Per-frame counters of the static shadow casters caching
+	struct ER_ShadowMapperStats
+	{
+		UINT staticCascadeRenders = 0; // cascades with re-rendered static casters
+		UINT skippedStaticCascadeRenders = 0; // cascades with static casters from the cache
+		UINT skippedCascadeRenders = 0; // cascades that were not touched at all (valid cache and no dynamic casters)
+		UINT staticCastersCount = 0;
+		UINT dynamicCastersCount = 0;
+	};
+
 	class ER_ShadowMapper : public ER_CoreComponent 
 	{
 	public:
@@ -36,9 +48,33 @@ namespace EveryRay_Core
 		void ApplyTransform();
 		//void ApplyRotation();
 
+		void Config() { mShowDebug = !mShowDebug; }
+		// Static casters of all cascades are re-rendered in the next Draw() (their changes are detected automatically, this is for everything else)
+		void InvalidateStaticCache();
+		const ER_ShadowMapperStats& GetStats() const { return mStats; }
+
 	private:
+		// Static casters (terrain and non-instanced objects) are rendered into mStaticShadowMaps with the matrices of the cascade stored here.
+		// Matrices of the cascade (and so the static depth) are kept until the light or the cascade moves beyond the thresholds.
+		struct StaticCascadeCache
+		{
+			XMFLOAT3 lightDirection = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			XMFLOAT3 center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+			float width = 0.0f; // 0 means that the cascade has never been placed
+			bool isValid = false; // static depth matches the matrices of the cascade
+			bool isCompositeValid = false; // shadow map is a copy of the static depth (i.e., no dynamic casters were drawn on top)
+		};
+
 		XMMATRIX GetLightProjectionMatrixInFrustum(int index, ER_Frustum& cameraFrustum, ER_DirectionalLight& light);
 		XMMATRIX GetProjectionBoundingSphere(int index);
+		bool IsCascadeMoved(int index, const XMFLOAT3& aCenter, float aWidth) const;
+		bool IsCascadeScheduled(int index) const;
+		bool IsStaticCaster(ER_RenderingObject* aObj) const;
+		UINT64 GetStaticCastersSignature(const ER_Scene* scene) const;
+		void UpdateImGui();
+
+		void BeginRenderingToDepth(ER_RHI_GPUTexture* aDepth, bool aClear);
+		void DrawCasters(int cascadeIndex, ER_RHI_GPUTexture* aDepth, ER_Terrain* terrain, const ER_ArenaVector<ER_RenderingObject*>& aObjects, bool aSkipCulling);
 
 		ER_Camera& mCamera;
 		ER_DirectionalLight& mDirectionalLight;
@@ -57,5 +93,17 @@ namespace EveryRay_Core
 		XMMATRIX mShadowMapProjectionMatrix;
 		UINT mResolution = 0;
 		bool mIsCascaded = true;
+
+		std::vector<ER_RHI_GPUTexture*> mStaticShadowMaps;
+		std::vector<StaticCascadeCache> mStaticCascadeCaches;
+		std::string mCascadeMaterialNames[NUM_SHADOW_CASCADES]; // built once (material lookups are per object per cascade)
+		ER_ShadowMapperStats mStats;
+		UINT64 mStaticCastersSignature = 0;
+		UINT64 mFrameIndex = 0;
+		float mCacheMaxLightAngle = 0.25f; // in degrees
+		float mCacheMaxCascadeOffset = 0.05f; // fraction of the width of the cascade
+		int mFarCascadesUpdateInterval = 2; // cascades > 0 are moved in turns (once in that many frames), 1 disables it
+		bool mIsCachingStaticCasters = true;
+		bool mShowDebug = false;
 	};
 }
\ No newline at end of file
@@ -188,7 +188,7 @@ namespace EveryRay_Core
 
 		assert(aRenderTarget);
 		assert(aSceneDepth);
-		auto quadRenderer = (ER_QuadRenderer*)mCore.GetServices().FindService(ER_QuadRenderer::TypeIdClass());
+		auto quadRenderer = mCore.GetServices().FindService<ER_QuadRenderer>();
 		assert(quadRenderer);
 
 		const std::string& psoName = isVolumetricCloudsPass ? mSunPassVolumetricCloudsPSOName : mSunPassPSOName;
@@ -0,0 +1,277 @@
+#include "stdafx.h"
+#include "ER_SphericalHarmonics.h"
+#include "ER_Utility.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace EveryRay_Core
+{
+	namespace
+	{
+		// basis constants (same signs as in DirectXSH, see sh_eval_basis_2())
+		const float SH_C0 = 0.282094791773878140f;
+		const float SH_C1 = 0.488602511902919920f;
+		const float SH_C2 = 1.092548430592079200f;
+		const float SH_C3 = 0.946174695757560080f;
+		const float SH_C4 = 0.315391565252520050f;
+		const float SH_C5 = 0.546274215296039590f;
+
+		// clamped cosine lobe per coefficient (bands 0, 1, 2)
+		const float SH_COSINE_LOBE[ER_SH_COEF_COUNT] = {
+			XM_PI,
+			2.0f * XM_PI / 3.0f, 2.0f * XM_PI / 3.0f, 2.0f * XM_PI / 3.0f,
+			XM_PI / 4.0f, XM_PI / 4.0f, XM_PI / 4.0f, XM_PI / 4.0f, XM_PI / 4.0f };
+
+		// Cubemap faces in D3D order: direction = major + u * axisU + v * axisV (u, v are in [-1, 1], v goes down the rows).
+		// Matches the texel directions of DirectX::SHProjectCubeMap().
+		const XMFLOAT3 FACE_MAJOR_AXIS[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		const XMFLOAT3 FACE_U_AXIS[6] = { { 0, 0, -1 }, { 0, 0, 1 }, { 1, 0, 0 }, { 1, 0, 0 }, { 1, 0, 0 }, { -1, 0, 0 } };
+		const XMFLOAT3 FACE_V_AXIS[6] = { { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 } };
+
+		// 4 directions at once (one component per vector)
+		inline void EvaluateBasis4(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, XMVECTOR aBasis[ER_SH_COEF_COUNT])
+		{
+			aBasis[0] = XMVectorReplicate(SH_C0);
+			aBasis[1] = XMVectorScale(y, -SH_C1);
+			aBasis[2] = XMVectorScale(z, SH_C1);
+			aBasis[3] = XMVectorScale(x, -SH_C1);
+			aBasis[4] = XMVectorScale(XMVectorMultiply(x, y), SH_C2);
+			aBasis[5] = XMVectorScale(XMVectorMultiply(y, z), -SH_C2);
+			aBasis[6] = XMVectorSubtract(XMVectorScale(XMVectorMultiply(z, z), SH_C3), XMVectorReplicate(SH_C4));
+			aBasis[7] = XMVectorScale(XMVectorMultiply(x, z), -SH_C2);
+			aBasis[8] = XMVectorScale(XMVectorSubtract(XMVectorMultiply(x, x), XMVectorMultiply(y, y)), SH_C5);
+		}
+
+		inline float HorizontalSum(FXMVECTOR v)
+		{
+			XMFLOAT4A components;
+			XMStoreFloat4A(&components, v);
+			return (components.x + components.y) + (components.z + components.w);
+		}
+	}
+
+	void ER_SphericalHarmonics::ProjectCubemap(const float* const aFaces[6], UINT aSize, UINT aStride, XMFLOAT3 aResult[ER_SH_COEF_COUNT])
+	{
+		assert(aSize > 0 && aStride >= 3);
+
+		XMVECTOR accumulated[3][ER_SH_COEF_COUNT];
+		for (int channel = 0; channel < 3; channel++)
+			for (int i = 0; i < ER_SH_COEF_COUNT; i++)
+				accumulated[channel][i] = XMVectorZero();
+		XMVECTOR weightsSum = XMVectorZero();
+
+		// texel centers: -1 + (2 * i + 1) / size
+		const float texelSize = 2.0f / static_cast<float>(aSize);
+		const XMVECTOR laneOffsets = XMVectorSet(0.0f, texelSize, 2.0f * texelSize, 3.0f * texelSize);
+		const XMVECTOR one = XMVectorReplicate(1.0f);
+		XMVECTOR basis[ER_SH_COEF_COUNT];
+
+		for (int face = 0; face < 6; face++)
+		{
+			const XMFLOAT3& major = FACE_MAJOR_AXIS[face];
+			const XMFLOAT3& axisU = FACE_U_AXIS[face];
+			const XMFLOAT3& axisV = FACE_V_AXIS[face];
+
+			for (UINT y = 0; y < aSize; y++)
+			{
+				const float v = -1.0f + (2.0f * y + 1.0f) / static_cast<float>(aSize);
+				const XMVECTOR vv = XMVectorReplicate(v);
+				const float* row = aFaces[face] + static_cast<size_t>(y) * aSize * aStride;
+
+				for (UINT x = 0; x < aSize; x += 4)
+				{
+					const UINT lanes = std::min(aSize - x, 4u);
+
+					const XMVECTOR u = XMVectorAdd(XMVectorReplicate(-1.0f + (2.0f * x + 1.0f) / static_cast<float>(aSize)), laneOffsets);
+					const XMVECTOR lengthSq = XMVectorAdd(one, XMVectorAdd(XMVectorMultiply(u, u), XMVectorMultiply(vv, vv)));
+					const XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+
+					// differential solid angle of the texel: 4 / (1 + u^2 + v^2)^(3/2) (normalized at the end)
+					XMVECTOR weight = XMVectorScale(XMVectorMultiply(invLength, XMVectorMultiply(invLength, invLength)), 4.0f);
+					if (lanes < 4)
+						weight = XMVectorSelect(XMVectorZero(), weight, XMVectorSelectControl(1, lanes > 1 ? 1 : 0, lanes > 2 ? 1 : 0, 0));
+
+					const XMVECTOR dirX = XMVectorMultiply(XMVectorAdd(XMVectorReplicate(major.x + v * axisV.x), XMVectorScale(u, axisU.x)), invLength);
+					const XMVECTOR dirY = XMVectorMultiply(XMVectorAdd(XMVectorReplicate(major.y + v * axisV.y), XMVectorScale(u, axisU.y)), invLength);
+					const XMVECTOR dirZ = XMVectorMultiply(XMVectorAdd(XMVectorReplicate(major.z + v * axisV.z), XMVectorScale(u, axisU.z)), invLength);
+					EvaluateBasis4(dirX, dirY, dirZ, basis);
+
+					float colors[3][4] = {};
+					for (UINT lane = 0; lane < lanes; lane++)
+					{
+						const float* texel = row + static_cast<size_t>(x + lane) * aStride;
+						colors[0][lane] = texel[0];
+						colors[1][lane] = texel[1];
+						colors[2][lane] = texel[2];
+					}
+
+					for (int channel = 0; channel < 3; channel++)
+					{
+						const XMVECTOR weightedColor = XMVectorMultiply(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(colors[channel])), weight);
+						for (int i = 0; i < ER_SH_COEF_COUNT; i++)
+							accumulated[channel][i] = XMVectorMultiplyAdd(basis[i], weightedColor, accumulated[channel][i]);
+					}
+					weightsSum = XMVectorAdd(weightsSum, weight);
+				}
+			}
+		}
+
+		// the weights sum up to the area of the sphere
+		const float normalization = (4.0f * XM_PI) / HorizontalSum(weightsSum);
+		for (int i = 0; i < ER_SH_COEF_COUNT; i++)
+		{
+			aResult[i] = XMFLOAT3(
+				HorizontalSum(accumulated[0][i]) * normalization,
+				HorizontalSum(accumulated[1][i]) * normalization,
+				HorizontalSum(accumulated[2][i]) * normalization);
+		}
+	}
+
+	bool ER_SphericalHarmonics::ProjectCubemap(const DirectX::ScratchImage& aCubemap, XMFLOAT3 aResult[ER_SH_COEF_COUNT])
+	{
+		const DirectX::TexMetadata& metadata = aCubemap.GetMetadata();
+		if (!metadata.IsCubemap() || metadata.arraySize < 6 || metadata.width != metadata.height)
+			return false;
+
+		const DirectX::ScratchImage* source = &aCubemap;
+		DirectX::ScratchImage converted;
+		if (metadata.format != DXGI_FORMAT_R32G32B32A32_FLOAT)
+		{
+			HRESULT hr;
+			if (DirectX::IsCompressed(metadata.format))
+				hr = DirectX::Decompress(aCubemap.GetImages(), aCubemap.GetImageCount(), metadata, DXGI_FORMAT_R32G32B32A32_FLOAT, converted);
+			else
+				hr = DirectX::Convert(aCubemap.GetImages(), aCubemap.GetImageCount(), metadata, DXGI_FORMAT_R32G32B32A32_FLOAT,
+					DirectX::TEX_FILTER_DEFAULT, DirectX::TEX_THRESHOLD_DEFAULT, converted);
+			if (FAILED(hr))
+				return false;
+			source = &converted;
+		}
+
+		const float* faces[6];
+		for (int face = 0; face < 6; face++)
+		{
+			const DirectX::Image* image = source->GetImage(0, face, 0);
+			if (!image || image->rowPitch != image->width * sizeof(XMFLOAT4))
+				return false;
+			faces[face] = reinterpret_cast<const float*>(image->pixels);
+		}
+
+		ProjectCubemap(faces, static_cast<UINT>(metadata.width), 4, aResult);
+		return true;
+	}
+
+	void ER_SphericalHarmonics::ConvolveWithCosineLobe(const XMFLOAT3 aRadiance[ER_SH_COEF_COUNT], XMFLOAT3 aIrradiance[ER_SH_COEF_COUNT])
+	{
+		for (int i = 0; i < ER_SH_COEF_COUNT; i++)
+			XMStoreFloat3(&aIrradiance[i], XMVectorScale(XMLoadFloat3(&aRadiance[i]), SH_COSINE_LOBE[i]));
+	}
+
+	void ER_SphericalHarmonics::Evaluate(const XMFLOAT3 aCoefficients[ER_SH_COEF_COUNT], const XMFLOAT3* aDirections, UINT aCount, XMFLOAT3* aResult, bool isIrradiance)
+	{
+		// per channel coefficients (with the cosine lobe and 1/Pi of the shader already applied)
+		XMVECTOR coefficients[3][ER_SH_COEF_COUNT];
+		for (int i = 0; i < ER_SH_COEF_COUNT; i++)
+		{
+			const float scale = isIrradiance ? SH_COSINE_LOBE[i] / XM_PI : 1.0f;
+			coefficients[0][i] = XMVectorReplicate(aCoefficients[i].x * scale);
+			coefficients[1][i] = XMVectorReplicate(aCoefficients[i].y * scale);
+			coefficients[2][i] = XMVectorReplicate(aCoefficients[i].z * scale);
+		}
+
+		XMVECTOR basis[ER_SH_COEF_COUNT];
+		for (UINT first = 0; first < aCount; first += 4)
+		{
+			const UINT lanes = std::min(aCount - first, 4u);
+
+			XMFLOAT4A x = {}, y = {}, z = {};
+			float* xs = &x.x; float* ys = &y.x; float* zs = &z.x;
+			for (UINT lane = 0; lane < lanes; lane++)
+			{
+				xs[lane] = aDirections[first + lane].x;
+				ys[lane] = aDirections[first + lane].y;
+				zs[lane] = aDirections[first + lane].z;
+			}
+			EvaluateBasis4(XMLoadFloat4A(&x), XMLoadFloat4A(&y), XMLoadFloat4A(&z), basis);
+
+			XMFLOAT4A channels[3];
+			for (int channel = 0; channel < 3; channel++)
+			{
+				XMVECTOR sum = XMVectorZero();
+				for (int i = 0; i < ER_SH_COEF_COUNT; i++)
+					sum = XMVectorMultiplyAdd(coefficients[channel][i], basis[i], sum);
+				XMStoreFloat4A(&channels[channel], sum);
+			}
+
+			for (UINT lane = 0; lane < lanes; lane++)
+				aResult[first + lane] = XMFLOAT3((&channels[0].x)[lane], (&channels[1].x)[lane], (&channels[2].x)[lane]);
+		}
+	}
+
+	void ER_SphericalHarmonics::EvaluateBasis(const XMFLOAT3& aDirection, float aResult[ER_SH_COEF_COUNT])
+	{
+		XMVECTOR basis[ER_SH_COEF_COUNT];
+		EvaluateBasis4(XMVectorReplicate(aDirection.x), XMVectorReplicate(aDirection.y), XMVectorReplicate(aDirection.z), basis);
+		for (int i = 0; i < ER_SH_COEF_COUNT; i++)
+			aResult[i] = XMVectorGetX(basis[i]);
+	}
+
+	bool ER_SphericalHarmonics::RunAnalyticTest(UINT aSize, float aTolerance)
+	{
+		// fill the faces with the radiance of the analytic environments (same texel directions as in ProjectCubemap())
+		std::vector<float> faces[6];
+		const float* facesData[6];
+		for (int face = 0; face < 6; face++)
+		{
+			faces[face].resize(static_cast<size_t>(aSize) * aSize * 3);
+			for (UINT y = 0; y < aSize; y++)
+			{
+				for (UINT x = 0; x < aSize; x++)
+				{
+					const float u = -1.0f + (2.0f * x + 1.0f) / static_cast<float>(aSize);
+					const float v = -1.0f + (2.0f * y + 1.0f) / static_cast<float>(aSize);
+					const XMVECTOR direction = XMVector3Normalize(XMVectorAdd(XMLoadFloat3(&FACE_MAJOR_AXIS[face]),
+						XMVectorAdd(XMVectorScale(XMLoadFloat3(&FACE_U_AXIS[face]), u), XMVectorScale(XMLoadFloat3(&FACE_V_AXIS[face]), v))));
+					const float z = XMVectorGetZ(direction);
+
+					float* texel = &faces[face][(static_cast<size_t>(y) * aSize + x) * 3];
+					texel[0] = 1.0f;
+					texel[1] = 1.0f + z;
+					texel[2] = z * z;
+				}
+			}
+			facesData[face] = faces[face].data();
+		}
+
+		XMFLOAT3 coefficients[ER_SH_COEF_COUNT];
+		ProjectCubemap(facesData, aSize, 3, coefficients);
+
+		const XMFLOAT3 directions[] = {
+			{ 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f },
+			{ 0.57735027f, 0.57735027f, 0.57735027f }, { 0.0f, -0.6f, 0.8f }, { -0.8f, 0.0f, -0.6f } };
+		const UINT directionsCount = static_cast<UINT>(sizeof(directions) / sizeof(directions[0]));
+		XMFLOAT3 irradiance[sizeof(directions) / sizeof(directions[0])];
+		Evaluate(coefficients, directions, directionsCount, irradiance);
+
+		const char* channelNames[3] = { "R (radiance 1)", "G (radiance 1 + z)", "B (radiance z^2)" };
+		bool isPassed = true;
+		for (UINT i = 0; i < directionsCount; i++)
+		{
+			const float nz = directions[i].z;
+			const float expected[3] = { 1.0f, 1.0f + 2.0f / 3.0f * nz, (1.0f + nz * nz) / 4.0f };
+			const float result[3] = { irradiance[i].x, irradiance[i].y, irradiance[i].z };
+			for (int channel = 0; channel < 3; channel++)
+			{
+				if (std::abs(result[channel] - expected[channel]) <= aTolerance)
+					continue;
+
+				ER_OUTPUT_LOG(ER_Utility::ToWideString("[ER Logger][ER_SphericalHarmonics] Analytic test failed for channel " + std::string(channelNames[channel]) +
+					" in direction (" + std::to_string(directions[i].x) + ", " + std::to_string(directions[i].y) + ", " + std::to_string(directions[i].z) + "): " +
+					std::to_string(result[channel]) + ", expected " + std::to_string(expected[channel]) + '\n').c_str());
+				isPassed = false;
+			}
+		}
+		return isPassed;
+	}
+}
@@ -0,0 +1,43 @@
+// CPU spherical harmonics (order 2, 9 coefficients per channel) in EveryRay Rendering Engine
+// Uses the same basis, sign convention and normalization as DirectX::SHProjectCubeMap() (DirectXSH), so the projected coefficients
+// can be stored directly in ER_LightProbe and evaluated with GetDiffuseIrradianceFromSphericalHarmonics() (Lighting.hlsli).
+// All loops process 4 texels/normals at once with DirectXMath (SSE/NEON) and need no GPU, so probes can be baked on any API or machine.
+
+#pragma once
+#include "Common.h"
+
+#define ER_SH_ORDER 2
+#define ER_SH_COEF_COUNT ((ER_SH_ORDER + 1) * (ER_SH_ORDER + 1))
+
+namespace EveryRay_Core
+{
+	class ER_SphericalHarmonics
+	{
+	public:
+		// Projects radiance of a cubemap with 'aSize' x 'aSize' RGB(A) float faces in D3D order (+X, -X, +Y, -Y, +Z, -Z, rows from the top).
+		// Every texel is weighted by its solid angle. 'aStride' is the distance between texels in floats (i.e., 4 for RGBA).
+		static void ProjectCubemap(const float* const aFaces[6], UINT aSize, UINT aStride, XMFLOAT3 aResult[ER_SH_COEF_COUNT]);
+		// Same for a cubemap in system memory (i.e., captured from the GPU), the first mip is used; returns false if the image can not be converted to floats
+		static bool ProjectCubemap(const DirectX::ScratchImage& aCubemap, XMFLOAT3 aResult[ER_SH_COEF_COUNT]);
+
+		// Radiance -> irradiance: convolution with the clamped cosine lobe (A0 = Pi, A1 = 2Pi/3, A2 = Pi/4)
+		static void ConvolveWithCosineLobe(const XMFLOAT3 aRadiance[ER_SH_COEF_COUNT], XMFLOAT3 aIrradiance[ER_SH_COEF_COUNT]);
+
+		// Evaluates 'aCount' directions at once (any count). With radiance coefficients from ProjectCubemap() and 'isIrradiance' set
+		// it returns the same values as GetDiffuseIrradianceFromSphericalHarmonics() in the shaders (the convolution is applied internally).
+		static void Evaluate(const XMFLOAT3 aCoefficients[ER_SH_COEF_COUNT], const XMFLOAT3* aDirections, UINT aCount, XMFLOAT3* aResult, bool isIrradiance = true);
+
+		// Basis functions for a normalized direction
+		static void EvaluateBasis(const XMFLOAT3& aDirection, float aResult[ER_SH_COEF_COUNT]);
+
+		// Projects analytic cubemaps and compares the evaluated irradiance with the closed form, failed channels are logged
+		// (run once in debug builds, before the first cubemap is projected on the CPU, see ER_RHI_DX12::ProjectCubemapToSH()).
+		// Radiance per channel: R = 1 (E/Pi = 1), G = 1 + z (E/Pi = 1 + 2/3 * n.z), B = z^2 (E/Pi = (1 + n.z^2) / 4); all are exact with 9 coefficients.
+		static bool RunAnalyticTest(UINT aSize = 32, float aTolerance = 0.005f);
+
+	private:
+		ER_SphericalHarmonics();
+		ER_SphericalHarmonics(const ER_SphericalHarmonics& rhs);
+		ER_SphericalHarmonics& operator=(const ER_SphericalHarmonics& rhs);
+	};
+}
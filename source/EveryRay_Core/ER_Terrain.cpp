@@ -128,9 +128,9 @@ namespace EveryRay_Core
 		for (int i = 0; i < NUM_SHADOW_CASCADES; i++)
 			mTerrainShadowBuffers[i].Release();
 
-		ReadbackPlacedPositionsOnInitEvent->RemoveAllListeners();
+		ReadbackPlacedPositionsOnInitEvent->UnsubscribeAll();
 		DeleteObject(ReadbackPlacedPositionsOnInitEvent);
-		ReadbackPlacedPositionsOnUpdateEvent->RemoveAllListeners();
+		ReadbackPlacedPositionsOnUpdateEvent->UnsubscribeAll();
 		DeleteObject(ReadbackPlacedPositionsOnUpdateEvent);
 	}
 
@@ -527,7 +527,7 @@ namespace EveryRay_Core
 			return;
 
 		ER_RHI* rhi = mCore->GetRHI();
-		ER_Camera* camera = (ER_Camera*)(mCore->GetServices().FindService(ER_Camera::TypeIdClass()));
+		ER_Camera* camera = mCore->GetServices().FindService<ER_Camera>();
 
 		if (worldShadowMapper && aPass != TerrainRenderPass::TERRAIN_GBUFFER)
 		{
@@ -579,7 +579,7 @@ namespace EveryRay_Core
 
 	void ER_Terrain::Update(const ER_CoreTime& gameTime)
 	{
-		ER_Camera* camera = (ER_Camera*)(mCore->GetServices().FindService(ER_Camera::TypeIdClass()));
+		ER_Camera* camera = mCore->GetServices().FindService<ER_Camera>();
 
 		int visibleTiles = 0;
 		for (int i = 0; i < mHeightMaps.size(); i++)
@@ -618,7 +618,7 @@ namespace EveryRay_Core
 
 		ER_RHI* rhi = mCore->GetRHI();
 
-		ER_Camera* camera = (ER_Camera*)(mCore->GetServices().FindService(ER_Camera::TypeIdClass()));
+		ER_Camera* camera = mCore->GetServices().FindService<ER_Camera>();
 		assert(camera);
 
 		ER_RHI_PRIMITIVE_TYPE originalPrimitiveTopology = rhi->GetCurrentTopologyType();
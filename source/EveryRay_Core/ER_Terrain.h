@@ -1,7 +1,7 @@
 #pragma once
 #include "Common.h"
 #include "ER_CoreComponent.h"
-#include "ER_GenericEvent.h"
+#include "ER_Event.h"
 #include "RHI/ER_RHI.h"
 
 #define NUM_THREADS_PER_TERRAIN_SIDE 4
@@ -164,9 +164,9 @@ namespace EveryRay_Core
 		bool IsEnabled() { return mEnabled; }
 		bool IsLoaded() { return mLoaded; }
 
-		using Delegate_ReadbackPlacedPositions = std::function<void(ER_Terrain* aTerrain)>;
-		ER_GenericEvent<Delegate_ReadbackPlacedPositions>* ReadbackPlacedPositionsOnInitEvent = new ER_GenericEvent<Delegate_ReadbackPlacedPositions>();
-		ER_GenericEvent<Delegate_ReadbackPlacedPositions>* ReadbackPlacedPositionsOnUpdateEvent = new ER_GenericEvent<Delegate_ReadbackPlacedPositions>();
+		using Delegate_ReadbackPlacedPositions = void(ER_Terrain* aTerrain);
+		ER_Event<Delegate_ReadbackPlacedPositions>* ReadbackPlacedPositionsOnInitEvent = new ER_Event<Delegate_ReadbackPlacedPositions>();
+		ER_Event<Delegate_ReadbackPlacedPositions>* ReadbackPlacedPositionsOnUpdateEvent = new ER_Event<Delegate_ReadbackPlacedPositions>();
 	private:
 		void LoadTile(int threadIndex, const std::wstring& path);
 		void CreateTerrainTileDataCPU(int tileIndexX, int tileIndexY, const std::wstring& aPath);
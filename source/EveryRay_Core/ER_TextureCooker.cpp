@@ -0,0 +1,447 @@
+#include "stdafx.h"
+#include <algorithm>
+
+#include "ER_TextureCooker.h"
+#include "ER_SceneDocument.h"
+#include "ER_CoreException.h"
+#include "ER_Utility.h"
+
+namespace EveryRay_Core
+{
+	static const char* ManifestRelativePath = "content\\levels\\cooked_textures_manifest.json";
+
+	static std::string ToUTF8(const std::wstring& source)
+	{
+		if (source.empty())
+			return std::string();
+
+		const int size = WideCharToMultiByte(CP_UTF8, 0, source.c_str(), static_cast<int>(source.size()), nullptr, 0, nullptr, nullptr);
+		std::string result(size, '\0');
+		WideCharToMultiByte(CP_UTF8, 0, source.c_str(), static_cast<int>(source.size()), &result[0], size, nullptr, nullptr);
+		return result;
+	}
+
+	static bool IsPowerOfTwo(size_t value)
+	{
+		return value && !(value & (value - 1));
+	}
+
+	ER_TextureCooker::ER_TextureCooker(bool isFast, bool isForced)
+		: mIsFast(isFast), mIsForced(isForced)
+	{
+		mManifestPath = ER_Utility::GetFilePath(std::string(ManifestRelativePath));
+	}
+
+	ER_TextureCooker::~ER_TextureCooker()
+	{
+		mJobs.clear();
+		mManifest.clear();
+	}
+
+	int ER_TextureCooker::RunFromCommandLine(const std::string& aCommandLine)
+	{
+		// the runtime is a windowed application, so we borrow the console of the process that started us (if any)
+		if (AttachConsole(ATTACH_PARENT_PROCESS))
+		{
+			FILE* stream = nullptr;
+			freopen_s(&stream, "CONOUT$", "w", stdout);
+		}
+
+		std::string sceneName;
+		bool isFast = false;
+		bool isForced = false;
+		{
+			std::istringstream arguments(aCommandLine);
+			std::string argument;
+			bool isSceneNameExpected = false;
+			while (arguments >> argument)
+			{
+				if (argument == "-cooktextures")
+					isSceneNameExpected = true;
+				else if (argument == "-fast")
+					isFast = true;
+				else if (argument == "-force")
+					isForced = true;
+				else if (isSceneNameExpected && argument[0] != '-')
+					sceneName = argument;
+			}
+		}
+
+		Json::Reader reader;
+		std::string configPath = ER_Utility::GetFilePath("content\\levels\\global_scenes_config.json");
+		std::ifstream globalConfig(configPath.c_str(), std::ifstream::binary);
+		Json::Value root;
+		if (!reader.parse(globalConfig, root))
+		{
+			Log(L"[ER Logger][ER_TextureCooker] Could not parse global_scenes_config.json\n");
+			return 1;
+		}
+
+		ER_TextureCooker cooker(isFast, isForced);
+		bool isSceneFound = false;
+		for (Json::Value::ArrayIndex i = 0; i != root["scenes"].size(); i++)
+		{
+			const std::string name = root["scenes"][i]["scene_name"].asString();
+			if (!sceneName.empty() && name != sceneName)
+				continue;
+
+			isSceneFound = true;
+			const std::string scenePath = ER_Utility::GetFilePath(root["scenes"][i]["scene_path"].asString() + name + ".json");
+			if (GetFileAttributesA(scenePath.c_str()) == INVALID_FILE_ATTRIBUTES) // i.e., private levels that are not in the repository
+			{
+				Log(L"[ER Logger][ER_TextureCooker] Skipping level (no scene file): " + ER_Utility::ToWideString(name) + L'\n');
+				continue;
+			}
+			cooker.AddScene(scenePath);
+		}
+
+		if (!isSceneFound)
+		{
+			Log(L"[ER Logger][ER_TextureCooker] Level is not defined in global_scenes_config.json: " + ER_Utility::ToWideString(sceneName) + L'\n');
+			return 1;
+		}
+
+		return (cooker.Cook() == 0) ? 0 : 1;
+	}
+
+	void ER_TextureCooker::AddScene(const std::string& aScenePath)
+	{
+		ER_SceneDocument document;
+		document.Load(aScenePath);
+		Json::Value& root = document.GetRoot();
+
+		const char* meshTextureFields[] = { "albedo", "normal", "roughness", "metalness", "height", "reflection_mask" };
+		const ER_TextureCookerUsage meshTextureUsages[] = { COOKER_TEXTURE_ALBEDO, COOKER_TEXTURE_NORMAL, COOKER_TEXTURE_MASK, COOKER_TEXTURE_MASK, COOKER_TEXTURE_MASK, COOKER_TEXTURE_MASK };
+
+		const char* materialTextureFields[] = { "snow_albedo", "snow_normal", "snow_roughness", "fur_height" };
+		const ER_TextureCookerUsage materialTextureUsages[] = { COOKER_TEXTURE_ALBEDO, COOKER_TEXTURE_NORMAL, COOKER_TEXTURE_MASK, COOKER_TEXTURE_MASK };
+
+		const size_t jobsCountBefore = mJobs.size();
+		for (Json::Value::ArrayIndex i = 0; i != root["rendering_objects"].size(); i++)
+		{
+			const Json::Value& object = root["rendering_objects"][i];
+
+			if (object.isMember("textures"))
+			{
+				for (Json::Value::ArrayIndex meshIndex = 0; meshIndex != object["textures"].size(); meshIndex++)
+				{
+					for (int field = 0; field < ARRAYSIZE(meshTextureFields); field++)
+					{
+						if (object["textures"][meshIndex].isMember(meshTextureFields[field]))
+							AddTexture(object["textures"][meshIndex][meshTextureFields[field]].asString(), meshTextureUsages[field]);
+					}
+				}
+			}
+
+			for (int field = 0; field < ARRAYSIZE(materialTextureFields); field++)
+			{
+				if (object.isMember(materialTextureFields[field]))
+					AddTexture(object[materialTextureFields[field]].asString(), materialTextureUsages[field]);
+			}
+		}
+
+		std::wstring msg = L"[ER Logger][ER_TextureCooker] Found " + std::to_wstring(mJobs.size() - jobsCountBefore) + L" new texture(s) in level: " + ER_Utility::ToWideString(aScenePath) + L'\n';
+		Log(msg);
+	}
+
+	// Adds the texture and all its quality versions (the same postfixes that ER_RenderingObject::LoadTexture() tries)
+	void ER_TextureCooker::AddTexture(const std::string& aRelativePath, ER_TextureCookerUsage aUsage)
+	{
+		const int extensionSymbolCount = 4; // .png, .dds, etc.
+		if (aRelativePath.length() <= extensionSymbolCount || aRelativePath.back() == '\\')
+			return;
+
+		const std::wstring path = ER_Utility::GetFilePath(ER_Utility::ToWideString(aRelativePath));
+		const wchar_t* postfixQuality[] = { L"", L"_lq", L"_mq", L"_hq" };
+		for (int i = 0; i < ARRAYSIZE(postfixQuality); i++)
+		{
+			std::wstring qualityPath = path;
+			qualityPath.insert(path.length() - extensionSymbolCount, std::wstring(postfixQuality[i]));
+
+			if (GetFileAttributesW(qualityPath.c_str()) == INVALID_FILE_ATTRIBUTES)
+				continue;
+
+			auto it = std::find_if(mJobs.begin(), mJobs.end(), [&qualityPath](const CookJob& job) { return job.sourcePath == qualityPath; });
+			if (it != mJobs.end())
+				continue;
+
+			CookJob job;
+			job.sourcePath = qualityPath;
+			job.usage = aUsage;
+			mJobs.push_back(job);
+		}
+	}
+
+	int ER_TextureCooker::Cook()
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		LoadManifest();
+
+		// every job is independent, so we just spread them over all cores (BC encoding is the bottleneck)
+		const UINT workersCount = std::max(1u, std::min(std::thread::hardware_concurrency(), static_cast<UINT>(mJobs.size())));
+		std::atomic<UINT> nextJob{ 0 };
+		std::vector<std::thread> workers;
+		workers.reserve(workersCount);
+		for (UINT i = 0; i < workersCount; i++)
+		{
+			workers.push_back(std::thread([this, &nextJob]
+			{
+				// WIC decoders need COM on every thread that uses them
+				CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+				for (UINT jobIndex = nextJob++; jobIndex < static_cast<UINT>(mJobs.size()); jobIndex = nextJob++)
+					CookTexture(mJobs[jobIndex]);
+				CoUninitialize();
+			}));
+		}
+		for (auto& worker : workers)
+			worker.join();
+
+		for (auto& job : mJobs)
+		{
+			if (!job.isFailed && job.hash)
+				mManifest[job.sourcePath] = job.hash;
+		}
+		SaveManifest();
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		const double seconds = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() / 1000.0;
+
+		std::wstring msg = L"[ER Logger][ER_TextureCooker] Done in " + std::to_wstring(seconds) + L" s on " + std::to_wstring(workersCount) + L" thread(s): " +
+			std::to_wstring(mCookedCount) + L" cooked, " + std::to_wstring(mSkippedCount) + L" up to date, " + std::to_wstring(mFailedCount) + L" failed (" +
+			std::to_wstring(mBytesWritten / (1024 * 1024)) + L" MB written)\n";
+		Log(msg);
+
+		return static_cast<int>(mFailedCount);
+	}
+
+	void ER_TextureCooker::CookTexture(CookJob& aJob)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		auto fail = [this, &aJob](const std::wstring& aReason)
+		{
+			aJob.isFailed = true;
+			mFailedCount++;
+			Log(L"[ER Logger][ER_TextureCooker] Failed to cook texture (" + aReason + L"): " + aJob.sourcePath + L'\n');
+		};
+
+		std::vector<uint8_t> fileData;
+		{
+			std::ifstream file(aJob.sourcePath.c_str(), std::ifstream::binary | std::ifstream::ate);
+			if (!file.is_open())
+				return fail(L"could not open the file");
+
+			fileData.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0, std::ios::beg);
+			if (fileData.empty() || !file.read(reinterpret_cast<char*>(fileData.data()), fileData.size()))
+				return fail(L"could not read the file");
+		}
+
+		const std::wstring cookedPath = GetCookedPath(aJob.sourcePath);
+		aJob.hash = HashContents(fileData, aJob.usage);
+		if (!mIsForced && GetFileAttributesW(cookedPath.c_str()) != INVALID_FILE_ATTRIBUTES)
+		{
+			auto it = mManifest.find(aJob.sourcePath); // read-only while cooking
+			if (it != mManifest.end() && it->second == aJob.hash)
+			{
+				aJob.isSkipped = true;
+				mSkippedCount++;
+				return;
+			}
+		}
+
+		std::wstring extension;
+		ER_Utility::GetPathExtension(aJob.sourcePath, extension);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::towlower);
+
+		// the shaders do the gamma conversion themselves, so sRGB formats are ignored (same as on the runtime's loading path)
+		HRESULT hr;
+		DirectX::ScratchImage image;
+		if (extension == L".dds")
+			hr = DirectX::LoadFromDDSMemory(fileData.data(), fileData.size(), DirectX::DDS_FLAGS_NONE, nullptr, image);
+		else if (extension == L".tga")
+			hr = DirectX::LoadFromTGAMemory(fileData.data(), fileData.size(), DirectX::TGA_FLAGS_NONE, nullptr, image);
+		else
+			hr = DirectX::LoadFromWICMemory(fileData.data(), fileData.size(), DirectX::WIC_FLAGS_IGNORE_SRGB, nullptr, image);
+		if (FAILED(hr))
+			return fail(L"could not decode the file");
+
+		const DirectX::TexMetadata& metadata = image.GetMetadata();
+		if (metadata.dimension != DirectX::TEX_DIMENSION_TEXTURE2D || metadata.arraySize > 1 || DirectX::IsCompressed(metadata.format))
+		{
+			// already cooked by hand (or not a material texture): the runtime keeps loading the source
+			aJob.isSkipped = true;
+			mSkippedCount++;
+			return;
+		}
+
+		// full chain from the top mip: box filter (SIMD, non-WIC path) for power of two textures, triangle filter otherwise
+		DirectX::TEX_FILTER_FLAGS filter = DirectX::TEX_FILTER_FORCE_NON_WIC;
+		filter |= (IsPowerOfTwo(metadata.width) && IsPowerOfTwo(metadata.height)) ? DirectX::TEX_FILTER_BOX : DirectX::TEX_FILTER_TRIANGLE;
+		if (aJob.usage == COOKER_TEXTURE_ALBEDO)
+			filter |= DirectX::TEX_FILTER_SRGB; // average in linear space, otherwise mips get darker
+
+		DirectX::ScratchImage mipChain;
+		if (FAILED(DirectX::GenerateMipMaps(*image.GetImage(0, 0, 0), filter, 0, mipChain)))
+			return fail(L"could not generate mips");
+
+		// BC textures must have the top mip dimensions aligned to the block size
+		DirectX::ScratchImage compressedImage;
+		DirectX::ScratchImage* result = &mipChain;
+		if (mipChain.GetMetadata().width % 4 == 0 && mipChain.GetMetadata().height % 4 == 0)
+		{
+			const DXGI_FORMAT format = GetCompressedFormat(aJob.usage, !mipChain.IsAlphaAllOpaque());
+			if (FAILED(DirectX::Compress(mipChain.GetImages(), mipChain.GetImageCount(), mipChain.GetMetadata(), format, DirectX::TEX_COMPRESS_DEFAULT,
+				DirectX::TEX_THRESHOLD_DEFAULT, compressedImage)))
+				return fail(L"could not compress");
+			result = &compressedImage;
+		}
+		else
+			Log(L"[ER Logger][ER_TextureCooker] Texture size is not a multiple of 4, keeping it uncompressed: " + aJob.sourcePath + L'\n');
+
+		// write to a temp file first, so that the runtime never sees a half-written texture
+		const std::wstring tempPath = cookedPath + L".tmp";
+		if (FAILED(DirectX::SaveToDDSFile(result->GetImages(), result->GetImageCount(), result->GetMetadata(), DirectX::DDS_FLAGS_NONE, tempPath.c_str())))
+		{
+			DeleteFileW(tempPath.c_str());
+			return fail(L"could not write the DDS file");
+		}
+		if (!MoveFileExW(tempPath.c_str(), cookedPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+		{
+			DeleteFileW(tempPath.c_str());
+			return fail(L"could not replace the cooked file");
+		}
+
+		mCookedCount++;
+		mBytesWritten += result->GetPixelsSize();
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		const long long milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+		std::wstring msg = L"[ER Logger][ER_TextureCooker] Cooked texture in " + std::to_wstring(milliseconds) + L" ms (" +
+			std::to_wstring(result->GetMetadata().mipLevels) + L" mips, DXGI format " + std::to_wstring(result->GetMetadata().format) + L"): " + cookedPath + L'\n';
+		Log(msg);
+	}
+
+	DXGI_FORMAT ER_TextureCooker::GetCompressedFormat(ER_TextureCookerUsage aUsage, bool hasAlpha) const
+	{
+		switch (aUsage)
+		{
+		case COOKER_TEXTURE_ALBEDO:
+			if (mIsFast)
+				return hasAlpha ? DXGI_FORMAT_BC3_UNORM : DXGI_FORMAT_BC1_UNORM;
+			return DXGI_FORMAT_BC7_UNORM;
+		case COOKER_TEXTURE_NORMAL:
+			// not BC5: the shaders read all three components of the normal map
+			return mIsFast ? DXGI_FORMAT_BC1_UNORM : DXGI_FORMAT_BC7_UNORM;
+		case COOKER_TEXTURE_MASK:
+		default:
+			return hasAlpha ? DXGI_FORMAT_BC3_UNORM : DXGI_FORMAT_BC1_UNORM;
+		}
+	}
+
+	// FNV-1a of the source contents + everything that changes the cooked result
+	UINT64 ER_TextureCooker::HashContents(const std::vector<uint8_t>& aData, ER_TextureCookerUsage aUsage) const
+	{
+		UINT64 hash = 14695981039346656037ull;
+		auto hashByte = [&hash](uint8_t value)
+		{
+			hash ^= value;
+			hash *= 1099511628211ull;
+		};
+
+		for (uint8_t value : aData)
+			hashByte(value);
+		hashByte(static_cast<uint8_t>(ER_TEXTURE_COOKER_VERSION));
+		hashByte(static_cast<uint8_t>(aUsage));
+		hashByte(static_cast<uint8_t>(mIsFast));
+
+		return hash;
+	}
+
+	void ER_TextureCooker::LoadManifest()
+	{
+		mManifest.clear();
+
+		std::ifstream file(mManifestPath.c_str(), std::ifstream::binary);
+		if (!file.is_open()) // first cook
+			return;
+
+		Json::Reader reader;
+		Json::Value root;
+		if (!reader.parse(file, root))
+		{
+			Log(L"[ER Logger][ER_TextureCooker] Could not parse the manifest, recooking everything\n");
+			return;
+		}
+
+		const std::wstring rootDirectory = ER_Utility::GetFilePath(std::wstring());
+		for (Json::Value::ArrayIndex i = 0; i != root["textures"].size(); i++)
+		{
+			const std::wstring path = rootDirectory + ER_Utility::ToWideString(root["textures"][i]["path"].asString());
+			mManifest[path] = std::stoull(root["textures"][i]["hash"].asString(), nullptr, 16);
+		}
+	}
+
+	void ER_TextureCooker::SaveManifest()
+	{
+		// paths are stored relative to the root, so that the manifest survives moving the repository
+		const std::wstring rootDirectory = ER_Utility::GetFilePath(std::wstring());
+
+		Json::Value root;
+		root["textures"] = Json::Value(Json::arrayValue);
+		for (auto& entry : mManifest)
+		{
+			std::wstring path = entry.first;
+			if (path.compare(0, rootDirectory.length(), rootDirectory) == 0)
+				path = path.substr(rootDirectory.length());
+
+			std::stringstream hash;
+			hash << std::hex << entry.second;
+
+			Json::Value texture;
+			texture["path"] = ToUTF8(path);
+			texture["hash"] = hash.str();
+			root["textures"].append(texture);
+		}
+
+		std::ofstream file(mManifestPath.c_str(), std::ofstream::binary | std::ofstream::trunc);
+		if (!file.is_open())
+			throw ER_CoreException("ER_TextureCooker: Could not write the manifest file");
+
+		Json::StreamWriterBuilder builder;
+		file << Json::writeString(builder, root);
+	}
+
+	std::wstring ER_TextureCooker::GetCookedPath(const std::wstring& aSourcePath)
+	{
+		// the source extension is kept, so that "a.png" and "a.jpg" do not end up in the same file
+		return aSourcePath + ER_TEXTURE_COOKER_POSTFIX;
+	}
+
+	std::wstring ER_TextureCooker::GetPreferredPath(const std::wstring& aSourcePath)
+	{
+		const std::wstring cookedPath = GetCookedPath(aSourcePath);
+
+		WIN32_FILE_ATTRIBUTE_DATA cookedAttributes;
+		if (!GetFileAttributesExW(cookedPath.c_str(), GetFileExInfoStandard, &cookedAttributes))
+			return aSourcePath;
+
+		// source was edited after the last cook
+		WIN32_FILE_ATTRIBUTE_DATA sourceAttributes;
+		if (GetFileAttributesExW(aSourcePath.c_str(), GetFileExInfoStandard, &sourceAttributes) &&
+			CompareFileTime(&sourceAttributes.ftLastWriteTime, &cookedAttributes.ftLastWriteTime) > 0)
+			return aSourcePath;
+
+		return cookedPath;
+	}
+
+	void ER_TextureCooker::Log(const std::wstring& aMessage)
+	{
+		static std::mutex logMutex;
+		const std::lock_guard<std::mutex> lock(logMutex);
+
+		ER_OUTPUT_LOG(aMessage.c_str());
+		fputws(aMessage.c_str(), stdout);
+		fflush(stdout);
+	}
+}
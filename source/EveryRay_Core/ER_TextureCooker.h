@@ -0,0 +1,77 @@
+// Offline texture cooker in EveryRay Rendering Engine
+// Scans the material fields of the levels' rendering objects and cooks the referenced textures into DDS files
+// (full mip chain filtered in linear space + BC compression) next to the source files. The runtime loads a cooked file instead of its source
+// automatically (see GetPreferredPath()), so no mips have to be generated at load time.
+// Cooking is incremental: the manifest stores a content hash of every source texture (+ cooking settings) and unchanged textures are skipped.
+//
+// Usage (from the runtime executable): EveryRay_Runtime_Win64_DX12.exe -cooktextures [level name, all levels if empty] [-fast] [-force]
+
+#pragma once
+#include "Common.h"
+
+#include <atomic>
+
+#define ER_TEXTURE_COOKER_VERSION 1 // bump to recook everything (i.e., after changing formats or filters)
+#define ER_TEXTURE_COOKER_POSTFIX L".cooked.dds"
+
+namespace EveryRay_Core
+{
+	enum ER_TextureCookerUsage
+	{
+		COOKER_TEXTURE_ALBEDO = 0, // sRGB data: mips are filtered in linear space
+		COOKER_TEXTURE_NORMAL,
+		COOKER_TEXTURE_MASK, // roughness, metalness, height, etc.
+
+		COOKER_TEXTURE_USAGE_COUNT
+	};
+
+	class ER_TextureCooker
+	{
+	public:
+		// 'isFast' uses BC1/BC3 instead of BC7 (much faster to encode), 'isForced' ignores the manifest and recooks everything
+		ER_TextureCooker(bool isFast = false, bool isForced = false);
+		~ER_TextureCooker();
+
+		// Parses the command line of the runtime and cooks the requested levels; returns the exit code of the process
+		static int RunFromCommandLine(const std::string& aCommandLine);
+
+		void AddScene(const std::string& aScenePath);
+		// Cooks all added textures on all cores; returns the number of textures that failed
+		int Cook();
+
+		static std::wstring GetCookedPath(const std::wstring& aSourcePath);
+		// Returns the cooked texture if it exists and is not older than its source, otherwise the source itself
+		static std::wstring GetPreferredPath(const std::wstring& aSourcePath);
+	private:
+		struct CookJob
+		{
+			std::wstring sourcePath;
+			ER_TextureCookerUsage usage = COOKER_TEXTURE_MASK;
+			UINT64 hash = 0;
+			bool isSkipped = false;
+			bool isFailed = false;
+		};
+
+		void AddTexture(const std::string& aRelativePath, ER_TextureCookerUsage aUsage);
+		void CookTexture(CookJob& aJob);
+		DXGI_FORMAT GetCompressedFormat(ER_TextureCookerUsage aUsage, bool hasAlpha) const;
+		UINT64 HashContents(const std::vector<uint8_t>& aData, ER_TextureCookerUsage aUsage) const;
+
+		void LoadManifest();
+		void SaveManifest();
+
+		static void Log(const std::wstring& aMessage);
+
+		std::vector<CookJob> mJobs;
+		std::map<std::wstring, UINT64> mManifest; // source path -> hash of the last cooked contents
+		std::string mManifestPath;
+
+		bool mIsFast = false;
+		bool mIsForced = false;
+
+		std::atomic<UINT> mCookedCount{ 0 };
+		std::atomic<UINT> mSkippedCount{ 0 };
+		std::atomic<UINT> mFailedCount{ 0 };
+		std::atomic<UINT64> mBytesWritten{ 0 };
+	};
+}
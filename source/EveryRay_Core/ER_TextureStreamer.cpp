@@ -0,0 +1,686 @@
+#include "stdafx.h"
+#include <algorithm>
+
+#include "ER_TextureStreamer.h"
+#include "ER_TextureCooker.h"
+#include "ER_Core.h"
+#include "ER_CoreTime.h"
+#include "ER_CoreException.h"
+#include "ER_Utility.h"
+
+#include "RHI/ER_RHI.h"
+
+namespace EveryRay_Core
+{
+	RTTI_DEFINITIONS(ER_TextureStreamer)
+
+	ER_TextureStreamer::ER_TextureStreamer(ER_Core& game) : ER_CoreComponent(game)
+	{
+		const UINT workersCount = std::max(1u, std::thread::hardware_concurrency() / 2);
+		mWorkers.reserve(workersCount);
+		for (UINT i = 0; i < workersCount; i++)
+			mWorkers.push_back(std::thread([this] { WorkerLoop(); }));
+	}
+
+	ER_TextureStreamer::~ER_TextureStreamer()
+	{
+		{
+			const std::lock_guard<std::mutex> lock(mDecodeQueueMutex);
+			mIsShuttingDown = true;
+		}
+		mDecodeQueueCondition.notify_all();
+		for (auto& worker : mWorkers)
+			worker.join();
+		mWorkers.clear();
+
+		Clear();
+	}
+
+	ER_TextureStreamer::CacheShard& ER_TextureStreamer::GetShard(const std::wstring& aFullPath)
+	{
+		return mShards[std::hash<std::wstring>()(aFullPath) % ER_TEXTURE_STREAMER_CACHE_SHARDS];
+	}
+
+	void ER_TextureStreamer::CreatePlaceholderTexture()
+	{
+		assert(!mPlaceholderTexture);
+		ER_RHI* rhi = mCore->GetRHI();
+
+		// 1x1 flat normal (0.5, 0.5, 1.0): neutral enough for every material slot and keeps normal mapping valid while streaming
+		DirectX::ScratchImage image;
+		if (FAILED(image.Initialize2D(DXGI_FORMAT_R8G8B8A8_UNORM, 1, 1, 1, 1)))
+			throw ER_CoreException("ER_TextureStreamer: Could not initialize the placeholder image");
+		uint8_t* pixel = image.GetPixels();
+		pixel[0] = 128;
+		pixel[1] = 128;
+		pixel[2] = 255;
+		pixel[3] = 255;
+
+		mPlaceholderTexture = rhi->CreateGPUTexture(L"ER_TextureStreamer: placeholder");
+		rhi->BeginCopyCommandList();
+		mPlaceholderTexture->CreateGPUTextureResource(rhi, image, true);
+		rhi->EndCopyCommandList();
+		rhi->ExecuteCopyCommandList();
+	}
+
+	ER_RHI_GPUTexture* ER_TextureStreamer::RequestTexture(const std::wstring& aFullPath, const std::function<void(ER_RHI_GPUTexture*)>& aOnReady,
+		bool* didExist, bool* statusFlag, bool isSilent)
+	{
+		assert(mPlaceholderTexture);
+		CacheShard& shard = GetShard(aFullPath);
+
+		{
+			const std::lock_guard<std::mutex> lock(shard.mutex);
+			auto it = shard.entries.find(aFullPath);
+			if (it != shard.entries.end())
+			{
+				if (didExist)
+					*didExist = true;
+				if (aOnReady)
+					it->second.listeners.push_back(aOnReady);
+				return it->second.texture;
+			}
+		}
+
+		if (didExist)
+			*didExist = false;
+
+		// cheap check instead of a failed decode (i.e., for quality postfixes like "_hq" that most textures do not have)
+		if (GetFileAttributesW(aFullPath.c_str()) == INVALID_FILE_ATTRIBUTES && statusFlag)
+		{
+			*statusFlag = false;
+			if (!isSilent)
+			{
+				std::wstring msg = L"[ER Logger][ER_TextureStreamer] Texture does not exist on disk: " + aFullPath + L'\n';
+				ER_OUTPUT_LOG(msg.c_str());
+			}
+			return nullptr;
+		}
+		// without 'statusFlag' the caller wants a texture in any case: a missing file fails on the worker and gets the fallback texture on upload
+
+		{
+			const std::lock_guard<std::mutex> lock(shard.mutex);
+			auto result = shard.entries.emplace(aFullPath, CacheEntry());
+			CacheEntry& entry = result.first->second;
+			if (!result.second) // requested from another thread in the meantime
+			{
+				if (didExist)
+					*didExist = true;
+				if (aOnReady)
+					entry.listeners.push_back(aOnReady);
+				return entry.texture;
+			}
+
+			entry.texture = mPlaceholderTexture;
+			entry.isStreaming = true;
+			if (aOnReady)
+				entry.listeners.push_back(aOnReady);
+		}
+
+		if (statusFlag)
+			*statusFlag = true;
+
+		mPendingRequests++;
+		{
+			const std::lock_guard<std::mutex> lock(mDecodeQueueMutex);
+			mDecodeQueue.push_back(std::make_pair(aFullPath, mGeneration.load()));
+		}
+		mDecodeQueueCondition.notify_one();
+
+		return mPlaceholderTexture;
+	}
+
+	void ER_TextureStreamer::WorkerLoop()
+	{
+		// WIC decoders need COM on every thread that uses them
+		CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+
+		while (true)
+		{
+			std::pair<std::wstring, UINT> job;
+			{
+				std::unique_lock<std::mutex> lock(mDecodeQueueMutex);
+				mDecodeQueueCondition.wait(lock, [this] { return mIsShuttingDown || !mDecodeQueue.empty(); });
+				if (mIsShuttingDown)
+					break;
+
+				job = std::move(mDecodeQueue.front());
+				mDecodeQueue.pop_front();
+			}
+
+			std::unique_ptr<DecodedTexture> decodedTexture = std::make_unique<DecodedTexture>();
+			decodedTexture->path = job.first;
+			decodedTexture->generation = job.second;
+			if (job.second == mGeneration) // skip requests of the previous level
+				Decode(*decodedTexture);
+
+			const std::lock_guard<std::mutex> lock(mDecodedQueueMutex);
+			mDecodedQueue.push_back(std::move(decodedTexture));
+		}
+
+		CoUninitialize();
+	}
+
+	void ER_TextureStreamer::Decode(DecodedTexture& aTexture)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		// cooked textures (mips + BC compression done offline) are preferred over their sources
+		const std::wstring filePath = ER_TextureCooker::GetPreferredPath(aTexture.path);
+
+		std::vector<uint8_t> fileData;
+		{
+			std::ifstream file(filePath.c_str(), std::ifstream::binary | std::ifstream::ate);
+			if (!file.is_open())
+				return;
+
+			fileData.resize(static_cast<size_t>(file.tellg()));
+			file.seekg(0, std::ios::beg);
+			if (fileData.empty() || !file.read(reinterpret_cast<char*>(fileData.data()), fileData.size()))
+				return;
+		}
+		mBytesRead += fileData.size();
+
+		std::wstring extension = filePath.substr(filePath.find_last_of(L'.') + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::towlower);
+
+		HRESULT hr;
+		DirectX::TexMetadata metadata;
+		if (extension == L"dds")
+			hr = DirectX::LoadFromDDSMemory(fileData.data(), fileData.size(), DirectX::DDS_FLAGS_NONE, &metadata, aTexture.image);
+		else if (extension == L"tga")
+			hr = DirectX::LoadFromTGAMemory(fileData.data(), fileData.size(), DirectX::TGA_FLAGS_NONE, &metadata, aTexture.image);
+		else
+			hr = DirectX::LoadFromWICMemory(fileData.data(), fileData.size(), DirectX::WIC_FLAGS_NONE, &metadata, aTexture.image);
+
+		if (FAILED(hr))
+			return;
+
+		// generate the mip chain here instead of on the GPU (with texture replacement) as it used to be for textures loaded from disk
+		if (metadata.mipLevels == 1 && metadata.dimension == DirectX::TEX_DIMENSION_TEXTURE2D && !DirectX::IsCompressed(metadata.format) &&
+			(metadata.width > 1 || metadata.height > 1))
+		{
+			DirectX::ScratchImage mipChain;
+			if (SUCCEEDED(DirectX::GenerateMipMaps(aTexture.image.GetImages(), aTexture.image.GetImageCount(), metadata, DirectX::TEX_FILTER_DEFAULT, 0, mipChain)))
+				aTexture.image = std::move(mipChain);
+		}
+
+		// block-compressed sub-chains must start at a multiple of 4, which is only guaranteed for power of two textures
+		const DirectX::TexMetadata& finalMetadata = aTexture.image.GetMetadata();
+		const bool isBlockAligned = !DirectX::IsCompressed(finalMetadata.format) ||
+			((finalMetadata.width & (finalMetadata.width - 1)) == 0 && (finalMetadata.height & (finalMetadata.height - 1)) == 0);
+		aTexture.isMipStreamable = finalMetadata.dimension == DirectX::TEX_DIMENSION_TEXTURE2D &&
+			finalMetadata.arraySize == 1 && !finalMetadata.IsCubemap() && finalMetadata.mipLevels > 1 && isBlockAligned;
+		aTexture.uploadBytes = aTexture.image.GetPixelsSize();
+		if (aTexture.isMipStreamable)
+		{
+			// start with the mip tail only
+			const UINT mipLevels = static_cast<UINT>(finalMetadata.mipLevels);
+			const DirectX::Image* images = aTexture.image.GetImages();
+			aTexture.uploadBytes = 0;
+			for (int mip = static_cast<int>(mipLevels) - 1; mip >= 0; mip--)
+			{
+				if (std::max(images[mip].width, images[mip].height) <= ER_TEXTURE_STREAMER_MIN_RESIDENT_SIZE)
+					aTexture.firstMip = static_cast<UINT>(mip);
+			}
+			if (aTexture.firstMip == 0 && std::max(images[0].width, images[0].height) > ER_TEXTURE_STREAMER_MIN_RESIDENT_SIZE)
+				aTexture.firstMip = mipLevels - 1;
+			for (UINT mip = aTexture.firstMip; mip < mipLevels; mip++)
+				aTexture.uploadBytes += images[mip].slicePitch;
+		}
+
+		aTexture.isValid = true;
+
+		auto endTime = std::chrono::high_resolution_clock::now();
+		mDecodeTimeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime).count();
+		mDecodedTexturesCount++;
+	}
+
+	// Uploads decoded textures and mip residency changes (up to the per-frame budget) in one copy queue batch and swaps the textures
+	void ER_TextureStreamer::Update(const ER_CoreTime& gameTime)
+	{
+		mFrameIndex++;
+		DeleteRetiredTextures(false);
+
+		mBytesUploadedLastFrame = 0;
+		mTexturesUploadedLastFrame = 0;
+		mMipsStreamedInLastFrame = 0;
+		mMipsEvictedLastFrame = 0;
+
+		std::vector<std::unique_ptr<DecodedTexture>> batch;
+		{
+			const std::lock_guard<std::mutex> lock(mDecodedQueueMutex);
+			while (!mDecodedQueue.empty() && (batch.empty() || mBytesUploadedLastFrame < ER_TEXTURE_STREAMER_UPLOAD_BUDGET_BYTES))
+			{
+				std::unique_ptr<DecodedTexture> decodedTexture = std::move(mDecodedQueue.front());
+				mDecodedQueue.pop_front();
+
+				if (decodedTexture->generation != mGeneration)
+				{
+					mPendingRequests--;
+					continue;
+				}
+
+				mBytesUploadedLastFrame += decodedTexture->uploadBytes;
+				batch.push_back(std::move(decodedTexture));
+			}
+		}
+
+		// held until the textures are swapped, so that removed textures are not retired/swapped here as well
+		const std::lock_guard<std::mutex> residencyLock(mResidencyMutex);
+
+		std::vector<TextureUpload> uploads;
+		uploads.reserve(batch.size());
+		for (auto& decodedTexture : batch)
+		{
+			TextureUpload upload = { &decodedTexture->path, decodedTexture->isValid ? &decodedTexture->image : nullptr, 0, nullptr, nullptr };
+
+			if (decodedTexture->isValid && decodedTexture->isMipStreamable)
+			{
+				std::unique_ptr<ResidencyInfo> info = std::make_unique<ResidencyInfo>();
+				info->path = decodedTexture->path;
+				info->image = std::move(decodedTexture->image);
+
+				const UINT mipLevels = static_cast<UINT>(info->image.GetMetadata().mipLevels);
+				const DirectX::Image* images = info->image.GetImages();
+				info->chainBytes.resize(mipLevels + 1, 0);
+				for (int mip = static_cast<int>(mipLevels) - 1; mip >= 0; mip--)
+					info->chainBytes[mip] = info->chainBytes[mip + 1] + images[mip].slicePitch;
+				info->maxResidentMip = decodedTexture->firstMip;
+
+				// start with the mip tail only, the rest comes with the usage feedback
+				info->residentMip = info->plannedMip = info->desiredMip = info->maxResidentMip;
+				info->lastUsedFrame = mFrameIndex;
+
+				upload.image = &info->image;
+				upload.firstMip = info->residentMip;
+				upload.residency = info.get();
+				mResidency[info->path] = std::move(info);
+			}
+			uploads.push_back(upload);
+		}
+
+		const size_t newTexturesCount = uploads.size();
+		PlanResidency(uploads, mBytesUploadedLastFrame);
+
+		if (uploads.empty())
+			return;
+
+		ER_RHI* rhi = mCore->GetRHI();
+
+		rhi->BeginCopyCommandList();
+		for (auto& upload : uploads)
+		{
+			upload.texture = rhi->CreateGPUTexture(*upload.path);
+			if (upload.image)
+				upload.texture->CreateGPUTextureResource(rhi, *upload.image, true, upload.firstMip);
+		}
+		rhi->EndCopyCommandList();
+		rhi->ExecuteCopyCommandList(); // waits for the copy fence
+
+		for (size_t i = 0; i < uploads.size(); i++)
+		{
+			TextureUpload& upload = uploads[i];
+			const bool isNewTexture = i < newTexturesCount;
+
+			if (!upload.image) // goes through the regular loading path which logs the error and loads the fallback texture
+				upload.texture->CreateGPUTextureResource(rhi, *upload.path, true);
+
+			if (ResidencyInfo* info = upload.residency)
+			{
+				if (info->texture)
+				{
+					mResidencyByTexture.erase(info->texture);
+					mRetiredTextures.push_back(std::make_pair(info->texture, mFrameIndex));
+					mResidentBytes -= info->chainBytes[info->residentMip];
+				}
+				info->texture = upload.texture;
+				info->residentMip = upload.firstMip;
+				mResidentBytes += info->chainBytes[info->residentMip];
+				mResidencyByTexture[info->texture] = info;
+			}
+
+			if (!SwapTexture(*upload.path, upload.texture)) // removed while streaming
+			{
+				if (upload.residency)
+				{
+					mResidencyByTexture.erase(upload.texture);
+					mResidentBytes -= upload.residency->chainBytes[upload.residency->residentMip];
+					mResidency.erase(*upload.path);
+				}
+				DeleteObject(upload.texture);
+			}
+
+			if (isNewTexture)
+			{
+				mPendingRequests--;
+				mTexturesUploadedLastFrame++;
+				mTexturesUploadedTotal++;
+
+				std::wstring msg = L"[ER Logger][ER_TextureStreamer] Streamed in texture to rendering objects' texture cache: " + *upload.path + L'\n';
+				ER_OUTPUT_LOG(msg.c_str());
+			}
+		}
+	}
+
+	bool ER_TextureStreamer::SwapTexture(const std::wstring& aFullPath, ER_RHI_GPUTexture* aTexture)
+	{
+		std::vector<std::function<void(ER_RHI_GPUTexture*)>> listeners;
+		{
+			CacheShard& shard = GetShard(aFullPath);
+			const std::lock_guard<std::mutex> lock(shard.mutex);
+			auto it = shard.entries.find(aFullPath);
+			if (it == shard.entries.end())
+				return false;
+
+			it->second.texture = aTexture;
+			it->second.isStreaming = false;
+			listeners = it->second.listeners;
+		}
+
+		for (auto& listener : listeners)
+			listener(aTexture);
+		return true;
+	}
+
+	void ER_TextureStreamer::ReportTextureUsage(ER_RHI_GPUTexture* aTexture, float aPixelsOnScreen, int aMipBias)
+	{
+		const std::lock_guard<std::mutex> residencyLock(mResidencyMutex);
+		auto it = mResidencyByTexture.find(aTexture);
+		if (it == mResidencyByTexture.end())
+			return;
+
+		ResidencyInfo& info = *it->second;
+		const DirectX::Image* topMip = info.image.GetImages();
+		const float texels = static_cast<float>(std::max(topMip->width, topMip->height));
+
+		// we assume the texture is mapped once over the object, so one texel per pixel is the mip we need
+		int mip = (aPixelsOnScreen >= texels) ? 0 : static_cast<int>(floorf(log2f(texels / std::max(aPixelsOnScreen, 1.0f))));
+		mip = std::max(0, std::min(mip + aMipBias, static_cast<int>(info.maxResidentMip)));
+		info.requiredMip = std::min(info.requiredMip, static_cast<UINT>(mip));
+	}
+
+	// Decides which mips should be resident after this frame and appends the textures that have to be recreated to 'aUploads'
+	void ER_TextureStreamer::PlanResidency(std::vector<TextureUpload>& aUploads, UINT64& aUploadBytes)
+	{
+		if (mResidency.empty())
+			return;
+
+		const UINT64 budgetBytes = static_cast<UINT64>(mVRAMBudgetMB) * 1024 * 1024;
+		UINT64 plannedBytes = mResidentBytes;
+
+		std::vector<ResidencyInfo*> lru;
+		lru.reserve(mResidency.size());
+		for (auto& it : mResidency)
+		{
+			ResidencyInfo& info = *it.second;
+			info.plannedMip = info.residentMip;
+			if (info.requiredMip != UINT_MAX)
+			{
+				info.desiredMip = info.requiredMip;
+				info.lastUsedFrame = mFrameIndex - 1; // feedback was reported in the previous frame
+				info.requiredMip = UINT_MAX;
+			}
+			if (info.texture) // not uploaded yet (new textures are already in 'aUploads')
+				lru.push_back(&info);
+		}
+		std::sort(lru.begin(), lru.end(), [](const ResidencyInfo* a, const ResidencyInfo* b) { return a->lastUsedFrame < b->lastUsedFrame; });
+
+		// trim textures that have more mips than they need
+		for (ResidencyInfo* info : lru)
+		{
+			if (info->desiredMip > info->plannedMip + ER_TEXTURE_STREAMER_MIP_HYSTERESIS)
+			{
+				plannedBytes -= info->chainBytes[info->plannedMip] - info->chainBytes[info->desiredMip];
+				info->plannedMip = info->desiredMip;
+			}
+		}
+
+		// i.e., the budget was lowered
+		if (plannedBytes > budgetBytes)
+			EvictLeastRecentlyUsed(lru, plannedBytes, budgetBytes, nullptr, mFrameIndex);
+
+		// stream in missing mips: biggest difference first, then the most recently used
+		std::vector<ResidencyInfo*> candidates;
+		for (ResidencyInfo* info : lru)
+		{
+			if (info->desiredMip < info->plannedMip)
+				candidates.push_back(info);
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const ResidencyInfo* a, const ResidencyInfo* b)
+		{
+			const UINT missingA = a->plannedMip - a->desiredMip;
+			const UINT missingB = b->plannedMip - b->desiredMip;
+			return (missingA != missingB) ? missingA > missingB : a->lastUsedFrame > b->lastUsedFrame;
+		});
+
+		for (ResidencyInfo* info : candidates)
+		{
+			if (aUploadBytes >= ER_TEXTURE_STREAMER_UPLOAD_BUDGET_BYTES)
+				break;
+
+			UINT newMip = info->desiredMip;
+			for (; newMip < info->plannedMip; newMip++)
+			{
+				const UINT64 extraBytes = info->chainBytes[newMip] - info->chainBytes[info->plannedMip];
+				if (plannedBytes + extraBytes > budgetBytes) // only evict textures that were used less recently than this one
+					EvictLeastRecentlyUsed(lru, plannedBytes, budgetBytes - std::min(budgetBytes, extraBytes), info, info->lastUsedFrame);
+				if (plannedBytes + extraBytes <= budgetBytes)
+					break;
+			}
+
+			if (newMip < info->plannedMip)
+			{
+				plannedBytes += info->chainBytes[newMip] - info->chainBytes[info->plannedMip];
+				mMipsStreamedInLastFrame += info->plannedMip - newMip;
+				info->plannedMip = newMip;
+				aUploadBytes += info->chainBytes[newMip];
+			}
+		}
+
+		for (ResidencyInfo* info : lru)
+		{
+			if (info->plannedMip == info->residentMip)
+				continue;
+
+			if (info->plannedMip > info->residentMip)
+			{
+				mMipsEvictedLastFrame += info->plannedMip - info->residentMip;
+				aUploadBytes += info->chainBytes[info->plannedMip]; // the texture is recreated with the remaining mips
+			}
+
+			TextureUpload upload = { &info->path, &info->image, info->plannedMip, info, nullptr };
+			aUploads.push_back(upload);
+		}
+	}
+
+	// Drops the top mips of the least recently used textures until 'aPlannedBytes' fits into 'aTargetBytes'
+	void ER_TextureStreamer::EvictLeastRecentlyUsed(const std::vector<ResidencyInfo*>& aLRU, UINT64& aPlannedBytes, UINT64 aTargetBytes,
+		const ResidencyInfo* aExclude, UINT64 aMaxLastUsedFrame)
+	{
+		for (ResidencyInfo* info : aLRU)
+		{
+			if (aPlannedBytes <= aTargetBytes || info->lastUsedFrame >= aMaxLastUsedFrame)
+				break;
+			if (info == aExclude)
+				continue;
+
+			while (aPlannedBytes > aTargetBytes && info->plannedMip < info->maxResidentMip)
+			{
+				aPlannedBytes -= info->chainBytes[info->plannedMip] - info->chainBytes[info->plannedMip + 1];
+				info->plannedMip++;
+			}
+		}
+	}
+
+	void ER_TextureStreamer::DeleteRetiredTextures(bool aForceAll)
+	{
+		while (!mRetiredTextures.empty() && (aForceAll || mFrameIndex - mRetiredTextures.front().second > ER_TEXTURE_STREAMER_RETIRE_FRAMES))
+		{
+			DeleteObject(mRetiredTextures.front().first);
+			mRetiredTextures.pop_front();
+		}
+	}
+
+	ER_RHI_GPUTexture* ER_TextureStreamer::AddOrGetTexture(const std::wstring& aFullPath, bool* didExist, bool is3D, bool skipFallback, bool* statusFlag, bool isSilent)
+	{
+		CacheShard& shard = GetShard(aFullPath);
+		auto findTexture = [&]() -> ER_RHI_GPUTexture*
+		{
+			const std::lock_guard<std::mutex> lock(shard.mutex);
+			auto it = shard.entries.find(aFullPath);
+			return (it != shard.entries.end()) ? it->second.texture : nullptr;
+		};
+
+		if (ER_RHI_GPUTexture* texture = findTexture())
+		{
+			if (didExist)
+				*didExist = true;
+			return texture;
+		}
+
+		const std::lock_guard<std::mutex> loadLock(mImmediateLoadMutex);
+		if (ER_RHI_GPUTexture* texture = findTexture()) // loaded from another thread while we were waiting
+		{
+			if (didExist)
+				*didExist = true;
+			return texture;
+		}
+
+		if (didExist)
+			*didExist = false;
+
+		ER_RHI* rhi = mCore->GetRHI();
+		ER_RHI_GPUTexture* texture = rhi->CreateGPUTexture(aFullPath);
+		texture->CreateGPUTextureResource(rhi, aFullPath, true, is3D, skipFallback, statusFlag, isSilent);
+		if (statusFlag && *statusFlag == false)
+		{
+			DeleteObject(texture);
+			return nullptr;
+		}
+
+		{
+			const std::lock_guard<std::mutex> lock(shard.mutex);
+			shard.entries[aFullPath].texture = texture;
+		}
+
+		std::wstring msg = L"[ER Logger][ER_TextureStreamer] Added new texture to rendering objects' texture cache: " + aFullPath + L'\n';
+		ER_OUTPUT_LOG(msg.c_str());
+
+		return texture;
+	}
+
+	void ER_TextureStreamer::AddTexture(const std::wstring& aFullPath, ER_RHI_GPUTexture* aTexture)
+	{
+		CacheShard& shard = GetShard(aFullPath);
+		const std::lock_guard<std::mutex> lock(shard.mutex);
+		auto result = shard.entries.emplace(aFullPath, CacheEntry());
+		if (result.second)
+			result.first->second.texture = aTexture;
+	}
+
+	bool ER_TextureStreamer::RemoveTexture(const std::wstring& aFullPath, bool removeKey)
+	{
+		const std::lock_guard<std::mutex> residencyLock(mResidencyMutex);
+		CacheShard& shard = GetShard(aFullPath);
+		const std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it = shard.entries.find(aFullPath);
+		if (it == shard.entries.end())
+			return false;
+
+		auto residency = mResidency.find(aFullPath);
+		if (residency != mResidency.end())
+		{
+			mResidencyByTexture.erase(residency->second->texture);
+			mResidentBytes -= residency->second->chainBytes[residency->second->residentMip];
+			mResidency.erase(residency);
+		}
+		if (it->second.texture != mPlaceholderTexture)
+			DeleteObject(it->second.texture);
+		if (removeKey)
+			shard.entries.erase(it);
+
+		return true;
+	}
+
+	void ER_TextureStreamer::ReplaceTexture(const std::wstring& aFullPath, ER_RHI_GPUTexture* aTexture)
+	{
+		const std::lock_guard<std::mutex> residencyLock(mResidencyMutex);
+		CacheShard& shard = GetShard(aFullPath);
+		const std::lock_guard<std::mutex> lock(shard.mutex);
+		auto it = shard.entries.find(aFullPath);
+		if (it != shard.entries.end())
+		{
+			// the texture is not ours anymore, so its mips are not managed either
+			auto residency = mResidency.find(aFullPath);
+			if (residency != mResidency.end())
+			{
+				mResidencyByTexture.erase(residency->second->texture);
+				mResidentBytes -= residency->second->chainBytes[residency->second->residentMip];
+				mResidency.erase(residency);
+			}
+			it->second.texture = aTexture;
+		}
+	}
+
+	bool ER_TextureStreamer::IsTextureInCache(const std::wstring& aFullPath)
+	{
+		CacheShard& shard = GetShard(aFullPath);
+		const std::lock_guard<std::mutex> lock(shard.mutex);
+		return shard.entries.find(aFullPath) != shard.entries.end();
+	}
+
+	void ER_TextureStreamer::Clear()
+	{
+		mGeneration++;
+		{
+			const std::lock_guard<std::mutex> lock(mDecodeQueueMutex);
+			mPendingRequests -= static_cast<UINT>(mDecodeQueue.size());
+			mDecodeQueue.clear();
+		}
+		{
+			const std::lock_guard<std::mutex> lock(mDecodedQueueMutex);
+			mPendingRequests -= static_cast<UINT>(mDecodedQueue.size());
+			mDecodedQueue.clear();
+		}
+		// decodes that are still running on the workers will be dropped in Update() because of the generation mismatch
+
+		const std::lock_guard<std::mutex> residencyLock(mResidencyMutex);
+		for (auto& shard : mShards)
+		{
+			const std::lock_guard<std::mutex> lock(shard.mutex);
+			for (auto& entry : shard.entries)
+			{
+				if (entry.second.texture != mPlaceholderTexture)
+					DeleteObject(entry.second.texture);
+			}
+			shard.entries.clear();
+		}
+		DeleteObject(mPlaceholderTexture);
+
+		mResidencyByTexture.clear();
+		mResidency.clear();
+		mResidentBytes = 0;
+		DeleteRetiredTextures(true);
+	}
+
+	void ER_TextureStreamer::ShowStatsImGui()
+	{
+		const UINT decodedCount = mDecodedTexturesCount;
+		const double decodeTimeMs = static_cast<double>(mDecodeTimeMicroseconds) / 1000.0;
+
+		ImGui::Text("Pending requests (queue depth): %u", mPendingRequests.load());
+		ImGui::Text("Decoded textures: %u (total: %.2f ms, avg: %.2f ms)", decodedCount, decodeTimeMs, decodedCount > 0 ? decodeTimeMs / decodedCount : 0.0);
+		ImGui::Text("Read from disk: %.2f MB", static_cast<double>(mBytesRead) / (1024.0 * 1024.0));
+		ImGui::Text("Uploaded last frame: %u textures (%.2f MB)", mTexturesUploadedLastFrame, static_cast<double>(mBytesUploadedLastFrame) / (1024.0 * 1024.0));
+		ImGui::Text("Uploaded total: %u textures", mTexturesUploadedTotal);
+
+		ImGui::Separator();
+		ImGui::SliderInt("VRAM budget (MB)", &mVRAMBudgetMB, 64, 8192);
+		{
+			const std::lock_guard<std::mutex> residencyLock(mResidencyMutex);
+			ImGui::Text("Mip-streamed textures: %u (resident: %.2f MB)", static_cast<UINT>(mResidency.size()), static_cast<double>(mResidentBytes) / (1024.0 * 1024.0));
+		}
+		ImGui::Text("Mips streamed in last frame: %u, evicted: %u", mMipsStreamedInLastFrame, mMipsEvictedLastFrame);
+	}
+}
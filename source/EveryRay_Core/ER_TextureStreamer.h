@@ -0,0 +1,151 @@
+// Asynchronous texture streamer in EveryRay Rendering Engine
+// Owns the cache of physical textures (on disk) from ER_RenderingObjects in the level.
+// Requested textures are returned as a shared placeholder right away and decoded (+ mips generated) on worker threads.
+// Decoded images are uploaded in batches on the copy queue from the main thread and swapped with the placeholder via callbacks.
+// 2D textures are then kept mip-granular: ER_RenderingObjects report the mip they need (from the screen coverage of their AABBs)
+// and the streamer keeps only those mips on the GPU, within a global VRAM budget (least recently used top mips are evicted first).
+
+#pragma once
+#include "Common.h"
+#include "ER_CoreComponent.h"
+
+#include <deque>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+
+#define ER_TEXTURE_STREAMER_CACHE_SHARDS 16
+#define ER_TEXTURE_STREAMER_UPLOAD_BUDGET_BYTES (64 * 1024 * 1024) // max bytes uploaded per frame (at least one texture is always uploaded)
+#define ER_TEXTURE_STREAMER_DEFAULT_VRAM_BUDGET_MB 512
+#define ER_TEXTURE_STREAMER_MIN_RESIDENT_SIZE 64 // mips of this size (and smaller) are never evicted
+#define ER_TEXTURE_STREAMER_MIP_HYSTERESIS 1 // extra mips we keep before trimming a texture that needs less detail
+#define ER_TEXTURE_STREAMER_RETIRE_FRAMES 3 // replaced textures can still be in use by the GPU for this many frames
+
+namespace EveryRay_Core
+{
+	class ER_Core;
+	class ER_CoreTime;
+	class ER_RHI_GPUTexture;
+
+	class ER_TextureStreamer : public ER_CoreComponent
+	{
+		RTTI_DECLARATIONS(ER_TextureStreamer, ER_CoreComponent)
+	public:
+		ER_TextureStreamer(ER_Core& game);
+		~ER_TextureStreamer();
+
+		virtual void Update(const ER_CoreTime& gameTime) override;
+
+		// Returns a cached texture, the placeholder (if the texture is being streamed in) or nullptr (+ 'statusFlag' set to false) if the file does not exist.
+		// Requests for the same path are merged into one decode. 'aOnReady' is called on the main thread every time the texture behind the path
+		// changes (the real texture has been uploaded or its resident mips changed), so the returned pointer must not be cached anywhere else.
+		// [WARNING] 'aOnReady' must stay valid until Clear() is called (i.e., on level change)
+		ER_RHI_GPUTexture* RequestTexture(const std::wstring& aFullPath, const std::function<void(ER_RHI_GPUTexture*)>& aOnReady,
+			bool* didExist = nullptr, bool* statusFlag = nullptr, bool isSilent = false);
+
+		// Synchronous version (decodes and uploads on the calling thread), used for textures that can't wait (i.e., 3D)
+		ER_RHI_GPUTexture* AddOrGetTexture(const std::wstring& aFullPath, bool* didExist = nullptr, bool is3D = false, bool skipFallback = false, bool* statusFlag = nullptr, bool isSilent = false);
+		void AddTexture(const std::wstring& aFullPath, ER_RHI_GPUTexture* aTexture);
+		bool RemoveTexture(const std::wstring& aFullPath, bool removeKey = false);
+		void ReplaceTexture(const std::wstring& aFullPath, ER_RHI_GPUTexture* aTexture);
+		bool IsTextureInCache(const std::wstring& aFullPath);
+
+		// Drops all pending requests (their callbacks are not called) and deletes all cached textures (including the placeholder)
+		void Clear();
+		// Must be called after the RHI has been (re)initialized, before any requests
+		void CreatePlaceholderTexture();
+
+		// Main thread only: 'aPixelsOnScreen' is the projected size of the object that uses the texture, 'aMipBias' drops extra mips (i.e., for lower texture quality).
+		// The feedback of the current frame is applied in the next Update().
+		void ReportTextureUsage(ER_RHI_GPUTexture* aTexture, float aPixelsOnScreen, int aMipBias = 0);
+
+		void ShowStatsImGui();
+	private:
+		struct CacheEntry
+		{
+			ER_RHI_GPUTexture* texture = nullptr;
+			bool isStreaming = false;
+			std::vector<std::function<void(ER_RHI_GPUTexture*)>> listeners;
+		};
+		struct CacheShard
+		{
+			std::mutex mutex;
+			std::unordered_map<std::wstring, CacheEntry> entries;
+		};
+		struct DecodedTexture
+		{
+			std::wstring path;
+			DirectX::ScratchImage image;
+			UINT generation = 0;
+			bool isValid = false;
+			bool isMipStreamable = false;
+			UINT firstMip = 0; // mips above it are streamed in with the usage feedback
+			UINT64 uploadBytes = 0; // of the mips from 'firstMip'
+		};
+
+		struct ResidencyInfo
+		{
+			std::wstring path;
+			DirectX::ScratchImage image; // full mip chain in system memory, so that evicted mips come back without touching the disk
+			std::vector<UINT64> chainBytes; // size of the mip chain starting from a given mip
+			ER_RHI_GPUTexture* texture = nullptr;
+			UINT residentMip = 0; // most detailed mip on the GPU
+			UINT plannedMip = 0;
+			UINT desiredMip = 0;
+			UINT requiredMip = UINT_MAX; // feedback of the current frame
+			UINT maxResidentMip = 0; // the mip tail from here is always resident
+			UINT64 lastUsedFrame = 0;
+		};
+		struct TextureUpload
+		{
+			const std::wstring* path;
+			const DirectX::ScratchImage* image;
+			UINT firstMip;
+			ResidencyInfo* residency;
+			ER_RHI_GPUTexture* texture;
+		};
+
+		CacheShard& GetShard(const std::wstring& aFullPath);
+		void WorkerLoop();
+		void Decode(DecodedTexture& aTexture);
+		bool SwapTexture(const std::wstring& aFullPath, ER_RHI_GPUTexture* aTexture);
+		void PlanResidency(std::vector<TextureUpload>& aUploads, UINT64& aUploadBytes);
+		void EvictLeastRecentlyUsed(const std::vector<ResidencyInfo*>& aLRU, UINT64& aPlannedBytes, UINT64 aTargetBytes, const ResidencyInfo* aExclude, UINT64 aMaxLastUsedFrame);
+		void DeleteRetiredTextures(bool aForceAll);
+
+		CacheShard mShards[ER_TEXTURE_STREAMER_CACHE_SHARDS];
+		std::mutex mImmediateLoadMutex; // RHI command lists are not thread-safe, so synchronous loads are serialized
+
+		ER_RHI_GPUTexture* mPlaceholderTexture = nullptr;
+
+		// mip residency: updated on the main thread, textures can be removed/replaced from any thread.
+		// 'mResidencyMutex' guards the residency maps and 'mResidentBytes'; it is always locked before a shard mutex.
+		std::mutex mResidencyMutex;
+		std::unordered_map<std::wstring, std::unique_ptr<ResidencyInfo>> mResidency;
+		std::unordered_map<ER_RHI_GPUTexture*, ResidencyInfo*> mResidencyByTexture;
+		UINT64 mResidentBytes = 0; // of mip-streamed textures
+		std::deque<std::pair<ER_RHI_GPUTexture*, UINT64>> mRetiredTextures; // texture, frame it was replaced in (main thread only)
+		UINT64 mFrameIndex = 0;
+		int mVRAMBudgetMB = ER_TEXTURE_STREAMER_DEFAULT_VRAM_BUDGET_MB;
+
+		std::vector<std::thread> mWorkers;
+		std::deque<std::pair<std::wstring, UINT>> mDecodeQueue; // path, generation
+		std::mutex mDecodeQueueMutex;
+		std::condition_variable mDecodeQueueCondition;
+		std::deque<std::unique_ptr<DecodedTexture>> mDecodedQueue;
+		std::mutex mDecodedQueueMutex;
+		std::atomic<UINT> mGeneration{ 0 }; // bumped by Clear(), so that the results of the previous level are dropped
+		bool mIsShuttingDown = false;
+
+		// stats
+		std::atomic<UINT> mPendingRequests{ 0 }; // queued + being decoded + waiting for the upload
+		std::atomic<UINT64> mDecodeTimeMicroseconds{ 0 };
+		std::atomic<UINT64> mBytesRead{ 0 };
+		std::atomic<UINT> mDecodedTexturesCount{ 0 };
+		UINT64 mBytesUploadedLastFrame = 0;
+		UINT mTexturesUploadedLastFrame = 0;
+		UINT mTexturesUploadedTotal = 0;
+		UINT mMipsStreamedInLastFrame = 0;
+		UINT mMipsEvictedLastFrame = 0;
+	};
+}
@@ -12,6 +12,8 @@ namespace EveryRay_Core
 	bool ER_Utility::IsLightEditor = false;
 	bool ER_Utility::IsFoliageEditor = false;
 	bool ER_Utility::IsMainCameraCPUFrustumCulling = true;
+	bool ER_Utility::IsMainCameraCPUOcclusionCulling = true;
+	bool ER_Utility::IsValidatingGPUCullingOnCPU = false;
 	bool ER_Utility::StopDrawingRenderingObjects = false;
 	float ER_Utility::DistancesLOD[MAX_LOD] = { 100.0f, 300.0f, 2000.0f };
 
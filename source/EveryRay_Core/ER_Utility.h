@@ -29,6 +29,8 @@ namespace EveryRay_Core
 		static bool IsLightEditor;
 		static bool IsFoliageEditor;
 		static bool IsMainCameraCPUFrustumCulling;
+		static bool IsMainCameraCPUOcclusionCulling;
+		static bool IsValidatingGPUCullingOnCPU;
 		static float DistancesLOD[MAX_LOD];
 		static bool StopDrawingRenderingObjects;
 	private:
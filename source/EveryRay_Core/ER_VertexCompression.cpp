@@ -0,0 +1,180 @@
+#include "stdafx.h"
+#include "ER_VertexCompression.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace EveryRay_Core
+{
+	namespace
+	{
+		inline float SignNotZero(float v) { return v >= 0.0f ? 1.0f : -1.0f; }
+
+		inline float GetExtent(const ER_AABB& aabb, int axis)
+		{
+			const float minValues[3] = { aabb.first.x, aabb.first.y, aabb.first.z };
+			const float maxValues[3] = { aabb.second.x, aabb.second.y, aabb.second.z };
+			return std::max(0.0f, maxValues[axis] - minValues[axis]);
+		}
+
+		inline float QuantizeAxis(float value, float minValue, float extent)
+		{
+			return extent > 0.0f ? (value - minValue) / extent : 0.0f;
+		}
+
+		float GetAngleErrorDegrees(const XMFLOAT3& original, const XMFLOAT3& decoded)
+		{
+			// atan2 instead of acos: acos is too imprecise for the tiny angles we measure
+			const XMFLOAT3 cross(original.y * decoded.z - original.z * decoded.y, original.z * decoded.x - original.x * decoded.z, original.x * decoded.y - original.y * decoded.x);
+			const float sinAngle = sqrtf(cross.x * cross.x + cross.y * cross.y + cross.z * cross.z);
+			const float cosAngle = original.x * decoded.x + original.y * decoded.y + original.z * decoded.z;
+			if (sinAngle == 0.0f && cosAngle == 0.0f) // zero vector
+				return 0.0f;
+			return XMConvertToDegrees(atan2f(sinAngle, cosAngle));
+		}
+
+		inline float GetDistance(const XMFLOAT3& a, const XMFLOAT3& b)
+		{
+			return sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+		}
+	}
+
+	UINT16 ER_VertexCompression::EncodeUNorm16(float aValue)
+	{
+		aValue = std::min(1.0f, std::max(0.0f, aValue));
+		return static_cast<UINT16>(aValue * 65535.0f + 0.5f);
+	}
+
+	float ER_VertexCompression::DecodeUNorm16(UINT16 aValue)
+	{
+		return static_cast<float>(aValue) / 65535.0f;
+	}
+
+	PackedVector::XMUSHORT4 ER_VertexCompression::EncodePosition(const XMFLOAT3& aPosition, const ER_AABB& aAABB)
+	{
+		return PackedVector::XMUSHORT4(
+			EncodeUNorm16(QuantizeAxis(aPosition.x, aAABB.first.x, GetExtent(aAABB, 0))),
+			EncodeUNorm16(QuantizeAxis(aPosition.y, aAABB.first.y, GetExtent(aAABB, 1))),
+			EncodeUNorm16(QuantizeAxis(aPosition.z, aAABB.first.z, GetExtent(aAABB, 2))),
+			0);
+	}
+
+	XMFLOAT3 ER_VertexCompression::DecodePosition(const PackedVector::XMUSHORT4& aPosition, const ER_AABB& aAABB)
+	{
+		return XMFLOAT3(
+			DecodeUNorm16(aPosition.x) * GetExtent(aAABB, 0) + aAABB.first.x,
+			DecodeUNorm16(aPosition.y) * GetExtent(aAABB, 1) + aAABB.first.y,
+			DecodeUNorm16(aPosition.z) * GetExtent(aAABB, 2) + aAABB.first.z);
+	}
+
+	void ER_VertexCompression::GetPositionDecodeScaleBias(const ER_AABB& aAABB, XMFLOAT4& aScale, XMFLOAT4& aBias)
+	{
+		aScale = XMFLOAT4(GetExtent(aAABB, 0), GetExtent(aAABB, 1), GetExtent(aAABB, 2), 0.0f);
+		aBias = XMFLOAT4(aAABB.first.x, aAABB.first.y, aAABB.first.z, 1.0f);
+	}
+
+	PackedVector::XMUSHORT2 ER_VertexCompression::EncodeOctahedral(const XMFLOAT3& aVector)
+	{
+		const float l1Norm = fabsf(aVector.x) + fabsf(aVector.y) + fabsf(aVector.z);
+		if (l1Norm <= 0.0f)
+			return PackedVector::XMUSHORT2(EncodeUNorm16(0.5f), EncodeUNorm16(0.5f)); // (0, 0, 1)
+
+		float x = aVector.x / l1Norm;
+		float y = aVector.y / l1Norm;
+		if (aVector.z < 0.0f) // fold the lower hemisphere over the diagonals
+		{
+			const float foldedX = (1.0f - fabsf(y)) * SignNotZero(x);
+			const float foldedY = (1.0f - fabsf(x)) * SignNotZero(y);
+			x = foldedX;
+			y = foldedY;
+		}
+		return PackedVector::XMUSHORT2(EncodeUNorm16(x * 0.5f + 0.5f), EncodeUNorm16(y * 0.5f + 0.5f));
+	}
+
+	XMFLOAT3 ER_VertexCompression::DecodeOctahedral(const PackedVector::XMUSHORT2& aVector)
+	{
+		const float x = DecodeUNorm16(aVector.x) * 2.0f - 1.0f;
+		const float y = DecodeUNorm16(aVector.y) * 2.0f - 1.0f;
+
+		XMFLOAT3 result(x, y, 1.0f - fabsf(x) - fabsf(y));
+		const float t = std::max(0.0f, -result.z);
+		result.x += result.x >= 0.0f ? -t : t;
+		result.y += result.y >= 0.0f ? -t : t;
+
+		const float length = sqrtf(result.x * result.x + result.y * result.y + result.z * result.z);
+		return XMFLOAT3(result.x / length, result.y / length, result.z / length);
+	}
+
+	PackedVector::XMHALF2 ER_VertexCompression::EncodeUV(const XMFLOAT2& aUV)
+	{
+		return PackedVector::XMHALF2(aUV.x, aUV.y);
+	}
+
+	XMFLOAT2 ER_VertexCompression::DecodeUV(const PackedVector::XMHALF2& aUV)
+	{
+		return XMFLOAT2(PackedVector::XMConvertHalfToFloat(aUV.x), PackedVector::XMConvertHalfToFloat(aUV.y));
+	}
+
+	ER_AABB ER_VertexCompression::CalculateAABB(const std::vector<XMFLOAT3>& aPositions)
+	{
+		ER_AABB aabb(XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX), XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+		if (aPositions.empty())
+			return ER_AABB(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+
+		for (const XMFLOAT3& position : aPositions)
+		{
+			aabb.first.x = std::min(aabb.first.x, position.x);
+			aabb.first.y = std::min(aabb.first.y, position.y);
+			aabb.first.z = std::min(aabb.first.z, position.z);
+			aabb.second.x = std::max(aabb.second.x, position.x);
+			aabb.second.y = std::max(aabb.second.y, position.y);
+			aabb.second.z = std::max(aabb.second.z, position.z);
+		}
+		return aabb;
+	}
+
+	void ER_VertexCompression::CompressVertices(const std::vector<XMFLOAT3>& aPositions, const std::vector<XMFLOAT3>& aUVs, const std::vector<XMFLOAT3>& aNormals,
+		const ER_AABB& aAABB, std::vector<VertexQuantizedPositionTextureNormal>& aResult, ER_VertexCompressionError* aError)
+	{
+		assert(aUVs.size() == aPositions.size());
+		assert(aNormals.size() == aPositions.size());
+
+		aResult.clear();
+		aResult.reserve(aPositions.size());
+		for (size_t i = 0; i < aPositions.size(); i++)
+		{
+			aResult.push_back(VertexQuantizedPositionTextureNormal(
+				EncodePosition(aPositions[i], aAABB),
+				EncodeUV(XMFLOAT2(aUVs[i].x, aUVs[i].y)),
+				EncodeOctahedral(aNormals[i])));
+		}
+
+		if (!aError)
+			return;
+
+		*aError = ER_VertexCompressionError();
+		aError->verticesCount = static_cast<UINT>(aPositions.size());
+		for (size_t i = 0; i < aPositions.size(); i++)
+		{
+			const VertexQuantizedPositionTextureNormal& vertex = aResult[i];
+
+			const float positionError = GetDistance(aPositions[i], DecodePosition(vertex.Position, aAABB));
+			aError->positionMax = std::max(aError->positionMax, positionError);
+			aError->positionAverage += positionError;
+
+			const float normalError = GetAngleErrorDegrees(aNormals[i], DecodeOctahedral(vertex.Normal));
+			aError->normalMaxDegrees = std::max(aError->normalMaxDegrees, normalError);
+			aError->normalAverageDegrees += normalError;
+
+			const XMFLOAT2 uv = DecodeUV(vertex.TextureCoordinates);
+			aError->uvMax = std::max(aError->uvMax, std::max(fabsf(uv.x - aUVs[i].x), fabsf(uv.y - aUVs[i].y)));
+		}
+
+		if (aError->verticesCount > 0)
+		{
+			aError->positionAverage /= static_cast<float>(aError->verticesCount);
+			aError->normalAverageDegrees /= static_cast<float>(aError->verticesCount);
+		}
+	}
+}
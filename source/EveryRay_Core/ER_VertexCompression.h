@@ -0,0 +1,51 @@
+// Vertex stream compression in EveryRay Rendering Engine
+// - positions: 16-bit UNORM per component, quantized against the AABB of the mesh (decode: q * scale + bias, see GetPositionDecodeScaleBias())
+// - normals: octahedral mapping stored as 2 x 16-bit UNORM ("A Survey of Efficient Representations for Independent Unit Vectors", Cigolle et al.)
+// - UVs: half floats
+// Used by ER_Mesh::CreateVertexBuffer_QuantizedPositionUvNormal() (opt-in, i.e. foliage zones with "quantized_vertices"), the errors are checked when the buffer is created.
+
+#pragma once
+#include "Common.h"
+#include "ER_VertexDeclarations.h"
+
+namespace EveryRay_Core
+{
+	// all errors are measured by decoding the compressed data on the CPU
+	struct ER_VertexCompressionError
+	{
+		float positionMax = 0.0f; // in the units of the mesh
+		float positionAverage = 0.0f;
+		float normalMaxDegrees = 0.0f;
+		float normalAverageDegrees = 0.0f;
+		float uvMax = 0.0f;
+		UINT verticesCount = 0;
+	};
+
+	class ER_VertexCompression
+	{
+	public:
+		static UINT16 EncodeUNorm16(float aValue); // [0, 1]
+		static float DecodeUNorm16(UINT16 aValue);
+
+		static PackedVector::XMUSHORT4 EncodePosition(const XMFLOAT3& aPosition, const ER_AABB& aAABB);
+		static XMFLOAT3 DecodePosition(const PackedVector::XMUSHORT4& aPosition, const ER_AABB& aAABB);
+		static void GetPositionDecodeScaleBias(const ER_AABB& aAABB, XMFLOAT4& aScale, XMFLOAT4& aBias);
+
+		static PackedVector::XMUSHORT2 EncodeOctahedral(const XMFLOAT3& aVector); // does not need to be normalized
+		static XMFLOAT3 DecodeOctahedral(const PackedVector::XMUSHORT2& aVector);
+
+		static PackedVector::XMHALF2 EncodeUV(const XMFLOAT2& aUV);
+		static XMFLOAT2 DecodeUV(const PackedVector::XMHALF2& aUV);
+
+		static ER_AABB CalculateAABB(const std::vector<XMFLOAT3>& aPositions);
+
+		// 'aUVs' can have 3 components per UV (as in ER_Mesh), only x and y are used. Error is calculated if 'aError' is set.
+		static void CompressVertices(const std::vector<XMFLOAT3>& aPositions, const std::vector<XMFLOAT3>& aUVs, const std::vector<XMFLOAT3>& aNormals,
+			const ER_AABB& aAABB, std::vector<VertexQuantizedPositionTextureNormal>& aResult, ER_VertexCompressionError* aError = nullptr);
+
+	private:
+		ER_VertexCompression();
+		ER_VertexCompression(const ER_VertexCompression& rhs);
+		ER_VertexCompression& operator=(const ER_VertexCompression& rhs);
+	};
+}
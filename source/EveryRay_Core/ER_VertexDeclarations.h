@@ -76,6 +76,20 @@ namespace EveryRay_Core
 
 	} VertexPositionTextureNormalTangent;
 
+	// Compressed version of VertexPositionTextureNormal (16 bytes instead of 36), see ER_VertexCompression:
+	// POSITION - R16G16B16A16_UNORM (AABB of the mesh), TEXCOORD - R16G16_FLOAT, NORMAL - R16G16_UNORM (octahedral)
+	typedef struct _VertexQuantizedPositionTextureNormal
+	{
+		PackedVector::XMUSHORT4 Position;
+		PackedVector::XMHALF2 TextureCoordinates;
+		PackedVector::XMUSHORT2 Normal;
+
+		_VertexQuantizedPositionTextureNormal() { }
+
+		_VertexQuantizedPositionTextureNormal(const PackedVector::XMUSHORT4& position, const PackedVector::XMHALF2& textureCoordinates, const PackedVector::XMUSHORT2& normal)
+			: Position(position), TextureCoordinates(textureCoordinates), Normal(normal) { }
+	} VertexQuantizedPositionTextureNormal;
+
 	typedef struct _VertexPositionTextureNormal
 	{
 		XMFLOAT4 Position;
@@ -233,68 +233,83 @@ namespace EveryRay_Core {
 		}
 		rhi->EndEventTag();
 
-		ER_QuadRenderer* quadRenderer = (ER_QuadRenderer*)mCore->GetServices().FindService(ER_QuadRenderer::TypeIdClass());
+		ER_QuadRenderer* quadRenderer = mCore->GetServices().FindService<ER_QuadRenderer>();
 		assert(quadRenderer);
 
-		rhi->BeginEventTag("EveryRay: Volumetric Clouds (main pass)");
-		// main pass
+		// async compute job: the depth is read by the job, so it has to be acquired before the graphics queue writes it again (see AcquireResults())
+		rhi->GetAsyncComputeScheduler().Submit("EveryRay: Volumetric Clouds (job)",
+			{ mSkyAndSunRT, mWeatherTextureSRV, mCloudTextureSRV, mWorleyTextureSRV, mIlluminationResultDepthTarget },
+			{ mMainRT, mUpsampleAndBlurRT }, [this, rhi]()
 		{
-			rhi->SetRootSignature(mMainPassRS, true);
-			if (!rhi->IsPSOReady(mMainPassPSOName, true))
+			rhi->BeginEventTag("EveryRay: Volumetric Clouds (main pass)");
+			// main pass
 			{
-				rhi->InitializePSO(mMainPassPSOName, true);
-				rhi->SetShader(mMainCS);
-				rhi->SetRootSignatureToPSO(mMainPassPSOName, mMainPassRS, true);
-				rhi->FinalizePSO(mMainPassPSOName, true);
-			}
-			rhi->SetPSO(mMainPassPSOName, true);
-			rhi->SetSamplers(ER_COMPUTE, { ER_RHI_SAMPLER_STATE::ER_TRILINEAR_WRAP, ER_RHI_SAMPLER_STATE::ER_BILINEAR_WRAP });
-			rhi->SetShaderResources(ER_COMPUTE, { mSkyAndSunRT,	mWeatherTextureSRV,	mCloudTextureSRV, mWorleyTextureSRV, mIlluminationResultDepthTarget }, 0,
-				mMainPassRS, MAIN_PASS_ROOT_DESCRIPTOR_TABLE_SRV_INDEX, true);
-			rhi->SetUnorderedAccessResources(ER_COMPUTE, { mMainRT }, 0, mMainPassRS, MAIN_PASS_ROOT_DESCRIPTOR_TABLE_UAV_INDEX, true);
-			rhi->SetConstantBuffers(ER_COMPUTE, { mFrameConstantBuffer.Buffer(), mCloudsConstantBuffer.Buffer() }, 0, mMainPassRS, MAIN_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX, true);
-			rhi->Dispatch(ER_DivideByMultiple(static_cast<UINT>(mMainRT->GetWidth()), 8u), ER_DivideByMultiple(static_cast<UINT>(mMainRT->GetHeight()), 8u), 1u);
-			rhi->UnsetPSO();
+				rhi->SetRootSignature(mMainPassRS, true);
+				if (!rhi->IsPSOReady(mMainPassPSOName, true))
+				{
+					rhi->InitializePSO(mMainPassPSOName, true);
+					rhi->SetShader(mMainCS);
+					rhi->SetRootSignatureToPSO(mMainPassPSOName, mMainPassRS, true);
+					rhi->FinalizePSO(mMainPassPSOName, true);
+				}
+				rhi->SetPSO(mMainPassPSOName, true);
+				rhi->SetSamplers(ER_COMPUTE, { ER_RHI_SAMPLER_STATE::ER_TRILINEAR_WRAP, ER_RHI_SAMPLER_STATE::ER_BILINEAR_WRAP });
+				rhi->SetShaderResources(ER_COMPUTE, { mSkyAndSunRT,	mWeatherTextureSRV,	mCloudTextureSRV, mWorleyTextureSRV, mIlluminationResultDepthTarget }, 0,
+					mMainPassRS, MAIN_PASS_ROOT_DESCRIPTOR_TABLE_SRV_INDEX, true);
+				rhi->SetUnorderedAccessResources(ER_COMPUTE, { mMainRT }, 0, mMainPassRS, MAIN_PASS_ROOT_DESCRIPTOR_TABLE_UAV_INDEX, true);
+				rhi->SetConstantBuffers(ER_COMPUTE, { mFrameConstantBuffer.Buffer(), mCloudsConstantBuffer.Buffer() }, 0, mMainPassRS, MAIN_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX, true);
+				rhi->Dispatch(ER_DivideByMultiple(static_cast<UINT>(mMainRT->GetWidth()), 8u), ER_DivideByMultiple(static_cast<UINT>(mMainRT->GetHeight()), 8u), 1u);
+				rhi->UnsetPSO();
 			
-			rhi->UnbindResourcesFromShader(ER_COMPUTE);
-		}
-		rhi->EndEventTag();
-
-		rhi->BeginEventTag("EveryRay: Volumetric Clouds (upsample+blur)");
-		//upsample and blur
-		{
-			mUpsampleBlurConstantBuffer.Data.Upsample = true;
-			mUpsampleBlurConstantBuffer.ApplyChanges(rhi);
+				rhi->UnbindResourcesFromShader(ER_COMPUTE);
+			}
+			rhi->EndEventTag();
 
-			rhi->SetRootSignature(mUpsampleBlurPassRS, true);
-			if (!rhi->IsPSOReady(mUpsampleBlurPSOName, true))
+			rhi->BeginEventTag("EveryRay: Volumetric Clouds (upsample+blur)");
+			//upsample and blur
 			{
-				rhi->InitializePSO(mUpsampleBlurPSOName, true);
-				rhi->SetShader(mUpsampleBlurCS);
-				rhi->SetRootSignatureToPSO(mUpsampleBlurPSOName, mUpsampleBlurPassRS, true);
-				rhi->FinalizePSO(mUpsampleBlurPSOName, true);
-			}
-			rhi->SetPSO(mUpsampleBlurPSOName, true);
-			rhi->SetSamplers(ER_COMPUTE, { ER_RHI_SAMPLER_STATE::ER_TRILINEAR_WRAP });
-			rhi->SetShaderResources(ER_COMPUTE, { mMainRT }, 0, mUpsampleBlurPassRS, UPSAMPLEBLUR_PASS_ROOT_DESCRIPTOR_TABLE_SRV_INDEX, true);
-			rhi->SetUnorderedAccessResources(ER_COMPUTE, { mUpsampleAndBlurRT }, 0, mUpsampleBlurPassRS, UPSAMPLEBLUR_PASS_ROOT_DESCRIPTOR_TABLE_UAV_INDEX, true);
-			rhi->SetConstantBuffers(ER_COMPUTE, { mUpsampleBlurConstantBuffer.Buffer() }, 0, mUpsampleBlurPassRS, UPSAMPLEBLUR_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX, true);
-			rhi->Dispatch(ER_DivideByMultiple(static_cast<UINT>(mUpsampleAndBlurRT->GetWidth()), 8u), ER_DivideByMultiple(static_cast<UINT>(mUpsampleAndBlurRT->GetHeight()), 8u), 1u);
-			rhi->UnsetPSO();
+				mUpsampleBlurConstantBuffer.Data.Upsample = true;
+				mUpsampleBlurConstantBuffer.ApplyChanges(rhi);
+
+				rhi->SetRootSignature(mUpsampleBlurPassRS, true);
+				if (!rhi->IsPSOReady(mUpsampleBlurPSOName, true))
+				{
+					rhi->InitializePSO(mUpsampleBlurPSOName, true);
+					rhi->SetShader(mUpsampleBlurCS);
+					rhi->SetRootSignatureToPSO(mUpsampleBlurPSOName, mUpsampleBlurPassRS, true);
+					rhi->FinalizePSO(mUpsampleBlurPSOName, true);
+				}
+				rhi->SetPSO(mUpsampleBlurPSOName, true);
+				rhi->SetSamplers(ER_COMPUTE, { ER_RHI_SAMPLER_STATE::ER_TRILINEAR_WRAP });
+				rhi->SetShaderResources(ER_COMPUTE, { mMainRT }, 0, mUpsampleBlurPassRS, UPSAMPLEBLUR_PASS_ROOT_DESCRIPTOR_TABLE_SRV_INDEX, true);
+				rhi->SetUnorderedAccessResources(ER_COMPUTE, { mUpsampleAndBlurRT }, 0, mUpsampleBlurPassRS, UPSAMPLEBLUR_PASS_ROOT_DESCRIPTOR_TABLE_UAV_INDEX, true);
+				rhi->SetConstantBuffers(ER_COMPUTE, { mUpsampleBlurConstantBuffer.Buffer() }, 0, mUpsampleBlurPassRS, UPSAMPLEBLUR_PASS_ROOT_DESCRIPTOR_TABLE_CBV_INDEX, true);
+				rhi->Dispatch(ER_DivideByMultiple(static_cast<UINT>(mUpsampleAndBlurRT->GetWidth()), 8u), ER_DivideByMultiple(static_cast<UINT>(mUpsampleAndBlurRT->GetHeight()), 8u), 1u);
+				rhi->UnsetPSO();
 			
-			rhi->UnbindResourcesFromShader(ER_COMPUTE);
-		}
-		rhi->EndEventTag();
+				rhi->UnbindResourcesFromShader(ER_COMPUTE);
+			}
+			rhi->EndEventTag();
+		});
 
 		//composite pass (happens in PostProcessing)
 	}
 
+	// Has to be called on the graphics queue before Composite() and before the depth is bound as a depth target again
+	void ER_VolumetricClouds::AcquireResults()
+	{
+		if (!mEnabled || mCurrentQuality == VolumetricCloudsQuality::VC_DISABLED)
+			return;
+
+		mCore->GetRHI()->GetAsyncComputeScheduler().Acquire({ mUpsampleAndBlurRT, mIlluminationResultDepthTarget });
+	}
+
 	void ER_VolumetricClouds::Composite(ER_RHI_GPUTexture* aRenderTarget)
 	{
 		if (mCurrentQuality == VolumetricCloudsQuality::VC_DISABLED)
 			return;
 
-		ER_QuadRenderer* quadRenderer = (ER_QuadRenderer*)mCore->GetServices().FindService(ER_QuadRenderer::TypeIdClass());
+		ER_QuadRenderer* quadRenderer = mCore->GetServices().FindService<ER_QuadRenderer>();
 		assert(quadRenderer);
 
 		auto rhi = mCore->GetRHI();
@@ -59,6 +59,7 @@ namespace EveryRay_Core
 		void Initialize(ER_RHI_GPUTexture* aIlluminationDepth);
 
 		void Draw(const ER_CoreTime& gametime);
+		void AcquireResults();
 		void Update(const ER_CoreTime& gameTime);
 		void Config() { mShowDebug = !mShowDebug; }
 		void Composite(ER_RHI_GPUTexture* aRenderTarget);
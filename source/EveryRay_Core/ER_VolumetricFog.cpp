@@ -101,20 +101,36 @@ namespace EveryRay_Core {
 			return;
 
 		auto rhi = GetCore()->GetRHI();
-		rhi->SetRootSignature(mInjectionAccumulationPassesRootSignature, true);
 
-		rhi->BeginEventTag("EveryRay: Volumetric Fog (injection)");
-		ComputeInjection();
-		rhi->EndEventTag();
+		// async compute job: both injection textures are written (one by the injection, the other one by the next frame), Composite() needs AcquireResults()
+		rhi->GetAsyncComputeScheduler().Submit("EveryRay: Volumetric Fog (job)",
+			{ mShadowMapper.GetShadowTexture(0), mBlueNoiseTexture },
+			{ mTempVoxelInjectionTexture3D[0], mTempVoxelInjectionTexture3D[1], mFinalVoxelAccumulationTexture3D }, [this, rhi]()
+		{
+			rhi->SetRootSignature(mInjectionAccumulationPassesRootSignature, true);
+
+			rhi->BeginEventTag("EveryRay: Volumetric Fog (injection)");
+			ComputeInjection();
+			rhi->EndEventTag();
+
+			rhi->BeginEventTag("EveryRay: Volumetric Fog (accumulation)");
+			ComputeAccumulation();
+			rhi->EndEventTag();
+		});
+	}
+
+	// Has to be called on the graphics queue before Composite() (outside of the passes that already set their render targets)
+	void ER_VolumetricFog::AcquireResults()
+	{
+		if (!mEnabled)
+			return;
 
-		rhi->BeginEventTag("EveryRay: Volumetric Fog (accumulation)");
-		ComputeAccumulation();
-		rhi->EndEventTag();
+		GetCore()->GetRHI()->GetAsyncComputeScheduler().Acquire({ mFinalVoxelAccumulationTexture3D });
 	}
 
 	void ER_VolumetricFog::Update(const ER_CoreTime& gameTime)
 	{
-		ER_Camera* camera = (ER_Camera*)GetCore()->GetServices().FindService(ER_Camera::TypeIdClass());
+		ER_Camera* camera = GetCore()->GetServices().FindService<ER_Camera>();
 		assert(camera);
 
 		UpdateImGui();
@@ -227,7 +243,7 @@ namespace EveryRay_Core {
 	{
 		assert(aGbufferWorldPos && aInputColorTexture && aRT);
 
-		ER_QuadRenderer* quadRenderer = (ER_QuadRenderer*)mCore->GetServices().FindService(ER_QuadRenderer::TypeIdClass());
+		ER_QuadRenderer* quadRenderer = mCore->GetServices().FindService<ER_QuadRenderer>();
 		assert(quadRenderer);
 
 		auto rhi = GetCore()->GetRHI();
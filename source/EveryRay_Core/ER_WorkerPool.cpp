@@ -0,0 +1,124 @@
+#include "stdafx.h"
+
+#include "ER_WorkerPool.h"
+#include "ER_LinearArena.h"
+
+#include <algorithm>
+
+namespace EveryRay_Core
+{
+	ER_WorkerPool::ER_WorkerPool(unsigned int aWorkersCount)
+	{
+		if (aWorkersCount == 0)
+			aWorkersCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+
+		mWorkers.reserve(aWorkersCount);
+		for (unsigned int i = 0; i < aWorkersCount; i++)
+			mWorkers.push_back(std::thread([this] { WorkerLoop(); }));
+	}
+
+	ER_WorkerPool::~ER_WorkerPool()
+	{
+		{
+			const std::lock_guard<std::mutex> lock(mQueueMutex);
+			assert(mQueue.empty());
+			mIsExiting = true;
+		}
+		mQueueCondition.notify_all();
+		for (auto& worker : mWorkers)
+			worker.join();
+		mWorkers.clear();
+	}
+
+	void ER_WorkerPool::Submit(ER_WorkerJobCounter& aCounter, const std::function<void()>& aJob)
+	{
+		aCounter.mPendingJobs++;
+		if (mWorkers.empty())
+		{
+			Job job = { aJob, &aCounter };
+			RunJob(job);
+			return;
+		}
+
+		{
+			const std::lock_guard<std::mutex> lock(mQueueMutex);
+			mQueue.push_back({ aJob, &aCounter });
+		}
+		mQueueCondition.notify_one();
+	}
+
+	void ER_WorkerPool::Wait(ER_WorkerJobCounter& aCounter)
+	{
+		std::unique_lock<std::mutex> lock(mQueueMutex);
+		while (!aCounter.IsDone())
+		{
+			Job job;
+			if (PopJob(&aCounter, job))
+			{
+				lock.unlock();
+				RunJob(job);
+				lock.lock();
+			}
+			else // the rest of the jobs is running on the workers
+				mDoneCondition.wait(lock, [&aCounter] { return aCounter.IsDone(); });
+		}
+	}
+
+	void ER_WorkerPool::ParallelFor(int aCount, const std::function<void(int aIndex)>& aJob)
+	{
+		if (aCount <= 0)
+			return;
+
+		ER_WorkerJobCounter counter;
+		for (int i = 1; i < aCount; i++)
+			Submit(counter, [&aJob, i] { aJob(i); });
+
+		Job firstJob = { [&aJob] { aJob(0); }, &counter };
+		counter.mPendingJobs++;
+		RunJob(firstJob);
+
+		Wait(counter);
+	}
+
+	void ER_WorkerPool::WorkerLoop()
+	{
+		while (true)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mQueueMutex);
+				mQueueCondition.wait(lock, [this] { return mIsExiting || !mQueue.empty(); });
+				if (mIsExiting && mQueue.empty())
+					return;
+				PopJob(nullptr, job);
+			}
+			RunJob(job);
+		}
+	}
+
+	void ER_WorkerPool::RunJob(Job& aJob)
+	{
+		{
+			ER_ThreadArenaScope arenaScope(nullptr);
+			aJob.function();
+		}
+
+		// the counter can be destroyed as soon as it is done (by the thread in Wait()), so it is decremented under the lock
+		{
+			const std::lock_guard<std::mutex> lock(mQueueMutex);
+			aJob.counter->mPendingJobs--;
+		}
+		mDoneCondition.notify_all();
+	}
+
+	bool ER_WorkerPool::PopJob(ER_WorkerJobCounter* aCounter, Job& aJob)
+	{
+		auto it = aCounter ? std::find_if(mQueue.begin(), mQueue.end(), [aCounter](const Job& aQueuedJob) { return aQueuedJob.counter == aCounter; }) : mQueue.begin();
+		if (it == mQueue.end())
+			return false;
+
+		aJob = std::move(*it);
+		mQueue.erase(it);
+		return true;
+	}
+}
@@ -0,0 +1,70 @@
+// Worker pool in EveryRay Rendering Engine: persistent threads for the parallel parts of a frame (parallel command contexts, culling, simulation)
+// - the threads are created once (ER_Core::Run()) and sleep when there is nothing to do, so a frame does not create or join threads
+// - jobs are submitted with a counter, Wait() blocks until all jobs of the counter are done. The waiting thread runs the jobs of its counter
+//   that were not picked up yet (only of its counter), so jobs can wait for nested jobs (i.e., ParallelFor() inside of a job) without deadlocks
+// - jobs run without a thread arena (ER_LinearArena), as on the threads that they replace
+#pragma once
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace EveryRay_Core
+{
+	class ER_WorkerPool;
+
+	// Number of unfinished jobs, must outlive its jobs (i.e., call Wait() before it is destroyed)
+	class ER_WorkerJobCounter
+	{
+	public:
+		ER_WorkerJobCounter() {}
+		~ER_WorkerJobCounter() { assert(IsDone()); }
+
+		bool IsDone() const { return mPendingJobs.load() == 0; }
+	private:
+		friend class ER_WorkerPool;
+		std::atomic<int> mPendingJobs = { 0 };
+
+		ER_WorkerJobCounter(const ER_WorkerJobCounter& rhs);
+		ER_WorkerJobCounter& operator=(const ER_WorkerJobCounter& rhs);
+	};
+
+	class ER_WorkerPool
+	{
+	public:
+		ER_WorkerPool(unsigned int aWorkersCount = 0); // 0: one thread less than the hardware threads (the main thread also runs jobs)
+		~ER_WorkerPool();
+
+		void Submit(ER_WorkerJobCounter& aCounter, const std::function<void()>& aJob);
+		void Wait(ER_WorkerJobCounter& aCounter);
+
+		// Runs aJob(i) for i in [0; aCount) on the workers and on the calling thread, returns when all are done
+		void ParallelFor(int aCount, const std::function<void(int aIndex)>& aJob);
+
+		int GetWorkersCount() const { return static_cast<int>(mWorkers.size()); }
+	private:
+		struct Job
+		{
+			std::function<void()> function;
+			ER_WorkerJobCounter* counter;
+		};
+
+		void WorkerLoop();
+		void RunJob(Job& aJob);
+		bool PopJob(ER_WorkerJobCounter* aCounter, Job& aJob); // any job if 'aCounter' is null, mQueueMutex has to be locked
+
+		std::vector<std::thread> mWorkers;
+		std::deque<Job> mQueue;
+		std::mutex mQueueMutex;
+		std::condition_variable mQueueCondition; // new jobs or exit
+		std::condition_variable mDoneCondition; // finished jobs
+		bool mIsExiting = false;
+
+		ER_WorkerPool(const ER_WorkerPool& rhs);
+		ER_WorkerPool& operator=(const ER_WorkerPool& rhs);
+	};
+}
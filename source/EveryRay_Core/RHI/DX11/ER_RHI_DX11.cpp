@@ -446,6 +446,26 @@ namespace EveryRay_Core
 		mDirect3DDeviceContext->GenerateMips(pShaderResourceView);
 	}
 
+	// We only use the immediate context (deferred contexts are usually slower than recording on one thread), so the contexts are executed serially in the order of their indices
+	void ER_RHI_DX11::ExecuteParallelCommandContexts(const std::string& aName, int aContextsCount, const std::function<void(int aContextIndex)>& aRecord)
+	{
+		assert(aContextsCount > 0 && aContextsCount <= ER_RHI_MAX_PARALLEL_COMMAND_CONTEXTS);
+
+		ER_RHI_ParallelCommandContextsStats stats;
+		stats.contextsCount = aContextsCount;
+
+		auto startTime = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < aContextsCount; i++)
+		{
+			auto startRecordingTime = std::chrono::high_resolution_clock::now();
+			aRecord(i);
+			stats.recordingTimeMs[i] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startRecordingTime).count();
+		}
+		stats.totalTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+
+		mParallelCommandContextsStats[aName] = stats;
+	}
+
 	void ER_RHI_DX11::PresentGraphics()
 	{
 		HRESULT hr = mSwapChain->Present(0, 0);
@@ -73,6 +73,7 @@ namespace EveryRay_Core
 
 		virtual void ExecuteCommandLists(int commandListIndex = 0, bool isCompute = false) override {}; //not supported on DX11
 		virtual void ExecuteCopyCommandList() override {}; //not supported on DX11
+		virtual void ExecuteParallelCommandContexts(const std::string& aName, int aContextsCount, const std::function<void(int aContextIndex)>& aRecord) override; // contexts are recorded one after another on the immediate context
 
 		virtual void GenerateMips(ER_RHI_GPUTexture* aTexture, ER_RHI_GPUTexture* aSRGBTexture = nullptr) override;
 		virtual void GenerateMipsWithTextureReplacement(ER_RHI_GPUTexture** aTexture, std::function<void(ER_RHI_GPUTexture**)> aReplacementCallback) override {}; //not supported on DX11
@@ -80,6 +81,10 @@ namespace EveryRay_Core
 
 		virtual void PresentGraphics() override;
 		virtual void PresentCompute() override {}; //not supported on DX11
+
+		virtual bool IsAsyncComputeSupported() override { return false; } // compute jobs of ER_RHI_AsyncComputeScheduler run on the immediate context
+		virtual UINT64 SignalQueue(ER_RHI_QUEUE_TYPE aQueue) override { return 0; }; //not supported on DX11
+		virtual void WaitQueue(ER_RHI_QUEUE_TYPE aQueue, UINT64 aValue) override {}; //not supported on DX11
 		
 		virtual bool ProjectCubemapToSH(ER_RHI_GPUTexture* aTexture, UINT order, float* resultR, float* resultG, float* resultB) override;
 		
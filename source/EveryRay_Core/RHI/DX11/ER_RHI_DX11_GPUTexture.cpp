@@ -411,6 +411,51 @@ namespace EveryRay_Core
 		resourceTex->Release();
 	}
 
+	void ER_RHI_DX11_GPUTexture::CreateGPUTextureResource(ER_RHI* aRHI, const DirectX::ScratchImage& aImage, bool isInCopyQueue, UINT aFirstMip)
+	{
+		assert(aRHI);
+		ER_RHI_DX11* aRHIDX11 = static_cast<ER_RHI_DX11*>(aRHI);
+		ID3D11Device* device = aRHIDX11->GetDevice();
+		assert(device);
+
+		mIsLoadedFromFile = true;
+
+		// no copy queue on DX11: the device is free-threaded, so this is just a regular texture creation with initial data
+		// sub-chain of the image starting from 'aFirstMip' (images of a 2D texture are stored mip after mip)
+		assert(aFirstMip == 0 || (aImage.GetMetadata().arraySize == 1 && aImage.GetMetadata().depth == 1 && aFirstMip < aImage.GetMetadata().mipLevels));
+		const DirectX::Image* images = aImage.GetImages() + aFirstMip;
+		const size_t imagesCount = aImage.GetImageCount() - aFirstMip;
+		DirectX::TexMetadata metadata = aImage.GetMetadata();
+		metadata.width = images[0].width;
+		metadata.height = images[0].height;
+		metadata.mipLevels -= aFirstMip;
+		if (FAILED(DirectX::CreateShaderResourceView(device, images, imagesCount, metadata, &mSRV)))
+			throw EveryRay_Core::ER_CoreException("ER_RHI_DX11: Could not create a texture from the decoded image");
+
+		ID3D11Resource* resourceTex = NULL;
+		mSRV->GetResource(&resourceTex);
+
+		if (metadata.dimension == DirectX::TEX_DIMENSION_TEXTURE3D)
+		{
+			if (FAILED(resourceTex->QueryInterface(IID_ID3D11Texture3D, (void**)&mTexture3D)))
+				throw EveryRay_Core::ER_CoreException("ER_RHI_DX11: Could not cast decoded texture resource to Texture3D. Maybe wrong dimension?");
+		}
+		else
+		{
+			if (FAILED(resourceTex->QueryInterface(IID_ID3D11Texture2D, (void**)&mTexture2D)))
+				throw EveryRay_Core::ER_CoreException("ER_RHI_DX11: Could not cast decoded texture resource to Texture2D. Maybe wrong dimension?");
+		}
+		resourceTex->Release();
+
+		mFormat = metadata.format;
+		mMipLevels = static_cast<UINT>(metadata.mipLevels);
+		mWidth = static_cast<UINT>(metadata.width);
+		mHeight = static_cast<UINT>(metadata.height);
+		mDepth = static_cast<UINT>(metadata.depth);
+		mArraySize = static_cast<UINT>(metadata.arraySize);
+		mIsCubemap = metadata.IsCubemap();
+	}
+
 	void ER_RHI_DX11_GPUTexture::LoadFallbackTexture(ER_RHI* aRHI, ID3D11Resource** texture, ID3D11ShaderResourceView** textureView)
 	{
 		assert(aRHI);
@@ -13,6 +13,7 @@ namespace EveryRay_Core
 			int mip = 1, int depth = -1, int arraySize = 1, bool isCubemap = false, int cubemapArraySize = -1) override;
 		virtual void CreateGPUTextureResource(ER_RHI* aRHI, const std::string& aPath, bool isFullPath = false, bool is3D = false, bool skipFallback = false, bool* statusFlag = nullptr, bool isSilent = false) override;
 		virtual void CreateGPUTextureResource(ER_RHI* aRHI, const std::wstring& aPath, bool isFullPath = false, bool is3D = false, bool skipFallback = false, bool* statusFlag = nullptr, bool isSilent = false) override;
+		virtual void CreateGPUTextureResource(ER_RHI* aRHI, const DirectX::ScratchImage& aImage, bool isInCopyQueue = false, UINT aFirstMip = 0) override;
 
 		virtual void* GetRTV(void* aEmpty = nullptr) override { return mRTVs[0]; }
 		virtual void* GetRTV(int index) override { return mRTVs[index]; }
@@ -8,6 +8,8 @@
 
 #include "..\..\ER_CoreException.h"
 #include "..\..\ER_Utility.h"
+#include "..\..\ER_SphericalHarmonics.h"
+#include "..\..\ER_WorkerPool.h"
 
 namespace EveryRay_Core
 {
@@ -194,6 +196,10 @@ namespace EveryRay_Core
 				}
 			}
 
+			assert(mWorkerPool);
+			const int threadsCount = mWorkerPool ? mWorkerPool->GetWorkersCount() + 1 : 1; // + calling thread
+			mParallelCommandContextsCount = std::max(1, std::min(threadsCount, ER_RHI_MAX_PARALLEL_COMMAND_CONTEXTS));
+
 			// fences
 			{
 				// Create a fence for tracking GPU execution progress.
@@ -209,9 +215,45 @@ namespace EveryRay_Core
 			}
 		}
 
-		//TODO create compute queue data 
+		// Create compute command queue data (async compute, see ER_RHI_AsyncComputeScheduler)
 		{
-			//...
+			D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+			queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+			queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+
+			if (FAILED(mDevice->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(mCommandQueueCompute.ReleaseAndGetAddressOf()))))
+				throw ER_CoreException("ER_RHI_DX12: Could not create compute command queue");
+			mCommandQueueCompute->SetName(L"ER_RHI_DX12: Compute command queue");
+
+			for (int i = 0; i < ER_RHI_MAX_COMPUTE_COMMAND_LISTS; i++)
+			{
+				for (UINT n = 0; n < DX12_MAX_BACK_BUFFER_COUNT; n++)
+				{
+					if (FAILED(mDevice->CreateCommandAllocator(queueDesc.Type, IID_PPV_ARGS(mCommandAllocatorsCompute[n][i].ReleaseAndGetAddressOf()))))
+						throw ER_CoreException("ER_RHI_DX12: Could not create compute command allocator");
+				}
+
+				if (FAILED(mDevice->CreateCommandList(0, queueDesc.Type, mCommandAllocatorsCompute[0][i].Get(), nullptr, IID_PPV_ARGS(mCommandListCompute[i].ReleaseAndGetAddressOf()))))
+					throw ER_CoreException("ER_RHI_DX12: Could not create compute command list");
+
+				mCommandListCompute[i]->Close();
+			}
+
+			// fences
+			{
+				if (FAILED(mDevice->CreateFence(mFenceValuesCompute, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFenceCompute.ReleaseAndGetAddressOf()))))
+					throw ER_CoreException("ER_RHI_DX12: Could not create compute fence");
+
+				mFenceValuesCompute++;
+				mFenceEventCompute.Attach(CreateEventEx(nullptr, nullptr, 0, EVENT_MODIFY_STATE | SYNCHRONIZE));
+				if (!mFenceEventCompute.IsValid())
+					throw ER_CoreException("ER_RHI_DX12: Could not create event for compute fence");
+				mFenceCompute->SetName(L"ER_RHI_DX12: Compute fence");
+
+				if (FAILED(mDevice->CreateFence(mFenceValueGraphicsToCompute, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(mFenceGraphicsToCompute.ReleaseAndGetAddressOf()))))
+					throw ER_CoreException("ER_RHI_DX12: Could not create graphics->compute fence");
+				mFenceGraphicsToCompute->SetName(L"ER_RHI_DX12: Graphics fence (for compute)");
+			}
 		}
 
 		WaitForGpuOnGraphicsFence();
@@ -264,6 +306,7 @@ namespace EveryRay_Core
 		CreateBlendStates();
 
 		ResetDescriptorManager();
+		CreateConstantRing();
 
 		//clear uav state and rs
 		{
@@ -334,6 +377,23 @@ namespace EveryRay_Core
 		return true;
 	}
 
+	void ER_RHI_DX12::CreateConstantRing()
+	{
+		mConstantRingAllocator.Initialize(DX12_CONSTANT_RING_SIZE_PER_FRAME, DX12_MAX_BACK_BUFFER_COUNT);
+
+		CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Buffer(mConstantRingAllocator.GetTotalSize());
+		if (FAILED(mDevice->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(mConstantRingBuffer.ReleaseAndGetAddressOf()))))
+			throw ER_CoreException("ER_RHI_DX12: Could not create constant ring buffer");
+		mConstantRingBuffer->SetName(L"ER_RHI_DX12: Constant ring buffer");
+
+		// persistently mapped (like our dynamic buffers), we never read from it on the CPU
+		CD3DX12_RANGE readRange(0, 0);
+		if (FAILED(mConstantRingBuffer->Map(0, &readRange, reinterpret_cast<void**>(&mConstantRingMappedData))))
+			throw ER_CoreException("ER_RHI_DX12: Could not map constant ring buffer");
+
+		mConstantRingAllocator.BeginFrame(mBackBufferIndex);
+	}
+
 	void ER_RHI_DX12::WaitForGpuOnGraphicsFence()
 	{
 		if (mCommandQueueGraphics && mFenceGraphics && mFenceEventGraphics.IsValid())
@@ -356,7 +416,22 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::WaitForGpuOnComputeFence()
 	{
-		//TODO
+		if (mCommandQueueCompute && mFenceCompute && mFenceEventCompute.IsValid())
+		{
+			// Schedule a Signal command in the GPU queue.
+			UINT64 fenceValue = mFenceValuesCompute;
+			if (SUCCEEDED(mCommandQueueCompute->Signal(mFenceCompute.Get(), fenceValue)))
+			{
+				// Wait until the Signal has been processed.
+				if (SUCCEEDED(mFenceCompute->SetEventOnCompletion(fenceValue, mFenceEventCompute.Get())))
+				{
+					WaitForSingleObjectEx(mFenceEventCompute.Get(), INFINITE, FALSE);
+
+					// Increment the fence value for the current frame.
+					mFenceValuesCompute++;
+				}
+			}
+		}
 	}
 
 	void ER_RHI_DX12::WaitForGpuOnCopyFence()
@@ -420,12 +495,21 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::BeginEventTag(const std::string& aName, bool isComputeQueue)
 	{
-		PIXBeginEvent(isComputeQueue ? mCommandListCompute[mCurrentComputeCommandListIndex].Get() : mCommandListGraphics[mCurrentGraphicsCommandListIndex].Get(), 0, aName.c_str());
+		assert(!isComputeQueue || IsRecordingComputeCommandList());
+		PIXBeginEvent(GetCommandListForCompute(true), 0, aName.c_str());
+		if (!IsRecordingComputeCommandList())
+			mOpenEventTags[GetCurrentGraphicsCommandListIndex()].push_back(aName);
 	}
 
 	void ER_RHI_DX12::EndEventTag(bool isComputeQueue)
 	{
-		PIXEndEvent(isComputeQueue ? mCommandListCompute[mCurrentComputeCommandListIndex].Get() : mCommandListGraphics[mCurrentGraphicsCommandListIndex].Get());
+		assert(!isComputeQueue || IsRecordingComputeCommandList());
+		PIXEndEvent(GetCommandListForCompute(true));
+		if (!IsRecordingComputeCommandList())
+		{
+			assert(!mOpenEventTags[GetCurrentGraphicsCommandListIndex()].empty());
+			mOpenEventTags[GetCurrentGraphicsCommandListIndex()].pop_back();
+		}
 	}
 
 	void ER_RHI_DX12::BeginGraphicsCommandList(int index)
@@ -446,6 +530,9 @@ namespace EveryRay_Core
 			std::string message = "ER_RHI_DX12:: Could not Reset() command list (graphics) " + std::to_string(index);
 			throw ER_CoreException(message.c_str());
 		}
+
+		for (const std::string& tag : mOpenEventTags[index])
+			PIXBeginEvent(mCommandListGraphics[index].Get(), 0, tag.c_str());
 	}
 
 	void ER_RHI_DX12::EndGraphicsCommandList(int index)
@@ -453,6 +540,9 @@ namespace EveryRay_Core
 		assert(index < ER_RHI_MAX_GRAPHICS_COMMAND_LISTS);
 		mCurrentGraphicsCommandListIndex = -1;
 
+		for (size_t i = 0; i < mOpenEventTags[index].size(); i++)
+			PIXEndEvent(mCommandListGraphics[index].Get());
+
 		HRESULT hr;
 		if (FAILED(hr = mCommandListGraphics[index]->Close()))
 		{
@@ -461,6 +551,42 @@ namespace EveryRay_Core
 		}
 	}
 
+	void ER_RHI_DX12::BeginComputeCommandList(int index)
+	{
+		assert(index > -1 && index < ER_RHI_MAX_COMPUTE_COMMAND_LISTS);
+		assert(mCurrentComputeCommandListIndex == -1);
+		assert(!IsRecordingParallelCommandContext());
+
+		// lists can be submitted several times per frame, so the allocator is only reset once (GPU might still execute the previous submissions)
+		ID3D12CommandAllocator* allocator = mCommandAllocatorsCompute[mBackBufferIndex][index].Get();
+		if (mCommandAllocatorsComputeResetFrame[mBackBufferIndex][index] != mFrameNumber)
+		{
+			if (FAILED(allocator->Reset()))
+				throw ER_CoreException(("ER_RHI_DX12:: Could not Reset() command allocator (compute) " + std::to_string(index)).c_str());
+			mCommandAllocatorsComputeResetFrame[mBackBufferIndex][index] = mFrameNumber;
+		}
+
+		if (FAILED(mCommandListCompute[index]->Reset(allocator, nullptr)))
+			throw ER_CoreException(("ER_RHI_DX12:: Could not Reset() command list (compute) " + std::to_string(index)).c_str());
+
+		mCurrentComputeCommandListIndex = index;
+		mComputePSOContexts[index].psoState = ER_RHI_DX12_PSO_STATE::UNSET;
+		mComputePSOContexts[index].setGraphicsPSOName = "";
+		mComputePSOContexts[index].setComputePSOName = "";
+
+		ID3D12DescriptorHeap* ppHeaps[] = { mDescriptorHeapManager->GetGPUHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV)->GetHeap() };
+		mCommandListCompute[index]->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+	}
+
+	void ER_RHI_DX12::EndComputeCommandList(int index)
+	{
+		assert(index > -1 && index < ER_RHI_MAX_COMPUTE_COMMAND_LISTS);
+		mCurrentComputeCommandListIndex = -1;
+
+		if (FAILED(mCommandListCompute[index]->Close()))
+			throw ER_CoreException(("ER_RHI_DX12:: Could not close command list (compute) " + std::to_string(index)).c_str());
+	}
+
 	void ER_RHI_DX12::BeginCopyCommandList(int index /*= 0*/)
 	{
 		HRESULT hr;
@@ -480,61 +606,58 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::ClearMainRenderTarget(float colors[4])
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 		CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(mMainRenderTarget[mBackBufferIndex].Get(), D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_RENDER_TARGET);
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->ResourceBarrier(1, &barrier);
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->ClearRenderTargetView(GetMainRenderTargetView(), colors, 0, nullptr);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->ResourceBarrier(1, &barrier);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->ClearRenderTargetView(GetMainRenderTargetView(), colors, 0, nullptr);
 	}
 
 	void ER_RHI_DX12::ClearMainDepthStencilTarget(float depth, UINT stencil /*= 0*/)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->ClearDepthStencilView(GetMainDepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, depth, stencil, 0, nullptr);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->ClearDepthStencilView(GetMainDepthStencilView(), D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, depth, stencil, 0, nullptr);
 	}
 
 	void ER_RHI_DX12::ClearRenderTarget(ER_RHI_GPUTexture* aRenderTarget, float colors[4], int rtvArrayIndex)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 		assert(aRenderTarget);
 		TransitionResources({ static_cast<ER_RHI_GPUResource*>(aRenderTarget) }, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_RENDER_TARGET);
 		if (rtvArrayIndex > 0)
 		{
 			ER_RHI_DX12_DescriptorHandle& handle = static_cast<ER_RHI_DX12_GPUTexture*>(aRenderTarget)->GetRTVHandle(rtvArrayIndex);
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->ClearRenderTargetView(handle.GetCPUHandle(), colors, 0, nullptr);
+			mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->ClearRenderTargetView(handle.GetCPUHandle(), colors, 0, nullptr);
 		}
 		else
 		{
 			ER_RHI_DX12_DescriptorHandle& handle = static_cast<ER_RHI_DX12_GPUTexture*>(aRenderTarget)->GetRTVHandle();
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->ClearRenderTargetView(handle.GetCPUHandle(), colors, 0, nullptr);
+			mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->ClearRenderTargetView(handle.GetCPUHandle(), colors, 0, nullptr);
 		}
 	}
 
 	void ER_RHI_DX12::ClearDepthStencilTarget(ER_RHI_GPUTexture* aDepthTarget, float depth, UINT stencil)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 		assert(aDepthTarget);
 		ER_RHI_DX12_GPUTexture* dtDX12 = static_cast<ER_RHI_DX12_GPUTexture*>(aDepthTarget);
 		assert(dtDX12);
 		TransitionResources({ aDepthTarget }, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_DEPTH_WRITE);
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->ClearDepthStencilView(dtDX12->GetDSVHandle().GetCPUHandle(), (stencil == -1) ? D3D12_CLEAR_FLAG_DEPTH : D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, depth, stencil, 0, nullptr);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->ClearDepthStencilView(dtDX12->GetDSVHandle().GetCPUHandle(), (stencil == -1) ? D3D12_CLEAR_FLAG_DEPTH : D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL, depth, stencil, 0, nullptr);
 	}
 
 	// Two versions are available (shader and command). Shader is the default one at the moment
 	void ER_RHI_DX12::ClearUAV(ER_RHI_GPUResource* aRenderTarget, float colors[4])
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 		assert(aRenderTarget);
 		ER_RHI_DX12_GPUTexture* uavDX12 = static_cast<ER_RHI_DX12_GPUTexture*>(aRenderTarget);
 		assert(uavDX12);
 
-		if (uavDX12->GetBackBufferIndex() != mBackBufferIndex)
-			return; //quick fix for not touching the resource that was created on a different back buffer's heap
-
 		bool is3D = uavDX12->GetDepth() > 0;
-		TransitionResources({ aRenderTarget }, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_UNORDERED_ACCESS, mCurrentGraphicsCommandListIndex);
+		TransitionResources({ aRenderTarget }, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_UNORDERED_ACCESS, GetCurrentGraphicsCommandListIndex());
 
 		#pragma region SHADER_CLEAR
-		auto cmdList = mCommandListGraphics[mCurrentGraphicsCommandListIndex];
+		ID3D12GraphicsCommandList* cmdList = GetCommandListForCompute(true);
 
 		const std::string& psoName = is3D ? mClearUAV3DPSOName : mClearUAV2DPSOName;
 		ER_RHI_GPURootSignature* rs = is3D ? mClearUAV3DRS : mClearUAV2DRS;
@@ -566,7 +689,7 @@ namespace EveryRay_Core
 			cmdList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::UAV(static_cast<ID3D12Resource*>(aRenderTarget->GetResource())));
 		}
 		UnsetPSO();
-		TransitionResources({ aRenderTarget }, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, mCurrentGraphicsCommandListIndex);
+		TransitionResources({ aRenderTarget }, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, GetCurrentGraphicsCommandListIndex());
 #pragma endregion
 
 		#pragma region COMMAND_CLEAR
@@ -698,7 +821,7 @@ namespace EveryRay_Core
 	void ER_RHI_DX12::CopyGPUTextureSubresourceRegion(ER_RHI_GPUResource* aDestBuffer, UINT DstSubresource, UINT DstX, UINT DstY, UINT DstZ, ER_RHI_GPUResource* aSrcBuffer, UINT SrcSubresource, bool isInCopyQueueOrSkipTransitions)
 	{
 		if (!isInCopyQueueOrSkipTransitions)
-			assert(mCurrentGraphicsCommandListIndex > -1);
+			assert(GetCurrentGraphicsCommandListIndex() > -1);
 		assert(aDestBuffer);
 		assert(aSrcBuffer);
 
@@ -710,7 +833,7 @@ namespace EveryRay_Core
 		if (!isInCopyQueueOrSkipTransitions)
 		{
 			TransitionResources({ static_cast<ER_RHI_GPUResource*>(dstbuffer), static_cast<ER_RHI_GPUResource*>(srcbuffer) },
-				{ ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_DEST, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_SOURCE }, mCurrentGraphicsCommandListIndex);
+				{ ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_DEST, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_SOURCE }, GetCurrentGraphicsCommandListIndex());
 		}
 
 		D3D12_TEXTURE_COPY_LOCATION dstLocation;
@@ -723,7 +846,7 @@ namespace EveryRay_Core
 		srcLocation.Type = D3D12_TEXTURE_COPY_TYPE_SUBRESOURCE_INDEX;
 		srcLocation.SubresourceIndex = SrcSubresource;
 		
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->CopyTextureRegion(&dstLocation, DstX, DstY, DstZ, &srcLocation, NULL);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->CopyTextureRegion(&dstLocation, DstX, DstY, DstZ, &srcLocation, NULL);
 		//else if (dstbuffer->GetTexture3D() && srcbuffer->GetTexture3D())
 		//else
 		//	throw ER_CoreException("ER_RHI_DX12:: One of the resources is NULL during CopyGPUTextureSubresourceRegion()");
@@ -731,56 +854,56 @@ namespace EveryRay_Core
 		if (!isInCopyQueueOrSkipTransitions)
 		{
 			TransitionResources({ static_cast<ER_RHI_GPUResource*>(dstbuffer), static_cast<ER_RHI_GPUResource*>(srcbuffer) },
-				{ ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE }, mCurrentGraphicsCommandListIndex);
+				{ ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE }, GetCurrentGraphicsCommandListIndex());
 		}
 	}
 
 	void ER_RHI_DX12::Draw(UINT VertexCount)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 		assert(VertexCount > 0);
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->DrawInstanced(VertexCount, 1, 0, 0);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->DrawInstanced(VertexCount, 1, 0, 0);
 	}
 
 	void ER_RHI_DX12::DrawIndexed(UINT IndexCount)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 		assert(IndexCount > 0);
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->DrawIndexedInstanced(IndexCount, 1, 0, 0, 0);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->DrawIndexedInstanced(IndexCount, 1, 0, 0, 0);
 	}
 
 	void ER_RHI_DX12::DrawInstanced(UINT VertexCountPerInstance, UINT InstanceCount, UINT StartVertexLocation, UINT StartInstanceLocation)
 	{
 		assert(VertexCountPerInstance > 0);
 		assert(InstanceCount > 0);
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->DrawInstanced(VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->DrawInstanced(VertexCountPerInstance, InstanceCount, StartVertexLocation, StartInstanceLocation);
 	}
 
 	void ER_RHI_DX12::DrawIndexedInstanced(UINT IndexCountPerInstance, UINT InstanceCount, UINT StartIndexLocation, INT BaseVertexLocation, UINT StartInstanceLocation)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 		assert(IndexCountPerInstance > 0);
 		assert(InstanceCount > 0);
 
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->DrawIndexedInstanced(IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->DrawIndexedInstanced(IndexCountPerInstance, InstanceCount, StartIndexLocation, BaseVertexLocation, StartInstanceLocation);
 	}
 
 	void ER_RHI_DX12::DrawIndexedInstancedIndirect(ER_RHI_GPUBuffer* anArgsBuffer, UINT alignedByteOffset)
 	{
 		assert(anArgsBuffer);
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
 		TransitionResources({ anArgsBuffer }, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_INDIRECT_ARGUMENT);
 
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->ExecuteIndirect(mCommandSignature_DrawIndexed.Get(), 1, static_cast<ID3D12Resource*>(anArgsBuffer->GetResource()), alignedByteOffset, nullptr, 0);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->ExecuteIndirect(mCommandSignature_DrawIndexed.Get(), 1, static_cast<ID3D12Resource*>(anArgsBuffer->GetResource()), alignedByteOffset, nullptr, 0);
 	}
 
 	void ER_RHI_DX12::Dispatch(UINT ThreadGroupCountX, UINT ThreadGroupCountY, UINT ThreadGroupCountZ)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->Dispatch(ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
+		GetCommandListForCompute(true)->Dispatch(ThreadGroupCountX, ThreadGroupCountY, ThreadGroupCountZ);
 	}
 
 	void ER_RHI_DX12::ExecuteCommandLists(int commandListIndex /*= 0*/, bool isCompute /*= false*/)
@@ -790,7 +913,185 @@ namespace EveryRay_Core
 			ID3D12CommandList* ppCommandLists[] = { mCommandListGraphics[commandListIndex].Get() };
 			mCommandQueueGraphics->ExecuteCommandLists(1, ppCommandLists);
 		}
-		//else TODO
+		else
+		{
+			ID3D12CommandList* ppCommandLists[] = { mCommandListCompute[commandListIndex].Get() };
+			mCommandQueueCompute->ExecuteCommandLists(1, ppCommandLists);
+		}
+	}
+
+	UINT64 ER_RHI_DX12::SignalQueue(ER_RHI_QUEUE_TYPE aQueue)
+	{
+		assert(!IsRecordingParallelCommandContext());
+
+		if (aQueue == ER_RHI_QUEUE_TYPE::ER_RHI_QUEUE_COMPUTE)
+		{
+			const UINT64 fenceValue = mFenceValuesCompute++;
+			if (FAILED(mCommandQueueCompute->Signal(mFenceCompute.Get(), fenceValue)))
+				throw ER_CoreException("ER_RHI_DX12: Could not signal compute command queue");
+			return fenceValue;
+		}
+
+		// the signal has to cover everything that was recorded so far
+		const int commandListIndex = mCurrentGraphicsCommandListIndex;
+		if (commandListIndex > -1)
+		{
+			EndGraphicsCommandList(commandListIndex);
+			ExecuteCommandLists(commandListIndex);
+		}
+
+		const UINT64 fenceValue = ++mFenceValueGraphicsToCompute;
+		if (FAILED(mCommandQueueGraphics->Signal(mFenceGraphicsToCompute.Get(), fenceValue)))
+			throw ER_CoreException("ER_RHI_DX12: Could not signal graphics command queue for compute");
+
+		if (commandListIndex > -1)
+		{
+			mCurrentGraphicsCommandListIndex = commandListIndex;
+			ReopenGraphicsCommandList(commandListIndex);
+		}
+		return fenceValue;
+	}
+
+	void ER_RHI_DX12::WaitQueue(ER_RHI_QUEUE_TYPE aQueue, UINT64 aValue)
+	{
+		assert(!IsRecordingParallelCommandContext());
+
+		if (aQueue == ER_RHI_QUEUE_TYPE::ER_RHI_QUEUE_COMPUTE)
+		{
+			if (FAILED(mCommandQueueCompute->Wait(mFenceGraphicsToCompute.Get(), aValue)))
+				throw ER_CoreException("ER_RHI_DX12: Could not wait for the graphics fence on compute command queue");
+			return;
+		}
+
+		// only the commands recorded from now on have to wait: everything before is submitted first
+		const int commandListIndex = mCurrentGraphicsCommandListIndex;
+		if (commandListIndex > -1)
+		{
+			EndGraphicsCommandList(commandListIndex);
+			ExecuteCommandLists(commandListIndex);
+		}
+
+		if (FAILED(mCommandQueueGraphics->Wait(mFenceCompute.Get(), aValue)))
+			throw ER_CoreException("ER_RHI_DX12: Could not wait for the compute fence on graphics command queue");
+
+		if (commandListIndex > -1)
+		{
+			mCurrentGraphicsCommandListIndex = commandListIndex;
+			ReopenGraphicsCommandList(commandListIndex);
+		}
+	}
+
+	// Contexts are recorded into the graphics command lists [1; aContextsCount] by their own threads and submitted with one ExecuteCommandLists() call.
+	// The current list is submitted before them (so the order on the GPU is the same as the serial one) and reopened afterwards with the same allocator.
+	void ER_RHI_DX12::ExecuteParallelCommandContexts(const std::string& aName, int aContextsCount, const std::function<void(int aContextIndex)>& aRecord)
+	{
+		assert(aContextsCount > 0 && aContextsCount <= ER_RHI_MAX_PARALLEL_COMMAND_CONTEXTS);
+		assert(!IsRecordingParallelCommandContext());
+
+		const int commandListIndex = mCurrentGraphicsCommandListIndex;
+		assert(commandListIndex > ER_RHI_MAX_PARALLEL_COMMAND_CONTEXTS || commandListIndex == 0);
+
+		ER_RHI_ParallelCommandContextsStats stats;
+		stats.contextsCount = aContextsCount;
+		auto startTime = std::chrono::high_resolution_clock::now();
+
+		if (aContextsCount == 1) // nothing to parallelize: record on the current list
+		{
+			aRecord(0);
+			stats.recordingTimeMs[0] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+			stats.totalTimeMs = stats.recordingTimeMs[0];
+			mParallelCommandContextsStats[aName] = stats;
+			return;
+		}
+
+		EndGraphicsCommandList(commandListIndex);
+		ExecuteCommandLists(commandListIndex);
+
+		// contexts are recorded by the worker pool and by the calling thread (it restores its own list index afterwards)
+		std::vector<std::exception_ptr> exceptions(aContextsCount);
+		mWorkerPool->ParallelFor(aContextsCount, [&](int i)
+		{
+			const int contextCommandListIndex = i + 1;
+			const int previousCommandListIndex = GetThreadGraphicsCommandListIndex();
+			GetThreadGraphicsCommandListIndex() = contextCommandListIndex;
+			try
+			{
+				ReopenGraphicsCommandList(contextCommandListIndex);
+				BeginEventTag(aName + " (context " + std::to_string(i) + ")");
+
+				auto startRecordingTime = std::chrono::high_resolution_clock::now();
+				aRecord(i);
+				stats.recordingTimeMs[i] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startRecordingTime).count();
+
+				EndEventTag();
+
+				if (FAILED(mCommandListGraphics[contextCommandListIndex]->Close()))
+					throw ER_CoreException(("ER_RHI_DX12:: Could not close command list (graphics) " + std::to_string(contextCommandListIndex)).c_str());
+			}
+			catch (...)
+			{
+				exceptions[i] = std::current_exception();
+			}
+			GetThreadGraphicsCommandListIndex() = previousCommandListIndex;
+		});
+
+		for (int i = 0; i < aContextsCount; i++)
+		{
+			if (exceptions[i])
+				std::rethrow_exception(exceptions[i]);
+		}
+
+#if defined(_DEBUG) || defined(DEBUG)
+		int sharedTransitionsCount = 0;
+		for (auto& transition : mParallelContextsTransitions)
+		{
+			if (transition.second == -1)
+				sharedTransitionsCount++;
+		}
+		if (sharedTransitionsCount > 0)
+			ER_OUTPUT_LOG(ER_Utility::ToWideString("[ER Logger][ER_RHI_DX12] " + std::to_string(sharedTransitionsCount) + " resource(s) were transitioned by several contexts of '" + aName +
+				"': they have to be transitioned before ExecuteParallelCommandContexts()\n").c_str());
+		mParallelContextsTransitions.clear();
+#endif
+
+		ID3D12CommandList* ppCommandLists[ER_RHI_MAX_PARALLEL_COMMAND_CONTEXTS];
+		for (int i = 0; i < aContextsCount; i++)
+			ppCommandLists[i] = mCommandListGraphics[i + 1].Get();
+		mCommandQueueGraphics->ExecuteCommandLists(aContextsCount, ppCommandLists);
+
+		mCurrentGraphicsCommandListIndex = commandListIndex;
+		ReopenGraphicsCommandList(commandListIndex);
+
+		stats.totalTimeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+		mParallelCommandContextsStats[aName] = stats;
+	}
+
+	void ER_RHI_DX12::ReopenGraphicsCommandList(int index)
+	{
+		assert(index < ER_RHI_MAX_GRAPHICS_COMMAND_LISTS);
+
+		ID3D12CommandAllocator* allocator = mCommandAllocatorsGraphics[mBackBufferIndex][index].Get();
+		if (index > 0 && index <= ER_RHI_MAX_PARALLEL_COMMAND_CONTEXTS && mCommandAllocatorsGraphicsResetFrame[mBackBufferIndex][index] != mFrameNumber)
+		{
+			if (FAILED(allocator->Reset()))
+				throw ER_CoreException(("ER_RHI_DX12:: Could not Reset() command allocator (graphics) " + std::to_string(index)).c_str());
+			mCommandAllocatorsGraphicsResetFrame[mBackBufferIndex][index] = mFrameNumber;
+		}
+
+		if (FAILED(mCommandListGraphics[index]->Reset(allocator, nullptr)))
+			throw ER_CoreException(("ER_RHI_DX12:: Could not Reset() command list (graphics) " + std::to_string(index)).c_str());
+
+		for (const std::string& tag : mOpenEventTags[index])
+			PIXBeginEvent(mCommandListGraphics[index].Get(), 0, tag.c_str());
+
+		mPSOContexts[index].psoState = ER_RHI_DX12_PSO_STATE::UNSET;
+		mPSOContexts[index].setGraphicsPSOName = "";
+		mPSOContexts[index].setComputePSOName = "";
+
+		SetGPUDescriptorHeap(ER_RHI_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, false);
+		SetViewport(mCurrentViewport);
+		SetRect(mCurrentRect);
+		mCommandListGraphics[index]->IASetPrimitiveTopology(GetTopology(mCurrentTopologyType));
 	}
 
 	void ER_RHI_DX12::ExecuteCopyCommandList()
@@ -799,6 +1100,7 @@ namespace EveryRay_Core
 		mCommandQueueCopy->ExecuteCommandLists(1, ppCommandLists);
 
 		WaitForGpuOnCopyFence();
+		mCopyUploadResources.clear();
 	}
 
 	void ER_RHI_DX12::GenerateMips(ER_RHI_GPUTexture* aTexture, ER_RHI_GPUTexture* aSRGBTexture)
@@ -810,7 +1112,7 @@ namespace EveryRay_Core
 		const UINT rootParamIndexUav = 1;
 		const UINT rootParamIndexConstant = 2;
 
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
 		UINT srcWidth = aTexture->GetWidth();
 		UINT srcHeight = aTexture->GetHeight();
@@ -821,8 +1123,9 @@ namespace EveryRay_Core
 
 		UINT mipCount = (aTexture->GetMips() > 1) ? aTexture->GetMips() : aTexture->GetCalculatedMipCount();
 		assert(mipCount > 1);
+		assert(!IsRecordingComputeCommandList());
 
-		auto cmdList = mCommandListGraphics[mCurrentGraphicsCommandListIndex];
+		auto cmdList = mCommandListGraphics[GetCurrentGraphicsCommandListIndex()];
 
 		const std::string& psoName = is3D ? mGenerateMips3DPSOName : mGenerateMips2DPSOName;
 		ER_RHI_GPURootSignature* rs = is3D ? mGenerateMips3DRS : mGenerateMips2DRS;
@@ -959,6 +1262,10 @@ namespace EveryRay_Core
 			// Set the fence value for the next frame.
 			mFenceValuesGraphics[mBackBufferIndex] = currentFenceValue + 1;
 
+			// GPU has finished the frame that used this region of the constant ring last time
+			mConstantRingAllocator.BeginFrame(mBackBufferIndex);
+			mFrameNumber++;
+
 			if (!mDXGIFactory->IsCurrent())
 			{
 				if (FAILED(CreateDXGIFactory2(mDXGIFactoryFlags, IID_PPV_ARGS(mDXGIFactory.ReleaseAndGetAddressOf()))))
@@ -967,22 +1274,65 @@ namespace EveryRay_Core
 		}
 	}
 
+	// Submits the open compute command list (if any) and signals the compute fence
 	void ER_RHI_DX12::PresentCompute()
 	{
-		//mCommandListCompute->Close();
-		//
-		//ID3D12CommandList* ppCommandLists[] = { mCommandListCompute };
-		//mCommandQueueCompute->ExecuteCommandLists(1, ppCommandLists);
-
-		//UINT64 fenceValue = mFenceValuesCompute;
-		//mCommandQueueCompute->Signal(mFenceCompute.Get(), fenceValue);
-		//mFenceValuesCompute++;
+		const int commandListIndex = mCurrentComputeCommandListIndex;
+		if (commandListIndex > -1)
+		{
+			EndComputeCommandList(commandListIndex);
+			ExecuteCommandLists(commandListIndex, true);
+		}
+		SignalQueue(ER_RHI_QUEUE_TYPE::ER_RHI_QUEUE_COMPUTE);
 	}
 
+	// There is no DX12 version of DirectX::SHProjectCubeMap(), so we read the cubemap back and project it on the CPU (same basis and weights).
+	// Pending work on the current graphics command list is submitted and waited for first, then the list is reopened.
 	bool ER_RHI_DX12::ProjectCubemapToSH(ER_RHI_GPUTexture* aTexture, UINT order, float* resultR, float* resultG, float* resultB)
 	{
-		//TODO
-		return false;
+		assert(aTexture);
+		if (order != ER_SH_ORDER + 1)
+			return false;
+
+#if defined(_DEBUG) || defined(DEBUG)
+		// CPU projection must match the closed-form irradiance (failed channels are logged)
+		static bool isProjectionChecked = false;
+		if (!isProjectionChecked)
+		{
+			isProjectionChecked = true;
+			ER_SphericalHarmonics::RunAnalyticTest();
+		}
+#endif
+
+		ER_RHI_DX12_GPUTexture* tex = static_cast<ER_RHI_DX12_GPUTexture*>(aTexture);
+		assert(tex);
+
+		const int commandListIndex = mCurrentGraphicsCommandListIndex;
+		if (commandListIndex > -1)
+		{
+			EndGraphicsCommandList(commandListIndex);
+			ExecuteCommandLists(commandListIndex);
+		}
+		WaitForGpuOnGraphicsFence();
+
+		const D3D12_RESOURCE_STATES state = GetState(tex->GetCurrentState());
+		DirectX::ScratchImage image;
+		HRESULT hr = DirectX::CaptureTexture(mCommandQueueGraphics.Get(), static_cast<ID3D12Resource*>(tex->GetResource()), true, image, state, state);
+
+		if (commandListIndex > -1)
+			BeginGraphicsCommandList(commandListIndex);
+
+		XMFLOAT3 coefficients[ER_SH_COEF_COUNT];
+		if (FAILED(hr) || !ER_SphericalHarmonics::ProjectCubemap(image, coefficients))
+			return false;
+
+		for (int i = 0; i < ER_SH_COEF_COUNT; i++)
+		{
+			resultR[i] = coefficients[i].x;
+			resultG[i] = coefficients[i].y;
+			resultB[i] = coefficients[i].z;
+		}
+		return true;
 	}
 
 	void ER_RHI_DX12::SaveGPUTextureToFile(ER_RHI_GPUTexture* aTexture, const std::wstring& aPathName)
@@ -997,7 +1347,7 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::SetRenderTargets(const std::vector<ER_RHI_GPUTexture*>& aRenderTargets, ER_RHI_GPUTexture* aDepthTarget /*= nullptr*/, ER_RHI_GPUTexture* aUAV /*= nullptr*/, int rtvArrayIndex)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 		if (!aUAV)
 		{
 			if (rtvArrayIndex > 0)
@@ -1031,12 +1381,12 @@ namespace EveryRay_Core
 				resources.push_back(static_cast<ER_RHI_GPUResource*>(aDepthTarget));
 				transitions.push_back(ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_DEPTH_WRITE);
 				TransitionResources(resources, transitions);
-				mCommandListGraphics[mCurrentGraphicsCommandListIndex]->OMSetRenderTargets(rtCount, rtvHandles, FALSE, &dsvHandle);
+				mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->OMSetRenderTargets(rtCount, rtvHandles, FALSE, &dsvHandle);
 			}
 			else
 			{
 				TransitionResources(resources, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_RENDER_TARGET);
-				mCommandListGraphics[mCurrentGraphicsCommandListIndex]->OMSetRenderTargets(rtCount, rtvHandles, FALSE, NULL);
+				mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->OMSetRenderTargets(rtCount, rtvHandles, FALSE, NULL);
 			}
 
 		}
@@ -1049,23 +1399,23 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::SetDepthTarget(ER_RHI_GPUTexture* aDepthTarget)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
 		assert(aDepthTarget);
 		D3D12_CPU_DESCRIPTOR_HANDLE dsvHandle = static_cast<ER_RHI_DX12_GPUTexture*>(aDepthTarget)->GetDSVHandle().GetCPUHandle();
 		TransitionResources({ static_cast<ER_RHI_GPUResource*>(aDepthTarget) }, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_DEPTH_WRITE);
 
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->OMSetRenderTargets(0, nullptr, FALSE, &dsvHandle);
 	}
 
 	void ER_RHI_DX12::SetRenderTargetFormats(const std::vector<ER_RHI_GPUTexture*>& aRenderTargets, ER_RHI_GPUTexture* aDepthTarget /*= nullptr*/)
 	{
-		if (mCurrentPSOState == ER_RHI_DX12_PSO_STATE::COMPUTE)
+		if (GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::COMPUTE)
 			return;
 
-		assert(mCurrentPSOState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
+		assert(GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
 
-		ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(mCurrentGraphicsPSOName);
+		ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(GetPSOContext().graphicsPSOName);
 		int rtCount = static_cast<int>(aRenderTargets.size());
 		assert(rtCount <= 8);
 
@@ -1077,24 +1427,24 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::SetMainRenderTargetFormats()
 	{
-		assert(mCurrentPSOState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
+		assert(GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
 
-		ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(mCurrentGraphicsPSOName);
+		ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(GetPSOContext().graphicsPSOName);
 		pso.SetRenderTargetFormats(1, &mMainRTBufferFormat, mMainDepthBufferFormat);
 	}
 
 	void ER_RHI_DX12::SetDepthStencilState(ER_RHI_DEPTH_STENCIL_STATE aDS, UINT stencilRef)
 	{
-		if (mCurrentPSOState == ER_RHI_DX12_PSO_STATE::UNSET)
+		if (GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::UNSET)
 			return;
 
-		assert(mCurrentPSOState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
+		assert(GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
 
 		auto it = mDepthStates.find(aDS);
 		if (it != mDepthStates.end())
 		{
 			mCurrentDS = aDS;
-			ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(mCurrentGraphicsPSOName);
+			ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(GetPSOContext().graphicsPSOName);
 			pso.SetDepthStencilState(it->second);
 		}
 		else
@@ -1103,16 +1453,16 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::SetBlendState(ER_RHI_BLEND_STATE aBS, const float BlendFactor[4], UINT SampleMask)
 	{
-		if (mCurrentPSOState == ER_RHI_DX12_PSO_STATE::UNSET)
+		if (GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::UNSET)
 			return;
 
-		assert(mCurrentPSOState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
+		assert(GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
 
 		auto it = mBlendStates.find(aBS);
 		if (it != mBlendStates.end())
 		{
 			mCurrentBS = aBS;
-			ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(mCurrentGraphicsPSOName);
+			ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(GetPSOContext().graphicsPSOName);
 			pso.SetBlendState(it->second);
 		}
 		else
@@ -1121,16 +1471,16 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::SetRasterizerState(ER_RHI_RASTERIZER_STATE aRS)
 	{
-		if (mCurrentPSOState == ER_RHI_DX12_PSO_STATE::UNSET)
+		if (GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::UNSET)
 			return;
 
-		assert(mCurrentPSOState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
+		assert(GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
 
 		auto it = mRasterizerStates.find(aRS);
 		if (it != mRasterizerStates.end())
 		{
 			mCurrentRS = aRS;
-			ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(mCurrentGraphicsPSOName);
+			ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(GetPSOContext().graphicsPSOName);
 			pso.SetRasterizerState(it->second);
 		}
 		else
@@ -1147,26 +1497,28 @@ namespace EveryRay_Core
 		viewport.MinDepth = aViewport.MinDepth;
 		viewport.MaxDepth = aViewport.MaxDepth;
 
-		mCurrentViewport = aViewport;
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		if (!IsRecordingParallelCommandContext()) // viewport of the main list is inherited by the recording threads
+			mCurrentViewport = aViewport;
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->RSSetViewports(1, &viewport);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->RSSetViewports(1, &viewport);
 	}
 
 	void ER_RHI_DX12::SetRect(const ER_RHI_Rect& rect)
 	{
-		mCurrentRect = rect;
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		if (!IsRecordingParallelCommandContext())
+			mCurrentRect = rect;
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
 		D3D12_RECT currentRect = { rect.left, rect.top, rect.right, rect.bottom };
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->RSSetScissorRects(1, &currentRect);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->RSSetScissorRects(1, &currentRect);
 	}
 
 	void ER_RHI_DX12::SetShader(ER_RHI_GPUShader* aShader)
 	{
 		assert(aShader);
 
-		assert(mCurrentPSOState != ER_RHI_DX12_PSO_STATE::UNSET);
+		assert(GetPSOContext().psoState != ER_RHI_DX12_PSO_STATE::UNSET);
 
 		ER_RHI_DX12_GPUShader* aDX12_Shader = static_cast<ER_RHI_DX12_GPUShader*>(aShader);
 		assert(aDX12_Shader);
@@ -1174,9 +1526,9 @@ namespace EveryRay_Core
 		ID3DBlob* blob = static_cast<ID3DBlob*>(aDX12_Shader->GetShaderObject());
 		assert(blob);
 
-		if (mCurrentPSOState == ER_RHI_DX12_PSO_STATE::GRAPHICS)
+		if (GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::GRAPHICS)
 		{
-			ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(mCurrentGraphicsPSOName);
+			ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(GetPSOContext().graphicsPSOName);
 
 			switch (aShader->mShaderType)
 			{
@@ -1199,7 +1551,7 @@ namespace EveryRay_Core
 		}
 		else
 		{
-			ER_RHI_DX12_ComputePSO& pso = mComputePSONames.at(mCurrentComputePSOName);
+			ER_RHI_DX12_ComputePSO& pso = mComputePSONames.at(GetPSOContext().computePSOName);
 			pso.SetComputeShader(blob->GetBufferPointer(), blob->GetBufferSize());
 		}
 	}
@@ -1213,7 +1565,7 @@ namespace EveryRay_Core
 		assert(srvCount > 0 && srvCount <= DX12_MAX_BOUND_SHADER_RESOURCE_VIEWS);
 		//assert(srvCount <= rs->GetRootParameterSRVCount(rootParamIndex));
 		assert(mDescriptorHeapManager);
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
 		ER_RHI_DX12_GPUDescriptorHeap* gpuDescriptorHeap = mDescriptorHeapManager->GetGPUHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 		ER_RHI_DX12_DescriptorHandle& srvHandle = gpuDescriptorHeap->GetHandleBlock(srvCount);
@@ -1232,14 +1584,12 @@ namespace EveryRay_Core
 		}
 
 		if (!skipAutomaticTransition)
-			TransitionResources(aSRVs, aShaderType == ER_RHI_SHADER_TYPE::ER_PIXEL ? ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE : ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, mCurrentGraphicsCommandListIndex);
+			TransitionResources(aSRVs, aShaderType == ER_RHI_SHADER_TYPE::ER_PIXEL ? ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE : ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, GetCurrentGraphicsCommandListIndex());
 
 		if (!isComputeRS)
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetGraphicsRootDescriptorTable(rootParamIndex, srvHandle.GetGPUHandle());
+			mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->SetGraphicsRootDescriptorTable(rootParamIndex, srvHandle.GetGPUHandle());
 		else
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetComputeRootDescriptorTable(rootParamIndex, srvHandle.GetGPUHandle());
-
-		//TODO compute queue
+			GetCommandListForCompute(true)->SetComputeRootDescriptorTable(rootParamIndex, srvHandle.GetGPUHandle());
 	}
 
 	void ER_RHI_DX12::SetUnorderedAccessResources(ER_RHI_SHADER_TYPE aShaderType, const std::vector<ER_RHI_GPUResource*>& aUAVs, UINT startSlot /*= 0*/,
@@ -1251,7 +1601,7 @@ namespace EveryRay_Core
 		assert(uavCount > 0 && uavCount <= DX12_MAX_BOUND_UNORDERED_ACCESS_VIEWS);
 		//assert(uavCount <= rs->GetRootParameterUAVCount(rootParamIndex));
 		assert(mDescriptorHeapManager);
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
 		ER_RHI_DX12_GPUDescriptorHeap* gpuDescriptorHeap = mDescriptorHeapManager->GetGPUHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 		ER_RHI_DX12_DescriptorHandle& uavHandle = gpuDescriptorHeap->GetHandleBlock(uavCount);
@@ -1265,14 +1615,12 @@ namespace EveryRay_Core
 		}
 
 		if (!skipAutomaticTransition)
-			TransitionResources(aUAVs, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_UNORDERED_ACCESS, mCurrentGraphicsCommandListIndex);
+			TransitionResources(aUAVs, ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_UNORDERED_ACCESS, GetCurrentGraphicsCommandListIndex());
 
 		if (!isComputeRS)
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetGraphicsRootDescriptorTable(rootParamIndex, uavHandle.GetGPUHandle());
+			mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->SetGraphicsRootDescriptorTable(rootParamIndex, uavHandle.GetGPUHandle());
 		else
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetComputeRootDescriptorTable(rootParamIndex, uavHandle.GetGPUHandle());
-
-		//TODO compute queue
+			GetCommandListForCompute(true)->SetComputeRootDescriptorTable(rootParamIndex, uavHandle.GetGPUHandle());
 	}
 
 	void ER_RHI_DX12::SetConstantBuffers(ER_RHI_SHADER_TYPE aShaderType, const std::vector<ER_RHI_GPUBuffer*>& aCBs, UINT startSlot /*= 0*/,
@@ -1284,22 +1632,27 @@ namespace EveryRay_Core
 		assert(cbvCount > 0 && cbvCount <= DX12_MAX_BOUND_CONSTANT_BUFFERS);
 		//assert(cbvCount <= rs->GetRootParameterCBVCount(rootParamIndex));
 		assert(mDescriptorHeapManager);
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
 		ER_RHI_DX12_GPUDescriptorHeap* gpuDescriptorHeap = mDescriptorHeapManager->GetGPUHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 		ER_RHI_DX12_DescriptorHandle& cbvHandle = gpuDescriptorHeap->GetHandleBlock(cbvCount);
 		for (int i = 0; i < cbvCount; i++)
 		{
 			assert(aCBs[i]);
-			gpuDescriptorHeap->AddToHandle(mDevice.Get(), cbvHandle, static_cast<ER_RHI_DX12_GPUBuffer*>(aCBs[i])->GetCBVDescriptorHandle());
+			ER_RHI_DX12_GPUBuffer* cb = static_cast<ER_RHI_DX12_GPUBuffer*>(aCBs[i]);
+
+			// CBV still points to a ring range of some older frame (which might be recycled already), so we put the last data into this frame's ring
+			const UINT64 ringFrameNumber = cb->GetCBVRingFrameNumber();
+			if (ringFrameNumber != 0 && ringFrameNumber != mConstantRingAllocator.GetFrameNumber())
+				UpdateConstantBuffer(cb, cb->GetCBVShadowData(), cb->GetSize());
+
+			gpuDescriptorHeap->AddToHandle(mDevice.Get(), cbvHandle, cb->GetCBVDescriptorHandle());
 		}
 
 		if (!isComputeRS)
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetGraphicsRootDescriptorTable(rootParamIndex, cbvHandle.GetGPUHandle());
+			mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->SetGraphicsRootDescriptorTable(rootParamIndex, cbvHandle.GetGPUHandle());
 		else
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetComputeRootDescriptorTable(rootParamIndex, cbvHandle.GetGPUHandle());
-
-		//TODO compute queue
+			GetCommandListForCompute(true)->SetComputeRootDescriptorTable(rootParamIndex, cbvHandle.GetGPUHandle());
 	}
 
 	void ER_RHI_DX12::SetSamplers(ER_RHI_SHADER_TYPE aShaderType, const std::vector<ER_RHI_SAMPLER_STATE>& aSamplers, UINT startSlot /*= 0*/, ER_RHI_GPURootSignature* rs)
@@ -1312,10 +1665,10 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::SetInputLayout(ER_RHI_InputLayout* aIL)
 	{
-		assert(mCurrentPSOState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
+		assert(GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
 		assert(aIL);
 
-		ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(mCurrentGraphicsPSOName);
+		ER_RHI_DX12_GraphicsPSO& pso = mGraphicsPSONames.at(GetPSOContext().graphicsPSOName);
 		pso.SetInputLayout(this, aIL->mInputElementDescriptionCount, aIL->mInputElementDescriptions);
 	}
 
@@ -1326,19 +1679,19 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::SetIndexBuffer(ER_RHI_GPUBuffer* aBuffer, UINT offset /*= 0*/)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
 		assert(aBuffer);
 		ER_RHI_DX12_GPUBuffer* buf = static_cast<ER_RHI_DX12_GPUBuffer*>(aBuffer);
 		assert(buf);
 
 		D3D12_INDEX_BUFFER_VIEW view = buf->GetIndexBufferView();
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->IASetIndexBuffer(&view);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->IASetIndexBuffer(&view);
 	}
 
 	void ER_RHI_DX12::SetVertexBuffers(const std::vector<ER_RHI_GPUBuffer*>& aVertexBuffers)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
 		assert(aVertexBuffers.size() > 0 && aVertexBuffers.size() <= ER_RHI_MAX_BOUND_VERTEX_BUFFERS);
 		if (aVertexBuffers.size() == 1)
@@ -1349,7 +1702,7 @@ namespace EveryRay_Core
 			assert(buffer);
 
 			D3D12_VERTEX_BUFFER_VIEW view = buffer->GetVertexBufferView();
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->IASetVertexBuffers(0, 1, &view);
+			mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->IASetVertexBuffers(0, 1, &view);
 		}
 		else //+ instance buffer
 		{
@@ -1364,65 +1717,66 @@ namespace EveryRay_Core
 			assert(instanceBuffer);
 
 			D3D12_VERTEX_BUFFER_VIEW views[2] = { vertexBuffer->GetVertexBufferView(), instanceBuffer->GetVertexBufferView() };
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->IASetVertexBuffers(0, 2, views);
+			mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->IASetVertexBuffers(0, 2, views);
 		}
 	}
 
 	void ER_RHI_DX12::SetTopologyType(ER_RHI_PRIMITIVE_TYPE aType)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->IASetPrimitiveTopology(GetTopology(aType));
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->IASetPrimitiveTopology(GetTopology(aType));
+		if (!IsRecordingParallelCommandContext())
+			mCurrentTopologyType = aType;
 	}
 
 	void ER_RHI_DX12::SetRootSignature(ER_RHI_GPURootSignature* rs, bool isCompute)
 	{
 		assert(rs);
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 		if (!isCompute)
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetGraphicsRootSignature(static_cast<ER_RHI_DX12_GPURootSignature*>(rs)->GetSignature());
+			mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->SetGraphicsRootSignature(static_cast<ER_RHI_DX12_GPURootSignature*>(rs)->GetSignature());
 		else
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetComputeRootSignature(static_cast<ER_RHI_DX12_GPURootSignature*>(rs)->GetSignature());
-
-		//TODO compute queue
+			GetCommandListForCompute(true)->SetComputeRootSignature(static_cast<ER_RHI_DX12_GPURootSignature*>(rs)->GetSignature());
 	}
 
 	void ER_RHI_DX12::SetRootConstant(UINT aConstant, UINT aRootIndex, UINT anOffset, bool isCompute)
 	{
 		if (!isCompute)
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetGraphicsRoot32BitConstant(aRootIndex, aConstant, anOffset);
+			mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->SetGraphicsRoot32BitConstant(aRootIndex, aConstant, anOffset);
 		else
-			mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetComputeRoot32BitConstant(aRootIndex, aConstant, anOffset);
-
-		//TODO compute queue
+			GetCommandListForCompute(true)->SetComputeRoot32BitConstant(aRootIndex, aConstant, anOffset);
 	}
 
 	void ER_RHI_DX12::SetTopologyTypeToPSO(const std::string& aName, ER_RHI_PRIMITIVE_TYPE aType)
 	{
-		if (mCurrentPSOState == ER_RHI_DX12_PSO_STATE::UNSET)
+		if (GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::UNSET)
 			return;
 
-		assert(mCurrentPSOState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
-		assert(mCurrentGraphicsPSOName == aName);
+		assert(GetPSOContext().psoState == ER_RHI_DX12_PSO_STATE::GRAPHICS);
+		assert(GetPSOContext().graphicsPSOName == aName);
 		mGraphicsPSONames.at(aName).SetPrimitiveTopologyType(GetTopologyType(aType));
 	}
 
 	ER_RHI_PRIMITIVE_TYPE ER_RHI_DX12::GetCurrentTopologyType()
 	{
-		//TODO
-		return ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_LINELIST;
+		return mCurrentTopologyType;
 	}
 
 	void ER_RHI_DX12::SetGPUDescriptorHeap(ER_RHI_DESCRIPTOR_HEAP_TYPE aType, bool aReset)
 	{
 		assert(mDescriptorHeapManager);
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
 
 		ER_RHI_DX12_GPUDescriptorHeap* gpuDescriptorHeap = mDescriptorHeapManager->GetGPUHeap(GetHeapType(aType));
 		if (aReset)
-			gpuDescriptorHeap->Reset();
+		{
+			// transient tables of the frames that GPU has finished are recycled (same rule as for the back buffers)
+			const UINT64 completedFrameNumber = mFrameNumber > DX12_MAX_BACK_BUFFER_COUNT ? mFrameNumber - DX12_MAX_BACK_BUFFER_COUNT : 0;
+			mDescriptorHeapManager->BeginFrame(mFrameNumber, completedFrameNumber);
+		}
 
 		ID3D12DescriptorHeap* ppHeaps[] = { gpuDescriptorHeap->GetHeap() };
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
 	}
 
 	void ER_RHI_DX12::SetGPUDescriptorHeapImGui(int cmdListIndex)
@@ -1451,19 +1805,23 @@ namespace EveryRay_Core
 		}
 	}
 
+	// PSOs are created on the main thread only (recording threads of ExecuteParallelCommandContexts() only look them up)
 	void ER_RHI_DX12::InitializePSO(const std::string& aName, bool isCompute)
 	{
+		assert(!IsRecordingParallelCommandContext());
+
+		ER_RHI_DX12_PSOContext& context = GetPSOContext();
 		if (isCompute)
 		{
 			mComputePSONames.insert(std::make_pair(aName, ER_RHI_DX12_ComputePSO(aName)));
-			mCurrentComputePSOName = aName;
-			mCurrentPSOState = ER_RHI_DX12_PSO_STATE::COMPUTE;
+			context.computePSOName = aName;
+			context.psoState = ER_RHI_DX12_PSO_STATE::COMPUTE;
 		}
 		else
 		{
 			mGraphicsPSONames.insert(std::make_pair(aName, ER_RHI_DX12_GraphicsPSO(aName)));
-			mCurrentGraphicsPSOName = aName;
-			mCurrentPSOState = ER_RHI_DX12_PSO_STATE::GRAPHICS;
+			context.graphicsPSOName = aName;
+			context.psoState = ER_RHI_DX12_PSO_STATE::GRAPHICS;
 			SetRasterizerState(ER_RHI_RASTERIZER_STATE::ER_BACK_CULLING); // set default RS to all gfx PSO on init
 		}
 	}
@@ -1476,12 +1834,12 @@ namespace EveryRay_Core
 
 		if (!isCompute)
 		{
-			assert(mCurrentGraphicsPSOName == aName);
+			assert(GetPSOContext().graphicsPSOName == aName);
 			mGraphicsPSONames.at(aName).SetRootSignature(*rsDX12);
 		}
 		else
 		{
-			assert(mCurrentComputePSOName == aName);
+			assert(GetPSOContext().computePSOName == aName);
 			mComputePSONames.at(aName).SetRootSignature(*rsDX12);
 		}
 	}
@@ -1490,19 +1848,20 @@ namespace EveryRay_Core
 	{
 		if (!isCompute)
 		{
-			assert(mCurrentGraphicsPSOName == aName);
+			assert(GetPSOContext().graphicsPSOName == aName);
 			mGraphicsPSONames.at(aName).Finalize(mDevice.Get());
 		}
 		else
 		{
-			assert(mCurrentComputePSOName == aName);
+			assert(GetPSOContext().computePSOName == aName);
 			mComputePSONames.at(aName).Finalize(mDevice.Get());
 		}
 	}
 
 	void ER_RHI_DX12::SetPSO(const std::string& aName, bool isCompute)
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
+		ER_RHI_DX12_PSOContext& context = GetPSOContext();
 		auto resetPSO = [&](const std::string& name, bool comp)
 		{
 			std::wstring msg = L"[ER Logger][ER_RHI_DX12] Could not find PSO to set, adding it now and trying to reset: " + ER_Utility::ToWideString(aName) + L'\n';
@@ -1516,17 +1875,17 @@ namespace EveryRay_Core
 			auto it = mGraphicsPSONames.find(aName);
 			if (it != mGraphicsPSONames.end())
 			{
-				if (mCurrentGraphicsPSOName == aName && mCurrentSetGraphicsPSOName == aName)
+				if (context.graphicsPSOName == aName && context.setGraphicsPSOName == aName)
 				{
-					mCurrentPSOState = ER_RHI_DX12_PSO_STATE::GRAPHICS;
+					context.psoState = ER_RHI_DX12_PSO_STATE::GRAPHICS;
 					return;
 				}
 				else
 				{
-					mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetPipelineState(it->second.GetPipelineStateObject());
-					mCurrentGraphicsPSOName = it->first;
-					mCurrentSetGraphicsPSOName = mCurrentGraphicsPSOName;
-					mCurrentPSOState = ER_RHI_DX12_PSO_STATE::GRAPHICS;
+					mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->SetPipelineState(it->second.GetPipelineStateObject());
+					context.graphicsPSOName = it->first;
+					context.setGraphicsPSOName = context.graphicsPSOName;
+					context.psoState = ER_RHI_DX12_PSO_STATE::GRAPHICS;
 				}
 			}
 			else
@@ -1537,16 +1896,16 @@ namespace EveryRay_Core
 			auto it = mComputePSONames.find(aName);
 			if (it != mComputePSONames.end())
 			{
-				if (mCurrentComputePSOName == aName && mCurrentSetComputePSOName == aName)
+				if (context.computePSOName == aName && context.setComputePSOName == aName)
 				{
-					mCurrentPSOState = ER_RHI_DX12_PSO_STATE::COMPUTE;
+					context.psoState = ER_RHI_DX12_PSO_STATE::COMPUTE;
 					return;
 				}
 				{
-					mCommandListGraphics[mCurrentGraphicsCommandListIndex]->SetPipelineState(it->second.GetPipelineStateObject());
-					mCurrentComputePSOName = it->first;
-					mCurrentSetComputePSOName = mCurrentComputePSOName;
-					mCurrentPSOState = ER_RHI_DX12_PSO_STATE::COMPUTE;
+					GetCommandListForCompute(true)->SetPipelineState(it->second.GetPipelineStateObject());
+					context.computePSOName = it->first;
+					context.setComputePSOName = context.computePSOName;
+					context.psoState = ER_RHI_DX12_PSO_STATE::COMPUTE;
 				}
 			}
 			else
@@ -1556,73 +1915,147 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::UnsetPSO()
 	{
-		mCurrentPSOState = ER_RHI_DX12_PSO_STATE::UNSET;
-		mCurrentSetGraphicsPSOName = "";
-		mCurrentSetComputePSOName = "";
+		ER_RHI_DX12_PSOContext& context = GetPSOContext();
+		context.psoState = ER_RHI_DX12_PSO_STATE::UNSET;
+		context.setGraphicsPSOName = "";
+		context.setComputePSOName = "";
 	}
 
 	void ER_RHI_DX12::TransitionResources(const std::vector<ER_RHI_GPUResource*>& aResources, const std::vector<ER_RHI_RESOURCE_STATE>& aStates, int cmdListIndex, bool isCopyQueue, int subresourceIndex)
 	{
 		int size = static_cast<int>(aResources.size());
+
+		// states of the resources are shared by all recording threads and their barriers always go to their own list
+		std::unique_lock<std::mutex> lock(mResourceStatesMutex, std::defer_lock);
+		if (IsRecordingParallelCommandContext())
+		{
+			lock.lock();
+			cmdListIndex = GetCurrentGraphicsCommandListIndex();
+		}
 		assert(size > 0 && size == aStates.size());
+		const bool isComputeQueue = !isCopyQueue && IsRecordingComputeCommandList();
 		std::vector<CD3DX12_RESOURCE_BARRIER> barriers;
 
 		for (int i = 0; i < size; i++)
 		{
-			if (aStates[i] == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE &&
-				aResources[i]->GetCurrentState() == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)
-				continue;
-
-			if (aResources[i] && aResources[i]->GetCurrentState() != aStates[i])
+			ER_RHI_RESOURCE_STATE targetState;
+			if (aResources[i] && GetTransitionTargetState(aResources[i], aStates[i], isComputeQueue, targetState))
 			{
-				barriers.emplace_back(CD3DX12_RESOURCE_BARRIER::Transition(static_cast<ID3D12Resource*>(aResources[i]->GetResource()), GetState(aResources[i]->GetCurrentState()), GetState(aStates[i]),
+				barriers.emplace_back(CD3DX12_RESOURCE_BARRIER::Transition(static_cast<ID3D12Resource*>(aResources[i]->GetResource()), GetState(aResources[i]->GetCurrentState()), GetState(targetState),
 					subresourceIndex < 0 ? D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES : subresourceIndex)
 				);
-				aResources[i]->SetCurrentState(aStates[i]);
+				aResources[i]->SetCurrentState(targetState);
+#if defined(_DEBUG) || defined(DEBUG)
+				if (IsRecordingParallelCommandContext())
+				{
+					auto transition = mParallelContextsTransitions.emplace(aResources[i], cmdListIndex);
+					if (!transition.second && transition.first->second != cmdListIndex)
+						transition.first->second = -1;
+				}
+#endif
 			}
 		}
 
 		if (barriers.size() > 0)
 		{
-			if (!isCopyQueue)
-				mCommandListGraphics[cmdListIndex]->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
-			else
+			if (isCopyQueue)
 				mCommandListCopy->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+			else if (isComputeQueue)
+				mCommandListCompute[mCurrentComputeCommandListIndex]->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+			else
+				mCommandListGraphics[cmdListIndex]->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
 		}
 	}
 
 	void ER_RHI_DX12::TransitionResources(const std::vector<ER_RHI_GPUResource*>& aResources, ER_RHI_RESOURCE_STATE aState, int cmdListIndex /*= 0*/, bool isCopyQueue, int subresourceIndex)
 	{
 		int size = static_cast<int>(aResources.size());
+
+		// see the overload above
+		std::unique_lock<std::mutex> lock(mResourceStatesMutex, std::defer_lock);
+		if (IsRecordingParallelCommandContext())
+		{
+			lock.lock();
+			cmdListIndex = GetCurrentGraphicsCommandListIndex();
+		}
+		const bool isComputeQueue = !isCopyQueue && IsRecordingComputeCommandList();
 		std::vector<CD3DX12_RESOURCE_BARRIER> barriers;
 
 		for (int i = 0; i < size; i++)
 		{
-			if (!aResources[i])
-				continue;
-
-			if (aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE &&
-				aResources[i]->GetCurrentState() == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)
-				continue;
-
-			if (aResources[i] && aResources[i]->GetCurrentState() != aState)
+			ER_RHI_RESOURCE_STATE targetState;
+			if (aResources[i] && GetTransitionTargetState(aResources[i], aState, isComputeQueue, targetState))
 			{
-				barriers.emplace_back(CD3DX12_RESOURCE_BARRIER::Transition(static_cast<ID3D12Resource*>(aResources[i]->GetResource()), GetState(aResources[i]->GetCurrentState()), GetState(aState),
+				barriers.emplace_back(CD3DX12_RESOURCE_BARRIER::Transition(static_cast<ID3D12Resource*>(aResources[i]->GetResource()), GetState(aResources[i]->GetCurrentState()), GetState(targetState),
 					subresourceIndex < 0 ? D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES : subresourceIndex)
 				);
-				aResources[i]->SetCurrentState(aState);
+				aResources[i]->SetCurrentState(targetState);
+#if defined(_DEBUG) || defined(DEBUG)
+				if (IsRecordingParallelCommandContext())
+				{
+					auto transition = mParallelContextsTransitions.emplace(aResources[i], cmdListIndex);
+					if (!transition.second && transition.first->second != cmdListIndex)
+						transition.first->second = -1;
+				}
+#endif
 			}
 		}
 
 		if (barriers.size() > 0)
 		{
-			if (!isCopyQueue)
-				mCommandListGraphics[cmdListIndex]->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
-			else
+			if (isCopyQueue)
 				mCommandListCopy->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+			else if (isComputeQueue)
+				mCommandListCompute[mCurrentComputeCommandListIndex]->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+			else
+				mCommandListGraphics[cmdListIndex]->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
 		}
 	}
 
+	// Returns false if the resource can already be used in 'aState'.
+	// Compute command lists can not use the states of the graphics pipeline, so shader resources become ER_RESOURCE_STATE_COMPUTE_SHADER_RESOURCE there
+	// and everything else has to be released to the compute queue first (see ER_RHI_AsyncComputeScheduler).
+	bool ER_RHI_DX12::GetTransitionTargetState(ER_RHI_GPUResource* aResource, ER_RHI_RESOURCE_STATE aState, bool isComputeQueue, ER_RHI_RESOURCE_STATE& aTargetState)
+	{
+		auto isComputeQueueState = [](ER_RHI_RESOURCE_STATE aState)
+		{
+			return aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COMMON ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_UNORDERED_ACCESS ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COMPUTE_SHADER_RESOURCE ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_INDIRECT_ARGUMENT ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_DEST ||
+				aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_SOURCE;
+		};
+
+		const ER_RHI_RESOURCE_STATE currentState = aResource->GetCurrentState();
+
+		// non-pixel shader resource state also contains the pixel one on DX12 (see GetState())
+		if (aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE && currentState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)
+			return false;
+		if (aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE && currentState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COMPUTE_SHADER_RESOURCE)
+			return false;
+
+		aTargetState = aState;
+		if (isComputeQueue)
+		{
+			if (aState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)
+			{
+				if (currentState == ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE)
+					return false;
+				aTargetState = ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COMPUTE_SHADER_RESOURCE;
+			}
+			if (currentState == aTargetState)
+				return false;
+
+			if (!isComputeQueueState(currentState) || !isComputeQueueState(aTargetState))
+				throw ER_CoreException("ER_RHI_DX12: Could not transition a resource on the compute queue (was it released to the compute queue by ER_RHI_AsyncComputeScheduler?)");
+			return true;
+		}
+
+		return currentState != aTargetState;
+	}
+
 	void ER_RHI_DX12::TransitionMainRenderTargetToPresent(int cmdListIndex)
 	{
 		CD3DX12_RESOURCE_BARRIER barrier = CD3DX12_RESOURCE_BARRIER::Transition(mMainRenderTarget[mBackBufferIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
@@ -1631,8 +2064,8 @@ namespace EveryRay_Core
 
 	void ER_RHI_DX12::UnbindRenderTargets()
 	{
-		assert(mCurrentGraphicsCommandListIndex > -1);
-		mCommandListGraphics[mCurrentGraphicsCommandListIndex]->OMSetRenderTargets(0, nullptr, false, nullptr);
+		assert(GetCurrentGraphicsCommandListIndex() > -1);
+		mCommandListGraphics[GetCurrentGraphicsCommandListIndex()]->OMSetRenderTargets(0, nullptr, false, nullptr);
 	}
 
 	void ER_RHI_DX12::UpdateBuffer(ER_RHI_GPUBuffer* aBuffer, void* aData, int dataSize, bool updateForAllBackBuffers)
@@ -1645,6 +2078,44 @@ namespace EveryRay_Core
 		buffer->Update(this, aData, dataSize, updateForAllBackBuffers);
 	}
 
+	void ER_RHI_DX12::UpdateConstantBuffer(ER_RHI_GPUBuffer* aBuffer, void* aData, int dataSize)
+	{
+		assert(aBuffer->GetSize() >= dataSize);
+
+		ER_RHI_DX12_GPUBuffer* buffer = static_cast<ER_RHI_DX12_GPUBuffer*>(aBuffer);
+		assert(buffer);
+
+		// every update gets its own range, so several updates of the same buffer in one frame do not overwrite each other
+		UINT64 offset = 0;
+		bool isAllocated = false;
+		{
+			const std::lock_guard<std::mutex> lock(mConstantRingMutex); // several recording threads can update constant buffers
+			isAllocated = mConstantRingMappedData && mConstantRingAllocator.Allocate(static_cast<UINT>(buffer->GetSize()), offset);
+		}
+		if (isAllocated)
+		{
+			if (buffer->GetCBVShadowData() != aData)
+				buffer->StoreCBVShadowData(aData, dataSize);
+			memcpy(mConstantRingMappedData + offset, buffer->GetCBVShadowData(), buffer->GetSize());
+			buffer->SetCBVRingLocation(this, mConstantRingBuffer->GetGPUVirtualAddress() + offset, mConstantRingAllocator.GetFrameNumber());
+		}
+		else // ring is full: fallback to the upload buffer of the constant buffer itself (overflow is counted in the stats)
+		{
+			if (buffer->GetCBVShadowData() != aData)
+				buffer->StoreCBVShadowData(aData, dataSize);
+			buffer->Update(this, aData, dataSize);
+		}
+	}
+
+	bool ER_RHI_DX12::GetDescriptorStats(ER_RHI_DESCRIPTOR_HEAP_TYPE aType, ER_RHI_DescriptorHeapStats& aStats)
+	{
+		if (!mDescriptorHeapManager)
+			return false;
+
+		mDescriptorHeapManager->GetStats(GetHeapType(aType), aStats);
+		return true;
+	}
+
 	void ER_RHI_DX12::InitImGui()
 	{
 		D3D12_DESCRIPTOR_HEAP_DESC desc = {};
@@ -1848,6 +2319,8 @@ namespace EveryRay_Core
 			return D3D12_RESOURCE_STATES::D3D12_RESOURCE_STATE_GENERIC_READ;
 		case ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PRESENT:
 			return D3D12_RESOURCE_STATES::D3D12_RESOURCE_STATE_PRESENT;
+		case ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COMPUTE_SHADER_RESOURCE:
+			return D3D12_RESOURCE_STATES::D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
 		default:
 			throw ER_CoreException("ER_RHI_DX12: Could not convert the resource state!");
 			return D3D12_RESOURCE_STATES::D3D12_RESOURCE_STATE_COMMON;
@@ -2072,6 +2545,7 @@ namespace EveryRay_Core
 		}
 		// Reset the index to the current back buffer.
 		mBackBufferIndex = mSwapChain->GetCurrentBackBufferIndex();
+		mConstantRingAllocator.BeginFrame(mBackBufferIndex); // GPU is idle, constant buffers from the ring will be reuploaded on their next bind
 
 		// main DSV
 		{
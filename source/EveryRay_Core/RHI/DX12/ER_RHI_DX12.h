@@ -20,6 +20,7 @@
 #define DX12_MAX_BOUND_SAMPLERS 8 
 #define DX12_MAX_BOUND_ROOT_PARAMS 8 
 #define DX12_MAX_BACK_BUFFER_COUNT 2
+#define DX12_CONSTANT_RING_SIZE_PER_FRAME (8 * 1024 * 1024) // upload memory for constant buffer updates of one frame
 
 #define DX12_MAX_GENERATE_MIPS_TEXTURES_IN_POOL 2048 // max # of textures pending for GenerateMipsWithTextureReplacement();
 
@@ -32,6 +33,16 @@ namespace EveryRay_Core
 		COMPUTE
 	};
 
+	// PSO tracking of one graphics command list (every recording thread has its own list, see ExecuteParallelCommandContexts())
+	struct ER_RHI_DX12_PSOContext
+	{
+		std::string graphicsPSOName;
+		std::string computePSOName;
+		std::string setGraphicsPSOName; //which was set to command list already
+		std::string setComputePSOName; //which was set to command list already
+		ER_RHI_DX12_PSO_STATE psoState = ER_RHI_DX12_PSO_STATE::UNSET;
+	};
+
 	class ER_RHI_DX12_GraphicsPSO;
 	class ER_RHI_DX12_ComputePSO;
 	class ER_RHI_DX12_GPURootSignature;
@@ -49,8 +60,8 @@ namespace EveryRay_Core
 		virtual void BeginGraphicsCommandList(int index = 0) override;
 		virtual void EndGraphicsCommandList(int index = 0) override;
 
-		virtual void BeginComputeCommandList(int index = 0) override {}; //TODO
-		virtual void EndComputeCommandList(int index = 0) override {}; //TODO
+		virtual void BeginComputeCommandList(int index = 0) override;
+		virtual void EndComputeCommandList(int index = 0) override;
 
 		virtual void BeginCopyCommandList(int index = 0) override;
 		virtual void EndCopyCommandList(int index = 0) override;
@@ -91,6 +102,7 @@ namespace EveryRay_Core
 
 		virtual void ExecuteCommandLists(int commandListIndex = 0, bool isCompute = false) override;
 		virtual void ExecuteCopyCommandList() override;
+		virtual void ExecuteParallelCommandContexts(const std::string& aName, int aContextsCount, const std::function<void(int aContextIndex)>& aRecord) override;
 
 		virtual void GenerateMips(ER_RHI_GPUTexture* aTexture, ER_RHI_GPUTexture* aSRGBTexture = nullptr) override;
 		virtual void GenerateMipsWithTextureReplacement(ER_RHI_GPUTexture** aTexture, std::function<void(ER_RHI_GPUTexture**)> aReplacementCallback) override;
@@ -98,6 +110,10 @@ namespace EveryRay_Core
 
 		virtual void PresentGraphics() override;
 		virtual void PresentCompute() override;
+
+		virtual bool IsAsyncComputeSupported() override { return mCommandQueueCompute != nullptr; }
+		virtual UINT64 SignalQueue(ER_RHI_QUEUE_TYPE aQueue) override;
+		virtual void WaitQueue(ER_RHI_QUEUE_TYPE aQueue, UINT64 aValue) override;
 		
 		virtual bool ProjectCubemapToSH(ER_RHI_GPUTexture* aTexture, UINT order, float* resultR, float* resultG, float* resultB) override;
 		
@@ -159,6 +175,9 @@ namespace EveryRay_Core
 		virtual void UnbindResourcesFromShader(ER_RHI_SHADER_TYPE aShaderType, bool unbindShader = true) override {}; //Not needed on DX12
 
 		virtual void UpdateBuffer(ER_RHI_GPUBuffer* aBuffer, void* aData, int dataSize, bool updateForAllBackBuffers = false) override;
+		virtual void UpdateConstantBuffer(ER_RHI_GPUBuffer* aBuffer, void* aData, int dataSize) override;
+		virtual const ER_RHI_ConstantRingStats* GetConstantRingStats() override { return &mConstantRingAllocator.GetLastFrameStats(); }
+		virtual bool GetDescriptorStats(ER_RHI_DESCRIPTOR_HEAP_TYPE aType, ER_RHI_DescriptorHeapStats& aStats) override;
 		
 		virtual bool IsHardwareRaytracingSupported() override { return mIsRaytracingTierAvailable; }
 		virtual bool IsRootConstantSupported()  override { return true; }
@@ -185,6 +204,9 @@ namespace EveryRay_Core
 		ID3D12Device5* GetDeviceRaytracing() const { return (ID3D12Device5*)mDevice.Get(); }
 		ID3D12GraphicsCommandList* GetGraphicsCommandList(int index) const { return mCommandListGraphics[index].Get(); }
 		ID3D12GraphicsCommandList* GetComputeCommandList(int index) const { return mCommandListCompute[index].Get(); }
+		ID3D12GraphicsCommandList* GetCopyCommandList() const { return mCommandListCopy.Get(); }
+		// upload buffers of the copy command list are kept alive until ExecuteCopyCommandList() has waited for the copy fence
+		void ReleaseAfterCopy(ComPtr<ID3D12Resource>& aUploadResource) { mCopyUploadResources.push_back(std::move(aUploadResource)); }
 		ER_RHI_DX12_GPUDescriptorHeapManager* GetDescriptorHeapManager() const { return mDescriptorHeapManager; }
 
 		const D3D12_SAMPLER_DESC& FindSamplerState(ER_RHI_SAMPLER_STATE aState);
@@ -215,6 +237,25 @@ namespace EveryRay_Core
 		void CreateBlendStates();
 		void CreateRasterizerStates();
 		void CreateDepthStencilStates();
+		void CreateConstantRing();
+
+		bool GetTransitionTargetState(ER_RHI_GPUResource* aResource, ER_RHI_RESOURCE_STATE aState, bool isComputeQueue, ER_RHI_RESOURCE_STATE& aTargetState);
+
+		// reopens a graphics command list in the middle of the frame: its allocator is only reset once per frame (GPU might still execute its previous commands)
+		void ReopenGraphicsCommandList(int index);
+		ER_RHI_DX12_PSOContext& GetPSOContext()
+		{
+			if (IsRecordingComputeCommandList())
+				return mComputePSOContexts[mCurrentComputeCommandListIndex];
+			const int index = GetCurrentGraphicsCommandListIndex();
+			return mPSOContexts[index > -1 ? index : 0];
+		}
+		// compute passes between Begin/EndComputeCommandList() (main thread only, recording threads of ExecuteParallelCommandContexts() always use their graphics lists)
+		bool IsRecordingComputeCommandList() { return mCurrentComputeCommandListIndex > -1 && !IsRecordingParallelCommandContext(); }
+		ID3D12GraphicsCommandList* GetCommandListForCompute(bool isCompute)
+		{
+			return (isCompute && IsRecordingComputeCommandList()) ? mCommandListCompute[mCurrentComputeCommandListIndex].Get() : mCommandListGraphics[GetCurrentGraphicsCommandListIndex()].Get();
+		}
 
 		D3D_FEATURE_LEVEL mFeatureLevel = D3D_FEATURE_LEVEL_12_1;
 		
@@ -237,9 +278,11 @@ namespace EveryRay_Core
 		ComPtr<ID3D12CommandQueue> mCommandQueueGraphics;
 		ComPtr<ID3D12GraphicsCommandList> mCommandListGraphics[ER_RHI_MAX_GRAPHICS_COMMAND_LISTS];
 		ComPtr<ID3D12CommandAllocator> mCommandAllocatorsGraphics[DX12_MAX_BACK_BUFFER_COUNT][ER_RHI_MAX_GRAPHICS_COMMAND_LISTS];
+		UINT64 mCommandAllocatorsGraphicsResetFrame[DX12_MAX_BACK_BUFFER_COUNT][ER_RHI_MAX_GRAPHICS_COMMAND_LISTS] = {}; // only for the lists of ExecuteParallelCommandContexts()
 		
 		ComPtr<ID3D12Fence> mFenceGraphics;
 		UINT64 mFenceValuesGraphics[DX12_MAX_BACK_BUFFER_COUNT] = {};
+		UINT64 mFrameNumber = 1; // number of the frame that is being recorded (0 - before the first frame)
 		Wrappers::Event mFenceEventGraphics;
 		
 		// compute
@@ -247,9 +290,15 @@ namespace EveryRay_Core
 		ComPtr<ID3D12GraphicsCommandList> mCommandListCompute[ER_RHI_MAX_COMPUTE_COMMAND_LISTS];
 		ComPtr<ID3D12CommandAllocator> mCommandAllocatorsCompute[DX12_MAX_BACK_BUFFER_COUNT][ER_RHI_MAX_COMPUTE_COMMAND_LISTS];
 
+		UINT64 mCommandAllocatorsComputeResetFrame[DX12_MAX_BACK_BUFFER_COUNT][ER_RHI_MAX_COMPUTE_COMMAND_LISTS] = {}; // lists can be reopened several times per frame
+
 		ComPtr<ID3D12Fence> mFenceCompute;
-		UINT64 mFenceValuesCompute;
+		UINT64 mFenceValuesCompute = 0;
 		Wrappers::Event mFenceEventCompute;
+
+		// signaled by the graphics queue for the compute queue (values of the main graphics fence are used for the frames in flight)
+		ComPtr<ID3D12Fence> mFenceGraphicsToCompute;
+		UINT64 mFenceValueGraphicsToCompute = 0;
 		
 		// copy
 		ComPtr<ID3D12CommandQueue> mCommandQueueCopy;
@@ -259,6 +308,7 @@ namespace EveryRay_Core
 		ComPtr<ID3D12Fence> mFenceCopy;
 		UINT64 mFenceValuesCopy;
 		Wrappers::Event mFenceEventCopy;
+		std::vector<ComPtr<ID3D12Resource>> mCopyUploadResources;
 
 		std::map<ER_RHI_SAMPLER_STATE, D3D12_SAMPLER_DESC> mSamplerStates;
 		std::map<ER_RHI_BLEND_STATE, D3D12_BLEND_DESC> mBlendStates;
@@ -267,16 +317,28 @@ namespace EveryRay_Core
 
 		std::map<std::string, ER_RHI_DX12_GraphicsPSO> mGraphicsPSONames;
 		std::map<std::string, ER_RHI_DX12_ComputePSO> mComputePSONames;
-		std::string mCurrentGraphicsPSOName;
-		std::string mCurrentComputePSOName;
-		std::string mCurrentSetGraphicsPSOName; //which was set to command list already
-		std::string mCurrentSetComputePSOName; //which was set to command list already
-		ER_RHI_DX12_PSO_STATE mCurrentPSOState = ER_RHI_DX12_PSO_STATE::UNSET;
+		ER_RHI_DX12_PSOContext mPSOContexts[ER_RHI_MAX_GRAPHICS_COMMAND_LISTS];
+		ER_RHI_DX12_PSOContext mComputePSOContexts[ER_RHI_MAX_COMPUTE_COMMAND_LISTS];
+		ER_RHI_PRIMITIVE_TYPE mCurrentTopologyType = ER_RHI_PRIMITIVE_TYPE::ER_PRIMITIVE_TOPOLOGY_TRIANGLELIST; // of the main thread, restored in ReopenGraphicsCommandList()
+		std::mutex mResourceStatesMutex; // resources can be transitioned by several recording threads
+#if defined(_DEBUG) || defined(DEBUG)
+		// list of the context that transitioned the resource during ExecuteParallelCommandContexts() (-1: several contexts, the resource had to be transitioned before the call)
+		std::map<ER_RHI_GPUResource*, int> mParallelContextsTransitions;
+#endif
+		// names of the event tags that are open on every graphics list: they are ended before the list is closed in the middle of the frame
+		// and begun again when it is reopened, so every tag begins and ends in the same list
+		std::vector<std::string> mOpenEventTags[ER_RHI_MAX_GRAPHICS_COMMAND_LISTS];
 
 		ER_RHI_DX12_GPUDescriptorHeapManager* mDescriptorHeapManager = nullptr;
 
 		ComPtr<ID3D12CommandSignature> mCommandSignature_DrawIndexed;
 
+		// one upload buffer for constant buffer updates of all frames in flight (see ER_RHI_ConstantRingAllocator)
+		ComPtr<ID3D12Resource> mConstantRingBuffer;
+		unsigned char* mConstantRingMappedData = nullptr;
+		ER_RHI_ConstantRingAllocator mConstantRingAllocator;
+		std::mutex mConstantRingMutex;
+
 		D3D12_SAMPLER_DESC mEmptySampler;
 
 		bool mIsRaytracingTierAvailable = false;
@@ -18,7 +18,11 @@ namespace EveryRay_Core
 			mBufferUpload[frameIndex].Reset();
 			//if (mBufferUpload[frameIndex] && mIsDynamic)
 			//	mBufferUpload[frameIndex]->Unmap(0, nullptr);
+			ER_RHI_DX12_GPUDescriptorHeapManager::FreeCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, mBufferCBVHandle[frameIndex]);
 		}
+
+		ER_RHI_DX12_GPUDescriptorHeapManager::FreeCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, mBufferSRVHandle);
+		ER_RHI_DX12_GPUDescriptorHeapManager::FreeCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, mBufferUAVHandle);
 	}
 
 	void ER_RHI_DX12_GPUBuffer::CreateGPUBufferResource(ER_RHI* aRHI, void* aData, UINT objectsCount, UINT byteStride, bool isDynamic /*= false*/, ER_RHI_BIND_FLAG bindFlags /*= 0*/, UINT cpuAccessFlags /*= 0*/, ER_RHI_RESOURCE_MISC_FLAG miscFlags /*= 0*/, ER_RHI_FORMAT format /*= ER_FORMAT_UNKNOWN*/)
@@ -87,7 +91,7 @@ namespace EveryRay_Core
 
 			if (bindFlags & ER_RHI_BIND_FLAG::ER_BIND_CONSTANT_BUFFER)
 			{
-				mBufferCBVHandle[frameIndex] = descriptorHeapManager->CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, frameIndex);
+				mBufferCBVHandle[frameIndex] = descriptorHeapManager->CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
 				D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
 				cbvDesc.BufferLocation = mBufferUpload[frameIndex]->GetGPUVirtualAddress();
@@ -249,6 +253,51 @@ namespace EveryRay_Core
 		}
 		//else
 		//	UpdateSubresource(aRHI, aData, dataSize, aRHIDX12->GetCurrentGraphicsCommandListIndex());
+
+		// data is in our own upload buffer now, so CBVs must not point to the constant ring anymore
+		if (mBindFlags & ER_BIND_CONSTANT_BUFFER)
+		{
+			for (int i = 0; i < DX12_MAX_BACK_BUFFER_COUNT; i++)
+			{
+				if ((updateForAllBackBuffers || i == ER_RHI_DX12::mBackBufferIndex) && mCBVRingFrameNumbers[i] != 0)
+					ResetCBVLocation(aRHI, i);
+			}
+		}
+	}
+
+	void ER_RHI_DX12_GPUBuffer::SetCBVRingLocation(ER_RHI* aRHI, D3D12_GPU_VIRTUAL_ADDRESS aLocation, UINT64 aFrameNumber)
+	{
+		assert(mBindFlags & ER_BIND_CONSTANT_BUFFER);
+		assert(aFrameNumber > 0);
+		ER_RHI_DX12* aRHIDX12 = static_cast<ER_RHI_DX12*>(aRHI);
+
+		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+		cbvDesc.BufferLocation = aLocation;
+		cbvDesc.SizeInBytes = ER_BitmaskAlign(static_cast<UINT>(mSize), ER_RHI_CONSTANT_RING_ALIGNMENT);
+		aRHIDX12->GetDevice()->CreateConstantBufferView(&cbvDesc, mBufferCBVHandle[ER_RHI_DX12::mBackBufferIndex].GetCPUHandle());
+
+		mCBVRingFrameNumbers[ER_RHI_DX12::mBackBufferIndex] = aFrameNumber;
+	}
+
+	void ER_RHI_DX12_GPUBuffer::ResetCBVLocation(ER_RHI* aRHI, int aBackBufferIndex)
+	{
+		assert(mBindFlags & ER_BIND_CONSTANT_BUFFER);
+		ER_RHI_DX12* aRHIDX12 = static_cast<ER_RHI_DX12*>(aRHI);
+
+		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc = {};
+		cbvDesc.BufferLocation = mBufferUpload[aBackBufferIndex]->GetGPUVirtualAddress();
+		cbvDesc.SizeInBytes = mSize;
+		aRHIDX12->GetDevice()->CreateConstantBufferView(&cbvDesc, mBufferCBVHandle[aBackBufferIndex].GetCPUHandle());
+
+		mCBVRingFrameNumbers[aBackBufferIndex] = 0;
+	}
+
+	void ER_RHI_DX12_GPUBuffer::StoreCBVShadowData(const void* aData, int dataSize)
+	{
+		assert(mSize >= dataSize);
+		if (mCBVShadowData.size() != static_cast<size_t>(mSize))
+			mCBVShadowData.resize(mSize, 0);
+		memcpy(&mCBVShadowData[0], aData, dataSize);
 	}
 
 }
\ No newline at end of file
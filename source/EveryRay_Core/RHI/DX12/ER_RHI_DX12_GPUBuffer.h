@@ -34,6 +34,13 @@ namespace EveryRay_Core
 		void Map(ER_RHI* aRHI, void** aOutData);
 		void Unmap(ER_RHI* aRHI);
 		void Update(ER_RHI* aRHI, void* aData, int dataSize, bool updateForAllBackBuffers = false);
+
+		// Constant buffers updated with ER_RHI_DX12::UpdateConstantBuffer() point the CBV of the current back buffer to a range in the constant ring
+		void SetCBVRingLocation(ER_RHI* aRHI, D3D12_GPU_VIRTUAL_ADDRESS aLocation, UINT64 aFrameNumber);
+		void ResetCBVLocation(ER_RHI* aRHI, int aBackBufferIndex);
+		UINT64 GetCBVRingFrameNumber() const { return mCBVRingFrameNumbers[ER_RHI_DX12::mBackBufferIndex]; }
+		void StoreCBVShadowData(const void* aData, int dataSize);
+		void* GetCBVShadowData() { return mCBVShadowData.empty() ? nullptr : &mCBVShadowData[0]; }
 		DXGI_FORMAT GetFormat() { return mFormat; }
 	private:
 		void UpdateSubresource(ER_RHI* aRHI, void* aData, int aSize, int cmdListIndex);
@@ -59,6 +66,8 @@ namespace EveryRay_Core
 
 		ER_RHI_BIND_FLAG mBindFlags;
 		unsigned char* mMappedData[DX12_MAX_BACK_BUFFER_COUNT];
+		UINT64 mCBVRingFrameNumbers[DX12_MAX_BACK_BUFFER_COUNT] = {}; // 0 - CBV points to our own upload buffer
+		std::vector<unsigned char> mCBVShadowData; // last data written to the ring (to reupload it if the buffer is bound in later frames without updates)
 		bool mIsDynamic = false;
 
 		std::string mDebugName;
@@ -1,6 +1,8 @@
 #include "ER_RHI_DX12_GPUDescriptorHeapManager.h"
 #include "..\..\ER_CoreException.h"
 
+#include <cassert>
+
 namespace EveryRay_Core
 {
 	ER_RHI_DX12_DescriptorHeap::ER_RHI_DX12_DescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, UINT numDescriptors, bool isReferencedByShader)
@@ -29,130 +31,209 @@ namespace EveryRay_Core
 	{
 	}
 
+	ER_RHI_DX12_DescriptorHeap::~ER_RHI_DX12_DescriptorHeap()
+	{
+	}
+
+	ER_RHI_DX12_DescriptorHandle ER_RHI_DX12_DescriptorHeap::MakeHandle(UINT index)
+	{
+		ER_RHI_DX12_DescriptorHandle newHandle;
+		D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = mDescriptorHeapCPUStart;
+		cpuHandle.ptr += index * mDescriptorSize;
+		newHandle.SetCPUHandle(cpuHandle);
+
+		if (mIsReferencedByShader)
+		{
+			D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = mDescriptorHeapGPUStart;
+			gpuHandle.ptr += index * mDescriptorSize;
+			newHandle.SetGPUHandle(gpuHandle);
+		}
+
+		newHandle.SetHeapIndex(index);
+		return newHandle;
+	}
+
+	std::string ER_RHI_DX12_DescriptorHeap::GetStatsText(const ER_RHI_DescriptorAllocatorStats& stats)
+	{
+		return " (heap type: " + std::to_string(static_cast<int>(mHeapType)) +
+			", capacity: " + std::to_string(stats.capacity) +
+			", allocated: " + std::to_string(stats.allocatedCount) +
+			", peak: " + std::to_string(stats.allocatedCountPeak) +
+			", largest free block: " + std::to_string(stats.largestFreeBlock) + ")";
+	}
+
 	ER_RHI_DX12_CPUDescriptorHeap::ER_RHI_DX12_CPUDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, UINT numDescriptors)
 		: ER_RHI_DX12_DescriptorHeap(device, heapType, numDescriptors, false)
 	{
-		mCurrentDescriptorIndex = 0;
-		mActiveHandleCount = 0;
+		mAllocator.Initialize(numDescriptors);
 	}
 
 	ER_RHI_DX12_CPUDescriptorHeap::~ER_RHI_DX12_CPUDescriptorHeap()
 	{
-		mFreeDescriptors.clear();
 	}
 
 	ER_RHI_DX12_DescriptorHandle ER_RHI_DX12_CPUDescriptorHeap::GetNewHandle()
 	{
-		UINT newHandleID = 0;
-
-		if (mCurrentDescriptorIndex < mMaxNumDescriptors)
-		{
-			newHandleID = mCurrentDescriptorIndex;
-			mCurrentDescriptorIndex++;
-		}
-		else if (mFreeDescriptors.size() > 0)
-		{
-			newHandleID = mFreeDescriptors.back();
-			mFreeDescriptors.pop_back();
-		}
-		else
-			throw ER_CoreException("ER_RHI_DX12: Ran out of dynamic descriptor heap handles, need to increase heap size");
-
-		ER_RHI_DX12_DescriptorHandle newHandle;
-		D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = mDescriptorHeapCPUStart;
-		cpuHandle.ptr += newHandleID * mDescriptorSize;
-		newHandle.SetCPUHandle(cpuHandle);
-		newHandle.SetHeapIndex(newHandleID);
-		mActiveHandleCount++;
+		const std::lock_guard<std::mutex> lock(mAllocationMutex);
+		UINT index = mAllocator.Allocate();
+		if (index == ER_RHI_DESCRIPTOR_INVALID_INDEX)
+			throw ER_CoreException(("ER_RHI_DX12: Ran out of CPU descriptor heap handles, need to increase heap size" + GetStatsText(mAllocator.GetStats())).c_str());
 
-		return newHandle;
+		return MakeHandle(index);
 	}
 
-	void ER_RHI_DX12_CPUDescriptorHeap::FreeHandle(ER_RHI_DX12_DescriptorHandle& handle)
+	bool ER_RHI_DX12_CPUDescriptorHeap::FreeHandle(ER_RHI_DX12_DescriptorHandle& handle)
 	{
-		mFreeDescriptors.push_back(handle.GetHeapIndex());
-
-		if (mActiveHandleCount == 0)
-			throw ER_CoreException("ER_RHI_DX12: Freeing heap handles when there should be none left");
-
-		mActiveHandleCount--;
+		const std::lock_guard<std::mutex> lock(mAllocationMutex);
+		return mAllocator.Free(handle.GetHeapIndex());
 	}
 
-	ER_RHI_DX12_GPUDescriptorHeap::ER_RHI_DX12_GPUDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, UINT numDescriptors)
+	ER_RHI_DX12_GPUDescriptorHeap::ER_RHI_DX12_GPUDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, UINT numDescriptors, UINT numPersistentDescriptors)
 		: ER_RHI_DX12_DescriptorHeap(device, heapType, numDescriptors, true)
+		, mPersistentDescriptorsCount(numPersistentDescriptors)
 	{
-		mCurrentDescriptorIndex = 0;
+		assert(numPersistentDescriptors < numDescriptors);
+		mPersistentAllocator.Initialize(numPersistentDescriptors);
+		mRingAllocator.Initialize(numDescriptors - numPersistentDescriptors);
 	}
 
-	ER_RHI_DX12_DescriptorHandle ER_RHI_DX12_GPUDescriptorHeap::GetHandleBlock(UINT count)
+	void ER_RHI_DX12_GPUDescriptorHeap::BeginFrame(UINT64 frameNumber, UINT64 completedFrameNumber)
 	{
-		UINT newHandleID = 0;
-		UINT blockEnd = mCurrentDescriptorIndex + count;
+		const std::lock_guard<std::mutex> lock(mAllocationMutex);
+		mCurrentFrameNumber = frameNumber;
+		mRingAllocator.BeginFrame(frameNumber, completedFrameNumber);
 
-		if (blockEnd < mMaxNumDescriptors)
+		// GPU might still read persistent descriptors in the frames that were recorded before they were freed
+		auto it = mPendingPersistentFrees.begin();
+		while (it != mPendingPersistentFrees.end())
 		{
-			newHandleID = mCurrentDescriptorIndex;
-			mCurrentDescriptorIndex = blockEnd;
+			if (it->first <= completedFrameNumber)
+			{
+				mPersistentAllocator.Free(it->second);
+				it = mPendingPersistentFrees.erase(it);
+			}
+			else
+				++it;
 		}
-		else
-			throw ER_CoreException("ER_RHI_DX12: Ran out of GPU descriptor heap handles, need to increase heap size");
+	}
 
-		ER_RHI_DX12_DescriptorHandle newHandle;
-		D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle = mDescriptorHeapCPUStart;
-		cpuHandle.ptr += newHandleID * mDescriptorSize;
-		newHandle.SetCPUHandle(cpuHandle);
+	ER_RHI_DX12_DescriptorHandle ER_RHI_DX12_GPUDescriptorHeap::GetHandleBlock(UINT count)
+	{
+		const std::lock_guard<std::mutex> lock(mAllocationMutex);
+		UINT index = mRingAllocator.Allocate(count);
+		if (index == ER_RHI_DESCRIPTOR_INVALID_INDEX)
+			throw ER_CoreException(("ER_RHI_DX12: Ran out of GPU descriptor heap handles for the frame, need to increase heap size" + GetStatsText(mRingAllocator.GetStats())).c_str());
 
-		D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle = mDescriptorHeapGPUStart;
-		gpuHandle.ptr += newHandleID * mDescriptorSize;
-		newHandle.SetGPUHandle(gpuHandle);
+		return MakeHandle(mPersistentDescriptorsCount + index);
+	}
 
-		newHandle.SetHeapIndex(newHandleID);
+	ER_RHI_DX12_DescriptorHandle ER_RHI_DX12_GPUDescriptorHeap::GetPersistentHandle()
+	{
+		const std::lock_guard<std::mutex> lock(mAllocationMutex);
+		UINT index = mPersistentAllocator.Allocate();
+		if (index == ER_RHI_DESCRIPTOR_INVALID_INDEX)
+			throw ER_CoreException(("ER_RHI_DX12: Ran out of persistent (bindless) GPU descriptor heap handles, need to increase heap size" + GetStatsText(mPersistentAllocator.GetStats())).c_str());
 
-		return newHandle;
+		return MakeHandle(index);
 	}
 
-	void ER_RHI_DX12_GPUDescriptorHeap::Reset()
+	bool ER_RHI_DX12_GPUDescriptorHeap::FreePersistentHandle(ER_RHI_DX12_DescriptorHandle& handle)
 	{
-		mCurrentDescriptorIndex = 0;
+		const std::lock_guard<std::mutex> lock(mAllocationMutex);
+		if (!mPersistentAllocator.IsAllocated(handle.GetHeapIndex()))
+			return false;
+
+		mPendingPersistentFrees.push_back(std::make_pair(mCurrentFrameNumber, handle.GetHeapIndex()));
+		return true;
 	}
 
+	UINT ER_RHI_DX12_GPUDescriptorHeapManager::sGenerationCounter = 0;
+	ER_RHI_DX12_GPUDescriptorHeapManager* ER_RHI_DX12_GPUDescriptorHeapManager::sCurrentManager = nullptr;
+
 	ER_RHI_DX12_GPUDescriptorHeapManager::ER_RHI_DX12_GPUDescriptorHeapManager(ID3D12Device* device)
 	{
-		static const int MaxNoofSRVDescriptors = 4 * 4096;
-		
-		for (int i = 0; i < DX12_MAX_BACK_BUFFER_COUNT; i++)
-		{
-			ZeroMemory(mCPUDescriptorHeaps[i], sizeof(mCPUDescriptorHeaps[i]));
-			mCPUDescriptorHeaps[i][D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV] = new ER_RHI_DX12_CPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, MaxNoofSRVDescriptors);
-			mCPUDescriptorHeaps[i][D3D12_DESCRIPTOR_HEAP_TYPE_RTV] = new ER_RHI_DX12_CPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 128);
-			mCPUDescriptorHeaps[i][D3D12_DESCRIPTOR_HEAP_TYPE_DSV] = new ER_RHI_DX12_CPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 128);
-			mCPUDescriptorHeaps[i][D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER] = new ER_RHI_DX12_CPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 16);
-			
-			ZeroMemory(mGPUDescriptorHeaps[i], sizeof(mGPUDescriptorHeaps[i]));
-			mGPUDescriptorHeaps[i][D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV] = new ER_RHI_DX12_GPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, MaxNoofSRVDescriptors);
-			mGPUDescriptorHeaps[i][D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER] = new ER_RHI_DX12_GPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 16);
-		}
+		ZeroMemory(mCPUDescriptorHeaps, sizeof(mCPUDescriptorHeaps));
+		mCPUDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV] = new ER_RHI_DX12_CPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, DX12_MAX_CBV_SRV_UAV_CPU_DESCRIPTORS);
+		mCPUDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_RTV] = new ER_RHI_DX12_CPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 256);
+		mCPUDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_DSV] = new ER_RHI_DX12_CPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 256);
+		mCPUDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER] = new ER_RHI_DX12_CPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 16);
+
+		ZeroMemory(mGPUDescriptorHeaps, sizeof(mGPUDescriptorHeaps));
+		mGPUDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV] = new ER_RHI_DX12_GPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+			DX12_MAX_CBV_SRV_UAV_GPU_DESCRIPTORS, DX12_MAX_CBV_SRV_UAV_GPU_PERSISTENT_DESCRIPTORS);
+		mGPUDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER] = new ER_RHI_DX12_GPUDescriptorHeap(device, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 16 * DX12_MAX_BACK_BUFFER_COUNT);
+
+		mGeneration = ++sGenerationCounter;
+		sCurrentManager = this;
 	}
 
 	ER_RHI_DX12_GPUDescriptorHeapManager::~ER_RHI_DX12_GPUDescriptorHeapManager()
 	{
-		for (int j = 0; j < DX12_MAX_BACK_BUFFER_COUNT; j++)
+		for (int i = 0; i < D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES; i++)
 		{
-			for (int i = 0; i < D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES; i++)
-			{
-				DeleteObject(mCPUDescriptorHeaps[j][i]);
-				DeleteObject(mGPUDescriptorHeaps[j][i]);
-			}
+			DeleteObject(mCPUDescriptorHeaps[i]);
+			DeleteObject(mGPUDescriptorHeaps[i]);
 		}
+
+		if (sCurrentManager == this)
+			sCurrentManager = nullptr;
 	}
 
-	ER_RHI_DX12_DescriptorHandle ER_RHI_DX12_GPUDescriptorHeapManager::CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType, int frameIndex)
+	ER_RHI_DX12_DescriptorHandle ER_RHI_DX12_GPUDescriptorHeapManager::CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType)
 	{
-		return mCPUDescriptorHeaps[frameIndex >= 0 ? frameIndex : ER_RHI_DX12::mBackBufferIndex][heapType]->GetNewHandle();
+		ER_RHI_DX12_DescriptorHandle handle = mCPUDescriptorHeaps[heapType]->GetNewHandle();
+		handle.SetGeneration(mGeneration);
+		return handle;
 	}
 
 	ER_RHI_DX12_DescriptorHandle ER_RHI_DX12_GPUDescriptorHeapManager::CreateGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType, UINT count)
 	{
-		return mGPUDescriptorHeaps[ER_RHI_DX12::mBackBufferIndex][heapType]->GetHandleBlock(count);
+		return mGPUDescriptorHeaps[heapType]->GetHandleBlock(count);
+	}
+
+	ER_RHI_DX12_DescriptorHandle ER_RHI_DX12_GPUDescriptorHeapManager::CreatePersistentGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType)
+	{
+		ER_RHI_DX12_DescriptorHandle handle = mGPUDescriptorHeaps[heapType]->GetPersistentHandle();
+		handle.SetGeneration(mGeneration);
+		return handle;
+	}
+
+	void ER_RHI_DX12_GPUDescriptorHeapManager::FreeCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType, ER_RHI_DX12_DescriptorHandle& handle)
+	{
+		if (!sCurrentManager || handle.GetGeneration() != sCurrentManager->mGeneration)
+			return;
+
+		sCurrentManager->mCPUDescriptorHeaps[heapType]->FreeHandle(handle);
+		handle.SetGeneration(0);
+	}
+
+	void ER_RHI_DX12_GPUDescriptorHeapManager::FreePersistentGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType, ER_RHI_DX12_DescriptorHandle& handle)
+	{
+		if (!sCurrentManager || handle.GetGeneration() != sCurrentManager->mGeneration)
+			return;
+
+		sCurrentManager->mGPUDescriptorHeaps[heapType]->FreePersistentHandle(handle);
+		handle.SetGeneration(0);
+	}
+
+	void ER_RHI_DX12_GPUDescriptorHeapManager::BeginFrame(UINT64 frameNumber, UINT64 completedFrameNumber)
+	{
+		for (int i = 0; i < D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES; i++)
+		{
+			if (mGPUDescriptorHeaps[i])
+				mGPUDescriptorHeaps[i]->BeginFrame(frameNumber, completedFrameNumber);
+		}
+	}
+
+	void ER_RHI_DX12_GPUDescriptorHeapManager::GetStats(D3D12_DESCRIPTOR_HEAP_TYPE heapType, ER_RHI_DescriptorHeapStats& stats)
+	{
+		stats = ER_RHI_DescriptorHeapStats();
+		if (mCPUDescriptorHeaps[heapType])
+			stats.cpu = mCPUDescriptorHeaps[heapType]->GetStats();
+		if (mGPUDescriptorHeaps[heapType])
+		{
+			stats.persistent = mGPUDescriptorHeaps[heapType]->GetPersistentStats();
+			stats.transient = mGPUDescriptorHeaps[heapType]->GetTransientStats();
+		}
 	}
 }
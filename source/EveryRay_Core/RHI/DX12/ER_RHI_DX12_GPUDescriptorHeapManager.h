@@ -1,6 +1,11 @@
 #pragma once
 
 #include "ER_RHI_DX12.h"
+#include "..\ER_RHI_DescriptorAllocator.h"
+
+#define DX12_MAX_CBV_SRV_UAV_CPU_DESCRIPTORS (8 * 4096)
+#define DX12_MAX_CBV_SRV_UAV_GPU_DESCRIPTORS (16 * 4096)
+#define DX12_MAX_CBV_SRV_UAV_GPU_PERSISTENT_DESCRIPTORS (4 * 4096) // bindless range at the start of the shader-visible heap, the rest is the per-frame ring
 
 namespace EveryRay_Core
 {
@@ -12,15 +17,18 @@ namespace EveryRay_Core
 			mCPUHandle.ptr = NULL;
 			mGPUHandle.ptr = NULL;
 			mHeapIndex = 0;
+			mGeneration = 0;
 		}
 
 		D3D12_CPU_DESCRIPTOR_HANDLE& GetCPUHandle() { return mCPUHandle; }
 		D3D12_GPU_DESCRIPTOR_HANDLE& GetGPUHandle() { return mGPUHandle; }
 		UINT GetHeapIndex() { return mHeapIndex; }
+		UINT GetGeneration() { return mGeneration; }
 
 		void SetCPUHandle(D3D12_CPU_DESCRIPTOR_HANDLE cpuHandle) { mCPUHandle = cpuHandle; }
 		void SetGPUHandle(D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle) { mGPUHandle = gpuHandle; }
 		void SetHeapIndex(UINT heapIndex) { mHeapIndex = heapIndex; }
+		void SetGeneration(UINT generation) { mGeneration = generation; }
 
 		bool IsValid() { return mCPUHandle.ptr != NULL; }
 		bool IsReferencedByShader() { return mGPUHandle.ptr != NULL; }
@@ -29,6 +37,7 @@ namespace EveryRay_Core
 		D3D12_CPU_DESCRIPTOR_HANDLE mCPUHandle;
 		D3D12_GPU_DESCRIPTOR_HANDLE mGPUHandle;
 		UINT mHeapIndex;
+		UINT mGeneration; // of the heap manager that allocated the handle (0 - handle does not need to be freed)
 	};
 
 	class ER_RHI_DX12_DescriptorHeap
@@ -57,6 +66,9 @@ namespace EveryRay_Core
 		}
 
 	protected:
+		ER_RHI_DX12_DescriptorHandle MakeHandle(UINT index);
+		std::string GetStatsText(const ER_RHI_DescriptorAllocatorStats& stats);
+
 		ComPtr<ID3D12DescriptorHeap> mDescriptorHeap;
 		D3D12_DESCRIPTOR_HEAP_TYPE mHeapType;
 		D3D12_CPU_DESCRIPTOR_HANDLE mDescriptorHeapCPUStart;
@@ -64,6 +76,7 @@ namespace EveryRay_Core
 		UINT mMaxNumDescriptors;
 		UINT mDescriptorSize;
 		bool mIsReferencedByShader;
+		std::mutex mAllocationMutex; // resources and tables can be created by several recording threads (see ER_RHI::ExecuteParallelCommandContexts())
 	};
 
 	class ER_RHI_DX12_CPUDescriptorHeap : public ER_RHI_DX12_DescriptorHeap
@@ -73,25 +86,37 @@ namespace EveryRay_Core
 		~ER_RHI_DX12_CPUDescriptorHeap() final;
 
 		ER_RHI_DX12_DescriptorHandle GetNewHandle();
-		void FreeHandle(ER_RHI_DX12_DescriptorHandle& handle);
+		bool FreeHandle(ER_RHI_DX12_DescriptorHandle& handle);
+		ER_RHI_DescriptorAllocatorStats GetStats() const { return mAllocator.GetStats(); }
 
 	private:
-		std::vector<UINT> mFreeDescriptors;
-		UINT mCurrentDescriptorIndex;
-		UINT mActiveHandleCount;
+		ER_RHI_DescriptorFreeListAllocator mAllocator;
 	};
 
 	class ER_RHI_DX12_GPUDescriptorHeap : public ER_RHI_DX12_DescriptorHeap
 	{
 	public:
-		ER_RHI_DX12_GPUDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, UINT numDescriptors);
+		ER_RHI_DX12_GPUDescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE heapType, UINT numDescriptors, UINT numPersistentDescriptors = 0);
 		~ER_RHI_DX12_GPUDescriptorHeap() final {};
 
-		void Reset();
+		// Releases tables (and persistent descriptors freed in the meantime) of the frames that GPU has finished
+		void BeginFrame(UINT64 frameNumber, UINT64 completedFrameNumber);
+
+		// Transient table for the current frame (ring)
 		ER_RHI_DX12_DescriptorHandle GetHandleBlock(UINT count);
 
+		// Descriptor that stays valid until it is freed (bindless range), heap index of the handle is its index in the bindless range
+		ER_RHI_DX12_DescriptorHandle GetPersistentHandle();
+		bool FreePersistentHandle(ER_RHI_DX12_DescriptorHandle& handle); // actual free is deferred until GPU has finished the current frame
+
+		ER_RHI_DescriptorAllocatorStats GetPersistentStats() const { return mPersistentAllocator.GetStats(); }
+		ER_RHI_DescriptorAllocatorStats GetTransientStats() const { return mRingAllocator.GetStats(); }
 	private:
-		UINT mCurrentDescriptorIndex;
+		ER_RHI_DescriptorFreeListAllocator mPersistentAllocator;
+		ER_RHI_DescriptorRingAllocator mRingAllocator;
+		std::vector<std::pair<UINT64, UINT>> mPendingPersistentFrees; // frame number, index
+		UINT64 mCurrentFrameNumber = 0;
+		UINT mPersistentDescriptorsCount;
 	};
 
 	class ER_RHI_DX12_GPUDescriptorHeapManager
@@ -100,18 +125,31 @@ namespace EveryRay_Core
 		ER_RHI_DX12_GPUDescriptorHeapManager(ID3D12Device* device);
 		~ER_RHI_DX12_GPUDescriptorHeapManager();
 
-		ER_RHI_DX12_DescriptorHandle CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType, int frameIndex = -1);
+		ER_RHI_DX12_DescriptorHandle CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType);
 		ER_RHI_DX12_DescriptorHandle CreateGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType, UINT count);
+		ER_RHI_DX12_DescriptorHandle CreatePersistentGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType);
+
+		// Can be called from destructors of resources: handles of a manager that does not exist anymore (i.e., after ResetDescriptorManager()) are ignored
+		static void FreeCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType, ER_RHI_DX12_DescriptorHandle& handle);
+		static void FreePersistentGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE heapType, ER_RHI_DX12_DescriptorHandle& handle);
+
+		void BeginFrame(UINT64 frameNumber, UINT64 completedFrameNumber);
+		void GetStats(D3D12_DESCRIPTOR_HEAP_TYPE heapType, ER_RHI_DescriptorHeapStats& stats);
 
 		ER_RHI_DX12_GPUDescriptorHeap* GetGPUHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType)
 		{
-			return mGPUDescriptorHeaps[ER_RHI_DX12::mBackBufferIndex][heapType];
+			return mGPUDescriptorHeaps[heapType];
 		}
 
 	private:
-		ER_RHI_DX12_CPUDescriptorHeap* mCPUDescriptorHeaps[DX12_MAX_BACK_BUFFER_COUNT][D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
-		ER_RHI_DX12_GPUDescriptorHeap* mGPUDescriptorHeaps[DX12_MAX_BACK_BUFFER_COUNT][D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
-
+		// CPU descriptors are only copied from (at bind time), so one heap per type is enough;
+		// one shader-visible heap per type is shared by all frames in flight (transient tables are recycled with the frame fence)
+		ER_RHI_DX12_CPUDescriptorHeap* mCPUDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
+		ER_RHI_DX12_GPUDescriptorHeap* mGPUDescriptorHeaps[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES];
+
+		UINT mGeneration;
+		static UINT sGenerationCounter;
+		static ER_RHI_DX12_GPUDescriptorHeapManager* sCurrentManager;
 	};
 }
 
@@ -14,6 +14,25 @@ namespace EveryRay_Core
 	{
 		mResource.Reset();
 		mResourceUpload.Reset();
+
+		ER_RHI_DX12_GPUDescriptorHeapManager::FreeCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, mSRVHandle);
+		ER_RHI_DX12_GPUDescriptorHeapManager::FreeCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, mDSVHandle);
+		ER_RHI_DX12_GPUDescriptorHeapManager::FreeCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, mDSVReadOnlyHandle);
+		for (auto& handle : mRTVHandles)
+			ER_RHI_DX12_GPUDescriptorHeapManager::FreeCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, handle);
+		for (auto& handle : mUAVHandles)
+			ER_RHI_DX12_GPUDescriptorHeapManager::FreeCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, handle);
+		for (auto& handle : mUAVHandlesGPU)
+			ER_RHI_DX12_GPUDescriptorHeapManager::FreePersistentGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, handle);
+		ER_RHI_DX12_GPUDescriptorHeapManager::FreePersistentGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, mSRVHandleBindless);
+	}
+
+	// Copies the SRV to the persistent range of the shader-visible heap, so that shaders can access the texture by its index
+	void ER_RHI_DX12_GPUTexture::CreateBindlessSRV(ID3D12Device* device, ER_RHI_DX12_GPUDescriptorHeapManager* descriptorHeapManager)
+	{
+		ER_RHI_DX12_GPUDescriptorHeapManager::FreePersistentGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, mSRVHandleBindless);
+		mSRVHandleBindless = descriptorHeapManager->CreatePersistentGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		device->CopyDescriptorsSimple(1, mSRVHandleBindless.GetCPUHandle(), mSRVHandle.GetCPUHandle(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	}
 
 	void ER_RHI_DX12_GPUTexture::CreateGPUTextureResource(ER_RHI* aRHI, UINT width, UINT height, UINT samples, ER_RHI_FORMAT format, ER_RHI_BIND_FLAG bindFlags /*= ER_BIND_SHADER_RESOURCE | ER_BIND_RENDER_TARGET*/, int mip /*= 1*/, int depth /*= -1*/, int arraySize /*= 1*/, bool isCubemap /*= false*/, int cubemapArraySize /*= -1*/)
@@ -38,7 +57,6 @@ namespace EveryRay_Core
 		mIsCubemap = isCubemap;
 		mIsDepthStencil = bindFlags & ER_BIND_DEPTH_STENCIL;
 		mFormat = aRHIDX12->GetFormat(format);
-		mBackBufferIndex = ER_RHI_DX12::mBackBufferIndex;
 
 		DXGI_FORMAT depthstencil_tex_format;
 		DXGI_FORMAT depthstencil_srv_format;
@@ -221,7 +239,7 @@ namespace EveryRay_Core
 			for (int i = 0; i < mip; i++)
 			{
 				mUAVHandles[i] = descriptorHeapManager->CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-				mUAVHandlesGPU[i] = descriptorHeapManager->CreateGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 1);
+				mUAVHandlesGPU[i] = descriptorHeapManager->CreatePersistentGPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 				if (currentDepth > 0) {
 					uavDesc.Texture3D.MipSlice = i;
 					uavDesc.Texture3D.FirstWSlice = 0;
@@ -389,6 +407,7 @@ namespace EveryRay_Core
 				srvDesc.Texture3D.MipLevels = desc.MipLevels;
 			}
 			device->CreateShaderResourceView(mResource.Get(), &srvDesc, mSRVHandle.GetCPUHandle());
+			CreateBindlessSRV(device, descriptorHeapManager);
 			
 			mMipLevels = desc.MipLevels;
 			mFormat = desc.Format;
@@ -435,6 +454,7 @@ namespace EveryRay_Core
 			srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 			srvDesc.Texture2D.MipLevels = 1;
 			device->CreateShaderResourceView(mResource.Get(), &srvDesc, mSRVHandle.GetCPUHandle());
+			CreateBindlessSRV(device, descriptorHeapManager);
 			
 			mMipLevels = desc.MipLevels;
 			mFormat = desc.Format;
@@ -452,6 +472,97 @@ namespace EveryRay_Core
 		}
 	}
 
+	void ER_RHI_DX12_GPUTexture::CreateGPUTextureResource(ER_RHI* aRHI, const DirectX::ScratchImage& aImage, bool isInCopyQueue, UINT aFirstMip)
+	{
+		assert(aRHI);
+		ER_RHI_DX12* aRHIDX12 = static_cast<ER_RHI_DX12*>(aRHI);
+		ID3D12Device* device = aRHIDX12->GetDevice();
+		assert(device);
+
+		ER_RHI_DX12_GPUDescriptorHeapManager* descriptorHeapManager = aRHIDX12->GetDescriptorHeapManager();
+		assert(descriptorHeapManager);
+
+		mIsLoadedFromFile = true;
+		mCurrentResourceState = ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COPY_DEST;
+
+		// sub-chain of the image starting from 'aFirstMip' (images of a 2D texture are stored mip after mip)
+		assert(aFirstMip == 0 || (aImage.GetMetadata().arraySize == 1 && aImage.GetMetadata().depth == 1 && aFirstMip < aImage.GetMetadata().mipLevels));
+		const DirectX::Image* images = aImage.GetImages() + aFirstMip;
+		const size_t imagesCount = aImage.GetImageCount() - aFirstMip;
+		DirectX::TexMetadata metadata = aImage.GetMetadata();
+		metadata.width = images[0].width;
+		metadata.height = images[0].height;
+		metadata.mipLevels -= aFirstMip;
+		if (FAILED(DirectX::CreateTexture(device, metadata, &mResource)))
+			throw ER_CoreException("ER_RHI_DX12: Could not create a committed resource for the GPU texture resource (decoded image)");
+
+		std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+		if (FAILED(DirectX::PrepareUpload(device, images, imagesCount, metadata, subresources)))
+			throw ER_CoreException("ER_RHI_DX12: Could not prepare subresources of the decoded image for the upload");
+
+		// Create the GPU upload buffer and update subresources
+		const UINT64 uploadBufferSize = GetRequiredIntermediateSize(mResource.Get(), 0, static_cast<UINT>(subresources.size()));
+		if (FAILED(device->CreateCommittedResource(&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD), D3D12_HEAP_FLAG_NONE, &CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize), D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&mResourceUpload))))
+			throw ER_CoreException("ER_RHI_DX12: Could not create a committed resource for the GPU texture resource (upload)");
+
+		if (isInCopyQueue)
+		{
+			// copy queue can't transition to shader resource states: the texture decays to common after the copy and gets implicitly promoted on the graphics queue
+			UpdateSubresources(aRHIDX12->GetCopyCommandList(), mResource.Get(), mResourceUpload.Get(), 0, 0, static_cast<UINT>(subresources.size()), subresources.data());
+			mCurrentResourceState = ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_COMMON;
+			aRHIDX12->ReleaseAfterCopy(mResourceUpload); // streamed textures are recreated for every mip change, so their upload buffers must not stay with them
+		}
+		else
+		{
+			int cmdIndex = aRHIDX12->GetCurrentGraphicsCommandListIndex();
+			auto commandList = aRHIDX12->GetGraphicsCommandList(cmdIndex);
+			UpdateSubresources(commandList, mResource.Get(), mResourceUpload.Get(), 0, 0, static_cast<UINT>(subresources.size()), subresources.data());
+
+			auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(mResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+			commandList->ResourceBarrier(1, &barrier);
+
+			mCurrentResourceState = ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+		}
+
+		mSRVHandle = descriptorHeapManager->CreateCPUHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		D3D12_RESOURCE_DESC desc = mResource->GetDesc();
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Format = desc.Format;
+		if (metadata.IsCubemap())
+		{
+			srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+			srvDesc.TextureCube.MipLevels = desc.MipLevels;
+		}
+		else if (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE2D)
+		{
+			if (desc.DepthOrArraySize > 1)
+			{
+				srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+				srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+				srvDesc.Texture2DArray.ArraySize = desc.DepthOrArraySize;
+			}
+			else
+			{
+				srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+				srvDesc.Texture2D.MipLevels = desc.MipLevels;
+			}
+		}
+		else if (desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+		{
+			srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+			srvDesc.Texture3D.MipLevels = desc.MipLevels;
+		}
+		device->CreateShaderResourceView(mResource.Get(), &srvDesc, mSRVHandle.GetCPUHandle());
+		CreateBindlessSRV(device, descriptorHeapManager);
+
+		mMipLevels = desc.MipLevels;
+		mFormat = desc.Format;
+		mWidth = static_cast<UINT>(desc.Width);
+		mHeight = static_cast<UINT>(desc.Height);
+		mResource->SetName(mDebugName.c_str());
+	}
+
 	void ER_RHI_DX12_GPUTexture::CreateSimpleGPUTexture2DResource(ER_RHI* aRHI, UINT width, UINT height, DXGI_FORMAT format, ER_RHI_BIND_FLAG bindFlags /*= ER_BIND_NONE*/, int mip)
 	{
 		assert(aRHI);
@@ -617,6 +728,7 @@ namespace EveryRay_Core
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 		srvDesc.Texture2D.MipLevels = 1;
 		device->CreateShaderResourceView(mResource.Get(), &srvDesc, mSRVHandle.GetCPUHandle());
+		CreateBindlessSRV(device, descriptorHeapManager);
 
 		mFormat = desc.Format;
 		mWidth = static_cast<UINT>(desc.Width);
@@ -14,6 +14,7 @@ namespace EveryRay_Core
 			int mip = 1, int depth = -1, int arraySize = 1, bool isCubemap = false, int cubemapArraySize = -1) override;
 		virtual void CreateGPUTextureResource(ER_RHI* aRHI, const std::string& aPath, bool isFullPath = false, bool is3D = false, bool skipFallback = false, bool* statusFlag = nullptr, bool isSilent = false) override;
 		virtual void CreateGPUTextureResource(ER_RHI* aRHI, const std::wstring& aPath, bool isFullPath = false, bool is3D = false, bool skipFallback = false, bool* statusFlag = nullptr, bool isSilent = false) override;
+		virtual void CreateGPUTextureResource(ER_RHI* aRHI, const DirectX::ScratchImage& aImage, bool isInCopyQueue = false, UINT aFirstMip = 0) override;
 		void CreateSimpleGPUTexture2DResource(ER_RHI* aRHI, UINT width, UINT height, DXGI_FORMAT format, ER_RHI_BIND_FLAG bindFlags = ER_BIND_NONE, int mip = 1);
 
 		virtual void* GetRTV(void* aEmpty = nullptr) override { return nullptr; /* Not needed on DX12 */ }
@@ -33,6 +34,8 @@ namespace EveryRay_Core
 		ER_RHI_DX12_DescriptorHandle& GetUAVHandle(int index = 0) { return mUAVHandles[index]; }
 		ER_RHI_DX12_DescriptorHandle& GetUAVHandleGPU(int index = 0) { return mUAVHandlesGPU[index]; }
 		ER_RHI_DX12_DescriptorHandle& GetSRVHandle() { return mSRVHandle; }
+		ER_RHI_DX12_DescriptorHandle& GetSRVHandleBindless() { return mSRVHandleBindless; }
+		UINT GetBindlessSRVIndex() { return mSRVHandleBindless.GetHeapIndex(); } // index in the bindless range of the shader-visible heap (only for loaded textures)
 		ER_RHI_DX12_DescriptorHandle& GetDSVHandle(bool readOnly = false) { if (readOnly) return mDSVReadOnlyHandle; else return mDSVHandle; }
  
 		virtual UINT GetMips() override { return mMipLevels; }
@@ -43,11 +46,12 @@ namespace EveryRay_Core
 
 		bool IsLoadedFromFile() { return mIsLoadedFromFile; }
 		const std::wstring& GetDebugName() { return mDebugName; }
-		int GetBackBufferIndex() { return mBackBufferIndex; }
 	private:
 		void LoadFallbackTexture(ER_RHI* aRHI);
+		void CreateBindlessSRV(ID3D12Device* device, ER_RHI_DX12_GPUDescriptorHeapManager* descriptorHeapManager);
 
 		ER_RHI_DX12_DescriptorHandle mSRVHandle;
+		ER_RHI_DX12_DescriptorHandle mSRVHandleBindless; //shader visible heap (persistent range)
 		ER_RHI_DX12_DescriptorHandle mDSVHandle;
 		ER_RHI_DX12_DescriptorHandle mDSVReadOnlyHandle;
 		std::vector<ER_RHI_DX12_DescriptorHandle> mRTVHandles;
@@ -70,7 +74,6 @@ namespace EveryRay_Core
 		bool mIsDepthStencil = false;
 		bool mIsLoadedFromFile = false;
 
-		int mBackBufferIndex; //which heap we create our handles from etc. (only for non-loaded texture resources)
 
 		std::wstring mDebugName;
 	};
@@ -1,12 +1,18 @@
 #pragma once
 #include "..\Common.h"
+#include "ER_RHI_DescriptorAllocator.h"
+#include "ER_RHI_AsyncCompute.h"
 
-#define ER_RHI_MAX_GRAPHICS_COMMAND_LISTS 8
+#define ER_RHI_MAX_GRAPHICS_COMMAND_LISTS 16
+#define ER_RHI_MAX_PARALLEL_COMMAND_CONTEXTS 8 // graphics command lists [1; ER_RHI_MAX_PARALLEL_COMMAND_CONTEXTS] are recorded by the threads of ExecuteParallelCommandContexts()
 #define ER_RHI_MAX_COMPUTE_COMMAND_LISTS 2
 #define ER_RHI_MAX_BOUND_VERTEX_BUFFERS 2 //we only support 1 vertex buffer + 1 instance buffer
+#define ER_RHI_CONSTANT_RING_ALIGNMENT 256 // placement alignment of constant buffer views
 
 namespace EveryRay_Core
 {
+	class ER_WorkerPool;
+
 	static const int DefaultFrameRate = 60;
 	static inline void AbstractRHIMethodAssert() { assert(("You called an abstract method from ER_RHI", 0)); }
 
@@ -99,7 +105,8 @@ namespace EveryRay_Core
 		ER_RESOURCE_STATE_COPY_SOURCE,
 		ER_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
 		ER_RESOURCE_STATE_GENERIC_READ,
-		ER_RESOURCE_STATE_PRESENT
+		ER_RESOURCE_STATE_PRESENT,
+		ER_RESOURCE_STATE_COMPUTE_SHADER_RESOURCE // shader resource of the compute queue (it can not use pixel shader states), set by the RHI
 	};
 
 	enum ER_RHI_FORMAT
@@ -256,6 +263,90 @@ namespace EveryRay_Core
 		UINT mInputElementDescriptionCount;
 	};
 	
+	struct ER_RHI_ConstantRingStats
+	{
+		UINT64 capacityPerFrame = 0;
+		UINT64 bytesAllocated = 0;
+		UINT64 bytesAllocatedPeak = 0;
+		UINT allocationsCount = 0;
+		UINT overflowsCount = 0;
+	};
+
+	struct ER_RHI_ParallelCommandContextsStats
+	{
+		int contextsCount = 0;
+		double recordingTimeMs[ER_RHI_MAX_PARALLEL_COMMAND_CONTEXTS] = {}; // time spent in the callback of every context
+		double totalTimeMs = 0.0; // wall time of the whole section (threads + submission)
+	};
+
+	// Linear allocator for per-frame constant data: one region per frame in flight, allocations are bumped inside the region of the current frame
+	// and the whole region is recycled in BeginFrame() (backends call it after waiting for the fence of the frame that used the region last time).
+	// It only manages offsets (no GPU objects): backends map them to their upload buffers.
+	class ER_RHI_ConstantRingAllocator
+	{
+	public:
+		void Initialize(UINT64 aCapacityPerFrame, UINT aFramesCount, UINT aAlignment = ER_RHI_CONSTANT_RING_ALIGNMENT)
+		{
+			assert(aFramesCount > 0);
+			assert(ER_IsPowerOfTwo(static_cast<int>(aAlignment)));
+			mAlignment = aAlignment;
+			mCapacityPerFrame = (aCapacityPerFrame + aAlignment - 1) & ~static_cast<UINT64>(aAlignment - 1);
+			mFramesCount = aFramesCount;
+			mFrameIndex = 0;
+			mOffset = 0;
+			mStats = ER_RHI_ConstantRingStats();
+			mStats.capacityPerFrame = mCapacityPerFrame;
+			mLastFrameStats = mStats;
+		}
+
+		void BeginFrame(UINT aFrameIndex)
+		{
+			assert(aFrameIndex < mFramesCount);
+			mLastFrameStats = mStats;
+			mStats.bytesAllocated = 0;
+			mStats.allocationsCount = 0;
+			mStats.overflowsCount = 0;
+
+			mFrameIndex = aFrameIndex;
+			mOffset = 0;
+			mFrameNumber++;
+		}
+
+		// Returns false if the region of the current frame is full (the caller has to use some fallback), 'aOutOffset' is from the start of the whole ring
+		bool Allocate(UINT aSize, UINT64& aOutOffset)
+		{
+			const UINT64 alignedSize = (static_cast<UINT64>(aSize) + mAlignment - 1) & ~static_cast<UINT64>(mAlignment - 1);
+			if (mFrameNumber == 0 || alignedSize == 0 || mOffset + alignedSize > mCapacityPerFrame)
+			{
+				mStats.overflowsCount++;
+				return false;
+			}
+
+			aOutOffset = mFrameIndex * mCapacityPerFrame + mOffset;
+			mOffset += alignedSize;
+
+			mStats.bytesAllocated = mOffset;
+			if (mOffset > mStats.bytesAllocatedPeak)
+				mStats.bytesAllocatedPeak = mOffset;
+			mStats.allocationsCount++;
+			return true;
+		}
+
+		UINT64 GetTotalSize() const { return mCapacityPerFrame * mFramesCount; }
+		UINT64 GetFrameNumber() const { return mFrameNumber; } // starts from 1 after the first BeginFrame() and is not reset by Initialize(), 0 means "never allocated"
+		const ER_RHI_ConstantRingStats& GetStats() const { return mStats; }
+		const ER_RHI_ConstantRingStats& GetLastFrameStats() const { return mLastFrameStats; }
+	private:
+		ER_RHI_ConstantRingStats mStats;
+		ER_RHI_ConstantRingStats mLastFrameStats;
+		UINT64 mCapacityPerFrame = 0;
+		UINT64 mOffset = 0;
+		UINT64 mFrameNumber = 0;
+		UINT mFramesCount = 0;
+		UINT mFrameIndex = 0;
+		UINT mAlignment = ER_RHI_CONSTANT_RING_ALIGNMENT;
+	};
+
 	class ER_RHI_GPURootSignature;
 	class ER_RHI_GPUResource;
 	class ER_RHI_GPUTexture;
@@ -273,6 +364,7 @@ namespace EveryRay_Core
 		virtual void BeginGraphicsCommandList(int index = 0) = 0;
 		virtual void EndGraphicsCommandList(int index = 0) = 0;
 
+		// Compute passes (root signatures, PSOs, resources, dispatches, transitions) that are recorded between these calls go to the compute command list
 		virtual void BeginComputeCommandList(int index = 0) = 0;
 		virtual void EndComputeCommandList(int index = 0) = 0;
 
@@ -320,10 +412,34 @@ namespace EveryRay_Core
 		virtual void ExecuteCommandLists(int commandListIndex = 0, bool isCompute = false) = 0;
 		virtual void ExecuteCopyCommandList() = 0;
 
+		// Records 'aContextsCount' command contexts in parallel (one thread and one graphics command list per context, 'aRecord' gets the index of the context)
+		// and submits them in the order of their indices, right after everything that was recorded on the current graphics command list before the call.
+		// So the GPU sees the same order as if the contexts were recorded one after another. Rules for 'aRecord':
+		// - only the descriptor heap, the viewport, the rect and the topology of the current list are inherited: render targets, root signature and PSO have to be set again
+		// - PSOs have to be created and resources shared by several contexts have to be transitioned before the call (on the current list), debug DX12 builds log the ones transitioned by several contexts
+		// The current list is reopened after the call without its render targets, root signature and PSO. Event tags that are open on it are ended before it is submitted
+		// and begun again on the reopened list (so every tag begins and ends in the same list).
+		virtual void ExecuteParallelCommandContexts(const std::string& aName, int aContextsCount, const std::function<void(int aContextIndex)>& aRecord) = 0;
+		// Recommended number of contexts (1 if parallel recording is disabled or not supported by the API)
+		int GetParallelCommandContextsCount() { return mIsParallelRecordingEnabled ? mParallelCommandContextsCount : 1; }
+		void SetParallelRecordingEnabled(bool aValue) { mIsParallelRecordingEnabled = aValue; }
+		bool IsParallelRecordingEnabled() { return mIsParallelRecordingEnabled; }
+		const std::map<std::string, ER_RHI_ParallelCommandContextsStats>& GetParallelCommandContextsStats() { return mParallelCommandContextsStats; } // last call of every section
+
 		virtual void PresentGraphics() = 0;
 		virtual void PresentCompute() = 0;
 
-		virtual bool ProjectCubemapToSH(ER_RHI_GPUTexture* aTexture, UINT order, float* resultR, float* resultG, float* resultB) = 0; //WARNING: only works on DX11 for now
+		// Async compute (see ER_RHI_AsyncComputeScheduler): the queues are synchronized on the GPU, the CPU never waits here
+		virtual bool IsAsyncComputeSupported() = 0;
+		// Returns the signaled value of the queue's fence. Graphics: the current graphics command list is submitted first (and reopened, same as in ExecuteParallelCommandContexts())
+		virtual UINT64 SignalQueue(ER_RHI_QUEUE_TYPE aQueue) = 0;
+		// 'aQueue' executes the command lists submitted after this call only when the fence of the other queue reaches 'aValue'
+		virtual void WaitQueue(ER_RHI_QUEUE_TYPE aQueue, UINT64 aValue) = 0;
+		ER_RHI_AsyncComputeScheduler& GetAsyncComputeScheduler() { return mAsyncComputeScheduler; }
+		void SetAsyncComputeEnabled(bool aValue) { mIsAsyncComputeEnabled = aValue; }
+		bool IsAsyncComputeEnabled() { return mIsAsyncComputeEnabled && IsAsyncComputeSupported(); }
+
+		virtual bool ProjectCubemapToSH(ER_RHI_GPUTexture* aTexture, UINT order, float* resultR, float* resultG, float* resultB) = 0; // DX12 reads the texture back and projects it on the CPU (ER_SphericalHarmonics)
 
 		virtual void SaveGPUTextureToFile(ER_RHI_GPUTexture* aTexture, const std::wstring& aPathName) = 0; //WARNING: only works on DX11 for now
 
@@ -388,6 +504,11 @@ namespace EveryRay_Core
 		virtual void UnbindResourcesFromShader(ER_RHI_SHADER_TYPE aShaderType, bool unbindShader = true) = 0;
 
 		virtual void UpdateBuffer(ER_RHI_GPUBuffer* aBuffer, void* aData, int dataSize, bool updateForAllBackBuffers = false) = 0;
+		// Updates a constant buffer for the current frame (called by ER_RHI_GPUConstantBuffer::ApplyChanges()).
+		// Backends with a constant ring (DX12) sub-allocate the data from it, so every update gets its own memory; others just update the buffer.
+		virtual void UpdateConstantBuffer(ER_RHI_GPUBuffer* aBuffer, void* aData, int dataSize) { UpdateBuffer(aBuffer, aData, dataSize); }
+		virtual const ER_RHI_ConstantRingStats* GetConstantRingStats() { return nullptr; } // stats of the last finished frame, nullptr if there is no ring
+		virtual bool GetDescriptorStats(ER_RHI_DESCRIPTOR_HEAP_TYPE aType, ER_RHI_DescriptorHeapStats& aStats) { return false; } // false if the API does not manage descriptor heaps itself
 
 		virtual bool IsHardwareRaytracingSupported() = 0;
 		virtual bool IsRootConstantSupported() = 0;
@@ -411,10 +532,15 @@ namespace EveryRay_Core
 		virtual void EndEventTag(bool isComputeQueue = false) = 0;
 
 		inline const int GetPrepareGraphicsCommandListIndex() { return mPrepareGraphicsCommandListIndex; }
-		inline const int GetCurrentGraphicsCommandListIndex() { return mCurrentGraphicsCommandListIndex; }
+		// recording threads of ExecuteParallelCommandContexts() see their own list
+		inline const int GetCurrentGraphicsCommandListIndex() { return GetThreadGraphicsCommandListIndex() > -1 ? GetThreadGraphicsCommandListIndex() : mCurrentGraphicsCommandListIndex; }
+		inline bool IsRecordingParallelCommandContext() { return GetThreadGraphicsCommandListIndex() > -1; }
 		inline const int GetCurrentComputeCommandListIndex() { return mCurrentComputeCommandListIndex; }
 
 		ER_GRAPHICS_API GetAPI() { return mAPI; }
+
+		// threads of ExecuteParallelCommandContexts() (owned by ER_Core, set before Initialize())
+		void SetWorkerPool(ER_WorkerPool* aPool) { mWorkerPool = aPool; }
 	protected:
 		HWND mWindowHandle;
 
@@ -425,12 +551,21 @@ namespace EveryRay_Core
 		ER_RHI_BLEND_STATE mCurrentBS;
 		ER_RHI_DEPTH_STENCIL_STATE mCurrentDS;
 
-		ER_RHI_Viewport mCurrentViewport;
-		ER_RHI_Rect mCurrentRect;
+		ER_RHI_Viewport mCurrentViewport = {};
+		ER_RHI_Rect mCurrentRect = {};
 
 		const int mPrepareGraphicsCommandListIndex = ER_RHI_MAX_GRAPHICS_COMMAND_LISTS - 1; // command list for prepare commands (on init)
 		int mCurrentGraphicsCommandListIndex = -1;
 		int mCurrentComputeCommandListIndex = -1;
+
+		static int& GetThreadGraphicsCommandListIndex() { static thread_local int index = -1; return index; }
+		ER_WorkerPool* mWorkerPool = nullptr;
+		std::map<std::string, ER_RHI_ParallelCommandContextsStats> mParallelCommandContextsStats;
+		int mParallelCommandContextsCount = 1;
+		bool mIsParallelRecordingEnabled = true;
+
+		ER_RHI_AsyncComputeScheduler mAsyncComputeScheduler;
+		bool mIsAsyncComputeEnabled = true;
 	};
 
 	class ER_RHI_GPURootSignature
@@ -478,6 +613,10 @@ namespace EveryRay_Core
 			int mip = 1, int depth = -1, int arraySize = 1, bool isCubemap = false, int cubemapArraySize = -1) { AbstractRHIMethodAssert();	}
 		virtual void CreateGPUTextureResource(ER_RHI* aRHI, const std::string& aPath, bool isFullPath = false, bool is3D = false, bool skipFallback = false, bool* statusFlag = nullptr, bool isSilent = false) { AbstractRHIMethodAssert(); }
 		virtual void CreateGPUTextureResource(ER_RHI* aRHI, const std::wstring& aPath, bool isFullPath = false, bool is3D = false, bool skipFallback = false, bool* statusFlag = nullptr, bool isSilent = false) { AbstractRHIMethodAssert(); }
+		// Creates the texture from an image that was already read and decoded on the CPU (i.e., by ER_TextureStreamer's workers).
+		// If 'isInCopyQueue' is true, the upload is recorded into the copy command list (must be open) instead of the graphics one.
+		// 'aFirstMip' skips the most detailed mips of a 2D image, so that the texture only contains the rest of the chain (mip streaming).
+		virtual void CreateGPUTextureResource(ER_RHI* aRHI, const DirectX::ScratchImage& aImage, bool isInCopyQueue = false, UINT aFirstMip = 0) { AbstractRHIMethodAssert(); }
 
 		virtual void* GetRTV(void* aEmpty = nullptr) { AbstractRHIMethodAssert(); return nullptr; }
 		virtual void* GetRTV(int index) { AbstractRHIMethodAssert(); return nullptr; }
@@ -567,7 +706,7 @@ namespace EveryRay_Core
 			assert(rhi);
 			assert(buffer);
 
-			rhi->UpdateBuffer(buffer, &Data, sizeof(T));
+			rhi->UpdateConstantBuffer(buffer, &Data, sizeof(T));
 		}
 	};
 }
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "ER_RHI_AsyncCompute.h"
+#include "ER_RHI.h"
+
+#include "..\ER_Utility.h"
+
+#include <algorithm>
+
+namespace EveryRay_Core
+{
+	void ER_RHI_AsyncComputeScheduler::BeginFrame(ER_RHI* aRHI, bool isAsync)
+	{
+		assert(!mIsFrameStarted);
+		assert(mComputeOwnedResources.empty());
+
+		mRHI = aRHI;
+		mIsAsync = isAsync;
+		mIsFrameStarted = true;
+
+		mCommands.clear();
+		mJobNames.clear();
+		mJobResources.clear();
+		mErrors.clear();
+		mStats = ER_RHI_AsyncComputeStats();
+
+		mGraphicsFenceValueAtBeginFrame = mGraphicsFenceValue;
+		mComputeFenceValueAtBeginFrame = mComputeFenceValue;
+	}
+
+	int ER_RHI_AsyncComputeScheduler::Submit(const std::string& aName, const std::vector<ER_RHI_GPUResource*>& aReads, const std::vector<ER_RHI_GPUResource*>& aWrites, const std::function<void()>& aRecord)
+	{
+		assert(mIsFrameStarted);
+
+		const int jobIndex = static_cast<int>(mJobNames.size());
+		mJobNames.push_back(aName);
+		mJobResources.emplace_back();
+		mStats.jobsCount++;
+
+		if (!mIsAsync)
+		{
+			AddCommand(ER_ASYNC_COMPUTE_EXECUTE, ER_RHI_QUEUE_GRAPHICS, 0, nullptr, jobIndex);
+			if (mRHI)
+			{
+				mRHI->BeginEventTag(aName);
+				aRecord();
+				mRHI->EndEventTag();
+			}
+			return jobIndex;
+		}
+
+		// resources that are both read and written are released for writing
+		std::map<const ER_RHI_GPUResource*, bool> accesses;
+		for (ER_RHI_GPUResource* resource : aReads)
+		{
+			if (resource)
+				accesses.emplace(resource, false);
+		}
+		for (ER_RHI_GPUResource* resource : aWrites)
+		{
+			if (resource)
+				accesses[resource] = true;
+		}
+
+		// graphics -> compute ownership transfers
+		std::vector<ER_RHI_GPUResource*> releasedResources;
+		std::vector<ER_RHI_RESOURCE_STATE> releasedStates;
+		std::vector<ER_RHI_GPUResource*> upgradedResources; // were only read by the previous jobs, so the graphics queue might still read them
+		for (auto& access : accesses)
+		{
+			auto it = mComputeOwnedResources.find(access.first);
+			if (it != mComputeOwnedResources.end() && access.second && !it->second.isWrite)
+				upgradedResources.push_back(const_cast<ER_RHI_GPUResource*>(access.first));
+		}
+		if (!upgradedResources.empty())
+			Acquire(upgradedResources);
+
+		for (auto& access : accesses)
+		{
+			mJobResources[jobIndex].push_back(access.first);
+			if (IsOwnedByCompute(access.first))
+				continue;
+
+			releasedResources.push_back(const_cast<ER_RHI_GPUResource*>(access.first));
+			releasedStates.push_back(access.second ? ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_UNORDERED_ACCESS : ER_RHI_RESOURCE_STATE::ER_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			AddCommand(ER_ASYNC_COMPUTE_RELEASE, ER_RHI_QUEUE_GRAPHICS, 0, access.first, -1, access.second);
+
+			Ownership ownership;
+			ownership.isWrite = access.second;
+			mComputeOwnedResources.emplace(access.first, ownership);
+			mStats.releasesCount++;
+		}
+		if (mRHI && !releasedResources.empty())
+			mRHI->TransitionResources(releasedResources, releasedStates, mRHI->GetCurrentGraphicsCommandListIndex());
+
+		// job starts after everything that was recorded on the graphics queue so far (including the transitions above)
+		Wait(ER_RHI_QUEUE_COMPUTE, Signal(ER_RHI_QUEUE_GRAPHICS));
+
+		AddCommand(ER_ASYNC_COMPUTE_EXECUTE, ER_RHI_QUEUE_COMPUTE, 0, nullptr, jobIndex);
+		if (mRHI)
+		{
+			mRHI->BeginComputeCommandList();
+			mRHI->BeginEventTag(aName, true);
+			aRecord();
+			mRHI->EndEventTag(true);
+			mRHI->EndComputeCommandList();
+			mRHI->ExecuteCommandLists(0, true);
+		}
+		mStats.asyncJobsCount++;
+
+		const uint64_t jobFenceValue = Signal(ER_RHI_QUEUE_COMPUTE);
+		for (auto& access : accesses)
+		{
+			Ownership& ownership = mComputeOwnedResources.at(access.first);
+			ownership.lastJobFenceValue = jobFenceValue;
+			ownership.isWrite = ownership.isWrite || access.second;
+		}
+
+		return jobIndex;
+	}
+
+	void ER_RHI_AsyncComputeScheduler::Acquire(const std::vector<ER_RHI_GPUResource*>& aResources)
+	{
+		assert(mIsFrameStarted);
+
+		uint64_t valueToWait = 0;
+		std::vector<const ER_RHI_GPUResource*> acquiredResources;
+		for (ER_RHI_GPUResource* resource : aResources)
+		{
+			auto it = mComputeOwnedResources.find(resource);
+			if (it == mComputeOwnedResources.end())
+				continue;
+
+			valueToWait = std::max(valueToWait, it->second.lastJobFenceValue);
+			acquiredResources.push_back(resource);
+		}
+		if (acquiredResources.empty())
+			return;
+
+		if (valueToWait > mComputeFenceValueWaitedByGraphics)
+			Wait(ER_RHI_QUEUE_GRAPHICS, valueToWait);
+
+		// no transitions here: jobs leave the resources in the states that are valid on the graphics queue, its next use transitions them as usual
+		for (const ER_RHI_GPUResource* resource : acquiredResources)
+		{
+			AddCommand(ER_ASYNC_COMPUTE_ACQUIRE, ER_RHI_QUEUE_GRAPHICS, mComputeOwnedResources.at(resource).lastJobFenceValue, resource);
+			mComputeOwnedResources.erase(resource);
+			mStats.acquiresCount++;
+		}
+	}
+
+	void ER_RHI_AsyncComputeScheduler::EndFrame()
+	{
+		assert(mIsFrameStarted);
+
+		std::vector<ER_RHI_GPUResource*> ownedResources;
+		for (auto& it : mComputeOwnedResources)
+			ownedResources.push_back(const_cast<ER_RHI_GPUResource*>(it.first));
+		Acquire(ownedResources);
+
+		mIsFrameStarted = false;
+
+#if defined (_DEBUG) || (DEBUG)
+		if (!Validate())
+		{
+			for (const std::string& error : mErrors)
+				ER_OUTPUT_LOG(ER_Utility::ToWideString("[ER Logger][ER_RHI_AsyncComputeScheduler] " + error + '\n').c_str());
+		}
+#endif
+	}
+
+	bool ER_RHI_AsyncComputeScheduler::Validate()
+	{
+		mErrors.clear();
+
+		struct ReplayedOwnership
+		{
+			uint64_t graphicsValueAtRelease = 0; // last graphics value signaled before the release: compute has to wait for a bigger one
+			uint64_t lastJobFenceValue = 0;
+			bool isUsedByPendingJob = false; // executed, but the compute queue has not signaled since then
+		};
+		std::map<const ER_RHI_GPUResource*, ReplayedOwnership> owned;
+
+		uint64_t signaledValues[2] = { mGraphicsFenceValueAtBeginFrame, mComputeFenceValueAtBeginFrame };
+		uint64_t waitedValues[2] = { 0, 0 }; // values of the other queue's fence
+		const char* queueNames[2] = { "graphics", "compute" };
+
+		for (const ER_RHI_AsyncComputeCommand& command : mCommands)
+		{
+			const int queue = static_cast<int>(command.queue);
+			const int otherQueue = 1 - queue;
+			switch (command.type)
+			{
+			case ER_ASYNC_COMPUTE_RELEASE:
+				if (command.queue != ER_RHI_QUEUE_GRAPHICS)
+					mErrors.push_back("resource is released on the compute queue");
+				else if (owned.find(command.resource) != owned.end())
+					mErrors.push_back("resource is released while it is already owned by the compute queue");
+				else
+					owned[command.resource].graphicsValueAtRelease = signaledValues[ER_RHI_QUEUE_GRAPHICS];
+				break;
+			case ER_ASYNC_COMPUTE_SIGNAL:
+				if (command.fenceValue <= signaledValues[queue])
+					mErrors.push_back(std::string("fence values of the ") + queueNames[queue] + " queue do not grow");
+				signaledValues[queue] = command.fenceValue;
+				if (command.queue == ER_RHI_QUEUE_COMPUTE)
+				{
+					for (auto& it : owned)
+					{
+						if (it.second.isUsedByPendingJob)
+						{
+							it.second.lastJobFenceValue = command.fenceValue;
+							it.second.isUsedByPendingJob = false;
+						}
+					}
+				}
+				break;
+			case ER_ASYNC_COMPUTE_WAIT:
+				if (command.fenceValue > signaledValues[otherQueue])
+					mErrors.push_back(std::string("the ") + queueNames[queue] + " queue waits for a value that was not signaled yet (deadlock)");
+				waitedValues[queue] = std::max(waitedValues[queue], command.fenceValue);
+				break;
+			case ER_ASYNC_COMPUTE_EXECUTE:
+				if (command.jobIndex < 0 || command.jobIndex >= static_cast<int>(mJobResources.size()))
+				{
+					mErrors.push_back("invalid job index");
+					break;
+				}
+				if (command.queue != ER_RHI_QUEUE_COMPUTE)
+					break;
+				for (const ER_RHI_GPUResource* resource : mJobResources[command.jobIndex])
+				{
+					auto it = owned.find(resource);
+					if (it == owned.end())
+						mErrors.push_back("job '" + mJobNames[command.jobIndex] + "' uses a resource that is owned by the graphics queue");
+					else
+					{
+						if (waitedValues[ER_RHI_QUEUE_COMPUTE] <= it->second.graphicsValueAtRelease)
+							mErrors.push_back("job '" + mJobNames[command.jobIndex] + "' does not wait for the release of its resource on the graphics queue");
+						it->second.isUsedByPendingJob = true;
+					}
+				}
+				break;
+			case ER_ASYNC_COMPUTE_ACQUIRE:
+			{
+				auto it = owned.find(command.resource);
+				if (it == owned.end())
+					mErrors.push_back("resource is acquired while it is owned by the graphics queue");
+				else
+				{
+					if (it->second.isUsedByPendingJob)
+						mErrors.push_back("resource is acquired before the compute queue signaled the end of its last job");
+					else if (waitedValues[ER_RHI_QUEUE_GRAPHICS] < it->second.lastJobFenceValue)
+						mErrors.push_back("resource is acquired without waiting for its last job");
+					owned.erase(it);
+				}
+				break;
+			}
+			}
+		}
+
+		if (!mIsFrameStarted && !owned.empty())
+			mErrors.push_back("resources are still owned by the compute queue at the end of the frame");
+
+		return mErrors.empty();
+	}
+
+	void ER_RHI_AsyncComputeScheduler::AddCommand(ER_RHI_ASYNC_COMPUTE_COMMAND_TYPE aType, ER_RHI_QUEUE_TYPE aQueue, uint64_t aFenceValue, const ER_RHI_GPUResource* aResource, int aJobIndex, bool isWrite)
+	{
+		ER_RHI_AsyncComputeCommand command;
+		command.type = aType;
+		command.queue = aQueue;
+		command.fenceValue = aFenceValue;
+		command.resource = aResource;
+		command.jobIndex = aJobIndex;
+		command.isWrite = isWrite;
+		mCommands.push_back(command);
+	}
+
+	uint64_t ER_RHI_AsyncComputeScheduler::Signal(ER_RHI_QUEUE_TYPE aQueue)
+	{
+		uint64_t& value = aQueue == ER_RHI_QUEUE_GRAPHICS ? mGraphicsFenceValue : mComputeFenceValue;
+		value = mRHI ? mRHI->SignalQueue(aQueue) : value + 1;
+		AddCommand(ER_ASYNC_COMPUTE_SIGNAL, aQueue, value);
+		return value;
+	}
+
+	void ER_RHI_AsyncComputeScheduler::Wait(ER_RHI_QUEUE_TYPE aQueue, uint64_t aValue)
+	{
+		if (mRHI)
+			mRHI->WaitQueue(aQueue, aValue);
+		AddCommand(ER_ASYNC_COMPUTE_WAIT, aQueue, aValue);
+
+		if (aQueue == ER_RHI_QUEUE_GRAPHICS)
+		{
+			mComputeFenceValueWaitedByGraphics = std::max(mComputeFenceValueWaitedByGraphics, aValue);
+			mStats.graphicsWaitsCount++;
+		}
+		else
+			mStats.computeWaitsCount++;
+	}
+}
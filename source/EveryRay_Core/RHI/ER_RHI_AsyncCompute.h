@@ -0,0 +1,107 @@
+// Async compute scheduling in EveryRay Rendering Engine
+// Compute jobs (i.e., volumetric fog, volumetric clouds, GPU culling) are submitted to the compute queue, so that they overlap the rasterization on the graphics queue.
+// The scheduler decides where every job runs and how the queues are synchronized:
+// - a job waits (on the GPU) for everything that was recorded on the graphics queue before it and signals the compute fence when it is done
+// - resources of a job are released by the graphics queue first (transitioned to the states that the compute queue can use: shader resource or UAV).
+//   The graphics queue has to Acquire() them back before it reads the results or writes/transitions the resources. Resources that the jobs only read
+//   can still be read by the graphics queue in shader resource states (i.e., shadow maps)
+// - EndFrame() acquires everything, so nothing is owned by the compute queue between frames
+// Every decision is recorded into a list of commands, EndFrame() checks the commands of the frame with Validate() in debug builds.
+#pragma once
+#include <vector>
+#include <string>
+#include <map>
+#include <functional>
+#include <cstdint>
+
+namespace EveryRay_Core
+{
+	class ER_RHI;
+	class ER_RHI_GPUResource;
+
+	enum ER_RHI_QUEUE_TYPE
+	{
+		ER_RHI_QUEUE_GRAPHICS,
+		ER_RHI_QUEUE_COMPUTE
+	};
+
+	enum ER_RHI_ASYNC_COMPUTE_COMMAND_TYPE
+	{
+		ER_ASYNC_COMPUTE_RELEASE, // graphics -> compute ownership transfer of a resource (transition on the graphics queue)
+		ER_ASYNC_COMPUTE_SIGNAL, // queue signals its fence
+		ER_ASYNC_COMPUTE_WAIT, // queue waits for a value of the fence of the other queue
+		ER_ASYNC_COMPUTE_EXECUTE, // job is recorded and submitted
+		ER_ASYNC_COMPUTE_ACQUIRE // compute -> graphics ownership transfer of a resource
+	};
+
+	struct ER_RHI_AsyncComputeCommand
+	{
+		ER_RHI_ASYNC_COMPUTE_COMMAND_TYPE type;
+		ER_RHI_QUEUE_TYPE queue;
+		uint64_t fenceValue = 0; // SIGNAL: signaled value, WAIT: awaited value of the other queue, ACQUIRE: value of the last job that used the resource
+		const ER_RHI_GPUResource* resource = nullptr; // RELEASE, ACQUIRE
+		int jobIndex = -1; // EXECUTE
+		bool isWrite = false; // RELEASE
+	};
+
+	struct ER_RHI_AsyncComputeStats
+	{
+		uint32_t jobsCount = 0;
+		uint32_t asyncJobsCount = 0; // on the compute queue
+		uint32_t graphicsWaitsCount = 0;
+		uint32_t computeWaitsCount = 0;
+		uint32_t releasesCount = 0;
+		uint32_t acquiresCount = 0;
+	};
+
+	class ER_RHI_AsyncComputeScheduler
+	{
+	public:
+		// 'isAsync' - false runs the jobs on the graphics queue (API without async compute or disabled by the user)
+		void BeginFrame(ER_RHI* aRHI, bool isAsync);
+		// 'aReads'/'aWrites' have to contain every resource that 'aRecord' uses. Returns the index of the job in the frame.
+		int Submit(const std::string& aName, const std::vector<ER_RHI_GPUResource*>& aReads, const std::vector<ER_RHI_GPUResource*>& aWrites, const std::function<void()>& aRecord);
+		// Graphics queue waits for the last jobs that used the resources and takes them back (does nothing for the resources owned by the graphics queue)
+		void Acquire(const std::vector<ER_RHI_GPUResource*>& aResources);
+		void EndFrame();
+
+		// Checks the commands of the last frame: waits only refer to values that were signaled before, jobs only use resources owned by the compute queue,
+		// resources are only acquired after waiting for their last job and nothing is owned by the compute queue at the end of the frame.
+		// Returns false if the schedule is invalid (see GetErrors()).
+		bool Validate();
+
+		bool IsAsync() const { return mIsAsync; }
+		bool IsOwnedByCompute(const ER_RHI_GPUResource* aResource) const { return mComputeOwnedResources.find(aResource) != mComputeOwnedResources.end(); }
+
+		const std::vector<ER_RHI_AsyncComputeCommand>& GetCommands() const { return mCommands; }
+		const std::vector<std::string>& GetJobNames() const { return mJobNames; }
+		const std::vector<std::string>& GetErrors() const { return mErrors; }
+		const ER_RHI_AsyncComputeStats& GetStats() const { return mStats; }
+	private:
+		struct Ownership
+		{
+			uint64_t lastJobFenceValue = 0; // compute fence value signaled after the last job that used the resource
+			bool isWrite = false; // written by a job (graphics queue can not read it either)
+		};
+
+		void AddCommand(ER_RHI_ASYNC_COMPUTE_COMMAND_TYPE aType, ER_RHI_QUEUE_TYPE aQueue, uint64_t aFenceValue, const ER_RHI_GPUResource* aResource = nullptr, int aJobIndex = -1, bool isWrite = false);
+		uint64_t Signal(ER_RHI_QUEUE_TYPE aQueue);
+		void Wait(ER_RHI_QUEUE_TYPE aQueue, uint64_t aValue);
+
+		std::map<const ER_RHI_GPUResource*, Ownership> mComputeOwnedResources;
+		std::vector<ER_RHI_AsyncComputeCommand> mCommands;
+		std::vector<std::string> mJobNames;
+		std::vector<std::vector<const ER_RHI_GPUResource*>> mJobResources; // for Validate()
+		std::vector<std::string> mErrors;
+		ER_RHI_AsyncComputeStats mStats;
+
+		ER_RHI* mRHI = nullptr;
+		uint64_t mGraphicsFenceValue = 0; // last signaled values (they are kept between frames, same as the fences)
+		uint64_t mComputeFenceValue = 0;
+		uint64_t mGraphicsFenceValueAtBeginFrame = 0;
+		uint64_t mComputeFenceValueAtBeginFrame = 0;
+		uint64_t mComputeFenceValueWaitedByGraphics = 0;
+		bool mIsAsync = false;
+		bool mIsFrameStarted = false;
+	};
+}
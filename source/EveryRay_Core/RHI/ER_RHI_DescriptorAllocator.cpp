@@ -0,0 +1,184 @@
+#include "ER_RHI_DescriptorAllocator.h"
+
+#include <cassert>
+
+namespace EveryRay_Core
+{
+	void ER_RHI_DescriptorFreeListAllocator::Initialize(uint32_t aCapacity)
+	{
+		mCapacity = aCapacity;
+		mHighWaterMark = 0;
+		mFreeIndices.clear();
+		mFreeIndices.reserve(aCapacity);
+		mIsAllocated.assign(aCapacity, 0);
+		mStats = ER_RHI_DescriptorAllocatorStats();
+		mStats.capacity = aCapacity;
+	}
+
+	uint32_t ER_RHI_DescriptorFreeListAllocator::Allocate()
+	{
+		uint32_t index = ER_RHI_DESCRIPTOR_INVALID_INDEX;
+		if (!mFreeIndices.empty())
+		{
+			index = mFreeIndices.back();
+			mFreeIndices.pop_back();
+		}
+		else if (mHighWaterMark < mCapacity)
+			index = mHighWaterMark++;
+		else
+		{
+			mStats.exhaustionsCount++;
+			return ER_RHI_DESCRIPTOR_INVALID_INDEX;
+		}
+
+		assert(!mIsAllocated[index]);
+		mIsAllocated[index] = 1;
+
+		mStats.allocatedCount++;
+		mStats.allocationsCount++;
+		if (mStats.allocatedCount > mStats.allocatedCountPeak)
+			mStats.allocatedCountPeak = mStats.allocatedCount;
+		return index;
+	}
+
+	bool ER_RHI_DescriptorFreeListAllocator::Free(uint32_t aIndex)
+	{
+		if (aIndex >= mCapacity || !mIsAllocated[aIndex])
+		{
+			mStats.invalidFreesCount++;
+			return false;
+		}
+
+		mIsAllocated[aIndex] = 0;
+		mFreeIndices.push_back(aIndex);
+		mStats.allocatedCount--;
+		return true;
+	}
+
+	ER_RHI_DescriptorAllocatorStats ER_RHI_DescriptorFreeListAllocator::GetStats() const
+	{
+		ER_RHI_DescriptorAllocatorStats stats = mStats;
+		stats.largestFreeBlock = mCapacity - mHighWaterMark;
+		if (stats.largestFreeBlock == 0 && !mFreeIndices.empty())
+			stats.largestFreeBlock = 1;
+		stats.fragmentation = mHighWaterMark > 0 ? static_cast<float>(mFreeIndices.size()) / static_cast<float>(mHighWaterMark) : 0.0f;
+		return stats;
+	}
+
+	void ER_RHI_DescriptorRingAllocator::Initialize(uint32_t aCapacity)
+	{
+		mCapacity = aCapacity;
+		mHead = 0;
+		mTail = 0;
+		mAllocatedTotal = 0;
+		mReleasedTotal = 0;
+		mCurrentFrameNumber = 0;
+		mFrameMarkers.clear();
+		mStats = ER_RHI_DescriptorAllocatorStats();
+		mStats.capacity = aCapacity;
+	}
+
+	void ER_RHI_DescriptorRingAllocator::BeginFrame(uint64_t aFrameNumber, uint64_t aCompletedFrameNumber)
+	{
+		if (aFrameNumber != mCurrentFrameNumber)
+		{
+			FrameMarker marker;
+			marker.frameNumber = mCurrentFrameNumber;
+			marker.allocatedTotal = mAllocatedTotal;
+			marker.head = mHead;
+			mFrameMarkers.push_back(marker);
+
+			mCurrentFrameNumber = aFrameNumber;
+			mStats.allocationsCount = 0;
+		}
+
+		size_t releasedMarkersCount = 0;
+		for (const FrameMarker& marker : mFrameMarkers)
+		{
+			if (marker.frameNumber > aCompletedFrameNumber)
+				break;
+			mTail = marker.head;
+			mReleasedTotal = marker.allocatedTotal;
+			releasedMarkersCount++;
+		}
+		if (releasedMarkersCount > 0)
+			mFrameMarkers.erase(mFrameMarkers.begin(), mFrameMarkers.begin() + releasedMarkersCount);
+
+		ResetIfEmpty();
+	}
+
+	// nothing is in use: start from the beginning, so that we have the biggest contiguous space
+	void ER_RHI_DescriptorRingAllocator::ResetIfEmpty()
+	{
+		if (GetUsedCount() != 0)
+			return;
+
+		mHead = 0;
+		mTail = 0;
+		for (FrameMarker& marker : mFrameMarkers)
+			marker.head = 0;
+	}
+
+	uint32_t ER_RHI_DescriptorRingAllocator::Allocate(uint32_t aCount)
+	{
+		assert(aCount > 0);
+		ResetIfEmpty();
+
+		const uint32_t usedCount = GetUsedCount();
+		uint32_t index = ER_RHI_DESCRIPTOR_INVALID_INDEX;
+		if (usedCount < mCapacity && aCount <= mCapacity)
+		{
+			if (usedCount == 0 || mHead > mTail) // used range is [tail, head) or empty
+			{
+				if (mHead + aCount <= mCapacity)
+					index = mHead;
+				else if (aCount <= mTail) // skip the end of the ring
+				{
+					mAllocatedTotal += mCapacity - mHead;
+					mHead = 0;
+					index = 0;
+				}
+			}
+			else if (mHead + aCount <= mTail) // used ranges are [tail, capacity) and [0, head)
+				index = mHead;
+		}
+
+		if (index == ER_RHI_DESCRIPTOR_INVALID_INDEX)
+		{
+			mStats.exhaustionsCount++;
+			return ER_RHI_DESCRIPTOR_INVALID_INDEX;
+		}
+
+		mHead = index + aCount;
+		if (mHead == mCapacity)
+			mHead = 0;
+		mAllocatedTotal += aCount;
+
+		mStats.allocationsCount++;
+		if (GetUsedCount() > mStats.allocatedCountPeak)
+			mStats.allocatedCountPeak = GetUsedCount();
+		return index;
+	}
+
+	uint32_t ER_RHI_DescriptorRingAllocator::GetLargestFreeBlock() const
+	{
+		const uint32_t usedCount = GetUsedCount();
+		if (usedCount == 0)
+			return mCapacity;
+		if (usedCount >= mCapacity)
+			return 0;
+		if (mHead > mTail)
+			return (mCapacity - mHead) > mTail ? (mCapacity - mHead) : mTail;
+		return mTail - mHead;
+	}
+
+	ER_RHI_DescriptorAllocatorStats ER_RHI_DescriptorRingAllocator::GetStats() const
+	{
+		ER_RHI_DescriptorAllocatorStats stats = mStats;
+		stats.allocatedCount = GetUsedCount();
+		stats.largestFreeBlock = GetLargestFreeBlock();
+		const uint32_t freeCount = mCapacity - stats.allocatedCount;
+		stats.fragmentation = freeCount > 0 ? 1.0f - static_cast<float>(stats.largestFreeBlock) / static_cast<float>(freeCount) : 0.0f;
+		return stats;
+	}
+}
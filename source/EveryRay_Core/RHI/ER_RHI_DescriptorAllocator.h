@@ -0,0 +1,88 @@
+// Platform-neutral descriptor allocation logic in EveryRay Rendering Engine
+// Only manages indices inside descriptor heaps (no API objects, no windows headers).
+// Backends (see ER_RHI_DX12_GPUDescriptorHeapManager) turn the indices into API handles.
+
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#define ER_RHI_DESCRIPTOR_INVALID_INDEX 0xffffffff
+
+namespace EveryRay_Core
+{
+	struct ER_RHI_DescriptorAllocatorStats
+	{
+		uint32_t capacity = 0;
+		uint32_t allocatedCount = 0;
+		uint32_t allocatedCountPeak = 0;
+		uint32_t largestFreeBlock = 0; // biggest contiguous block that can be allocated right now
+		uint32_t allocationsCount = 0; // since the last BeginFrame() (ring) or since initialization (free-list)
+		uint32_t exhaustionsCount = 0; // failed allocations
+		uint32_t invalidFreesCount = 0; // double frees and indices outside of the allocator
+		float fragmentation = 0.0f; // free-list: free holes below the high water mark / high water mark; ring: 1 - largestFreeBlock / free descriptors
+	};
+
+	struct ER_RHI_DescriptorHeapStats
+	{
+		ER_RHI_DescriptorAllocatorStats cpu; // non shader-visible descriptors of resources
+		ER_RHI_DescriptorAllocatorStats persistent; // shader-visible descriptors that live as long as their resource (bindless range)
+		ER_RHI_DescriptorAllocatorStats transient; // shader-visible tables that live for one frame (ring)
+	};
+
+	// O(1) allocation/free of single descriptors in [0, capacity).
+	// Freed indices are reused first (LIFO), so the used part of the heap stays as compact as possible.
+	class ER_RHI_DescriptorFreeListAllocator
+	{
+	public:
+		void Initialize(uint32_t aCapacity);
+
+		uint32_t Allocate(); // returns ER_RHI_DESCRIPTOR_INVALID_INDEX if the allocator is exhausted
+		bool Free(uint32_t aIndex); // returns false (and counts it in the stats) for double frees and invalid indices
+
+		bool IsAllocated(uint32_t aIndex) const { return aIndex < mCapacity && mIsAllocated[aIndex] != 0; }
+		uint32_t GetCapacity() const { return mCapacity; }
+		uint32_t GetHighWaterMark() const { return mHighWaterMark; }
+		ER_RHI_DescriptorAllocatorStats GetStats() const;
+	private:
+		std::vector<uint32_t> mFreeIndices;
+		std::vector<uint8_t> mIsAllocated;
+		ER_RHI_DescriptorAllocatorStats mStats;
+		uint32_t mCapacity = 0;
+		uint32_t mHighWaterMark = 0; // indices >= this were never allocated
+	};
+
+	// Ring of contiguous descriptor blocks (tables) in [0, capacity) that are only used by the GPU in the frame they were allocated in.
+	// Blocks of a frame are released when the backend reports that frame as completed (fence), blocks never wrap around the end of the ring.
+	class ER_RHI_DescriptorRingAllocator
+	{
+	public:
+		void Initialize(uint32_t aCapacity);
+
+		// Closes the current frame and releases all blocks of frames <= 'aCompletedFrameNumber'. Calling it again for the same frame only releases.
+		void BeginFrame(uint64_t aFrameNumber, uint64_t aCompletedFrameNumber);
+		uint32_t Allocate(uint32_t aCount); // returns the first index of the block or ER_RHI_DESCRIPTOR_INVALID_INDEX if there is no space
+
+		uint32_t GetCapacity() const { return mCapacity; }
+		uint32_t GetUsedCount() const { return static_cast<uint32_t>(mAllocatedTotal - mReleasedTotal); }
+		ER_RHI_DescriptorAllocatorStats GetStats() const;
+	private:
+		struct FrameMarker
+		{
+			uint64_t frameNumber;
+			uint64_t allocatedTotal; // mAllocatedTotal at the end of the frame
+			uint32_t head; // mHead at the end of the frame
+		};
+		uint32_t GetLargestFreeBlock() const;
+		void ResetIfEmpty();
+
+		std::vector<FrameMarker> mFrameMarkers; // oldest first
+		ER_RHI_DescriptorAllocatorStats mStats;
+		uint64_t mCurrentFrameNumber = 0;
+		uint64_t mAllocatedTotal = 0; // includes descriptors skipped at the end of the ring
+		uint64_t mReleasedTotal = 0;
+		uint32_t mCapacity = 0;
+		uint32_t mHead = 0; // next free index
+		uint32_t mTail = 0; // first index that is still in use
+	};
+}
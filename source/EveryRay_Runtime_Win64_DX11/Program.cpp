@@ -5,6 +5,7 @@
 
 #include "..\EveryRay_Core\ER_RuntimeCore.h"
 #include "..\EveryRay_Core\ER_CoreException.h"
+#include "..\EveryRay_Core\ER_TextureCooker.h"
 #include "..\EveryRay_Core\RHI\ER_RHI.h"
 #include "..\EveryRay_Core\RHI\DX11\ER_RHI_DX11.h"
 
@@ -21,6 +22,10 @@ int WINAPI WinMain(HINSTANCE instance, HINSTANCE previousInstance, LPSTR command
 	if (FAILED(CoInitializeEx(nullptr, COINIT_MULTITHREADED)))
 		throw ER_CoreException("Failed to call CoInitializeEx");
 
+	// offline texture cooking: "-cooktextures [level name] [-fast] [-force]" (no window, exits when done)
+	if (strstr(commandLine, "-cooktextures"))
+		return ER_TextureCooker::RunFromCommandLine(commandLine);
+
 	//#if defined(DEBUG) || defined(_DEBUG)
 	//_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF|_CRTDBG_LEAK_CHECK_DF);
 	//#endif